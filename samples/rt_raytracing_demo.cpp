@@ -1,5 +1,7 @@
+#include <chrono>
 #include <memory>
 
+#include <animation.h>
 #include <rmath.h>
 #include <scene.h>
 
@@ -17,8 +19,12 @@ public:
   RayTracingApp(Config conf) : WinApp(conf) {}
 
 private:
+  Animator m_animator;
+  chrono::steady_clock::time_point m_last_update;
+
   void on_start() override;
   void on_update() override;
+  void start_animations();
 };
 
 void RayTracingApp::on_start() {
@@ -106,10 +112,60 @@ void RayTracingApp::on_start() {
   scene().add_model(tube_arrange(2), tube, mild_light, L"tube light");
   scene().add_model(tube_arrange(3), tube, mild_light, L"tube light");
   scene().add_model(tube_arrange(4), tube, mild_light, L"tube light");
+
+  // analytic sphere lights: a distant sun and a small lamp
+  auto sphere_light = [&](const Vec3& pos, double radius, double intensity, const Name& name) {
+    Light light = Light::point(pos, Colors::white, intensity);
+    light.type = LightType::Sphere;
+    light.radius = radius;
+    light.name = name;
+    scene().add_light(light);
+  };
+  sphere_light({-100, 50, 60}, 1, 30000, L"sun");
+  sphere_light({-5, 4, -3}, 0.5, 400, L"lamp");
+
+  start_animations();
+}
+
+// The light blob circles above the cube, and the first small ball bounces
+void RayTracingApp::start_animations() {
+  auto find_model = [&](const Name& name) {
+    for (const ModelPtr& model : scene().get_models())
+      if (model->get_name() == name) return model->handle();
+    return ModelHandle();
+  };
+  const ModelHandle blob = find_model(L"light blob");
+  const ModelHandle ball = find_model(L"One of Small Balls");
+
+  auto clip = make_shared<AnimationClip>();
+  clip->name = L"Demo Loop";
+  AnimationChannel& orbit = clip->add_channel(L"light blob");
+  for (int k = 0; k <= 16; k++) {
+    const double angle = 2 * pi * k / 16;
+    orbit.translation.add_key(k * 0.5, {1.5 + std::cos(angle), 2.5, std::sin(angle)});
+  }
+  orbit.translation.interpolation = Interpolation::Cubic;
+  orbit.translation.auto_tangents();
+  AnimationChannel& bounce = clip->add_channel(L"ball");
+  const Vec3 ball_pos = scene().store().transform(ball)[3].truncated();
+  bounce.translation.add_key(0.0, ball_pos);
+  bounce.translation.add_key(1.0, ball_pos + Vec3(0, 1, 0));
+  bounce.translation.add_key(2.0, ball_pos);
+  clip->fit_duration();
+
+  const Animator::PlaybackId playback = m_animator.play(clip);
+  m_animator.bind(playback, 0, scene().store(), blob);
+  m_animator.bind(playback, 1, scene().store(), ball);
+  m_last_update = chrono::steady_clock::now();
 }
 
 void RayTracingApp::on_update() {
   Base::on_update();
+
+  const auto now = chrono::steady_clock::now();
+  m_animator.advance(chrono::duration<double>(now - m_last_update).count());
+  m_last_update = now;
+  m_animator.apply(scene());
 }
 
 int main() {
@@ -0,0 +1,173 @@
+#ifndef REI_AABB_H
+#define REI_AABB_H
+
+#include <algorithm>
+#include <limits>
+
+#include "algebra.h"
+
+/*
+ * aabb.h
+ * Axis-aligned bounding box and other bounding volumes, used by the spatial structures.
+ */
+
+namespace rei {
+
+struct Aabb {
+  // Empty box by default; expanding it by any point makes it valid
+  Vec3 min {(std::numeric_limits<double>::max)(), (std::numeric_limits<double>::max)(),
+    (std::numeric_limits<double>::max)()};
+  Vec3 max {(std::numeric_limits<double>::lowest)(), (std::numeric_limits<double>::lowest)(),
+    (std::numeric_limits<double>::lowest)()};
+
+  Aabb() = default;
+  Aabb(const Vec3& lo, const Vec3& hi) : min {lo}, max {hi} {}
+
+  bool empty() const { return min.x > max.x || min.y > max.y || min.z > max.z; }
+
+  void expand(const Vec3& p) {
+    for (int i = 0; i < 3; i++) {
+      min[i] = (std::min)(min[i], p[i]);
+      max[i] = (std::max)(max[i], p[i]);
+    }
+  }
+  void expand(const Aabb& b) {
+    for (int i = 0; i < 3; i++) {
+      min[i] = (std::min)(min[i], b.min[i]);
+      max[i] = (std::max)(max[i], b.max[i]);
+    }
+  }
+  void inflate(double r) {
+    min -= Vec3(r, r, r);
+    max += Vec3(r, r, r);
+  }
+
+  static Aabb merge(const Aabb& a, const Aabb& b) {
+    Aabb ret = a;
+    ret.expand(b);
+    return ret;
+  }
+
+  Vec3 center() const { return (min + max) * 0.5; }
+  Vec3 extent() const { return max - min; }
+  int longest_axis() const {
+    Vec3 e = extent();
+    return (e.x > e.y) ? (e.x > e.z ? 0 : 2) : (e.y > e.z ? 1 : 2);
+  }
+
+  double surface_area() const {
+    if (empty()) return 0;
+    Vec3 e = extent();
+    return 2.0 * (e.x * e.y + e.y * e.z + e.z * e.x);
+  }
+
+  bool contains(const Vec3& p) const {
+    return p.x >= min.x && p.x <= max.x && p.y >= min.y && p.y <= max.y && p.z >= min.z
+           && p.z <= max.z;
+  }
+  bool contains(const Aabb& b) const { return contains(b.min) && contains(b.max); }
+  bool overlaps(const Aabb& b) const {
+    return min.x <= b.max.x && max.x >= b.min.x && min.y <= b.max.y && max.y >= b.min.y
+           && min.z <= b.max.z && max.z >= b.min.z;
+  }
+
+  // Squared distance from a point to the box (0 if inside)
+  double distance2(const Vec3& p) const {
+    double d2 = 0;
+    for (int i = 0; i < 3; i++) {
+      double d = (std::max)({min[i] - p[i], 0.0, p[i] - max[i]});
+      d2 += d * d;
+    }
+    return d2;
+  }
+
+  // Slab test; `inv_dir` is the component-wise reciprocal of the ray direction.
+  // On hit, [t_near, t_far] is clipped to the overlapping interval.
+  bool intersect(const Vec3& origin, const Vec3& inv_dir, double& t_near, double& t_far) const {
+    for (int i = 0; i < 3; i++) {
+      double t0 = (min[i] - origin[i]) * inv_dir[i];
+      double t1 = (max[i] - origin[i]) * inv_dir[i];
+      if (t0 > t1) std::swap(t0, t1);
+      t_near = t0 > t_near ? t0 : t_near;
+      t_far = t1 < t_far ? t1 : t_far;
+      if (t_near > t_far) return false;
+    }
+    return true;
+  }
+
+  // Bounds of this box after an affine transform (column-vector convention)
+  Aabb transformed(const Mat4& m) const {
+    if (empty()) return *this;
+    Vec3 c = center(), e = extent() * 0.5;
+    Vec3 new_c = Vec3(m(0, 3), m(1, 3), m(2, 3));
+    Vec3 new_e;
+    for (int i = 0; i < 3; i++) {
+      new_c[i] += m(i, 0) * c.x + m(i, 1) * c.y + m(i, 2) * c.z;
+      new_e[i] = std::abs(m(i, 0)) * e.x + std::abs(m(i, 1)) * e.y + std::abs(m(i, 2)) * e.z;
+    }
+    return Aabb(new_c - new_e, new_c + new_e);
+  }
+};
+
+struct Sphere {
+  Vec3 center;
+  double radius = 0;
+
+  Sphere() = default;
+  Sphere(const Vec3& c, double r) : center(c), radius(r) {}
+
+  bool overlaps(const Aabb& b) const { return b.distance2(center) <= radius * radius; }
+};
+
+/*
+ * Convex volume bounded by six planes, extracted from a world-to-clip matrix with OpenGL-style
+ * clip space (-w <= z <= w), e.g. Camera::world_to_device(). Plane normals point inwards.
+ */
+struct Frustum {
+  enum Overlap { Outside, Intersecting, Inside };
+
+  Vec4 planes[6]; // (normal, d); a point p is inside a plane if dot(normal, p) + d >= 0
+
+  Frustum() = default;
+  explicit Frustum(const Mat4& world_to_clip) {
+    const Mat4& m = world_to_clip;
+    auto row = [&](int i) { return Vec4(m(i, 0), m(i, 1), m(i, 2), m(i, 3)); };
+    const Vec4 r0 = row(0), r1 = row(1), r2 = row(2), r3 = row(3);
+    planes[0] = r3 + r0; // left
+    planes[1] = r3 - r0; // right
+    planes[2] = r3 + r1; // bottom
+    planes[3] = r3 - r1; // top
+    planes[4] = r3 + r2; // near
+    planes[5] = r3 - r2; // far
+    for (Vec4& p : planes) {
+      double len = Vec3(p.x, p.y, p.z).norm();
+      if (len > 0) p = p * (1.0 / len);
+    }
+  }
+
+  bool contains(const Vec3& p) const {
+    for (const Vec4& pl : planes)
+      if (pl.x * p.x + pl.y * p.y + pl.z * p.z + pl.h < 0) return false;
+    return true;
+  }
+
+  // Conservative: boxes near frustum corners may be reported as intersecting
+  Overlap classify(const Aabb& b) const {
+    Overlap ret = Inside;
+    for (const Vec4& pl : planes) {
+      // farthest corner along the normal, and the nearest one
+      Vec3 pos(pl.x >= 0 ? b.max.x : b.min.x, pl.y >= 0 ? b.max.y : b.min.y,
+        pl.z >= 0 ? b.max.z : b.min.z);
+      Vec3 neg(pl.x >= 0 ? b.min.x : b.max.x, pl.y >= 0 ? b.min.y : b.max.y,
+        pl.z >= 0 ? b.min.z : b.max.z);
+      if (pl.x * pos.x + pl.y * pos.y + pl.z * pos.z + pl.h < 0) return Outside;
+      if (pl.x * neg.x + pl.y * neg.y + pl.z * neg.z + pl.h < 0) ret = Intersecting;
+    }
+    return ret;
+  }
+  bool overlaps(const Aabb& b) const { return classify(b) != Outside; }
+};
+
+} // namespace rei
+
+#endif
@@ -0,0 +1,309 @@
+// source of aabb_tree.h
+#include "aabb_tree.h"
+
+#include <algorithm>
+
+#include "debug.h"
+#include "parallel.h"
+
+using std::uint32_t;
+using std::vector;
+
+namespace rei {
+
+namespace {
+
+// Run `query(i, stack, out)` for every query in parallel and flatten the results in order
+template <typename Q>
+void run_batch(size_t query_num, DynamicAabbTree::BatchResult& result, Q&& query) {
+  vector<vector<uint32_t>> per_query(query_num);
+  parallel_for_range(0, query_num, 16, [&](size_t b, size_t e) {
+    vector<DynamicAabbTree::ProxyId> stack;
+    for (size_t i = b; i < e; i++)
+      query(i, stack, per_query[i]);
+  });
+  result.offsets.resize(query_num + 1);
+  result.offsets[0] = 0;
+  for (size_t i = 0; i < query_num; i++)
+    result.offsets[i + 1] = result.offsets[i] + per_query[i].size();
+  result.items.resize(result.offsets[query_num]);
+  parallel_for(0, query_num, 64, [&](size_t i) {
+    std::copy(per_query[i].begin(), per_query[i].end(), result.items.begin() + result.offsets[i]);
+  });
+}
+
+} // namespace
+
+uint32_t DynamicAabbTree::alloc_node() {
+  if (m_free == k_null) {
+    m_nodes.emplace_back();
+    return uint32_t(m_nodes.size() - 1);
+  }
+  uint32_t node = m_free;
+  m_free = m_nodes[node].parent;
+  m_nodes[node] = Node();
+  return node;
+}
+
+void DynamicAabbTree::free_node(uint32_t node) {
+  m_nodes[node].parent = m_free;
+  m_nodes[node].height = -1;
+  m_free = node;
+}
+
+Aabb DynamicAabbTree::fatten(const Aabb& bounds) const {
+  Aabb ret = bounds;
+  Vec3 e = bounds.extent() * m_margin;
+  e.x = (std::max)(e.x, m_min_margin);
+  e.y = (std::max)(e.y, m_min_margin);
+  e.z = (std::max)(e.z, m_min_margin);
+  ret.min -= e;
+  ret.max += e;
+  return ret;
+}
+
+DynamicAabbTree::ProxyId DynamicAabbTree::insert(const Aabb& bounds, uint32_t user_data) {
+  REI_ASSERT(!bounds.empty());
+  uint32_t leaf = alloc_node();
+  m_nodes[leaf].box = fatten(bounds);
+  m_nodes[leaf].user_data = user_data;
+  m_nodes[leaf].height = 0;
+  insert_leaf(leaf);
+  m_leaf_num++;
+  return leaf;
+}
+
+void DynamicAabbTree::remove(ProxyId proxy) {
+  REI_ASSERT(proxy < m_nodes.size() && m_nodes[proxy].height == 0);
+  remove_leaf(proxy);
+  free_node(proxy);
+  m_leaf_num--;
+}
+
+bool DynamicAabbTree::move(ProxyId proxy, const Aabb& bounds) {
+  REI_ASSERT(proxy < m_nodes.size() && m_nodes[proxy].height == 0);
+  if (m_nodes[proxy].box.contains(bounds)) return false;
+  remove_leaf(proxy);
+  m_nodes[proxy].box = fatten(bounds);
+  insert_leaf(proxy);
+  return true;
+}
+
+void DynamicAabbTree::clear() {
+  m_nodes.clear();
+  m_root = k_null;
+  m_free = k_null;
+  m_leaf_num = 0;
+  m_rebalance_cursor = 0;
+}
+
+void DynamicAabbTree::rebalance(size_t leaf_budget) {
+  if (m_leaf_num < 3) return;
+  size_t visited = 0;
+  while (leaf_budget > 0 && visited < m_nodes.size()) {
+    m_rebalance_cursor = (m_rebalance_cursor + 1) % m_nodes.size();
+    visited++;
+    uint32_t node = uint32_t(m_rebalance_cursor);
+    if (m_nodes[node].height != 0) continue;
+    remove_leaf(node);
+    insert_leaf(node);
+    leaf_budget--;
+  }
+}
+
+// Greedy descent on the SAH cost (as in Box2D): at each node, compare pairing the leaf with the
+// node itself against the lower bound of descending into either child. The cost of a pairing
+// is the area of the new parent plus the area growth inherited by all ancestors.
+uint32_t DynamicAabbTree::find_best_sibling(const Aabb& box) const {
+  const double leaf_area = box.surface_area();
+  uint32_t index = m_root;
+  double inherited = 0;
+  while (!m_nodes[index].leaf()) {
+    const Node& node = m_nodes[index];
+    const double area = node.box.surface_area();
+    const double merged_area = Aabb::merge(node.box, box).surface_area();
+    const double cost_here = merged_area + inherited;
+    const double child_inherited = inherited + merged_area - area;
+
+    double child_cost[2];
+    for (int i = 0; i < 2; i++) {
+      const Node& child = m_nodes[node.child[i]];
+      const double merged = Aabb::merge(child.box, box).surface_area();
+      // pairing with a leaf child is exact; for an internal child, only the growth is certain
+      child_cost[i] = child.leaf() ? merged + child_inherited
+                                   : merged - child.box.surface_area() + child_inherited
+                                       + leaf_area;
+    }
+    if (cost_here <= (std::min)(child_cost[0], child_cost[1])) break;
+    inherited = child_inherited;
+    index = node.child[child_cost[1] < child_cost[0] ? 1 : 0];
+  }
+  return index;
+}
+
+void DynamicAabbTree::insert_leaf(uint32_t leaf) {
+  if (m_root == k_null) {
+    m_root = leaf;
+    m_nodes[leaf].parent = k_null;
+    return;
+  }
+  const Aabb box = m_nodes[leaf].box;
+  const uint32_t sibling = find_best_sibling(box);
+
+  const uint32_t old_parent = m_nodes[sibling].parent;
+  const uint32_t new_parent = alloc_node();
+  Node& p = m_nodes[new_parent];
+  p.parent = old_parent;
+  p.box = Aabb::merge(box, m_nodes[sibling].box);
+  p.height = m_nodes[sibling].height + 1;
+  p.child[0] = sibling;
+  p.child[1] = leaf;
+  m_nodes[sibling].parent = new_parent;
+  m_nodes[leaf].parent = new_parent;
+
+  if (old_parent == k_null) {
+    m_root = new_parent;
+  } else {
+    Node& op = m_nodes[old_parent];
+    op.child[op.child[0] == sibling ? 0 : 1] = new_parent;
+  }
+  refit_upwards(old_parent);
+}
+
+void DynamicAabbTree::remove_leaf(uint32_t leaf) {
+  if (leaf == m_root) {
+    m_root = k_null;
+    return;
+  }
+  const uint32_t parent = m_nodes[leaf].parent;
+  const uint32_t grand = m_nodes[parent].parent;
+  const uint32_t sibling = m_nodes[parent].child[m_nodes[parent].child[0] == leaf ? 1 : 0];
+
+  m_nodes[sibling].parent = grand;
+  if (grand == k_null) {
+    m_root = sibling;
+  } else {
+    Node& g = m_nodes[grand];
+    g.child[g.child[0] == parent ? 0 : 1] = sibling;
+  }
+  free_node(parent);
+  m_nodes[leaf].parent = k_null;
+  refit_upwards(grand);
+}
+
+void DynamicAabbTree::refit_upwards(uint32_t node) {
+  while (node != k_null) {
+    rotate(node);
+    Node& n = m_nodes[node];
+    const Node& a = m_nodes[n.child[0]];
+    const Node& b = m_nodes[n.child[1]];
+    n.box = Aabb::merge(a.box, b.box);
+    n.height = 1 + (std::max)(a.height, b.height);
+    node = n.parent;
+  }
+}
+
+// Swap a child of `node` with a grandchild under the other child, if that shrinks the other
+// child's box (Kensler 2008). The children's boxes must be up to date.
+void DynamicAabbTree::rotate(uint32_t node) {
+  const uint32_t b = m_nodes[node].child[0];
+  const uint32_t c = m_nodes[node].child[1];
+
+  // Candidates: (side that is swapped up, grandchild that is swapped down)
+  double best_gain = 0;
+  uint32_t best_up = k_null, best_down = k_null;
+  for (int side = 0; side < 2; side++) {
+    const uint32_t up = side == 0 ? b : c;      // moves under `other`
+    const uint32_t other = side == 0 ? c : b;   // loses a grandchild
+    const Node& o = m_nodes[other];
+    if (o.leaf()) continue;
+    const double area = o.box.surface_area();
+    for (int g = 0; g < 2; g++) {
+      // `up` replaces grandchild g, which becomes the child of `node`
+      const uint32_t kept = o.child[1 - g];
+      const double new_area = Aabb::merge(m_nodes[up].box, m_nodes[kept].box).surface_area();
+      const double gain = area - new_area;
+      if (gain > best_gain) {
+        best_gain = gain;
+        best_up = up;
+        best_down = o.child[g];
+      }
+    }
+  }
+  if (best_up == k_null) return;
+
+  // Swap best_up (child of node) with best_down (grandchild under the other child)
+  const uint32_t other = m_nodes[best_down].parent;
+  Node& n = m_nodes[node];
+  n.child[n.child[0] == best_up ? 0 : 1] = best_down;
+  Node& o = m_nodes[other];
+  o.child[o.child[0] == best_down ? 0 : 1] = best_up;
+  m_nodes[best_down].parent = node;
+  m_nodes[best_up].parent = other;
+  o.box = Aabb::merge(m_nodes[o.child[0]].box, m_nodes[o.child[1]].box);
+  o.height = 1 + (std::max)(m_nodes[o.child[0]].height, m_nodes[o.child[1]].height);
+}
+
+double DynamicAabbTree::sah_cost() const {
+  if (m_root == k_null) return 0;
+  double total = 0;
+  for (const Node& n : m_nodes)
+    if (n.height > 0) total += n.box.surface_area();
+  return total / m_nodes[m_root].box.surface_area();
+}
+
+bool DynamicAabbTree::validate() const {
+  if (m_root == k_null) return m_leaf_num == 0;
+  if (m_nodes[m_root].parent != k_null) return false;
+  size_t leaves = 0;
+  vector<uint32_t> stack {m_root};
+  while (!stack.empty()) {
+    const uint32_t i = stack.back();
+    stack.pop_back();
+    const Node& n = m_nodes[i];
+    if (n.leaf()) {
+      if (n.height != 0) return false;
+      leaves++;
+      continue;
+    }
+    const Node& a = m_nodes[n.child[0]];
+    const Node& b = m_nodes[n.child[1]];
+    if (a.parent != i || b.parent != i) return false;
+    if (n.height != 1 + (std::max)(a.height, b.height)) return false;
+    if (!n.box.contains(a.box) || !n.box.contains(b.box)) return false;
+    stack.push_back(n.child[0]);
+    stack.push_back(n.child[1]);
+  }
+  return leaves == m_leaf_num;
+}
+
+void DynamicAabbTree::query(const vector<Aabb>& boxes, BatchResult& result) const {
+  run_batch(boxes.size(), result, [&](size_t i, vector<ProxyId>& stack, vector<uint32_t>& out) {
+    traverse(stack, [&](const Aabb& b) { return boxes[i].overlaps(b); },
+      [&](uint32_t user) { out.push_back(user); });
+  });
+}
+
+void DynamicAabbTree::query(const vector<Sphere>& spheres, BatchResult& result) const {
+  run_batch(spheres.size(), result, [&](size_t i, vector<ProxyId>& stack, vector<uint32_t>& out) {
+    traverse(stack, [&](const Aabb& b) { return spheres[i].overlaps(b); },
+      [&](uint32_t user) { out.push_back(user); });
+  });
+}
+
+void DynamicAabbTree::query(const vector<Frustum>& frustums, BatchResult& result) const {
+  run_batch(frustums.size(), result, [&](size_t i, vector<ProxyId>& stack, vector<uint32_t>& out) {
+    query_frustum(stack, frustums[i], [&](uint32_t user) { out.push_back(user); });
+  });
+}
+
+void DynamicAabbTree::query(const vector<Ray>& rays, BatchResult& result) const {
+  run_batch(rays.size(), result, [&](size_t i, vector<ProxyId>& stack, vector<uint32_t>& out) {
+    query_ray(stack, rays[i], [&](uint32_t user, double) {
+      out.push_back(user);
+      return rays[i].t_max;
+    });
+  });
+}
+
+} // namespace rei
@@ -0,0 +1,195 @@
+#ifndef REI_AABB_TREE_H
+#define REI_AABB_TREE_H
+
+#include <cstdint>
+#include <vector>
+
+#include "aabb.h"
+#include "algebra.h"
+
+/*
+ * aabb_tree.h
+ * Dynamic AABB tree: an incrementally updated bounding volume hierarchy over moving objects.
+ */
+
+namespace rei {
+
+/*
+ * Leaves store "fat" boxes (the object bounds inflated by a margin), so an object moving
+ * inside its fat box costs nothing. Otherwise the leaf is reinserted in O(log n):
+ *   - insertion descends towards the sibling that adds the least surface area to the tree
+ *     (greedy on the SAH cost);
+ *   - every refit on the way up tries a tree rotation that reduces surface area, so the tree
+ *     rebalances itself incrementally;
+ *   - rebalance() additionally reinserts a few leaves per call, round-robin.
+ * Proxy ids are stable for the lifetime of an object.
+ */
+class DynamicAabbTree {
+public:
+  using ProxyId = std::uint32_t;
+  static constexpr ProxyId k_null = UINT32_MAX;
+
+  struct Ray {
+    Vec3 origin;
+    Vec3 dir;
+    double t_max;
+  };
+
+  // Results of a batched query: results of query i are items[offsets[i], offsets[i + 1])
+  struct BatchResult {
+    std::vector<std::uint32_t> items;
+    std::vector<size_t> offsets;
+  };
+
+  // `margin` is relative to the object size; `min_margin` is absolute
+  explicit DynamicAabbTree(double margin = 0.1, double min_margin = 1e-3)
+      : m_margin(margin), m_min_margin(min_margin) {}
+
+  ProxyId insert(const Aabb& bounds, std::uint32_t user_data);
+  void remove(ProxyId proxy);
+  // Return true if the leaf was reinserted
+  bool move(ProxyId proxy, const Aabb& bounds);
+  void clear();
+
+  // Reinsert up to `leaf_budget` leaves; call once per frame for steady improvement
+  void rebalance(size_t leaf_budget);
+
+  size_t size() const { return m_leaf_num; }
+  bool empty() const { return m_root == k_null; }
+  int height() const { return m_root == k_null ? 0 : m_nodes[m_root].height; }
+  std::uint32_t user_data(ProxyId proxy) const { return m_nodes[proxy].user_data; }
+  const Aabb& fat_bounds(ProxyId proxy) const { return m_nodes[proxy].box; }
+  Aabb bounds() const { return m_root == k_null ? Aabb() : m_nodes[m_root].box; }
+  // Sum of surface areas of internal nodes, relative to the root; lower is better
+  double sah_cost() const;
+  // Check structure invariants; for tests
+  bool validate() const;
+
+  // Visitors receive the user data of every leaf whose fat box passes the test
+  template <typename F>
+  void query(const Aabb& box, F&& f) const {
+    std::vector<ProxyId> stack;
+    traverse(stack, [&](const Aabb& b) { return box.overlaps(b); }, f);
+  }
+  template <typename F>
+  void query(const Sphere& sphere, F&& f) const {
+    std::vector<ProxyId> stack;
+    traverse(stack, [&](const Aabb& b) { return sphere.overlaps(b); }, f);
+  }
+  template <typename F>
+  void query(const Frustum& frustum, F&& f) const {
+    std::vector<ProxyId> stack;
+    query_frustum(stack, frustum, f);
+  }
+  // f(user_data, t_enter) returns the new t_max: return t_max to continue, or a smaller value
+  // (e.g. a narrow-phase hit distance) to clip the ray; leaves are not visited in t order
+  template <typename F>
+  void query(const Ray& ray, F&& f) const {
+    std::vector<ProxyId> stack;
+    query_ray(stack, ray, f);
+  }
+
+  // Batched, multi-threaded queries
+  void query(const std::vector<Aabb>& boxes, BatchResult& result) const;
+  void query(const std::vector<Sphere>& spheres, BatchResult& result) const;
+  void query(const std::vector<Frustum>& frustums, BatchResult& result) const;
+  void query(const std::vector<Ray>& rays, BatchResult& result) const;
+
+private:
+  struct Node {
+    Aabb box;
+    std::uint32_t parent = k_null; // next free node when on the free list
+    std::uint32_t child[2] = {k_null, k_null};
+    std::uint32_t user_data = 0;
+    int height = 0; // leaves are 0; -1 when free
+
+    bool leaf() const { return child[0] == k_null; }
+  };
+
+  std::vector<Node> m_nodes;
+  std::uint32_t m_root = k_null;
+  std::uint32_t m_free = k_null;
+  size_t m_leaf_num = 0;
+  size_t m_rebalance_cursor = 0;
+  double m_margin;
+  double m_min_margin;
+
+  std::uint32_t alloc_node();
+  void free_node(std::uint32_t node);
+  Aabb fatten(const Aabb& bounds) const;
+  void insert_leaf(std::uint32_t leaf);
+  void remove_leaf(std::uint32_t leaf);
+  std::uint32_t find_best_sibling(const Aabb& box) const;
+  void refit_upwards(std::uint32_t node);
+  void rotate(std::uint32_t node);
+
+  template <typename Test, typename F>
+  void traverse(std::vector<ProxyId>& stack, Test&& test, F&& f) const {
+    if (m_root == k_null) return;
+    stack.clear();
+    stack.push_back(m_root);
+    while (!stack.empty()) {
+      const Node& node = m_nodes[stack.back()];
+      stack.pop_back();
+      if (!test(node.box)) continue;
+      if (node.leaf()) {
+        f(node.user_data);
+      } else {
+        stack.push_back(node.child[0]);
+        stack.push_back(node.child[1]);
+      }
+    }
+  }
+
+  // Subtrees fully inside the frustum are reported without further plane tests
+  template <typename F>
+  void query_frustum(std::vector<ProxyId>& stack, const Frustum& frustum, F&& f) const {
+    if (m_root == k_null) return;
+    const std::uint32_t inside_bit = 0x80000000u;
+    stack.clear();
+    stack.push_back(m_root);
+    while (!stack.empty()) {
+      std::uint32_t entry = stack.back();
+      stack.pop_back();
+      const Node& node = m_nodes[entry & ~inside_bit];
+      std::uint32_t inside = entry & inside_bit;
+      if (!inside) {
+        Frustum::Overlap overlap = frustum.classify(node.box);
+        if (overlap == Frustum::Outside) continue;
+        if (overlap == Frustum::Inside) inside = inside_bit;
+      }
+      if (node.leaf()) {
+        f(node.user_data);
+      } else {
+        stack.push_back(node.child[0] | inside);
+        stack.push_back(node.child[1] | inside);
+      }
+    }
+  }
+
+  template <typename F>
+  void query_ray(std::vector<ProxyId>& stack, const Ray& ray, F&& f) const {
+    if (m_root == k_null) return;
+    const Vec3 inv_dir(1.0 / ray.dir.x, 1.0 / ray.dir.y, 1.0 / ray.dir.z);
+    double t_max = ray.t_max;
+    stack.clear();
+    stack.push_back(m_root);
+    while (!stack.empty()) {
+      const Node& node = m_nodes[stack.back()];
+      stack.pop_back();
+      double t_near = 0, t_far = t_max;
+      if (!node.box.intersect(ray.origin, inv_dir, t_near, t_far)) continue;
+      if (node.leaf()) {
+        t_max = f(node.user_data, t_near);
+        if (t_max <= 0) return;
+      } else {
+        stack.push_back(node.child[0]);
+        stack.push_back(node.child[1]);
+      }
+    }
+  }
+};
+
+} // namespace rei
+
+#endif
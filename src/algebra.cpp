@@ -41,6 +41,11 @@ std::wostream& operator<<(std::wostream& os, const Mat3& m) {
   return os;
 }
 
+// Column-vector transformation : Ax
+Vec3 operator*(const Mat3& A, const Vec3& x) {
+  return A[0] * x.x + A[1] * x.y + A[2] * x.z;
+}
+
 // Vec4 //////////////////////////////////////////////////////////////////////
 // Non-members.
 ////
@@ -151,6 +156,15 @@ Mat3 Mat4::adj3() const {
     A(0, 0) * A(1, 1) - A(0, 1) * A(1, 0));
 }
 
+// Cofactors are det * inverse-transpose; flip them back for mirroring transforms
+Mat4 Mat4::normal_matrix() const {
+  Mat3 C = adj3();
+  const Mat4& A = *this;
+  const double det = A(0, 0) * C(0, 0) + A(0, 1) * C(0, 1) + A(0, 2) * C(0, 2);
+  if (det < 0) C *= -1;
+  return {{C[0], 0}, {C[1], 0}, {C[2], 0}, {0, 0, 0, 1}};
+}
+
 // Minor (reduced determinant)
 double Mat4::minor(int i, int j) const {
   // Now I really wish to learn meta-programming ... this is UGLY
@@ -202,4 +216,74 @@ std::wostream& operator<<(std::wostream& os, const Mat4& m) {
   return os;
 }
 
+// Quat ///////////////////////////////////////////////////////////////////////
+
+// Shepperd's method: branch on the largest diagonal term for precision
+Quat Quat::from_matrix(const Mat4& m) {
+  const double trace = m(0, 0) + m(1, 1) + m(2, 2);
+  Quat q;
+  if (trace > 0) {
+    const double s = 0.5 / std::sqrt(trace + 1.0);
+    q = {(m(2, 1) - m(1, 2)) * s, (m(0, 2) - m(2, 0)) * s, (m(1, 0) - m(0, 1)) * s, 0.25 / s};
+  } else if (m(0, 0) > m(1, 1) && m(0, 0) > m(2, 2)) {
+    const double s = 2.0 * std::sqrt(1.0 + m(0, 0) - m(1, 1) - m(2, 2));
+    q = {0.25 * s, (m(0, 1) + m(1, 0)) / s, (m(0, 2) + m(2, 0)) / s, (m(2, 1) - m(1, 2)) / s};
+  } else if (m(1, 1) > m(2, 2)) {
+    const double s = 2.0 * std::sqrt(1.0 + m(1, 1) - m(0, 0) - m(2, 2));
+    q = {(m(0, 1) + m(1, 0)) / s, 0.25 * s, (m(1, 2) + m(2, 1)) / s, (m(0, 2) - m(2, 0)) / s};
+  } else {
+    const double s = 2.0 * std::sqrt(1.0 + m(2, 2) - m(0, 0) - m(1, 1));
+    q = {(m(0, 2) + m(2, 0)) / s, (m(1, 2) + m(2, 1)) / s, 0.25 * s, (m(1, 0) - m(0, 1)) / s};
+  }
+  return q.normalized();
+}
+
+Mat4 Quat::matrix() const {
+  const double xx = x * x, yy = y * y, zz = z * z;
+  const double xy = x * y, xz = x * z, yz = y * z, wx = w * x, wy = w * y, wz = w * z;
+  return {1 - 2 * (yy + zz), 2 * (xy - wz), 2 * (xz + wy), 0, //
+    2 * (xy + wz), 1 - 2 * (xx + zz), 2 * (yz - wx), 0,       //
+    2 * (xz - wy), 2 * (yz + wx), 1 - 2 * (xx + yy), 0,       //
+    0, 0, 0, 1};
+}
+
+Quat slerp(const Quat& a, const Quat& b, double t) {
+  double cos_theta = dot(a, b);
+  const Quat b1 = cos_theta < 0 ? -b : b;
+  cos_theta = std::abs(cos_theta);
+  // Nearly parallel: the sine below vanishes, and lerp is as accurate
+  if (cos_theta > 0.9995) return (a * (1 - t) + b1 * t).normalized();
+  const double theta = std::acos(cos_theta);
+  const double inv_sin = 1.0 / std::sin(theta);
+  return a * (std::sin((1 - t) * theta) * inv_sin) + b1 * (std::sin(t * theta) * inv_sin);
+}
+
+std::wostream& operator<<(std::wostream& os, const Quat& q) {
+  return os << "Quat(" << q.x << ", " << q.y << ", " << q.z << ", " << q.w << ")";
+}
+
+// Trs ///////////////////////////////////////////////////////////////////////
+
+Mat4 Trs::matrix() const {
+  Mat4 m = rotation.matrix();
+  m[0] = m[0] * scale.x;
+  m[1] = m[1] * scale.y;
+  m[2] = m[2] * scale.z;
+  m[3] = Vec4(translation, 1.0);
+  return m;
+}
+
+Trs Trs::decompose(const Mat4& m) {
+  Trs ret;
+  ret.translation = m[3].truncated();
+  Vec3 axes[3] = {m[0].truncated(), m[1].truncated(), m[2].truncated()};
+  ret.scale = {axes[0].norm(), axes[1].norm(), axes[2].norm()};
+  if (dot(cross(axes[0], axes[1]), axes[2]) < 0) ret.scale.x = -ret.scale.x;
+  Mat4 rot = Mat4::I();
+  for (int i = 0; i < 3; i++)
+    if (ret.scale[i] != 0) rot[i] = Vec4(axes[i] * (1.0 / ret.scale[i]), 0.0);
+  ret.rotation = Quat::from_matrix(rot);
+  return ret;
+}
+
 } // namespace rei
@@ -197,7 +197,7 @@ inline Mat3 operator*(double c, const Mat3& A) {
 }
 
 // Column-vector transformation : Ax
-Vec3 operator*(const Mat3& A, const Vec3& x); // TODO
+Vec3 operator*(const Mat3& A, const Vec3& x);
 
 // Row-vector transformation : xA
 inline Vec3 operator*(const Vec3& x, const Mat3& A) {
@@ -372,6 +372,11 @@ struct Mat4 {
   // Adjoint of the upper-left 3x3 matrix; useful for normal transform
   Mat3 adj3() const;
 
+  // Transform for normals (and other covectors): the inverse-transpose of the upper-left 3x3
+  // matrix, up to a positive scale, without translation. Correct under non-uniform scale and
+  // mirroring; normals need to be renormalized after.
+  Mat4 normal_matrix() const;
+
   // Minor (reduced determinant)
   double minor(int i, int j) const;
 
@@ -407,6 +412,86 @@ inline Vec4 operator*(const Vec4& x, const Mat4& A) {
   return Vec4(dot(x, A[0]), dot(x, A[1]), dot(x, A[2]), dot(x, A[3]));
 }
 
+// Quat ///////////////////////////////////////////////////////////////////////
+// Quaternion (x, y, z) + w; unit quaternions represent rotations.
+////
+
+struct Quat {
+  double x;
+  double y;
+  double z;
+  double w;
+
+  // Default constructor (identity rotation)
+  constexpr Quat() : x(0.0), y(0.0), z(0.0), w(1.0) {};
+
+  // Initialize with components
+  constexpr Quat(double x, double y, double z, double w) : x(x), y(y), z(z), w(w) {};
+
+  // Rotation around a unit axis, right-handed
+  static Quat rotate(const Vec3& axis, double radian) {
+    const double s = std::sin(radian * 0.5);
+    return {axis.x * s, axis.y * s, axis.z * s, std::cos(radian * 0.5)};
+  }
+
+  // Rotation of an orthonormal (upper-left 3x3) matrix
+  static Quat from_matrix(const Mat4& m);
+
+  // Access element by index (from 0; w is 3)
+  double& operator[](int i) { return (&x)[i]; }
+  const double& operator[](int i) const { return (&x)[i]; }
+
+  // Arithmatics, for blending
+  Quat operator+(const Quat& rhs) const { return {x + rhs.x, y + rhs.y, z + rhs.z, w + rhs.w}; }
+  Quat operator*(double c) const { return {x * c, y * c, z * c, w * c}; }
+  Quat operator-() const { return {-x, -y, -z, -w}; }
+
+  // Hamilton product; composes rotations (rhs first)
+  Quat operator*(const Quat& rhs) const {
+    return {w * rhs.x + x * rhs.w + y * rhs.z - z * rhs.y,
+      w * rhs.y - x * rhs.z + y * rhs.w + z * rhs.x,
+      w * rhs.z + x * rhs.y - y * rhs.x + z * rhs.w, w * rhs.w - x * rhs.x - y * rhs.y - z * rhs.z};
+  }
+  Quat conjugate() const { return {-x, -y, -z, w}; }
+
+  // Norms
+  double norm2() const { return x * x + y * y + z * z + w * w; }
+  double norm() const { return std::sqrt(norm2()); }
+  Quat normalized() const { return (*this) * (1.0 / norm()); }
+
+  // Rotate a vector (assume unit length)
+  Vec3 rotate_vector(const Vec3& v) const {
+    const Vec3 u {x, y, z};
+    const Vec3 t = 2.0 * cross(u, v);
+    return v + w * t + cross(u, t);
+  }
+
+  // Rotation matrix (assume unit length)
+  Mat4 matrix() const;
+};
+
+inline double dot(const Quat& a, const Quat& b) {
+  return a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w;
+}
+
+// Spherical interpolation along the shorter arc; unit inputs give a unit result
+Quat slerp(const Quat& a, const Quat& b, double t);
+
+// Print quaternion
+std::wostream& operator<<(std::wostream& os, const Quat& q);
+
+// Translation, rotation and scale, composed as T * R * S
+struct Trs {
+  Vec3 translation;
+  Quat rotation;
+  Vec3 scale {1.0, 1.0, 1.0};
+
+  Mat4 matrix() const;
+
+  // Split an affine transform without shear; a mirroring is folded into a negative x scale
+  static Trs decompose(const Mat4& m);
+};
+
 // Common data transform
 inline void flip_z_column(Mat4& m) {
   m[2] = -m[2];
@@ -0,0 +1,268 @@
+// source of animation.h
+#include "animation.h"
+
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+
+#include "parallel.h"
+#include "scene.h"
+
+using std::uint32_t;
+using std::vector;
+
+namespace rei {
+
+// Tracks ////////////////////////////////////////////////////////////////////
+
+template <int N>
+void KeyTrack<N>::auto_tangents() {
+  const size_t n = times.size();
+  for (int c = 0; c < N; c++) {
+    in_tangents[c].resize(n);
+    out_tangents[c].resize(n);
+    for (size_t k = 0; k < n; k++) {
+      // One-sided differences at the ends
+      const size_t prev = k > 0 ? k - 1 : k, next = k + 1 < n ? k + 1 : k;
+      const float dt = times[next] - times[prev];
+      const float m = dt > 0 ? (values[c][next] - values[c][prev]) / dt : 0.f;
+      in_tangents[c][k] = out_tangents[c][k] = m;
+    }
+  }
+}
+
+template struct KeyTrack<3>;
+template struct KeyTrack<4>;
+
+void Vec3Track::add_key(double time, const Vec3& v) {
+  REI_ASSERT(times.empty() || float(time) > times.back());
+  times.push_back(float(time));
+  for (int c = 0; c < 3; c++)
+    values[c].push_back(float(v[c]));
+}
+
+void Vec3Track::add_key(
+  double time, const Vec3& v, const Vec3& in_tangent, const Vec3& out_tangent) {
+  add_key(time, v);
+  for (int c = 0; c < 3; c++) {
+    in_tangents[c].push_back(float(in_tangent[c]));
+    out_tangents[c].push_back(float(out_tangent[c]));
+  }
+}
+
+void QuatTrack::add_key(double time, const Quat& q) {
+  REI_ASSERT(times.empty() || float(time) > times.back());
+  times.push_back(float(time));
+  for (int c = 0; c < 4; c++)
+    values[c].push_back(float(q[c]));
+}
+
+void QuatTrack::add_key(
+  double time, const Quat& q, const Quat& in_tangent, const Quat& out_tangent) {
+  add_key(time, q);
+  for (int c = 0; c < 4; c++) {
+    in_tangents[c].push_back(float(in_tangent[c]));
+    out_tangents[c].push_back(float(out_tangent[c]));
+  }
+}
+
+uint32_t find_key(const vector<float>& times, float time, uint32_t& cursor) {
+  const uint32_t n = uint32_t(times.size());
+  if (n < 2 || time <= times[0]) return cursor = 0;
+  if (time >= times[n - 1]) return cursor = n - 1;
+  // From here on times[0] < time < times[n - 1], so the segment is in [0, n - 2]
+  uint32_t k = (std::min)(cursor, n - 2);
+  if (times[k] <= time) {
+    // A frame step rarely crosses more than a key or two
+    for (int step = 0; step < 4; step++, k++)
+      if (time < times[k + 1]) return cursor = k;
+    k = uint32_t(std::upper_bound(times.begin() + k, times.end(), time) - times.begin()) - 1;
+  } else {
+    k = uint32_t(std::upper_bound(times.begin(), times.begin() + k, time) - times.begin()) - 1;
+  }
+  return cursor = k;
+}
+
+// Component-wise interpolation of key k and k + 1 at `time` in between; false when the value is
+// just key k (step, or clamped to an end)
+template <int N>
+static bool interpolate(const KeyTrack<N>& track, uint32_t k, float time, double out[N]) {
+  if (k + 1 >= track.size() || time <= track.times[k]
+      || track.interpolation == Interpolation::Step) {
+    for (int c = 0; c < N; c++)
+      out[c] = track.values[c][k];
+    return false;
+  }
+  const double t0 = track.times[k], dt = double(track.times[k + 1]) - t0;
+  const double u = (time - t0) / dt;
+  if (track.interpolation == Interpolation::Linear) {
+    for (int c = 0; c < N; c++)
+      out[c] = track.values[c][k] + (track.values[c][k + 1] - track.values[c][k]) * u;
+    return true;
+  }
+  // Cubic Hermite basis
+  REI_ASSERT(track.in_tangents[0].size() == track.size());
+  const double u2 = u * u, u3 = u2 * u;
+  const double h00 = 2 * u3 - 3 * u2 + 1, h10 = (u3 - 2 * u2 + u) * dt;
+  const double h01 = -2 * u3 + 3 * u2, h11 = (u3 - u2) * dt;
+  for (int c = 0; c < N; c++)
+    out[c] = h00 * track.values[c][k] + h10 * track.out_tangents[c][k]
+             + h01 * track.values[c][k + 1] + h11 * track.in_tangents[c][k + 1];
+  return true;
+}
+
+Vec3 sample(const Vec3Track& track, float time, uint32_t& cursor) {
+  REI_ASSERT(!track.empty());
+  const uint32_t k = find_key(track.times, time, cursor);
+  double v[3];
+  interpolate(track, k, time, v);
+  return {v[0], v[1], v[2]};
+}
+
+Quat sample(const QuatTrack& track, float time, uint32_t& cursor) {
+  REI_ASSERT(!track.empty());
+  const uint32_t k = find_key(track.times, time, cursor);
+  if (track.interpolation == Interpolation::Linear && k + 1 < track.size()
+      && time > track.times[k]) {
+    const double u = (time - track.times[k]) / (track.times[k + 1] - track.times[k]);
+    return slerp(track.key(k), track.key(k + 1), u);
+  }
+  double v[4];
+  if (interpolate(track, k, time, v)) return Quat(v[0], v[1], v[2], v[3]).normalized();
+  return {v[0], v[1], v[2], v[3]};
+}
+
+// AnimationClip /////////////////////////////////////////////////////////////
+
+size_t AnimationClip::find_channel(const Name& target) const {
+  for (size_t i = 0; i < channels.size(); i++)
+    if (channels[i].target == target) return i;
+  return SIZE_MAX;
+}
+
+void AnimationClip::fit_duration() {
+  duration = 0;
+  for (const AnimationChannel& ch : channels) {
+    const float end = (std::max)(
+      {ch.translation.end_time(), ch.rotation.end_time(), ch.scale.end_time()});
+    duration = (std::max)(duration, double(end));
+  }
+}
+
+// Animator //////////////////////////////////////////////////////////////////
+
+Animator::PlaybackId Animator::play(
+  std::shared_ptr<const AnimationClip> clip, bool loop, double speed) {
+  REI_ASSERT(clip);
+  m_playbacks.push_back({std::move(clip), 0.0, speed, loop});
+  return PlaybackId(m_playbacks.size() - 1);
+}
+
+void Animator::add_binding(PlaybackId playback, size_t channel, ModelHandle model,
+  SceneGraph::NodeId node, const Mat4& rest) {
+  REI_ASSERT(playback < m_playbacks.size());
+  const AnimationClip& clip = *m_playbacks[playback].clip;
+  REI_ASSERT(channel < clip.channels.size());
+  m_playback.push_back(playback);
+  m_channels.push_back(&clip.channels[channel]);
+  m_models.push_back(model);
+  m_nodes.push_back(node);
+  m_rest.push_back(Trs::decompose(rest));
+  m_cursors.push_back({});
+}
+
+void Animator::bind(
+  PlaybackId playback, size_t channel, const ModelStore& store, ModelHandle model) {
+  REI_ASSERT(store.valid(model));
+  add_binding(playback, channel, model, SceneGraph::k_invalid_node, store.transform(model));
+}
+
+void Animator::bind(
+  PlaybackId playback, size_t channel, const SceneGraph& graph, SceneGraph::NodeId node) {
+  add_binding(playback, channel, ModelHandle(), node, graph.local(node));
+}
+
+size_t Animator::bind(PlaybackId playback, const SceneGraph& graph) {
+  const AnimationClip& clip = *m_playbacks[playback].clip;
+  std::unordered_map<Name, size_t> channel_of;
+  for (size_t i = 0; i < clip.channels.size(); i++)
+    channel_of.emplace(clip.channels[i].target, i);
+  size_t count = 0;
+  for (SceneGraph::NodeId node = 0; node < graph.size() && !channel_of.empty(); node++) {
+    auto it = channel_of.find(graph.name(node));
+    if (it == channel_of.end()) continue;
+    bind(playback, it->second, graph, node);
+    channel_of.erase(it); // the first node of a name takes the channel
+    count++;
+  }
+  return count;
+}
+
+void Animator::advance(double seconds) {
+  for (Playback& p : m_playbacks)
+    p.time += seconds * p.speed;
+}
+
+size_t Animator::apply(ModelStore& store, SceneGraph* graph) {
+  m_clip_times.resize(m_playbacks.size());
+  for (size_t i = 0; i < m_playbacks.size(); i++) {
+    const Playback& p = m_playbacks[i];
+    const double duration = p.clip->duration;
+    double t = 0;
+    if (duration > 0) {
+      t = p.loop ? std::fmod(p.time, duration) : (std::min)((std::max)(p.time, 0.0), duration);
+      if (t < 0) t += duration;
+    }
+    m_clip_times[i] = float(t);
+  }
+
+  // Models are written in place, each by one binding; nodes go through the graph afterwards
+  const size_t n = m_channels.size();
+  m_samples.resize(n);
+  Mat4* transforms = store.transforms();
+  parallel_for(0, n, 64, [&](size_t i) {
+    const AnimationChannel& ch = *m_channels[i];
+    const float t = m_clip_times[m_playback[i]];
+    Cursors& cursors = m_cursors[i];
+    Trs trs = m_rest[i];
+    if (!ch.translation.empty()) trs.translation = sample(ch.translation, t, cursors.t);
+    if (!ch.rotation.empty()) trs.rotation = sample(ch.rotation, t, cursors.r);
+    if (!ch.scale.empty()) trs.scale = sample(ch.scale, t, cursors.s);
+    const ModelHandle model = m_models[i];
+    if (!model)
+      m_samples[i] = trs.matrix();
+    else if (store.valid(model))
+      transforms[store.dense_index(model)] = trs.matrix();
+  });
+
+  m_written.clear();
+  size_t nodes_written = 0;
+  for (size_t i = 0; i < n; i++) {
+    if (m_models[i]) {
+      if (store.valid(m_models[i])) m_written.push_back(m_models[i]);
+    } else if (graph) {
+      graph->set_local(m_nodes[i], m_samples[i]);
+      nodes_written++;
+    }
+  }
+  store.mark_changed(m_written.data(), m_written.size());
+  return m_written.size() + nodes_written;
+}
+
+size_t Animator::apply(Scene& scene) {
+  const size_t count = apply(scene.store(), &scene.graph());
+  scene.update_transforms();
+  return count;
+}
+
+void Animator::clear() {
+  m_playbacks.clear();
+  m_playback.clear();
+  m_channels.clear();
+  m_models.clear();
+  m_nodes.clear();
+  m_rest.clear();
+  m_cursors.clear();
+}
+
+} // namespace rei
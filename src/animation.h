@@ -0,0 +1,188 @@
+#ifndef REI_ANIMATION_H
+#define REI_ANIMATION_H
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "algebra.h"
+#include "common.h"
+#include "model_store.h"
+#include "scene_graph.h"
+
+/*
+ * animation.h
+ * Keyframe animation clips, and an Animator sampling them into model and node transforms.
+ */
+
+namespace rei {
+
+class Scene;
+
+enum class Interpolation : std::uint8_t {
+  Step,   // hold the value of the previous key
+  Linear, // lerp; slerp for rotations
+  Cubic,  // Hermite spline through the keys, with per-key in/out tangents
+};
+
+/*
+ * Keyframes of an N-component property. Keys are stored SoA: the times in one array and each
+ * component in its own, so the key search only walks the time array.
+ *
+ * Cubic tangents are in units per second: out_tangents[c][k] leaves key k and in_tangents[c][k]
+ * arrives at it (the glTF convention). Other interpolations leave them empty.
+ */
+template <int N>
+struct KeyTrack {
+  static constexpr int k_components = N;
+
+  Interpolation interpolation = Interpolation::Linear;
+  std::vector<float> times; // seconds, strictly increasing
+  std::vector<float> values[N];
+  std::vector<float> in_tangents[N];
+  std::vector<float> out_tangents[N];
+
+  size_t size() const { return times.size(); }
+  bool empty() const { return times.empty(); }
+  float end_time() const { return times.empty() ? 0.f : times.back(); }
+
+  void reserve(size_t n) {
+    times.reserve(n);
+    for (int c = 0; c < N; c++)
+      values[c].reserve(n);
+  }
+
+  // Catmull-Rom tangents, for Cubic tracks given without any
+  void auto_tangents();
+};
+
+struct Vec3Track : KeyTrack<3> {
+  void add_key(double time, const Vec3& v);
+  void add_key(double time, const Vec3& v, const Vec3& in_tangent, const Vec3& out_tangent);
+  Vec3 key(size_t i) const { return {values[0][i], values[1][i], values[2][i]}; }
+};
+
+// Unit quaternions, (x, y, z, w)
+struct QuatTrack : KeyTrack<4> {
+  void add_key(double time, const Quat& q);
+  void add_key(double time, const Quat& q, const Quat& in_tangent, const Quat& out_tangent);
+  Quat key(size_t i) const { return {values[0][i], values[1][i], values[2][i], values[3][i]}; }
+};
+
+/*
+ * Index k of the key segment [times[k], times[k + 1]) containing `time`, clamped to the first
+ * and last key. `cursor` holds the result of the previous search on the same track: forward
+ * playback moves it by a key or so per call, which makes the search amortized O(1); going
+ * backward (e.g. a looping clip wrapping around) falls back to a binary search.
+ */
+std::uint32_t find_key(const std::vector<float>& times, float time, std::uint32_t& cursor);
+
+// Value of a non-empty track at `time`; rotations are renormalized
+Vec3 sample(const Vec3Track& track, float time, std::uint32_t& cursor);
+Quat sample(const QuatTrack& track, float time, std::uint32_t& cursor);
+
+// Local transform tracks of one target. An empty track leaves that component as it was when the
+// channel was bound.
+struct AnimationChannel {
+  Name target; // name of the scene graph node (or model) to animate
+  Vec3Track translation;
+  QuatTrack rotation;
+  Vec3Track scale;
+};
+
+struct AnimationClip {
+  Name name;
+  double duration = 0; // seconds
+  std::vector<AnimationChannel> channels;
+
+  AnimationChannel& add_channel(const Name& target) {
+    channels.push_back({target, {}, {}, {}});
+    return channels.back();
+  }
+  // Index of the channel animating `target`, or SIZE_MAX
+  size_t find_channel(const Name& target) const;
+  // Set duration to the time of the last key
+  void fit_duration();
+};
+
+using AnimationClipPtr = std::shared_ptr<AnimationClip>;
+
+/*
+ * Plays clips on models and scene graph nodes. Bindings (a clip channel and its target) are
+ * kept as SoA arrays with one key cursor per track, and sampled in parallel by apply().
+ *
+ * Models bound directly have their transform written straight into the ModelStore column, then
+ * stamped as changed in one batch, so consumers of the store see only the animated models. Nodes
+ * get their local transform through SceneGraph::set_local; the next graph update propagates it to
+ * the subtree and the models bound there.
+ *
+ * A target should be bound at most once at a time.
+ */
+class Animator {
+public:
+  using PlaybackId = std::uint32_t;
+
+  Animator() = default;
+
+  // Start playing `clip` from time 0; its channels play nothing until bound
+  PlaybackId play(std::shared_ptr<const AnimationClip> clip, bool loop = true, double speed = 1.0);
+
+  // Bind one channel of a playback. The current transform of the target supplies the components
+  // the channel has no keys for.
+  void bind(PlaybackId playback, size_t channel, const ModelStore& store, ModelHandle model);
+  void bind(PlaybackId playback, size_t channel, const SceneGraph& graph, SceneGraph::NodeId node);
+  // Bind every channel to the graph node of the same name; returns the number of channels bound
+  size_t bind(PlaybackId playback, const SceneGraph& graph);
+
+  // Advance every playback by `seconds`, scaled by its speed
+  void advance(double seconds);
+  void seek(PlaybackId playback, double time) { m_playbacks[playback].time = time; }
+  double time(PlaybackId playback) const { return m_playbacks[playback].time; }
+
+  /*
+   * Sample every binding at the time of its playback and write the result. Bindings of stale
+   * model handles are skipped, and so are node bindings without a graph. Returns the number of
+   * targets written.
+   */
+  size_t apply(ModelStore& store, SceneGraph* graph = nullptr);
+  // Also updates the transforms of the scene (graph and spatial index) after writing
+  size_t apply(Scene& scene);
+
+  size_t playback_count() const { return m_playbacks.size(); }
+  size_t binding_count() const { return m_channels.size(); }
+  void clear();
+
+private:
+  struct Playback {
+    std::shared_ptr<const AnimationClip> clip;
+    double time;
+    double speed;
+    bool loop;
+  };
+  // Translation, rotation and scale cursors of a binding
+  struct Cursors {
+    std::uint32_t t = 0, r = 0, s = 0;
+  };
+
+  std::vector<Playback> m_playbacks;
+
+  // Bindings, SoA; node is k_invalid_node for a model binding, model is null for a node binding
+  std::vector<PlaybackId> m_playback;
+  std::vector<const AnimationChannel*> m_channels;
+  std::vector<ModelHandle> m_models;
+  std::vector<SceneGraph::NodeId> m_nodes;
+  std::vector<Trs> m_rest;
+  std::vector<Cursors> m_cursors;
+
+  // Scratch, reused across apply()
+  std::vector<float> m_clip_times; // per playback
+  std::vector<Mat4> m_samples;
+  std::vector<ModelHandle> m_written;
+
+  void add_binding(PlaybackId playback, size_t channel, ModelHandle model,
+    SceneGraph::NodeId node, const Mat4& rest);
+};
+
+} // namespace rei
+
+#endif
@@ -0,0 +1,184 @@
+// source of ao_baker.h
+#include "ao_baker.h"
+
+#include <cmath>
+
+#include "debug.h"
+#include "geometry.h"
+#include "parallel.h"
+#include "rmath.h"
+
+using std::uint32_t;
+using std::uint64_t;
+using std::vector;
+
+namespace rei {
+
+namespace {
+
+inline uint32_t hash_u32(uint32_t x) {
+  // lowbias32, https://nullprogram.com/blog/2018/07/31/
+  x ^= x >> 16;
+  x *= 0x7feb352dU;
+  x ^= x >> 15;
+  x *= 0x846ca68bU;
+  x ^= x >> 16;
+  return x;
+}
+
+inline double frac(double x) {
+  return x - std::floor(x);
+}
+
+// Sample k of the R2 sequence, rotated by a per-vertex offset (Cranley-Patterson)
+inline void sample_2d(uint32_t k, uint32_t vertex_hash, double& u1, double& u2) {
+  const double a1 = 0.7548776662466927, a2 = 0.5698402909980532;
+  const double r1 = (vertex_hash & 0xFFFF) / 65536.0;
+  const double r2 = (vertex_hash >> 16) / 65536.0;
+  u1 = frac(0.5 + a1 * k + r1);
+  u2 = frac(0.5 + a2 * k + r2);
+}
+
+// Orthonormal basis around n (Duff et al. 2017)
+inline void make_basis(const Vec3& n, Vec3& t, Vec3& b) {
+  const double sign = std::copysign(1.0, n.z);
+  const double a = -1.0 / (sign + n.z);
+  const double c = n.x * n.y * a;
+  t = Vec3(1.0 + sign * n.x * n.x * a, sign * c, -sign * n.x);
+  b = Vec3(c, sign + n.y * n.y * a, -n.y);
+}
+
+} // namespace
+
+AmbientOcclusionBaker::AmbientOcclusionBaker(const Scene& scene) {
+  vector<uint32_t> indices;
+  m_vertex_offset.push_back(0);
+  for (const ModelPtr& model : scene.get_models()) {
+    const Mesh* mesh = dynamic_cast<const Mesh*>(model->get_geometry().get());
+    if (!mesh || mesh->empty()) continue;
+
+    const Mat4 trans = model->get_transform();
+    const Mat3 normal_trans = trans.adj3(); // inverse-transpose up to scale
+    const uint32_t base = uint32_t(m_positions.size());
+    for (const Mesh::Vertex& v : mesh->get_vertices()) {
+      m_positions.push_back(Vec3(trans * v.coord));
+      Vec3 n = normal_trans * v.normal;
+      m_normals.push_back(n.zero() ? Vec3(0, 0, 1) : n.normalized());
+    }
+    for (const Mesh::Triangle& t : mesh->get_triangles()) {
+      indices.push_back(base + uint32_t(t.a));
+      indices.push_back(base + uint32_t(t.b));
+      indices.push_back(base + uint32_t(t.c));
+    }
+    m_models.push_back(model);
+    m_vertex_offset.push_back(m_positions.size());
+  }
+  m_bvh.build(vector<Vec3>(m_positions), std::move(indices));
+}
+
+AmbientOcclusionBaker::~AmbientOcclusionBaker() {
+  stop_progressive();
+}
+
+void AmbientOcclusionBaker::trace(const AoBakeOptions& options, int first, int count,
+  uint32_t* unoccluded, ThreadPool& pool) const {
+  parallel_for(pool, 0, m_positions.size(), 64, [&](size_t v) {
+    const Vec3& n = m_normals[v];
+    const Vec3 origin = m_positions[v] + n * options.bias;
+    Vec3 t, b;
+    make_basis(n, t, b);
+    const uint32_t vertex_hash = hash_u32(uint32_t(v) ^ hash_u32(options.seed));
+    uint32_t hits = 0;
+    for (int k = first; k < first + count; k++) {
+      double u1, u2;
+      sample_2d(uint32_t(k), vertex_hash, u1, u2);
+      // cosine-weighted hemisphere
+      const double phi = 2.0 * pi * u1;
+      const double r = std::sqrt(u2);
+      const Vec3 dir = t * (r * std::cos(phi)) + b * (r * std::sin(phi)) + n * std::sqrt(1.0 - u2);
+      if (!m_bvh.occluded(origin, dir, options.max_distance)) hits++;
+    }
+    unoccluded[v] += hits;
+  });
+}
+
+vector<AmbientOcclusionBaker::AoStream> AmbientOcclusionBaker::split(
+  const vector<float>& flat) const {
+  vector<AoStream> ret(m_models.size());
+  for (size_t m = 0; m < m_models.size(); m++) {
+    ret[m].assign(flat.begin() + m_vertex_offset[m], flat.begin() + m_vertex_offset[m + 1]);
+  }
+  return ret;
+}
+
+vector<AmbientOcclusionBaker::AoStream> AmbientOcclusionBaker::bake(
+  const AoBakeOptions& options, ThreadPool& pool) const {
+  REI_ASSERT(options.sample_num > 0);
+  vector<uint32_t> unoccluded(m_positions.size(), 0);
+  trace(options, 0, options.sample_num, unoccluded.data(), pool);
+  vector<float> flat(m_positions.size());
+  for (size_t v = 0; v < flat.size(); v++)
+    flat[v] = float(unoccluded[v]) / options.sample_num;
+  return split(flat);
+}
+
+void AmbientOcclusionBaker::start_progressive(const AoBakeOptions& options, int samples_per_pass) {
+  stop_progressive();
+  REI_ASSERT(samples_per_pass > 0);
+  m_stop = false;
+  m_finished = false;
+  m_published_samples = 0;
+  m_worker = std::thread([this, options, samples_per_pass] {
+    vector<uint32_t> unoccluded(m_positions.size(), 0);
+    vector<float> flat(m_positions.size());
+    int done = 0;
+    while (done < options.sample_num && !m_stop.load()) {
+      int count = (std::min)(samples_per_pass, options.sample_num - done);
+      trace(options, done, count, unoccluded.data(), global_thread_pool());
+      done += count;
+      for (size_t v = 0; v < flat.size(); v++)
+        flat[v] = float(unoccluded[v]) / done;
+      {
+        std::lock_guard<std::mutex> lock(m_publish_mutex);
+        m_published.swap(flat);
+        m_published_samples = done;
+        m_version++;
+      }
+      flat.resize(m_positions.size());
+    }
+    m_finished = done >= options.sample_num;
+  });
+}
+
+void AmbientOcclusionBaker::stop_progressive() {
+  m_stop = true;
+  if (m_worker.joinable()) m_worker.join();
+}
+
+uint64_t AmbientOcclusionBaker::fetch_progressive(vector<AoStream>& ao) const {
+  std::lock_guard<std::mutex> lock(m_publish_mutex);
+  uint64_t version = m_version.load();
+  if (m_published.empty()) return 0;
+  ao = split(m_published);
+  return version;
+}
+
+void AmbientOcclusionBaker::write_vertex_colors(
+  const vector<ModelPtr>& models, const vector<AoStream>& ao) {
+  REI_ASSERT(models.size() == ao.size());
+  Hashmap<const Geometry*, int> users;
+  for (const ModelPtr& model : models)
+    users[model->get_geometry().get()]++;
+
+  for (size_t m = 0; m < models.size(); m++) {
+    Mesh* mesh = dynamic_cast<Mesh*>(models[m]->get_geometry().get());
+    if (!mesh) continue;
+    if (users[mesh] > 1) {
+      REI_WARNING("Mesh is shared by several models; skipped writing AO into vertex colors");
+      continue;
+    }
+    mesh->set_vertex_occlusion(ao[m]);
+  }
+}
+
+} // namespace rei
@@ -0,0 +1,93 @@
+#ifndef REI_AO_BAKER_H
+#define REI_AO_BAKER_H
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "algebra.h"
+#include "bvh.h"
+#include "parallel.h"
+#include "scene.h"
+#include "type_utils.h"
+
+/*
+ * ao_baker.h
+ * Per-vertex ambient occlusion baking against a whole scene, on the CPU.
+ */
+
+namespace rei {
+
+struct AoBakeOptions {
+  int sample_num = 64;       // rays per vertex
+  double max_distance = 1.0; // occluders farther than this are ignored
+  double bias = 1e-3;        // ray origin offset along the vertex normal
+  std::uint32_t seed = 0;
+};
+
+/*
+ * Builds its own BVH over the world-space triangles of all mesh models at construction; the
+ * scene must stay static while baking. Sampling is deterministic: sample k of a vertex is fixed
+ * by (seed, vertex, k), so results do not depend on thread count or on how many progressive
+ * passes were used to reach a sample count.
+ */
+class AmbientOcclusionBaker : NoCopy {
+public:
+  // Per-vertex AO of one model; 1 is fully unoccluded
+  using AoStream = std::vector<float>;
+
+  explicit AmbientOcclusionBaker(const Scene& scene);
+  ~AmbientOcclusionBaker();
+
+  // Models being baked; result streams are in the same order
+  const std::vector<ModelPtr>& models() const { return m_models; }
+
+  // Blocking bake, multi-threaded
+  std::vector<AoStream> bake(const AoBakeOptions& options, ThreadPool& pool) const;
+  std::vector<AoStream> bake(const AoBakeOptions& options) const {
+    return bake(options, global_thread_pool());
+  }
+
+  // Progressive bake on a background thread, `samples_per_pass` rays per vertex per pass.
+  // Results after each pass can be fetched while the app keeps running.
+  void start_progressive(const AoBakeOptions& options, int samples_per_pass = 4);
+  void stop_progressive();
+  bool progressive_finished() const { return m_finished.load(); }
+  int progressive_samples() const { return m_published_samples.load(); }
+  // Copy the latest published result; returns its version (0 if nothing published yet)
+  std::uint64_t fetch_progressive(std::vector<AoStream>& ao) const;
+  std::uint64_t progressive_version() const { return m_version.load(); }
+
+  // Multiply AO into vertex colors (see Mesh::set_vertex_occlusion; writing again replaces the
+  // previous AO). Meshes shared by several models are skipped with a warning, since each
+  // instance has its own occlusion; use the streams for those.
+  static void write_vertex_colors(
+    const std::vector<ModelPtr>& models, const std::vector<AoStream>& ao);
+
+private:
+  std::vector<ModelPtr> m_models;
+  std::vector<size_t> m_vertex_offset; // per model, into the flat arrays below; size + 1
+  std::vector<Vec3> m_positions;       // world space
+  std::vector<Vec3> m_normals;         // world space, normalized
+  TriangleBVH m_bvh;
+
+  // Progressive state
+  std::thread m_worker;
+  std::atomic<bool> m_stop {false};
+  std::atomic<bool> m_finished {false};
+  std::atomic<int> m_published_samples {0};
+  std::atomic<std::uint64_t> m_version {0};
+  mutable std::mutex m_publish_mutex;
+  std::vector<float> m_published;
+
+  // Add the number of unoccluded rays of samples [first, first + count) to `unoccluded`
+  void trace(const AoBakeOptions& options, int first, int count, std::uint32_t* unoccluded,
+    ThreadPool& pool) const;
+  std::vector<AoStream> split(const std::vector<float>& flat) const;
+};
+
+} // namespace rei
+
+#endif
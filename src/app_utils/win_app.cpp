@@ -69,6 +69,7 @@ WinApp::~WinApp() {
 void WinApp::initialize_scene() {
   SceneConfig conf {};
   conf.scene = m_scene.get();
+  conf.geometry_upload_budget = config.geometry_upload_budget;
   m_scene_h = m_pipeline->register_scene(conf);
 }
 
@@ -173,11 +174,8 @@ void WinApp::render() {
 void WinApp::on_render() {
   // update camera
   m_pipeline->transform_viewport(m_viewport_h, *m_camera);
-  // update model transform
-  for (ModelPtr& m : m_scene->get_models()) {
-    // TODO may be we need some transform mark-dirty mechanics?
-    m_pipeline->update_model(m_scene_h, *m, m_scene->get_id(m));
-  }
+  // upload what changed in the scene
+  m_pipeline->sync_scene(m_scene_h, *m_scene);
   // render
   m_pipeline->render(m_viewport_h, m_scene_h);
 
@@ -35,6 +35,8 @@ public:
     RenderMode render_mode = RenderMode::RealtimeRaytracing;
     bool default_camera_control_enabled = true;
     bool enable_grid_line = true;
+    // Bytes of new geometry the pipeline uploads per frame; 0 for no limit
+    size_t geometry_upload_budget = 0;
   };
 
   WinApp(Config config);
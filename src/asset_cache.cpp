@@ -0,0 +1,213 @@
+// source of asset_cache.h
+#include "asset_cache.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <random>
+#include <vector>
+
+#include "debug.h"
+#include "mapped_file.h"
+
+namespace fs = std::filesystem;
+using std::string;
+using std::uint64_t;
+
+namespace rei {
+
+namespace {
+
+constexpr uint64_t k_prime1 = 0x9E3779B185EBCA87ull;
+constexpr uint64_t k_prime2 = 0xC2B2AE3D27D4EB4Full;
+constexpr uint64_t k_prime3 = 0x165667B19E3779F9ull;
+constexpr uint64_t k_prime4 = 0x85EBCA77C2B2AE63ull;
+constexpr uint64_t k_prime5 = 0x27D4EB2F165667C5ull;
+
+inline uint64_t rotl(uint64_t x, int r) {
+  return (x << r) | (x >> (64 - r));
+}
+
+inline uint64_t read64(const std::uint8_t* p) {
+  uint64_t v;
+  std::memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+inline std::uint32_t read32(const std::uint8_t* p) {
+  std::uint32_t v;
+  std::memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+inline uint64_t round(uint64_t acc, uint64_t input) {
+  acc += input * k_prime2;
+  return rotl(acc, 31) * k_prime1;
+}
+
+inline uint64_t merge_round(uint64_t acc, uint64_t val) {
+  acc ^= round(0, val);
+  return acc * k_prime1 + k_prime4;
+}
+
+// Entries older than this are left-overs of a writer that crashed
+constexpr auto k_stale_temp_age = std::chrono::hours(1);
+
+} // namespace
+
+uint64_t hash_bytes(const void* data, size_t bytes, uint64_t seed) {
+  const std::uint8_t* p = static_cast<const std::uint8_t*>(data);
+  const std::uint8_t* const end = p + bytes;
+  uint64_t h;
+
+  if (bytes >= 32) {
+    uint64_t v1 = seed + k_prime1 + k_prime2;
+    uint64_t v2 = seed + k_prime2;
+    uint64_t v3 = seed;
+    uint64_t v4 = seed - k_prime1;
+    for (const std::uint8_t* limit = end - 32; p <= limit; p += 32) {
+      v1 = round(v1, read64(p));
+      v2 = round(v2, read64(p + 8));
+      v3 = round(v3, read64(p + 16));
+      v4 = round(v4, read64(p + 24));
+    }
+    h = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+    h = merge_round(h, v1);
+    h = merge_round(h, v2);
+    h = merge_round(h, v3);
+    h = merge_round(h, v4);
+  } else {
+    h = seed + k_prime5;
+  }
+  h += uint64_t(bytes);
+
+  for (; p + 8 <= end; p += 8) {
+    h ^= round(0, read64(p));
+    h = rotl(h, 27) * k_prime1 + k_prime4;
+  }
+  if (p + 4 <= end) {
+    h ^= uint64_t(read32(p)) * k_prime1;
+    h = rotl(h, 23) * k_prime2 + k_prime3;
+    p += 4;
+  }
+  for (; p < end; p++) {
+    h ^= (*p) * k_prime5;
+    h = rotl(h, 11) * k_prime1;
+  }
+
+  h ^= h >> 33;
+  h *= k_prime2;
+  h ^= h >> 29;
+  h *= k_prime3;
+  h ^= h >> 32;
+  return h;
+}
+
+AssetCache::AssetCache(Options options) : m_options(std::move(options)) {
+  std::error_code ec;
+  fs::create_directories(m_options.directory, ec);
+  m_usable = !ec && fs::is_directory(m_options.directory, ec);
+  if (!m_usable) REI_WARNING("AssetCache: cannot use directory " + m_options.directory);
+}
+
+std::shared_ptr<AssetCache> AssetCache::shared_default() {
+  static std::shared_ptr<AssetCache> cache = std::make_shared<AssetCache>(Options());
+  return cache;
+}
+
+uint64_t AssetCache::key(const string& source, uint64_t options) {
+  MappedFile file;
+  if (!file.open(source)) return 0;
+  const uint64_t content = hash_bytes(file.data(), file.size());
+  const uint64_t ret = hash_bytes(&options, sizeof(options), content);
+  return ret ? ret : 1;
+}
+
+string AssetCache::entry_path(uint64_t key) const {
+  char name[32];
+  std::snprintf(name, sizeof(name), "%016llx.cache", static_cast<unsigned long long>(key));
+  return (fs::path(m_options.directory) / name).string();
+}
+
+string AssetCache::find(uint64_t key) {
+  if (!m_usable || key == 0) return string();
+  std::lock_guard<std::mutex> lock(m_mutex);
+  const string path = entry_path(key);
+  std::error_code ec;
+  if (!fs::is_regular_file(path, ec)) return string();
+  // Recency for eviction
+  fs::last_write_time(path, fs::file_time_type::clock::now(), ec);
+  return path;
+}
+
+bool AssetCache::store(uint64_t key, const std::function<bool(const string& path)>& write) {
+  if (!m_usable || key == 0) return false;
+  const string path = entry_path(key);
+
+  // Unique across threads and processes sharing the directory
+  std::random_device device;
+  const uint64_t nonce = (uint64_t(device()) << 32) ^ device()
+                         ^ uint64_t(std::chrono::steady_clock::now().time_since_epoch().count());
+  char suffix[32];
+  std::snprintf(suffix, sizeof(suffix), ".%016llx.tmp", static_cast<unsigned long long>(nonce));
+  const string temp = path + suffix;
+
+  std::error_code ec;
+  if (!write(temp)) {
+    fs::remove(temp, ec);
+    return false;
+  }
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    fs::rename(temp, path, ec);
+  }
+  if (ec) {
+    // e.g. another process holds the same entry open; its content is the same
+    fs::remove(temp, ec);
+    return fs::is_regular_file(path, ec);
+  }
+  evict();
+  return true;
+}
+
+uint64_t AssetCache::evict() {
+  if (!m_usable) return 0;
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  struct Entry {
+    fs::path path;
+    uint64_t bytes;
+    fs::file_time_type time;
+  };
+  std::vector<Entry> entries;
+  uint64_t total = 0;
+  const auto now = fs::file_time_type::clock::now();
+  std::error_code ec;
+  for (fs::directory_iterator it(m_options.directory, ec), end; !ec && it != end;
+       it.increment(ec)) {
+    if (!it->is_regular_file(ec)) continue;
+    const fs::path& path = it->path();
+    const fs::file_time_type time = fs::last_write_time(path, ec);
+    if (ec) continue;
+    if (path.extension() == ".tmp") {
+      if (now - time > k_stale_temp_age) fs::remove(path, ec);
+      continue;
+    }
+    if (path.extension() != ".cache") continue;
+    const uint64_t bytes = fs::file_size(path, ec);
+    if (ec) continue;
+    entries.push_back({path, bytes, time});
+    total += bytes;
+  }
+
+  std::sort(entries.begin(), entries.end(),
+    [](const Entry& a, const Entry& b) { return a.time < b.time; });
+  for (const Entry& entry : entries) {
+    if (total <= m_options.max_bytes) break;
+    if (fs::remove(entry.path, ec) && !ec) total -= entry.bytes;
+  }
+  return total;
+}
+
+} // namespace rei
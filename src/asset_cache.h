@@ -0,0 +1,71 @@
+#ifndef REI_ASSET_CACHE_H
+#define REI_ASSET_CACHE_H
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "type_utils.h"
+
+/*
+ * asset_cache.h
+ * Persistent on-disk cache of converted assets, keyed by the content of their source file.
+ */
+
+namespace rei {
+
+// 64-bit non-cryptographic hash (the XXH64 algorithm); several GB/s, so hashing a source file
+// costs about as much as reading it
+std::uint64_t hash_bytes(const void* data, size_t bytes, std::uint64_t seed = 0);
+
+/*
+ * One file per entry in a cache directory, named by the entry key. Entries are written to a
+ * temporary file first and renamed into place, so a reader (in this or another process) sees
+ * either no entry or a complete one. A hit refreshes the entry's modification time; when the
+ * directory grows past max_bytes, the least recently used entries are deleted.
+ *
+ * The cache does not interpret entries; AssetLoader stores scene archives in it.
+ */
+class AssetCache : NoCopy {
+public:
+  struct Options {
+    std::string directory = "asset_cache";
+    std::uint64_t max_bytes = std::uint64_t(2) << 30;
+  };
+
+  explicit AssetCache(Options options);
+
+  // Shared cache with the default Options, i.e. in "asset_cache" under the current directory,
+  // created on first use. Loaders only use a cache they are given; pass this one to opt in.
+  static std::shared_ptr<AssetCache> shared_default();
+
+  // Key of a source file's bytes combined with `options` (import flags, converter version, ...);
+  // 0 if the file cannot be read
+  static std::uint64_t key(const std::string& source, std::uint64_t options);
+
+  // Path of the entry for `key`, or an empty string on a miss
+  std::string find(std::uint64_t key);
+
+  // Create the entry by calling write(path) on a temporary path, then publish it and evict old
+  // entries. Return false if writing failed; nothing is published then.
+  bool store(std::uint64_t key, const std::function<bool(const std::string& path)>& write);
+
+  // Delete least recently used entries until the directory fits in max_bytes; return the number
+  // of bytes left. Entries still in use (e.g. mapped on Windows) are skipped.
+  std::uint64_t evict();
+
+  const Options& options() const { return m_options; }
+
+private:
+  Options m_options;
+  std::mutex m_mutex;
+  bool m_usable = false;
+
+  std::string entry_path(std::uint64_t key) const;
+};
+
+} // namespace rei
+
+#endif
@@ -1,43 +1,155 @@
 // source of asset_loader.h
 #include "asset_loader.h"
 
-#include <assimp/postprocess.h> // Post processing flags
-#include <assimp/scene.h>       // Output data structure
-#include <assimp/Importer.hpp>  // C++ importer interface
-
+#include <assimp/DefaultIOSystem.h> // File access, recorded for the asset cache
+#include <assimp/postprocess.h>      // Post processing flags
+#include <assimp/scene.h>            // Output data structure
+#include <assimp/Importer.hpp>       // C++ importer interface
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <filesystem>
+#include <limits>
+#include <mutex>
+#include <thread>
+
+#include "aabb.h"
 #include "console.h"
+#include "mesh_import.h"
+#include "mesh_reader.h"
+#include "parallel.h"
+#include "scene_archive.h"
 #include "string_utils.h"
 
 using namespace std;
 
 namespace rei {
 
+// Post-processing asked from assimp; part of the asset cache key
+constexpr unsigned int k_import_flags = aiProcess_Triangulate | // break-down polygons
+                                        aiProcess_JoinIdenticalVertices | // join vertices
+                                        aiProcess_LimitBoneWeights | // 4 bones per vertex
+                                        aiProcess_SortByPType; // FIXME: what is this?
+
+// Used when the file has no camera
+static CameraPtr default_camera() {
+  return make_shared<Camera>(Vec3 {0, 0, 10}, Vec3 {0, 0, -1});
+}
+
+static vector<LightHandle> scene_lights(const Scene& scene) {
+  const LightStore& lights = scene.lights();
+  return vector<LightHandle>(lights.handles(), lights.handles() + lights.size());
+}
+
+// Remembers every path the importer opens or probes, so that files reading others (.mtl,
+// external parts, ...) can be told from self-contained ones
+class RecordingIOSystem : public Assimp::DefaultIOSystem {
+public:
+  bool Exists(const char* file) const override {
+    record(file);
+    return DefaultIOSystem::Exists(file);
+  }
+  Assimp::IOStream* Open(const char* file, const char* mode = "rb") override {
+    record(file);
+    return DefaultIOSystem::Open(file, mode);
+  }
+
+  void clear() {
+    lock_guard<mutex> lock(m_mutex);
+    m_paths.clear();
+  }
+  // True if no file but `source` was asked for since clear()
+  bool only_read(const string& source) const {
+    lock_guard<mutex> lock(m_mutex);
+    error_code ec;
+    const filesystem::path canonical = filesystem::weakly_canonical(source, ec);
+    if (ec) return size_t(count(m_paths.begin(), m_paths.end(), source)) == m_paths.size();
+    for (const string& path : m_paths) {
+      if (path == source) continue;
+      const filesystem::path other = filesystem::weakly_canonical(path, ec);
+      if (ec || other != canonical) return false;
+    }
+    return true;
+  }
+
+private:
+  mutable mutex m_mutex;
+  mutable vector<string> m_paths;
+
+  void record(const char* file) const {
+    lock_guard<mutex> lock(m_mutex);
+    if (find(m_paths.begin(), m_paths.end(), file) == m_paths.end()) m_paths.push_back(file);
+  }
+};
+
 // AssimpLoaderImpl //////////////////////////////////////////////////////////
 // Private Class to this modules. Effectively separates the assimp header
 // dependency from the interface.
 ////
 
+// Node hierarchy and mesh references of the loaded file, before any mesh is converted
+struct WorldLayout {
+  struct Node {
+    SceneGraph::NodeId parent; // index in `nodes`
+    Mat4 local;
+    Mat4 world;
+    Name name;
+  };
+  struct Model {
+    SceneGraph::NodeId node;
+    unsigned int mesh; // aiMesh index
+  };
+  vector<Node> nodes; // parents before children
+  vector<Model> models;
+  vector<Aabb> mesh_bounds; // by aiMesh index, in mesh space
+  vector<Light> lights;      // in world space
+  vector<unsigned int> used_meshes; // aiMesh indices referenced by models, each once
+};
+
 // NOTE: works almost like a namespace :P
 class AssimpLoaderImpl {
 public:
   // Default constructor
-  AssimpLoaderImpl() : importer() {}
+  AssimpLoaderImpl() : importer() {
+    io = new RecordingIOSystem();
+    importer.SetIOHandler(io); // owned by the importer
+  }
 
   // Main Functions //
 
   // Load the aiScene and check things
   int load_file(const string filename);
+  // True if loading `filename` read no other file; only such files are cached
+  bool self_contained(const string& filename) const { return io->only_read(filename); }
 
   // Return meshes
   vector<MeshPtr> load_meshes();
+  vector<MeshInstance> load_instances();
 
   // Return Scene, Camera and lights
   ScenePtr load_scene();
   CameraPtr load_camera();
-  vector<LightPtr> load_lights(); // TODO
+  vector<AnimationClipPtr> load_animations();
+
+  // Pieces of load_scene(), for streaming
+  WorldLayout load_layout();
+  MeshPtr load_mesh(unsigned int mesh_index) const {
+    return make_mesh(*(as->mMeshes[mesh_index]), Mat4::I(), materials_list);
+  }
+  // Add the layout to `scene` with a geometry per aiMesh index; `users` [out, optional] receives
+  // the models created per aiMesh index
+  int instantiate(const WorldLayout& layout, const vector<GeometryPtr>& meshes, Scene& scene,
+    vector<vector<ModelPtr>>* users = nullptr);
+  // Drop the aiScene once everything is converted
+  void free_scene() {
+    importer.FreeScene();
+    as = nullptr;
+  }
 
 private:
   Assimp::Importer importer;
+  RecordingIOSystem* io;
   const aiScene* as; // current loaded aiScene
   vector<Material> materials_list;
 
@@ -45,14 +157,17 @@ private:
 
   tuple<const aiNode*, Mat4> find_node(const aiNode* root, const string& node_name);
 
-  int collect_mesh(const aiNode* node, vector<MeshPtr>& m_models, Mat4 trans);
-  Model load_model(const aiNode& node, Mat4 scene_trans);
+  int collect_mesh(const aiNode* node, vector<pair<unsigned int, Mat4>>& meshes, Mat4 trans);
+  void layout_node(const aiNode& node, SceneGraph::NodeId parent, WorldLayout& layout);
 
   // Utilities
   static Vec3 make_Vec3(const aiVector3D& v);
   static Mat4 make_Mat4(const aiMatrix4x4& aim);
+  static Mat4 make_transform(const aiMatrix4x4& aim);
   static Material make_material(const aiMaterial&);
   static MeshPtr make_mesh(const aiMesh& mesh, const Mat4 trans, const vector<Material>& maters);
+  static void make_skin(const aiMesh& mesh, const Mat4& trans, Mesh& ret);
+  static bool make_light(const aiLight& light, const Mat4& trans, Light& ret);
 };
 
 // Main Interfaces //
@@ -60,11 +175,8 @@ private:
 // Load the file as aiScene
 int AssimpLoaderImpl::load_file(const string filename) {
   // Load as assimp scene
-  this->as = importer.ReadFile(filename,
-    aiProcess_Triangulate |             // break-down polygons
-      aiProcess_JoinIdenticalVertices | // join vertices
-      aiProcess_SortByPType             // FIXME: what is this?
-  );
+  io->clear();
+  this->as = importer.ReadFile(filename, k_import_flags);
   if (as == nullptr) // Read failed
   {
     console << "AssetLoader Error: Read " << filename << " FAILED." << endl;
@@ -99,21 +211,67 @@ int AssimpLoaderImpl::load_file(const string filename) {
 
 // Load all meshes into world-space
 vector<MeshPtr> AssimpLoaderImpl::load_meshes() {
-  // Collect meshes
-  vector<MeshPtr> ret;
-  int read_count = collect_mesh(as->mRootNode, ret, Mat4::I());
+  // Collect meshes, then convert them in parallel
+  vector<pair<unsigned int, Mat4>> meshes;
+  int read_count = collect_mesh(as->mRootNode, meshes, Mat4::I());
+  vector<MeshPtr> ret(meshes.size());
+  parallel_for(0, meshes.size(), 1, [&](size_t i) {
+    ret[i] = make_mesh(*(as->mMeshes[meshes[i].first]), meshes[i].second, materials_list);
+  });
   console << "Loaded meshes : " << read_count << endl;
 
   return ret;
 }
 
+// Load each mesh once in mesh-space, and an instance per node using it
+vector<MeshInstance> AssimpLoaderImpl::load_instances() {
+  WorldLayout layout = load_layout();
+  vector<MeshPtr> meshes(layout.mesh_bounds.size());
+  parallel_for(0, layout.used_meshes.size(), 1, [&](size_t i) {
+    const unsigned int mesh = layout.used_meshes[i];
+    meshes[mesh] = load_mesh(mesh);
+  });
+  vector<MeshInstance> ret;
+  ret.reserve(layout.models.size());
+  for (const WorldLayout::Model& model : layout.models) {
+    const WorldLayout::Node& node = layout.nodes[model.node];
+    ret.push_back({meshes[model.mesh], node.world, node.name});
+  }
+  console << "Loaded instances : " << ret.size() << " of " << layout.used_meshes.size()
+          << " meshes" << endl;
+
+  return ret;
+}
+
 // Load as REI::Scene
 ScenePtr AssimpLoaderImpl::load_scene() {
   const aiNode& root_node = *(as->mRootNode);
   auto ret = make_shared<Scene>(make_wstring(root_node.mName.C_Str()));
 
-  // Load model from each child nodes
-  Mat4 coordinate_trans = make_Mat4(root_node.mTransformation);
+  // Every mesh is converted once, even if several nodes use it; large meshes are also split
+  // into vertex ranges
+  WorldLayout layout = load_layout();
+  vector<GeometryPtr> meshes(layout.mesh_bounds.size());
+  parallel_for(0, layout.used_meshes.size(), 1, [&](size_t i) {
+    const unsigned int mesh = layout.used_meshes[i];
+    meshes[mesh] = load_mesh(mesh);
+  });
+  int model_count = instantiate(layout, meshes, *ret);
+  console << "Loaded models : " << model_count << " (" << ret->graph().size() << " nodes, "
+          << ret->graph().depth() << " levels)" << endl;
+  if (!ret->lights().empty()) console << "Loaded lights : " << ret->lights().size() << endl;
+
+  return ret;
+}
+
+// Collect the node hierarchy; the root transform carries the coordinate conversion
+WorldLayout AssimpLoaderImpl::load_layout() {
+  const aiNode& root_node = *(as->mRootNode);
+  WorldLayout layout;
+  layout.mesh_bounds.resize(as->mNumMeshes);
+  const Mat4 root_trans = make_transform(root_node.mTransformation);
+  layout.nodes.push_back({SceneGraph::k_invalid_node, root_trans, root_trans,
+    make_wstring(root_node.mName.C_Str())});
   for (int i = 0; i < root_node.mNumChildren; ++i) {
     const aiNode& child = *(root_node.mChildren[i]);
     string name {child.mName.C_Str()};
@@ -124,21 +282,64 @@ ScenePtr AssimpLoaderImpl::load_scene() {
       console << "AssetLoader: Skip a Light node in scene";
       console << "(" << child.mNumMeshes << " meshes)" << endl;
     } else {
-      // Load the model without instance-transform
-      auto mi = load_model(child, coordinate_trans);
-      if (mi.get_geometry()) // check if no real mesh loaded
-        ret->add_model(std::move(mi));
+      layout_node(child, 0, layout);
     }
   }
 
-  return ret;
+  // Bounds only read positions, so they are ready long before the meshes
+  vector<bool> used(as->mNumMeshes, false);
+  for (const WorldLayout::Model& model : layout.models) {
+    if (used[model.mesh]) continue;
+    used[model.mesh] = true;
+    layout.used_meshes.push_back(model.mesh);
+    const aiMesh& mesh = *(as->mMeshes[model.mesh]);
+    Aabb& bounds = layout.mesh_bounds[model.mesh];
+    for (unsigned int v = 0; v < mesh.mNumVertices; ++v)
+      bounds.expand(make_Vec3(mesh.mVertices[v]));
+  }
+
+  // A light is placed by the node of the same name
+  for (unsigned int i = 0; i < as->mNumLights; ++i) {
+    const aiLight& light = *(as->mLights[i]);
+    auto node = find_node(as->mRootNode, light.mName.C_Str());
+    if (!get<0>(node))
+      console << "AssetLoader Warning: failed to find the node of light " << light.mName.C_Str()
+              << endl;
+    Light converted;
+    if (make_light(light, get<1>(node), converted)) layout.lights.push_back(converted);
+  }
+  return layout;
+}
+
+int AssimpLoaderImpl::instantiate(const WorldLayout& layout, const vector<GeometryPtr>& meshes,
+  Scene& scene, vector<vector<ModelPtr>>* users) {
+  SceneGraph& graph = scene.graph();
+  vector<SceneGraph::NodeId> ids(layout.nodes.size());
+  for (size_t i = 0; i < layout.nodes.size(); ++i) {
+    const WorldLayout::Node& node = layout.nodes[i];
+    const SceneGraph::NodeId parent
+      = node.parent == SceneGraph::k_invalid_node ? node.parent : ids[node.parent];
+    ids[i] = graph.add_node(parent, node.local, node.name);
+  }
+  for (const Light& light : layout.lights)
+    scene.add_light(light);
+  if (users) users->resize(meshes.size());
+  for (const WorldLayout::Model& model : layout.models) {
+    const GeometryPtr& mesh = meshes[model.mesh];
+    scene.add_model(Mat4::I(), mesh, layout.nodes[model.node].name);
+    const ModelPtr& added = scene.get_models().back();
+    graph.bind(ids[model.node], scene.get_handle(added));
+    if (users) (*users)[model.mesh].push_back(added);
+  }
+  scene.update_transforms();
+  return int(layout.models.size());
 }
 
 CameraPtr AssimpLoaderImpl::load_camera() {
   // Check numbers of camera
   if (as->mNumCameras < 1) {
     console << "AssetLoader Warning: No Camera. Use default." << endl;
-    return make_shared<Camera>(Vec3 {0, 0, 10}, Vec3 {0, 0, -1});
+    return default_camera();
   }
   if (as->mNumCameras > 1)
     console << "AssetLoader Warning: Multiple camera. Use the first." << endl;
@@ -162,6 +363,46 @@ CameraPtr AssimpLoaderImpl::load_camera() {
   return ret;
 }
 
+// Append assimp keys to a track, converting ticks to seconds
+template <typename Key, typename Track, typename Convert>
+static void convert_keys(
+  const Key* keys, unsigned int count, double ticks_per_second, Track& track, Convert convert) {
+  track.reserve(count);
+  for (unsigned int i = 0; i < count; ++i) {
+    const double time = keys[i].mTime / ticks_per_second;
+    // Some exporters repeat a key at the same time; keep the first
+    if (!track.empty() && float(time) <= track.times.back()) continue;
+    track.add_key(time, convert(keys[i].mValue));
+  }
+}
+
+// Assimp keys are meant to be interpolated linearly (rotations with slerp)
+vector<AnimationClipPtr> AssimpLoaderImpl::load_animations() {
+  vector<AnimationClipPtr> ret;
+  for (unsigned int i = 0; i < as->mNumAnimations; ++i) {
+    const aiAnimation& anim = *(as->mAnimations[i]);
+    // Left as 0 when the file does not tell; 25 is what assimp assumes then
+    const double ticks = anim.mTicksPerSecond > 0 ? anim.mTicksPerSecond : 25.0;
+    auto clip = make_shared<AnimationClip>();
+    clip->name = make_wstring(anim.mName.C_Str());
+    clip->duration = anim.mDuration / ticks;
+    for (unsigned int c = 0; c < anim.mNumChannels; ++c) {
+      const aiNodeAnim& node = *(anim.mChannels[c]);
+      AnimationChannel& channel = clip->add_channel(make_wstring(node.mNodeName.C_Str()));
+      convert_keys(node.mPositionKeys, node.mNumPositionKeys, ticks, channel.translation,
+        [](const aiVector3D& v) { return make_Vec3(v); });
+      convert_keys(node.mRotationKeys, node.mNumRotationKeys, ticks, channel.rotation,
+        [](const aiQuaternion& q) { return Quat(q.x, q.y, q.z, q.w).normalized(); });
+      convert_keys(node.mScalingKeys, node.mNumScalingKeys, ticks, channel.scale,
+        [](const aiVector3D& v) { return make_Vec3(v); });
+    }
+    console << "Loaded animation : " << anim.mName.C_Str() << " (" << anim.mNumChannels
+            << " channels, " << clip->duration << "s)" << endl;
+    ret.push_back(std::move(clip));
+  }
+  return ret;
+}
+
 // Big Helpers Functions ////
 
 // Find the node with given name; return the node and accumulated transform.
@@ -186,62 +427,46 @@ tuple<const aiNode*, Mat4> AssimpLoaderImpl::find_node(
   return make_tuple(nullptr, Mat4::I());
 }
 
-// Convert from asMesh to a REI::Mesh, and add to `models` [out]
-int AssimpLoaderImpl::collect_mesh(const aiNode* node, vector<MeshPtr>& m_models, Mat4 trans) {
+// Collect the aiMesh indices under `node`, with their accumulated transform, into `meshes` [out]
+int AssimpLoaderImpl::collect_mesh(
+  const aiNode* node, vector<pair<unsigned int, Mat4>>& meshes, Mat4 trans) {
   int mesh_count = 0;
 
-  // Add the mesh to `models`, with accumulated transform
+  // Add the mesh to `meshes`, with accumulated transform
   trans = make_Mat4(node->mTransformation) * trans;
   for (int i = 0; i < node->mNumMeshes; ++i) {
-    // Convert the aiMesh stored in aiScene
-    unsigned int mesh_ind = node->mMeshes[i];
-
-    m_models.push_back(make_mesh(*(as->mMeshes[mesh_ind]), trans, materials_list));
+    meshes.emplace_back(node->mMeshes[i], trans);
     ++mesh_count;
   }
 
   // Continue to collect the child if any
   for (int i = 0; i < node->mNumChildren; ++i)
-    mesh_count += collect_mesh(node->mChildren[i], m_models, trans);
+    mesh_count += collect_mesh(node->mChildren[i], meshes, trans);
 
   return mesh_count;
 }
 
-Model AssimpLoaderImpl::load_model(const aiNode& node, Mat4 coordinate_trans) {
-  // Correct the world-transfor to fit in right-hand coordinate_trans
-  Mat4 old_W = make_Mat4(node.mTransformation);
-  Mat4 W = coordinate_trans.inv() * old_W * coordinate_trans;
-
-  MeshPtr mesh = nullptr;
-
-  // Build Hiearchy model
-  if (node.mNumChildren > 0) {
-    // TODO : make Hiearchy
-    console << "AssetLoader Warnning: need hiearachy";
-    console << "(name = " << node.mName.C_Str() << "chile = " << node.mNumChildren << ")" << endl;
-    return Model {L"empty", W, nullptr, nullptr};
-  }
-
-  // Build Non Hiearchy model
-  if (node.mNumMeshes < 1) // Nothing here
-  {
-    console << "AssetLoader Warnning: empty node";
-    console << "(name = " << node.mName.C_Str() << ")" << endl;
-  } else if (node.mNumMeshes == 1) // Mesh
-  {
-    // Make a mesh fron aiMesh
-    REI_NOT_IMPLEMENTED
-    mesh = make_mesh(*(as->mMeshes[node.mMeshes[0]]), coordinate_trans, this->materials_list);
-    console << "AssetLoader: loaded node name = " << node.mName.C_Str() << ")" << endl;
-  } else // Mesh aggrerate
-  {
-    // TODO
-    console << "AssetLoader Warnning: need aggregate";
-    console << "(name = " << node.mName.C_Str() << ", meshnum = " << node.mNumMeshes << ")" << endl;
+// Add the node and its subtree to the layout, with a model bound to every mesh.
+void AssimpLoaderImpl::layout_node(
+  const aiNode& node, SceneGraph::NodeId parent, WorldLayout& layout) {
+  const Name name = make_wstring(node.mName.C_Str());
+  const Mat4 local = make_transform(node.mTransformation);
+  const SceneGraph::NodeId id = SceneGraph::NodeId(layout.nodes.size());
+  layout.nodes.push_back({parent, local, layout.nodes[parent].world * local, name});
+
+  // Meshes are kept in node space; the first one is bound to the node, others to identity
+  // child nodes (a node binds one model)
+  for (unsigned int i = 0; i < node.mNumMeshes; ++i) {
+    SceneGraph::NodeId mesh_node = id;
+    if (i > 0) {
+      mesh_node = SceneGraph::NodeId(layout.nodes.size());
+      layout.nodes.push_back({id, Mat4::I(), layout.nodes[id].world, name});
+    }
+    layout.models.push_back({mesh_node, node.mMeshes[i]});
   }
 
-  // Return an instance
-  return Model {L"assimp no name", W, mesh, nullptr};
+  for (unsigned int i = 0; i < node.mNumChildren; ++i)
+    layout_node(*(node.mChildren[i]), id, layout);
 }
 
 // Utilities ////
@@ -259,6 +484,11 @@ inline Mat4 AssimpLoaderImpl::make_Mat4(const aiMatrix4x4& aim) {
     aim.c3, aim.d3, aim.a4, aim.b4, aim.c4, aim.d4);
 }
 
+// make_Mat4 is for row vectors (as make_mesh bakes it); the scene graph transforms column vectors
+inline Mat4 AssimpLoaderImpl::make_transform(const aiMatrix4x4& aim) {
+  return make_Mat4(aim).T();
+}
+
 // Convert all aiMaterial to Mesh::Material
 Material AssimpLoaderImpl::make_material(const aiMaterial& mater) {
   Material ret;
@@ -304,75 +534,521 @@ MeshPtr AssimpLoaderImpl::make_mesh(
     console << "AssetLoader Warning: mesh has multiple color sets" << endl;
 
   // Create the mesh with node name
-  MeshPtr ret = make_shared<Mesh>(string(mesh.mName.C_Str()));
-
-  // Convert all vertex (with coordinates, normals, and colors)
-  vector<Mesh::Vertex> va;
-  Mat3 trans_normal = trans.adj3();
-  for (int i = 0; i < mesh.mNumVertices; ++i) {
-    // Coordinates & Normal (store in world-space)
-    const aiVector3D& v = mesh.mVertices[i];
-    const aiVector3D& n = mesh.mNormals[i]; // NOTE: pertain scaling !
-    Vec4 coord = Vec4(v.x, v.y, v.z, 1.0) * trans;
-    Vec3 normal = (Vec3(n.x, n.y, n.z) * trans_normal).normalized();
-
-    // Color
-    // NOTE: the mesh may containt multiple color set
-    const int color_set = 0;
-    Color color;
-    if (mesh.HasVertexColors(color_set)) {
-      const aiColor4D& c = mesh.mColors[color_set][i];
-      color = Color(c.r, c.g, c.b, c.a);
-    } else {
-      color = Color {0.5f, 0.5f, 0.5f, 1.0f};
-    }
-
-    // Push to vertex array
-    va.push_back(Mesh::Vertex(coord, normal, color));
-
-  } // end for all vertex
+  MeshPtr ret = make_shared<Mesh>(make_wstring(mesh.mName.C_Str()));
+
+  // Convert all vertex (with coordinates, normals, and colors), in world-space
+  // NOTE: the mesh may containt multiple color set; the first one is used
+  const int color_set = 0;
+  MeshStreams streams;
+  streams.positions = reinterpret_cast<const float*>(mesh.mVertices);
+  streams.normals = reinterpret_cast<const float*>(mesh.mNormals); // NOTE: pertain scaling !
+  if (mesh.HasVertexColors(color_set))
+    streams.colors = reinterpret_cast<const float*>(mesh.mColors[color_set]);
+  streams.vertex_num = mesh.mNumVertices;
+  vector<Mesh::Vertex> va = convert_vertices(streams, trans);
 
   // Encode all triangle (face) as vertex index
   using Triangle = typename Mesh::Triangle;
-  vector<Mesh::Triangle> ta;
-  for (int i = 0; i < mesh.mNumFaces; ++i) {
+  vector<Mesh::Triangle> ta(mesh.mNumFaces);
+  parallel_for(0, mesh.mNumFaces, 16384, [&](size_t i) {
     const aiFace& face = mesh.mFaces[i];
     assert(face.mNumIndices == 3);
-    Triangle it {face.mIndices[0], face.mIndices[1], face.mIndices[2]};
-    ta.push_back(it);
-  }
+    ta[i] = Triangle {face.mIndices[0], face.mIndices[1], face.mIndices[2]};
+  });
 
   // Set the data and material, then done
   ret->set(std::move(va), std::move(ta));
+  if (mesh.HasBones()) make_skin(mesh, trans, *ret);
   REI_NOT_IMPLEMENTED
   // ret->set(mat_list[mesh.mMaterialIndex]); // fix model and mesh and material stuffs
   return ret;
 
 } // end make_mesh
 
+// Bones and the 4 strongest influences of every vertex, renormalized
+void AssimpLoaderImpl::make_skin(const aiMesh& mesh, const Mat4& trans, Mesh& ret) {
+  // Offsets map mesh space to bone space; vertices baked by `trans` (a row-vector transform)
+  // need its inverse first
+  const Mat4 unbake = trans.T().inv();
+  vector<Mesh::Bone> bones(mesh.mNumBones);
+  vector<Mesh::BoneWeights> weights(mesh.mNumVertices, Mesh::BoneWeights {});
+  for (unsigned int b = 0; b < mesh.mNumBones; ++b) {
+    const aiBone& bone = *(mesh.mBones[b]);
+    bones[b].name = make_wstring(bone.mName.C_Str());
+    bones[b].offset = make_transform(bone.mOffsetMatrix) * unbake;
+    for (unsigned int i = 0; i < bone.mNumWeights; ++i) {
+      const aiVertexWeight& vw = bone.mWeights[i];
+      Mesh::BoneWeights& w = weights[vw.mVertexId];
+      int slot = 0; // the weakest slot
+      for (int k = 1; k < 4; ++k)
+        if (w.weights[k] < w.weights[slot]) slot = k;
+      if (vw.mWeight <= w.weights[slot]) continue;
+      w.bones[slot] = uint16_t(b);
+      w.weights[slot] = vw.mWeight;
+    }
+  }
+  for (Mesh::BoneWeights& w : weights) {
+    const float sum = w.weights[0] + w.weights[1] + w.weights[2] + w.weights[3];
+    if (sum <= 0) {
+      console << "AssetLoader Warning: vertex without bone weight in " << mesh.mName.C_Str()
+              << endl;
+      w.weights[0] = 1.f; // follow the first bone
+      continue;
+    }
+    for (int k = 0; k < 4; ++k)
+      w.weights[k] /= sum;
+  }
+  ret.set_skin(std::move(bones), std::move(weights));
+}
+
+// Convert a light placed by `trans` (row-vector convention, as from find_node); false for kinds
+// without a counterpart
+bool AssimpLoaderImpl::make_light(const aiLight& light, const Mat4& trans, Light& ret) {
+  ret.name = make_wstring(light.mName.C_Str());
+  ret.position = Vec4(make_Vec3(light.mPosition), 1.0) * trans;
+  ret.direction = (make_Vec3(light.mDirection) * trans.sub3()).normalized();
+  // Exporters fold the intensity into the color
+  const aiColor3D& c = light.mColorDiffuse;
+  const float intensity = (std::max)({c.r, c.g, c.b});
+  ret.intensity = intensity;
+  if (intensity > 0) ret.color = Color(c.r / intensity, c.g / intensity, c.b / intensity);
+
+  switch (light.mType) {
+    case aiLightSource_POINT:
+      ret.type = LightType::Point;
+      break;
+    case aiLightSource_SPOT:
+      ret.type = LightType::Spot;
+      ret.outer_angle = (std::min)(double(light.mAngleOuterCone), pi / 2);
+      ret.inner_angle = (std::min)(double(light.mAngleInnerCone), ret.outer_angle);
+      break;
+    case aiLightSource_DIRECTIONAL:
+      ret.type = LightType::Directional;
+      break;
+    case aiLightSource_AREA: {
+      // Rectangles become spheres of the same area, or tubes when long and thin
+      const double w = light.mSize.x, h = light.mSize.y;
+      if ((std::max)(w, h) > 2 * (std::min)(w, h)) {
+        const Vec3 up = make_Vec3(light.mUp) * trans.sub3();
+        ret.type = LightType::Tube;
+        ret.radius = (std::min)(w, h) / 2;
+        ret.length = (std::max)(w, h);
+        ret.direction = (h > w ? up : cross(ret.direction, up)).normalized();
+      } else {
+        ret.type = LightType::Sphere;
+        ret.radius = std::sqrt(w * h / pi);
+      }
+      break;
+    }
+    default:
+      console << "AssetLoader Warning: skip light " << light.mName.C_Str()
+              << " of unsupported type " << int(light.mType) << endl;
+      return false;
+  }
+  return true;
+}
+
+// WorldStreamImpl /////////////////////////////////////////////////////////
+// The loader thread parses the file and schedules mesh conversion; the owner of the scene
+// takes converted meshes through apply().
+////
+
+class WorldStreamImpl {
+public:
+  WorldStreamImpl(const string& filename, const Camera* focus);
+  ~WorldStreamImpl() {
+    m_cancelled = true;
+    if (m_thread.joinable()) m_thread.join();
+  }
+
+  bool parsed() const {
+    lock_guard<mutex> lock(m_mutex);
+    return m_parsed;
+  }
+  bool failed() const {
+    lock_guard<mutex> lock(m_mutex);
+    return m_failed;
+  }
+  void set_focus(const Vec3& position) {
+    lock_guard<mutex> lock(m_mutex);
+    m_focus = position;
+    m_has_focus = true;
+  }
+  CameraPtr camera() const {
+    lock_guard<mutex> lock(m_mutex);
+    return m_camera;
+  }
+  size_t mesh_count() const {
+    lock_guard<mutex> lock(m_mutex);
+    return m_layout.used_meshes.size();
+  }
+  size_t applied_count() const { return m_applied; }
+  shared_future<bool> finished() const { return m_finished_future; }
+
+  size_t apply(Scene& scene, size_t max_meshes);
+
+private:
+  AssimpLoaderImpl m_loader;
+  std::thread m_thread;
+  atomic<bool> m_cancelled {false};
+  promise<bool> m_finished;
+  shared_future<bool> m_finished_future;
+
+  // Shared with the loader thread; the layout and camera are written once, before m_parsed
+  mutable mutex m_mutex;
+  bool m_parsed = false;
+  bool m_failed = false;
+  WorldLayout m_layout;
+  CameraPtr m_camera;
+  Vec3 m_focus;
+  bool m_has_focus = false;
+  deque<pair<unsigned int, MeshPtr>> m_arrived;
+
+  // Owner thread only
+  bool m_instantiated = false;
+  vector<GeometryPtr> m_placeholders; // by aiMesh index
+  vector<vector<ModelPtr>> m_users;
+  size_t m_applied = 0;
+
+  void run(const string& filename);
+};
+
+WorldStreamImpl::WorldStreamImpl(const string& filename, const Camera* focus) {
+  if (focus) set_focus(focus->position());
+  m_finished_future = m_finished.get_future().share();
+  m_thread = std::thread([this, filename]() { run(filename); });
+}
+
+void WorldStreamImpl::run(const string& filename) {
+  if (m_loader.load_file(filename) != 0) {
+    lock_guard<mutex> lock(m_mutex);
+    m_parsed = m_failed = true;
+    m_finished.set_value(false);
+    return;
+  }
+  WorldLayout layout = m_loader.load_layout();
+  CameraPtr camera = m_loader.load_camera();
+  vector<Aabb> model_bounds; // world space, for priorities
+  model_bounds.reserve(layout.models.size());
+  for (const WorldLayout::Model& model : layout.models)
+    model_bounds.push_back(
+      layout.mesh_bounds[model.mesh].transformed(layout.nodes[model.node].world));
+  vector<unsigned int> remaining = layout.used_meshes;
+  {
+    lock_guard<mutex> lock(m_mutex);
+    m_layout = layout;
+    m_camera = camera;
+    if (!m_has_focus) m_focus = camera->position();
+    m_parsed = true;
+  }
+
+  // Convert in waves of a few meshes per thread, the nearest (to the focus at the start of the
+  // wave) first. A mesh used by several models is as near as its nearest model.
+  const size_t wave = global_thread_pool().concurrency() * 2;
+  vector<double> distance2(layout.mesh_bounds.size());
+  vector<MeshPtr> converted;
+  while (!remaining.empty() && !m_cancelled) {
+    Vec3 focus;
+    {
+      lock_guard<mutex> lock(m_mutex);
+      focus = m_focus;
+    }
+    for (unsigned int mesh : remaining)
+      distance2[mesh] = (numeric_limits<double>::max)();
+    for (size_t i = 0; i < layout.models.size(); ++i) {
+      double& d = distance2[layout.models[i].mesh];
+      d = (std::min)(d, model_bounds[i].distance2(focus));
+    }
+    const size_t count = (std::min)(wave, remaining.size());
+    auto nearer = [&](unsigned int a, unsigned int b) { return distance2[a] < distance2[b]; };
+    nth_element(remaining.begin(), remaining.begin() + count - 1, remaining.end(), nearer);
+    sort(remaining.begin(), remaining.begin() + count, nearer);
+
+    converted.assign(count, nullptr);
+    parallel_for(0, count, 1, [&](size_t i) { converted[i] = m_loader.load_mesh(remaining[i]); });
+    {
+      lock_guard<mutex> lock(m_mutex);
+      for (size_t i = 0; i < count; ++i)
+        m_arrived.emplace_back(remaining[i], std::move(converted[i]));
+    }
+    remaining.erase(remaining.begin(), remaining.begin() + count);
+  }
+
+  m_loader.free_scene();
+  m_finished.set_value(remaining.empty());
+}
+
+size_t WorldStreamImpl::apply(Scene& scene, size_t max_meshes) {
+  vector<pair<unsigned int, MeshPtr>> arrived;
+  {
+    lock_guard<mutex> lock(m_mutex);
+    if (!m_parsed || m_failed) return 0;
+    const size_t count = (std::min)(max_meshes, m_arrived.size());
+    arrived.assign(make_move_iterator(m_arrived.begin()),
+      make_move_iterator(m_arrived.begin() + count));
+    m_arrived.erase(m_arrived.begin(), m_arrived.begin() + count);
+  }
+
+  // Everything becomes visible at once, as placeholders
+  if (!m_instantiated) {
+    m_placeholders.resize(m_layout.mesh_bounds.size());
+    for (unsigned int mesh : m_layout.used_meshes) {
+      const Aabb& bounds = m_layout.mesh_bounds[mesh];
+      m_placeholders[mesh] = make_shared<PendingGeometry>(L"pending", bounds.min, bounds.max);
+    }
+    int model_count = m_loader.instantiate(m_layout, m_placeholders, scene, &m_users);
+    console << "Streaming models : " << model_count << " (" << m_layout.used_meshes.size()
+            << " meshes)" << endl;
+    m_instantiated = true;
+  }
+
+  size_t model_count = 0;
+  for (auto& mesh : arrived) {
+    for (const ModelPtr& model : m_users[mesh.first]) {
+      // The application may have removed it meanwhile
+      if (scene.get_model(model->handle()) != model) continue;
+      scene.set_geometry(model, mesh.second);
+      model_count++;
+    }
+    scene.drop_geometry(m_placeholders[mesh.first]);
+    m_placeholders[mesh.first] = nullptr;
+    m_users[mesh.first].clear();
+  }
+  m_applied += arrived.size();
+  return model_count;
+}
+
+// Asset cache ///////////////////////////////////////////////////////////////
+// Converted files are kept as scene archives; see asset_cache.h
+////
+
+// Bump when the conversion changes its output, so that older entries are missed. Version 2 no
+// longer stores files reading other files, whose entries went stale with those files.
+constexpr std::uint64_t k_converter_version = 2;
+
+enum class CachedAs : std::uint64_t {
+  Meshes = 1, // world-space meshes, one model each
+  World = 2,
+  Instances = 3, // mesh-space meshes, one model per instance
+};
+
+static std::uint64_t cache_options(CachedAs kind) {
+  const std::uint64_t fields[]
+    = {k_import_flags, k_converter_version, archive::k_format_version, std::uint64_t(kind)};
+  return hash_bytes(fields, sizeof(fields));
+}
+
+// The key only covers the file itself, so only self-contained files are stored
+static bool cacheable(const AssimpLoaderImpl& impl, const string& filename) {
+  if (impl.self_contained(filename)) return true;
+  console << "AssetLoader: " << filename << " reads other files; not cached." << endl;
+  return false;
+}
+
+static std::shared_ptr<const SceneArchive> open_cached(AssetCache* cache, std::uint64_t key) {
+  if (!cache || !key) return nullptr;
+  const string path = cache->find(key);
+  return path.empty() ? nullptr : SceneArchive::open(path);
+}
+
+// Meshes in the archive, back in Mesh layout
+static vector<MeshPtr> load_archived_meshes(const SceneArchive& cached) {
+  using namespace archive;
+  const MeshRecord* meshes = cached.records<MeshRecord>(Meshes);
+  const PackedMesh::Vertex* vertices = cached.records<PackedMesh::Vertex>(Vertices);
+  const PackedMesh::Index* indices = cached.records<PackedMesh::Index>(Indices);
+  vector<MeshPtr> ret(cached.count(Meshes));
+  parallel_for(0, ret.size(), 1, [&](size_t i) {
+    const MeshRecord& rec = meshes[i];
+    vector<Mesh::Vertex> va(rec.vertex_count);
+    for (size_t v = 0; v < va.size(); v++) {
+      const PackedMesh::Vertex& pv = vertices[rec.first_vertex + v];
+      va[v].coord = Vec4(pv.position[0], pv.position[1], pv.position[2], pv.position[3]);
+      va[v].normal = Vec3(pv.normal[0], pv.normal[1], pv.normal[2]);
+      va[v].color = Color(pv.color[0], pv.color[1], pv.color[2], pv.color[3]);
+    }
+    vector<Mesh::Triangle> ta(rec.index_count / 3);
+    for (size_t t = 0; t < ta.size(); t++) {
+      const PackedMesh::Index* tri = indices + rec.first_index + t * 3;
+      ta[t] = Mesh::Triangle(tri[0], tri[1], tri[2]);
+    }
+    ret[i] = make_shared<Mesh>(cached.name(rec.name), std::move(va), std::move(ta));
+  });
+  return ret;
+}
+
+// Native readers ////////////////////////////////////////////////////////////
+// Plain OBJ/PLY files skip assimp (and the cache: reading them is about as fast as a cache hit)
+////
+
+// The single mesh of the file, named after it; nullptr if the reader gives up, so that assimp
+// can have a go
+static MeshPtr read_native(const string& filename) {
+  MeshData data;
+  if (!read_mesh_data(filename, data)) return nullptr;
+  const string stem = std::filesystem::path(filename).stem().string();
+  return build_mesh(data, make_wstring(stem.c_str()));
+}
+
 // AssetLoader /////////////////////////////////////////////////////////////
 // Member functions are all just wappers!
 ////
 
 // Default constructor; make a AssimpLoaderImpl
-AssetLoader::AssetLoader() {
+AssetLoader::AssetLoader(std::shared_ptr<AssetCache> cache) : cache(std::move(cache)) {
   this->impl = make_shared<AssimpLoaderImpl>();
 }
 
 // Load all models from the file
 vector<MeshPtr> AssetLoader::load_meshes(const std::string filename) {
+  if (has_native_reader(filename))
+    if (MeshPtr mesh = read_native(filename)) return {mesh};
+
+  const std::uint64_t key = cache ? AssetCache::key(filename, cache_options(CachedAs::Meshes)) : 0;
+  if (auto archive = open_cached(cache.get(), key)) {
+    console << "Read " << filename << " from the asset cache." << endl;
+    const vector<MeshPtr> meshes = load_archived_meshes(*archive);
+    const archive::ModelRecord* models = archive->records<archive::ModelRecord>(archive::Models);
+    vector<MeshPtr> ret(archive->count(archive::Models));
+    for (size_t i = 0; i < ret.size(); i++)
+      ret[i] = meshes[models[i].mesh];
+    return ret;
+  }
+
+  impl->load_file(filename);
+  vector<MeshPtr> meshes = impl->load_meshes();
+
+  // Meshes are already in world-space, so each one becomes a model without transform
+  auto can_store = [](const MeshPtr& m) { return archivable(*m); };
+  if (key && all_of(meshes.begin(), meshes.end(), can_store) && cacheable(*impl, filename)) {
+    Scene scene;
+    for (const MeshPtr& mesh : meshes)
+      scene.add_model(Mat4::I(), mesh, mesh->get_name());
+    cache->store(key, [&](const string& path) { return write_scene_archive(path, scene); });
+  }
+  return meshes;
+}
+
+// Load meshes once, with their instances
+vector<MeshInstance> AssetLoader::load_instances(const std::string filename) {
+  if (has_native_reader(filename))
+    if (MeshPtr mesh = read_native(filename)) return {{mesh, Mat4::I(), mesh->get_name()}};
+
+  const std::uint64_t key
+    = cache ? AssetCache::key(filename, cache_options(CachedAs::Instances)) : 0;
+  if (auto archive = open_cached(cache.get(), key)) {
+    console << "Read " << filename << " from the asset cache." << endl;
+    const vector<MeshPtr> meshes = load_archived_meshes(*archive);
+    const archive::ModelRecord* models = archive->records<archive::ModelRecord>(archive::Models);
+    vector<MeshInstance> ret(archive->count(archive::Models));
+    for (size_t i = 0; i < ret.size(); i++) {
+      const double* t = models[i].transform;
+      ret[i].mesh = meshes[models[i].mesh];
+      ret[i].transform = Mat4({t[0], t[1], t[2], t[3]}, {t[4], t[5], t[6], t[7]},
+        {t[8], t[9], t[10], t[11]}, {t[12], t[13], t[14], t[15]});
+      ret[i].name = archive->name(models[i].name);
+    }
+    return ret;
+  }
+
   impl->load_file(filename);
-  return impl->load_meshes();
+  vector<MeshInstance> instances = impl->load_instances();
+
+  // The archive stores each mesh once, however many models share it
+  auto can_store = [](const MeshInstance& inst) { return archivable(*inst.mesh); };
+  if (key && all_of(instances.begin(), instances.end(), can_store)
+      && cacheable(*impl, filename)) {
+    Scene scene;
+    for (const MeshInstance& inst : instances)
+      scene.add_model(inst.transform, inst.mesh, inst.name);
+    cache->store(key, [&](const string& path) { return write_scene_archive(path, scene); });
+  }
+  return instances;
 }
 
 // Load the while 3D file as (scene, camera, lights)
-tuple<ScenePtr, CameraPtr, std::vector<LightPtr> > AssetLoader::load_world(
+tuple<ScenePtr, CameraPtr, std::vector<LightHandle> > AssetLoader::load_world(
   const std::string filename) {
+  if (has_native_reader(filename))
+    if (MeshPtr mesh = read_native(filename)) {
+      ScenePtr sp = make_shared<Scene>(mesh->get_name());
+      sp->add_model(Mat4::I(), mesh, mesh->get_name());
+      return make_tuple(sp, default_camera(), std::vector<LightHandle>());
+    }
+
+  const std::uint64_t key = cache ? AssetCache::key(filename, cache_options(CachedAs::World)) : 0;
+  if (auto archive = open_cached(cache.get(), key)) {
+    console << "Read " << filename << " from the asset cache." << endl;
+    CameraPtr cp = archive->camera();
+    ScenePtr sp = archive->instantiate();
+    return make_tuple(sp, cp ? cp : default_camera(), scene_lights(*sp));
+  }
+
   impl->load_file(filename);
   ScenePtr sp = impl->load_scene();
   CameraPtr cp = impl->load_camera();
 
-  return make_tuple(sp, cp, std::vector<LightPtr>());
+  if (key) {
+    bool complete = true;
+    for (const ModelPtr& model : sp->get_models())
+      complete &= !model->get_geometry() || archivable(*model->get_geometry());
+    if (complete && cacheable(*impl, filename))
+      cache->store(
+        key, [&](const string& path) { return write_scene_archive(path, *sp, cp.get()); });
+  }
+
+  return make_tuple(sp, cp, scene_lights(*sp));
+}
+
+// Animations only come from assimp; the asset cache does not keep them
+vector<AnimationClipPtr> AssetLoader::load_animations(const std::string& filename) {
+  if (has_native_reader(filename)) return {};
+  if (impl->load_file(filename) != 0) return {};
+  return impl->load_animations();
+}
+
+// Start loading the 3D file on a loader thread
+unique_ptr<WorldStream> AssetLoader::load_world_async(
+  const std::string& filename, const Camera* focus) {
+  return unique_ptr<WorldStream>(new WorldStream(make_shared<WorldStreamImpl>(filename, focus)));
+}
+
+// WorldStream ///////////////////////////////////////////////////////////////
+// Wrappers as well
+////
+
+WorldStream::~WorldStream() = default;
+
+bool WorldStream::parsed() const {
+  return impl->parsed();
+}
+
+bool WorldStream::failed() const {
+  return impl->failed();
+}
+
+shared_future<bool> WorldStream::finished() const {
+  return impl->finished();
+}
+
+void WorldStream::set_focus(const Vec3& position) {
+  impl->set_focus(position);
+}
+
+size_t WorldStream::apply(Scene& scene, size_t max_meshes) {
+  return impl->apply(scene, max_meshes);
+}
+
+CameraPtr WorldStream::camera() const {
+  return impl->camera();
+}
+
+size_t WorldStream::mesh_count() const {
+  return impl->mesh_count();
+}
+
+size_t WorldStream::applied_count() const {
+  return impl->applied_count();
 }
 
 } // namespace rei
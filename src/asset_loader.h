@@ -1,12 +1,16 @@
 #ifndef REI_ASSET_LOADER_H
 #define REI_ASSET_LOADER_H
 
+#include <cstdint>
+#include <future>
 #include <memory>
 #include <string>
 #include <tuple>
 #include <vector>
 
 #include "algebra.h"
+#include "animation.h"
+#include "asset_cache.h"
 #include "camera.h"
 #include "scene.h"
 
@@ -15,6 +19,8 @@
  * Define a loader to load model from .dae files, and return the model in
  * OpenGL-style right-hand coordinates (+x right, +y up, -z forward).
  *
+ * Plain .obj and .ply files go through the native readers in mesh_reader.h.
+ *
  * NOTE: Implementation details are hided in the source file, to reduce header
  * dependency.
  */
@@ -24,25 +30,94 @@ namespace rei {
 using MeshPtr = std::shared_ptr<Mesh>;
 using ScenePtr = std::shared_ptr<Scene>;
 using CameraPtr = std::shared_ptr<Camera>;
-using LightPtr = std::shared_ptr<void>;
 
 // Forward declaration for the implemetation class
 class AssimpLoaderImpl;
+class WorldStreamImpl;
+
+/*
+ * A world loading in the background; see AssetLoader::load_world_async.
+ *
+ * The file is parsed on a loader thread; then meshes are converted on the thread pool, nearest
+ * to the focus point first, and queued. apply() moves what arrived into a scene on the thread
+ * owning that scene, in batches. The first apply() after parsing adds the whole node hierarchy
+ * and every model, with PendingGeometry carrying the mesh bounds, so culling and the spatial
+ * index see models before their geometry arrives.
+ *
+ * Dropping the stream cancels the remaining conversions.
+ */
+class WorldStream : NoCopy {
+public:
+  ~WorldStream();
+
+  // True once the file is parsed, or failed to be
+  bool parsed() const;
+  bool failed() const;
+  // Becomes true when every mesh is converted (applied or not), false if the file failed or the
+  // stream was cancelled
+  std::shared_future<bool> finished() const;
+
+  // Meshes nearer to `position` are converted first; thread-safe, e.g. set every frame
+  void set_focus(const Vec3& position);
+
+  // Add what arrived to `scene` (always the same scene), at most `max_meshes` meshes per call.
+  // Return the number of models that received their geometry.
+  size_t apply(Scene& scene, size_t max_meshes = SIZE_MAX);
+
+  // Camera of the file, or a default one; nullptr until parsed
+  CameraPtr camera() const;
+
+  // Progress, in meshes
+  size_t mesh_count() const;
+  size_t applied_count() const;
+
+private:
+  friend class AssetLoader;
+  WorldStream(std::shared_ptr<WorldStreamImpl> impl) : impl(std::move(impl)) {}
+
+  std::shared_ptr<WorldStreamImpl> impl;
+};
+
+// A mesh placed in the world; instances of the same mesh share its MeshPtr
+struct MeshInstance {
+  MeshPtr mesh;
+  Mat4 transform; // mesh-space to world-space
+  Name name;      // of the node
+};
 
 // The asset loader interface
 class AssetLoader {
 public:
-  // Default constructor
-  AssetLoader();
+  // Default constructor. Converted files are kept in `cache` if one is given (e.g.
+  // AssetCache::shared_default()), keyed by the content of the file and the import settings.
+  // Files that make the importer read other files (.mtl, external parts, ...) are not cached.
+  explicit AssetLoader(std::shared_ptr<AssetCache> cache = nullptr);
 
-  // Load all models from the file
+  // Load all models from the file, with the node transforms baked into world-space vertices
   std::vector<MeshPtr> load_meshes(const std::string filename);
 
-  // Load the while 3D file as (scene, camera, lights)
-  std::tuple<ScenePtr, CameraPtr, std::vector<LightPtr> > load_world(const std::string filename);
+  // Load every mesh once in mesh-space, plus an instance per node referencing it. Scenes that
+  // repeat a part many times (e.g. CAD assemblies) take a fraction of the memory of load_meshes.
+  std::vector<MeshInstance> load_instances(const std::string filename);
+
+  // Load the while 3D file as (scene, camera, lights). Lights are added to the scene; the handles
+  // are those of the scene's LightStore. From the cache, meshes are PackedMesh views into the
+  // cached archive.
+  std::tuple<ScenePtr, CameraPtr, std::vector<LightHandle> > load_world(
+    const std::string filename);
+
+  // Start loading the 3D file in the background and return at once. Meshes near `focus` (the
+  // camera of the file if nullptr) are converted first.
+  std::unique_ptr<WorldStream> load_world_async(
+    const std::string& filename, const Camera* focus = nullptr);
+
+  // Load the animations of the file, with times in seconds; channels target the scene graph
+  // nodes of load_world by name (see Animator::bind). The file is parsed again.
+  std::vector<AnimationClipPtr> load_animations(const std::string& filename);
 
 private:
   std::shared_ptr<AssimpLoaderImpl> impl;
+  std::shared_ptr<AssetCache> cache;
 };
 
 } // namespace rei
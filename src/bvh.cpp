@@ -0,0 +1,390 @@
+// source of bvh.h
+#include "bvh.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "debug.h"
+
+using std::uint32_t;
+using std::vector;
+
+namespace rei {
+
+namespace {
+
+constexpr uint32_t k_leaf_size = 4;
+constexpr uint32_t k_max_leaf_size = 16;
+constexpr int k_bin_num = 12;
+constexpr int k_stack_size = 128;
+// Nodes this deep are made leaves, however many triangles they hold. Traversal keeps at most one
+// pending sibling per level, so the fixed stack above can never overflow.
+constexpr uint32_t k_max_depth = k_stack_size - 2;
+
+} // namespace
+
+Vec3 closest_point_on_triangle(const Vec3& p, const Vec3& a, const Vec3& b, const Vec3& c) {
+  // Ref: Real-Time Collision Detection, 5.1.5
+  Vec3 ab = b - a, ac = c - a, ap = p - a;
+  double d1 = dot(ab, ap), d2 = dot(ac, ap);
+  if (d1 <= 0 && d2 <= 0) return a;
+
+  Vec3 bp = p - b;
+  double d3 = dot(ab, bp), d4 = dot(ac, bp);
+  if (d3 >= 0 && d4 <= d3) return b;
+
+  double vc = d1 * d4 - d3 * d2;
+  if (vc <= 0 && d1 >= 0 && d3 <= 0) return a + ab * (d1 / (d1 - d3));
+
+  Vec3 cp = p - c;
+  double d5 = dot(ab, cp), d6 = dot(ac, cp);
+  if (d6 >= 0 && d5 <= d6) return c;
+
+  double vb = d5 * d2 - d1 * d6;
+  if (vb <= 0 && d2 >= 0 && d6 <= 0) return a + ac * (d2 / (d2 - d6));
+
+  double va = d3 * d6 - d5 * d4;
+  if (va <= 0 && (d4 - d3) >= 0 && (d5 - d6) >= 0) {
+    return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+  }
+
+  double denom = 1.0 / (va + vb + vc);
+  return a + ab * (vb * denom) + ac * (vc * denom);
+}
+
+double intersect_triangle(const Vec3& origin, const Vec3& dir, const Vec3& a, const Vec3& b,
+  const Vec3& c, double& u, double& v) {
+  const double eps = 1e-12;
+  Vec3 e1 = b - a, e2 = c - a;
+  Vec3 pvec = cross(dir, e2);
+  double det = dot(e1, pvec);
+  if (std::abs(det) < eps) return -1;
+  double inv_det = 1.0 / det;
+  Vec3 tvec = origin - a;
+  u = dot(tvec, pvec) * inv_det;
+  if (u < 0 || u > 1) return -1;
+  Vec3 qvec = cross(tvec, e1);
+  v = dot(dir, qvec) * inv_det;
+  if (v < 0 || u + v > 1) return -1;
+  return dot(e2, qvec) * inv_det;
+}
+
+void TriangleBVH::build(vector<Vec3>&& positions, vector<uint32_t>&& indices) {
+  REI_ASSERT(indices.size() % 3 == 0);
+  m_positions = std::move(positions);
+  m_indices = std::move(indices);
+  build_nodes();
+}
+
+void TriangleBVH::build(const Mesh& mesh, const Mat4& transform) {
+  const auto& vertices = mesh.get_vertices();
+  const auto& triangles = mesh.get_triangles();
+  vector<Vec3> positions;
+  positions.reserve(vertices.size());
+  for (const auto& v : vertices) {
+    positions.push_back(Vec3(transform * v.coord));
+  }
+  vector<uint32_t> indices;
+  indices.reserve(triangles.size() * 3);
+  for (const auto& t : triangles) {
+    indices.push_back(uint32_t(t.a));
+    indices.push_back(uint32_t(t.b));
+    indices.push_back(uint32_t(t.c));
+  }
+  build(std::move(positions), std::move(indices));
+}
+
+Aabb TriangleBVH::triangle_bounds(TriangleId tri) const {
+  Aabb box;
+  box.expand(vertex(tri, 0));
+  box.expand(vertex(tri, 1));
+  box.expand(vertex(tri, 2));
+  return box;
+}
+
+void TriangleBVH::build_nodes() {
+  m_nodes.clear();
+  m_tri_order.clear();
+  const uint32_t tri_num = uint32_t(triangle_num());
+  if (tri_num == 0) return;
+
+  vector<Aabb> tri_bounds(tri_num);
+  vector<Vec3> centroids(tri_num);
+  for (uint32_t i = 0; i < tri_num; i++) {
+    tri_bounds[i] = triangle_bounds(i);
+    centroids[i] = tri_bounds[i].center();
+  }
+  m_tri_order.resize(tri_num);
+  for (uint32_t i = 0; i < tri_num; i++)
+    m_tri_order[i] = i;
+
+  m_nodes.reserve(tri_num * 2 / k_leaf_size + 1);
+
+  // Depth-first construction; a task is (node index, item range)
+  struct Task {
+    uint32_t node;
+    uint32_t parent; // only used by pending right children
+    uint32_t begin, end;
+    uint32_t depth;
+  };
+  constexpr uint32_t k_pending_right = UINT32_MAX;
+  vector<Task> tasks;
+  m_nodes.emplace_back();
+  tasks.push_back({0, 0, 0, tri_num, 0});
+
+  while (!tasks.empty()) {
+    Task task = tasks.back();
+    tasks.pop_back();
+    if (task.node == k_pending_right) {
+      task.node = uint32_t(m_nodes.size());
+      m_nodes.emplace_back();
+      m_nodes[task.parent].first = task.node;
+    }
+
+    Aabb bounds, centroid_bounds;
+    for (uint32_t i = task.begin; i < task.end; i++) {
+      bounds.expand(tri_bounds[m_tri_order[i]]);
+      centroid_bounds.expand(centroids[m_tri_order[i]]);
+    }
+    m_nodes[task.node].bounds = bounds;
+
+    const uint32_t count = task.end - task.begin;
+    auto make_leaf = [&]() {
+      m_nodes[task.node].first = task.begin;
+      m_nodes[task.node].count = count;
+    };
+    if (count <= k_leaf_size || task.depth >= k_max_depth) {
+      make_leaf();
+      continue;
+    }
+
+    // Binned SAH split along the longest centroid axis
+    const int axis = centroid_bounds.longest_axis();
+    const double axis_min = centroid_bounds.min[axis];
+    const double axis_extent = centroid_bounds.max[axis] - axis_min;
+    uint32_t mid = task.begin + count / 2;
+    if (axis_extent > 0) {
+      struct Bin {
+        Aabb bounds;
+        uint32_t count = 0;
+      } bins[k_bin_num];
+      const double bin_scale = k_bin_num / axis_extent;
+      auto bin_of = [&](uint32_t tri) {
+        int b = int((centroids[tri][axis] - axis_min) * bin_scale);
+        return (std::min)(b, k_bin_num - 1);
+      };
+      for (uint32_t i = task.begin; i < task.end; i++) {
+        Bin& bin = bins[bin_of(m_tri_order[i])];
+        bin.bounds.expand(tri_bounds[m_tri_order[i]]);
+        bin.count++;
+      }
+
+      double right_area[k_bin_num];
+      uint32_t right_count[k_bin_num];
+      {
+        Aabb acc;
+        uint32_t n = 0;
+        for (int b = k_bin_num - 1; b > 0; b--) {
+          acc.expand(bins[b].bounds);
+          n += bins[b].count;
+          right_area[b] = acc.surface_area();
+          right_count[b] = n;
+        }
+      }
+      double best_cost = (std::numeric_limits<double>::max)();
+      int best_split = -1;
+      {
+        Aabb acc;
+        uint32_t n = 0;
+        for (int b = 0; b < k_bin_num - 1; b++) {
+          acc.expand(bins[b].bounds);
+          n += bins[b].count;
+          if (n == 0 || right_count[b + 1] == 0) continue;
+          double cost = acc.surface_area() * n + right_area[b + 1] * right_count[b + 1];
+          if (cost < best_cost) {
+            best_cost = cost;
+            best_split = b;
+          }
+        }
+      }
+
+      const double leaf_cost = bounds.surface_area() * count;
+      if (best_split >= 0 && (best_cost < leaf_cost || count > k_max_leaf_size)) {
+        auto it = std::partition(m_tri_order.begin() + task.begin, m_tri_order.begin() + task.end,
+          [&](uint32_t tri) { return bin_of(tri) <= best_split; });
+        mid = uint32_t(it - m_tri_order.begin());
+      } else if (count <= k_max_leaf_size) {
+        make_leaf();
+        continue;
+      }
+    } else if (count <= k_max_leaf_size) {
+      // all centroids coincide
+      make_leaf();
+      continue;
+    }
+    if (mid == task.begin || mid == task.end) mid = task.begin + count / 2;
+
+    // Left child directly follows the parent; the right child is allocated when its task is
+    // popped, i.e. after the whole left subtree
+    const uint32_t left = uint32_t(m_nodes.size());
+    m_nodes.emplace_back();
+    tasks.push_back({k_pending_right, task.node, mid, task.end, task.depth + 1});
+    tasks.push_back({left, 0, task.begin, mid, task.depth + 1});
+  }
+}
+
+void TriangleBVH::refit() {
+  for (size_t i = m_nodes.size(); i-- > 0;) {
+    Node& node = m_nodes[i];
+    if (node.is_leaf()) {
+      Aabb box;
+      for (uint32_t j = node.first; j < node.first + node.count; j++)
+        box.expand(triangle_bounds(m_tri_order[j]));
+      node.bounds = box;
+    } else {
+      node.bounds = Aabb::merge(m_nodes[i + 1].bounds, m_nodes[node.first].bounds);
+    }
+  }
+}
+
+bool TriangleBVH::intersect(const Vec3& origin, const Vec3& dir, double t_max, RayHit& hit) const {
+  if (m_nodes.empty()) return false;
+  const Vec3 inv_dir(1.0 / dir.x, 1.0 / dir.y, 1.0 / dir.z);
+  bool found = false;
+  hit.t = t_max;
+
+  uint32_t stack[k_stack_size];
+  int top = 0;
+  stack[top++] = 0;
+  while (top > 0) {
+    const Node& node = m_nodes[stack[--top]];
+    double t0 = 0, t1 = hit.t;
+    if (!node.bounds.intersect(origin, inv_dir, t0, t1)) continue;
+    if (node.is_leaf()) {
+      for (uint32_t j = node.first; j < node.first + node.count; j++) {
+        TriangleId tri = m_tri_order[j];
+        double u, v;
+        double t
+          = intersect_triangle(origin, dir, vertex(tri, 0), vertex(tri, 1), vertex(tri, 2), u, v);
+        if (t > 0 && t < hit.t) {
+          hit = {t, tri, u, v};
+          found = true;
+        }
+      }
+    } else {
+      const uint32_t self = uint32_t(&node - m_nodes.data());
+      REI_ASSERT(top + 2 <= k_stack_size);
+      // visit the child on the ray-facing side first
+      const int axis = node.bounds.longest_axis();
+      if (dir[axis] > 0) {
+        stack[top++] = node.first;
+        stack[top++] = self + 1;
+      } else {
+        stack[top++] = self + 1;
+        stack[top++] = node.first;
+      }
+    }
+  }
+  return found;
+}
+
+bool TriangleBVH::occluded(const Vec3& origin, const Vec3& dir, double t_max) const {
+  if (m_nodes.empty()) return false;
+  const Vec3 inv_dir(1.0 / dir.x, 1.0 / dir.y, 1.0 / dir.z);
+  uint32_t stack[k_stack_size];
+  int top = 0;
+  stack[top++] = 0;
+  while (top > 0) {
+    const uint32_t index = stack[--top];
+    const Node& node = m_nodes[index];
+    double t0 = 0, t1 = t_max;
+    if (!node.bounds.intersect(origin, inv_dir, t0, t1)) continue;
+    if (node.is_leaf()) {
+      for (uint32_t j = node.first; j < node.first + node.count; j++) {
+        TriangleId tri = m_tri_order[j];
+        double u, v;
+        double t
+          = intersect_triangle(origin, dir, vertex(tri, 0), vertex(tri, 1), vertex(tri, 2), u, v);
+        if (t > 0 && t < t_max) return true;
+      }
+    } else {
+      REI_ASSERT(top + 2 <= k_stack_size);
+      stack[top++] = node.first;
+      stack[top++] = index + 1;
+    }
+  }
+  return false;
+}
+
+size_t TriangleBVH::count_intersections(const Vec3& origin, const Vec3& dir, double t_max) const {
+  if (m_nodes.empty()) return 0;
+  const Vec3 inv_dir(1.0 / dir.x, 1.0 / dir.y, 1.0 / dir.z);
+  size_t count = 0;
+  uint32_t stack[k_stack_size];
+  int top = 0;
+  stack[top++] = 0;
+  while (top > 0) {
+    const uint32_t index = stack[--top];
+    const Node& node = m_nodes[index];
+    double t0 = 0, t1 = t_max;
+    if (!node.bounds.intersect(origin, inv_dir, t0, t1)) continue;
+    if (node.is_leaf()) {
+      for (uint32_t j = node.first; j < node.first + node.count; j++) {
+        TriangleId tri = m_tri_order[j];
+        double u, v;
+        double t
+          = intersect_triangle(origin, dir, vertex(tri, 0), vertex(tri, 1), vertex(tri, 2), u, v);
+        if (t > 0 && t < t_max) count++;
+      }
+    } else {
+      REI_ASSERT(top + 2 <= k_stack_size);
+      stack[top++] = node.first;
+      stack[top++] = index + 1;
+    }
+  }
+  return count;
+}
+
+bool TriangleBVH::closest_point(const Vec3& p, double max_distance, ClosestPoint& result) const {
+  if (m_nodes.empty()) return false;
+  double best = max_distance * max_distance;
+  bool found = false;
+
+  uint32_t stack[k_stack_size];
+  int top = 0;
+  stack[top++] = 0;
+  while (top > 0) {
+    const uint32_t index = stack[--top];
+    const Node& node = m_nodes[index];
+    if (node.bounds.distance2(p) > best) continue;
+    if (node.is_leaf()) {
+      for (uint32_t j = node.first; j < node.first + node.count; j++) {
+        TriangleId tri = m_tri_order[j];
+        Vec3 q = closest_point_on_triangle(p, vertex(tri, 0), vertex(tri, 1), vertex(tri, 2));
+        double d2 = (q - p).norm2();
+        if (d2 < best) {
+          best = d2;
+          result = {d2, tri, q};
+          found = true;
+        }
+      }
+    } else {
+      REI_ASSERT(top + 2 <= k_stack_size);
+      // push the farther child first so the nearer one is visited next
+      const uint32_t left = index + 1, right = node.first;
+      double dl = m_nodes[left].bounds.distance2(p);
+      double dr = m_nodes[right].bounds.distance2(p);
+      if (dl < dr) {
+        stack[top++] = right;
+        stack[top++] = left;
+      } else {
+        stack[top++] = left;
+        stack[top++] = right;
+      }
+    }
+  }
+  return found;
+}
+
+} // namespace rei
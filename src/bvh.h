@@ -0,0 +1,93 @@
+#ifndef REI_BVH_H
+#define REI_BVH_H
+
+#include <cstdint>
+#include <vector>
+
+#include "aabb.h"
+#include "algebra.h"
+#include "geometry.h"
+
+/*
+ * bvh.h
+ * A CPU bounding volume hierarchy over triangles, for ray and closest-point queries.
+ */
+
+namespace rei {
+
+class TriangleBVH {
+public:
+  using TriangleId = std::uint32_t;
+
+  // Closest hit along a ray; (u, v) are barycentrics of vertex b and c
+  struct RayHit {
+    double t;
+    TriangleId triangle;
+    double u, v;
+  };
+
+  struct ClosestPoint {
+    double distance2;
+    TriangleId triangle;
+    Vec3 point;
+  };
+
+  TriangleBVH() = default;
+
+  // Build from a flat position list and 3 indices per triangle
+  void build(std::vector<Vec3>&& positions, std::vector<std::uint32_t>&& indices);
+  // Build from a mesh, with vertices transformed by `transform`
+  void build(const Mesh& mesh, const Mat4& transform = Mat4::I());
+
+  // Recompute node bounds after positions are modified in place (topology is kept)
+  std::vector<Vec3>& positions() { return m_positions; }
+  void refit();
+
+  bool empty() const { return m_nodes.empty(); }
+  size_t triangle_num() const { return m_indices.size() / 3; }
+  size_t node_num() const { return m_nodes.size(); }
+  Aabb bounds() const { return m_nodes.empty() ? Aabb() : m_nodes[0].bounds; }
+
+  const Vec3& vertex(TriangleId tri, int corner) const {
+    return m_positions[m_indices[tri * 3 + corner]];
+  }
+
+  // Closest intersection in (0, t_max)
+  bool intersect(const Vec3& origin, const Vec3& dir, double t_max, RayHit& hit) const;
+  // Any intersection in (0, t_max)
+  bool occluded(const Vec3& origin, const Vec3& dir, double t_max) const;
+  // Number of intersections in (0, t_max); used for inside/outside parity tests
+  size_t count_intersections(const Vec3& origin, const Vec3& dir, double t_max) const;
+
+  // Closest point on the surface within `max_distance`
+  bool closest_point(const Vec3& p, double max_distance, ClosestPoint& result) const;
+
+private:
+  // Children of an interior node are `index + 1` and `right`; nodes are in depth-first order, so
+  // every child comes after its parent.
+  struct Node {
+    Aabb bounds;
+    std::uint32_t first = 0; // leaf: first item in m_tri_order; interior: right child index
+    std::uint32_t count = 0; // leaf: triangle count; interior: 0
+    bool is_leaf() const { return count > 0; }
+  };
+
+  std::vector<Node> m_nodes;
+  std::vector<Vec3> m_positions;
+  std::vector<std::uint32_t> m_indices;
+  std::vector<TriangleId> m_tri_order; // leaf ranges index into this
+
+  Aabb triangle_bounds(TriangleId tri) const;
+  void build_nodes();
+};
+
+// Closest point on triangle (a, b, c) to p
+Vec3 closest_point_on_triangle(const Vec3& p, const Vec3& a, const Vec3& b, const Vec3& c);
+
+// Moller-Trumbore ray/triangle test; returns t, or a negative value if missed
+double intersect_triangle(const Vec3& origin, const Vec3& dir, const Vec3& a, const Vec3& b,
+  const Vec3& c, double& u, double& v);
+
+} // namespace rei
+
+#endif
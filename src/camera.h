@@ -38,6 +38,8 @@ public:
   double aspect() const { return m_aspect; }
   double fov_h() const { return angle; }
   double fov_v() const { return angle / m_aspect; }
+  double near_plane() const { return znear; }
+  double far_plane() const { return zfar; }
   Vec3 position() const { return m_position; }
   Vec3 forward() const { return m_direction; }
   Vec3 up() const { return m_up; }
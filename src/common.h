@@ -4,9 +4,8 @@
 #include <string>
 
 #include "debug.h"
+#include "name.h"
 #include "string_utils.h"
 #include "type_utils.h"
 
-typedef std::wstring Name;
-
 #endif
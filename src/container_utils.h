@@ -18,13 +18,13 @@ class FixedVec : private std::array<T, N> {
   using C = Containter;
 
 public:
-  using C::const_pointer;
-  using C::const_reference;
-  using C::difference_type;
-  using C::pointer;
-  using C::reference;
-  using C::size_type;
-  using C::value_type;
+  using typename C::const_pointer;
+  using typename C::const_reference;
+  using typename C::difference_type;
+  using typename C::pointer;
+  using typename C::reference;
+  using typename C::size_type;
+  using typename C::value_type;
   // TODO iterator
 
   static constexpr size_type max_size = N;
@@ -156,7 +156,7 @@ private:
 template <typename TKey, typename TVal, typename Hasher = std::hash<TKey>>
 class Hashmap : public std::unordered_map<TKey, TVal, Hasher> {
 public:
-  bool has(const TKey& key) const { return find(key) != end(); }
+  bool has(const TKey& key) const { return this->find(key) != this->end(); }
 
   TVal* try_get(const TKey& key) {
     auto found = this->find(key);
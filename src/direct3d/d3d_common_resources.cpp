@@ -36,6 +36,25 @@ const D3D12_INPUT_ELEMENT_DESC c_input_layout[3]
         + sizeof(VertexElement::color), // skip the fisrt 3 coordinnate and 4 colors ata
       D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0}};
 
+// Vertex layout plus per-instance world and normal matrices (one row per element) from slot 1;
+// the normal matrix is a 4x4 in the buffer, but only its upper 3x3 part is read
+const D3D12_INPUT_ELEMENT_DESC c_instanced_input_layout[10] = {c_input_layout[0], c_input_layout[1],
+  c_input_layout[2],
+  {"INSTANCE_WORLD", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 0,
+    D3D12_INPUT_CLASSIFICATION_PER_INSTANCE_DATA, 1},
+  {"INSTANCE_WORLD", 1, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 16,
+    D3D12_INPUT_CLASSIFICATION_PER_INSTANCE_DATA, 1},
+  {"INSTANCE_WORLD", 2, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 32,
+    D3D12_INPUT_CLASSIFICATION_PER_INSTANCE_DATA, 1},
+  {"INSTANCE_WORLD", 3, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 48,
+    D3D12_INPUT_CLASSIFICATION_PER_INSTANCE_DATA, 1},
+  {"INSTANCE_NORMAL", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 64,
+    D3D12_INPUT_CLASSIFICATION_PER_INSTANCE_DATA, 1},
+  {"INSTANCE_NORMAL", 1, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 80,
+    D3D12_INPUT_CLASSIFICATION_PER_INSTANCE_DATA, 1},
+  {"INSTANCE_NORMAL", 2, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 96,
+    D3D12_INPUT_CLASSIFICATION_PER_INSTANCE_DATA, 1}};
+
 ID3D12Resource* BufferData::get_res() {
   return res.match( //
     [](const TextureBuffer& tex) { return tex.buffer.Get(); },
@@ -15,6 +15,7 @@
 
 #include "..//scene.h"
 #include "../algebra.h"
+#include "../resource_state_tracker.h"
 #include "../camera.h"
 #include "../color.h"
 #include "../common.h"
@@ -155,6 +156,8 @@ struct VertexElement {
 
 constexpr UINT c_input_layout_num = 3;
 extern const D3D12_INPUT_ELEMENT_DESC c_input_layout[3];
+constexpr UINT c_instanced_input_layout_num = 10;
+extern const D3D12_INPUT_ELEMENT_DESC c_instanced_input_layout[10];
 
 struct RenderTargetSpec {
   DXGI_SAMPLE_DESC sample_desc; // multi-sampling parameters
@@ -213,7 +216,7 @@ struct TextureBuffer {
   ResourceFormat format;
   ResourceDimension dimension;
   #if DEBUG
-  std::wstring name;
+  Name name;
   #endif
 };
 
@@ -246,6 +249,7 @@ struct BufferData : BaseBufferData {
 
   ResourceVariant res;
   D3D12_RESOURCE_STATES state = D3D12_RESOURCE_STATE_COMMON;
+  StateTracking<D3D12_RESOURCE_STATES> tracking;
 
   ID3D12Resource* get_res();
 };
@@ -340,7 +344,6 @@ struct RasterShaderDesc {
   CD3DX12_STATIC_SAMPLER_DESC static_sampler_desc {};
   RootSignatureDescMemory root_signature {};
 
-  // TODO allow configuration of input layout
   D3D12_INPUT_LAYOUT_DESC input_layout = {c_input_layout, c_input_layout_num};
 
   FixedVec<DXGI_FORMAT, 8> rt_formats;
@@ -361,6 +364,9 @@ struct RasterShaderDesc {
       rt_formats.push_back(to_dxgi_format(rt_desc.format));
     }
     is_depth_stencil_null = meta.is_depth_stencil_disabled;
+    if (meta.is_instanced) {
+      input_layout = {c_instanced_input_layout, c_instanced_input_layout_num};
+    }
     if (meta.is_blending_addictive) {
       blend_state.RenderTarget[0].BlendEnable = true;
       blend_state.RenderTarget[0].BlendOp = D3D12_BLEND_OP_ADD;
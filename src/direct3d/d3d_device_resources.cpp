@@ -132,14 +132,23 @@ void DeviceResources::create_mesh_buffer(const Mesh& mesh, MeshUploadResult& res
     indices.push_back(t.b);
     indices.push_back(t.c);
   }
+  create_mesh_buffer(vertices.data(), vertices.size(), indices.data(), indices.size(), res);
+}
+
+void DeviceResources::create_mesh_buffer(const PackedMesh& mesh, MeshUploadResult& res) {
+  // Already in upload layout (e.g. mapped from a scene archive); copied only into the upload heap
+  static_assert(sizeof(PackedMesh::Vertex) == sizeof(VertexElement), "vertex layout mismatch");
+  static_assert(sizeof(PackedMesh::Index) == sizeof(std::uint16_t), "index format mismatch");
+  create_mesh_buffer(mesh.vertices(), mesh.vertices_num(), mesh.indices(), mesh.indices_num(), res);
+}
 
+void DeviceResources::create_mesh_buffer(const void* p_vertices, size_t vertex_num,
+  const std::uint16_t* p_indices, size_t index_num, MeshUploadResult& res) {
   ID3D12Device* device = this->device();
   ID3D12GraphicsCommandList* cmd_list = this->prepare_command_list();
 
-  const void* p_vertices = vertices.data();
-  const UINT64 vert_bytesize = vertices.size() * sizeof(vertices[0]);
-  const void* p_indices = indices.data();
-  const UINT64 ind_bytesize = indices.size() * sizeof(indices[0]);
+  const UINT64 vert_bytesize = vertex_num * sizeof(VertexElement);
+  const UINT64 ind_bytesize = index_num * sizeof(std::uint16_t);
 
   // Create vertices buffer and upload data
   ComPtr<ID3D12Resource> vert_buffer = create_default_buffer(device, vert_bytesize);
@@ -154,11 +163,11 @@ void DeviceResources::create_mesh_buffer(const Mesh& mesh, MeshUploadResult& res
   // populate the result
   res.vert_buffer = vert_buffer;
   res.vert_upload_buffer = vert_upload_buffer;
-  res.vertex_num = vertices.size();
+  res.vertex_num = vertex_num;
 
   res.ind_buffer = ind_buffer;
   res.ind_upload_buffer = ind_upload_buffer;
-  res.index_num = indices.size();
+  res.index_num = index_num;
 
   if (is_dxr_enabled) {
     D3D12_SHADER_RESOURCE_VIEW_DESC common_desc = {};
@@ -179,8 +188,8 @@ void DeviceResources::create_mesh_buffer(const Mesh& mesh, MeshUploadResult& res
       geo_desc.Triangles.Transform3x4 = NULL; // not used TODO check this
       geo_desc.Triangles.IndexFormat = c_index_format;
       geo_desc.Triangles.VertexFormat = c_accel_struct_vertex_pos_format;
-      geo_desc.Triangles.IndexCount = indices.size();
-      geo_desc.Triangles.VertexCount = vertices.size();
+      geo_desc.Triangles.IndexCount = UINT(index_num);
+      geo_desc.Triangles.VertexCount = UINT(vertex_num);
       geo_desc.Triangles.IndexBuffer = ind_buffer->GetGPUVirtualAddress();
       geo_desc.Triangles.VertexBuffer.StartAddress = vert_buffer->GetGPUVirtualAddress();
       geo_desc.Triangles.VertexBuffer.StrideInBytes = sizeof(VertexElement);
@@ -244,6 +253,41 @@ void DeviceResources::flush_command_list() {
   m_command_queue->ExecuteCommandLists(1, temp_cmd_lists);
 }
 
+DeviceResources::RecordingContext* DeviceResources::acquire_recording_context() {
+  if (m_recording_contexts_in_use == m_recording_contexts.size()) {
+    auto context = make_unique<RecordingContext>();
+    const D3D12_COMMAND_LIST_TYPE list_type = D3D12_COMMAND_LIST_TYPE_DIRECT;
+    REI_ASSERT(
+      SUCCEEDED(m_device->CreateCommandAllocator(list_type, IID_PPV_ARGS(&context->alloc))));
+    ComPtr<ID3D12GraphicsCommandList> legacy_list;
+    REI_ASSERT(SUCCEEDED(m_device->CreateCommandList(
+      0, list_type, context->alloc.Get(), nullptr, IID_PPV_ARGS(&legacy_list))));
+    REI_ASSERT(SUCCEEDED(legacy_list->QueryInterface(IID_PPV_ARGS(&context->list))));
+    context->list->Close();
+    m_recording_contexts.push_back(std::move(context));
+  }
+  RecordingContext* context = m_recording_contexts[m_recording_contexts_in_use++].get();
+  HRESULT hr = context->list->Reset(context->alloc.Get(), nullptr);
+  REI_ASSERT(SUCCEEDED(hr));
+  return context;
+}
+
+void DeviceResources::execute_recording_contexts(
+  RecordingContext* const* contexts, size_t count) {
+  vector<ID3D12CommandList*> lists;
+  lists.reserve(count + 1);
+  if (is_using_cmd_list) {
+    REI_ASSERT(SUCCEEDED(m_command_list->Close()));
+    is_using_cmd_list = false;
+    lists.push_back(m_command_list.Get());
+  }
+  for (size_t i = 0; i < count; i++) {
+    REI_ASSERT(SUCCEEDED(contexts[i]->list->Close()));
+    lists.push_back(contexts[i]->list.Get());
+  }
+  if (!lists.empty()) m_command_queue->ExecuteCommandLists(UINT(lists.size()), lists.data());
+}
+
 void DeviceResources::flush_command_queue_for_frame() {
   HRESULT hr;
 
@@ -273,6 +317,11 @@ void DeviceResources::flush_command_queue_for_frame() {
   // Reset allocator since commands are finished
   hr = m_command_alloc->Reset();
   REI_ASSERT(SUCCEEDED(hr));
+  for (size_t i = 0; i < m_recording_contexts_in_use; i++) {
+    hr = m_recording_contexts[i]->alloc->Reset();
+    REI_ASSERT(SUCCEEDED(hr));
+  }
+  m_recording_contexts_in_use = 0;
 }
 
 } // namespace d3d
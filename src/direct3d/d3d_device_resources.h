@@ -56,6 +56,9 @@ public:
     const D3D12_ROOT_SIGNATURE_DESC& root_desc, ComPtr<ID3D12RootSignature>& root_sign);
 
   void create_mesh_buffer(const Mesh& mesh, MeshUploadResult& res);
+  void create_mesh_buffer(const PackedMesh& mesh, MeshUploadResult& res);
+  void create_mesh_buffer(const void* vertices, size_t vertex_num, const std::uint16_t* indices,
+    size_t index_num, MeshUploadResult& res);
 
   ID3D12GraphicsCommandList4* prepare_command_list(ID3D12PipelineState* init_pso = nullptr);
   // TODO remove this, just use the new prepare_cmd_list
@@ -66,6 +69,16 @@ public:
   void flush_command_list();
   void flush_command_queue_for_frame();
 
+  // An extra allocator and command list, recorded on its own thread and executed after the main
+  // list. Pooled; all are returned when the frame's commands finish.
+  struct RecordingContext {
+    ComPtr<ID3D12CommandAllocator> alloc;
+    ComPtr<ID3D12GraphicsCommandList4> list;
+  };
+  RecordingContext* acquire_recording_context();
+  // Close and execute the main list, then `contexts` in order
+  void execute_recording_contexts(RecordingContext* const* contexts, size_t count);
+
 private:
   HINSTANCE hinstance = NULL;
 
@@ -83,6 +96,9 @@ private:
   ComPtr<ID3D12GraphicsCommandList4> m_command_list; // newer interface of m_command_list
   bool is_using_cmd_list = false;
 
+  std::vector<std::unique_ptr<RecordingContext>> m_recording_contexts;
+  size_t m_recording_contexts_in_use = 0;
+
   UINT64 current_frame_fence = 0;
   ComPtr<ID3D12Fence> frame_fence;
 
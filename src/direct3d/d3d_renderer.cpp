@@ -60,6 +60,72 @@ FixedVec<D3D_SHADER_MACRO, N + 1> to_hlsl_macros(const FixedVec<ShaderCompileCon
   return hlsl_macros;
 }
 
+/*
+ * The list returned by prepare() records into the device's command list, and issues the batched
+ * barriers before each command. The others record into a recording context of their own, which
+ * the owner executes after the main list on submit().
+ */
+class CommandList : public rei::CommandList {
+public:
+  CommandList(Renderer* owner, DeviceResources::RecordingContext* context)
+      : m_owner(owner), m_context(context) {}
+
+  void begin_render_pass(const RenderPassCommand& cmd) override {
+    m_owner->record_render_pass(list(), cmd);
+  }
+  void end_render_pass() override { list()->EndRenderPass(); }
+
+  void transition(BufferHandle buffer_h, ResourceState state) override {
+    REI_ASSERT(is_main());
+    auto buffer = m_owner->peek_buffer(buffer_h);
+    REI_ASSERT(buffer);
+    // Batched; issued by flush_barriers() before the next command
+    m_owner->m_states.transition(*buffer, to_res_state(state));
+  }
+  void barrier(BufferHandle buffer_h) override {
+    REI_ASSERT(is_main());
+    auto buffer = m_owner->peek_buffer(buffer_h);
+    REI_ASSERT(buffer);
+    m_owner->m_states.uav_barrier(*buffer);
+  }
+  void begin_transition(BufferHandle buffer_h, ResourceState state) override {
+    REI_ASSERT(is_main());
+    auto buffer = m_owner->peek_buffer(buffer_h);
+    REI_ASSERT(buffer);
+    m_owner->m_states.begin_split(*buffer, to_res_state(state));
+  }
+
+  void draw(const DrawCommand& cmd) override { m_owner->record_draw(list(), cmd); }
+  void dispatch(const DispatchCommand& cmd) override { m_owner->record_dispatch(list(), cmd); }
+  using rei::CommandList::raytrace;
+  void raytrace(const RaytraceCommand& cmd) override { m_owner->record_raytrace(list(), cmd); }
+
+  void clear_texture(BufferHandle target, Vec4 clear_value, RenderArea clear_area) override {
+    REI_ASSERT(is_main());
+    m_owner->record_clear_texture(list(), target, clear_value, clear_area);
+  }
+  void copy_texture(BufferHandle src, BufferHandle dest, bool revert_state = true) override {
+    REI_ASSERT(is_main());
+    m_owner->record_copy_texture(list(), src, dest, revert_state);
+  }
+
+private:
+  friend class Renderer;
+
+  Renderer* const m_owner;
+  DeviceResources::RecordingContext* m_context; // null for the main list
+  bool m_open = false;
+
+  bool is_main() const { return m_context == nullptr; }
+
+  // The list to record into; on the main list, with the batched barriers issued
+  ID3D12GraphicsCommandList4* list() {
+    if (m_context) return m_context->list.Get();
+    ID3D12GraphicsCommandList4* cmd_list = m_owner->device_resources->prepare_command_list();
+    m_owner->flush_barriers(cmd_list);
+    return cmd_list;
+  }
+};
 
 // Default Constructor
 Renderer::Renderer(HINSTANCE hinstance, Options opt)
@@ -67,8 +133,11 @@ Renderer::Renderer(HINSTANCE hinstance, Options opt)
   DeviceResources::Options dev_opt;
   dev_opt.is_dxr_enabled = is_dxr_enabled;
   device_resources = std::make_shared<DeviceResources>(hinstance, dev_opt);
+  m_main_list = make_unique<CommandList>(this, nullptr);
 }
 
+Renderer::~Renderer() = default;
+
 SwapchainHandle Renderer::create_swapchain(
   SystemWindowID window_id, size_t width, size_t height, size_t rendertarget_count) {
   REI_ASSERT(window_id.platform == SystemWindowID::Win);
@@ -152,7 +221,7 @@ BufferHandle Renderer::fetch_swapchain_render_target_buffer(SwapchainHandle hand
 }
 
 BufferHandle Renderer::create_texture_2d(
-  const TextureDesc& desc, ResourceState init_state, std::wstring&& debug_name) {
+  const TextureDesc& desc, ResourceState init_state, Name debug_name) {
   auto device = device_resources->device();
   DXGI_FORMAT dxgi_format = to_dxgi_format(desc.format);
   D3D12_RESOURCE_STATES d3d_init_state = to_res_state(init_state);
@@ -185,7 +254,7 @@ BufferHandle Renderer::create_texture_2d(
     texture.buffer = tex;
   }
 #if DEBUG
-  texture.name = std::move(debug_name);
+  texture.name = debug_name;
 #endif
 
   auto res_data = make_shared<BufferData>(this);
@@ -195,7 +264,7 @@ BufferHandle Renderer::create_texture_2d(
 }
 
 BufferHandle Renderer::create_const_buffer(
-  const ConstBufferLayout& layout, size_t num, wstring&& name) {
+  const ConstBufferLayout& layout, size_t num, Name name) {
   auto device = device_resources->device();
 
   ConstBuffer cb;
@@ -208,6 +277,43 @@ BufferHandle Renderer::create_const_buffer(
   return BufferHandle(buffer_data);
 }
 
+BufferHandle Renderer::create_instance_buffer(
+  const ConstBufferLayout& layout, size_t num, Name name) {
+  auto device = device_resources->device();
+
+  // Same as a const buffer, but without the 256-byte element alignment
+  ConstBuffer cb;
+  cb.buffer = make_unique<UploadBuffer>(*device, get_width(layout), false, num);
+  cb.buffer->resource()->SetName(name.c_str());
+  cb.layout = layout;
+  auto buffer_data = make_shared<BufferData>(this);
+  buffer_data->state = cb.buffer->init_state();
+  buffer_data->res = std::move(cb);
+  return BufferHandle(buffer_data);
+}
+
+void Renderer::update_const_buffer(
+  BufferHandle handle, size_t index, const void* data, size_t bytes) {
+  auto buffer = to_buffer(handle);
+  auto& cb = buffer->res.get<ConstBuffer>();
+  REI_ASSERT(bytes == get_width(cb.layout));
+  cb.buffer->update(data, bytes, UINT(index), 0);
+}
+
+BufferHandle Renderer::create_structured_buffer(
+  const ConstBufferLayout& layout, size_t num, Name name) {
+  // An instance buffer already has the tight packing a structured buffer view needs
+  return create_instance_buffer(layout, num, name);
+}
+
+void Renderer::update_buffer_elements(
+  BufferHandle handle, size_t first, const void* data, size_t count) {
+  auto buffer = to_buffer(handle);
+  auto& cb = buffer->res.get<ConstBuffer>();
+  // Elements are contiguous, so one copy covers the whole range
+  cb.buffer->update_elements(data, UINT(first), UINT(count));
+}
+
 void Renderer::update_const_buffer(BufferHandle buffer, size_t index, size_t member, Vec4 value) {
   auto converted = rei_to_D3D(value);
   set_const_buffer(buffer, index, member, &converted, sizeof(converted));
@@ -428,6 +534,17 @@ ShaderArgumentHandle Renderer::create_shader_argument(ShaderArgumentValue arg_va
         desc.Buffer.StructureByteStride = vert.stride;
         desc.Buffer.Flags = D3D12_BUFFER_SRV_FLAG_NONE;
       },
+      [&](ConstBuffer& cb) {
+        // Structured buffer view over tightly packed elements (see create_structured_buffer)
+        REI_ASSERT(cb.buffer->element_bytewidth() == get_width(cb.layout));
+        create_ptr = cb.buffer->resource();
+        desc.Format = DXGI_FORMAT_UNKNOWN;
+        desc.ViewDimension = D3D12_SRV_DIMENSION_BUFFER;
+        desc.Buffer.FirstElement = 0;
+        desc.Buffer.NumElements = cb.buffer->size();
+        desc.Buffer.StructureByteStride = UINT(cb.buffer->element_bytewidth());
+        desc.Buffer.Flags = D3D12_BUFFER_SRV_FLAG_NONE;
+      },
       [&](TextureBuffer& tex) {
         create_ptr = tex.buffer.Get();
         desc.Format = to_dxgi_format_srv(tex.format);
@@ -474,10 +591,14 @@ ShaderArgumentHandle Renderer::create_shader_argument(ShaderArgumentValue arg_va
 }
 
 GeometryBuffers Renderer::create_geometry(const GeometryDesc& desc) {
-  // TODO currently only support mesh type
-  auto& mesh = dynamic_cast<const Mesh&>(*(desc.geometry));
+  // TODO currently only support mesh types
   MeshUploadResult res;
-  device_resources->create_mesh_buffer(mesh, res);
+  if (auto packed = dynamic_cast<const PackedMesh*>(desc.geometry.get())) {
+    device_resources->create_mesh_buffer(*packed, res);
+  } else {
+    auto& mesh = dynamic_cast<const Mesh&>(*(desc.geometry));
+    device_resources->create_mesh_buffer(mesh, res);
+  }
   GeometryBuffers ret {};
   {
     IndexBuffer ib;
@@ -612,12 +733,11 @@ void Renderer::update_shader_table(const UpdateShaderTable& cmd) {
     shader_id, local_args.data(), local_args.size() * gpu_descriptor_size, cmd.index, 0);
 }
 
-void Renderer::begin_render_pass(const RenderPassCommand& cmd) {
+void Renderer::record_render_pass(
+  ID3D12GraphicsCommandList4* cmd_list, const RenderPassCommand& cmd) {
   const RenderViewaport viewport = cmd.viewport;
   const RenderArea& area = cmd.area;
 
-  auto cmd_list = device_resources->prepare_command_list();
-
   // Set raster configs
   {
     // NOTE: DirectX viewport starts from top-left to bottom-right.
@@ -651,7 +771,7 @@ void Renderer::begin_render_pass(const RenderPassCommand& cmd) {
     for (size_t i = 0; i < cmd.render_targets.size(); i++) {
       BufferHandle render_target_h = cmd.render_targets[i];
       REI_ASSERT(render_target_h != c_empty_handle);
-      auto rt_buffer = to_buffer(render_target_h);
+      auto rt_buffer = peek_buffer(render_target_h);
       REI_ASSERT(rt_buffer);
       REI_ASSERT(rt_buffer->res.holds<TextureBuffer>());
       auto& tex = rt_buffer->res.get<TextureBuffer>();
@@ -673,7 +793,7 @@ void Renderer::begin_render_pass(const RenderPassCommand& cmd) {
   D3D12_RENDER_PASS_DEPTH_STENCIL_DESC* ds_desc_ptr = nullptr;
   D3D12_RENDER_PASS_DEPTH_STENCIL_DESC ds_desc {};
   if (cmd.depth_stencil != c_empty_handle) {
-    auto ds_buffer = to_buffer(cmd.depth_stencil);
+    auto ds_buffer = peek_buffer(cmd.depth_stencil);
     REI_ASSERT(ds_buffer && ds_buffer->res.holds<TextureBuffer>());
     auto& tex = ds_buffer->res.get<TextureBuffer>();
     ds_desc.cpuDescriptor = get_dsv_cpu(tex.buffer.Get());
@@ -698,39 +818,40 @@ void Renderer::begin_render_pass(const RenderPassCommand& cmd) {
   cmd_list->BeginRenderPass(rt_descs.size(), rt_descs.data(), ds_desc_ptr, flag);
 }
 
-void Renderer::end_render_pass() {
-  auto cmd_list = device_resources->prepare_command_list();
-  cmd_list->EndRenderPass();
-}
-
-void Renderer::transition(BufferHandle buffer_h, ResourceState state) {
-  auto cmd_list = device_resources->prepare_command_list();
-
-  auto buffer = to_buffer(buffer_h);
-  D3D12_RESOURCE_STATES to_state = to_res_state(state);
-
-  if (to_state == buffer->state) { return; }
-
-  auto barr = CD3DX12_RESOURCE_BARRIER::Transition(buffer->get_res(), buffer->state, to_state);
-  cmd_list->ResourceBarrier(1, &barr);
-
-  buffer->state = to_state;
-}
-
-void Renderer::barrier(BufferHandle buffer_h) {
-  auto buffer = to_buffer(buffer_h);
-  REI_ASSERT(buffer);
-
-  auto cmd_list = device_resources->prepare_command_list();
-  cmd_list->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::UAV(buffer->get_res()));
+void Renderer::flush_barriers(ID3D12GraphicsCommandList* cmd_list) {
+  using Barrier = decltype(m_states)::Barrier;
+  using Kind = decltype(m_states)::BarrierKind;
+  m_states.flush([&](const Barrier* barriers, size_t count) {
+    m_barrier_batch.clear();
+    for (size_t i = 0; i < count; i++) {
+      const Barrier& b = barriers[i];
+      ID3D12Resource* res = b.record->get_res();
+      switch (b.kind) {
+        case Kind::Transition:
+          m_barrier_batch.push_back(
+            CD3DX12_RESOURCE_BARRIER::Transition(res, b.before, b.after));
+          break;
+        case Kind::BeginOnly:
+          m_barrier_batch.push_back(CD3DX12_RESOURCE_BARRIER::Transition(res, b.before, b.after,
+            D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES, D3D12_RESOURCE_BARRIER_FLAG_BEGIN_ONLY));
+          break;
+        case Kind::EndOnly:
+          m_barrier_batch.push_back(CD3DX12_RESOURCE_BARRIER::Transition(res, b.before, b.after,
+            D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES, D3D12_RESOURCE_BARRIER_FLAG_END_ONLY));
+          break;
+        case Kind::UAV:
+          m_barrier_batch.push_back(CD3DX12_RESOURCE_BARRIER::UAV(res));
+          break;
+      }
+    }
+    cmd_list->ResourceBarrier(UINT(m_barrier_batch.size()), m_barrier_batch.data());
+  });
 }
 
-void Renderer::draw(const DrawCommand& cmd) {
-  auto cmd_list = device_resources->prepare_command_list();
-
+void Renderer::record_draw(ID3D12GraphicsCommandList4* cmd_list, const DrawCommand& cmd) {
   // validate
   REI_ASSERT(cmd.shader);
-  shared_ptr<RasterizationShaderData> shader = to_shader<RasterizationShaderData>(cmd.shader);
+  RasterizationShaderData* shader = peek_shader<RasterizationShaderData>(cmd.shader);
 
   // shared setup
   cmd_list->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
@@ -747,7 +868,7 @@ void Renderer::draw(const DrawCommand& cmd) {
   {
     for (UINT i = 0; i < cmd.arguments.size(); i++) {
       if (cmd.arguments[i] == c_empty_handle) continue;
-      const auto shader_arg = to_argument(cmd.arguments[i]);
+      const auto shader_arg = peek_argument(cmd.arguments[i]);
       REI_ASSERT(shader_arg);
       cmd_list->SetGraphicsRootDescriptorTable(i, shader_arg->base_descriptor_gpu);
     }
@@ -760,7 +881,7 @@ void Renderer::draw(const DrawCommand& cmd) {
   if (has_vertex) {
     UINT index_count;
     {
-      auto buffer = to_buffer(cmd.index_buffer);
+      auto buffer = peek_buffer(cmd.index_buffer);
       auto& ib = buffer->res.get<IndexBuffer>();
       index_count = ib.index_count;
       D3D12_INDEX_BUFFER_VIEW ibv;
@@ -770,7 +891,7 @@ void Renderer::draw(const DrawCommand& cmd) {
       cmd_list->IASetIndexBuffer(&ibv);
     }
     {
-      auto buffer = to_buffer(cmd.vertex_buffer);
+      auto buffer = peek_buffer(cmd.vertex_buffer);
       auto& vb = buffer->res.get<VertexBuffer>();
       D3D12_VERTEX_BUFFER_VIEW vbv;
       vbv.BufferLocation = vb.buffer->GetGPUVirtualAddress();
@@ -778,8 +899,18 @@ void Renderer::draw(const DrawCommand& cmd) {
       vbv.StrideInBytes = vb.stride;
       cmd_list->IASetVertexBuffers(0, 1, &vbv);
     }
+    if (cmd.instance_buffer) {
+      REI_ASSERT(shader->meta.input_layout.pInputElementDescs == c_instanced_input_layout);
+      auto buffer = peek_buffer(cmd.instance_buffer);
+      auto& instances = *(buffer->res.get<ConstBuffer>().buffer);
+      D3D12_VERTEX_BUFFER_VIEW vbv;
+      vbv.BufferLocation = instances.buffer_address(cmd.instance_offset);
+      vbv.SizeInBytes = UINT(cmd.instance_count * instances.element_bytewidth());
+      vbv.StrideInBytes = UINT(instances.element_bytewidth());
+      cmd_list->IASetVertexBuffers(1, 1, &vbv);
+    }
     // Draw
-    cmd_list->DrawIndexedInstanced(index_count, 1, 0, 0, 0);
+    cmd_list->DrawIndexedInstanced(index_count, cmd.instance_count, 0, 0, 0);
   } else {
     // FIXME better shortcut for blit pass
     cmd_list->IASetVertexBuffers(0, 0, NULL);
@@ -788,13 +919,12 @@ void Renderer::draw(const DrawCommand& cmd) {
   }
 }
 
-void Renderer::dispatch(const DispatchCommand& cmd) {
-  auto shader = to_shader<ComputeShaderData>(cmd.compute_shader);
+void Renderer::record_dispatch(
+  ID3D12GraphicsCommandList4* cmd_list, const DispatchCommand& cmd) {
+  auto shader = peek_shader<ComputeShaderData>(cmd.compute_shader);
   REI_ASSERT(shader);
   REI_ASSERT(cmd.dispatch_x * cmd.dispatch_y * cmd.dispatch_z > 0);
 
-  auto cmd_list = device_resources->prepare_command_list();
-
   ID3D12RootSignature* root_signature = shader->root_signature.Get();
   cmd_list->SetComputeRootSignature(root_signature);
   ID3D12PipelineState* pso = shader->pso.Get();
@@ -803,7 +933,7 @@ void Renderer::dispatch(const DispatchCommand& cmd) {
   for (UINT i = 0; i < cmd.arguments.size(); i++) {
     auto& h = cmd.arguments[i];
     if (h == c_empty_handle) continue;
-    auto arg = to_argument(h);
+    auto arg = peek_argument(h);
     REI_ASSERT(arg);
     cmd_list->SetComputeRootDescriptorTable(i, arg->base_descriptor_gpu);
   }
@@ -811,15 +941,14 @@ void Renderer::dispatch(const DispatchCommand& cmd) {
   cmd_list->Dispatch(cmd.dispatch_x, cmd.dispatch_y, cmd.dispatch_z);
 }
 
-void Renderer::raytrace(const RaytraceCommand& cmd) {
-  auto shader = to_shader<RaytracingShaderData>(cmd.raytrace_shader);
+void Renderer::record_raytrace(
+  ID3D12GraphicsCommandList4* cmd_list, const RaytraceCommand& cmd) {
+  auto shader = peek_shader<RaytracingShaderData>(cmd.raytrace_shader);
   REI_ASSERT(shader);
-  auto buffer = to_buffer(cmd.shader_table);
+  auto buffer = peek_buffer(cmd.shader_table);
   REI_ASSERT(buffer && buffer->res.holds<ShaderTableBuffer>());
   auto& shader_table = buffer->res.get<ShaderTableBuffer>();
 
-  auto cmd_list = device_resources->prepare_command_list_dxr();
-
   // Change render state
   {
     cmd_list->SetComputeRootSignature(shader->root_signature.Get());
@@ -829,7 +958,7 @@ void Renderer::raytrace(const RaytraceCommand& cmd) {
   // Bing global resource
   {
     for (UINT i = 0; i < cmd.arguments.size(); i++) {
-      const auto shader_arg = to_argument(cmd.arguments[i]);
+      const auto shader_arg = peek_argument(cmd.arguments[i]);
       if (shader_arg) {
         cmd_list->SetComputeRootDescriptorTable(i, shader_arg->base_descriptor_gpu);
       }
@@ -858,9 +987,9 @@ void Renderer::raytrace(const RaytraceCommand& cmd) {
   }
 }
 
-void Renderer::clear_texture(BufferHandle handle, Vec4 clear_value, RenderArea area) {
+void Renderer::record_clear_texture(
+  ID3D12GraphicsCommandList4* cmd_list, BufferHandle handle, Vec4 clear_value, RenderArea area) {
   auto device = device_resources->device();
-  auto cmd_list = device_resources->prepare_command_list();
 
   auto target = to_buffer(handle);
   REI_ASSERT((target->state & D3D12_RESOURCE_STATE_UNORDERED_ACCESS) == D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
@@ -903,9 +1032,9 @@ void Renderer::clear_texture(BufferHandle handle, Vec4 clear_value, RenderArea a
   cmd_list->ClearUnorderedAccessViewFloat(gpu_descriptor, cpu_descriptor, res, color, 1, &clear_rect);
 }
 
-void Renderer::copy_texture(BufferHandle src_h, BufferHandle dst_h, bool revert_state) {
+void Renderer::record_copy_texture(
+  ID3D12GraphicsCommandList4* cmd_list, BufferHandle src_h, BufferHandle dst_h, bool revert_state) {
   auto device = device_resources->device();
-  auto cmd_list = device_resources->prepare_command_list();
 
   auto src = to_buffer(src_h);
   auto dst = to_buffer(dst_h);
@@ -915,29 +1044,23 @@ void Renderer::copy_texture(BufferHandle src_h, BufferHandle dst_h, bool revert_
   REI_ASSERT(src_resource);
   REI_ASSERT(dst_resource);
 
-  D3D12_RESOURCE_BARRIER pre_copy[2];
-  pre_copy[0] = CD3DX12_RESOURCE_BARRIER::Transition(
-    src_resource, src->state, D3D12_RESOURCE_STATE_COPY_SOURCE);
-  pre_copy[1] = CD3DX12_RESOURCE_BARRIER::Transition(
-    dst_resource, dst->state, D3D12_RESOURCE_STATE_COPY_DEST);
-  cmd_list->ResourceBarrier(2, pre_copy);
+  // Batched with the transitions pending; reverting is left pending, so the next transition of
+  // either texture can cancel it
+  const D3D12_RESOURCE_STATES src_state = src->state;
+  const D3D12_RESOURCE_STATES dst_state = dst->state;
+  m_states.transition(*src, D3D12_RESOURCE_STATE_COPY_SOURCE);
+  m_states.transition(*dst, D3D12_RESOURCE_STATE_COPY_DEST);
+  flush_barriers(cmd_list);
 
   cmd_list->CopyResource(dst_resource, src_resource);
 
   if (revert_state) {
-    D3D12_RESOURCE_BARRIER post_copy[2];
-    post_copy[0] = CD3DX12_RESOURCE_BARRIER::Transition(
-      src_resource, D3D12_RESOURCE_STATE_COPY_SOURCE, src->state);
-    post_copy[1] = CD3DX12_RESOURCE_BARRIER::Transition(
-      dst_resource, D3D12_RESOURCE_STATE_COPY_DEST, dst->state);
-    cmd_list->ResourceBarrier(2, post_copy);
-  } else {
-    src->state = D3D12_RESOURCE_STATE_COPY_SOURCE;
-    dst->state = D3D12_RESOURCE_STATE_COPY_DEST;
+    m_states.transition(*src, src_state);
+    m_states.transition(*dst, dst_state);
   }
 }
 
-Renderer* Renderer::prepare() {
+rei::CommandList* Renderer::prepare() {
   // Finish previous resources commands
   upload_resources();
 
@@ -945,7 +1068,35 @@ Renderer* Renderer::prepare() {
   auto cmd_list = device_resources->prepare_command_list();
   cmd_list->SetDescriptorHeaps(1, device_resources->cbv_srv_heap_addr());
 
-  return this;
+  return m_main_list.get();
+}
+
+rei::CommandList* Renderer::open_command_list() {
+  if (m_open_list_count == m_lists.size())
+    m_lists.push_back(make_unique<CommandList>(this, nullptr));
+  CommandList* list = m_lists[m_open_list_count++].get();
+  list->m_context = device_resources->acquire_recording_context();
+  list->m_context->list->SetDescriptorHeaps(1, device_resources->cbv_srv_heap_addr());
+  list->m_open = true;
+  return list;
+}
+
+void Renderer::submit(rei::CommandList* const* lists, size_t count) {
+  // What the prepare() list recorded so far runs first, its transitions included
+  flush_barriers(device_resources->prepare_command_list());
+  vector<DeviceResources::RecordingContext*> contexts;
+  contexts.reserve(count);
+  for (size_t i = 0; i < count; i++) {
+    auto list = static_cast<CommandList*>(lists[i]);
+    REI_ASSERT(list && list->m_owner == this && list->m_open && list->m_context);
+    contexts.push_back(list->m_context);
+    list->m_open = false;
+  }
+  device_resources->execute_recording_contexts(contexts.data(), contexts.size());
+
+  // Continue on the main list
+  auto cmd_list = device_resources->prepare_command_list();
+  cmd_list->SetDescriptorHeaps(1, device_resources->cbv_srv_heap_addr());
 }
 
 void Renderer::present(SwapchainHandle handle, bool vsync) {
@@ -953,6 +1104,7 @@ void Renderer::present(SwapchainHandle handle, bool vsync) {
   REI_ASSERT(swapchain);
 
   // check state
+  flush_barriers(device_resources->prepare_command_list());
   auto rt_buffer = to_buffer(swapchain->get_curr_render_target());
   REI_ASSERT(rt_buffer->state == D3D12_RESOURCE_STATE_PRESENT);
 
@@ -971,6 +1123,13 @@ void Renderer::present(SwapchainHandle handle, bool vsync) {
   // Wait
   // FIXME should not wait
   device_resources->flush_command_queue_for_frame();
+
+  // Lists opened this frame are recycled, with their recording contexts
+  for (size_t i = 0; i < m_open_list_count; i++) {
+    REI_ASSERT(!m_lists[i]->m_open);
+    m_lists[i]->m_context = nullptr;
+  }
+  m_open_list_count = 0;
 }
 
 void Renderer::upload_resources() {
@@ -1138,6 +1297,7 @@ void Renderer::set_const_buffer(
 }
 
 D3D12_CPU_DESCRIPTOR_HANDLE Renderer::get_rtv_cpu(ID3D12Resource* texture) {
+  std::lock_guard<std::mutex> lock(m_view_cache_mutex);
   {
     auto* cached = m_rtv_cache.try_get(texture);
     if (cached) return *cached;
@@ -1153,6 +1313,7 @@ D3D12_CPU_DESCRIPTOR_HANDLE Renderer::get_rtv_cpu(ID3D12Resource* texture) {
 }
 
 D3D12_CPU_DESCRIPTOR_HANDLE Renderer::get_dsv_cpu(ID3D12Resource* texture) {
+  std::lock_guard<std::mutex> lock(m_view_cache_mutex);
   {
     auto* cached = m_dsv_cache.try_get(texture);
     if (cached) return *cached;
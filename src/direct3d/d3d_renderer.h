@@ -5,6 +5,7 @@
 
 #include <array>
 #include <memory>
+#include <mutex>
 
 #include "../algebra.h"
 #include "../camera.h"
@@ -22,6 +23,7 @@ namespace rei {
 
 namespace d3d {
 
+class CommandList;
 class DeviceResources;
 class ViewportResources;
 struct ShaderData;
@@ -38,89 +40,53 @@ public:
   };
 
   Renderer(HINSTANCE hinstance, Options options = {});
-  ~Renderer() override = default;
+  ~Renderer() override;
 
-  SwapchainHandle create_swapchain(
-    SystemWindowID window_id, size_t width, size_t height, size_t rendertarget_count);
-  BufferHandle fetch_swapchain_render_target_buffer(SwapchainHandle swapchain);
+  SwapchainHandle create_swapchain(SystemWindowID window_id, size_t width, size_t height,
+    size_t rendertarget_count) override;
+  BufferHandle fetch_swapchain_render_target_buffer(SwapchainHandle swapchain) override;
 
+  using Base::create_texture_2d;
   BufferHandle create_texture_2d(
-    const TextureDesc& desc, ResourceState init_state, std::wstring&& debug_name);
-  [[deprecated]] BufferHandle create_texture_2d(
-    size_t width, size_t height, ResourceFormat format, std::wstring&& debug_name) {
-    TextureDesc desc {width, height, format};
-    return create_texture_2d(desc, ResourceState::Undefined, std::move(debug_name));
-  }
-  [[deprecated]] BufferHandle create_unordered_access_buffer_2d(size_t width, size_t height,
-    ResourceFormat format, std::wstring&& debug_name = L"Unnamed UA Buffer") {
-    return create_texture_2d(TextureDesc::unorder_access(width, height, format),
-      ResourceState::UnorderedAccess, std ::move(debug_name));
-  }
+    const TextureDesc& desc, ResourceState init_state, Name debug_name) override;
 
   BufferHandle create_const_buffer(const ConstBufferLayout& layout, size_t num,
-    std::wstring&& debug_name = L"Unnamed ConstBuffer");
-
-  void update_const_buffer(BufferHandle buffer, size_t index, size_t member, Vec4 value);
-  void update_const_buffer(BufferHandle buffer, size_t index, size_t member, Mat4 value);
-
+    Name debug_name = L"Unnamed ConstBuffer") override;
+  BufferHandle create_instance_buffer(const ConstBufferLayout& layout, size_t num,
+    Name debug_name = L"Unnamed InstanceBuffer") override;
+  BufferHandle create_structured_buffer(const ConstBufferLayout& layout, size_t num,
+    Name debug_name = L"Unnamed StructuredBuffer") override;
+
+  void update_const_buffer(BufferHandle buffer, size_t index, size_t member, Vec4 value) override;
+  void update_const_buffer(BufferHandle buffer, size_t index, size_t member, Mat4 value) override;
+  void update_const_buffer(
+    BufferHandle buffer, size_t index, const void* data, size_t bytes) override;
+  void update_buffer_elements(
+    BufferHandle buffer, size_t first, const void* data, size_t count) override;
+
+  using Base::create_shader;
   ShaderHandle create_shader(const std::wstring& shader_path, RasterizationShaderMetaInfo&& meta,
-    const ShaderCompileConfig& config = {});
-  ShaderHandle create_shader(const std::wstring& shader_path,
-    std::unique_ptr<RasterizationShaderMetaInfo>&& meta, const ShaderCompileConfig& config = {}) {
-    return create_shader(shader_path, std::move(*meta), config);
-  }
-
+    const ShaderCompileConfig& config = {}) override;
   ShaderHandle create_shader(const std::wstring& shader_path, ComputeShaderMetaInfo&& meta,
-    const ShaderCompileConfig& config = {});
-
+    const ShaderCompileConfig& config = {}) override;
   ShaderHandle create_shader(const std::wstring& shader_path, RaytracingShaderMetaInfo&& meta,
-    const ShaderCompileConfig& config = {});
-  ShaderHandle create_raytracing_shader(const std::wstring& shader_path,
-    std::unique_ptr<RaytracingShaderMetaInfo>&& meta, const ShaderCompileConfig& config = {}) {
-    return create_shader(shader_path, std::move(*meta), config);
-  }
+    const ShaderCompileConfig& config = {}) override;
 
-  ShaderArgumentHandle create_shader_argument(ShaderArgumentValue arg_value);
-  void update_shader_argument(
-    ShaderHandle shader, ShaderArgumentValue arg_value, ShaderArgumentHandle& arg_handle);
+  ShaderArgumentHandle create_shader_argument(ShaderArgumentValue arg_value) override;
 
-  GeometryBuffers create_geometry(const GeometryDesc& geometry);
-  BufferHandle create_raytracing_accel_struct(const RaytraceSceneDesc& scene);
-  BufferHandle create_shader_table(size_t intersection_count, ShaderHandle raytracing_shader);
-  BufferHandle create_shader_table(const Scene& scene, ShaderHandle raytracing_shader);
+  GeometryBuffers create_geometry(const GeometryDesc& geometry) override;
+  BufferHandle create_raytracing_accel_struct(const RaytraceSceneDesc& scene) override;
+  BufferHandle create_shader_table(
+    size_t intersection_count, ShaderHandle raytracing_shader) override;
+  BufferHandle create_shader_table(const Scene& scene, ShaderHandle raytracing_shader) override;
 
   // void update_raygen_shader_record();
-  void update_shader_table(const UpdateShaderTable& cmd);
-
-  void begin_render_pass(const RenderPassCommand& cmd);
-  void end_render_pass();
-
-  void transition(BufferHandle buffer, ResourceState state);
-  void barrier(BufferHandle buffer);
-
-  void draw(const DrawCommand& cmd);
+  void update_shader_table(const UpdateShaderTable& cmd) override;
 
-  void dispatch(const DispatchCommand& dispatch);
-
-  void raytrace(const RaytraceCommand& cmd);
-  void raytrace(ShaderHandle raytrace_shader, ShaderArguments arguments, BufferHandle shader_table,
-    size_t width, size_t height, size_t depth = 1) {
-    RaytraceCommand cmd {};
-    cmd.raytrace_shader = raytrace_shader;
-    cmd.arguments = std::move(arguments);
-    cmd.shader_table = std::move(shader_table);
-    cmd.width = width;
-    cmd.height = height;
-    cmd.depth = depth;
-    raytrace(cmd);
-  }
-
-  void clear_texture(BufferHandle target, Vec4 clear_value, RenderArea clear_area);
-  void copy_texture(BufferHandle src, BufferHandle dest, bool revert_state = true);
-
-  // TODO return a command list object
-  Renderer* prepare();
-  void present(SwapchainHandle swapchain, bool vsync);
+  rei::CommandList* prepare() override;
+  rei::CommandList* open_command_list() override;
+  void submit(rei::CommandList* const* lists, size_t count) override;
+  void present(SwapchainHandle swapchain, bool vsync) override;
 
   DeviceResources& device() const { return *device_resources; }
 
@@ -138,10 +104,22 @@ protected:
   std::vector<ComPtr<ID3D12Resource>> m_delayed_release;
   Hashmap<BufferHandle, UINT> m_texture_clear_descriptor;
 
+  // Transitions and UAV barriers not issued yet
+  ResourceStateTracker<BufferData, D3D12_RESOURCE_STATES> m_states;
+  std::vector<D3D12_RESOURCE_BARRIER> m_barrier_batch;
+
+  friend class CommandList;
+  std::unique_ptr<CommandList> m_main_list;
+  // Lists from open_command_list(), the first `m_open_list_count` in use this frame
+  std::vector<std::unique_ptr<CommandList>> m_lists;
+  size_t m_open_list_count = 0;
+
   bool is_uploading_resources = false;
 
   Hashmap<const ID3D12Resource*, D3D12_CPU_DESCRIPTOR_HANDLE> m_dsv_cache {};
   Hashmap<const ID3D12Resource*, D3D12_CPU_DESCRIPTOR_HANDLE> m_rtv_cache {};
+  // Render passes may begin on several threads
+  std::mutex m_view_cache_mutex;
 
   // TODO move state to cmd_list object
   const RenderTargetSpec curr_target_spec {};
@@ -151,6 +129,19 @@ protected:
   UINT generate_tlas_instance_id() { return next_tlas_instance_id++; }
 
   void upload_resources();
+  // Issue the batched barriers as one ResourceBarrier call, before a command depending on them
+  void flush_barriers(ID3D12GraphicsCommandList* cmd_list);
+
+  // Commands, recorded into any command list. Render passes, draws, dispatches and traces may
+  // record on several threads at once.
+  void record_render_pass(ID3D12GraphicsCommandList4* cmd_list, const RenderPassCommand& cmd);
+  void record_draw(ID3D12GraphicsCommandList4* cmd_list, const DrawCommand& cmd);
+  void record_dispatch(ID3D12GraphicsCommandList4* cmd_list, const DispatchCommand& cmd);
+  void record_raytrace(ID3D12GraphicsCommandList4* cmd_list, const RaytraceCommand& cmd);
+  void record_clear_texture(ID3D12GraphicsCommandList4* cmd_list, BufferHandle target,
+    Vec4 clear_value, RenderArea clear_area);
+  void record_copy_texture(
+    ID3D12GraphicsCommandList4* cmd_list, BufferHandle src, BufferHandle dest, bool revert_state);
 
   void build_raytracing_pso(const std::wstring& shader_path,
     const d3d::RaytracingShaderData& shader_data, ComPtr<ID3D12StateObject>& pso);
@@ -192,6 +183,16 @@ protected:
   std::shared_ptr<ShaderArgumentData> to_argument(ShaderArgumentHandle h) {
     return get_data<ShaderArgumentHandle, ShaderArgumentData>(h);
   }
+
+  // Without reference counting, for recording on several threads
+  BufferData* peek_buffer(const BufferHandle& h) const { return peek_data<BufferData>(h); }
+  template <typename T>
+  T* peek_shader(const ShaderHandle& h) const {
+    return peek_data<T>(h);
+  }
+  ShaderArgumentData* peek_argument(const ShaderArgumentHandle& h) const {
+    return peek_data<ShaderArgumentData>(h);
+  }
 };
 
 } // namespace d3d
@@ -213,6 +213,14 @@ public:
     memcpy(mapped_memory + offset, (byte*)src, bytecount);
   }
 
+  // Copy `count` whole elements starting at `index`; elements must be tightly packed
+  void update_elements(const void* src, UINT index, UINT count) const {
+    REI_ASSERT(index + count <= m_element_num);
+    REI_ASSERT(m_element_bytewidth == m_layout.element_width);
+    UINT64 offset = buffer_offset + index * m_element_bytewidth;
+    memcpy(mapped_memory + offset, (byte*)src, count * m_element_bytewidth);
+  }
+
   template <typename Ele>
   void update(const Ele& value, UINT index, UINT local_offset = 0) const {
     update(&value, 0, sizeof(Ele), 0, index, local_offset);
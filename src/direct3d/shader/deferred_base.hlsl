@@ -1,12 +1,7 @@
 #include "deferred_common.hlsl"
+#include "raster_common.hlsl"
 
-// constant buffer to hold the projection transforming matrix
-cbuffer cbPerObject : register(b0, space0) {
-  float4x4 WVP;
-  float4x4 World;
-};
-
-ConstantBuffer<ConstBufferPerRender> g_per_render : register(b0, space1);
+ConstantBuffer<ConstBufferPerRender> g_per_render : register(b0, space0);
 
 struct VertexData {
   float4 pos : POSITION;
@@ -27,13 +22,14 @@ struct GBufferPixel {
   float4 albedo_smoothness : SV_TARGET1;
 };
 
-RasterAttr VS(VertexData vert) {
+RasterAttr VS(VertexData vert, InstanceData inst) {
   RasterAttr output;
 
-  output.pos= mul(WVP, vert.pos);
+  float4x4 world = get_world(inst);
+  float4 pos_w = mul(world, vert.pos);
+  output.pos = mul(g_per_render.camera_world_trans, pos_w);
   output.color = vert.color;
-  output.w_normal = mul(World, float4(vert.normal.xyz, 0)).xyz;
-  float4 pos_w = mul(World, vert.pos);
+  output.w_normal = mul(get_normal_matrix(inst), vert.normal.xyz);
   output.pos_w = pos_w.xyz / pos_w.w;
 
   return output;
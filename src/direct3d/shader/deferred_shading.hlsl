@@ -1,12 +1,14 @@
 #include "common.hlsl"
 #include "deferred_common.hlsl"
+#include "lights.hlsl"
 
-struct Light {
-  float4 pos_dir;
-  float4 color;
+struct LightList {
+  float4 info; // x: light count
 };
 
-ConstantBuffer<Light> g_light : register(b0, space0);
+// Scene lights
+ConstantBuffer<LightList> g_light_list : register(b0, space0);
+StructuredBuffer<Light> g_lights : register(t0, space0);
 
 ConstantBuffer<ConstBufferPerRender> g_render : register(b0, space1);
 
@@ -97,16 +99,23 @@ float4 PS(float4 pos : SV_POSITION) : SV_TARGET {
   float3 ambient = float3(0, 0, 0);
 #endif
 
-  PunctualLight light;
-  if (g_light.pos_dir.w > 0.5) { // position
-    light.dir = normalize(w_pos - g_light.pos_dir.xyz);
-  } else { // direction
-    light.dir = g_light.pos_dir.xyz;
+  // Bliin-Phong reflection with Lambertian Diffuse, summed over all lights
+  float3 radiance = surf.albedo * ambient;
+  uint light_count = uint(g_light_list.info.x);
+  for (uint i = 0; i < light_count; i++) {
+    Light l = g_lights[i];
+    if (!light_has_flag(l, LIGHT_FLAG_ENABLED)) { continue; }
+    LightSample ls;
+    if (is_area_light(l)) {
+      ls = eval_area_light(l, w_pos);
+    } else {
+      ls = eval_punctual_light(l, w_pos);
+    }
+    PunctualLight light;
+    light.dir = ls.dir;
+    light.color = ls.radiance;
+    radiance += blinn_phong(surf, light, float3(0, 0, 0), -view_dir);
   }
-  light.color = g_light.color.xyz;
-
-  // Bliin-Phong reflection with Lambertian Diffuse
-  float3 radiance = blinn_phong(surf, light, ambient, -view_dir);
 
   float3 final_color = lerp(radiance, bg_color, is_background);
   return float4(final_color, 1.0f);
@@ -1,14 +1,16 @@
 #include "common.hlsl"
 #include "hybrid_common.hlsl"
+#include "lights.hlsl"
 #include "raster_common.hlsl"
 
-struct SphericalLight {
-  float4 pos_radius; // for dir, w is zero; for pos, w is 1.
-  float4 color;   // hdr color, defined as irradiance * PI, aka lambertian response
+struct LightPass {
+  float4 info; // x: light count
+  float4 noise_offset;
 };
 
-// Per light data
-ConstantBuffer<SphericalLight> g_light : register(b0, space0);
+// Scene lights
+ConstantBuffer<LightPass> g_pass : register(b0, space0);
+StructuredBuffer<Light> g_lights : register(t0, space0);
 
 // G-buffers
 Texture2D<float> g_depth : register(t0, space1);
@@ -40,22 +42,6 @@ void output(uint2 index, float3 radiance) {
   float4 w_coord = mul(get_view_proj_inv(g_render), ndc);
   float3 w_pos = w_coord.xyz / w_coord.w;
 
-  // Decode light data
-  float3 light_dir;
-  float3 light_color;
-
-  float3 delta = g_light.pos_radius.xyz - w_pos;
-  float dist_0 = sqrt(dot(delta, delta));
-  float radius = g_light.pos_radius.w;
-  float dist = dist_0 - radius;
-  light_dir = normalize(delta);
-  float dist2 = dist * dist;
-  // fake disk-like area light with solid angle 
-  float rant = radius / dist;
-  float theta = atan2(radius, dist);
-  float solid_angle = (1 - cos(theta)) * PI_2;
-  light_color = g_light.color.xyz * solid_angle;
-
   // Evalute BRDF for surface
   float4 rt0 = g_rt0[tid.xy];
   float4 rt1 = g_rt1[tid.xy];
@@ -63,11 +49,18 @@ void output(uint2 index, float3 radiance) {
   Surface surf = decode_gbuffer(rt0, rt1, rt2);
   BXDFSurface bxdf = to_bxdf(surf);
   float3 viewer_dir = normalize(g_render.camera_pos.xyz - w_pos);
-  BrdfCosine brdf_cos = BRDF_GGX_Lambertian(bxdf, viewer_dir, light_dir);
 
   // fake de decrease for highlight
   float attenuation = pow(max(1 - surf.smoothness, EPS), 2);
 
-  float3 reflectance = (brdf_cos.specular + brdf_cos.diffuse) * light_color * attenuation;
+  float3 reflectance = float3(0, 0, 0);
+  uint light_count = uint(g_pass.info.x);
+  for (uint i = 0; i < light_count; i++) {
+    Light light = g_lights[i];
+    if (!light_has_flag(light, LIGHT_FLAG_ENABLED) || !is_area_light(light)) { continue; }
+    LightSample ls = eval_area_light(light, w_pos);
+    BrdfCosine brdf_cos = BRDF_GGX_Lambertian(bxdf, viewer_dir, ls.dir);
+    reflectance += (brdf_cos.specular + brdf_cos.diffuse) * ls.radiance * attenuation;
+  }
   output(tid.xy, reflectance);
 }
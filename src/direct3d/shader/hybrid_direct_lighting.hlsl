@@ -1,14 +1,16 @@
 #include "common.hlsl"
 #include "hybrid_common.hlsl"
+#include "lights.hlsl"
 #include "raster_common.hlsl"
 
-struct Light {
-  float4 pos_dir; // for dir, w is zero; for pos, w is 1.
-  float4 color;   // hdr color, defined as irradiance * PI, aka lambertian response
+struct LightPass {
+  float4 info; // x: light count
+  float4 noise_offset;
 };
 
-// Per light data
-ConstantBuffer<Light> g_light : register(b0, space0);
+// Scene lights
+ConstantBuffer<LightPass> g_pass : register(b0, space0);
+StructuredBuffer<Light> g_lights : register(t0, space0);
 
 // G-buffers
 Texture2D<float> g_depth : register(t0, space1);
@@ -32,8 +34,8 @@ void CS(uint3 tid :SV_DispatchThreadId) {
   float z = g_depth[tid.xy];
 
   // skip backgroug pixel
-  if (z <= EPS) { 
-    return; 
+  if (z <= EPS) {
+    return;
   }
 
   // get world pos from depth
@@ -42,19 +44,6 @@ void CS(uint3 tid :SV_DispatchThreadId) {
   float4 w_coord = mul(get_view_proj_inv(g_render), ndc);
   float3 w_pos = w_coord.xyz / w_coord.w;
 
-  // Decode light data
-  float3 light_dir;
-  float3 light_color;
-  if (g_light.pos_dir.w > 0.5) { // position
-    float3 diff = g_light.pos_dir.xyz - w_pos;
-    light_dir = normalize(diff);
-    float dist2 = dot(diff, diff);
-    light_color = g_light.color.xyz / dist2;
-  } else { // direction
-    light_dir = g_light.pos_dir.xyz;
-    light_color = g_light.color.xyz;
-  }
-
   // Evalute BRDF for surface
   float4 rt0 = g_rt0[tid.xy];
   float4 rt1 = g_rt1[tid.xy];
@@ -62,11 +51,18 @@ void CS(uint3 tid :SV_DispatchThreadId) {
   Surface surf = decode_gbuffer(rt0, rt1, rt2);
   BXDFSurface bxdf = to_bxdf(surf);
   float3 viewer_dir = normalize(g_render.camera_pos.xyz - w_pos);
-  BrdfCosine brdf_cos = BRDF_GGX_Lambertian(bxdf, viewer_dir, light_dir);
 
   // TODO shadow
   float attenuation = 1.0;
 
-  float3 reflectance = (brdf_cos.specular + brdf_cos.diffuse) * light_color * attenuation;
+  float3 reflectance = float3(0, 0, 0);
+  uint light_count = uint(g_pass.info.x);
+  for (uint i = 0; i < light_count; i++) {
+    Light light = g_lights[i];
+    if (!light_has_flag(light, LIGHT_FLAG_ENABLED) || is_area_light(light)) { continue; }
+    LightSample ls = eval_punctual_light(light, w_pos);
+    BrdfCosine brdf_cos = BRDF_GGX_Lambertian(bxdf, viewer_dir, ls.dir);
+    reflectance += (brdf_cos.specular + brdf_cos.diffuse) * ls.radiance * attenuation;
+  }
   output(tid.xy, reflectance);
 }
@@ -1,8 +1,9 @@
 #include "hybrid_common.hlsl"
+#include "raster_common.hlsl"
 
-cbuffer cbPerObject : register(b0, space0) {
-  float4x4 WVP;
-  float4x4 World;
+// Possibly jittered, so not the one in the per-render CB
+cbuffer cbPerView : register(b0, space0) {
+  float4x4 ViewProj;
 };
 
 ConstantBuffer<PerMaterialConstBuffer> g_per_material : register(b0, space1);
@@ -22,13 +23,14 @@ struct RasterAttr {
   float3 w_normal : NORMAL;
 };
 
-RasterAttr VS(VertexData vert) {
+RasterAttr VS(VertexData vert, InstanceData inst) {
   RasterAttr output;
 
-  output.pos= mul(WVP, vert.pos);
+  float4x4 world = get_world(inst);
+  float4 pos_w = mul(world, vert.pos);
+  output.pos = mul(ViewProj, pos_w);
   output.color = vert.color;
-  output.w_normal = mul(World, float4(vert.normal.xyz, 0)).xyz;
-  float4 pos_w = mul(World, vert.pos);
+  output.w_normal = mul(get_normal_matrix(inst), vert.normal.xyz);
   output.pos_w = pos_w.xyz / pos_w.w;
 
   return output;
@@ -175,7 +175,8 @@ void output(float3 color) {
 
   float2 bary = attr.barycentrics.xy;
   float3 n = n0 + bary.x * (n1 - n0) + bary.y * (n2 - n0);
-  n = normalize(n);
+  // Vertices are in mesh space; transform by the inverse-transpose of the instance transform
+  n = normalize(mul(n, (float3x3)WorldToObject3x4()));
 
   Surface surf;
   fill_surface(g_material, n, surf);
@@ -2,16 +2,17 @@
 #include "hybrid_common.hlsl"
 #include "raster_common.hlsl"
 #include "blue_noise.hlsl"
+#include "lights.hlsl"
 
-struct SphericalLight {
-  float4 pos_radius; // for dir, w is zero; for pos, w is 1.
-  float4 color;   // hdr color, defined as irradiance * PI, aka lambertian response
-// addional sampling data
+struct LightPass {
+  float4 info; // x: index of the sampled light
+  // addional sampling data
   float4 noise_offset;
 };
 
-// Per light data
-ConstantBuffer<SphericalLight> g_light : register(b0, space0);
+// Per sample pass data, and the scene lights
+ConstantBuffer<LightPass> g_pass : register(b0, space0);
+StructuredBuffer<Light> g_lights : register(t0, space0);
 
 // G-buffers
 Texture2D<float> g_depth : register(t0, space1);
@@ -62,17 +63,22 @@ float3 shpere_sample(float3 center, float radius, float3 viewer, float rnd0, flo
   float4 w_coord = mul(get_view_proj_inv(g_render), ndc);
   float3 w_pos = w_coord.xyz / w_coord.w;
 
-  // Take a random light position
+  // Take a random light position; tubes are sampled as a sphere around a random point on the axis
+  Light light = g_lights[uint(g_pass.info.x)];
   float2 blue_rnd = blue_noise2(tid.xy);
-  float2 rnd = frac(g_light.noise_offset.zw + blue_rnd);
+  float2 rnd = frac(g_pass.noise_offset.zw + blue_rnd);
+  float3 center = light.position_range.xyz;
+  if (light_type(light) == LIGHT_TUBE) {
+    float t = frac(g_pass.noise_offset.y + blue_rnd.x + blue_rnd.y) - 0.5;
+    center += light.direction_type.xyz * (light.shape.w * t);
+  }
   float pdf;
-  float3 p = shpere_sample(g_light.pos_radius.xyz, g_light.pos_radius.w, w_pos, rnd.x, rnd.y, pdf);
+  float3 p = shpere_sample(center, light.shape.z, w_pos, rnd.x, rnd.y, pdf);
   float3 delta = p - w_pos;
   float dist2 = dot(delta, delta);
   float dist = sqrt(dist2);
   float3 light_dir = delta / dist;
-  float3 light_color = g_light.color.xyz / dist2;
-  light_color = g_light.color.xyz;
+  float3 light_color = light.radiance.xyz * range_falloff(light, dist);
 
   // Evalute BRDF for surface
   float4 rt0 = g_rt0[tid.xy];
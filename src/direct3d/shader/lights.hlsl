@@ -0,0 +1,101 @@
+#ifndef REI_LIGHTS_HLSL
+#define REI_LIGHTS_HLSL
+
+#include "common.hlsl"
+
+//
+// Scene lights, as packed by LightStore::pack (see PackedLight in light_store.h)
+//
+
+#define LIGHT_POINT 0
+#define LIGHT_SPOT 1
+#define LIGHT_DIRECTIONAL 2
+#define LIGHT_SPHERE 3
+#define LIGHT_TUBE 4
+
+#define LIGHT_FLAG_ENABLED 1
+#define LIGHT_FLAG_CAST_SHADOW 2
+
+struct Light {
+  float4 position_range; // w: range, 0 for unlimited
+  float4 direction_type; // unit direction the light shines along; w: type
+  float4 radiance;       // color * intensity; w: flags
+  float4 shape;          // cos(outer angle), cos(inner angle), radius, length
+};
+
+uint light_type(Light l) {
+  return uint(l.direction_type.w);
+}
+
+bool light_has_flag(Light l, uint flag) {
+  return (uint(l.radiance.w) & flag) != 0;
+}
+
+bool is_area_light(Light l) {
+  uint type = light_type(l);
+  return type == LIGHT_SPHERE || type == LIGHT_TUBE;
+}
+
+// Center of the light as seen from p; for tubes, the closest point on the axis
+float3 light_center(Light l, float3 p) {
+  float3 center = l.position_range.xyz;
+  if (light_type(l) == LIGHT_TUBE) {
+    float half_length = l.shape.w * 0.5;
+    float t = clamp(dot(p - center, l.direction_type.xyz), -half_length, half_length);
+    center += l.direction_type.xyz * t;
+  }
+  return center;
+}
+
+// Smooth cut-off towards the light range
+float range_falloff(Light l, float dist) {
+  float range = l.position_range.w;
+  if (range <= 0) { return 1; }
+  float r = dist / range;
+  float window = saturate(1 - r * r * r * r);
+  return window * window;
+}
+
+struct LightSample {
+  float3 dir;      // from the shaded point to the light
+  float3 radiance; // arriving at the shaded point
+};
+
+// Point, spot and directional lights
+LightSample eval_punctual_light(Light l, float3 w_pos) {
+  LightSample s;
+  if (light_type(l) == LIGHT_DIRECTIONAL) {
+    s.dir = -l.direction_type.xyz;
+    s.radiance = l.radiance.xyz;
+    return s;
+  }
+
+  float3 delta = l.position_range.xyz - w_pos;
+  float dist2 = max(dot(delta, delta), 1e-8);
+  float dist = sqrt(dist2);
+  s.dir = delta / dist;
+  float falloff = range_falloff(l, dist) / dist2;
+  if (light_type(l) == LIGHT_SPOT) {
+    float cos_angle = dot(-s.dir, l.direction_type.xyz);
+    falloff *= smoothstep(l.shape.x, l.shape.y, cos_angle);
+  }
+  s.radiance = l.radiance.xyz * falloff;
+  return s;
+}
+
+// Sphere and tube lights, lit from their representative point and weighted by the solid angle
+// of a disk of the light radius facing the shaded point
+LightSample eval_area_light(Light l, float3 w_pos) {
+  LightSample s;
+  float3 delta = light_center(l, w_pos) - w_pos;
+  float dist_0 = sqrt(dot(delta, delta));
+  float radius = l.shape.z;
+  float dist = max(dist_0 - radius, 1e-4);
+  s.dir = delta / max(dist_0, 1e-8);
+  float theta = atan2(radius, dist);
+  float solid_angle = (1 - cos(theta)) * PI_2;
+  s.radiance = l.radiance.xyz * solid_angle * range_falloff(l, dist);
+  return s;
+}
+
+#endif
@@ -1,6 +1,30 @@
 #ifndef REI_RASTER_COMMON_HLSL
 #define REI_RASTER_COMMON_HLSL
 
+//
+// Instancing helper
+
+// Per-instance vertex input; matrices come in column by column (as in const buffers)
+struct InstanceData {
+  float4 world0 : INSTANCE_WORLD0;
+  float4 world1 : INSTANCE_WORLD1;
+  float4 world2 : INSTANCE_WORLD2;
+  float4 world3 : INSTANCE_WORLD3;
+  float4 normal0 : INSTANCE_NORMAL0;
+  float4 normal1 : INSTANCE_NORMAL1;
+  float4 normal2 : INSTANCE_NORMAL2;
+};
+
+float4x4 get_world(InstanceData inst) {
+  return transpose(float4x4(inst.world0, inst.world1, inst.world2, inst.world3));
+}
+
+// Inverse-transpose of the world matrix (up to scale); keeps normals perpendicular to surfaces
+// under non-uniform scale
+float3x3 get_normal_matrix(InstanceData inst) {
+  return transpose(float3x3(inst.normal0.xyz, inst.normal1.xyz, inst.normal2.xyz));
+}
+
 //
 // Screen pass helper
 
@@ -127,7 +127,8 @@ float3 sample_lambertian_brdf(float3 normal, float rnd0, float rnd1, out float p
 
   float2 bary = attr.barycentrics.xy;
   float3 n = n0 + bary.x * (n1 - n0) + bary.y * (n2 - n0);
-  n = normalize(n);
+  // Vertices are in mesh space; transform by the inverse-transpose of the instance transform
+  n = normalize(mul(n, (float3x3)WorldToObject3x4()));
 
   // Get hitpoint world pos
   float3 world_pos = WorldRayOrigin() + RayTCurrent() * WorldRayDirection();
@@ -1,5 +1,6 @@
 #include "geometry.h"
 
+#include <atomic>
 #include <sstream>
 #include <unordered_map>
 #include <vector>
@@ -12,20 +13,71 @@ using std::wstring;
 
 namespace rei {
 
+namespace {
+
+std::atomic<Geometry::Version> g_geometry_version {0};
+
+} // namespace
+
 Geometry::~Geometry() {
   // Default behaviour
 }
 
+Geometry::Version Geometry::latest_version() {
+  return g_geometry_version.load(std::memory_order_acquire);
+}
+
+Geometry::Version Geometry::next_version() {
+  return g_geometry_version.fetch_add(1, std::memory_order_acq_rel) + 1;
+}
+
 void Mesh::set(std::vector<Vertex>&& va, const std::vector<size_type>& ta) {
-  m_vertices = va;
+  m_vertices = std::move(va);
   m_triangles.reserve(ta.size() / 3);
-  for (size_type i = 0; i < va.size(); i += 3)
+  for (size_type i = 0; i < ta.size(); i += 3)
     m_triangles.emplace_back(ta[i], ta[i + 1], ta[i + 2]);
+  m_unoccluded_colors.clear();
+  touch();
 }
 
 void Mesh::set(std::vector<Vertex>&& va, std::vector<Triangle>&& ta) {
-  m_vertices = va;
-  m_triangles = ta;
+  m_vertices = std::move(va);
+  m_triangles = std::move(ta);
+  m_unoccluded_colors.clear();
+  touch();
+}
+
+void Mesh::set_vertex_colors(const std::vector<Color>& colors) {
+  REI_ASSERT(colors.size() == m_vertices.size());
+  for (size_type i = 0; i < m_vertices.size(); i++)
+    m_vertices[i].color = colors[i];
+  m_unoccluded_colors.clear();
+  touch();
+}
+
+void Mesh::set_vertex_occlusion(const std::vector<float>& occlusion) {
+  REI_ASSERT(occlusion.size() == m_vertices.size());
+  if (m_unoccluded_colors.empty()) {
+    m_unoccluded_colors.reserve(m_vertices.size());
+    for (const Vertex& v : m_vertices)
+      m_unoccluded_colors.push_back(v.color);
+  }
+  for (size_type i = 0; i < m_vertices.size(); i++) {
+    const Color& c = m_unoccluded_colors[i];
+    const float occ = occlusion[i];
+    m_vertices[i].color = Color(c.r * occ, c.g * occ, c.b * occ, c.a);
+  }
+  touch();
+}
+
+void Mesh::set_skin(std::vector<Bone>&& bones, std::vector<BoneWeights>&& weights) {
+  REI_ASSERT(weights.size() == m_vertices.size());
+  for (const BoneWeights& w : weights)
+    for (int i = 0; i < 4; i++)
+      REI_ASSERT(w.weights[i] == 0 || w.bones[i] < bones.size());
+  m_bones = std::move(bones);
+  m_bone_weights = std::move(weights);
+  touch();
 }
 
 // Debug print info
@@ -44,6 +96,19 @@ wstring Mesh::summary() const {
   return oss.str();
 }
 
+wstring PackedMesh::summary() const {
+  std::wostringstream oss;
+  oss << "Packed mesh name: " << name << ", vertices : " << m_vertex_num
+      << ", triangles: " << m_index_num / 3 << endl;
+  return oss.str();
+}
+
+wstring PendingGeometry::summary() const {
+  std::wostringstream oss;
+  oss << "Pending geometry name: " << name << " (not loaded yet)" << endl;
+  return oss.str();
+}
+
 Mesh Mesh::procudure_cube(Vec3 extent, Vec3 origin, bool flip) {
   extent.x = std::abs(extent.x);
   extent.y = std::abs(extent.y);
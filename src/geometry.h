@@ -1,6 +1,8 @@
 #ifndef REI_GEOMETRY_H
 #define REI_GEOMETRY_H
 
+#include <cstdint>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -14,11 +16,21 @@ namespace rei {
 // Base class for all geometry object
 class Geometry : public NoCopy {
 public:
-  Geometry(std::wstring name) : name(name) {};
+  using Version = std::uint64_t;
+
+  Geometry(Name name) : name(name) {};
   virtual ~Geometry() = 0;
 
   Geometry(Geometry&& other) = default;
 
+  const Name& get_name() const { return name; }
+
+  // Stamped by every change of the geometry data, from one counter shared by all geometries, so
+  // consumers holding uploaded copies can tell them stale; 0 for a geometry never changed.
+  // Nothing changed anywhere while latest_version() stays the same.
+  Version version() const { return m_version; }
+  static Version latest_version();
+
   // Debug info
   virtual std::wstring summary() const { return L"<Base Geomtry>"; }
   friend std::wostream& operator<<(std::wostream& os, const Geometry& g) {
@@ -26,7 +38,14 @@ public:
   }
 
 protected:
-  std::wstring name;
+  Name name;
+
+  void touch() { m_version = next_version(); }
+
+private:
+  Version m_version = 0;
+
+  static Version next_version();
 };
 
 typedef std::shared_ptr<Geometry> GeometryPtr;
@@ -57,6 +76,17 @@ public:
     TriangleTpl(VertexId a, VertexId b, VertexId c) : a(a), b(b), c(c) {};
   };
 
+  // Skinning streams: up to 4 bone influences per vertex; unused slots have zero weight
+  struct BoneWeights {
+    std::uint16_t bones[4];
+    float weights[4]; // sum to 1
+  };
+  // A bone of the skin: the node driving it, and its inverse bind matrix (mesh space to bone space)
+  struct Bone {
+    Name name;
+    Mat4 offset;
+  };
+
   // Type alias
   using size_type = std::vector<Vertex>::size_type;
   using Size = std::vector<Vertex>::size_type;
@@ -64,9 +94,9 @@ public:
   using Index = size_type;
 
   [[deprecated]] Mesh(std::string n)
-      : Geometry(L"deprecated") {REI_DEPRECATED} Mesh(std::wstring n = L"Mesh Un-named")
+      : Geometry(L"deprecated") {REI_DEPRECATED} Mesh(Name n = L"Mesh Un-named")
       : Geometry(n) {}
-  Mesh(std::wstring name, std::vector<Vertex> vertices, std::vector<Triangle>&& triangles)
+  Mesh(Name name, std::vector<Vertex> vertices, std::vector<Triangle>&& triangles)
       : Geometry(name), m_vertices(vertices), m_triangles(triangles) {}
 
   Mesh(Mesh&& other) = default;
@@ -76,6 +106,18 @@ public:
   // Set data (by vertives index triplet array)
   void set(std::vector<Vertex>&& va, std::vector<Triangle>&& ta);
 
+  // Overwrite the color stream; `colors` has one entry per vertex
+  void set_vertex_colors(const std::vector<Color>& colors);
+  // Scale the color stream by per-vertex occlusion in [0, 1]. The colors from before the first
+  // call are kept, so writing occlusion again replaces the previous one instead of compounding.
+  void set_vertex_occlusion(const std::vector<float>& occlusion);
+
+  // Make the mesh skinned; `weights` has one entry per vertex, referring to `bones`
+  void set_skin(std::vector<Bone>&& bones, std::vector<BoneWeights>&& weights);
+  bool skinned() const { return !m_bones.empty(); }
+  const std::vector<Bone>& get_bones() const { return m_bones; }
+  const std::vector<BoneWeights>& get_bone_weights() const { return m_bone_weights; }
+
   // Basic queries
   const std::vector<Vertex>& get_vertices() const { return m_vertices; }
   const std::vector<Triangle>& get_triangles() const { return m_triangles; }
@@ -100,11 +142,79 @@ public:
 
 private:
   std::vector<Vertex> m_vertices;
+  std::vector<Color> m_unoccluded_colors; // empty until set_vertex_occlusion()
   std::vector<Triangle> m_triangles;
+  std::vector<Bone> m_bones;
+  std::vector<BoneWeights> m_bone_weights;
 };
 
 typedef std::shared_ptr<Mesh> MeshPtr;
 
+/*
+ * Triangle mesh already in GPU upload layout (float vertices, 16-bit indices), viewing storage
+ * owned by someone else, e.g. a memory-mapped scene archive. The storage is kept alive by a
+ * shared owner, and the streams are uploaded as-is.
+ */
+class PackedMesh : public Geometry {
+public:
+  struct Vertex {
+    float position[4];
+    float color[4];
+    float normal[3];
+  };
+  using Index = std::uint16_t;
+
+  PackedMesh(Name name, std::shared_ptr<const void> owner, const Vertex* vertices,
+    size_t vertex_num, const Index* indices, size_t index_num, Vec3 bound_min, Vec3 bound_max)
+      : Geometry(name),
+        m_owner(std::move(owner)),
+        m_vertices(vertices),
+        m_indices(indices),
+        m_vertex_num(vertex_num),
+        m_index_num(index_num),
+        m_bound_min(bound_min),
+        m_bound_max(bound_max) {}
+
+  const Vertex* vertices() const { return m_vertices; }
+  const Index* indices() const { return m_indices; }
+  size_t vertices_num() const { return m_vertex_num; }
+  size_t indices_num() const { return m_index_num; }
+
+  // Object-space bounds, precomputed so no vertex has to be touched
+  Vec3 bound_min() const { return m_bound_min; }
+  Vec3 bound_max() const { return m_bound_max; }
+
+  std::wstring summary() const override;
+
+private:
+  std::shared_ptr<const void> m_owner;
+  const Vertex* m_vertices;
+  const Index* m_indices;
+  size_t m_vertex_num;
+  size_t m_index_num;
+  Vec3 m_bound_min;
+  Vec3 m_bound_max;
+};
+
+/*
+ * Stands in for geometry that is still being loaded. It has bounds but no data, so culling and
+ * the spatial index see the model, while pipelines skip it until the real geometry is set.
+ */
+class PendingGeometry : public Geometry {
+public:
+  PendingGeometry(Name name, Vec3 bound_min, Vec3 bound_max)
+      : Geometry(name), m_bound_min(bound_min), m_bound_max(bound_max) {}
+
+  Vec3 bound_min() const { return m_bound_min; }
+  Vec3 bound_max() const { return m_bound_max; }
+
+  std::wstring summary() const override;
+
+private:
+  Vec3 m_bound_min;
+  Vec3 m_bound_max;
+};
+
 } // namespace rei
 
 #endif // !REI_GEOMETRY_H
@@ -1,6 +1,8 @@
 #ifndef REI_GRAPHIC_HANDLE_H
 #define REI_GRAPHIC_HANDLE_H
 
+#include <memory>
+
 #include "algebra.h"
 
 /*
@@ -44,7 +46,7 @@ enum class ResourceState {
 
 struct GraphicData {
   GraphicData(Renderer* owner) : owner(owner) {}
-  const Renderer const* owner; // as a marker
+  const Renderer* owner; // as a marker
 };
 
 struct BaseScreenTransformData : GraphicData {
@@ -0,0 +1,793 @@
+// source of image_codec.h
+#include "image_codec.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#include "debug.h"
+#include "mapped_file.h"
+#include "string_utils.h"
+
+using std::string;
+using std::uint16_t;
+using std::uint32_t;
+using std::uint64_t;
+using std::uint8_t;
+using std::vector;
+
+namespace rei {
+
+namespace {
+
+// Inflate ///////////////////////////////////////////////////////////////////
+
+// LSB-first bit reader over a byte range; reading past the end yields zeros and sets overrun()
+class BitReader {
+public:
+  BitReader(const uint8_t* data, size_t size) : m_p(data), m_end(data + size) {}
+
+  // Top up the buffer to at least 57 bits
+  void refill() {
+    while (m_count <= 56) {
+      if (m_p < m_end)
+        m_bits |= uint64_t(*m_p++) << m_count;
+      else
+        m_pad++;
+      m_count += 8;
+    }
+  }
+
+  uint32_t peek(int n) const { return uint32_t(m_bits & ((uint64_t(1) << n) - 1)); }
+  uint32_t peek_bit(int i) const { return uint32_t(m_bits >> i) & 1; }
+  void consume(int n) {
+    m_bits >>= n;
+    m_count -= n;
+  }
+  uint32_t get(int n) {
+    if (m_count < n) refill();
+    const uint32_t v = peek(n);
+    consume(n);
+    return v;
+  }
+
+  // True if bits past the end of the data were consumed
+  bool overrun() const { return m_count < int(m_pad * 8); }
+
+  // Skip to the next byte boundary and return the position of the first unread byte; the reader
+  // continues from resume()
+  const uint8_t* release() {
+    consume(m_count % 8);
+    if (overrun()) return nullptr;
+    const uint8_t* p = m_p - (m_count / 8 - m_pad);
+    m_bits = 0;
+    m_count = 0;
+    m_pad = 0;
+    return p;
+  }
+  void resume(const uint8_t* p) { m_p = p; }
+  const uint8_t* end() const { return m_end; }
+
+private:
+  const uint8_t* m_p;
+  const uint8_t* m_end;
+  uint64_t m_bits = 0;
+  int m_count = 0;
+  size_t m_pad = 0; // zero bytes appended past the end
+};
+
+// Canonical Huffman code; codes up to k_fast_bits long are decoded with one table lookup
+struct Huffman {
+  static constexpr int k_fast_bits = 10;
+  uint16_t fast[1 << k_fast_bits]; // (symbol << 4) | length, or 0
+  uint16_t count[16];              // codes of each length
+  uint16_t symbol[288];            // by code
+
+  // Return false if the code lengths are over-subscribed
+  bool build(const uint8_t* lengths, int n) {
+    std::fill(count, count + 16, uint16_t(0));
+    for (int i = 0; i < n; i++)
+      count[lengths[i]]++;
+    count[0] = 0;
+    int left = 1;
+    for (int len = 1; len < 16; len++) {
+      left = (left << 1) - count[len];
+      if (left < 0) return false;
+    }
+
+    uint16_t offset[16] = {};
+    uint32_t next_code[16] = {};
+    for (int len = 1; len < 15; len++)
+      offset[len + 1] = offset[len] + count[len];
+    for (int len = 1; len < 16; len++)
+      next_code[len] = (next_code[len - 1] + count[len - 1]) << 1;
+    for (int i = 0; i < n; i++)
+      if (lengths[i]) symbol[offset[lengths[i]]++] = uint16_t(i);
+
+    std::fill(fast, fast + (1 << k_fast_bits), uint16_t(0));
+    for (int i = 0; i < n; i++) {
+      const int len = lengths[i];
+      if (!len) continue;
+      const uint32_t code = next_code[len]++;
+      if (len > k_fast_bits) continue;
+      uint32_t reversed = 0;
+      for (int b = 0; b < len; b++)
+        reversed |= ((code >> b) & 1) << (len - 1 - b);
+      for (uint32_t j = reversed; j < (1u << k_fast_bits); j += 1u << len)
+        fast[j] = uint16_t((i << 4) | len);
+    }
+    return true;
+  }
+
+  // Next symbol, or -1 for an invalid code
+  int decode(BitReader& br) const {
+    br.refill();
+    const uint16_t e = fast[br.peek(k_fast_bits)];
+    if (e) {
+      br.consume(e & 15);
+      return e >> 4;
+    }
+    int code = 0, first = 0, index = 0;
+    for (int len = 1; len < 16; len++) {
+      code |= int(br.peek_bit(len - 1));
+      if (code - first < count[len]) {
+        br.consume(len);
+        return symbol[index + code - first];
+      }
+      index += count[len];
+      first = (first + count[len]) << 1;
+      code <<= 1;
+    }
+    return -1;
+  }
+};
+
+const uint16_t k_length_base[29] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35,
+  43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+const uint8_t k_length_extra[29]
+  = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+const uint16_t k_dist_base[30] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257,
+  385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+const uint8_t k_dist_extra[30] = {
+  0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+const uint8_t k_code_length_order[19]
+  = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+
+// Code lengths of a dynamic block
+bool read_dynamic_codes(BitReader& br, Huffman& lit, Huffman& dist) {
+  const int hlit = int(br.get(5)) + 257;
+  const int hdist = int(br.get(5)) + 1;
+  const int hclen = int(br.get(4)) + 4;
+  if (hlit > 286 || hdist > 30) return false;
+
+  uint8_t cl_lengths[19] = {};
+  for (int i = 0; i < hclen; i++)
+    cl_lengths[k_code_length_order[i]] = uint8_t(br.get(3));
+  Huffman cl;
+  if (!cl.build(cl_lengths, 19)) return false;
+
+  uint8_t lengths[286 + 30] = {};
+  int n = 0;
+  while (n < hlit + hdist) {
+    const int sym = cl.decode(br);
+    if (sym < 0) return false;
+    if (sym < 16) {
+      lengths[n++] = uint8_t(sym);
+      continue;
+    }
+    uint8_t value = 0;
+    int repeat;
+    if (sym == 16) {
+      if (n == 0) return false;
+      value = lengths[n - 1];
+      repeat = 3 + int(br.get(2));
+    } else if (sym == 17) {
+      repeat = 3 + int(br.get(3));
+    } else {
+      repeat = 11 + int(br.get(7));
+    }
+    if (n + repeat > hlit + hdist) return false;
+    std::fill(lengths + n, lengths + n + repeat, value);
+    n += repeat;
+  }
+  if (lengths[256] == 0) return false; // no end-of-block code
+  return lit.build(lengths, hlit) && dist.build(lengths + hlit, hdist);
+}
+
+void fixed_codes(Huffman& lit, Huffman& dist) {
+  uint8_t lengths[288];
+  std::fill(lengths, lengths + 144, uint8_t(8));
+  std::fill(lengths + 144, lengths + 256, uint8_t(9));
+  std::fill(lengths + 256, lengths + 280, uint8_t(7));
+  std::fill(lengths + 280, lengths + 288, uint8_t(8));
+  lit.build(lengths, 288);
+  std::fill(lengths, lengths + 30, uint8_t(5));
+  dist.build(lengths, 30);
+}
+
+// Raw deflate stream into out[0, out_size); return the end of the stream, or nullptr on error
+const uint8_t* inflate_raw(BitReader& br, uint8_t* out, size_t out_size, size_t& written) {
+  size_t pos = 0;
+  Huffman lit, dist;
+  bool last = false;
+  while (!last) {
+    last = br.get(1) != 0;
+    const uint32_t type = br.get(2);
+    if (type == 0) {
+      const uint8_t* p = br.release();
+      if (!p || br.end() - p < 4) return nullptr;
+      const size_t len = size_t(p[0]) | size_t(p[1]) << 8;
+      const size_t nlen = size_t(p[2]) | size_t(p[3]) << 8;
+      p += 4;
+      if (len != (~nlen & 0xFFFF) || size_t(br.end() - p) < len || out_size - pos < len)
+        return nullptr;
+      std::memcpy(out + pos, p, len);
+      pos += len;
+      br.resume(p + len);
+      continue;
+    }
+    if (type == 1)
+      fixed_codes(lit, dist);
+    else if (type != 2 || !read_dynamic_codes(br, lit, dist))
+      return nullptr;
+
+    for (;;) {
+      const int sym = lit.decode(br);
+      if (sym < 256) {
+        if (sym < 0 || pos == out_size) return nullptr;
+        out[pos++] = uint8_t(sym);
+        continue;
+      }
+      if (sym == 256) break;
+      const int l = sym - 257;
+      if (l >= 29) return nullptr;
+      const size_t len = k_length_base[l] + br.get(k_length_extra[l]);
+      const int d = dist.decode(br);
+      if (d < 0 || d >= 30) return nullptr;
+      const size_t distance = k_dist_base[d] + br.get(k_dist_extra[d]);
+      if (distance > pos || len > out_size - pos) return nullptr;
+      uint8_t* dst = out + pos;
+      const uint8_t* src = dst - distance;
+      if (distance >= len)
+        std::memcpy(dst, src, len);
+      else
+        for (size_t k = 0; k < len; k++) // overlapping: repeats the last `distance` bytes
+          dst[k] = src[k];
+      pos += len;
+    }
+    if (br.overrun()) return nullptr;
+  }
+  written = pos;
+  return br.release();
+}
+
+uint32_t adler32(const uint8_t* data, size_t size) {
+  uint32_t a = 1, b = 0;
+  while (size) {
+    const size_t n = (std::min)(size, size_t(5552)); // largest run without overflow
+    for (size_t i = 0; i < n; i++) {
+      a += data[i];
+      b += a;
+    }
+    a %= 65521;
+    b %= 65521;
+    data += n;
+    size -= n;
+  }
+  return (b << 16) | a;
+}
+
+uint32_t read_be32(const uint8_t* p) {
+  return uint32_t(p[0]) << 24 | uint32_t(p[1]) << 16 | uint32_t(p[2]) << 8 | p[3];
+}
+
+// Largest decoded image, in pixels
+constexpr uint64_t k_max_pixels = uint64_t(1) << 28;
+
+// PNG ///////////////////////////////////////////////////////////////////////
+
+struct PngHeader {
+  uint32_t width = 0, height = 0;
+  int depth = 0, color_type = 0, interlace = 0;
+  int channels() const {
+    switch (color_type) {
+      case 2: return 3;
+      case 4: return 2;
+      case 6: return 4;
+      default: return 1;
+    }
+  }
+  size_t row_bytes(uint32_t pixels) const {
+    return (size_t(pixels) * channels() * depth + 7) / 8;
+  }
+};
+
+// Adam7 passes; a non-interlaced image is the single pass {0, 0, 1, 1}
+struct PngPass {
+  uint32_t x0, y0, dx, dy;
+  uint32_t width(uint32_t w) const { return w > x0 ? (w - x0 + dx - 1) / dx : 0; }
+  uint32_t height(uint32_t h) const { return h > y0 ? (h - y0 + dy - 1) / dy : 0; }
+};
+const PngPass k_adam7[7] = {{0, 0, 8, 8}, {4, 0, 8, 8}, {0, 4, 4, 8}, {2, 0, 4, 4}, {0, 2, 2, 4},
+  {1, 0, 2, 2}, {0, 1, 1, 2}};
+const PngPass k_single_pass = {0, 0, 1, 1};
+
+uint8_t paeth(int a, int b, int c) {
+  const int p = a + b - c;
+  const int pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+  if (pa <= pb && pa <= pc) return uint8_t(a);
+  return uint8_t(pb <= pc ? b : c);
+}
+
+// Undo the per-row filters of a pass in place; rows are [filter byte][row_bytes]
+bool unfilter(uint8_t* rows, size_t row_bytes, uint32_t height, size_t bpp) {
+  const size_t stride = row_bytes + 1;
+  for (uint32_t y = 0; y < height; y++) {
+    uint8_t* cur = rows + y * stride + 1;
+    const uint8_t* prev = y ? cur - stride : nullptr;
+    switch (cur[-1]) {
+      case 0: break;
+      case 1:
+        for (size_t i = bpp; i < row_bytes; i++)
+          cur[i] = uint8_t(cur[i] + cur[i - bpp]);
+        break;
+      case 2:
+        if (prev)
+          for (size_t i = 0; i < row_bytes; i++)
+            cur[i] = uint8_t(cur[i] + prev[i]);
+        break;
+      case 3:
+        for (size_t i = 0; i < row_bytes; i++) {
+          const int left = i >= bpp ? cur[i - bpp] : 0;
+          const int up = prev ? prev[i] : 0;
+          cur[i] = uint8_t(cur[i] + ((left + up) >> 1));
+        }
+        break;
+      case 4:
+        for (size_t i = 0; i < row_bytes; i++) {
+          const int left = i >= bpp ? cur[i - bpp] : 0;
+          const int up = prev ? prev[i] : 0;
+          const int up_left = prev && i >= bpp ? prev[i - bpp] : 0;
+          cur[i] = uint8_t(cur[i] + paeth(left, up, up_left));
+        }
+        break;
+      default: return false;
+    }
+  }
+  return true;
+}
+
+struct PngPalette {
+  uint8_t rgba[256][4];
+  int size = 0;
+  // Color key from tRNS for gray and true-color images, in sample units
+  bool has_key = false;
+  uint16_t key[3] = {};
+};
+
+// Write the pixels of one unfiltered pass to their places in out
+void expand_pass(const PngHeader& h, const PngPass& pass, const uint8_t* rows, size_t row_bytes,
+  const PngPalette& palette, uint8_t* out) {
+  const uint32_t pw = pass.width(h.width), ph = pass.height(h.height);
+  const int channels = h.channels();
+  const int depth = h.depth;
+  const uint32_t max_sample = (1u << depth) - 1;
+  for (uint32_t j = 0; j < ph; j++) {
+    const uint8_t* row = rows + j * (row_bytes + 1) + 1;
+    uint8_t* dst_row = out + (size_t(pass.y0 + j * pass.dy) * h.width + pass.x0) * 4;
+    for (uint32_t i = 0; i < pw; i++) {
+      // Samples at full precision
+      uint32_t s[4];
+      for (int c = 0; c < channels; c++) {
+        const size_t index = size_t(i) * channels + c;
+        if (depth == 8)
+          s[c] = row[index];
+        else if (depth == 16)
+          s[c] = uint32_t(row[index * 2]) << 8 | row[index * 2 + 1];
+        else
+          s[c] = (row[index * depth / 8] >> (8 - depth - index * depth % 8)) & max_sample;
+      }
+      auto to8 = [&](uint32_t v) -> uint8_t {
+        return depth == 16 ? uint8_t(v >> 8) : uint8_t(v * 255 / max_sample);
+      };
+      uint8_t* dst = dst_row + size_t(i) * pass.dx * 4;
+      switch (h.color_type) {
+        case 0:
+          dst[0] = dst[1] = dst[2] = to8(s[0]);
+          dst[3] = palette.has_key && s[0] == palette.key[0] ? 0 : 255;
+          break;
+        case 2:
+          dst[0] = to8(s[0]), dst[1] = to8(s[1]), dst[2] = to8(s[2]);
+          dst[3] = palette.has_key && s[0] == palette.key[0] && s[1] == palette.key[1]
+                       && s[2] == palette.key[2]
+                     ? 0
+                     : 255;
+          break;
+        case 3: std::memcpy(dst, palette.rgba[s[0]], 4); break;
+        case 4:
+          dst[0] = dst[1] = dst[2] = to8(s[0]);
+          dst[3] = to8(s[1]);
+          break;
+        default:
+          for (int c = 0; c < 4; c++)
+            dst[c] = to8(s[c]);
+          break;
+      }
+    }
+  }
+}
+
+// TGA ///////////////////////////////////////////////////////////////////////
+
+// One pixel of `bits` bits to RGBA; `attribute_alpha` if the 16/32-bit alpha bits are used
+void tga_color(const uint8_t* p, int bits, bool gray, bool attribute_alpha, uint8_t* rgba) {
+  auto five = [](uint32_t v) { return uint8_t((v << 3) | (v >> 2)); };
+  if (gray) {
+    rgba[0] = rgba[1] = rgba[2] = p[0];
+    rgba[3] = bits == 16 ? p[1] : 255;
+    return;
+  }
+  switch (bits) {
+    case 15:
+    case 16: {
+      const uint32_t v = uint32_t(p[0]) | uint32_t(p[1]) << 8;
+      rgba[0] = five((v >> 10) & 31), rgba[1] = five((v >> 5) & 31), rgba[2] = five(v & 31);
+      rgba[3] = bits == 16 && attribute_alpha ? ((v & 0x8000) ? 255 : 0) : 255;
+      break;
+    }
+    case 24: rgba[0] = p[2], rgba[1] = p[1], rgba[2] = p[0], rgba[3] = 255; break;
+    default: rgba[0] = p[2], rgba[1] = p[1], rgba[2] = p[0], rgba[3] = attribute_alpha ? p[3] : 255;
+  }
+}
+
+// HDR ///////////////////////////////////////////////////////////////////////
+
+// Radiance's convention: the mantissa is the center of its bucket
+void rgbe_to_float(const uint8_t* rgbe, float* rgba) {
+  if (rgbe[3] == 0) {
+    rgba[0] = rgba[1] = rgba[2] = 0.f;
+  } else {
+    const float f = std::ldexp(1.f, int(rgbe[3]) - (128 + 8));
+    for (int c = 0; c < 3; c++)
+      rgba[c] = (float(rgbe[c]) + 0.5f) * f;
+  }
+  rgba[3] = 1.f;
+}
+
+// One scanline of `width` RGBE pixels, advancing p
+bool read_hdr_scanline(const uint8_t*& p, const uint8_t* end, uint32_t width, uint8_t* rgbe) {
+  const bool per_channel = width >= 8 && width < 0x8000 && end - p >= 4 && p[0] == 2
+                           && p[1] == 2 && (uint32_t(p[2]) << 8 | p[3]) == width;
+  if (per_channel) {
+    p += 4;
+    for (int c = 0; c < 4; c++) {
+      uint32_t x = 0;
+      while (x < width) {
+        if (p >= end) return false;
+        uint32_t n = *p++;
+        if (n > 128) {
+          n -= 128;
+          if (p >= end || n > width - x) return false;
+          for (const uint8_t v = *p++; n; n--, x++)
+            rgbe[x * 4 + c] = v;
+        } else {
+          if (n == 0 || n > width - x || uint32_t(end - p) < n) return false;
+          for (; n; n--, x++)
+            rgbe[x * 4 + c] = *p++;
+        }
+      }
+    }
+    return true;
+  }
+
+  // Flat pixels, where (1, 1, 1, n) repeats the previous pixel n times (shifted by 8 bits per
+  // consecutive repeat record)
+  uint32_t x = 0;
+  int shift = 0;
+  while (x < width) {
+    if (end - p < 4) return false;
+    if (p[0] == 1 && p[1] == 1 && p[2] == 1) {
+      const uint64_t n = uint64_t(p[3]) << shift;
+      if (x == 0 || n > width - x) return false;
+      for (uint64_t k = 0; k < n; k++, x++)
+        std::memcpy(rgbe + x * 4, rgbe + (x - 1) * 4, 4);
+      shift += 8;
+    } else {
+      std::memcpy(rgbe + x * 4, p, 4);
+      x++;
+      shift = 0;
+    }
+    p += 4;
+  }
+  return true;
+}
+
+} // namespace
+
+bool inflate_zlib(const uint8_t* data, size_t size, size_t expected_bytes, vector<uint8_t>& out) {
+  if (size < 6) return false;
+  const uint32_t cmf = data[0], flg = data[1];
+  if ((cmf & 15) != 8 || (cmf >> 4) > 7 || (cmf * 256 + flg) % 31 != 0 || (flg & 0x20))
+    return false; // not deflate, or a preset dictionary
+  out.resize(expected_bytes);
+  BitReader br(data + 2, size - 2);
+  size_t written = 0;
+  const uint8_t* end = inflate_raw(br, out.data(), out.size(), written);
+  if (!end || written != expected_bytes || data + size - end < 4) return false;
+  return read_be32(end) == adler32(out.data(), out.size());
+}
+
+bool decode_png(const uint8_t* data, size_t size, Image& out) {
+  auto fail = [](const char* what) {
+    REI_WARNING(string("PNG: ") + what);
+    return false;
+  };
+  static const uint8_t signature[8] = {137, 80, 78, 71, 13, 10, 26, 10};
+  if (size < 8 || std::memcmp(data, signature, 8) != 0) return fail("bad signature");
+
+  // Chunks; CRCs are not checked, since the zlib stream carries its own checksum
+  PngHeader h;
+  PngPalette palette;
+  vector<const uint8_t*> idat;
+  vector<size_t> idat_bytes;
+  bool has_header = false, has_end = false;
+  size_t pos = 8;
+  while (!has_end && size - pos >= 12) {
+    const size_t len = read_be32(data + pos);
+    const uint8_t* type = data + pos + 4;
+    const uint8_t* body = data + pos + 8;
+    if (len > size - pos - 12) return fail("truncated chunk");
+    auto is = [&](const char* name) { return std::memcmp(type, name, 4) == 0; };
+    if (is("IHDR")) {
+      if (len != 13) return fail("bad header");
+      h.width = read_be32(body), h.height = read_be32(body + 4);
+      h.depth = body[8], h.color_type = body[9], h.interlace = body[12];
+      if (body[10] != 0 || body[11] != 0 || h.interlace > 1) return fail("unknown method");
+      has_header = true;
+    } else if (is("PLTE")) {
+      if (len % 3 || len > 768) return fail("bad palette");
+      palette.size = int(len / 3);
+      for (int i = 0; i < palette.size; i++) {
+        std::memcpy(palette.rgba[i], body + i * 3, 3);
+        palette.rgba[i][3] = 255;
+      }
+    } else if (is("tRNS")) {
+      if (h.color_type == 3) {
+        for (size_t i = 0; i < len && i < 256; i++)
+          palette.rgba[i][3] = body[i];
+      } else if ((h.color_type == 0 && len == 2) || (h.color_type == 2 && len == 6)) {
+        palette.has_key = true;
+        for (size_t c = 0; c < len / 2; c++)
+          palette.key[c] = uint16_t(body[c * 2] << 8 | body[c * 2 + 1]);
+      }
+    } else if (is("IDAT")) {
+      idat.push_back(body);
+      idat_bytes.push_back(len);
+    } else if (is("IEND")) {
+      has_end = true;
+    } else if (!(type[0] & 0x20)) {
+      return fail("unknown critical chunk");
+    }
+    pos += len + 12;
+  }
+  if (!has_header || idat.empty()) return fail("missing header or data");
+
+  // Valid depths per color type: 0: 1/2/4/8/16, 2/4/6: 8/16, 3: 1/2/4/8
+  const bool valid_depth = [&] {
+    switch (h.color_type) {
+      case 0: return h.depth == 1 || h.depth == 2 || h.depth == 4 || h.depth == 8 || h.depth == 16;
+      case 3: return h.depth == 1 || h.depth == 2 || h.depth == 4 || h.depth == 8;
+      case 2:
+      case 4:
+      case 6: return h.depth == 8 || h.depth == 16;
+      default: return false;
+    }
+  }();
+  if (!valid_depth) return fail("bad color type or bit depth");
+  if (h.color_type == 3 && palette.size == 0) return fail("missing palette");
+  if (h.width == 0 || h.height == 0 || uint64_t(h.width) * h.height > k_max_pixels)
+    return fail("bad size");
+
+  // Decompressed size, over all passes
+  const PngPass* passes = h.interlace ? k_adam7 : &k_single_pass;
+  const int pass_num = h.interlace ? 7 : 1;
+  size_t raw_bytes = 0;
+  for (int p = 0; p < pass_num; p++) {
+    const uint32_t pw = passes[p].width(h.width), ph = passes[p].height(h.height);
+    if (pw && ph) raw_bytes += size_t(ph) * (h.row_bytes(pw) + 1);
+  }
+
+  // Usually a single IDAT; otherwise the zlib stream is split over several
+  vector<uint8_t> joined;
+  const uint8_t* stream = idat[0];
+  size_t stream_bytes = idat_bytes[0];
+  if (idat.size() > 1) {
+    for (size_t i = 0; i < idat.size(); i++)
+      joined.insert(joined.end(), idat[i], idat[i] + idat_bytes[i]);
+    stream = joined.data();
+    stream_bytes = joined.size();
+  }
+  vector<uint8_t> raw;
+  if (!inflate_zlib(stream, stream_bytes, raw_bytes, raw)) return fail("bad zlib stream");
+
+  out.width = h.width;
+  out.height = h.height;
+  out.hdr = false;
+  out.rgba32f.clear();
+  out.rgba8.assign(out.pixel_num() * 4, 0);
+  const size_t bpp = (std::max)(1, h.channels() * h.depth / 8);
+  uint8_t* rows = raw.data();
+  for (int p = 0; p < pass_num; p++) {
+    const uint32_t pw = passes[p].width(h.width), ph = passes[p].height(h.height);
+    if (!pw || !ph) continue;
+    const size_t row_bytes = h.row_bytes(pw);
+    if (!unfilter(rows, row_bytes, ph, bpp)) return fail("bad filter");
+    expand_pass(h, passes[p], rows, row_bytes, palette, out.rgba8.data());
+    rows += size_t(ph) * (row_bytes + 1);
+  }
+  return true;
+}
+
+bool decode_tga(const uint8_t* data, size_t size, Image& out) {
+  auto fail = [](const char* what) {
+    REI_WARNING(string("TGA: ") + what);
+    return false;
+  };
+  if (size < 18) return fail("truncated header");
+  const int id_length = data[0];
+  const int map_type = data[1];
+  const int image_type = data[2];
+  const size_t map_first = size_t(data[3]) | size_t(data[4]) << 8;
+  const size_t map_length = size_t(data[5]) | size_t(data[6]) << 8;
+  const int map_bits = data[7];
+  const uint32_t width = uint32_t(data[12]) | uint32_t(data[13]) << 8;
+  const uint32_t height = uint32_t(data[14]) | uint32_t(data[15]) << 8;
+  const int bits = data[16];
+  const int descriptor = data[17];
+  const bool attribute_alpha = (descriptor & 15) != 0;
+
+  const bool rle = image_type >= 9;
+  const int base_type = rle ? image_type - 8 : image_type;
+  const bool mapped = base_type == 1, gray = base_type == 3;
+  if (base_type < 1 || base_type > 3) return fail("unsupported image type");
+  if (width == 0 || height == 0) return fail("bad size");
+  if (mapped ? (map_type != 1 || (bits != 8 && bits != 16))
+             : gray ? (bits != 8 && bits != 16)
+                    : (bits != 15 && bits != 16 && bits != 24 && bits != 32))
+    return fail("unsupported pixel depth");
+
+  const uint8_t* p = data + 18 + id_length;
+  const uint8_t* end = data + size;
+  if (p > end) return fail("truncated");
+
+  // Color map, converted to RGBA up front
+  vector<uint8_t> map;
+  if (map_type == 1) {
+    if (map_bits != 15 && map_bits != 16 && map_bits != 24 && map_bits != 32)
+      return fail("unsupported color map depth");
+    const size_t entry_bytes = (map_bits + 7) / 8;
+    if (size_t(end - p) < map_length * entry_bytes) return fail("truncated color map");
+    map.resize((map_first + map_length) * 4, 0);
+    for (size_t i = 0; i < map_length; i++)
+      tga_color(p + i * entry_bytes, map_bits, false, attribute_alpha, &map[(map_first + i) * 4]);
+    p += map_length * entry_bytes;
+  }
+
+  const size_t pixel_bytes = size_t(bits + 7) / 8;
+  const size_t pixel_num = size_t(width) * height;
+  out.width = width;
+  out.height = height;
+  out.hdr = false;
+  out.rgba32f.clear();
+  out.rgba8.assign(pixel_num * 4, 0);
+
+  // Pixels in file order, then placed by the origin bits
+  const bool top_down = (descriptor & 0x20) != 0;
+  const bool right_to_left = (descriptor & 0x10) != 0;
+  auto place = [&](size_t i) {
+    const size_t y = i / width, x = i % width;
+    const size_t row = top_down ? y : height - 1 - y;
+    const size_t col = right_to_left ? width - 1 - x : x;
+    return &out.rgba8[(row * width + col) * 4];
+  };
+  auto convert = [&](const uint8_t* src, uint8_t* rgba) {
+    if (!mapped) {
+      tga_color(src, bits, gray, attribute_alpha, rgba);
+      return true;
+    }
+    const size_t index = bits == 8 ? src[0] : size_t(src[0]) | size_t(src[1]) << 8;
+    if (index * 4 >= map.size()) return false;
+    std::memcpy(rgba, &map[index * 4], 4);
+    return true;
+  };
+
+  size_t i = 0;
+  while (i < pixel_num) {
+    size_t count = 1;
+    bool repeat = false;
+    if (rle) {
+      if (p >= end) return fail("truncated");
+      repeat = (*p & 0x80) != 0;
+      count = (std::min)(size_t(*p++ & 0x7F) + 1, pixel_num - i);
+    } else {
+      count = pixel_num;
+    }
+    const size_t read = repeat ? 1 : count;
+    if (size_t(end - p) < read * pixel_bytes) return fail("truncated");
+    for (size_t k = 0; k < count; k++, i++)
+      if (!convert(p + (repeat ? 0 : k * pixel_bytes), place(i))) return fail("bad color index");
+    p += read * pixel_bytes;
+  }
+  return true;
+}
+
+bool decode_hdr(const uint8_t* data, size_t size, Image& out) {
+  auto fail = [](const char* what) {
+    REI_WARNING(string("HDR: ") + what);
+    return false;
+  };
+  const uint8_t* p = data;
+  const uint8_t* end = data + size;
+  auto next_line = [&]() {
+    const uint8_t* eol = static_cast<const uint8_t*>(std::memchr(p, '\n', end - p));
+    if (!eol) eol = end;
+    string line(reinterpret_cast<const char*>(p), eol - p);
+    p = eol < end ? eol + 1 : end;
+    return line;
+  };
+
+  if (size < 2 || p[0] != '#' || p[1] != '?') return fail("bad signature");
+  for (;;) {
+    if (p >= end) return fail("truncated header");
+    const string line = next_line();
+    if (line.empty()) break;
+    if (line.compare(0, 7, "FORMAT=") == 0 && line != "FORMAT=32-bit_rle_rgbe")
+      return fail("unsupported pixel format");
+  }
+  int w = 0, h = 0;
+  const string resolution = next_line();
+  if (std::sscanf(resolution.c_str(), "-Y %d +X %d", &h, &w) != 2)
+    return fail("unsupported orientation");
+  if (w <= 0 || h <= 0 || uint64_t(w) * uint64_t(h) > k_max_pixels) return fail("bad size");
+
+  out.width = uint32_t(w);
+  out.height = uint32_t(h);
+  out.hdr = true;
+  out.rgba8.clear();
+  out.rgba32f.resize(out.pixel_num() * 4);
+  vector<uint8_t> rgbe(size_t(w) * 4);
+  for (uint32_t y = 0; y < out.height; y++) {
+    if (!read_hdr_scanline(p, end, out.width, rgbe.data())) return fail("bad scanline");
+    float* row = &out.rgba32f[size_t(y) * out.width * 4];
+    for (uint32_t x = 0; x < out.width; x++)
+      rgbe_to_float(&rgbe[x * 4], row + x * 4);
+  }
+  return true;
+}
+
+bool has_image_decoder(const string& filename) {
+  const string ext = lower_extension(filename);
+  return ext == ".png" || ext == ".tga" || ext == ".hdr";
+}
+
+bool decode_image(const string& filename, Image& out) {
+  MappedFile file;
+  if (!file.open(filename)) {
+    REI_WARNING("ImageCodec: cannot map " + filename);
+    return false;
+  }
+  const string ext = lower_extension(filename);
+  bool ok = false;
+  if (ext == ".png")
+    ok = decode_png(file.data(), file.size(), out);
+  else if (ext == ".tga")
+    ok = decode_tga(file.data(), file.size(), out);
+  else if (ext == ".hdr")
+    ok = decode_hdr(file.data(), file.size(), out);
+  else
+    REI_WARNING("ImageCodec: unsupported format " + filename);
+  return ok;
+}
+
+} // namespace rei
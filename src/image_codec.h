@@ -0,0 +1,58 @@
+#ifndef REI_IMAGE_CODEC_H
+#define REI_IMAGE_CODEC_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*
+ * image_codec.h
+ * Decoders for the texture source formats: PNG, TGA and Radiance HDR.
+ */
+
+namespace rei {
+
+// Decoded pixels, rows top to bottom; 8-bit sources fill rgba8, HDR sources fill rgba32f
+struct Image {
+  std::uint32_t width = 0;
+  std::uint32_t height = 0;
+  bool hdr = false;
+  std::vector<std::uint8_t> rgba8;
+  std::vector<float> rgba32f; // linear
+
+  size_t pixel_num() const { return size_t(width) * height; }
+};
+
+/*
+ * Decompress a zlib stream (RFC 1950/1951) into out, which must end up exactly `expected_bytes`
+ * long. The Adler-32 checksum is verified.
+ */
+bool inflate_zlib(
+  const std::uint8_t* data, size_t size, size_t expected_bytes, std::vector<std::uint8_t>& out);
+
+/*
+ * PNG: every color type, bit depths 1 to 16 and Adam7 interlacing; palette and tRNS
+ * transparency are expanded to RGBA. 16-bit channels keep their high byte. Gamma and color
+ * space chunks are ignored (8-bit color is taken as sRGB).
+ *
+ * TGA: true-color, grayscale and color-mapped images, raw or run-length encoded, in 8/15/16/24/32
+ * bits per pixel and either origin.
+ *
+ * HDR: Radiance RGBE with flat, old-style or per-channel run-length scanlines, in the standard
+ * -Y +X orientation.
+ *
+ * Return false, with a warning, if the data is malformed or uses an unsupported feature.
+ */
+bool decode_png(const std::uint8_t* data, size_t size, Image& out);
+bool decode_tga(const std::uint8_t* data, size_t size, Image& out);
+bool decode_hdr(const std::uint8_t* data, size_t size, Image& out);
+
+// True for the extensions decode_image understands (.png, .tga, .hdr, in any case)
+bool has_image_decoder(const std::string& filename);
+
+// Map the file and decode it by its extension
+bool decode_image(const std::string& filename, Image& out);
+
+} // namespace rei
+
+#endif
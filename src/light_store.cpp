@@ -0,0 +1,170 @@
+// source of light_store.h
+#include "light_store.h"
+
+#include <cmath>
+
+namespace rei {
+
+LightHandle LightStore::create(const Light& light) {
+  std::uint32_t index;
+  if (!m_free_slots.empty()) {
+    index = m_free_slots.front();
+    m_free_slots.pop_front();
+  } else {
+    index = std::uint32_t(m_slots.size());
+    if (index > LightHandle::k_index_mask) {
+      REI_ERROR("LightStore is out of handle slots");
+      return LightHandle();
+    }
+    m_slots.emplace_back();
+  }
+
+  Slot& slot = m_slots[index];
+  const size_t dense = m_handles.size();
+  slot.dense = std::uint32_t(dense);
+  LightHandle h(index, slot.generation);
+  for_columns([](auto& column) { column.emplace_back(); });
+  m_handles[dense] = h;
+  write(dense, light);
+  return h;
+}
+
+void LightStore::destroy(LightHandle h) {
+  if (!valid(h)) {
+    REI_WARNING("Destroying an invalid light handle");
+    return;
+  }
+  Slot& slot = m_slots[h.index()];
+  const std::uint32_t dense = slot.dense;
+  const std::uint32_t last = std::uint32_t(m_handles.size() - 1);
+  if (dense != last) {
+    for_columns([&](auto& column) { column[dense] = std::move(column[last]); });
+    m_slots[m_handles[dense].index()].dense = dense;
+  }
+  for_columns([](auto& column) { column.pop_back(); });
+  // The moved light now lives at `dense`, so its packed copy is stale
+  if (dense != last)
+    touch(dense);
+  else
+    ++m_version;
+
+  slot.dense = k_no_dense;
+  if (slot.generation < LightHandle::k_max_generation) {
+    slot.generation++;
+    m_free_slots.push_back(h.index());
+  }
+}
+
+void LightStore::clear() {
+  for (size_t i = m_handles.size(); i-- > 0;)
+    destroy(m_handles[i]);
+}
+
+void LightStore::reserve(size_t n) {
+  for_columns([n](auto& column) { column.reserve(n); });
+}
+
+Light LightStore::get(LightHandle h) const {
+  const size_t i = dense_index(h);
+  const Shape& s = m_shapes[i];
+  Light l;
+  l.type = m_types[i];
+  l.flags = m_flags[i];
+  l.position = m_positions[i];
+  l.direction = m_directions[i];
+  l.color = m_colors[i];
+  l.intensity = m_intensities[i];
+  l.range = s.range;
+  l.inner_angle = s.inner_angle;
+  l.outer_angle = s.outer_angle;
+  l.radius = s.radius;
+  l.length = s.length;
+  l.name = m_names[i];
+  return l;
+}
+
+void LightStore::set(LightHandle h, const Light& light) {
+  write(dense_index(h), light);
+}
+
+void LightStore::set_position(LightHandle h, const Vec3& position) {
+  const size_t i = dense_index(h);
+  m_positions[i] = position;
+  touch(i);
+}
+
+void LightStore::set_direction(LightHandle h, const Vec3& direction) {
+  const size_t i = dense_index(h);
+  m_directions[i] = direction.normalized();
+  touch(i);
+}
+
+void LightStore::set_intensity(LightHandle h, double intensity) {
+  const size_t i = dense_index(h);
+  m_intensities[i] = intensity;
+  touch(i);
+}
+
+void LightStore::mark_changed(const LightHandle* handles, size_t count) {
+  for (size_t i = 0; i < count; i++)
+    if (valid(handles[i])) touch(m_slots[handles[i].index()].dense);
+}
+
+void LightStore::write(size_t dense, const Light& light) {
+  REI_ASSERT(light.inner_angle <= light.outer_angle);
+  m_types[dense] = light.type;
+  m_flags[dense] = light.flags;
+  m_positions[dense] = light.position;
+  m_directions[dense] = light.direction.normalized();
+  m_colors[dense] = light.color;
+  m_intensities[dense] = light.intensity;
+  m_shapes[dense]
+    = {light.range, light.inner_angle, light.outer_angle, light.radius, light.length};
+  m_names[dense] = light.name;
+  touch(dense);
+}
+
+void LightStore::changed_range(Version since, size_t& first, size_t& last) const {
+  first = last = 0;
+  if (since >= m_version) return;
+  const size_t n = m_versions.size();
+  size_t i = 0;
+  while (i < n && m_versions[i] <= since)
+    i++;
+  if (i == n) return;
+  size_t j = n;
+  while (m_versions[j - 1] <= since)
+    j--;
+  first = i;
+  last = j;
+}
+
+void LightStore::pack(size_t first, size_t last, PackedLight* out) const {
+  REI_ASSERT(first <= last && last <= size());
+  for (size_t i = first; i < last; i++) {
+    PackedLight& p = out[i - first];
+    const Vec3& pos = m_positions[i];
+    const Vec3& dir = m_directions[i];
+    const Shape& s = m_shapes[i];
+    const Color& c = m_colors[i];
+    const float intensity = float(m_intensities[i]);
+    p.position_range[0] = float(pos.x);
+    p.position_range[1] = float(pos.y);
+    p.position_range[2] = float(pos.z);
+    p.position_range[3] = float(s.range);
+    p.direction_type[0] = float(dir.x);
+    p.direction_type[1] = float(dir.y);
+    p.direction_type[2] = float(dir.z);
+    p.direction_type[3] = float(m_types[i]);
+    p.radiance[0] = c.r * intensity;
+    p.radiance[1] = c.g * intensity;
+    p.radiance[2] = c.b * intensity;
+    p.radiance[3] = float(m_flags[i]);
+    p.shape[0] = float(std::cos(s.outer_angle));
+    p.shape[1] = float(std::cos(s.inner_angle));
+    p.shape[2] = float(s.radius);
+    p.shape[3] = float(s.length);
+  }
+}
+
+} // namespace rei
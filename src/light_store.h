@@ -0,0 +1,230 @@
+#ifndef REI_LIGHT_STORE_H
+#define REI_LIGHT_STORE_H
+
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+#include "algebra.h"
+#include "color.h"
+#include "common.h"
+#include "debug.h"
+#include "rmath.h"
+
+/*
+ * light_store.h
+ * Data-oriented storage of scene lights, and the packed layout pipelines upload them in.
+ */
+
+namespace rei {
+
+enum class LightType : std::uint32_t {
+  Point,
+  Spot,
+  Directional,
+  Sphere, // area light; a point light with a radius
+  Tube,   // area light; a capsule of `length` along the direction
+};
+
+/*
+ * One light, as it is added and read back. Positions and directions are in world space.
+ * `color * intensity` is the radiant intensity of punctual lights (the irradiance of directional
+ * lights), and the radiance leaving the surface of area lights.
+ */
+struct Light {
+  enum Flag : std::uint32_t {
+    Enabled = 1 << 0,
+    CastShadow = 1 << 1,
+  };
+  static constexpr std::uint32_t k_default_flags = Enabled | CastShadow;
+
+  LightType type = LightType::Point;
+  std::uint32_t flags = k_default_flags;
+  Vec3 position;              // ignored by directional lights
+  Vec3 direction {0, -1, 0};  // where the light shines; spot axis, tube axis
+  Color color = Colors::white;
+  double intensity = 1;
+  double range = 0;           // no light beyond it; 0 for unlimited (inverse-square only)
+  double inner_angle = 0;     // spot cone half-angles, radians; full intensity inside inner
+  double outer_angle = pi / 4;
+  double radius = 0;          // sphere and tube
+  double length = 0;          // tube, centered on the position
+  Name name;
+
+  static Light point(const Vec3& position, const Color& color, double intensity) {
+    Light l;
+    l.position = position;
+    l.color = color;
+    l.intensity = intensity;
+    return l;
+  }
+  static Light directional(const Vec3& direction, const Color& color, double intensity) {
+    Light l;
+    l.type = LightType::Directional;
+    l.direction = direction.normalized();
+    l.color = color;
+    l.intensity = intensity;
+    return l;
+  }
+};
+
+/*
+ * A light as the shaders read it: four float4 per light, in one structured buffer. Mirrored by
+ * `Light` in direct3d/shader/lights.hlsl.
+ */
+struct alignas(16) PackedLight {
+  float position_range[4]; // w: range, 0 for unlimited
+  float direction_type[4]; // unit direction; w: LightType
+  float radiance[4];       // color * intensity; w: flags
+  float shape[4];          // cos(outer angle), cos(inner angle), radius, length
+};
+static_assert(sizeof(PackedLight) == 64, "PackedLight must match the shader layout");
+
+/*
+ * 32-bit light handle: 24-bit slot index and 8-bit generation, like ModelHandle.
+ * A zero value is the null handle (generations start at 1).
+ */
+struct LightHandle {
+  static constexpr std::uint32_t k_index_bits = 24;
+  static constexpr std::uint32_t k_index_mask = (1u << k_index_bits) - 1;
+  static constexpr std::uint32_t k_max_generation = 0xFF;
+
+  std::uint32_t value = 0;
+
+  constexpr LightHandle() = default;
+  constexpr explicit LightHandle(std::uint32_t v) : value(v) {}
+  constexpr LightHandle(std::uint32_t index, std::uint32_t generation)
+      : value((generation << k_index_bits) | (index & k_index_mask)) {}
+
+  constexpr std::uint32_t index() const { return value & k_index_mask; }
+  constexpr std::uint32_t generation() const { return value >> k_index_bits; }
+  constexpr bool null() const { return value == 0; }
+  constexpr explicit operator bool() const { return value != 0; }
+
+  constexpr bool operator==(LightHandle other) const { return value == other.value; }
+  constexpr bool operator!=(LightHandle other) const { return value != other.value; }
+};
+
+/*
+ * Lights of a scene as dense SoA columns addressed by generational handles; removal swaps the
+ * last light into the hole, so [0, size()) is always packed.
+ *
+ * Every change stamps the light with a new store version. Pipelines keep a packed copy in a
+ * structured buffer; each frame they ask for the dense range changed since their last sync and
+ * re-pack only that, which is O(1) when no light changed.
+ */
+class LightStore {
+public:
+  using Version = std::uint64_t;
+
+  LightStore() = default;
+
+  LightHandle create(const Light& light);
+  // Swap-remove; the last light moves into the freed dense position
+  void destroy(LightHandle h);
+  void clear();
+
+  bool valid(LightHandle h) const {
+    const std::uint32_t index = h.index();
+    return !h.null() && index < m_slots.size() && m_slots[index].generation == h.generation()
+           && m_slots[index].dense != k_no_dense;
+  }
+
+  size_t size() const { return m_handles.size(); }
+  bool empty() const { return m_handles.empty(); }
+  void reserve(size_t n);
+
+  // Handle -> dense position
+  size_t dense_index(LightHandle h) const {
+    REI_ASSERT(valid(h));
+    return m_slots[h.index()].dense;
+  }
+
+  Light get(LightHandle h) const;
+  void set(LightHandle h, const Light& light);
+  // The usual per-frame edits
+  void set_position(LightHandle h, const Vec3& position);
+  void set_direction(LightHandle h, const Vec3& direction);
+  void set_intensity(LightHandle h, double intensity);
+  // Stamp lights written through the raw columns as changed
+  void mark_changed(const LightHandle* handles, size_t count);
+
+  // Latest version stamped on any light, or on the store by a removal
+  Version version() const { return m_version; }
+
+  /*
+   * Dense range [first, last) of the lights changed after version `since`, possibly with
+   * unchanged lights in between; empty if none changed. Lights moved by a removal count as
+   * changed, and the store may have shrunk, so consumers also compare size().
+   */
+  void changed_range(Version since, size_t& first, size_t& last) const;
+
+  // Pack dense lights [first, last) into out[0, last - first)
+  void pack(size_t first, size_t last, PackedLight* out) const;
+
+  // Dense columns, all of size()
+  const LightType* types() const { return m_types.data(); }
+  const std::uint32_t* flags() const { return m_flags.data(); }
+  const Vec3* positions() const { return m_positions.data(); }
+  Vec3* positions() { return m_positions.data(); }
+  const Vec3* directions() const { return m_directions.data(); }
+  Vec3* directions() { return m_directions.data(); }
+  const Color* colors() const { return m_colors.data(); }
+  const double* intensities() const { return m_intensities.data(); }
+  double* intensities() { return m_intensities.data(); }
+  const Name* names() const { return m_names.data(); }
+  const LightHandle* handles() const { return m_handles.data(); }
+
+private:
+  static constexpr std::uint32_t k_no_dense = UINT32_MAX;
+
+  struct Slot {
+    std::uint32_t dense = k_no_dense;
+    std::uint32_t generation = 1;
+  };
+  // Parameters only read when packing
+  struct Shape {
+    double range;
+    double inner_angle;
+    double outer_angle;
+    double radius;
+    double length;
+  };
+
+  std::vector<Slot> m_slots;
+  std::deque<std::uint32_t> m_free_slots;
+
+  std::vector<LightType> m_types;
+  std::vector<std::uint32_t> m_flags;
+  std::vector<Vec3> m_positions;
+  std::vector<Vec3> m_directions;
+  std::vector<Color> m_colors;
+  std::vector<double> m_intensities;
+  std::vector<Shape> m_shapes;
+  std::vector<Name> m_names;
+  std::vector<LightHandle> m_handles;
+  std::vector<Version> m_versions;
+
+  Version m_version = 0;
+
+  // Apply f to every dense column
+  template <typename F>
+  void for_columns(F&& f) {
+    f(m_types);
+    f(m_flags);
+    f(m_positions);
+    f(m_directions);
+    f(m_colors);
+    f(m_intensities);
+    f(m_shapes);
+    f(m_names);
+    f(m_handles);
+    f(m_versions);
+  }
+  void write(size_t dense, const Light& light);
+  void touch(size_t dense) { m_versions[dense] = ++m_version; }
+};
+
+} // namespace rei
+
+#endif
@@ -0,0 +1,125 @@
+// source of mapped_file.h
+#include "mapped_file.h"
+
+#if WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <utility>
+
+namespace rei {
+
+MappedFile::MappedFile(MappedFile&& other) {
+  *this = std::move(other);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) {
+  if (this == &other) return *this;
+  close();
+  std::swap(m_data, other.m_data);
+  std::swap(m_size, other.m_size);
+#if WIN32
+  std::swap(m_file, other.m_file);
+  std::swap(m_mapping, other.m_mapping);
+#else
+  std::swap(m_fd, other.m_fd);
+#endif
+  return *this;
+}
+
+#if WIN32
+
+bool MappedFile::open(const std::string& filename) {
+  close();
+  HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+    FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS, NULL);
+  if (file == INVALID_HANDLE_VALUE) return false;
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+    CloseHandle(file);
+    return false;
+  }
+  HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+  if (!mapping) {
+    CloseHandle(file);
+    return false;
+  }
+  const void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  if (!view) {
+    CloseHandle(mapping);
+    CloseHandle(file);
+    return false;
+  }
+  m_file = file;
+  m_mapping = mapping;
+  m_data = static_cast<const std::uint8_t*>(view);
+  m_size = size_t(size.QuadPart);
+  return true;
+}
+
+void MappedFile::close() {
+  if (m_data) UnmapViewOfFile(m_data);
+  if (m_mapping) CloseHandle(m_mapping);
+  if (m_file) CloseHandle(m_file);
+  m_data = nullptr;
+  m_size = 0;
+  m_mapping = nullptr;
+  m_file = nullptr;
+}
+
+void MappedFile::prefetch(size_t offset, size_t bytes) const {
+  if (!m_data || offset >= m_size) return;
+  WIN32_MEMORY_RANGE_ENTRY range;
+  range.VirtualAddress = const_cast<std::uint8_t*>(m_data + offset);
+  range.NumberOfBytes = (std::min)(bytes, m_size - offset);
+  PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+}
+
+#else
+
+bool MappedFile::open(const std::string& filename) {
+  close();
+  int fd = ::open(filename.c_str(), O_RDONLY);
+  if (fd < 0) return false;
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size == 0) {
+    ::close(fd);
+    return false;
+  }
+  void* view = mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+  if (view == MAP_FAILED) {
+    ::close(fd);
+    return false;
+  }
+  m_fd = fd;
+  m_data = static_cast<const std::uint8_t*>(view);
+  m_size = size_t(st.st_size);
+  return true;
+}
+
+void MappedFile::close() {
+  if (m_data) munmap(const_cast<std::uint8_t*>(m_data), m_size);
+  if (m_fd >= 0) ::close(m_fd);
+  m_data = nullptr;
+  m_size = 0;
+  m_fd = -1;
+}
+
+void MappedFile::prefetch(size_t offset, size_t bytes) const {
+  if (!m_data || offset >= m_size) return;
+  // madvise wants a page-aligned start
+  const size_t page = size_t(sysconf(_SC_PAGESIZE));
+  const size_t begin = offset / page * page;
+  const size_t end = (std::min)(offset + bytes, m_size);
+  madvise(const_cast<std::uint8_t*>(m_data + begin), end - begin, MADV_WILLNEED);
+}
+
+#endif
+
+} // namespace rei
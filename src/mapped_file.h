@@ -0,0 +1,53 @@
+#ifndef REI_MAPPED_FILE_H
+#define REI_MAPPED_FILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "type_utils.h"
+
+/*
+ * mapped_file.h
+ * Read-only memory mapping of a whole file.
+ */
+
+namespace rei {
+
+/*
+ * Pages are loaded by the OS on first touch, so opening is O(1) in the file size and data that
+ * is never read never leaves the disk.
+ */
+class MappedFile : NoCopy {
+public:
+  MappedFile() = default;
+  ~MappedFile() { close(); }
+
+  MappedFile(MappedFile&& other);
+  MappedFile& operator=(MappedFile&& other);
+
+  // Return false (and stay closed) if the file cannot be opened or mapped
+  bool open(const std::string& filename);
+  void close();
+
+  bool is_open() const { return m_data != nullptr; }
+  const std::uint8_t* data() const { return m_data; }
+  size_t size() const { return m_size; }
+
+  // Hint that [offset, offset + bytes) will be read soon
+  void prefetch(size_t offset, size_t bytes) const;
+
+private:
+  const std::uint8_t* m_data = nullptr;
+  size_t m_size = 0;
+#if WIN32
+  void* m_file = nullptr;
+  void* m_mapping = nullptr;
+#else
+  int m_fd = -1;
+#endif
+};
+
+} // namespace rei
+
+#endif
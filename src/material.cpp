@@ -0,0 +1,68 @@
+// source of material.h
+#include "material.h"
+
+#include <atomic>
+#include <mutex>
+#include <shared_mutex>
+
+namespace rei {
+
+namespace {
+
+// Key names by id, and the way back; names are interned, so lookups hash a symbol
+struct KeyRegistry {
+  std::shared_mutex mutex;
+  std::vector<Name> names;
+  Hashmap<Name, MaterialKey> ids;
+
+  KeyRegistry() {
+    // Must follow the ids in MaterialKeys
+    for (const wchar_t* builtin : {L"albedo", L"smoothness", L"metalness", L"emissive"})
+      intern(builtin);
+    REI_ASSERT(names.size() == MaterialKeys::builtin_count);
+  }
+
+  MaterialKey intern(const Name& name) {
+    if (const MaterialKey* found = ids.try_get(name)) return *found;
+    const MaterialKey key = MaterialKey(names.size());
+    names.push_back(name);
+    ids.insert({name, key});
+    return key;
+  }
+};
+
+KeyRegistry& key_registry() {
+  static KeyRegistry registry;
+  return registry;
+}
+
+std::atomic<Material::Version> g_material_version {0};
+
+} // namespace
+
+MaterialKey material_key(const Name& name) {
+  KeyRegistry& registry = key_registry();
+  {
+    std::shared_lock<std::shared_mutex> lock(registry.mutex);
+    if (const MaterialKey* found = registry.ids.try_get(name)) return *found;
+  }
+  std::unique_lock<std::shared_mutex> lock(registry.mutex);
+  return registry.intern(name);
+}
+
+Name material_key_name(MaterialKey key) {
+  KeyRegistry& registry = key_registry();
+  std::shared_lock<std::shared_mutex> lock(registry.mutex);
+  REI_ASSERT(key < registry.names.size());
+  return registry.names[key];
+}
+
+Material::Version Material::latest_version() {
+  return g_material_version.load(std::memory_order_acquire);
+}
+
+Material::Version Material::next_version() {
+  return g_material_version.fetch_add(1, std::memory_order_acq_rel) + 1;
+}
+
+} // namespace rei
@@ -1,19 +1,44 @@
 #ifndef REI_MATERIAL_H
 #define REI_MATERIAL_H
 
+#include <cstdint>
 #include <memory>
+#include <vector>
 
+#include "common.h"
 #include "container_utils.h"
 #include "string_utils.h"
 #include "variant_utils.h"
 
 #include "color.h"
+#include "texture.h"
 
 namespace rei {
 
+/*
+ * Interned material property key: a dense id per distinct key name. The built-in keys below have
+ * fixed ids, so code using them never touches a string; other keys get an id the first time they
+ * are used and keep it for the rest of the process.
+ */
+using MaterialKey = std::uint32_t;
+
+namespace MaterialKeys {
+constexpr MaterialKey albedo = 0;
+constexpr MaterialKey smoothness = 1;
+constexpr MaterialKey metalness = 2;
+constexpr MaterialKey emissive = 3;
+constexpr MaterialKey builtin_count = 4;
+} // namespace MaterialKeys
+
+// Id of a key name, interning it if new; thread safe
+MaterialKey material_key(const Name& name);
+// Name of an interned key
+Name material_key_name(MaterialKey key);
+
 /*
  * General material property data.
- * Basically a bunch of hashmaps, storing limited amount of data types.
+ * Properties are stored densely by key, so a lookup by MaterialKey is an array index; the Name
+ * overloads intern the name first.
  */
 class Material {
 public:
@@ -22,10 +47,11 @@ public:
     std::monostate,
     Color, 
     Vec4, 
-    double
-    // Texture
+    double,
+    TexturePtr
     >;
   // clang-format on
+  using Version = std::uint64_t;
 
   Material() : m_name(L"Unnamed") {}
   Material(Name&& name) : m_name(name) {}
@@ -33,41 +59,80 @@ public:
   Material(Material&& other) = default;
   Material(const Material& other) = default;
 
-  bool has(const Name& prop_name) const { return m_properties.has(prop_name); }
+  bool has(MaterialKey key) const {
+    return key < m_properties.size() && !m_properties[key].holds<std::monostate>();
+  }
+  bool has(const Name& prop_name) const { return has(material_key(prop_name)); }
 
-  void set(Name&& prop_name, MaterialProperty&& prop_value) {
-    m_properties.insert_or_assign(std::move(prop_name), std::move(prop_value));
+  void set(MaterialKey key, MaterialProperty&& prop_value) {
+    if (key >= m_properties.size()) m_properties.resize(key + 1);
+    m_properties[key] = std::move(prop_value);
+    m_version = next_version();
+  }
+  void set(const Name& prop_name, MaterialProperty&& prop_value) {
+    set(material_key(prop_name), std::move(prop_value));
   }
 
-  const MaterialProperty& get(const Name& prop_name) const {
-    const MaterialProperty* value = m_properties.try_get(prop_name);
-    return value ? *value : MaterialProperty();
+  /*
+   * Stamped by every set(), from one counter shared by all materials. Renderers compare it
+   * against the version they last uploaded, and can skip looking at their materials altogether
+   * while latest_version() stays the same.
+   */
+  Version version() const { return m_version; }
+  static Version latest_version();
+
+  const MaterialProperty& get(MaterialKey key) const {
+    static const MaterialProperty empty;
+    return key < m_properties.size() ? m_properties[key] : empty;
   }
+  const MaterialProperty& get(const Name& prop_name) const { return get(material_key(prop_name)); }
 
   template <typename T>
-  std::optional<T> get(const Name& prop_name) const {
-    const MaterialProperty* value = m_properties.try_get(prop_name);
-    const T* ptr = std::get_if<T>(value);
+  std::optional<T> get(MaterialKey key) const {
+    const T* ptr = std::get_if<T>(&get(key));
     return ptr ? *ptr : std::optional<T>();
   }
+  template <typename T>
+  std::optional<T> get(const Name& prop_name) const {
+    return get<T>(material_key(prop_name));
+  }
+
+  const Name& name() const { return m_name; }
+
+  // f(MaterialKey, const MaterialProperty&) for every property set, by key
+  template <typename F>
+  void for_each_key(F f) const {
+    for (size_t key = 0; key < m_properties.size(); key++)
+      if (!m_properties[key].holds<std::monostate>()) f(MaterialKey(key), m_properties[key]);
+  }
+  // f(const Name&, const MaterialProperty&) for every property set
+  template <typename F>
+  void for_each_property(F f) const {
+    for_each_key([&](MaterialKey key, const MaterialProperty& value) {
+      f(material_key_name(key), value);
+    });
+  }
 
   // void set_graphic_handle(MaterialHandle h) { graphic_handle = h; }
   // MaterialHandle get_graphic_handle() const { return graphic_handle; }
 
 protected:
   Name m_name;
-  Hashmap<Name, MaterialProperty> m_properties;
+  std::vector<MaterialProperty> m_properties; // by key; monostate if not set
+  Version m_version = 0;
+
+  static Version next_version();
 
   friend std::wostream& operator<<(std::wostream& os, const Material& mat) {
     os << mat.m_name << " {";
-    auto beg = mat.m_properties.cbegin();
-    const auto end = mat.m_properties.cend();
-    while (beg != end) {
-      os << beg->first << ":" << beg->second;
-      beg++;
-      if (beg != end) { os << ", "; }
-    }
+    bool first = true;
+    mat.for_each_property([&](const Name& prop_name, const MaterialProperty& value) {
+      if (!first) { os << ", "; }
+      os << prop_name << ":" << value;
+      first = false;
+    });
     os << "}";
+    return os;
   }
 };
 
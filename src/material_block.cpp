@@ -0,0 +1,63 @@
+// source of material_block.h
+#include "material_block.h"
+
+#include <algorithm>
+
+namespace rei {
+
+MaterialSchema& MaterialSchema::add_float4(MaterialKey key, size_t row, const Vec4& fallback) {
+  REI_ASSERT(row < ParameterBlock::k_max_rows);
+  Field f {key, std::uint32_t(row * 4), 4, {}};
+  f.fallback[0] = float(fallback.x);
+  f.fallback[1] = float(fallback.y);
+  f.fallback[2] = float(fallback.z);
+  f.fallback[3] = float(fallback.h);
+  m_fields.push_back(f);
+  m_row_count = (std::max)(m_row_count, row + 1);
+  return *this;
+}
+
+MaterialSchema& MaterialSchema::add_float(
+  MaterialKey key, size_t row, size_t lane, double fallback) {
+  REI_ASSERT(row < ParameterBlock::k_max_rows && lane < 4);
+  Field f {key, std::uint32_t(row * 4 + lane), 1, {}};
+  f.fallback[0] = float(fallback);
+  m_fields.push_back(f);
+  m_row_count = (std::max)(m_row_count, row + 1);
+  return *this;
+}
+
+ConstBufferLayout MaterialSchema::layout() const {
+  ConstBufferLayout lo(m_row_count);
+  for (size_t i = 0; i < m_row_count; i++)
+    lo[i] = ShaderDataType::Float4;
+  return lo;
+}
+
+bool MaterialSchema::compile(const Material& material, ParameterBlock& block) const {
+  if (block.version == material.version() && block.row_count == m_row_count) return false;
+
+  block = {};
+  block.row_count = std::uint32_t(m_row_count);
+  block.version = material.version();
+  float* out = &block.rows[0][0];
+  for (const Field& f : m_fields) {
+    const Material::MaterialProperty& value = material.get(f.key);
+    float* dst = out + f.offset;
+    if (f.width == 4) {
+      if (const Color* c = std::get_if<Color>(&value)) {
+        dst[0] = c->r, dst[1] = c->g, dst[2] = c->b, dst[3] = c->a;
+      } else if (const Vec4* v = std::get_if<Vec4>(&value)) {
+        dst[0] = float(v->x), dst[1] = float(v->y), dst[2] = float(v->z), dst[3] = float(v->h);
+      } else {
+        std::copy(f.fallback, f.fallback + 4, dst);
+      }
+    } else {
+      const double* d = std::get_if<double>(&value);
+      dst[0] = d ? float(*d) : f.fallback[0];
+    }
+  }
+  return true;
+}
+
+} // namespace rei
@@ -0,0 +1,69 @@
+#ifndef REI_MATERIAL_BLOCK_H
+#define REI_MATERIAL_BLOCK_H
+
+#include <cstdint>
+#include <vector>
+
+#include "algebra.h"
+#include "material.h"
+#include "shader_struct.h"
+
+/*
+ * material_block.h
+ * Materials compiled into flat parameter blocks, the form pipelines upload them in.
+ */
+
+namespace rei {
+
+/*
+ * A material packed for the GPU: rows of four floats, as a constant buffer element holds them.
+ * Plain data of a fixed size, so pipelines keep one per material without allocating and upload
+ * it with one copy.
+ */
+struct ParameterBlock {
+  static constexpr size_t k_max_rows = 4;
+
+  float rows[k_max_rows][4];
+  std::uint32_t row_count = 0;
+  Material::Version version = 0; // of the material compiled into it; 0 if never compiled
+
+  const void* data() const { return rows; }
+  size_t bytes() const { return row_count * sizeof(rows[0]); }
+};
+
+/*
+ * Where each material property goes in a ParameterBlock, and the value used when a material
+ * does not have it. A pipeline builds one per shader material layout, once.
+ */
+class MaterialSchema {
+public:
+  // A Color or Vec4 property filling a whole row
+  MaterialSchema& add_float4(MaterialKey key, size_t row, const Vec4& fallback);
+  // A double property in one lane of a row
+  MaterialSchema& add_float(MaterialKey key, size_t row, size_t lane, double fallback);
+
+  size_t row_count() const { return m_row_count; }
+  // One Float4 member per row
+  ConstBufferLayout layout() const;
+
+  /*
+   * Pack `material` into `block`. Return false, leaving the block alone, if it already holds
+   * this version of the material. Properties of an unexpected type read as the fallback.
+   */
+  bool compile(const Material& material, ParameterBlock& block) const;
+
+private:
+  struct Field {
+    MaterialKey key;
+    std::uint32_t offset; // in floats
+    std::uint32_t width;  // 1 or 4 floats
+    float fallback[4];
+  };
+
+  std::vector<Field> m_fields;
+  size_t m_row_count = 0;
+};
+
+} // namespace rei
+
+#endif
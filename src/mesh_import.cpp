@@ -0,0 +1,86 @@
+// source of mesh_import.h
+#include "mesh_import.h"
+
+#include "debug.h"
+#include "parallel.h"
+#include "simd.h"
+
+namespace rei {
+
+namespace {
+
+// Two vertices in SoA layout
+struct Lanes {
+  Double2 x, y, z;
+};
+
+inline Lanes load_pair(const float* stream, size_t a, size_t b) {
+  const float* p = stream + a * 3;
+  const float* q = stream + b * 3;
+  return {Double2(p[0], q[0]), Double2(p[1], q[1]), Double2(p[2], q[2])};
+}
+
+// dot(v, col) with the association order of dot(Vec3, Vec3)
+inline Double2 dot3(const Lanes& v, const Vec3& col) {
+  return v.x * Double2(col.x) + v.y * Double2(col.y) + v.z * Double2(col.z);
+}
+
+} // namespace
+
+void convert_vertices(
+  const MeshStreams& src, const Mat4& trans, Mesh::Vertex* dst, size_t begin, size_t end) {
+  REI_ASSERT(src.positions && src.normals && end <= src.vertex_num);
+  const Mat3 trans_normal = trans.adj3();
+  const Vec3 col[4] = {trans[0].truncated(), trans[1].truncated(), trans[2].truncated(),
+    trans[3].truncated()};
+  const Double2 col_h[4] = {
+    Double2(trans[0].h), Double2(trans[1].h), Double2(trans[2].h), Double2(trans[3].h)};
+  const Double2 one(1.0);
+
+  for (size_t i = begin; i < end; i += 2) {
+    // An odd tail computes its vertex in both lanes
+    const size_t j = i + 1 < end ? i + 1 : i;
+
+    // Homogeneous position (x, y, z, 1) * trans, then projected
+    const Lanes p = load_pair(src.positions, i, j);
+    Double2 c[4];
+    for (int k = 0; k < 4; k++)
+      c[k] = dot3(p, col[k]) + col_h[k];
+    const Double2 px = c[0] / c[3], py = c[1] / c[3], pz = c[2] / c[3];
+
+    const Lanes n = load_pair(src.normals, i, j);
+    const Double2 nx = dot3(n, trans_normal[0]);
+    const Double2 ny = dot3(n, trans_normal[1]);
+    const Double2 nz = dot3(n, trans_normal[2]);
+    const Double2 inv_norm = one / sqrt(nx * nx + ny * ny + nz * nz);
+    const Double2 ux = nx * inv_norm, uy = ny * inv_norm, uz = nz * inv_norm;
+
+    Mesh::Vertex& a = dst[i];
+    a.coord = Vec4(px.lo(), py.lo(), pz.lo(), 1.0);
+    a.normal = Vec3(ux.lo(), uy.lo(), uz.lo());
+    if (j != i) {
+      Mesh::Vertex& b = dst[j];
+      b.coord = Vec4(px.hi(), py.hi(), pz.hi(), 1.0);
+      b.normal = Vec3(ux.hi(), uy.hi(), uz.hi());
+    }
+  }
+
+  if (src.colors) {
+    for (size_t i = begin; i < end; i++) {
+      const float* c = src.colors + i * 4;
+      dst[i].color = Color(c[0], c[1], c[2], c[3]);
+    }
+  } else {
+    for (size_t i = begin; i < end; i++)
+      dst[i].color = k_import_default_color;
+  }
+}
+
+std::vector<Mesh::Vertex> convert_vertices(const MeshStreams& src, const Mat4& trans) {
+  std::vector<Mesh::Vertex> ret(src.vertex_num);
+  parallel_for_range(0, src.vertex_num, 8192,
+    [&](size_t begin, size_t end) { convert_vertices(src, trans, ret.data(), begin, end); });
+  return ret;
+}
+
+} // namespace rei
@@ -0,0 +1,42 @@
+#ifndef REI_MESH_IMPORT_H
+#define REI_MESH_IMPORT_H
+
+#include <vector>
+
+#include "algebra.h"
+#include "color.h"
+#include "geometry.h"
+
+/*
+ * mesh_import.h
+ * Conversion of importer vertex streams (e.g. of an aiMesh) into Mesh vertices.
+ */
+
+namespace rei {
+
+// Vertex streams as importers lay them out; all have vertex_num elements
+struct MeshStreams {
+  const float* positions = nullptr; // xyz
+  const float* normals = nullptr;   // xyz
+  const float* colors = nullptr;    // rgba; nullptr for k_import_default_color
+  size_t vertex_num = 0;
+};
+
+constexpr Color k_import_default_color {0.5f, 0.5f, 0.5f, 1.0f};
+
+/*
+ * Transform positions by `trans` (as row vectors, p * trans) and normals by its adjoint, then
+ * renormalize the normals; vertices [begin, end) of `src` are written to the same positions of
+ * `dst`.
+ * Two vertices go through the same double-precision operations side by side, so the result is
+ * bit-identical to transforming each one with Vec4 * Mat4 and Vec3::normalized().
+ */
+void convert_vertices(
+  const MeshStreams& src, const Mat4& trans, Mesh::Vertex* dst, size_t begin, size_t end);
+
+// All vertices; large meshes are split into ranges over the thread pool
+std::vector<Mesh::Vertex> convert_vertices(const MeshStreams& src, const Mat4& trans);
+
+} // namespace rei
+
+#endif
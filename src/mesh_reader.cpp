@@ -0,0 +1,834 @@
+// source of mesh_reader.h
+#include "mesh_reader.h"
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+
+#include "debug.h"
+#include "mapped_file.h"
+#include "parallel.h"
+#include "string_utils.h"
+
+using std::string;
+using std::uint32_t;
+using std::uint8_t;
+using std::vector;
+
+namespace rei {
+
+MeshStreams MeshData::streams() const {
+  MeshStreams ret;
+  ret.positions = positions.data();
+  ret.normals = normals.empty() ? nullptr : normals.data();
+  ret.colors = colors.empty() ? nullptr : colors.data();
+  ret.vertex_num = vertex_num();
+  return ret;
+}
+
+namespace {
+
+// Text scanning ////
+
+inline bool is_space(char c) {
+  return c == ' ' || c == '\t' || c == '\r';
+}
+
+inline const char* skip_spaces(const char* p, const char* end) {
+  while (p < end && is_space(*p))
+    p++;
+  return p;
+}
+
+inline const char* skip_token(const char* p, const char* end) {
+  while (p < end && !is_space(*p))
+    p++;
+  return p;
+}
+
+inline const char* line_end(const char* p, const char* end) {
+  const void* nl = std::memchr(p, '\n', end - p);
+  return nl ? static_cast<const char*>(nl) : end;
+}
+
+// Return nullptr if no number starts at p (after spaces)
+template <typename T>
+inline const char* parse_number(const char* p, const char* end, T& out) {
+  p = skip_spaces(p, end);
+  if (p < end && *p == '+') p++;
+  const std::from_chars_result r = std::from_chars(p, end, out);
+  return r.ec == std::errc() ? r.ptr : nullptr;
+}
+
+// Chunks of at least 1 MiB, a few per thread, each starting after a newline
+vector<size_t> line_aligned_chunks(const char* data, size_t size) {
+  const size_t threads = global_thread_pool().concurrency();
+  const size_t target = (std::max<size_t>)(size_t(1) << 20, size / (threads * 8) + 1);
+  vector<size_t> bounds {0};
+  while (bounds.back() < size) {
+    size_t b = (std::min)(size, bounds.back() + target);
+    if (b < size) b = line_end(data + b, data + size) - data + 1;
+    bounds.push_back((std::min)(b, size));
+  }
+  return bounds;
+}
+
+// Concatenate per-chunk vectors in order, copying in parallel
+template <typename T, typename FGet>
+void concat(size_t chunk_num, FGet get, vector<T>& out) {
+  vector<size_t> offset(chunk_num + 1, 0);
+  for (size_t c = 0; c < chunk_num; c++)
+    offset[c + 1] = offset[c] + get(c).size();
+  out.resize(offset.back());
+  parallel_for(0, chunk_num, 1, [&](size_t c) {
+    const vector<T>& src = get(c);
+    std::copy(src.begin(), src.end(), out.begin() + offset[c]);
+  });
+}
+
+bool check_indices(const MeshData& mesh, const char* format) {
+  const size_t vertex_num = mesh.vertex_num();
+  std::atomic<bool> ok {true};
+  parallel_for_range(0, mesh.indices.size(), 1 << 16, [&](size_t b, size_t e) {
+    for (size_t i = b; i < e; i++)
+      if (mesh.indices[i] >= vertex_num) {
+        ok = false;
+        return;
+      }
+  });
+  if (!ok) REI_WARNING(string(format) + ": face index out of range");
+  return ok;
+}
+
+// OBJ ////
+
+// Relative (negative) indices are stored biased, relative to the chunk's first vertex, and
+// resolved once the vertex count before each chunk is known
+constexpr std::int64_t k_relative = std::int64_t(1) << 48;
+
+struct ObjChunk {
+  vector<float> positions;
+  vector<float> normals;
+  vector<float> colors;
+  vector<std::int64_t> indices;
+  size_t colored = 0; // positions with a color
+  bool normals_by_position = true;
+  bool ok = true;
+};
+
+// Face vertex "v", "v/t", "v//n" or "v/t/n"; return nullptr on a syntax error
+const char* parse_face_vertex(
+  const char* p, const char* end, std::int64_t& v, std::int64_t& n, bool& has_n) {
+  p = parse_number(p, end, v);
+  has_n = false;
+  if (!p || v == 0) return nullptr;
+  if (p < end && *p == '/') {
+    p++;
+    if (p < end && *p != '/') {
+      std::int64_t t;
+      p = parse_number(p, end, t);
+      if (!p) return nullptr;
+    }
+    if (p < end && *p == '/') {
+      p = parse_number(p + 1, end, n);
+      if (!p) return nullptr;
+      has_n = true;
+    }
+  }
+  return p;
+}
+
+void parse_obj_chunk(const char* p, const char* end, ObjChunk& chunk) {
+  while (p < end && chunk.ok) {
+    const char* eol = line_end(p, end);
+    const char* q = skip_spaces(p, eol);
+    if (q + 1 < eol && q[0] == 'v' && is_space(q[1])) {
+      q += 1;
+      float xyz[3], rgb[3];
+      for (float& x : xyz)
+        if (!(q = parse_number(q, eol, x))) break;
+      if (!q) {
+        chunk.ok = false;
+        break;
+      }
+      chunk.positions.insert(chunk.positions.end(), xyz, xyz + 3);
+      const char* c = q;
+      for (float& x : rgb)
+        if (c && !(c = parse_number(c, eol, x))) break;
+      if (c) {
+        chunk.colors.insert(chunk.colors.end(), {rgb[0], rgb[1], rgb[2], 1.f});
+        chunk.colored++;
+      }
+    } else if (q + 2 < eol && q[0] == 'v' && q[1] == 'n' && is_space(q[2])) {
+      q += 2;
+      float xyz[3];
+      for (float& x : xyz)
+        if (!(q = parse_number(q, eol, x))) break;
+      if (!q) {
+        chunk.ok = false;
+        break;
+      }
+      chunk.normals.insert(chunk.normals.end(), xyz, xyz + 3);
+    } else if (q + 1 < eol && q[0] == 'f' && is_space(q[1])) {
+      // Fan-triangulate: (first, previous, current)
+      const std::int64_t vertex_count = std::int64_t(chunk.positions.size() / 3);
+      std::int64_t first = 0, prev = 0;
+      int corner = 0;
+      q = skip_spaces(q + 1, eol);
+      while (q < eol) {
+        std::int64_t v, n = 0;
+        bool has_n;
+        q = parse_face_vertex(q, eol, v, n, has_n);
+        if (!q) {
+          chunk.ok = false;
+          break;
+        }
+        if (has_n && n != v) chunk.normals_by_position = false;
+        const std::int64_t index = v > 0 ? v - 1 : k_relative + vertex_count + v;
+        if (corner == 0) {
+          first = index;
+        } else if (corner >= 2) {
+          chunk.indices.insert(chunk.indices.end(), {first, prev, index});
+        }
+        prev = index;
+        corner++;
+        q = skip_spaces(q, eol);
+      }
+    }
+    // other records (vt, o, g, s, usemtl, comments, ...) are skipped
+    p = eol + 1;
+  }
+}
+
+// PLY ////
+
+enum class PlyType { Int8, UInt8, Int16, UInt16, Int32, UInt32, Float32, Float64, Invalid };
+
+PlyType ply_type(const string& name) {
+  if (name == "char" || name == "int8") return PlyType::Int8;
+  if (name == "uchar" || name == "uint8") return PlyType::UInt8;
+  if (name == "short" || name == "int16") return PlyType::Int16;
+  if (name == "ushort" || name == "uint16") return PlyType::UInt16;
+  if (name == "int" || name == "int32") return PlyType::Int32;
+  if (name == "uint" || name == "uint32") return PlyType::UInt32;
+  if (name == "float" || name == "float32") return PlyType::Float32;
+  if (name == "double" || name == "float64") return PlyType::Float64;
+  return PlyType::Invalid;
+}
+
+size_t ply_size(PlyType type) {
+  switch (type) {
+    case PlyType::Int8:
+    case PlyType::UInt8:
+      return 1;
+    case PlyType::Int16:
+    case PlyType::UInt16:
+      return 2;
+    case PlyType::Int32:
+    case PlyType::UInt32:
+    case PlyType::Float32:
+      return 4;
+    case PlyType::Float64:
+      return 8;
+    default:
+      return 0;
+  }
+}
+
+// Scale bringing an integer color channel to [0, 1]
+float color_scale(PlyType type) {
+  switch (type) {
+    case PlyType::UInt8:
+      return 1.f / 255.f;
+    case PlyType::UInt16:
+      return 1.f / 65535.f;
+    case PlyType::Float32:
+    case PlyType::Float64:
+      return 1.f;
+    default:
+      return 1.f / 255.f;
+  }
+}
+
+template <typename T>
+inline T load(const uint8_t* p, bool swap) {
+  uint8_t bytes[sizeof(T)];
+  std::memcpy(bytes, p, sizeof(T));
+  if (swap) std::reverse(bytes, bytes + sizeof(T));
+  T ret;
+  std::memcpy(&ret, bytes, sizeof(T));
+  return ret;
+}
+
+inline double load_value(const uint8_t* p, PlyType type, bool swap) {
+  switch (type) {
+    case PlyType::Int8:
+      return double(std::int8_t(*p));
+    case PlyType::UInt8:
+      return double(*p);
+    case PlyType::Int16:
+      return double(load<std::int16_t>(p, swap));
+    case PlyType::UInt16:
+      return double(load<std::uint16_t>(p, swap));
+    case PlyType::Int32:
+      return double(load<std::int32_t>(p, swap));
+    case PlyType::UInt32:
+      return double(load<std::uint32_t>(p, swap));
+    case PlyType::Float32:
+      return double(load<float>(p, swap));
+    case PlyType::Float64:
+      return load<double>(p, swap);
+    default:
+      return 0;
+  }
+}
+
+inline size_t load_count(const uint8_t* p, PlyType type, bool swap) {
+  const double v = load_value(p, type, swap);
+  return v > 0 ? size_t(v) : 0;
+}
+
+struct PlyProperty {
+  string name;
+  PlyType type = PlyType::Invalid;
+  bool is_list = false;
+  PlyType count_type = PlyType::Invalid;
+};
+
+struct PlyElement {
+  string name;
+  size_t count = 0;
+  vector<PlyProperty> properties;
+
+  bool has_list() const {
+    return std::any_of(properties.begin(), properties.end(),
+      [](const PlyProperty& p) { return p.is_list; });
+  }
+  int find(const char* name) const {
+    for (size_t i = 0; i < properties.size(); i++)
+      if (properties[i].name == name) return int(i);
+    return -1;
+  }
+};
+
+enum class PlyFormat { Ascii, BinaryLittle, BinaryBig };
+
+struct PlyHeader {
+  PlyFormat format = PlyFormat::Ascii;
+  vector<PlyElement> elements;
+  size_t body = 0; // offset of the first byte after end_header
+};
+
+bool parse_ply_header(const char* data, size_t size, PlyHeader& header) {
+  const char* end = data + size;
+  const char* p = data;
+  bool first = true;
+  while (p < end) {
+    const char* eol = line_end(p, end);
+    const char* q = skip_spaces(p, eol);
+    vector<string> words;
+    while (q < eol) {
+      const char* w = skip_token(q, eol);
+      words.emplace_back(q, w);
+      q = skip_spaces(w, eol);
+    }
+    p = eol + 1;
+    if (first) {
+      if (words.size() != 1 || words[0] != "ply") return false;
+      first = false;
+      continue;
+    }
+    if (words.empty() || words[0] == "comment" || words[0] == "obj_info") continue;
+    if (words[0] == "end_header") {
+      header.body = (std::min)(size_t(p - data), size);
+      return true;
+    }
+    if (words[0] == "format" && words.size() >= 2) {
+      if (words[1] == "ascii")
+        header.format = PlyFormat::Ascii;
+      else if (words[1] == "binary_little_endian")
+        header.format = PlyFormat::BinaryLittle;
+      else if (words[1] == "binary_big_endian")
+        header.format = PlyFormat::BinaryBig;
+      else
+        return false;
+    } else if (words[0] == "element" && words.size() == 3) {
+      PlyElement element;
+      element.name = words[1];
+      if (std::from_chars(words[2].data(), words[2].data() + words[2].size(), element.count).ec
+          != std::errc())
+        return false;
+      header.elements.push_back(std::move(element));
+    } else if (words[0] == "property" && !header.elements.empty()) {
+      PlyProperty prop;
+      if (words.size() == 5 && words[1] == "list") {
+        prop.is_list = true;
+        prop.count_type = ply_type(words[2]);
+        prop.type = ply_type(words[3]);
+        prop.name = words[4];
+        if (prop.count_type == PlyType::Invalid) return false;
+      } else if (words.size() == 3) {
+        prop.type = ply_type(words[1]);
+        prop.name = words[2];
+      } else {
+        return false;
+      }
+      if (prop.type == PlyType::Invalid) return false;
+      header.elements.back().properties.push_back(std::move(prop));
+    } else {
+      return false;
+    }
+  }
+  return false;
+}
+
+// Vertex channels to read, as property indices (-1 if missing)
+struct PlyVertexLayout {
+  int position[3];
+  int normal[3];
+  int color[4];
+
+  explicit PlyVertexLayout(const PlyElement& e)
+      : position {e.find("x"), e.find("y"), e.find("z")},
+        normal {e.find("nx"), e.find("ny"), e.find("nz")},
+        color {e.find("red"), e.find("green"), e.find("blue"), e.find("alpha")} {}
+
+  bool has_position() const { return position[0] >= 0 && position[1] >= 0 && position[2] >= 0; }
+  bool has_normal() const { return normal[0] >= 0 && normal[1] >= 0 && normal[2] >= 0; }
+  bool has_color() const { return color[0] >= 0 && color[1] >= 0 && color[2] >= 0; }
+};
+
+void prepare_vertices(const PlyElement& element, const PlyVertexLayout& layout, MeshData& out) {
+  out.positions.resize(element.count * 3);
+  if (layout.has_normal()) out.normals.resize(element.count * 3);
+  if (layout.has_color()) out.colors.resize(element.count * 4);
+}
+
+// Store the values of vertex i, given a getter of property values
+template <typename FValue>
+inline void store_vertex(
+  const PlyElement& element, const PlyVertexLayout& layout, size_t i, FValue value, MeshData& out) {
+  for (int k = 0; k < 3; k++)
+    out.positions[i * 3 + k] = float(value(layout.position[k]));
+  if (!out.normals.empty())
+    for (int k = 0; k < 3; k++)
+      out.normals[i * 3 + k] = float(value(layout.normal[k]));
+  if (!out.colors.empty()) {
+    for (int k = 0; k < 4; k++) {
+      const int prop = layout.color[k];
+      out.colors[i * 4 + k]
+        = prop < 0 ? 1.f
+                   : float(value(prop)) * color_scale(element.properties[size_t(prop)].type);
+    }
+  }
+}
+
+// Binary: fixed-size vertex records are read in parallel, each property at its offset
+bool read_binary_vertices(
+  const uint8_t* p, const uint8_t* end, const PlyElement& element, bool swap, MeshData& out) {
+  const PlyVertexLayout layout(element);
+  vector<size_t> offsets;
+  size_t stride = 0;
+  for (const PlyProperty& prop : element.properties) {
+    offsets.push_back(stride);
+    stride += ply_size(prop.type);
+  }
+  if (!layout.has_position() || element.has_list()) return false;
+  if (size_t(end - p) / stride < element.count) return false;
+  prepare_vertices(element, layout, out);
+  parallel_for_range(0, element.count, 1 << 14, [&](size_t b, size_t e) {
+    for (size_t i = b; i < e; i++) {
+      const uint8_t* record = p + i * stride;
+      auto value = [&](int prop) {
+        return load_value(record + offsets[prop], element.properties[prop].type, swap);
+      };
+      store_vertex(element, layout, i, value, out);
+    }
+  });
+  return true;
+}
+
+// Size of one record starting at p, or 0 if it runs past `end`
+size_t binary_record_size(const uint8_t* p, const uint8_t* end, const PlyElement& element,
+  bool swap) {
+  const uint8_t* q = p;
+  for (const PlyProperty& prop : element.properties) {
+    if (prop.is_list) {
+      const size_t count_bytes = ply_size(prop.count_type);
+      if (size_t(end - q) < count_bytes) return 0;
+      const size_t n = load_count(q, prop.count_type, swap);
+      q += count_bytes;
+      if (size_t(end - q) / ply_size(prop.type) < n) return 0;
+      q += n * ply_size(prop.type);
+    } else {
+      if (size_t(end - q) < ply_size(prop.type)) return 0;
+      q += ply_size(prop.type);
+    }
+  }
+  return size_t(q - p);
+}
+
+// Binary faces: if every face is a triangle, records have a fixed size and are copied in
+// parallel; otherwise they are walked one by one. Return the end of the element, or nullptr.
+const uint8_t* read_binary_faces(const uint8_t* p, const uint8_t* end, const PlyElement& element,
+  bool swap, MeshData& out) {
+  int list = element.find("vertex_indices");
+  if (list < 0) list = element.find("vertex_index");
+  if (list < 0 || !element.properties[list].is_list) return nullptr;
+  for (size_t i = 0; i < element.properties.size(); i++)
+    if (int(i) != list && element.properties[i].is_list) list = -1;
+
+  if (list >= 0) {
+    const PlyProperty& indices = element.properties[list];
+    // Fixed-size properties before and after the list
+    size_t before = 0, after = 0;
+    for (int i = 0; i < int(element.properties.size()); i++) {
+      if (i < list) before += ply_size(element.properties[i].type);
+      if (i > list) after += ply_size(element.properties[i].type);
+    }
+    const size_t count_bytes = ply_size(indices.count_type);
+    const size_t index_bytes = ply_size(indices.type);
+    const size_t stride = before + count_bytes + 3 * index_bytes + after;
+    if (size_t(end - p) / stride >= element.count) {
+      std::atomic<bool> triangles {true};
+      parallel_for_range(0, element.count, 1 << 16, [&](size_t b, size_t e) {
+        for (size_t i = b; i < e && triangles; i++)
+          if (load_count(p + i * stride + before, indices.count_type, swap) != 3) triangles = false;
+      });
+      if (triangles) {
+        out.indices.resize(element.count * 3);
+        parallel_for_range(0, element.count, 1 << 14, [&](size_t b, size_t e) {
+          for (size_t i = b; i < e; i++) {
+            const uint8_t* record = p + i * stride + before + count_bytes;
+            for (size_t k = 0; k < 3; k++)
+              out.indices[i * 3 + k]
+                = uint32_t(load_value(record + k * index_bytes, indices.type, swap));
+          }
+        });
+        return p + element.count * stride;
+      }
+    }
+  }
+
+  // Polygons, or several lists per face
+  int face_list = element.find("vertex_indices");
+  if (face_list < 0) face_list = element.find("vertex_index");
+  for (size_t f = 0; f < element.count; f++) {
+    const uint8_t* q = p;
+    for (int k = 0; k < int(element.properties.size()); k++) {
+      const PlyProperty& prop = element.properties[k];
+      if (!prop.is_list) {
+        if (size_t(end - q) < ply_size(prop.type)) return nullptr;
+        q += ply_size(prop.type);
+        continue;
+      }
+      const size_t count_bytes = ply_size(prop.count_type);
+      const size_t item_bytes = ply_size(prop.type);
+      if (size_t(end - q) < count_bytes) return nullptr;
+      const size_t n = load_count(q, prop.count_type, swap);
+      q += count_bytes;
+      if (size_t(end - q) / item_bytes < n) return nullptr;
+      if (k == face_list) {
+        for (size_t c = 2; c < n; c++) {
+          out.indices.push_back(uint32_t(load_value(q, prop.type, swap)));
+          out.indices.push_back(uint32_t(load_value(q + (c - 1) * item_bytes, prop.type, swap)));
+          out.indices.push_back(uint32_t(load_value(q + c * item_bytes, prop.type, swap)));
+        }
+      }
+      q += n * item_bytes;
+    }
+    p = q;
+  }
+  return p;
+}
+
+bool read_binary_ply(const uint8_t* p, const uint8_t* end, const PlyHeader& header,
+  MeshData& out) {
+  const bool swap = header.format == PlyFormat::BinaryBig;
+  bool has_vertices = false;
+  for (const PlyElement& element : header.elements) {
+    if (element.name == "vertex") {
+      if (!read_binary_vertices(p, end, element, swap, out)) return false;
+      has_vertices = true;
+      size_t stride = 0;
+      for (const PlyProperty& prop : element.properties)
+        stride += ply_size(prop.type);
+      p += element.count * stride;
+    } else if (element.name == "face") {
+      p = read_binary_faces(p, end, element, swap, out);
+      if (!p) return false;
+    } else if (!element.has_list()) {
+      size_t stride = 0;
+      for (const PlyProperty& prop : element.properties)
+        stride += ply_size(prop.type);
+      if (size_t(end - p) / (std::max<size_t>)(stride, 1) < element.count) return false;
+      p += element.count * stride;
+    } else {
+      for (size_t i = 0; i < element.count; i++) {
+        const size_t bytes = binary_record_size(p, end, element, swap);
+        if (bytes == 0) return false;
+        p += bytes;
+      }
+    }
+  }
+  return has_vertices;
+}
+
+// Ascii: lines are counted per chunk first, so that each chunk knows which element its lines
+// belong to
+struct PlyAsciiChunk {
+  vector<uint32_t> indices;
+  bool ok = true;
+};
+
+bool read_ascii_ply(const char* p, const char* end, const PlyHeader& header, MeshData& out) {
+  const vector<size_t> bounds = line_aligned_chunks(p, size_t(end - p));
+  const size_t chunk_num = bounds.size() - 1;
+  vector<size_t> first_line(chunk_num + 1, 0);
+  parallel_for(0, chunk_num, 1, [&](size_t c) {
+    first_line[c + 1] = size_t(std::count(p + bounds[c], p + bounds[c + 1], '\n'));
+  });
+  for (size_t c = 0; c < chunk_num; c++)
+    first_line[c + 1] += first_line[c];
+  const size_t line_num = first_line.back() + (end > p && end[-1] != '\n' ? 1 : 0);
+
+  // Line ranges of the elements
+  const PlyElement* vertex = nullptr;
+  const PlyElement* face = nullptr;
+  size_t vertex_first = 0, face_first = 0, line = 0;
+  for (const PlyElement& element : header.elements) {
+    if (element.name == "vertex" && !vertex) {
+      vertex = &element;
+      vertex_first = line;
+    } else if (element.name == "face" && !face) {
+      face = &element;
+      face_first = line;
+    }
+    line += element.count;
+  }
+  if (!vertex) return false;
+  const PlyVertexLayout layout(*vertex);
+  if (!layout.has_position() || vertex->has_list()) return false;
+  prepare_vertices(*vertex, layout, out);
+  int face_list = -1;
+  if (face) {
+    face_list = face->find("vertex_indices");
+    if (face_list < 0) face_list = face->find("vertex_index");
+    if (face_list < 0) return false;
+  }
+
+  vector<PlyAsciiChunk> chunks(chunk_num);
+  parallel_for(0, chunk_num, 1, [&](size_t c) {
+    PlyAsciiChunk& chunk = chunks[c];
+    const char* q = p + bounds[c];
+    const char* chunk_end = p + bounds[c + 1];
+    vector<double> values(vertex->properties.size());
+    vector<std::int64_t> polygon;
+    for (size_t line = first_line[c]; q < chunk_end && chunk.ok; line++) {
+      const char* eol = line_end(q, chunk_end);
+      if (line >= vertex_first && line < vertex_first + vertex->count) {
+        const char* r = q;
+        for (double& v : values)
+          if (r && !(r = parse_number(r, eol, v))) break;
+        if (!r) {
+          chunk.ok = false;
+          break;
+        }
+        auto value = [&](int prop) { return values[prop]; };
+        store_vertex(*vertex, layout, line - vertex_first, value, out);
+      } else if (face && line >= face_first && line < face_first + face->count) {
+        const char* r = q;
+        for (int k = 0; r && k < int(face->properties.size()); k++) {
+          const PlyProperty& prop = face->properties[k];
+          size_t n = 1;
+          if (prop.is_list && !(r = parse_number(r, eol, n))) break;
+          polygon.clear();
+          for (size_t i = 0; r && i < n; i++) {
+            double v;
+            if ((r = parse_number(r, eol, v))) polygon.push_back(std::int64_t(v));
+          }
+          if (r && k == face_list) {
+            for (size_t i = 2; i < polygon.size(); i++)
+              chunk.indices.insert(chunk.indices.end(),
+                {uint32_t(polygon[0]), uint32_t(polygon[i - 1]), uint32_t(polygon[i])});
+          }
+        }
+        if (!r) chunk.ok = false;
+      }
+      q = eol + 1;
+    }
+  });
+  for (const PlyAsciiChunk& chunk : chunks)
+    if (!chunk.ok) return false;
+  if (line_num < line) return false; // truncated
+  auto chunk_indices = [&](size_t c) -> const vector<uint32_t>& { return chunks[c].indices; };
+  concat<uint32_t>(chunk_num, chunk_indices, out.indices);
+  return true;
+}
+
+} // namespace
+
+bool read_obj(const uint8_t* bytes, size_t size, MeshData& out) {
+  const char* data = reinterpret_cast<const char*>(bytes);
+  const vector<size_t> bounds = line_aligned_chunks(data, size);
+  const size_t chunk_num = bounds.size() - 1;
+  vector<ObjChunk> chunks(chunk_num);
+  parallel_for(0, chunk_num, 1,
+    [&](size_t c) { parse_obj_chunk(data + bounds[c], data + bounds[c + 1], chunks[c]); });
+
+  // Merge: vertex streams are concatenated, face indices are resolved against the vertex count
+  // before their chunk
+  vector<std::int64_t> vertex_base(chunk_num + 1, 0);
+  size_t colored = 0, normal_num = 0;
+  bool normals_by_position = true;
+  for (size_t c = 0; c < chunk_num; c++) {
+    if (!chunks[c].ok) {
+      REI_WARNING("OBJ: malformed record");
+      return false;
+    }
+    vertex_base[c + 1] = vertex_base[c] + std::int64_t(chunks[c].positions.size() / 3);
+    colored += chunks[c].colored;
+    normal_num += chunks[c].normals.size() / 3;
+    normals_by_position &= chunks[c].normals_by_position;
+  }
+  const size_t vertex_num = size_t(vertex_base.back());
+
+  concat<float>(chunk_num, [&](size_t c) -> const vector<float>& { return chunks[c].positions; },
+    out.positions);
+  out.normals.clear();
+  if (normal_num == vertex_num && normals_by_position)
+    concat<float>(chunk_num, [&](size_t c) -> const vector<float>& { return chunks[c].normals; },
+      out.normals);
+  out.colors.clear();
+  if (colored == vertex_num && vertex_num > 0)
+    concat<float>(chunk_num, [&](size_t c) -> const vector<float>& { return chunks[c].colors; },
+      out.colors);
+
+  vector<size_t> index_offset(chunk_num + 1, 0);
+  for (size_t c = 0; c < chunk_num; c++)
+    index_offset[c + 1] = index_offset[c] + chunks[c].indices.size();
+  out.indices.resize(index_offset.back());
+  std::atomic<bool> in_range {true};
+  parallel_for(0, chunk_num, 1, [&](size_t c) {
+    const vector<std::int64_t>& src = chunks[c].indices;
+    uint32_t* dst = out.indices.data() + index_offset[c];
+    for (size_t i = 0; i < src.size(); i++) {
+      std::int64_t index = src[i];
+      if (index >= k_relative / 2) index = index - k_relative + vertex_base[c];
+      if (index < 0 || index >= std::int64_t(vertex_num)) in_range = false;
+      dst[i] = uint32_t(index);
+    }
+  });
+  if (!in_range) {
+    REI_WARNING("OBJ: face index out of range");
+    return false;
+  }
+  return true;
+}
+
+bool read_ply(const uint8_t* bytes, size_t size, MeshData& out) {
+  const char* data = reinterpret_cast<const char*>(bytes);
+  PlyHeader header;
+  if (!parse_ply_header(data, size, header)) {
+    REI_WARNING("PLY: malformed or unsupported header");
+    return false;
+  }
+  out = MeshData();
+  const bool ok = header.format == PlyFormat::Ascii
+                    ? read_ascii_ply(data + header.body, data + size, header, out)
+                    : read_binary_ply(bytes + header.body, bytes + size, header, out);
+  if (!ok) {
+    REI_WARNING("PLY: malformed or truncated data");
+    return false;
+  }
+  return check_indices(out, "PLY");
+}
+
+bool has_native_reader(const string& filename) {
+  const string ext = lower_extension(filename);
+  return ext == ".obj" || ext == ".ply";
+}
+
+bool read_mesh_data(const string& filename, MeshData& out) {
+  MappedFile file;
+  if (!file.open(filename)) {
+    REI_WARNING("MeshReader: cannot map " + filename);
+    return false;
+  }
+  file.prefetch(0, file.size());
+  const string ext = lower_extension(filename);
+  bool ok = false;
+  if (ext == ".obj")
+    ok = read_obj(file.data(), file.size(), out);
+  else if (ext == ".ply")
+    ok = read_ply(file.data(), file.size(), out);
+  else
+    REI_WARNING("MeshReader: unsupported format " + filename);
+  if (ok && out.normals.empty()) compute_vertex_normals(out);
+  return ok;
+}
+
+void compute_vertex_normals(MeshData& mesh) {
+  const size_t vertex_num = mesh.vertex_num();
+  const size_t triangle_num = mesh.triangle_num();
+  const float* pos = mesh.positions.data();
+  const uint32_t* idx = mesh.indices.data();
+
+  // Triangles around each vertex, as offsets into `around` (counted, then filled, in parallel)
+  vector<std::atomic<uint32_t>> cursor(vertex_num);
+  parallel_for_range(0, triangle_num * 3, 1 << 16, [&](size_t b, size_t e) {
+    for (size_t i = b; i < e; i++)
+      cursor[idx[i]].fetch_add(1, std::memory_order_relaxed);
+  });
+  vector<size_t> first(vertex_num + 1, 0);
+  for (size_t v = 0; v < vertex_num; v++) {
+    first[v + 1] = first[v] + cursor[v].load(std::memory_order_relaxed);
+    cursor[v].store(0, std::memory_order_relaxed);
+  }
+  vector<uint32_t> around(first.back());
+  parallel_for_range(0, triangle_num * 3, 1 << 16, [&](size_t b, size_t e) {
+    for (size_t i = b; i < e; i++) {
+      const uint32_t v = idx[i];
+      around[first[v] + cursor[v].fetch_add(1, std::memory_order_relaxed)] = uint32_t(i / 3);
+    }
+  });
+
+  // Unnormalized cross products weigh each triangle by its area
+  mesh.normals.assign(vertex_num * 3, 0.f);
+  parallel_for_range(0, vertex_num, 1 << 12, [&](size_t b, size_t e) {
+    for (size_t v = b; v < e; v++) {
+      double n[3] = {0, 0, 0};
+      for (size_t k = first[v]; k < first[v + 1]; k++) {
+        const uint32_t* t = idx + size_t(around[k]) * 3;
+        const float *p0 = pos + size_t(t[0]) * 3, *p1 = pos + size_t(t[1]) * 3,
+                    *p2 = pos + size_t(t[2]) * 3;
+        const double e1[3] = {p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2]};
+        const double e2[3] = {p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2]};
+        n[0] += e1[1] * e2[2] - e1[2] * e2[1];
+        n[1] += e1[2] * e2[0] - e1[0] * e2[2];
+        n[2] += e1[0] * e2[1] - e1[1] * e2[0];
+      }
+      const double len = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+      const double inv = len > 0 ? 1.0 / len : 0.0;
+      for (int k = 0; k < 3; k++)
+        mesh.normals[v * 3 + k] = float(len > 0 ? n[k] * inv : (k == 1 ? 1.0 : 0.0));
+    }
+  });
+}
+
+std::shared_ptr<Mesh> build_mesh(const MeshData& mesh, const Name& name) {
+  REI_ASSERT(mesh.normals.size() == mesh.positions.size());
+  vector<Mesh::Vertex> va = convert_vertices(mesh.streams(), Mat4::I());
+  vector<Mesh::Triangle> ta(mesh.triangle_num());
+  parallel_for(0, ta.size(), 1 << 14, [&](size_t i) {
+    const uint32_t* t = mesh.indices.data() + i * 3;
+    ta[i] = Mesh::Triangle(t[0], t[1], t[2]);
+  });
+  auto ret = std::make_shared<Mesh>(name);
+  ret->set(std::move(va), std::move(ta));
+  return ret;
+}
+
+} // namespace rei
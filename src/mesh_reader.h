@@ -0,0 +1,63 @@
+#ifndef REI_MESH_READER_H
+#define REI_MESH_READER_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "geometry.h"
+#include "mesh_import.h"
+
+/*
+ * mesh_reader.h
+ * Native readers for plain mesh formats (Wavefront OBJ, PLY), for large scanned meshes where
+ * going through assimp would be slow. Files are mapped and parsed in parallel.
+ */
+
+namespace rei {
+
+// Vertex and triangle streams of a single mesh, as read from a file
+struct MeshData {
+  std::vector<float> positions;       // xyz
+  std::vector<float> normals;         // xyz, or empty
+  std::vector<float> colors;          // rgba, or empty
+  std::vector<std::uint32_t> indices; // three per triangle
+
+  size_t vertex_num() const { return positions.size() / 3; }
+  size_t triangle_num() const { return indices.size() / 3; }
+  MeshStreams streams() const;
+};
+
+/*
+ * OBJ: `v` (with optional rgb), `vn` and `f` records; polygons are fan-triangulated, negative
+ * indices are resolved. Normals are kept only if the file gives one per position and faces
+ * reference them by the position index; texture coordinates, groups and materials are ignored.
+ * The file is split into line-aligned chunks, which are parsed on the thread pool.
+ *
+ * PLY: ascii, binary_little_endian and binary_big_endian. Vertices take x/y/z, nx/ny/nz and
+ * red/green/blue/alpha (integer colors are normalized); faces take the vertex_indices (or
+ * vertex_index) list. Binary vertex records are copied straight out of the mapping at their
+ * stride; so are faces when every face is a triangle.
+ *
+ * Return false, with a warning, if the data is malformed or an index is out of range.
+ */
+bool read_obj(const std::uint8_t* data, size_t size, MeshData& out);
+bool read_ply(const std::uint8_t* data, size_t size, MeshData& out);
+
+// True for the extensions read_mesh_data understands (.obj, .ply, in any case)
+bool has_native_reader(const std::string& filename);
+
+// Map the file and read it by its extension; normals are computed if the file has none
+bool read_mesh_data(const std::string& filename, MeshData& out);
+
+// Area-weighted vertex normals from the triangles
+void compute_vertex_normals(MeshData& mesh);
+
+// Mesh in the renderer's layout; vertices without color get k_import_default_color.
+// `mesh` must have normals.
+std::shared_ptr<Mesh> build_mesh(const MeshData& mesh, const Name& name);
+
+} // namespace rei
+
+#endif
@@ -0,0 +1,108 @@
+// source of model_index.h
+#include "model_index.h"
+
+namespace rei {
+
+void ModelSpatialIndex::insert(ModelHandle model, const Aabb& local_bounds, const Mat4& world) {
+  if (local_bounds.empty()) return;
+  REI_ASSERT(!contains(model));
+  const size_t slot = model.index();
+  if (slot >= m_proxy_of_slot.size()) {
+    m_proxy_of_slot.resize(slot + 1, DynamicAabbTree::k_null);
+    m_handle_of_slot.resize(slot + 1);
+  }
+  const DynamicAabbTree::ProxyId proxy =
+    m_tree.insert(local_bounds.transformed(world), model.value);
+  if (proxy >= m_local_bounds.size()) m_local_bounds.resize(proxy + 1);
+  m_local_bounds[proxy] = local_bounds;
+  m_proxy_of_slot[slot] = proxy;
+  m_handle_of_slot[slot] = model;
+}
+
+bool ModelSpatialIndex::contains(ModelHandle model) const {
+  const size_t slot = model.index();
+  return slot < m_proxy_of_slot.size() && m_proxy_of_slot[slot] != DynamicAabbTree::k_null
+         && m_handle_of_slot[slot] == model;
+}
+
+void ModelSpatialIndex::remove(ModelHandle model) {
+  if (!contains(model)) return;
+  const size_t slot = model.index();
+  m_tree.remove(m_proxy_of_slot[slot]);
+  m_proxy_of_slot[slot] = DynamicAabbTree::k_null;
+  m_handle_of_slot[slot] = ModelHandle();
+}
+
+void ModelSpatialIndex::update(ModelHandle model, const Mat4& world) {
+  if (!contains(model)) return;
+  const DynamicAabbTree::ProxyId proxy = m_proxy_of_slot[model.index()];
+  m_tree.move(proxy, m_local_bounds[proxy].transformed(world));
+}
+
+void ModelSpatialIndex::update(
+  ModelHandle model, const GeometryPtr& geometry, const Mat4& world) {
+  const Aabb& local_bounds = geometry_bounds(geometry);
+  if (!contains(model)) {
+    insert(model, local_bounds, world);
+    return;
+  }
+  if (local_bounds.empty()) {
+    remove(model);
+    return;
+  }
+  const DynamicAabbTree::ProxyId proxy = m_proxy_of_slot[model.index()];
+  m_local_bounds[proxy] = local_bounds;
+  m_tree.move(proxy, local_bounds.transformed(world));
+}
+
+void ModelSpatialIndex::clear() {
+  m_tree.clear();
+  m_proxy_of_slot.clear();
+  m_handle_of_slot.clear();
+  m_local_bounds.clear();
+  m_geometry_bounds.clear();
+  m_synced_version = 0;
+  m_geometries_synced = 0;
+}
+
+const Aabb& ModelSpatialIndex::geometry_bounds(const GeometryPtr& geometry) {
+  static const Aabb no_bounds;
+  if (!geometry) return no_bounds;
+  CachedBounds& cached = m_geometry_bounds[geometry.get()];
+  if (cached.geometry.lock() == geometry && cached.version == geometry->version())
+    return cached.bounds;
+
+  Aabb bounds;
+  if (const Mesh* mesh = dynamic_cast<const Mesh*>(geometry.get())) {
+    for (const Mesh::Vertex& v : mesh->get_vertices())
+      bounds.expand(Vec3(v.coord));
+  } else if (const PackedMesh* packed = dynamic_cast<const PackedMesh*>(geometry.get())) {
+    bounds.expand(packed->bound_min());
+    bounds.expand(packed->bound_max());
+  } else if (const auto* pending = dynamic_cast<const PendingGeometry*>(geometry.get())) {
+    bounds.expand(pending->bound_min());
+    bounds.expand(pending->bound_max());
+  }
+  cached.geometry = geometry;
+  cached.version = geometry->version();
+  cached.bounds = bounds;
+  return cached.bounds;
+}
+
+std::vector<ModelStore::Id> ModelSpatialIndex::take_edited_geometries() {
+  std::vector<ModelStore::Id> edited;
+  std::vector<const Geometry*> freed;
+  for (const auto& kv : m_geometry_bounds) {
+    std::shared_ptr<const Geometry> geometry = kv.second.geometry.lock();
+    if (!geometry)
+      freed.push_back(kv.first);
+    else if (geometry->version() != kv.second.version)
+      edited.push_back(ModelStore::Id(kv.first));
+  }
+  for (const Geometry* geometry : freed)
+    m_geometry_bounds.erase(geometry);
+  std::sort(edited.begin(), edited.end());
+  return edited;
+}
+
+} // namespace rei
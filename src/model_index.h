@@ -0,0 +1,121 @@
+#ifndef REI_MODEL_INDEX_H
+#define REI_MODEL_INDEX_H
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include "aabb.h"
+#include "aabb_tree.h"
+#include "container_utils.h"
+#include "geometry.h"
+#include "model_store.h"
+
+/*
+ * model_index.h
+ * Spatial index over the world bounds of scene models.
+ */
+
+namespace rei {
+
+/*
+ * Keeps a DynamicAabbTree in sync with a ModelStore. Models are inserted with their
+ * geometry's local bounds; on sync() every model changed since the last sync is updated, each in
+ * O(log n) (or O(1) while it stays in its fat box), and a few leaves are rebalanced.
+ *
+ * The index is only as fresh as the last sync(): moving a model or swapping its geometry just
+ * marks it in the store's change journal (Scene::update_transforms and
+ * Scene::update_spatial_index sync). A sync reads the geometry again for every changed model, so
+ * models enter the index when they get bounds and leave it when they lose them, and it refits
+ * the models of geometries edited in place since the last sync.
+ */
+class ModelSpatialIndex {
+public:
+  using BatchResult = DynamicAabbTree::BatchResult; // items are ModelHandle values
+
+  ModelSpatialIndex() = default;
+
+  // Models without bounds (e.g. no geometry) are ignored
+  void insert(ModelHandle model, const Aabb& local_bounds, const Mat4& world);
+  void insert(ModelHandle model, const GeometryPtr& geometry, const Mat4& world) {
+    insert(model, geometry_bounds(geometry), world);
+  }
+  void remove(ModelHandle model);
+  bool contains(ModelHandle model) const;
+  void update(ModelHandle model, const Mat4& world);
+  // Insert, refit or remove the model after its geometry or transform changed
+  void update(ModelHandle model, const GeometryPtr& geometry, const Mat4& world);
+
+  // Update the models changed in `store` since the last sync, with GeometryPtr
+  // geometry_of(ModelHandle) telling their current geometry; return the number of changed models
+  template <typename F>
+  size_t sync(const ModelStore& store, F geometry_of) {
+    size_t count = 0;
+    store.changes_since(m_synced_version, [&](ModelHandle model) {
+      update(model, geometry_of(model), store.transform(model));
+      count++;
+    });
+    m_synced_version = store.version();
+    // Geometries edited in place leave the store as it is; their models are found by geometry id
+    if (Geometry::latest_version() != m_geometries_synced) {
+      m_geometries_synced = Geometry::latest_version();
+      std::vector<ModelStore::Id> edited = take_edited_geometries();
+      for (size_t i = 0; !edited.empty() && i < store.size(); i++) {
+        if (!std::binary_search(edited.begin(), edited.end(), store.geometries()[i])) continue;
+        const ModelHandle model = store.handles()[i];
+        update(model, geometry_of(model), store.transforms()[i]);
+        count++;
+      }
+    }
+    m_tree.rebalance(rebalance_budget);
+    return count;
+  }
+  void clear();
+
+  size_t size() const { return m_tree.size(); }
+  const DynamicAabbTree& tree() const { return m_tree; }
+
+  // Bounds of a geometry in its own space; cached per geometry and version
+  const Aabb& geometry_bounds(const GeometryPtr& geometry);
+
+  // f(ModelHandle) for every model whose (fat) world bounds pass the test
+  template <typename Volume, typename F>
+  void query(const Volume& volume, F&& f) const {
+    m_tree.query(volume, [&](std::uint32_t user) { f(ModelHandle(user)); });
+  }
+  // f(ModelHandle, t_enter) returns the new t_max
+  template <typename F>
+  void query(const DynamicAabbTree::Ray& ray, F&& f) const {
+    m_tree.query(ray, [&](std::uint32_t user, double t) { return f(ModelHandle(user), t); });
+  }
+  template <typename Volume>
+  void query(const std::vector<Volume>& volumes, BatchResult& result) const {
+    m_tree.query(volumes, result);
+  }
+
+  // Rebalance budget per sync
+  size_t rebalance_budget = 16;
+
+private:
+  DynamicAabbTree m_tree;
+  std::vector<DynamicAabbTree::ProxyId> m_proxy_of_slot; // by handle index
+  std::vector<ModelHandle> m_handle_of_slot;
+  std::vector<Aabb> m_local_bounds; // by proxy
+  ModelStore::Version m_synced_version = 0;
+
+  // Keyed by address, so each entry checks it still describes the geometry living there
+  struct CachedBounds {
+    std::weak_ptr<const Geometry> geometry;
+    Geometry::Version version = 0;
+    Aabb bounds;
+  };
+  Hashmap<const Geometry*, CachedBounds> m_geometry_bounds;
+  Geometry::Version m_geometries_synced = 0;
+
+  // Sorted ids of the cached geometries changed since they were cached; drops freed ones
+  std::vector<ModelStore::Id> take_edited_geometries();
+};
+
+} // namespace rei
+
+#endif
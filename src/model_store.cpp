@@ -0,0 +1,157 @@
+// source of model_store.h
+#include "model_store.h"
+
+namespace rei {
+
+ModelHandle ModelStore::create(
+  const Mat4& transform, Id geometry, Id material, std::uint32_t flags) {
+  std::uint32_t index;
+  if (!m_free_slots.empty()) {
+    index = m_free_slots.front();
+    m_free_slots.pop_front();
+  } else {
+    index = std::uint32_t(m_slots.size());
+    if (index > ModelHandle::k_index_mask) {
+      REI_ERROR("ModelStore is out of handle slots");
+      return ModelHandle();
+    }
+    m_slots.emplace_back();
+  }
+
+  Slot& slot = m_slots[index];
+  slot.dense = std::uint32_t(m_handles.size());
+  ModelHandle h(index, slot.generation);
+
+  m_transforms.push_back(transform);
+  m_geometries.push_back(geometry);
+  m_materials.push_back(material);
+  m_flags.push_back(flags);
+  m_handles.push_back(h);
+  m_versions.push_back(0);
+  touch(m_handles.size() - 1);
+  return h;
+}
+
+void ModelStore::destroy(ModelHandle h) {
+  if (!valid(h)) {
+    REI_WARNING("Destroying an invalid model handle");
+    return;
+  }
+  Slot& slot = m_slots[h.index()];
+  const std::uint32_t dense = slot.dense;
+  const std::uint32_t last = std::uint32_t(m_handles.size() - 1);
+
+  if (dense != last) {
+    m_transforms[dense] = m_transforms[last];
+    m_geometries[dense] = m_geometries[last];
+    m_materials[dense] = m_materials[last];
+    m_flags[dense] = m_flags[last];
+    m_handles[dense] = m_handles[last];
+    m_versions[dense] = m_versions[last];
+    m_slots[m_handles[dense].index()].dense = dense;
+  }
+  m_transforms.pop_back();
+  m_geometries.pop_back();
+  m_materials.pop_back();
+  m_flags.pop_back();
+  m_handles.pop_back();
+  m_versions.pop_back();
+
+  {
+    std::lock_guard<std::mutex> lock(m_journal_mutex);
+    record(h, ++m_version, true);
+  }
+
+  slot.dense = k_no_dense;
+  // A slot whose generation is exhausted is retired instead of risking a stale handle match
+  if (slot.generation < ModelHandle::k_max_generation) {
+    slot.generation++;
+    m_free_slots.push_back(h.index());
+  }
+}
+
+void ModelStore::set_transform(ModelHandle h, const Mat4& t) {
+  const size_t i = dense_index(h);
+  m_transforms[i] = t;
+  touch(i);
+}
+
+void ModelStore::set_geometry(ModelHandle h, Id g) {
+  const size_t i = dense_index(h);
+  m_geometries[i] = g;
+  touch(i);
+}
+
+void ModelStore::set_material(ModelHandle h, Id m) {
+  const size_t i = dense_index(h);
+  m_materials[i] = m;
+  touch(i);
+}
+
+void ModelStore::set_flags(ModelHandle h, std::uint32_t f) {
+  const size_t i = dense_index(h);
+  m_flags[i] = f;
+  touch(i);
+}
+
+void ModelStore::mark_changed(const ModelHandle* handles, size_t count) {
+  std::lock_guard<std::mutex> lock(m_journal_mutex);
+  for (size_t i = 0; i < count; i++) {
+    if (!valid(handles[i])) continue;
+    m_versions[m_slots[handles[i].index()].dense] = ++m_version;
+    record(handles[i], m_version, false);
+  }
+}
+
+void ModelStore::touch(size_t dense) {
+  std::lock_guard<std::mutex> lock(m_journal_mutex);
+  m_versions[dense] = ++m_version;
+  record(m_handles[dense], m_version, false);
+}
+
+void ModelStore::record(ModelHandle h, Version version, bool removed) {
+  m_journal.push_back({h, version, removed});
+  // Keeps the journal within a constant factor of the model count, amortized O(1) per change
+  if (m_journal.size() > 2 * m_handles.size() + 64) compact_journal();
+}
+
+void ModelStore::compact_journal() {
+  // Superseded changes and changes of destroyed models are never reported again
+  auto stale = [&](const Change& c) {
+    if (c.removed) return false;
+    return !valid(c.handle) || m_versions[dense_index(c.handle)] != c.version;
+  };
+  m_journal.erase(std::remove_if(m_journal.begin(), m_journal.end(), stale), m_journal.end());
+
+  // Removals can outnumber live models; the oldest ones are dropped, and consumers that have
+  // not synced since then are told to resync
+  const size_t removal_limit = m_handles.size() + 64;
+  size_t removals = 0;
+  for (const Change& c : m_journal)
+    removals += c.removed;
+  if (removals <= removal_limit) return;
+  size_t to_drop = removals - removal_limit / 2;
+  auto dropped = std::remove_if(m_journal.begin(), m_journal.end(), [&](const Change& c) {
+    if (!c.removed || to_drop == 0) return false;
+    to_drop--;
+    m_journal_floor = c.version;
+    return true;
+  });
+  m_journal.erase(dropped, m_journal.end());
+}
+
+void ModelStore::clear() {
+  for (size_t i = m_handles.size(); i-- > 0;)
+    destroy(m_handles[i]);
+}
+
+void ModelStore::reserve(size_t n) {
+  m_transforms.reserve(n);
+  m_geometries.reserve(n);
+  m_materials.reserve(n);
+  m_flags.reserve(n);
+  m_handles.reserve(n);
+  m_versions.reserve(n);
+}
+
+} // namespace rei
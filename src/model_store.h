@@ -0,0 +1,181 @@
+#ifndef REI_MODEL_STORE_H
+#define REI_MODEL_STORE_H
+
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+#include "algebra.h"
+#include "debug.h"
+
+/*
+ * model_store.h
+ * Data-oriented storage of scene models: packed SoA columns addressed by generational handles.
+ */
+
+namespace rei {
+
+/*
+ * 32-bit model handle: 24-bit slot index and 8-bit generation.
+ * A zero value is the null handle (generations start at 1).
+ */
+struct ModelHandle {
+  static constexpr std::uint32_t k_index_bits = 24;
+  static constexpr std::uint32_t k_index_mask = (1u << k_index_bits) - 1;
+  static constexpr std::uint32_t k_max_generation = 0xFF;
+
+  std::uint32_t value = 0;
+
+  constexpr ModelHandle() = default;
+  constexpr explicit ModelHandle(std::uint32_t v) : value(v) {}
+  constexpr ModelHandle(std::uint32_t index, std::uint32_t generation)
+      : value((generation << k_index_bits) | (index & k_index_mask)) {}
+
+  constexpr std::uint32_t index() const { return value & k_index_mask; }
+  constexpr std::uint32_t generation() const { return value >> k_index_bits; }
+  constexpr bool null() const { return value == 0; }
+  constexpr explicit operator bool() const { return value != 0; }
+
+  constexpr bool operator==(ModelHandle other) const { return value == other.value; }
+  constexpr bool operator!=(ModelHandle other) const { return value != other.value; }
+
+  struct Hasher {
+    std::size_t operator()(ModelHandle h) const { return std::hash<std::uint32_t>()(h.value); }
+  };
+};
+
+/*
+ * Columns are kept dense (no holes) by swap-removal, so iterating [0, size()) touches only live
+ * models, in contiguous memory. Slots map handles to dense positions in O(1).
+ *
+ * Changes are versioned: every create, destroy and set_* stamps a new store version and appends
+ * to a change journal. Any number of consumers (spatial index, render pipelines) remember the
+ * version they last synced to and visit only what changed since, in O(changes) rather than
+ * O(models).
+ */
+class ModelStore {
+public:
+  using Id = std::uintptr_t; // geometry/material runtime id; see Scene::get_id
+  using Version = std::uint64_t;
+
+  enum Flag : std::uint32_t {
+    Visible = 1 << 0,
+    CastShadow = 1 << 1,
+  };
+  static constexpr std::uint32_t k_default_flags = Visible | CastShadow;
+
+  ModelStore() = default;
+
+  ModelHandle create(const Mat4& transform, Id geometry, Id material,
+    std::uint32_t flags = k_default_flags);
+  // Swap-remove; the last model moves into the freed dense position
+  void destroy(ModelHandle h);
+  void clear();
+
+  bool valid(ModelHandle h) const {
+    const std::uint32_t index = h.index();
+    return !h.null() && index < m_slots.size() && m_slots[index].generation == h.generation()
+           && m_slots[index].dense != k_no_dense;
+  }
+
+  size_t size() const { return m_handles.size(); }
+  bool empty() const { return m_handles.empty(); }
+  void reserve(size_t n);
+
+  // Handle -> dense position
+  size_t dense_index(ModelHandle h) const {
+    REI_ASSERT(valid(h));
+    return m_slots[h.index()].dense;
+  }
+
+  // Per-handle access; setters are thread-safe for distinct handles
+  const Mat4& transform(ModelHandle h) const { return m_transforms[dense_index(h)]; }
+  void set_transform(ModelHandle h, const Mat4& t);
+  Id geometry(ModelHandle h) const { return m_geometries[dense_index(h)]; }
+  void set_geometry(ModelHandle h, Id g);
+  Id material(ModelHandle h) const { return m_materials[dense_index(h)]; }
+  void set_material(ModelHandle h, Id m);
+  std::uint32_t flags(ModelHandle h) const { return m_flags[dense_index(h)]; }
+  void set_flags(ModelHandle h, std::uint32_t f);
+  // Stamp models written through the raw columns as changed, under a single lock; stale handles
+  // are skipped. Batched writers (e.g. an Animator) use it instead of one set_* per model.
+  void mark_changed(const ModelHandle* handles, size_t count);
+
+  // Latest version stamped on any model; 0 for a store that never changed
+  Version version() const { return m_version; }
+  // Version of the last change to a model
+  Version version(ModelHandle h) const { return m_versions[dense_index(h)]; }
+
+  // Visit f(handle) for every live model created or changed after version `since`, each once,
+  // in the order of their last change. Writes through the raw columns are not tracked.
+  template <typename F>
+  void changes_since(Version since, F&& f) const {
+    for (auto it = journal_after(since); it != m_journal.end(); ++it) {
+      // Earlier entries of a model changed again are superseded by its last entry
+      if (valid(it->handle) && m_versions[dense_index(it->handle)] == it->version) f(it->handle);
+    }
+  }
+  // Visit f(handle) for every model destroyed after version `since`
+  template <typename F>
+  void removals_since(Version since, F&& f) const {
+    for (auto it = journal_after(since); it != m_journal.end(); ++it)
+      if (it->removed) f(it->handle);
+  }
+  // False if removals after `since` may have been dropped from the journal; the consumer has to
+  // compare its whole state against the store instead
+  bool covers(Version since) const { return since >= m_journal_floor; }
+
+  // Dense columns, all of size(); for cache-friendly iteration
+  const Mat4* transforms() const { return m_transforms.data(); }
+  Mat4* transforms() { return m_transforms.data(); }
+  const Id* geometries() const { return m_geometries.data(); }
+  const Id* materials() const { return m_materials.data(); }
+  const std::uint32_t* flags() const { return m_flags.data(); }
+  std::uint32_t* flags() { return m_flags.data(); }
+  const ModelHandle* handles() const { return m_handles.data(); }
+
+private:
+  static constexpr std::uint32_t k_no_dense = UINT32_MAX;
+
+  struct Slot {
+    std::uint32_t dense = k_no_dense;
+    std::uint32_t generation = 1;
+  };
+
+  // Sparse
+  std::vector<Slot> m_slots;
+  std::deque<std::uint32_t> m_free_slots; // FIFO, so generations cycle slowly
+
+  // Dense columns
+  std::vector<Mat4> m_transforms;
+  std::vector<Id> m_geometries;
+  std::vector<Id> m_materials;
+  std::vector<std::uint32_t> m_flags;
+  std::vector<ModelHandle> m_handles;
+  std::vector<Version> m_versions;
+
+  // Sorted by version; superseded and destroyed entries are compacted away as it grows
+  struct Change {
+    ModelHandle handle;
+    Version version;
+    bool removed;
+  };
+  std::vector<Change> m_journal;
+  Version m_version = 0;
+  Version m_journal_floor = 0;
+  std::mutex m_journal_mutex;
+
+  void touch(size_t dense);
+  void record(ModelHandle h, Version version, bool removed);
+  void compact_journal();
+  std::vector<Change>::const_iterator journal_after(Version since) const {
+    return std::upper_bound(m_journal.begin(), m_journal.end(), since,
+      [](Version v, const Change& c) { return v < c.version; });
+  }
+};
+
+} // namespace rei
+
+#endif
@@ -0,0 +1,93 @@
+// source of name.h
+#include "name.h"
+
+#include <atomic>
+#include <mutex>
+#include <shared_mutex>
+#include <stdexcept>
+#include <unordered_map>
+
+#include "debug.h"
+
+namespace rei {
+
+namespace {
+
+/*
+ * Strings by symbol, in fixed-size chunks that never move once allocated, so a reader only
+ * loads a chunk pointer. Interning looks the string up under a shared lock and appends under an
+ * exclusive one; the lookup table keys view the stored strings, so probing it allocates nothing.
+ */
+class NameTable {
+public:
+  NameTable() {
+    for (auto& chunk : m_chunks)
+      chunk.store(nullptr, std::memory_order_relaxed);
+    const Name::Symbol empty = intern(std::wstring_view());
+    REI_ASSERT(empty == 0);
+  }
+
+  const std::wstring& get(Name::Symbol symbol) const {
+    const std::wstring* chunk = m_chunks[symbol >> k_chunk_bits].load(std::memory_order_acquire);
+    return chunk[symbol & k_chunk_mask];
+  }
+
+  Name::Symbol intern(std::wstring_view str) {
+    {
+      std::shared_lock<std::shared_mutex> lock(m_mutex);
+      auto it = m_symbols.find(str);
+      if (it != m_symbols.end()) return it->second;
+    }
+    std::unique_lock<std::shared_mutex> lock(m_mutex);
+    auto it = m_symbols.find(str); // someone else may have added it in between
+    if (it != m_symbols.end()) return it->second;
+
+    const size_t symbol = m_count.load(std::memory_order_relaxed);
+    // Going on would write past the chunk table
+    if (symbol >= k_max_chunks * k_chunk_size) REI_THROW("NameTable: out of name symbols");
+    std::atomic<std::wstring*>& chunk_slot = m_chunks[symbol >> k_chunk_bits];
+    std::wstring* chunk = chunk_slot.load(std::memory_order_relaxed);
+    if (!chunk) {
+      chunk = new std::wstring[k_chunk_size]; // never freed; names outlive everything
+      chunk_slot.store(chunk, std::memory_order_release);
+    }
+    std::wstring& stored = chunk[symbol & k_chunk_mask];
+    stored.assign(str.data(), str.size());
+    m_symbols.emplace(std::wstring_view(stored), Name::Symbol(symbol));
+    m_count.store(symbol + 1, std::memory_order_release);
+    return Name::Symbol(symbol);
+  }
+
+  size_t count() const { return m_count.load(std::memory_order_acquire); }
+
+private:
+  static constexpr size_t k_chunk_bits = 10;
+  static constexpr size_t k_chunk_size = size_t(1) << k_chunk_bits;
+  static constexpr size_t k_chunk_mask = k_chunk_size - 1;
+  static constexpr size_t k_max_chunks = 4096; // about four million names
+
+  std::atomic<std::wstring*> m_chunks[k_max_chunks];
+  std::atomic<size_t> m_count {0};
+  std::shared_mutex m_mutex;
+  std::unordered_map<std::wstring_view, Name::Symbol> m_symbols;
+};
+
+NameTable& name_table() {
+  // Leaked on purpose: names in static objects may be read during exit
+  static NameTable* table = new NameTable();
+  return *table;
+}
+
+} // namespace
+
+Name::Name(std::wstring_view str) : m_symbol(name_table().intern(str)) {}
+
+const std::wstring& Name::str() const {
+  return name_table().get(m_symbol);
+}
+
+size_t Name::interned_count() {
+  return name_table().count();
+}
+
+} // namespace rei
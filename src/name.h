@@ -0,0 +1,65 @@
+#ifndef REI_NAME_H
+#define REI_NAME_H
+
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <string_view>
+
+/*
+ * name.h
+ * Interned names: the string is stored once per process, and a Name is its 32-bit symbol.
+ */
+
+namespace rei {
+
+/*
+ * A name of a scene object, resource or property.
+ * Construction interns the string (no allocation if it was seen before); copying, comparing and
+ * hashing are integer operations, and reading the string back takes no lock. Interned strings
+ * live until the process exits, so names should come from a bounded set, not from per-frame
+ * formatting; interning a new string past about four million names throws std::runtime_error.
+ */
+class Name {
+public:
+  using Symbol = std::uint32_t;
+
+  Name() = default; // the empty name
+  Name(const wchar_t* str) : Name(std::wstring_view(str)) {}
+  Name(const std::wstring& str) : Name(std::wstring_view(str)) {}
+  Name(std::wstring_view str);
+
+  Symbol symbol() const { return m_symbol; }
+  bool empty() const { return m_symbol == 0; }
+
+  const std::wstring& str() const;
+  const wchar_t* c_str() const { return str().c_str(); }
+  size_t size() const { return str().size(); }
+
+  friend bool operator==(Name a, Name b) { return a.m_symbol == b.m_symbol; }
+  friend bool operator!=(Name a, Name b) { return a.m_symbol != b.m_symbol; }
+  // Order of interning, not alphabetical; for ordered containers only
+  friend bool operator<(Name a, Name b) { return a.m_symbol < b.m_symbol; }
+
+  friend std::wostream& operator<<(std::wostream& os, Name name) { return os << name.str(); }
+
+  // Number of distinct names interned so far, including the empty one
+  static size_t interned_count();
+
+private:
+  Symbol m_symbol = 0;
+};
+
+} // namespace rei
+
+namespace std {
+
+template <>
+struct hash<rei::Name> {
+  size_t operator()(rei::Name name) const { return hash<rei::Name::Symbol>()(name.symbol()); }
+};
+
+} // namespace std
+
+#endif
@@ -0,0 +1,544 @@
+// source of null_renderer.h
+#include "null_renderer.h"
+
+#include <algorithm>
+
+#include "../geometry.h"
+
+using std::make_shared;
+using std::shared_ptr;
+
+namespace rei {
+
+namespace null {
+
+struct BufferData : BaseBufferData {
+  using BaseBufferData::BaseBufferData;
+  BufferKind kind;
+  size_t element_count = 1;
+  ConstBufferLayout layout; // element layout of const, instance and structured buffers
+  size_t element_bytes = 0;
+  ResourceState state = ResourceState::Undefined;
+  StateTracking<ResourceState> tracking;
+};
+
+struct ShaderData : BaseShaderData {
+  using BaseShaderData::BaseShaderData;
+  enum class Kind {
+    Rasterization,
+    Compute,
+    Raytracing,
+  } kind;
+  bool is_instanced = false;
+};
+
+struct ShaderArgumentData : BaseShaderArgument {
+  using BaseShaderArgument::BaseShaderArgument;
+  // Textures bound, whose states are checked when the argument is used
+  std::vector<std::shared_ptr<BufferData>> shader_resources;
+  std::vector<std::shared_ptr<BufferData>> unordered_accesses;
+};
+
+struct SwapchainData : BaseSwapchainData {
+  using BaseSwapchainData::BaseSwapchainData;
+  std::vector<BufferHandle> render_targets;
+  size_t current = 0;
+};
+
+// Like REI_ASSERT, but counted, so a headless run can tell whether it was clean
+#define REI_NULL_CHECK(expr) (REI_ASSERT(expr) ? true : (m_stats.failed_checks++, false))
+
+namespace {
+
+// Packed sizes, as HLSL lays out the members in a buffer element
+size_t width_of(ShaderDataType type) {
+  switch (type) {
+    case ShaderDataType::Float4:
+      return 4 * sizeof(float);
+    case ShaderDataType::Float4x4:
+      return 16 * sizeof(float);
+  }
+  REI_ERROR("Unhandled shader data type");
+  return 0;
+}
+
+size_t width_of(const ConstBufferLayout& layout) {
+  size_t sum = 0;
+  for (ShaderDataType member : layout.m_members)
+    sum += width_of(member);
+  return sum;
+}
+
+// In `state` with no split transition in flight, as a command using the texture needs
+bool is_ready(const BufferData& buffer, ResourceState state) {
+  return buffer.state == state && !buffer.tracking.splitting;
+}
+
+} // namespace
+
+/*
+ * The prepare() list counts into the renderer's stats directly. Other lists count into their
+ * own, merged by submit(), and look handles up without touching reference counts, so they can
+ * record on several threads at once.
+ */
+class CommandList : public rei::CommandList {
+public:
+  CommandList(Renderer* owner, bool is_main)
+      : m_owner(owner),
+        m_is_main(is_main),
+        m_stats(is_main ? owner->m_stats : m_local_stats),
+        m_commands(is_main ? owner->m_commands : m_local_commands) {}
+
+  void begin_render_pass(const RenderPassCommand& cmd) override;
+  void end_render_pass() override;
+
+  void transition(BufferHandle buffer, ResourceState state) override;
+  void barrier(BufferHandle buffer) override;
+  void begin_transition(BufferHandle buffer, ResourceState state) override;
+
+  void draw(const DrawCommand& cmd) override;
+  void dispatch(const DispatchCommand& dispatch) override;
+  using rei::CommandList::raytrace;
+  void raytrace(const RaytraceCommand& cmd) override;
+
+  void clear_texture(BufferHandle target, Vec4 clear_value, RenderArea clear_area) override;
+  void copy_texture(BufferHandle src, BufferHandle dest, bool revert_state = true) override;
+
+private:
+  friend class Renderer;
+  using Call = Renderer::Call;
+  using Stats = Renderer::Stats;
+
+  Renderer* const m_owner;
+  const bool m_is_main;
+  Stats m_local_stats;
+  std::vector<Call> m_local_commands;
+  Stats& m_stats;
+  std::vector<Call>& m_commands;
+  bool m_open = false; // opened and not submitted yet; the prepare() list is never closed
+  bool m_in_render_pass = false;
+
+  void record(Call call) {
+    m_stats.calls[size_t(call)]++;
+    if (m_owner->m_options.record_commands) m_commands.push_back(call);
+  }
+
+  BufferData* to_buffer(const BufferHandle& h) { return m_owner->peek_data<BufferData>(h); }
+  ShaderData* to_shader(const ShaderHandle& h) { return m_owner->peek_data<ShaderData>(h); }
+  ShaderArgumentData* to_argument(const ShaderArgumentHandle& h) {
+    return m_owner->peek_data<ShaderArgumentData>(h);
+  }
+
+  // Issue the batched barriers, before a command depending on them
+  void flush_barriers();
+  // Also check the states of the textures bound, with `read_state` for shader resources;
+  // Undefined skips that, for arguments only recorded
+  void check_arguments(const ShaderArguments& arguments, ResourceState read_state);
+};
+
+Renderer::Renderer() : Renderer(Options()) {}
+
+Renderer::Renderer(Options options)
+    : m_options(options), m_main_list(std::make_unique<CommandList>(this, true)) {}
+
+Renderer::~Renderer() = default;
+
+shared_ptr<BufferData> Renderer::to_buffer(BufferHandle h) {
+  return get_data<BufferHandle, BufferData>(h);
+}
+
+shared_ptr<ShaderData> Renderer::to_shader(ShaderHandle h) {
+  return get_data<ShaderHandle, ShaderData>(h);
+}
+
+shared_ptr<ShaderArgumentData> Renderer::to_argument(ShaderArgumentHandle h) {
+  return get_data<ShaderArgumentHandle, ShaderArgumentData>(h);
+}
+
+shared_ptr<SwapchainData> Renderer::to_swapchain(SwapchainHandle h) {
+  return get_data<SwapchainHandle, SwapchainData>(h);
+}
+
+SwapchainHandle Renderer::create_swapchain(
+  SystemWindowID /*window_id*/, size_t width, size_t height, size_t rendertarget_count) {
+  REI_NULL_CHECK(rendertarget_count > 0);
+  record(Call::CreateSwapchain);
+  auto swapchain = make_shared<SwapchainData>(this);
+  TextureDesc desc = TextureDesc::render_target(width, height, ResourceFormat::B8G8R8A8_UNORM);
+  for (size_t i = 0; i < rendertarget_count; i++)
+    swapchain->render_targets.push_back(
+      create_texture_2d(desc, ResourceState::Present, L"Swapchain Buffer"));
+  return SwapchainHandle(swapchain);
+}
+
+BufferHandle Renderer::fetch_swapchain_render_target_buffer(SwapchainHandle handle) {
+  auto swapchain = to_swapchain(handle);
+  REI_NULL_CHECK(swapchain);
+  return swapchain->render_targets[swapchain->current];
+}
+
+BufferHandle Renderer::create_texture_2d(
+  const TextureDesc& desc, ResourceState init_state, Name /*debug_name*/) {
+  REI_NULL_CHECK(desc.width > 0 && desc.height > 0);
+  record(Call::CreateTexture);
+  m_stats.texture_bytes += desc.bytes();
+  auto texture = make_shared<BufferData>(this);
+  texture->kind = BufferKind::Texture;
+  texture->state = init_state;
+  return BufferHandle(texture);
+}
+
+BufferHandle Renderer::create_element_buffer(
+  const ConstBufferLayout& layout, size_t num, BufferKind kind) {
+  REI_NULL_CHECK(num > 0 && layout.size() > 0);
+  record(Call::CreateBuffer);
+  auto buffer = make_shared<BufferData>(this);
+  buffer->kind = kind;
+  buffer->element_count = num;
+  buffer->layout = layout;
+  buffer->element_bytes = width_of(layout);
+  return BufferHandle(buffer);
+}
+
+BufferHandle Renderer::create_const_buffer(
+  const ConstBufferLayout& layout, size_t num, Name /*debug_name*/) {
+  return create_element_buffer(layout, num, BufferKind::ConstBuffer);
+}
+
+BufferHandle Renderer::create_instance_buffer(
+  const ConstBufferLayout& layout, size_t num, Name /*debug_name*/) {
+  return create_element_buffer(layout, num, BufferKind::InstanceBuffer);
+}
+
+BufferHandle Renderer::create_structured_buffer(
+  const ConstBufferLayout& layout, size_t num, Name /*debug_name*/) {
+  return create_element_buffer(layout, num, BufferKind::StructuredBuffer);
+}
+
+void Renderer::update_const_buffer(
+  BufferHandle handle, size_t index, size_t member, Vec4 /*value*/) {
+  auto buffer = to_buffer(handle);
+  REI_NULL_CHECK(buffer && buffer->element_bytes > 0);
+  REI_NULL_CHECK(index < buffer->element_count && member < buffer->layout.size());
+  REI_NULL_CHECK(buffer->layout[member] == ShaderDataType::Float4);
+  record(Call::UpdateBuffer);
+  m_stats.uploaded_bytes += width_of(ShaderDataType::Float4);
+}
+
+void Renderer::update_const_buffer(
+  BufferHandle handle, size_t index, size_t member, Mat4 /*value*/) {
+  auto buffer = to_buffer(handle);
+  REI_NULL_CHECK(buffer && buffer->element_bytes > 0);
+  REI_NULL_CHECK(index < buffer->element_count && member < buffer->layout.size());
+  REI_NULL_CHECK(buffer->layout[member] == ShaderDataType::Float4x4);
+  record(Call::UpdateBuffer);
+  m_stats.uploaded_bytes += width_of(ShaderDataType::Float4x4);
+}
+
+void Renderer::update_const_buffer(
+  BufferHandle handle, size_t index, const void* data, size_t bytes) {
+  auto buffer = to_buffer(handle);
+  REI_NULL_CHECK(buffer && data);
+  REI_NULL_CHECK(index < buffer->element_count && bytes == buffer->element_bytes);
+  record(Call::UpdateBuffer);
+  m_stats.uploaded_bytes += bytes;
+}
+
+void Renderer::update_buffer_elements(
+  BufferHandle handle, size_t first, const void* data, size_t count) {
+  auto buffer = to_buffer(handle);
+  REI_NULL_CHECK(buffer && (data || count == 0));
+  REI_NULL_CHECK(buffer->kind == BufferKind::InstanceBuffer
+             || buffer->kind == BufferKind::StructuredBuffer);
+  REI_NULL_CHECK(first + count <= buffer->element_count);
+  record(Call::UpdateBuffer);
+  m_stats.uploaded_bytes += count * buffer->element_bytes;
+}
+
+ShaderHandle Renderer::create_shader(const std::wstring& /*shader_path*/,
+  RasterizationShaderMetaInfo&& meta, const ShaderCompileConfig& /*config*/) {
+  record(Call::CreateShader);
+  auto shader = make_shared<ShaderData>(this);
+  shader->kind = ShaderData::Kind::Rasterization;
+  shader->is_instanced = meta.is_instanced;
+  return ShaderHandle(shader);
+}
+
+ShaderHandle Renderer::create_shader(const std::wstring& /*shader_path*/,
+  ComputeShaderMetaInfo&& /*meta*/, const ShaderCompileConfig& /*config*/) {
+  record(Call::CreateShader);
+  auto shader = make_shared<ShaderData>(this);
+  shader->kind = ShaderData::Kind::Compute;
+  return ShaderHandle(shader);
+}
+
+ShaderHandle Renderer::create_shader(const std::wstring& /*shader_path*/,
+  RaytracingShaderMetaInfo&& /*meta*/, const ShaderCompileConfig& /*config*/) {
+  record(Call::CreateShader);
+  auto shader = make_shared<ShaderData>(this);
+  shader->kind = ShaderData::Kind::Raytracing;
+  return ShaderHandle(shader);
+}
+
+ShaderArgumentHandle Renderer::create_shader_argument(ShaderArgumentValue arg_value) {
+  REI_NULL_CHECK(arg_value.const_buffer_offsets.size() <= arg_value.const_buffers.size());
+  for (size_t i = 0; i < arg_value.const_buffers.size(); i++) {
+    auto buffer = to_buffer(arg_value.const_buffers[i]);
+    REI_NULL_CHECK(buffer && buffer->element_bytes > 0);
+    if (i < arg_value.const_buffer_offsets.size())
+      REI_NULL_CHECK(arg_value.const_buffer_offsets[i] < buffer->element_count);
+  }
+  for (const BufferHandle& h : arg_value.shader_resources)
+    REI_NULL_CHECK(to_buffer(h));
+  for (const BufferHandle& h : arg_value.unordered_accesses)
+    REI_NULL_CHECK(to_buffer(h));
+  record(Call::CreateArgument);
+  auto arg = make_shared<ShaderArgumentData>(this);
+  for (const BufferHandle& h : arg_value.shader_resources) {
+    auto buffer = to_buffer(h);
+    if (buffer && buffer->kind == BufferKind::Texture) arg->shader_resources.push_back(buffer);
+  }
+  for (const BufferHandle& h : arg_value.unordered_accesses) {
+    auto buffer = to_buffer(h);
+    if (buffer && buffer->kind == BufferKind::Texture) arg->unordered_accesses.push_back(buffer);
+  }
+  return ShaderArgumentHandle(arg);
+}
+
+GeometryBuffers Renderer::create_geometry(const GeometryDesc& desc) {
+  REI_NULL_CHECK(desc.geometry);
+  record(Call::CreateGeometry);
+  size_t vertex_count = 1, index_count = 1;
+  if (const Mesh* mesh = dynamic_cast<const Mesh*>(desc.geometry.get())) {
+    vertex_count = mesh->get_vertices().size();
+    index_count = mesh->get_triangles().size() * 3;
+  }
+  auto make = [&](BufferKind kind, size_t count) {
+    auto buffer = make_shared<BufferData>(this);
+    buffer->kind = kind;
+    buffer->element_count = count;
+    return BufferHandle(buffer);
+  };
+  GeometryBuffers ret;
+  ret.vertex_buffer = make(BufferKind::VertexBuffer, vertex_count);
+  ret.index_buffer = make(BufferKind::IndexBuffer, index_count);
+  ret.blas_buffer = make(BufferKind::AccelStruct, 1);
+  return ret;
+}
+
+BufferHandle Renderer::create_raytracing_accel_struct(const RaytraceSceneDesc& desc) {
+  REI_NULL_CHECK(desc.blas_buffer.size() == desc.transform.size());
+  REI_NULL_CHECK(desc.blas_buffer.size() == desc.instance_id.size());
+  for (const BufferHandle& blas : desc.blas_buffer) {
+    auto buffer = to_buffer(blas);
+    REI_NULL_CHECK(buffer && buffer->kind == BufferKind::AccelStruct);
+  }
+  record(Call::CreateAccelStruct);
+  auto tlas = make_shared<BufferData>(this);
+  tlas->kind = BufferKind::AccelStruct;
+  tlas->element_count = desc.blas_buffer.size();
+  return BufferHandle(tlas);
+}
+
+BufferHandle Renderer::create_shader_table(
+  size_t intersection_count, ShaderHandle raytracing_shader) {
+  auto shader = to_shader(raytracing_shader);
+  REI_NULL_CHECK(shader && shader->kind == ShaderData::Kind::Raytracing);
+  record(Call::CreateShaderTable);
+  auto table = make_shared<BufferData>(this);
+  table->kind = BufferKind::ShaderTable;
+  table->element_count = intersection_count;
+  return BufferHandle(table);
+}
+
+BufferHandle Renderer::create_shader_table(const Scene& scene, ShaderHandle raytracing_shader) {
+  return create_shader_table(scene.get_models().size(), raytracing_shader);
+}
+
+void Renderer::update_shader_table(const UpdateShaderTable& cmd) {
+  auto shader = to_shader(cmd.shader);
+  auto table = to_buffer(cmd.shader_table);
+  REI_NULL_CHECK(shader && shader->kind == ShaderData::Kind::Raytracing);
+  REI_NULL_CHECK(table && table->kind == BufferKind::ShaderTable);
+  REI_NULL_CHECK(cmd.table_type == UpdateShaderTable::TableType::Hitgroup);
+  REI_NULL_CHECK(cmd.index < table->element_count);
+  m_main_list->check_arguments(cmd.arguments, ResourceState::Undefined);
+  record(Call::UpdateShaderTable);
+}
+
+void CommandList::begin_render_pass(const RenderPassCommand& cmd) {
+  REI_NULL_CHECK(!m_in_render_pass);
+  flush_barriers();
+  for (const BufferHandle& rt : cmd.render_targets) {
+    auto buffer = to_buffer(rt);
+    REI_NULL_CHECK(buffer && is_ready(*buffer, ResourceState::RenderTarget));
+  }
+  if (cmd.depth_stencil) {
+    auto buffer = to_buffer(cmd.depth_stencil);
+    REI_NULL_CHECK(buffer && is_ready(*buffer, ResourceState::DeptpWrite));
+  }
+  m_in_render_pass = true;
+  record(Call::BeginRenderPass);
+}
+
+void CommandList::end_render_pass() {
+  REI_NULL_CHECK(m_in_render_pass);
+  m_in_render_pass = false;
+  record(Call::EndRenderPass);
+}
+
+void CommandList::transition(BufferHandle handle, ResourceState state) {
+  auto buffer = to_buffer(handle);
+  // Only the prepare() list tracks states; the others record on resources already in place
+  if (!REI_NULL_CHECK(buffer && m_is_main)) return;
+  REI_NULL_CHECK(!m_in_render_pass);
+  m_owner->m_states.transition(*buffer, state);
+  record(Call::Transition);
+}
+
+void CommandList::barrier(BufferHandle handle) {
+  auto buffer = to_buffer(handle);
+  if (!REI_NULL_CHECK(buffer && m_is_main)) return;
+  m_owner->m_states.uav_barrier(*buffer);
+  record(Call::Barrier);
+}
+
+void CommandList::begin_transition(BufferHandle handle, ResourceState state) {
+  auto buffer = to_buffer(handle);
+  if (!REI_NULL_CHECK(buffer && m_is_main)) return;
+  m_owner->m_states.begin_split(*buffer, state);
+  record(Call::BeginTransition);
+}
+
+void CommandList::flush_barriers() {
+  // Barriers are only counted; the tracker keeps the states the checks below read
+  if (m_is_main) m_owner->m_states.flush([](const auto* /*barriers*/, size_t /*count*/) {});
+}
+
+void CommandList::check_arguments(const ShaderArguments& arguments, ResourceState read_state) {
+  for (const ShaderArgumentHandle& handle : arguments) {
+    if (handle == c_empty_handle) continue;
+    auto arg = to_argument(handle);
+    if (!REI_NULL_CHECK(arg) || read_state == ResourceState::Undefined) continue;
+    // Textures must be transitioned for how the argument binds them before they are used
+    for (const auto& uav : arg->unordered_accesses)
+      REI_NULL_CHECK(is_ready(*uav, ResourceState::UnorderedAccess));
+    for (const auto& srv : arg->shader_resources) {
+      const auto& uavs = arg->unordered_accesses;
+      if (std::find(uavs.begin(), uavs.end(), srv) != uavs.end()) continue; // bound as both
+      REI_NULL_CHECK(is_ready(*srv, read_state));
+    }
+  }
+}
+
+void CommandList::draw(const DrawCommand& cmd) {
+  REI_NULL_CHECK(m_in_render_pass);
+  auto shader = to_shader(cmd.shader);
+  REI_NULL_CHECK(shader && shader->kind == ShaderData::Kind::Rasterization);
+  REI_NULL_CHECK(bool(cmd.vertex_buffer) == bool(cmd.index_buffer));
+  if (cmd.instance_buffer) {
+    auto instances = to_buffer(cmd.instance_buffer);
+    REI_NULL_CHECK(shader->is_instanced && instances);
+    REI_NULL_CHECK(instances->kind == BufferKind::InstanceBuffer);
+    REI_NULL_CHECK(cmd.instance_offset + cmd.instance_count <= instances->element_count);
+  }
+  flush_barriers();
+  check_arguments(cmd.arguments, ResourceState::PixelShaderResource);
+  record(Call::Draw);
+  m_stats.drawn_instances += cmd.instance_count;
+}
+
+void CommandList::dispatch(const DispatchCommand& cmd) {
+  REI_NULL_CHECK(!m_in_render_pass);
+  auto shader = to_shader(cmd.compute_shader);
+  REI_NULL_CHECK(shader && shader->kind == ShaderData::Kind::Compute);
+  REI_NULL_CHECK(cmd.dispatch_x > 0 && cmd.dispatch_y > 0 && cmd.dispatch_z > 0);
+  flush_barriers();
+  check_arguments(cmd.arguments, ResourceState::ComputeShaderResource);
+  record(Call::Dispatch);
+}
+
+void CommandList::raytrace(const RaytraceCommand& cmd) {
+  REI_NULL_CHECK(!m_in_render_pass);
+  auto shader = to_shader(cmd.raytrace_shader);
+  REI_NULL_CHECK(shader && shader->kind == ShaderData::Kind::Raytracing);
+  auto table = to_buffer(cmd.shader_table);
+  REI_NULL_CHECK(table && table->kind == BufferKind::ShaderTable);
+  flush_barriers();
+  check_arguments(cmd.arguments, ResourceState::ComputeShaderResource);
+  record(Call::Raytrace);
+}
+
+void CommandList::clear_texture(
+  BufferHandle target, Vec4 /*clear_value*/, RenderArea /*clear_area*/) {
+  auto buffer = to_buffer(target);
+  REI_NULL_CHECK(buffer && buffer->kind == BufferKind::Texture && m_is_main);
+  flush_barriers();
+  REI_NULL_CHECK(is_ready(*buffer, ResourceState::UnorderedAccess));
+  record(Call::ClearTexture);
+}
+
+void CommandList::copy_texture(BufferHandle src, BufferHandle dest, bool /*revert_state*/) {
+  auto src_buffer = to_buffer(src);
+  auto dest_buffer = to_buffer(dest);
+  REI_NULL_CHECK(src_buffer && dest_buffer && src_buffer != dest_buffer && m_is_main);
+  flush_barriers();
+  record(Call::CopyTexture);
+}
+
+rei::CommandList* Renderer::prepare() {
+  m_commands.clear();
+  return m_main_list.get();
+}
+
+rei::CommandList* Renderer::open_command_list() {
+  if (m_open_list_count == m_lists.size())
+    m_lists.push_back(std::make_unique<CommandList>(this, false));
+  CommandList* list = m_lists[m_open_list_count++].get();
+  list->m_local_stats = {};
+  list->m_local_commands.clear();
+  list->m_open = true;
+  list->m_in_render_pass = false;
+  return list;
+}
+
+void Renderer::submit(rei::CommandList* const* lists, size_t count) {
+  REI_NULL_CHECK(!m_main_list->m_in_render_pass);
+  record(Call::Submit);
+  // What the prepare() list recorded so far runs first, its transitions included
+  m_main_list->flush_barriers();
+  for (size_t i = 0; i < count; i++) {
+    auto list = dynamic_cast<CommandList*>(lists[i]);
+    if (!REI_NULL_CHECK(list && list->m_owner == this && list->m_open)) continue;
+    REI_NULL_CHECK(!list->m_in_render_pass);
+    const Stats& stats = list->m_local_stats;
+    for (size_t c = 0; c < size_t(Call::Count); c++)
+      m_stats.calls[c] += stats.calls[c];
+    m_stats.drawn_instances += stats.drawn_instances;
+    m_stats.failed_checks += stats.failed_checks;
+    m_commands.insert(
+      m_commands.end(), list->m_local_commands.begin(), list->m_local_commands.end());
+    m_stats.submitted_lists++;
+    list->m_open = false;
+  }
+}
+
+void Renderer::present(SwapchainHandle handle, bool /*vsync*/) {
+  REI_NULL_CHECK(!m_main_list->m_in_render_pass);
+  auto swapchain = to_swapchain(handle);
+  REI_NULL_CHECK(swapchain);
+  m_main_list->flush_barriers();
+  auto target = to_buffer(swapchain->render_targets[swapchain->current]);
+  REI_NULL_CHECK(is_ready(*target, ResourceState::Present));
+  swapchain->current = (swapchain->current + 1) % swapchain->render_targets.size();
+  // Lists opened this frame are recycled; each must have been submitted
+  for (size_t i = 0; i < m_open_list_count; i++)
+    REI_NULL_CHECK(!m_lists[i]->m_open);
+  m_open_list_count = 0;
+  record(Call::Present);
+  m_stats.presented_frames++;
+}
+
+} // namespace null
+
+} // namespace rei
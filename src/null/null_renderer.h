@@ -0,0 +1,183 @@
+#ifndef REI_NULL_NULL_RENDERER_H
+#define REI_NULL_NULL_RENDERER_H
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "../renderer.h"
+#include "../resource_state_tracker.h"
+
+/*
+ * null/null_renderer.h
+ * A renderer without a device, for running pipelines headless.
+ */
+
+namespace rei {
+
+namespace null {
+
+enum class BufferKind : std::uint8_t {
+  Texture,
+  ConstBuffer,
+  InstanceBuffer,
+  StructuredBuffer,
+  VertexBuffer,
+  IndexBuffer,
+  AccelStruct,
+  ShaderTable,
+};
+
+class CommandList;
+struct BufferData;
+struct ShaderData;
+struct ShaderArgumentData;
+struct SwapchainData;
+
+/*
+ * Checks every call the way a device backend relies on (handle ownership, element bounds,
+ * shader kinds, render pass nesting, texture states) and counts it, but touches no GPU.
+ * Pipelines run their full CPU side against it, so scene registration and command recording
+ * can be measured anywhere. Transitions are batched like a device backend does, and the
+ * barriers it would issue are counted. Lists from open_command_list() count into their own
+ * stats, merged in submission order, so recording on several threads gives the same totals.
+ */
+class Renderer : public rei::Renderer {
+  using Base = rei::Renderer;
+
+public:
+  enum class Call : std::uint8_t {
+    CreateSwapchain,
+    CreateTexture,
+    CreateBuffer,
+    UpdateBuffer,
+    CreateShader,
+    CreateArgument,
+    CreateGeometry,
+    CreateAccelStruct,
+    CreateShaderTable,
+    UpdateShaderTable,
+    BeginRenderPass,
+    EndRenderPass,
+    Transition,
+    Barrier,
+    BeginTransition,
+    Draw,
+    Dispatch,
+    Raytrace,
+    ClearTexture,
+    CopyTexture,
+    Submit,
+    Present,
+    Count,
+  };
+
+  struct Stats {
+    size_t calls[size_t(Call::Count)] = {};
+    size_t uploaded_bytes = 0;  // through update_const_buffer and update_buffer_elements
+    size_t texture_bytes = 0;   // of all textures created
+    size_t drawn_instances = 0;
+    size_t presented_frames = 0;
+    size_t submitted_lists = 0; // through submit()
+    size_t failed_checks = 0;   // calls a device backend would have rejected
+
+    size_t operator[](Call call) const { return calls[size_t(call)]; }
+  };
+
+  using BarrierStats = ResourceStateTracker<BufferData, ResourceState>::Stats;
+
+  struct Options {
+    // Keep the sequence of commands recorded since the last prepare()
+    bool record_commands = false;
+  };
+
+  Renderer();
+  Renderer(Options options);
+  ~Renderer() override;
+
+  SwapchainHandle create_swapchain(SystemWindowID window_id, size_t width, size_t height,
+    size_t rendertarget_count) override;
+  BufferHandle fetch_swapchain_render_target_buffer(SwapchainHandle swapchain) override;
+
+  using Base::create_texture_2d;
+  BufferHandle create_texture_2d(
+    const TextureDesc& desc, ResourceState init_state, Name debug_name) override;
+
+  BufferHandle create_const_buffer(const ConstBufferLayout& layout, size_t num,
+    Name debug_name = L"Unnamed ConstBuffer") override;
+  BufferHandle create_instance_buffer(const ConstBufferLayout& layout, size_t num,
+    Name debug_name = L"Unnamed InstanceBuffer") override;
+  BufferHandle create_structured_buffer(const ConstBufferLayout& layout, size_t num,
+    Name debug_name = L"Unnamed StructuredBuffer") override;
+
+  void update_const_buffer(BufferHandle buffer, size_t index, size_t member, Vec4 value) override;
+  void update_const_buffer(BufferHandle buffer, size_t index, size_t member, Mat4 value) override;
+  void update_const_buffer(
+    BufferHandle buffer, size_t index, const void* data, size_t bytes) override;
+  void update_buffer_elements(
+    BufferHandle buffer, size_t first, const void* data, size_t count) override;
+
+  using Base::create_shader;
+  ShaderHandle create_shader(const std::wstring& shader_path, RasterizationShaderMetaInfo&& meta,
+    const ShaderCompileConfig& config = {}) override;
+  ShaderHandle create_shader(const std::wstring& shader_path, ComputeShaderMetaInfo&& meta,
+    const ShaderCompileConfig& config = {}) override;
+  ShaderHandle create_shader(const std::wstring& shader_path, RaytracingShaderMetaInfo&& meta,
+    const ShaderCompileConfig& config = {}) override;
+
+  ShaderArgumentHandle create_shader_argument(ShaderArgumentValue arg_value) override;
+
+  GeometryBuffers create_geometry(const GeometryDesc& geometry) override;
+  BufferHandle create_raytracing_accel_struct(const RaytraceSceneDesc& scene) override;
+  BufferHandle create_shader_table(
+    size_t intersection_count, ShaderHandle raytracing_shader) override;
+  BufferHandle create_shader_table(const Scene& scene, ShaderHandle raytracing_shader) override;
+  void update_shader_table(const UpdateShaderTable& cmd) override;
+
+  rei::CommandList* prepare() override;
+  rei::CommandList* open_command_list() override;
+  void submit(rei::CommandList* const* lists, size_t count) override;
+  void present(SwapchainHandle swapchain, bool vsync) override;
+
+  bool is_depth_range_01() const override { return true; }
+
+  const Stats& stats() const { return m_stats; }
+  const BarrierStats& barrier_stats() const { return m_states.stats(); }
+  void reset_stats() {
+    m_stats = {};
+    m_states.reset_stats();
+  }
+  // Empty unless Options::record_commands; submitted lists are merged in
+  const std::vector<Call>& commands() const { return m_commands; }
+
+private:
+  friend class CommandList;
+
+  Options m_options;
+  Stats m_stats;
+  ResourceStateTracker<BufferData, ResourceState> m_states;
+  std::vector<Call> m_commands;
+  std::unique_ptr<CommandList> m_main_list;
+  // Lists from open_command_list(), the first `m_open_list_count` in use this frame
+  std::vector<std::unique_ptr<CommandList>> m_lists;
+  size_t m_open_list_count = 0;
+
+  void record(Call call) {
+    m_stats.calls[size_t(call)]++;
+    if (m_options.record_commands) m_commands.push_back(call);
+  }
+
+  // Handle conversion; null for handles of another renderer
+  std::shared_ptr<BufferData> to_buffer(BufferHandle h);
+  std::shared_ptr<ShaderData> to_shader(ShaderHandle h);
+  std::shared_ptr<ShaderArgumentData> to_argument(ShaderArgumentHandle h);
+  std::shared_ptr<SwapchainData> to_swapchain(SwapchainHandle h);
+
+  BufferHandle create_element_buffer(const ConstBufferLayout& layout, size_t num, BufferKind kind);
+};
+
+} // namespace null
+
+} // namespace rei
+
+#endif
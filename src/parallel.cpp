@@ -0,0 +1,91 @@
+// source of parallel.h
+#include "parallel.h"
+
+namespace rei {
+
+ThreadPool::ThreadPool(size_t worker_num) {
+  if (worker_num == 0) {
+    size_t hw = std::thread::hardware_concurrency();
+    worker_num = hw > 1 ? hw - 1 : 1;
+  }
+  m_workers.reserve(worker_num);
+  for (size_t i = 0; i < worker_num; i++) {
+    m_workers.emplace_back([this] { worker_loop(); });
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stopping = true;
+  }
+  m_cond.notify_all();
+  for (auto& t : m_workers)
+    t.join();
+}
+
+void ThreadPool::enqueue(Job&& job) {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_jobs.emplace_back(std::move(job));
+  }
+  m_cond.notify_one();
+}
+
+void ThreadPool::worker_loop() {
+  while (true) {
+    Job job;
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_cond.wait(lock, [this] { return m_stopping || !m_jobs.empty(); });
+      if (m_jobs.empty()) return; // stopping
+      job = std::move(m_jobs.front());
+      m_jobs.pop_front();
+    }
+    job();
+  }
+}
+
+void ThreadPool::run_chunks(size_t chunk_num, const std::function<void(size_t)>& task) {
+  if (chunk_num == 0) return;
+
+  // Shared by all helpers; a helper may start after the call has returned, so it is ref-counted
+  struct State {
+    std::atomic<size_t> next {0};
+    std::atomic<size_t> done {0};
+    size_t total = 0;
+    const std::function<void(size_t)>* task = nullptr;
+    std::mutex mutex;
+    std::condition_variable finished;
+  };
+  auto state = std::make_shared<State>();
+  state->total = chunk_num;
+  state->task = &task;
+
+  auto drain = [](State& s) {
+    size_t chunk;
+    while ((chunk = s.next.fetch_add(1)) < s.total) {
+      (*s.task)(chunk);
+      if (s.done.fetch_add(1) + 1 == s.total) {
+        std::lock_guard<std::mutex> lock(s.mutex);
+        s.finished.notify_all();
+      }
+    }
+  };
+
+  size_t helper_num = (std::min)(m_workers.size(), chunk_num - 1);
+  for (size_t i = 0; i < helper_num; i++) {
+    enqueue([state, drain] { drain(*state); });
+  }
+  drain(*state);
+
+  std::unique_lock<std::mutex> lock(state->mutex);
+  state->finished.wait(lock, [&] { return state->done.load() == state->total; });
+}
+
+ThreadPool& global_thread_pool() {
+  static ThreadPool pool;
+  return pool;
+}
+
+} // namespace rei
@@ -0,0 +1,95 @@
+#ifndef REI_PARALLEL_H
+#define REI_PARALLEL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "type_utils.h"
+
+/*
+ * parallel.h
+ * A minimal persistent thread pool, and parallel-for helpers built on it.
+ */
+
+namespace rei {
+
+class ThreadPool : NoCopy {
+public:
+  using Job = std::function<void()>;
+
+  // `worker_num` == 0 means (hardware concurrency - 1); the calling thread always helps
+  explicit ThreadPool(size_t worker_num = 0);
+  ~ThreadPool();
+
+  // Number of threads that may execute a parallel task, including the caller
+  size_t concurrency() const { return m_workers.size() + 1; }
+
+  // Push a job to the queue; no completion tracking
+  void enqueue(Job&& job);
+
+  // Run task(chunk_index) for every chunk in [0, chunk_num); block until all are done.
+  // The caller participates, so nested invocation from a worker does not deadlock.
+  void run_chunks(size_t chunk_num, const std::function<void(size_t)>& task);
+
+private:
+  std::vector<std::thread> m_workers;
+  std::deque<Job> m_jobs;
+  std::mutex m_mutex;
+  std::condition_variable m_cond;
+  bool m_stopping = false;
+
+  void worker_loop();
+};
+
+// Process-wide pool, created on first use
+ThreadPool& global_thread_pool();
+
+// Call f(begin, end) on sub-ranges of [begin, end) in parallel on `pool`; each sub-range has at
+// least `grain` elements (except the last one)
+template <typename F>
+void parallel_for_range(ThreadPool& pool, size_t begin, size_t end, size_t grain, F&& f) {
+  if (end <= begin) return;
+  const size_t count = end - begin;
+  grain = (std::max<size_t>)(grain, 1);
+  // a few chunks per thread for some load-balancing
+  size_t chunk_size = (std::max)(grain, count / (pool.concurrency() * 4) + 1);
+  size_t chunk_num = (count + chunk_size - 1) / chunk_size;
+  if (chunk_num <= 1) {
+    f(begin, end);
+    return;
+  }
+  pool.run_chunks(chunk_num, [&](size_t chunk) {
+    size_t b = begin + chunk * chunk_size;
+    size_t e = (std::min)(end, b + chunk_size);
+    f(b, e);
+  });
+}
+
+template <typename F>
+void parallel_for_range(size_t begin, size_t end, size_t grain, F&& f) {
+  parallel_for_range(global_thread_pool(), begin, end, grain, std::forward<F>(f));
+}
+
+// Call f(i) for every i in [begin, end) in parallel
+template <typename F>
+void parallel_for(ThreadPool& pool, size_t begin, size_t end, size_t grain, F&& f) {
+  parallel_for_range(pool, begin, end, grain, [&](size_t b, size_t e) {
+    for (size_t i = b; i < e; i++)
+      f(i);
+  });
+}
+template <typename F>
+void parallel_for(size_t begin, size_t end, size_t grain, F&& f) {
+  parallel_for(global_thread_pool(), begin, end, grain, std::forward<F>(f));
+}
+
+} // namespace rei
+
+#endif
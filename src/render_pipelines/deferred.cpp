@@ -4,12 +4,17 @@
 #include <unordered_map>
 
 #include "../container_utils.h"
-#include "../direct3d/d3d_renderer.h"
+#include "instancing.h"
+#include "parallel_recording.h"
+#include "scene_residency.h"
 
 namespace rei {
 
 namespace deferred {
 
+// Fewer draws than this are not worth a command list of their own
+constexpr size_t c_gpass_draws_per_list = 128;
+
 struct ViewportData {
   size_t width = 1;
   size_t height = 1;
@@ -17,9 +22,8 @@ struct ViewportData {
   BufferHandle depth_stencil_buffer;
   BufferHandle normal_buffer;
   BufferHandle albedo_buffer;
+  ShaderArgumentHandle gpass_per_render_arg;
   ShaderArgumentHandle shading_pass_per_render_arg;
-  // Max 8 light pass
-  FixedVec<ShaderArgumentHandle, DeferredPipeline::max_light_count> shading_pass_per_light_args;
 
   Mat4 view_proj = Mat4::I();
   Mat4 view_proj_inv = Mat4::I();
@@ -27,17 +31,49 @@ struct ViewportData {
 };
 
 struct SceneData {
-  // holding for default material
-  BufferHandle objects_cb;
+  // World and normal transforms of all models, batch by batch
+  BufferHandle instances_buffer;
+  size_t instances_capacity = 0;
   struct ModelData {
-    GeometryBuffers geometry;
-    // TODO should use an offset in cb instead, rather than a brand-new descriptor
-    ShaderArgumentHandle arg;
-    size_t cb_index;
+    size_t instance_index;
     Mat4 trans;
+    Scene::GeometryUID geometry;
+    Scene::MaterialUID material;
+    bool dirty;
+  };
+  struct GeometryData {
+    GeometryBuffers buffers;
+    std::weak_ptr<Geometry> geometry; // tells a new geometry at a freed one's address
+  };
+  struct BatchData {
+    Scene::GeometryUID geometry_id;
+    GeometryBuffers geometry;
+    std::uint32_t first_instance;
+    std::uint32_t instance_count;
   };
-  Hashmap<Scene::GeometryUID, GeometryBuffers> geometries;
+  Hashmap<Scene::GeometryUID, GeometryData> geometries;
   Hashmap<Scene::ModelUID, ModelData> m_models;
+  std::vector<BatchData> batches;
+  // Models were added, removed or moved to another batch; instances are laid out again on sync
+  bool layout_dirty = false;
+
+  // Scene changes are pulled by version; only dirty instances are uploaded
+  Scene::Version synced_version = 0;
+  Geometry::Version geometries_synced = 0;
+  std::vector<Scene::ModelUID> dirty_models;
+
+  void mark_dirty(Scene::ModelUID id, ModelData& model) {
+    if (model.dirty) return;
+    model.dirty = true;
+    dirty_models.push_back(id);
+  }
+
+  // Scene lights, packed in one structured buffer and shaded in one screen pass
+  LightMirror lights;
+  BufferHandle lights_buffer;
+  size_t lights_capacity = 0;
+  BufferHandle lights_cb; // light count
+  ShaderArgumentHandle lights_arg;
 };
 
 } // namespace deferred
@@ -48,22 +84,22 @@ using SceneProxy = deferred::SceneData;
 struct DeferredBaseMeta : RasterizationShaderMetaInfo {
   DeferredBaseMeta() {
     ShaderParameter space0 {};
-    space0.const_buffers = {ConstantBuffer()};
-    ShaderParameter space1 {};
-    space1.const_buffers = {ConstantBuffer()};
+    space0.const_buffers = {ConstantBuffer()}; // per-render CB
 
     RenderTargetDesc rt_normal {ResourceFormat::R32G32B32A32_FLOAT};
     RenderTargetDesc rt_albedo {ResourceFormat::B8G8R8A8_UNORM};
     render_target_descs = {rt_normal, rt_albedo};
 
-    signature.param_table = {space0, space1};
+    signature.param_table = {space0};
+    is_instanced = true;
   }
 };
 
 struct DeferredShadingMeta : RasterizationShaderMetaInfo {
   DeferredShadingMeta() {
     ShaderParameter space0 {};
-    space0.const_buffers = {ConstantBuffer()};
+    space0.const_buffers = {ConstantBuffer()};     // light count
+    space0.shader_resources = {ShaderResource()}; // scene lights
     ShaderParameter space1 {};
     space1.const_buffers = {ConstantBuffer()};
     space1.shader_resources = {ShaderResource(), ShaderResource(), ShaderResource()};
@@ -74,19 +110,33 @@ struct DeferredShadingMeta : RasterizationShaderMetaInfo {
     render_target_descs = {rt_color};
 
     is_depth_stencil_disabled = true;
-    is_blending_addictive = true;
   }
 };
 
+static ConstBufferLayout instance_layout() {
+  return {
+    ShaderDataType::Float4x4, // World
+    ShaderDataType::Float4x4, // Normal; see Mat4::normal_matrix
+  };
+}
+
+// Mirrors PackedLight
+static ConstBufferLayout packed_light_layout() {
+  return {
+    ShaderDataType::Float4, // position, range
+    ShaderDataType::Float4, // direction, type
+    ShaderDataType::Float4, // radiance, flags
+    ShaderDataType::Float4, // shape
+  };
+}
+
 DeferredPipeline::DeferredPipeline(RendererPtr renderer) : SimplexPipeline(renderer) {
   Renderer* r = get_renderer();
 
   m_default_shader
     = r->create_shader(L"CoreData/shader/deferred_base.hlsl", std::make_unique<DeferredBaseMeta>());
-  m_lighting_shader_base = r->create_shader(L"CoreData/shader/deferred_shading.hlsl",
+  m_lighting_shader = r->create_shader(L"CoreData/shader/deferred_shading.hlsl",
     std::make_unique<DeferredShadingMeta>(), ShaderCompileConfig::defines<1>({{"BASE_SHADING", "1"},}));
-  m_lighting_shader_add = r->create_shader(
-    L"CoreData/shader/deferred_shading.hlsl", std::make_unique<DeferredShadingMeta>());
 
   {
     ConstBufferLayout lo = {
@@ -97,14 +147,6 @@ DeferredPipeline::DeferredPipeline(RendererPtr renderer) : SimplexPipeline(rende
     };
     m_per_render_buffer = r->create_const_buffer(lo, 1, L"ShadingPass PerRender CB");
   }
-
-  {
-    ConstBufferLayout lo = {
-      ShaderDataType::Float4, // light pos/dir
-      ShaderDataType::Float4, // light color
-    };
-    m_per_light_buffer = r->create_const_buffer(lo, max_light_count, L"ShadingPass PerLight CB");
-  }
 }
 
 DeferredPipeline::ViewportHandle DeferredPipeline::register_viewport(ViewportConfig conf) {
@@ -125,17 +167,10 @@ DeferredPipeline::ViewportHandle DeferredPipeline::register_viewport(ViewportCon
     ShaderArgumentValue v {};
     v.const_buffers = {m_per_render_buffer};
     v.const_buffer_offsets = {0}; // assume only one viewport
+    proxy.gpass_per_render_arg = r->create_shader_argument(v);
     v.shader_resources = {proxy.depth_stencil_buffer, proxy.normal_buffer, proxy.albedo_buffer};
     proxy.shading_pass_per_render_arg = r->create_shader_argument(v);
   }
-  {
-    ShaderArgumentValue v {};
-    v.const_buffers = {m_per_light_buffer};
-    for (size_t i = 0; i < proxy.shading_pass_per_light_args.max_size; i++) {
-      v.const_buffer_offsets = {i}; // assume only one viewport using the buffer at the same time
-      proxy.shading_pass_per_light_args.push_back(r->create_shader_argument(v));
-    }
-  }
 
   return add_viewport(std::move(proxy));
 }
@@ -155,41 +190,31 @@ DeferredPipeline::SceneHandle DeferredPipeline::register_scene(SceneConfig conf)
   const Scene* scene = conf.scene;
   Renderer* r = get_renderer();
 
-  const int model_count = scene->get_models().size();
-
   SceneProxy proxy = {};
+  proxy.geometries_synced = Geometry::latest_version();
+  layout_instances(proxy, *scene);
+  proxy.synced_version = scene->version();
   {
-    ConstBufferLayout cb_lo = {
-      ShaderDataType::Float4x4, // WVP
-      ShaderDataType::Float4x4, // World
+    ConstBufferLayout lo = {
+      ShaderDataType::Float4, // light count
     };
-    proxy.objects_cb = r->create_const_buffer(cb_lo, model_count, L"Scene-Objects CB");
-  }
-  {
-    for (auto& g : scene->geometries()) {
-      auto geo = r->create_geometry({g});
-      proxy.geometries.insert({scene->get_id(g), geo});
-    }
-  }
-  {
-    proxy.m_models.reserve(model_count);
-    ShaderArgumentValue arg_value = {};
-    { // init
-      arg_value.const_buffers = {proxy.objects_cb};
-      arg_value.const_buffer_offsets = {0};
-    }
-    for (size_t i = 0; i < model_count; i++) {
-      auto model = scene->get_models()[i];
-      auto* geo = proxy.geometries.try_get(scene->get_id(model->get_geometry()));
-      arg_value.const_buffer_offsets[0] = i;
-      ShaderArgumentHandle arg = r->create_shader_argument(arg_value);
-      proxy.m_models.insert({
-        scene->get_id(model), {*geo, arg, i, model->get_transform()} // value
-      });
-    }
+    proxy.lights_cb = r->create_const_buffer(lo, 1, L"ShadingPass Lights CB");
   }
 
-  return add_scene(std::move(proxy));
+  SceneHandle handle = add_scene(std::move(proxy));
+  sync_lights(*get_scene(handle), scene->lights());
+  return handle;
+}
+
+void DeferredPipeline::add_model(
+  SceneHandle scene_handle, const Model& model, Scene::ModelUID model_id) {
+  SceneProxy* scene = get_scene(scene_handle);
+  REI_ASSERT(scene);
+  if (scene->m_models.has(model_id)) {
+    update_model(scene_handle, model, model_id);
+    return;
+  }
+  scene->layout_dirty = true;
 }
 
 void DeferredPipeline::update_model(
@@ -197,7 +222,118 @@ void DeferredPipeline::update_model(
   SceneProxy* scene = get_scene(scene_handle);
   REI_ASSERT(scene);
   auto* data = scene->m_models.try_get(model_id);
+  if (!data) return; // not registered
+  if (data->geometry != Scene::GeometryUID(model.get_geometry().get())
+      || data->material != Scene::MaterialUID(model.get_material().get()))
+    scene->layout_dirty = true; // moves to another batch
   data->trans = model.get_transform();
+  scene->mark_dirty(model_id, *data);
+}
+
+void DeferredPipeline::remove_model(SceneHandle scene_handle, Scene::ModelUID model_id) {
+  SceneProxy* scene = get_scene(scene_handle);
+  REI_ASSERT(scene);
+  if (scene->m_models.erase(model_id)) scene->layout_dirty = true;
+}
+
+void DeferredPipeline::sync_scene(SceneHandle scene_handle, const Scene& scene) {
+  SceneProxy* proxy = get_scene(scene_handle);
+  REI_ASSERT(proxy);
+  if (scene.tracks_changes_since(proxy->synced_version)) {
+    scene.model_removals_since(
+      proxy->synced_version, [&](ModelHandle) { proxy->layout_dirty = true; });
+    scene.model_changes_since(proxy->synced_version, [&](ModelHandle handle) {
+      ModelPtr model = scene.get_model(handle);
+      add_model(scene_handle, *model, scene.get_id(model));
+    });
+  } else {
+    proxy->layout_dirty = true;
+  }
+  proxy->synced_version = scene.version();
+
+  // Geometry versions come from one growing counter, so the edited ones are those stamped after
+  // the last sync; they are uploaded again for every batch drawing them
+  if (Geometry::latest_version() != proxy->geometries_synced) {
+    Renderer* r = get_renderer();
+    for (const GeometryPtr& g : scene.geometries()) {
+      if (g->version() <= proxy->geometries_synced) continue;
+      const Scene::GeometryUID id = scene.get_id(g);
+      auto* geo = proxy->geometries.try_get(id);
+      if (!geo || geo->geometry.lock() != g) continue; // not registered
+      geo->buffers = r->create_geometry({g});
+      for (SceneProxy::BatchData& batch : proxy->batches)
+        if (batch.geometry_id == id) batch.geometry = geo->buffers;
+    }
+    proxy->geometries_synced = Geometry::latest_version();
+  }
+
+  if (proxy->layout_dirty) layout_instances(*proxy, scene);
+  sync_lights(*proxy, scene.lights());
+}
+
+// Deferred keeps no batcher of its own: any added, removed or re-batched model lays every instance
+// out again, uploading only the geometries not registered yet
+void DeferredPipeline::layout_instances(SceneProxy& proxy, const Scene& scene) {
+  Renderer* r = get_renderer();
+
+  Hashmap<Scene::GeometryUID, SceneProxy::GeometryData> geometries;
+  for (const GeometryPtr& g : scene.geometries()) {
+    const Scene::GeometryUID id = scene.get_id(g);
+    const SceneProxy::GeometryData* old = proxy.geometries.try_get(id);
+    if (old && old->geometry.lock() == g)
+      geometries.insert({id, *old});
+    else
+      geometries.insert({id, {r->create_geometry({g}), g}});
+  }
+  proxy.geometries = std::move(geometries);
+
+  // The base pass ignores materials, so this may split a geometry into more draws than needed
+  InstanceBatchList list = build_instance_batches(scene);
+  proxy.batches.clear();
+  proxy.batches.reserve(list.batches.size());
+  for (const InstanceBatch& batch : list.batches) {
+    auto* geo = proxy.geometries.try_get(batch.geometry);
+    if (!geo) continue; // models without geometry draw nothing
+    proxy.batches.push_back(
+      {batch.geometry, geo->buffers, batch.first_instance, batch.instance_count});
+  }
+  if (!proxy.instances_buffer || list.instance_count() > proxy.instances_capacity) {
+    proxy.instances_capacity = grown_capacity(proxy.instances_capacity, list.instance_count());
+    proxy.instances_buffer = r->create_instance_buffer(
+      instance_layout(), proxy.instances_capacity, L"Scene-Instances Buffer");
+  }
+
+  proxy.m_models.clear();
+  proxy.m_models.reserve(list.instance_count());
+  for (const ModelPtr& model : scene.get_models()) {
+    proxy.m_models.insert({scene.get_id(model), {0, model->get_transform(),
+      scene.get_id(model->get_geometry()), scene.get_id(model->get_material()), false}});
+  }
+  proxy.dirty_models.clear();
+  proxy.dirty_models.reserve(list.instance_count());
+  for (size_t i = 0; i < list.models.size(); i++) {
+    auto* data = proxy.m_models.try_get(list.models[i]);
+    data->instance_index = i;
+    proxy.mark_dirty(list.models[i], *data);
+  }
+  proxy.layout_dirty = false;
+}
+
+void DeferredPipeline::sync_lights(SceneProxy& scene, const LightStore& lights) {
+  if (!scene.lights.sync(lights)) return;
+  if (scene.lights_arg && scene.lights.size() <= scene.lights_capacity) return;
+
+  // Every light is uploaded again into the larger buffer
+  Renderer* r = get_renderer();
+  scene.lights_capacity = grown_capacity(scene.lights_capacity, scene.lights.size());
+  scene.lights_buffer = r->create_structured_buffer(
+    packed_light_layout(), scene.lights_capacity, L"Scene Lights Buffer");
+  scene.lights.mark_all_dirty();
+  ShaderArgumentValue v {};
+  v.const_buffers = {scene.lights_cb};
+  v.const_buffer_offsets = {0};
+  v.shader_resources = {scene.lights_buffer};
+  scene.lights_arg = r->create_shader_argument(v);
 }
 
 void DeferredPipeline::render(ViewportHandle viewport_h, SceneHandle scene_h) {
@@ -207,27 +343,41 @@ void DeferredPipeline::render(ViewportHandle viewport_h, SceneHandle scene_h) {
   REI_ASSERT(scene);
 
   Renderer* const renderer = get_renderer();
-  const auto cmd_list = renderer->prepare();
+  CommandList* const cmd_list = renderer->prepare();
 
   // Update scene-wide const buffer (per-frame CB)
   {
-    cmd_list->update_const_buffer(
+    renderer->update_const_buffer(
       m_per_render_buffer, 0, 0, Vec4(viewport->width, viewport->height, 0, 0));
-    cmd_list->update_const_buffer(m_per_render_buffer, 0, 1, viewport->view_proj);
-    cmd_list->update_const_buffer(m_per_render_buffer, 0, 2, viewport->view_proj_inv);
-    cmd_list->update_const_buffer(m_per_render_buffer, 0, 3, viewport->cam_pos);
+    renderer->update_const_buffer(m_per_render_buffer, 0, 1, viewport->view_proj);
+    renderer->update_const_buffer(m_per_render_buffer, 0, 2, viewport->view_proj_inv);
+    renderer->update_const_buffer(m_per_render_buffer, 0, 3, viewport->cam_pos);
+  }
+
+  // Update per-instance transforms
+  {
+    for (Scene::ModelUID id : scene->dirty_models) {
+      auto* model = scene->m_models.try_get(id);
+      if (!model) continue;
+      const size_t index = model->instance_index;
+      renderer->update_const_buffer(scene->instances_buffer, index, 0, model->trans);
+      renderer->update_const_buffer(
+        scene->instances_buffer, index, 1, model->trans.normal_matrix());
+      model->dirty = false;
+    }
+    scene->dirty_models.clear();
   }
 
-  // Update per-object const buffer
+  // Upload the lights changed since the last frame, in one copy
   {
-    for (auto& pair : scene->m_models) {
-      auto& model = pair.second;
-      size_t index = model.cb_index;
-      Mat4& m = model.trans;
-      Mat4 mvp = viewport->view_proj * m;
-      renderer->update_const_buffer(scene->objects_cb, index, 0, mvp);
-      renderer->update_const_buffer(scene->objects_cb, index, 1, m);
+    if (scene->lights.dirty()) {
+      const size_t first = scene->lights.dirty_first();
+      renderer->update_buffer_elements(scene->lights_buffer, first, scene->lights.data() + first,
+        scene->lights.dirty_last() - first);
+      scene->lights.clear_dirty();
     }
+    renderer->update_const_buffer(
+      scene->lights_cb, 0, 0, Vec4(double(scene->lights.size()), 0, 0, 0));
   }
 
   // Geometry pass
@@ -243,20 +393,27 @@ void DeferredPipeline::render(ViewportHandle viewport_h, SceneHandle scene_h) {
     gpass.viewport = RenderViewaport::full(viewport->width, viewport->height);
     gpass.area = RenderArea::full(viewport->width, viewport->height);
   }
-  cmd_list->begin_render_pass(gpass);
-  {
-    DrawCommand draw_cmd = {};
-    draw_cmd.shader = m_default_shader;
-    for (auto pair : scene->m_models) {
-      auto& model = pair.second;
-      draw_cmd.index_buffer = model.geometry.index_buffer;
-      draw_cmd.vertex_buffer = model.geometry.vertex_buffer;
+  // One draw per batch of models sharing a geometry, recorded on several threads; each range
+  // resumes the pass the first one clears
+  record_in_parallel(renderer, cmd_list, scene->batches.size(), deferred::c_gpass_draws_per_list,
+    [&](CommandList* list, size_t begin, size_t end) {
+      RenderPassCommand range_pass = gpass;
+      range_pass.clear_rt = range_pass.clear_ds = begin == 0;
+      list->begin_render_pass(range_pass);
+      DrawCommand draw_cmd = {};
       draw_cmd.shader = m_default_shader;
-      draw_cmd.arguments = {model.arg};
-      cmd_list->draw(draw_cmd);
-    }
-  }
-  cmd_list->end_render_pass();
+      draw_cmd.arguments = {viewport->gpass_per_render_arg};
+      draw_cmd.instance_buffer = scene->instances_buffer;
+      for (size_t i = begin; i < end; i++) {
+        const auto& batch = scene->batches[i];
+        draw_cmd.index_buffer = batch.geometry.index_buffer;
+        draw_cmd.vertex_buffer = batch.geometry.vertex_buffer;
+        draw_cmd.instance_offset = batch.first_instance;
+        draw_cmd.instance_count = batch.instance_count;
+        list->draw(draw_cmd);
+      }
+      list->end_render_pass();
+    });
 
   // Shading pass
   BufferHandle render_target = renderer->fetch_swapchain_render_target_buffer(viewport->swapchain);
@@ -274,22 +431,17 @@ void DeferredPipeline::render(ViewportHandle viewport_h, SceneHandle scene_h) {
     shading_pass.area = RenderArea::full(viewport->width, viewport->height);
   }
   cmd_list->begin_render_pass(shading_pass);
-  std::vector<Vec4> light_pos = {{0.5, 0.6, 0.9, 0}, {0.5, 0.6, 0.8, 0}};
-  for (int light_i = 0; light_i < 2; light_i++) {
-    // Run a screen-pass for each light
-    cmd_list->update_const_buffer(m_per_light_buffer, light_i, 0, light_pos[light_i]);      // pos
-    cmd_list->update_const_buffer(m_per_light_buffer, light_i, 1, Vec4(0.7, 0.65, 0.6, 0)); // color
-
+  {
+    // One screen pass loops over all lights
     DrawCommand cmd = {};
-    cmd.shader = (light_i == 0) ? m_lighting_shader_base : m_lighting_shader_add;
-    cmd.arguments
-      = {viewport->shading_pass_per_light_args[light_i], viewport->shading_pass_per_render_arg};
+    cmd.shader = m_lighting_shader;
+    cmd.arguments = {scene->lights_arg, viewport->shading_pass_per_render_arg};
     cmd_list->draw(cmd);
   }
   cmd_list->end_render_pass();
 
   cmd_list->transition(render_target, ResourceState::Present);
-  cmd_list->present(viewport->swapchain, true);
+  renderer->present(viewport->swapchain, true);
 }
 
 } // namespace rei
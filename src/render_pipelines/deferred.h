@@ -5,11 +5,6 @@
 
 namespace rei {
 
-// FIXME lazyness
-namespace d3d {
-class Renderer;
-}
-
 // Forwared decl
 namespace deferred {
 struct ViewportData;
@@ -17,10 +12,7 @@ struct SceneData;
 } // namespace deferred
 
 class DeferredPipeline
-    : public SimplexPipeline<deferred::ViewportData, deferred::SceneData, d3d::Renderer> {
-  // FIXME lazyness
-  using Renderer = d3d::Renderer;
-
+    : public SimplexPipeline<deferred::ViewportData, deferred::SceneData> {
 public:
   DeferredPipeline(RendererPtr renderer);
 
@@ -31,23 +23,27 @@ public:
   virtual SceneHandle register_scene(SceneConfig conf) override;
   virtual void remove_scene(SceneHandle scene) override {}
 
+  // Added and removed models, or models moved to another geometry or material, are drawn as such
+  // after the next sync_scene, which lays out the instances again
+  virtual void add_model(SceneHandle scene, const Model& model, Scene::ModelUID model_id) override;
   virtual void update_model(
     SceneHandle scene, const Model& model, Scene::ModelUID model_id) override;
-  virtual void add_model(SceneHandle scene, const Model& model, Scene::ModelUID model_id) override {
-  }
+  virtual void remove_model(SceneHandle scene, Scene::ModelUID model_id) override;
+  virtual void sync_scene(SceneHandle scene_handle, const Scene& scene) override;
 
   virtual void render(ViewportHandle viewport, SceneHandle scene) override;
 
-  constexpr static size_t max_light_count = 8;
-
 private:
   // FIXME should be material handle
   ShaderHandle m_default_shader;
-  ShaderHandle m_lighting_shader_base;
-  ShaderHandle m_lighting_shader_add;
+  ShaderHandle m_lighting_shader;
 
-  BufferHandle m_per_light_buffer;
   BufferHandle m_per_render_buffer;
+
+  // Batches, instance slots and the instance buffer for all models of the scene
+  void layout_instances(deferred::SceneData& proxy, const Scene& scene);
+  // Re-pack changed lights, growing the light buffer as needed
+  void sync_lights(deferred::SceneData& scene, const LightStore& lights);
 };
 
 } // namespace rei
@@ -5,7 +5,10 @@
 #include <vector>
 
 #include "../container_utils.h"
-#include "../direct3d/d3d_renderer.h"
+#include "instancing.h"
+#include "parallel_recording.h"
+#include "render_graph.h"
+#include "scene_residency.h"
 
 using std::vector;
 
@@ -13,6 +16,9 @@ namespace rei {
 
 namespace hybrid {
 
+// Fewer G-buffer draws than this are not worth a command list of their own
+constexpr size_t c_gpass_draws_per_list = 128;
+
 struct HaltonSequence {
   size_t index = 0;
 
@@ -39,17 +45,42 @@ struct ViewportProxy {
   size_t width = 1;
   size_t height = 1;
   SwapchainHandle swapchain;
+
+  // Frame graph; the per-frame textures below are its (possibly aliased) physical textures
+  RenderGraph graph;
+  struct Passes {
+    RenderGraph::PassID gbuffer;
+    RenderGraph::PassID base_shading;
+    RenderGraph::PassID punctual_lighting;
+    RenderGraph::PassID area_lighting;
+    RenderGraph::PassID multibounce;
+    RenderGraph::PassID stochastic_shadow;
+    RenderGraph::PassID denoise_firstpass;
+    RenderGraph::PassID denoise_finalpass;
+    RenderGraph::PassID taa;
+    RenderGraph::PassID present;
+  } passes;
+  // Imported per frame, and transitioned within a pass
+  RenderGraph::TextureID backbuffer_tex;
+  RenderGraph::TextureID taa_input_tex;
+  RenderGraph::TextureID taa_output_tex;
+  RenderGraph::TextureID sample_ray_tex;
+  RenderGraph::TextureID sample_radiance_tex;
+
   BufferHandle depth_stencil_buffer;
   BufferHandle gbuffer0;
   BufferHandle gbuffer1;
   BufferHandle gbuffer2;
 
+  // G-pass view transform
+  BufferHandle gpass_cb;
+  ShaderArgumentHandle gpass_arg;
+
   ShaderArgumentHandle base_shading_inout_arg;
   ShaderArgumentHandle direct_lighting_inout_arg;
 
   // Multi-bounce GI
   BufferHandle raytracing_output_buffer;
-  ShaderArgumentHandle blit_raytracing_output;
 
   // Statochastic Shadowed area lighting
   struct AreaLightHandles {
@@ -69,17 +100,15 @@ struct ViewportProxy {
     ShaderArgumentHandle denoise_fistpass_arg0;
     ShaderArgumentHandle denoise_finalpass_arg0;
     ShaderArgumentHandle denoise_common_arg1;
-
-    // debug pass
-    ShaderArgumentHandle blit_unshadowed;
-    ShaderArgumentHandle blit_stochastic_sample_ray;
-    ShaderArgumentHandle blit_stochastic_sample_radiance;
-    ShaderArgumentHandle blit_stochastic_unshadowed;
-    ShaderArgumentHandle blit_stochastic_shadowed;
-    ShaderArgumentHandle blit_denoised_unshadowed;
-    ShaderArgumentHandle blit_denoised_shadowed;
   } area_light;
 
+  // Debug views, blitting intermediate textures over the final image; culled unless enabled
+  struct DebugView {
+    RenderGraph::PassID pass;
+    ShaderArgumentHandle blit_arg;
+  };
+  vector<DebugView> debug_views;
+
   // TAA resources
   BufferHandle taa_cb;
   BufferHandle taa_buffer[2];
@@ -107,7 +136,7 @@ struct ViewportProxy {
   BufferHandle taa_curr_input() { return taa_buffer[frame_id % 2]; }
   BufferHandle taa_curr_output() { return taa_buffer[(frame_id + 1) % 2]; }
 
-  const Mat4& get_view_proj(bool jiterred) {
+  Mat4 get_view_proj(bool jiterred) const {
     if (jiterred) {
       float rndx = HaltonSequence::sample<2>(frame_id);
       float rndy = HaltonSequence::sample<3>(frame_id);
@@ -124,44 +153,85 @@ struct ViewportProxy {
 };
 
 struct SceneProxy {
-  // holding for default material
-  BufferHandle objects_cb;
+  // World and normal transforms of all models, at their instance slot
+  BufferHandle instances_buffer;
+  size_t instances_capacity;
+  // Models sharing geometry and material are drawn with one instanced draw
+  InstanceBatcher batcher;
+  // The batches of the frame, split across the G-buffer recording threads
+  vector<InstanceBatch> gpass_batches;
+
   BufferHandle materials_cb;
+  size_t materials_capacity;
+  SlotAllocator material_slots;
   struct MaterialData {
     ShaderArgumentHandle arg;
-    Vec4 parset0;
-    Vec4 parset1;
+    ParameterBlock block; // compiled with the pipeline material schema
     size_t cb_index;
-    Vec4& albedo() { return parset0; }
-    double& smoothness() { return parset1.x; }
-    double& metalness() { return parset1.y; }
-    double& emissive() { return parset1.z; }
+    size_t refs;
+    bool dirty;
   };
   struct ModelData {
-    GeometryBuffers geo_buffers;
-    // TODO support root cb offseting
-    ShaderArgumentHandle raster_arg;
+    Scene::GeometryUID geometry;
+    Scene::MaterialUID material;
+    ModelHandle handle;
     ShaderArgumentHandle raytrace_shadertable_arg;
-    size_t cb_index;
-    size_t tlas_instance_id;
+    SlotAllocator::Slot tlas_instance_id;
     Mat4 trans;
-
-    // JUST COPY THAT SH*T
-    MaterialData mat;
+    bool dirty;
   };
-  Hashmap<Scene::GeometryUID, GeometryBuffers> geometries;
+  GeometryCache<Renderer> geometries;
   Hashmap<Scene::MaterialUID, MaterialData> materials;
   Hashmap<Scene::ModelUID, ModelData> models;
 
-  // Accelration structure and shader table
+  // Scene changes are pulled by version; only dirty instances are uploaded
+  SceneChangeTracker tracker;
+  UploadThrottle uploads;
+  vector<Scene::ModelUID> dirty_models;
+
+  void mark_dirty(Scene::ModelUID id, ModelData& model) {
+    if (model.dirty) return;
+    model.dirty = true;
+    dirty_models.push_back(id);
+  }
+  void mark_all_dirty() {
+    for (auto& kv : models)
+      mark_dirty(kv.first, kv.second);
+  }
+
+  // Materials are re-compiled only after some material changed since the last sync
+  Material::Version materials_synced = 0;
+  vector<Scene::MaterialUID> dirty_materials;
+
+  void mark_dirty(Scene::MaterialUID id, MaterialData& material) {
+    if (material.dirty) return;
+    material.dirty = true;
+    dirty_materials.push_back(id);
+  }
+
+  // Accelration structure, rebuilt when the instance set or an instance transform changes
+  SlotAllocator tlas_slots;
   BufferHandle tlas;
-  BufferHandle multibounce_shadetable;
+  bool tlas_dirty = true;
 
-  // Direct lighting const buffer
-  BufferHandle punctual_lights;
-  vector<ShaderArgumentHandle> punctual_light_arg_cache;
-  BufferHandle area_lights;
-  vector<ShaderArgumentHandle> area_light_arg_cache;
+  // Hit group records are indexed by TLAS instance id; only changed records are written
+  BufferHandle multibounce_shadetable;
+  size_t shader_table_capacity;
+  vector<Scene::ModelUID> dirty_records;
+  bool shader_table_dirty = true;
+
+  // Scene lights, packed in one structured buffer and grown on demand
+  LightMirror lights;
+  BufferHandle lights_buffer;
+  size_t lights_capacity;
+  // Dense indices of the area lights casting shadows, which get stochastic shadow passes
+  vector<std::uint32_t> shadowed_area_lights;
+
+  // Per-pass light data: element 0 for the passes looping all lights, then one element per
+  // stochastic shadow sample pass, so no pass overwrites data a previous one still reads
+  BufferHandle light_pass_cb;
+  size_t light_pass_capacity;
+  vector<ShaderArgumentHandle> light_pass_args; // lazily created, per element
 };
 
 } // namespace hybrid
@@ -171,11 +241,9 @@ using namespace hybrid;
 struct HybridGPassShaderDesc : RasterizationShaderMetaInfo {
   HybridGPassShaderDesc() {
     ShaderParameter space0 {};
-    space0.const_buffers = {ConstantBuffer()};
+    space0.const_buffers = {ConstantBuffer()}; // view transform
     ShaderParameter space1 {};
-    space1.const_buffers = {ConstantBuffer()};
-    ShaderParameter space2 {};
-    space2.const_buffers = {ConstantBuffer()};
+    space1.const_buffers = {ConstantBuffer()}; // material
 
     RenderTargetDesc rt_normal {ResourceFormat::R32G32B32A32_FLOAT};
     RenderTargetDesc rt_albedo {ResourceFormat::B8G8R8A8_UNORM};
@@ -183,6 +251,7 @@ struct HybridGPassShaderDesc : RasterizationShaderMetaInfo {
     render_target_descs = {rt_normal, rt_albedo, rt_emissive};
 
     signature.param_table = {space0, space1};
+    is_instanced = true;
   }
 };
 
@@ -225,7 +294,10 @@ struct HybridDirectLightingShaderDesc : ComputeShaderMetaInfo {
   HybridDirectLightingShaderDesc() {
     ShaderParameter space0 {};
     space0.const_buffers = {
-      ConstantBuffer(), // light data
+      ConstantBuffer(), // light pass data
+    };
+    space0.shader_resources = {
+      ShaderResource(), // scene lights
     };
     ShaderParameter space1 {};
     space1.shader_resources = {
@@ -252,7 +324,10 @@ struct HybridStochasticGenShaderDesc : ComputeShaderMetaInfo {
   HybridStochasticGenShaderDesc() {
     ShaderParameter space0 {};
     space0.const_buffers = {
-      ConstantBuffer(), // light data
+      ConstantBuffer(), // light pass data
+    };
+    space0.shader_resources = {
+      ShaderResource(), // scene lights
     };
     ShaderParameter space1 {};
     space1.shader_resources = {
@@ -346,6 +421,23 @@ struct TaaShaderDesc : ComputeShaderMetaInfo {
   }
 };
 
+// Mirrors PackedLight
+static ConstBufferLayout packed_light_layout() {
+  return {
+    ShaderDataType::Float4, // position, range
+    ShaderDataType::Float4, // direction, type
+    ShaderDataType::Float4, // radiance, flags
+    ShaderDataType::Float4, // shape
+  };
+}
+
+static ConstBufferLayout light_pass_layout() {
+  return {
+    ShaderDataType::Float4, // light count, or the index of the sampled light
+    ShaderDataType::Float4, // stochastic data
+  };
+}
+
 HybridPipeline::HybridPipeline(RendererPtr renderer)
     : SimplexPipeline(renderer),
       m_enable_multibounce(true),
@@ -353,6 +445,12 @@ HybridPipeline::HybridPipeline(RendererPtr renderer)
       m_area_shadow_ssp_per_light(4) {
   Renderer* r = get_renderer();
 
+  // Matches the material constant buffer in hybrid_gpass.hlsl
+  m_material_schema.add_float4(MaterialKeys::albedo, 0, Vec4(Colors::magenta))
+    .add_float(MaterialKeys::smoothness, 1, 0, 0)
+    .add_float(MaterialKeys::metalness, 1, 1, 0)
+    .add_float(MaterialKeys::emissive, 1, 2, 0);
+
   {
     m_gpass_shader
       = r->create_shader(L"CoreData/shader/hybrid_gpass.hlsl", HybridGPassShaderDesc());
@@ -417,55 +515,149 @@ HybridPipeline::ViewportHandle HybridPipeline::register_viewport(ViewportConfig
   proxy.height = conf.height;
   proxy.swapchain = r->create_swapchain(conf.window_id, conf.width, conf.height, 2);
 
-  proxy.depth_stencil_buffer
-    = r->create_texture_2d(TextureDesc::depth_stencil(conf.width, conf.height),
-      ResourceState::DeptpWrite, L"Depth Stencil");
-  proxy.gbuffer0 = r->create_texture_2d(
-    TextureDesc::render_target(conf.width, conf.height, ResourceFormat::R32G32B32A32_FLOAT),
-    ResourceState::RenderTarget, L"Normal Buffer");
-  proxy.gbuffer1 = r->create_texture_2d(
-    TextureDesc::render_target(conf.width, conf.height, ResourceFormat::B8G8R8A8_UNORM),
-    ResourceState::RenderTarget, L"Albedo Buffer");
-  proxy.gbuffer2 = r->create_texture_2d(
-    TextureDesc::render_target(conf.width, conf.height, ResourceFormat::R32G32B32A32_FLOAT),
-    ResourceState::RenderTarget, L"Emissive Buffer");
-
-  proxy.raytracing_output_buffer = r->create_unordered_access_buffer_2d(
-    conf.width, conf.height, ResourceFormat::R32G32B32A32_FLOAT, L"Raytracing Output Buffer");
-
-  proxy.deferred_shading_output = r->create_texture_2d(
-    TextureDesc::unorder_access(conf.width, conf.height, ResourceFormat::R32G32B32A32_FLOAT),
-    ResourceState::UnorderedAccess, L"Deferred Shading Output");
-
-  // area light resources
-  proxy.area_light.unshadowed = r->create_texture_2d(
-    TextureDesc::unorder_access(conf.width, conf.height, ResourceFormat::R32G32B32A32_FLOAT),
-    ResourceState::UnorderedAccess, L"Area Light Unshadowed");
-  proxy.area_light.stochastic_unshadowed = r->create_texture_2d(
-    TextureDesc::unorder_access(conf.width, conf.height, ResourceFormat::R32G32B32A32_FLOAT),
-    ResourceState::UnorderedAccess, L"Area Light Stochastic Unshadowed");
-  proxy.area_light.stochastic_sample_ray = r->create_texture_2d(
-    TextureDesc::unorder_access(conf.width, conf.height, ResourceFormat::R32G32B32A32_FLOAT),
-    ResourceState::UnorderedAccess, L"Area Light Stochastic Sample-Ray");
-  proxy.area_light.stochastic_sample_radiance = r->create_texture_2d(
-    TextureDesc::unorder_access(conf.width, conf.height, ResourceFormat::R32G32B32A32_FLOAT),
-    ResourceState::UnorderedAccess, L"Area Light Stochastic Sample-Radiance");
-  proxy.area_light.stochastic_shadowed = r->create_texture_2d(
-    TextureDesc::unorder_access(conf.width, conf.height, ResourceFormat::R32G32B32A32_FLOAT),
-    ResourceState::UnorderedAccess, L"Area Light Stochastic Shadowed");
-  proxy.area_light.denoised_shadowed = r->create_texture_2d(
-    TextureDesc::unorder_access(conf.width, conf.height, ResourceFormat::R32G32B32A32_FLOAT),
-    ResourceState::UnorderedAccess, L"Area Light Denoised Shadowed");
-  proxy.area_light.denoised_unshadowed = r->create_texture_2d(
-    TextureDesc::unorder_access(conf.width, conf.height, ResourceFormat::R32G32B32A32_FLOAT),
-    ResourceState::UnorderedAccess, L"Area Light Denoised Unshadowed");
-
-  // helper routine
-  auto make_blit_arg = [&](BufferHandle source) {
-    ShaderArgumentValue val {};
-    val.shader_resources = {source};
-    return r->create_shader_argument(val);
-  };
+  // Frame graph: per-frame textures and the passes using them, in execution order
+  RenderGraph& graph = proxy.graph;
+  ViewportProxy::Passes& passes = proxy.passes;
+  {
+    using RS = ResourceState;
+    const auto rt_desc = [&](ResourceFormat format) {
+      return TextureDesc::render_target(conf.width, conf.height, format);
+    };
+    const TextureDesc ua_desc
+      = TextureDesc::unorder_access(conf.width, conf.height, ResourceFormat::R32G32B32A32_FLOAT);
+
+    const auto depth = graph.create_texture(
+      TextureDesc::depth_stencil(conf.width, conf.height), L"Depth Stencil");
+    const auto gbuffer0
+      = graph.create_texture(rt_desc(ResourceFormat::R32G32B32A32_FLOAT), L"Normal Buffer");
+    const auto gbuffer1
+      = graph.create_texture(rt_desc(ResourceFormat::B8G8R8A8_UNORM), L"Albedo Buffer");
+    const auto gbuffer2
+      = graph.create_texture(rt_desc(ResourceFormat::R32G32B32A32_FLOAT), L"Emissive Buffer");
+    const auto shading = graph.create_texture(ua_desc, L"Deferred Shading Output");
+    const auto rt_output = graph.create_texture(ua_desc, L"Raytracing Output Buffer");
+    const auto unshadowed = graph.create_texture(ua_desc, L"Area Light Unshadowed");
+    const auto stochastic_unshadowed
+      = graph.create_texture(ua_desc, L"Area Light Stochastic Unshadowed");
+    const auto sample_ray = graph.create_texture(ua_desc, L"Area Light Stochastic Sample-Ray");
+    const auto sample_radiance
+      = graph.create_texture(ua_desc, L"Area Light Stochastic Sample-Radiance");
+    const auto stochastic_shadowed
+      = graph.create_texture(ua_desc, L"Area Light Stochastic Shadowed");
+    const auto denoised_shadowed = graph.create_texture(ua_desc, L"Area Light Denoised Shadowed");
+    const auto denoised_unshadowed
+      = graph.create_texture(ua_desc, L"Area Light Denoised Unshadowed");
+    proxy.backbuffer_tex = graph.import_texture(L"Swapchain Buffer", RS::Present);
+    proxy.taa_input_tex = graph.import_texture(L"TAA Input");
+    proxy.taa_output_tex = graph.import_texture(L"TAA Output");
+    proxy.sample_ray_tex = sample_ray;
+    proxy.sample_radiance_tex = sample_radiance;
+
+    const auto read_gbuffers = [&](RenderGraph::PassID pass) {
+      for (auto tex : {depth, gbuffer0, gbuffer1, gbuffer2})
+        graph.read(pass, tex, RS::ComputeShaderResource);
+    };
+
+    passes.gbuffer = graph.add_pass(L"G-Buffer");
+    graph.write(passes.gbuffer, depth, RS::DeptpWrite);
+    for (auto tex : {gbuffer0, gbuffer1, gbuffer2})
+      graph.write(passes.gbuffer, tex, RS::RenderTarget);
+
+    passes.base_shading = graph.add_pass(L"Base Shading");
+    graph.write(passes.base_shading, shading, RS::UnorderedAccess);
+
+    passes.punctual_lighting = graph.add_pass(L"Punctual Lighting");
+    read_gbuffers(passes.punctual_lighting);
+    graph.read_write(passes.punctual_lighting, shading);
+
+    passes.area_lighting = graph.add_pass(L"Area Lighting");
+    read_gbuffers(passes.area_lighting);
+    graph.write(passes.area_lighting, unshadowed, RS::UnorderedAccess);
+
+    if (m_enable_multibounce) {
+      passes.multibounce = graph.add_pass(L"Multi-bounce GI");
+      read_gbuffers(passes.multibounce);
+      graph.write(passes.multibounce, rt_output, RS::UnorderedAccess);
+      graph.read_write(passes.multibounce, shading);
+    }
+
+    passes.stochastic_shadow = graph.add_pass(L"Stochastic Shadow");
+    read_gbuffers(passes.stochastic_shadow);
+    for (auto tex : {stochastic_unshadowed, stochastic_shadowed, sample_ray, sample_radiance})
+      graph.write(passes.stochastic_shadow, tex, RS::UnorderedAccess);
+
+    // Separable bilateral filter, one axis per pass
+    passes.denoise_firstpass = graph.add_pass(L"Stochastic Shadow Denoise 0");
+    for (auto tex : {stochastic_shadowed, stochastic_unshadowed, depth, gbuffer0, unshadowed})
+      graph.read(passes.denoise_firstpass, tex, RS::ComputeShaderResource);
+    graph.write(passes.denoise_firstpass, denoised_shadowed, RS::UnorderedAccess);
+    graph.write(passes.denoise_firstpass, denoised_unshadowed, RS::UnorderedAccess);
+
+    passes.denoise_finalpass = graph.add_pass(L"Stochastic Shadow Denoise 1");
+    for (auto tex : {denoised_shadowed, denoised_unshadowed, depth, gbuffer0, unshadowed})
+      graph.read(passes.denoise_finalpass, tex, RS::ComputeShaderResource);
+    graph.read_write(passes.denoise_finalpass, shading);
+
+    passes.taa = graph.add_pass(L"TAA");
+    graph.read(passes.taa, proxy.taa_input_tex, RS::ComputeShaderResource);
+    graph.write(passes.taa, proxy.taa_output_tex, RS::UnorderedAccess);
+    graph.read_write(passes.taa, shading);
+
+    passes.present = graph.add_pass(L"Blit For Present");
+    graph.read(passes.present, shading, RS::PixelShaderResource);
+    graph.write(passes.present, proxy.backbuffer_tex, RS::RenderTarget);
+
+    const RenderGraph::TextureID debug_textures[] = {unshadowed, stochastic_unshadowed,
+      sample_ray, sample_radiance, stochastic_shadowed, denoised_shadowed, denoised_unshadowed,
+      rt_output};
+    for (auto tex : debug_textures) {
+      ViewportProxy::DebugView view {};
+      view.pass = graph.add_pass(L"Debug View", true);
+      graph.read(view.pass, tex, RS::PixelShaderResource);
+      graph.write(view.pass, proxy.backbuffer_tex, RS::RenderTarget);
+      proxy.debug_views.push_back(view);
+    }
+
+    RenderGraph::CompileOptions options {};
+    options.debug_views = m_enable_debug_views;
+    bool compiled = graph.compile(options);
+    REI_ASSERT(compiled);
+    graph.realize(r);
+
+    proxy.depth_stencil_buffer = graph.texture(depth);
+    proxy.gbuffer0 = graph.texture(gbuffer0);
+    proxy.gbuffer1 = graph.texture(gbuffer1);
+    proxy.gbuffer2 = graph.texture(gbuffer2);
+    proxy.deferred_shading_output = graph.texture(shading);
+    proxy.raytracing_output_buffer = graph.texture(rt_output);
+    proxy.area_light.unshadowed = graph.texture(unshadowed);
+    proxy.area_light.stochastic_unshadowed = graph.texture(stochastic_unshadowed);
+    proxy.area_light.stochastic_sample_ray = graph.texture(sample_ray);
+    proxy.area_light.stochastic_sample_radiance = graph.texture(sample_radiance);
+    proxy.area_light.stochastic_shadowed = graph.texture(stochastic_shadowed);
+    proxy.area_light.denoised_shadowed = graph.texture(denoised_shadowed);
+    proxy.area_light.denoised_unshadowed = graph.texture(denoised_unshadowed);
+
+    // Blit arguments, for the debug views kept
+    for (size_t i = 0; i < proxy.debug_views.size(); i++) {
+      ViewportProxy::DebugView& view = proxy.debug_views[i];
+      if (graph.is_culled(view.pass)) continue;
+      ShaderArgumentValue val {};
+      val.shader_resources = {graph.texture(debug_textures[i])};
+      view.blit_arg = r->create_shader_argument(val);
+    }
+  }
+
+  {
+    ConstBufferLayout lo = {
+      ShaderDataType::Float4x4, // view_proj, jittered
+    };
+    proxy.gpass_cb = r->create_const_buffer(lo, 1, L"GPass CB");
+    ShaderArgumentValue v {};
+    v.const_buffers = {proxy.gpass_cb};
+    v.const_buffer_offsets = {0};
+    proxy.gpass_arg = r->create_shader_argument(v);
+  }
 
   // Base shading pass argument
   {
@@ -499,7 +691,6 @@ HybridPipeline::ViewportHandle HybridPipeline::register_viewport(ViewportConfig
       = {0}; // FIXME current all viewport using the same part of per-render buffer
     proxy.area_light.unshadowed_pass_arg = r->create_shader_argument(val);
     REI_ASSERT(proxy.area_light.unshadowed_pass_arg);
-    proxy.area_light.blit_unshadowed = make_blit_arg(proxy.area_light.unshadowed);
   }
   {
     ShaderArgumentValue val {};
@@ -512,15 +703,6 @@ HybridPipeline::ViewportHandle HybridPipeline::register_viewport(ViewportConfig
       = {0}; // FIXME current all viewport using the same part of per-render buffer
     proxy.area_light.sample_gen_pass_arg = r->create_shader_argument(val);
     REI_ASSERT(proxy.area_light.sample_gen_pass_arg);
-    proxy.area_light.blit_stochastic_unshadowed
-      = make_blit_arg(proxy.area_light.stochastic_unshadowed);
-    proxy.area_light.blit_stochastic_sample_ray
-      = make_blit_arg(proxy.area_light.stochastic_sample_ray);
-    proxy.area_light.blit_stochastic_sample_radiance
-      = make_blit_arg(proxy.area_light.stochastic_sample_radiance);
-  }
-  {
-    proxy.area_light.blit_stochastic_shadowed = make_blit_arg(proxy.area_light.stochastic_shadowed);
   }
   {
     ShaderArgumentValue val1 {};
@@ -535,18 +717,12 @@ HybridPipeline::ViewportHandle HybridPipeline::register_viewport(ViewportConfig
     first0.unordered_accesses
       = {proxy.area_light.denoised_shadowed, proxy.area_light.denoised_unshadowed};
     proxy.area_light.denoise_fistpass_arg0 = r->create_shader_argument(first0);
-    ShaderArgumentValue final0 = first0;
+    // The final pass filters the other axis of the first pass result
+    ShaderArgumentValue final0 {};
+    final0.shader_resources
+      = {proxy.area_light.denoised_shadowed, proxy.area_light.denoised_unshadowed};
     final0.unordered_accesses = {proxy.deferred_shading_output};
     proxy.area_light.denoise_finalpass_arg0 = r->create_shader_argument(final0);
-
-    proxy.area_light.blit_denoised_shadowed = make_blit_arg(proxy.area_light.denoised_shadowed);
-    proxy.area_light.blit_denoised_unshadowed = make_blit_arg(proxy.area_light.denoised_unshadowed);
-  }
-
-  // Multibounce tracing arguments
-  {
-    // debug blit
-    proxy.blit_raytracing_output = make_blit_arg(proxy.raytracing_output_buffer);
   }
 
   // TAA arguments
@@ -556,6 +732,7 @@ HybridPipeline::ViewportHandle HybridPipeline::register_viewport(ViewportConfig
     proxy.taa_cb = r->create_const_buffer(lo, 1, L"TAA CB");
   }
   {
+    // History is kept across frames, so it lives out of the frame graph
     static const wchar_t* taa_names[2] = {L"TAA_Buffer[0]", L"TAA_Buffer[1]"};
     auto make_taa_buffer = [&](int idx) {
       return r->create_texture_2d(
@@ -580,11 +757,20 @@ HybridPipeline::ViewportHandle HybridPipeline::register_viewport(ViewportConfig
   }
 
   // final blit
-  proxy.blit_for_present = make_blit_arg(proxy.deferred_shading_output);
+  {
+    ShaderArgumentValue val {};
+    val.shader_resources = {proxy.deferred_shading_output};
+    proxy.blit_for_present = r->create_shader_argument(val);
+  }
 
   return add_viewport(std::move(proxy));
 }
 
+const RenderGraph* HybridPipeline::render_graph(ViewportHandle handle) {
+  ViewportProxy* viewport = get_viewport(handle);
+  return viewport ? &viewport->graph : nullptr;
+}
+
 void HybridPipeline::transform_viewport(ViewportHandle handle, const Camera& camera) {
   ViewportProxy* viewport = get_viewport(handle);
   REI_ASSERT(viewport);
@@ -609,124 +795,316 @@ HybridPipeline::SceneHandle HybridPipeline::register_scene(SceneConfig conf) {
   REI_ASSERT(r);
 
   const size_t model_count = scene->get_models().size();
-  const size_t material_count = scene->materials().size();
 
   SceneProxy proxy = {};
-  // Initialize Geometries
+  // Allocate material, instance and shader table storage; grown on demand when models are added
   {
-    for (const GeometryPtr& geo : scene->geometries()) {
-      GeometryBuffers buffers = r->create_geometry({geo});
-      Scene::GeometryUID id = conf.scene->get_id(geo);
-      proxy.geometries.insert({id, buffers});
-    }
+    proxy.materials_capacity = grown_capacity(0, scene->materials().size());
+    proxy.materials_cb = r->create_const_buffer(
+      m_material_schema.layout(), proxy.materials_capacity, L"Scene Material CB");
   }
-  // Initialize Materials
   {
-    ConstBufferLayout mat_lo = {
-      ShaderDataType::Float4, // albedo
-      ShaderDataType::Float4, // metalness and smoothness
+    ConstBufferLayout lo = {
+      ShaderDataType::Float4x4, // World
+      ShaderDataType::Float4x4, // Normal; see Mat4::normal_matrix
     };
-    proxy.materials_cb = r->create_const_buffer(mat_lo, material_count, L"Scene Material CB");
+    // Batches reserve power-of-two ranges, so leave some room
+    proxy.instances_capacity = grown_capacity(0, model_count * 2);
+    proxy.instances_buffer
+      = r->create_instance_buffer(lo, proxy.instances_capacity, L"Scene-Instances Buffer");
+  }
+  proxy.shader_table_capacity = grown_capacity(0, model_count);
+  proxy.multibounce_shadetable
+    = r->create_shader_table(proxy.shader_table_capacity, m_multibounce_shader);
+
+  // Allocate analitic light buffers; filled by the first light sync
+  proxy.lights_capacity = grown_capacity(0, scene->lights().size());
+  proxy.lights_buffer = r->create_structured_buffer(
+    packed_light_layout(), proxy.lights_capacity, L"Scene Lights Buffer");
+  proxy.light_pass_capacity = grown_capacity(0, 1);
+  proxy.light_pass_cb
+    = r->create_const_buffer(light_pass_layout(), proxy.light_pass_capacity, L"Light Pass CB");
+
+  // Models go through the same path as models added later
+  SceneHandle handle = add_scene(std::move(proxy));
+  SceneProxy* added = get_scene(handle);
+  added->models.reserve(model_count);
+  added->uploads.budget = conf.geometry_upload_budget;
+  for (const ModelPtr& model : scene->get_models()) {
+    // Still loading; registered when the scene reports its geometry
+    if (dynamic_cast<const PendingGeometry*>(model->get_geometry().get())) continue;
+    register_model(*added, *model, scene->get_id(model));
+  }
+  added->tracker.synced_to(scene->version());
+  sync_lights(*added, scene->lights());
+  return handle;
+}
 
-    proxy.materials.reserve(material_count);
-    size_t index = 0;
-    ShaderArgumentValue v {};
-    v.const_buffers = {proxy.materials_cb}; // currenlty, materials are just somt value config
-    v.const_buffer_offsets = {0};
-    for (const MaterialPtr& mat : scene->materials()) {
-      v.const_buffer_offsets[0] = index;
-      ShaderArgumentHandle mat_arg = r->create_shader_argument(v);
-      REI_ASSERT(mat_arg);
-      SceneProxy::MaterialData data {};
-      data.arg = mat_arg;
-      data.cb_index = index;
-      data.albedo() = Vec4(mat->get<Color>(L"albedo").value_or(Colors::magenta));
-      data.smoothness() = mat->get<double>(L"smoothness").value_or(0);
-      data.metalness() = mat->get<double>(L"metalness").value_or(0);
-      data.emissive() = mat->get<double>(L"emissive").value_or(0);
-      proxy.materials.insert({conf.scene->get_id(mat), data});
-      index++;
+void HybridPipeline::remove_scene(SceneHandle scene) {
+  drop_cached_args(0, scene);
+  scenes.erase(scene);
+}
+
+void HybridPipeline::remove_viewport(ViewportHandle viewport) {
+  drop_cached_args(viewport, 0);
+  viewports.erase(viewport);
+}
+
+void HybridPipeline::add_model(
+  SceneHandle scene_handle, const Model& model, Scene::ModelUID model_id) {
+  SceneProxy* scene = get_scene(scene_handle);
+  REI_ASSERT(scene);
+  if (scene->models.has(model_id)) {
+    update_model(scene_handle, model, model_id);
+    return;
+  }
+  register_model(*scene, model, model_id);
+}
+
+void HybridPipeline::update_model(
+  SceneHandle scene_handle, const Model& model, Scene::ModelUID model_id) {
+  SceneProxy* scene = get_scene(scene_handle);
+  REI_ASSERT(scene);
+  auto* data = scene->models.try_get(model_id);
+  if (!data) return; // not registered
+  if (data->geometry != Scene::GeometryUID(model.get_geometry().get())
+      || data->material != Scene::MaterialUID(model.get_material().get())) {
+    // Moves to another batch and needs another hit group record
+    unregister_model(*scene, model_id);
+    register_model(*scene, model, model_id);
+    return;
+  }
+  data->trans = model.get_transform();
+  scene->mark_dirty(model_id, *data);
+  scene->tlas_dirty = true;
+}
+
+void HybridPipeline::remove_model(SceneHandle scene_handle, Scene::ModelUID model_id) {
+  SceneProxy* scene = get_scene(scene_handle);
+  REI_ASSERT(scene);
+  if (scene->models.has(model_id)) unregister_model(*scene, model_id);
+}
+
+void HybridPipeline::sync_scene(SceneHandle scene_handle, const Scene& scene) {
+  SceneProxy* proxy = get_scene(scene_handle);
+  REI_ASSERT(proxy);
+
+  sync_with_budget(
+    scene, proxy->tracker, proxy->uploads,
+    [&](Scene::GeometryUID geometry) { return proxy->geometries.resident(geometry); },
+    [&](Scene::ModelUID id) { remove_model(scene_handle, id); },
+    [&](const Model& model, Scene::ModelUID id) { add_model(scene_handle, model, id); });
+
+  // Edited geometries get new buffers, hence new BLAS and hit group arguments
+  proxy->geometries.refresh(*get_renderer(), [&](Scene::GeometryUID geometry) {
+    for (auto& kv : proxy->models)
+      if (kv.second.geometry == geometry) create_raytrace_record(*proxy, kv.first);
+    proxy->tlas_dirty = true;
+  });
+
+  // Skip the material walk entirely when no material was edited since the last sync
+  const Material::Version latest = Material::latest_version();
+  if (latest != proxy->materials_synced) {
+    for (const MaterialPtr& mat : scene.materials()) {
+      const Scene::MaterialUID id = scene.get_id(mat);
+      auto* data = proxy->materials.try_get(id);
+      if (data && m_material_schema.compile(*mat, data->block)) proxy->mark_dirty(id, *data);
     }
+    proxy->materials_synced = latest;
   }
 
-  // Initialize Geometry, Material, and assigning raster/ray-tracing shader arguments
-  {
-    ConstBufferLayout cb_lo = {
-      ShaderDataType::Float4x4, // WVP
+  sync_lights(*proxy, scene.lights());
+}
+
+void HybridPipeline::sync_lights(SceneProxy& scene, const LightStore& lights) {
+  if (!scene.lights.sync(lights)) return;
+
+  if (scene.lights.size() > scene.lights_capacity) {
+    // Every light is uploaded again into the larger buffer
+    Renderer* r = get_renderer();
+    scene.lights_capacity = grown_capacity(scene.lights_capacity, scene.lights.size());
+    scene.lights_buffer = r->create_structured_buffer(
+      packed_light_layout(), scene.lights_capacity, L"Scene Lights Buffer");
+    scene.lights.mark_all_dirty();
+    scene.light_pass_args.clear();
+  }
+
+  // Only two small columns are read; the rest of a light never leaves the store
+  scene.shadowed_area_lights.clear();
+  const LightType* types = lights.types();
+  const std::uint32_t* flags = lights.flags();
+  const std::uint32_t shadowed = Light::Enabled | Light::CastShadow;
+  for (size_t i = 0; i < lights.size(); i++) {
+    const bool area = types[i] == LightType::Sphere || types[i] == LightType::Tube;
+    if (area && (flags[i] & shadowed) == shadowed)
+      scene.shadowed_area_lights.push_back(std::uint32_t(i));
+  }
+
+  const size_t passes = 1 + scene.shadowed_area_lights.size() * m_area_shadow_ssp_per_light;
+  if (passes > scene.light_pass_capacity) {
+    Renderer* r = get_renderer();
+    scene.light_pass_capacity = grown_capacity(scene.light_pass_capacity, passes);
+    scene.light_pass_cb
+      = r->create_const_buffer(light_pass_layout(), scene.light_pass_capacity, L"Light Pass CB");
+    scene.light_pass_args.clear();
+  }
+}
+
+void HybridPipeline::register_model(
+  SceneProxy& scene, const Model& model, Scene::ModelUID model_id) {
+  Renderer* r = get_renderer();
+  REI_ASSERT(r);
+  const GeometryPtr& geometry = model.get_geometry();
+  const MaterialPtr& material = model.get_material();
+  REI_ASSERT(geometry && material);
+
+  scene.geometries.acquire(*r, geometry);
+  acquire_material(scene, material);
+
+  SceneProxy::ModelData data {};
+  data.geometry = Scene::GeometryUID(geometry.get());
+  data.material = Scene::MaterialUID(material.get());
+  data.handle = model.handle();
+  data.tlas_instance_id = scene.tlas_slots.allocate();
+  data.trans = model.get_transform();
+  scene.models.insert({model_id, data});
+  scene.tracker.track(data.handle, model_id);
+  scene.batcher.add(model_id, data.geometry, data.material);
+  scene.mark_dirty(model_id, *scene.models.try_get(model_id));
+  scene.tlas_dirty = true;
+
+  if (scene.tlas_slots.end() > scene.shader_table_capacity) {
+    // Every record is written again into the larger table
+    scene.shader_table_capacity
+      = grown_capacity(scene.shader_table_capacity, scene.tlas_slots.end());
+    scene.multibounce_shadetable
+      = r->create_shader_table(scene.shader_table_capacity, m_multibounce_shader);
+    scene.shader_table_dirty = true;
+  }
+  if (scene.batcher.slot_count() > scene.instances_capacity) {
+    ConstBufferLayout lo = {
       ShaderDataType::Float4x4, // World
+      ShaderDataType::Float4x4, // Normal; see Mat4::normal_matrix
     };
-    proxy.objects_cb = r->create_const_buffer(cb_lo, model_count, L"Scene-Objects CB");
-
-    proxy.models.reserve(model_count);
-    ShaderArgumentValue raster_arg_value = {};
-    { // init
-      raster_arg_value.const_buffers = {proxy.objects_cb};
-      raster_arg_value.const_buffer_offsets = {SIZE_T_ERROR};
-    }
-    ShaderArgumentValue raytrace_arg_value = {};
-    {
-      raytrace_arg_value.const_buffers = {proxy.materials_cb};
-      raytrace_arg_value.const_buffer_offsets = {SIZE_T_ERROR};
-    }
-    for (size_t model_index = 0; model_index < model_count; model_index++) {
-      auto model = scene->get_models()[model_index];
-      auto mat = proxy.materials.try_get(conf.scene->get_id(model->get_material()));
-      REI_ASSERT(mat);
-      auto geo = proxy.geometries.try_get(conf.scene->get_id(model->get_geometry()));
-      REI_ASSERT(geo);
-      const size_t material_index = mat->cb_index;
-      // raster
-      raster_arg_value.const_buffer_offsets[0] = model_index;
-      ShaderArgumentHandle raster_arg = r->create_shader_argument(raster_arg_value);
-      // raytrace
-      raytrace_arg_value.shader_resources = {geo->index_buffer, geo->vertex_buffer};
-      raytrace_arg_value.const_buffer_offsets[0] = material_index;
-      ShaderArgumentHandle raytrace_arg = r->create_shader_argument(raytrace_arg_value);
-      // record
-      size_t tlas_instance_id = model_index;
-      SceneProxy::ModelData data {*geo, raster_arg, raytrace_arg, model_index, tlas_instance_id,
-        model->get_transform(), *mat};
-      proxy.models.insert({conf.scene->get_id(model), std::move(data)});
-    }
+    scene.instances_capacity = grown_capacity(scene.instances_capacity, scene.batcher.slot_count());
+    scene.instances_buffer
+      = r->create_instance_buffer(lo, scene.instances_capacity, L"Scene-Instances Buffer");
+    scene.mark_all_dirty();
   }
 
-  // Build Acceleration structure and shader table
-  {
-    RaytraceSceneDesc desc {};
-    for (auto& kv : proxy.models) {
-      auto& m = kv.second;
-      desc.instance_id.push_back(m.tlas_instance_id);
-      desc.blas_buffer.push_back(m.geo_buffers.blas_buffer);
-      desc.transform.push_back(m.trans);
-    }
-    proxy.tlas = r->create_raytracing_accel_struct(desc);
-    proxy.multibounce_shadetable = r->create_shader_table(*scene, m_multibounce_shader);
+  create_raytrace_record(scene, model_id);
+}
+
+void HybridPipeline::unregister_model(SceneProxy& scene, Scene::ModelUID model_id) {
+  const SceneProxy::ModelData* data = scene.models.try_get(model_id);
+  REI_ASSERT(data);
+  scene.batcher.remove(model_id);
+  scene.tlas_slots.free(data->tlas_instance_id);
+  release_material(scene, data->material);
+  // BLAS stays alive with the current TLAS until it is rebuilt before the next trace
+  scene.geometries.release(data->geometry);
+  scene.tracker.untrack(data->handle);
+  scene.models.erase(model_id);
+  scene.tlas_dirty = true;
+}
+
+void HybridPipeline::acquire_material(SceneProxy& scene, const MaterialPtr& material) {
+  const Scene::MaterialUID id = Scene::MaterialUID(material.get());
+  if (SceneProxy::MaterialData* found = scene.materials.try_get(id)) {
+    found->refs++;
+    return;
   }
 
-  // Allocate analitic light buffer
-  {
-    ConstBufferLayout lo {};
-    lo[0] = ShaderDataType::Float4; // pos_dir
-    lo[1] = ShaderDataType::Float4; // color
-    proxy.punctual_lights = r->create_const_buffer(lo, 128, L"Punctual Lights Buffer");
+  SceneProxy::MaterialData data {};
+  data.cb_index = scene.material_slots.allocate();
+  data.refs = 1;
+  m_material_schema.compile(*material, data.block);
+  SceneProxy::MaterialData& added = scene.materials.insert({id, data}).first->second;
+  scene.mark_dirty(id, added);
+  if (scene.material_slots.end() > scene.materials_capacity) {
+    grow_materials(scene); // also creates the argument of the new material
+    return;
   }
-  {
-    ConstBufferLayout lo {};
-    lo[0] = ShaderDataType::Float4; // shaper
-    lo[1] = ShaderDataType::Float4; // color
-    lo[2] = ShaderDataType::Float4; // stochastic data
-    proxy.area_lights = r->create_const_buffer(lo, 128, L"Area Lights Buffer");
+
+  Renderer* r = get_renderer();
+  ShaderArgumentValue v {};
+  v.const_buffers = {scene.materials_cb}; // currenlty, materials are just somt value config
+  v.const_buffer_offsets = {added.cb_index};
+  added.arg = r->create_shader_argument(v);
+  REI_ASSERT(added.arg);
+}
+
+void HybridPipeline::release_material(SceneProxy& scene, Scene::MaterialUID material) {
+  SceneProxy::MaterialData* data = scene.materials.try_get(material);
+  REI_ASSERT(data && data->refs > 0);
+  if (--data->refs > 0) return;
+  scene.material_slots.free(SlotAllocator::Slot(data->cb_index));
+  scene.materials.erase(material);
+}
+
+void HybridPipeline::grow_materials(SceneProxy& scene) {
+  Renderer* r = get_renderer();
+  REI_ASSERT(r);
+  scene.materials_capacity = grown_capacity(scene.materials_capacity, scene.material_slots.end());
+  scene.materials_cb = r->create_const_buffer(
+    m_material_schema.layout(), scene.materials_capacity, L"Scene Material CB");
+
+  // Everything pointing into the old buffer is recreated
+  ShaderArgumentValue v {};
+  v.const_buffers = {scene.materials_cb};
+  v.const_buffer_offsets = {0};
+  for (auto& kv : scene.materials) {
+    v.const_buffer_offsets[0] = kv.second.cb_index;
+    kv.second.arg = r->create_shader_argument(v);
+    scene.mark_dirty(kv.first, kv.second);
   }
+  for (auto& kv : scene.models)
+    create_raytrace_record(scene, kv.first);
+}
 
-  return add_scene(std::move(proxy));
+void HybridPipeline::create_raytrace_record(SceneProxy& scene, Scene::ModelUID model_id) {
+  Renderer* r = get_renderer();
+  SceneProxy::ModelData* model = scene.models.try_get(model_id);
+  REI_ASSERT(model);
+  const GeometryBuffers* geo = scene.geometries.get(model->geometry);
+  const SceneProxy::MaterialData* mat = scene.materials.try_get(model->material);
+  REI_ASSERT(geo && mat);
+
+  ShaderArgumentValue v = {};
+  v.const_buffers = {scene.materials_cb};
+  v.const_buffer_offsets = {mat->cb_index};
+  v.shader_resources = {geo->index_buffer, geo->vertex_buffer};
+  model->raytrace_shadertable_arg = r->create_shader_argument(v);
+  if (!scene.shader_table_dirty) scene.dirty_records.push_back(model_id);
 }
 
-void HybridPipeline::update_model(
-  SceneHandle scene_handle, const Model& model, Scene::ModelUID model_id) {
-  SceneProxy* scene = get_scene(scene_handle);
-  REI_ASSERT(scene);
-  auto* data = scene->models.try_get(model_id);
-  data->trans = model.get_transform();
+void HybridPipeline::rebuild_tlas(SceneHandle scene_handle, SceneProxy& scene) {
+  Renderer* r = get_renderer();
+  RaytraceSceneDesc desc {};
+  desc.instance_id.reserve(scene.models.size());
+  desc.blas_buffer.reserve(scene.models.size());
+  desc.transform.reserve(scene.models.size());
+  for (auto& kv : scene.models) {
+    const auto& m = kv.second;
+    desc.instance_id.push_back(m.tlas_instance_id);
+    desc.blas_buffer.push_back(scene.geometries.get(m.geometry)->blas_buffer);
+    desc.transform.push_back(m.trans);
+  }
+  scene.tlas = r->create_raytracing_accel_struct(desc);
+  scene.tlas_dirty = false;
+  // Tracing arguments bind the TLAS
+  drop_cached_args(0, scene_handle);
+}
+
+void HybridPipeline::drop_cached_args(ViewportHandle viewport, SceneHandle scene) {
+  auto matches = [&](const CombinedArgumentKey& key) {
+    return (!viewport || key.first == viewport) && (!scene || key.second == scene);
+  };
+  for (auto* cache : {&m_raytracing_args, &m_shadow_tracing_args}) {
+    for (auto it = cache->begin(); it != cache->end();) {
+      it = matches(it->first) ? cache->erase(it) : std::next(it);
+    }
+  }
 }
 
 void HybridPipeline::render(ViewportHandle viewport_h, SceneHandle scene_h) {
@@ -736,7 +1114,7 @@ void HybridPipeline::render(ViewportHandle viewport_h, SceneHandle scene_h) {
   REI_ASSERT(scene);
 
   Renderer* const renderer = get_renderer();
-  const auto cmd_list = renderer->prepare();
+  CommandList* const cmd_list = renderer->prepare();
 
   // render info
   Mat4 view_proj = viewport->get_view_proj(viewport->view_proj_dirty && m_enable_jittering);
@@ -746,66 +1124,107 @@ void HybridPipeline::render(ViewportHandle viewport_h, SceneHandle scene_h) {
   // Update pre-render const buffer (aka per-frame CB)
   {
     Vec4 screen = Vec4(viewport->width, viewport->height, 0, 0);
-    cmd_list->update_const_buffer(m_per_render_buffer, 0, 0, screen);
-    cmd_list->update_const_buffer(m_per_render_buffer, 0, 1, viewport->proj_inv);
-    cmd_list->update_const_buffer(m_per_render_buffer, 0, 2, viewport->view_proj);
-    cmd_list->update_const_buffer(m_per_render_buffer, 0, 3, viewport->view_proj_inv);
-    cmd_list->update_const_buffer(m_per_render_buffer, 0, 4, viewport->cam_pos);
+    renderer->update_const_buffer(m_per_render_buffer, 0, 0, screen);
+    renderer->update_const_buffer(m_per_render_buffer, 0, 1, viewport->proj_inv);
+    renderer->update_const_buffer(m_per_render_buffer, 0, 2, viewport->view_proj);
+    renderer->update_const_buffer(m_per_render_buffer, 0, 3, viewport->view_proj_inv);
+    renderer->update_const_buffer(m_per_render_buffer, 0, 4, viewport->cam_pos);
     Vec4 render_info = Vec4(viewport->frame_id, -1, -1, -1);
-    cmd_list->update_const_buffer(m_per_render_buffer, 0, 5, render_info);
+    renderer->update_const_buffer(m_per_render_buffer, 0, 5, render_info);
+  }
+
+  // Acceleration structure for the current instance set
+  if (scene->tlas_dirty) rebuild_tlas(scene_h, *scene);
+
+  // Upload the lights changed since the last frame, in one copy
+  if (scene->lights.dirty()) {
+    const size_t first = scene->lights.dirty_first();
+    renderer->update_buffer_elements(scene->lights_buffer, first, scene->lights.data() + first,
+      scene->lights.dirty_last() - first);
+    scene->lights.clear_dirty();
   }
+  const size_t light_count = scene->lights.size();
+  renderer->update_const_buffer(scene->light_pass_cb, 0, 0, Vec4(double(light_count), 0, 0, 0));
 
   // Update material buffer
   {
-    for (auto& pair : scene->materials) {
-      auto& mat = pair.second;
-      renderer->update_const_buffer(scene->materials_cb, mat.cb_index, 0, mat.parset0);
-      renderer->update_const_buffer(scene->materials_cb, mat.cb_index, 1, mat.parset1);
+    for (Scene::MaterialUID id : scene->dirty_materials) {
+      auto* mat = scene->materials.try_get(id);
+      if (!mat) continue; // released since
+      renderer->update_const_buffer(
+        scene->materials_cb, mat->cb_index, mat->block.data(), mat->block.bytes());
+      mat->dirty = false;
     }
+    scene->dirty_materials.clear();
   }
 
+  //-------
+  // Frame graph: imports of this frame; passes below are begun in graph order, which issues the
+  // transitions and UAV barriers they need
+  RenderGraph& graph = viewport->graph;
+  const ViewportProxy::Passes& passes = viewport->passes;
+  BufferHandle render_target = renderer->fetch_swapchain_render_target_buffer(viewport->swapchain);
+  graph.bind_import(viewport->backbuffer_tex, render_target);
+  graph.bind_import(viewport->taa_input_tex, viewport->taa_curr_input());
+  graph.bind_import(viewport->taa_output_tex, viewport->taa_curr_output());
+
   //-------
   // Pass: Create G-Buffer
 
-  // Update per-object const buffer
+  // Update view transform and per-instance transforms
   {
-    for (auto& pair : scene->models) {
-      auto& model = pair.second;
-      size_t index = model.cb_index;
-      Mat4& m = model.trans;
-      Mat4 mvp = view_proj * m;
-      renderer->update_const_buffer(scene->objects_cb, index, 0, mvp);
-      renderer->update_const_buffer(scene->objects_cb, index, 1, m);
+    renderer->update_const_buffer(viewport->gpass_cb, 0, 0, view_proj);
+    for (Scene::ModelUID id : scene->batcher.take_relocated())
+      scene->mark_dirty(id, *scene->models.try_get(id));
+    for (Scene::ModelUID id : scene->dirty_models) {
+      auto* model = scene->models.try_get(id);
+      if (!model) continue;
+      const size_t index = scene->batcher.slot(id);
+      renderer->update_const_buffer(scene->instances_buffer, index, 0, model->trans);
+      renderer->update_const_buffer(
+        scene->instances_buffer, index, 1, model->trans.normal_matrix());
+      model->dirty = false;
     }
+    scene->dirty_models.clear();
   }
 
   // Draw to G-Buffer
-  cmd_list->transition(viewport->gbuffer0, ResourceState::RenderTarget);
-  cmd_list->transition(viewport->gbuffer1, ResourceState::RenderTarget);
-  cmd_list->transition(viewport->gbuffer2, ResourceState::RenderTarget);
-  cmd_list->transition(viewport->depth_stencil_buffer, ResourceState::DeptpWrite);
-  RenderPassCommand gpass = {};
-  {
+  if (graph.begin_pass(cmd_list, passes.gbuffer)) {
+    RenderPassCommand gpass = {};
     gpass.render_targets = {viewport->gbuffer0, viewport->gbuffer1, viewport->gbuffer2};
     gpass.depth_stencil = viewport->depth_stencil_buffer;
     gpass.clear_ds = true;
     gpass.clear_rt = true;
     gpass.viewport = RenderViewaport::full(viewport->width, viewport->height);
     gpass.area = RenderArea::full(viewport->width, viewport->height);
+
+    // Draws recorded on several threads; each range resumes the pass the first one clears
+    vector<InstanceBatch>& batches = scene->gpass_batches;
+    batches.clear();
+    scene->batcher.for_each_batch([&](const InstanceBatch& batch) { batches.push_back(batch); });
+    record_in_parallel(renderer, cmd_list, batches.size(), c_gpass_draws_per_list,
+      [&](CommandList* list, size_t begin, size_t end) {
+        RenderPassCommand range_pass = gpass;
+        range_pass.clear_rt = range_pass.clear_ds = begin == 0;
+        list->begin_render_pass(range_pass);
+        DrawCommand draw_cmd = {};
+        draw_cmd.shader = m_gpass_shader;
+        draw_cmd.instance_buffer = scene->instances_buffer;
+        for (size_t i = begin; i < end; i++) {
+          const InstanceBatch& batch = batches[i];
+          const GeometryBuffers* geo = scene->geometries.get(batch.geometry);
+          const SceneProxy::MaterialData* mat = scene->materials.try_get(batch.material);
+          REI_ASSERT(geo && mat);
+          draw_cmd.index_buffer = geo->index_buffer;
+          draw_cmd.vertex_buffer = geo->vertex_buffer;
+          draw_cmd.arguments = {viewport->gpass_arg, mat->arg};
+          draw_cmd.instance_offset = batch.first_instance;
+          draw_cmd.instance_count = batch.instance_count;
+          list->draw(draw_cmd);
+        }
+        list->end_render_pass();
+      });
   }
-  cmd_list->begin_render_pass(gpass);
-  {
-    DrawCommand draw_cmd = {};
-    draw_cmd.shader = m_gpass_shader;
-    for (auto pair : scene->models) {
-      auto& model = pair.second;
-      draw_cmd.index_buffer = model.geo_buffers.index_buffer;
-      draw_cmd.vertex_buffer = model.geo_buffers.vertex_buffer;
-      draw_cmd.arguments = {model.raster_arg, model.mat.arg};
-      cmd_list->draw(draw_cmd);
-    }
-  }
-  cmd_list->end_render_pass();
 
   //--- End G-Buffer pass
 
@@ -813,8 +1232,7 @@ void HybridPipeline::render(ViewportHandle viewport_h, SceneHandle scene_h) {
   // Pass: Deferred direct lightings, both punctual and area lights
 
   // Base Shading
-  cmd_list->transition(viewport->deferred_shading_output, ResourceState::UnorderedAccess);
-  {
+  if (graph.begin_pass(cmd_list, passes.base_shading)) {
     DispatchCommand dispatch {};
     dispatch.compute_shader = m_base_shading_shader;
     dispatch.arguments = {viewport->base_shading_inout_arg};
@@ -824,35 +1242,12 @@ void HybridPipeline::render(ViewportHandle viewport_h, SceneHandle scene_h) {
     cmd_list->dispatch(dispatch);
   }
 
-  cmd_list->barrier(viewport->deferred_shading_output);
-
   // Punctual lights
-  // TODO: same texture input for multibounce GI
-  cmd_list->transition(viewport->gbuffer0, ResourceState::ComputeShaderResource);
-  cmd_list->transition(viewport->gbuffer1, ResourceState::ComputeShaderResource);
-  cmd_list->transition(viewport->gbuffer2, ResourceState::ComputeShaderResource);
-  cmd_list->transition(viewport->depth_stencil_buffer, ResourceState::ComputeShaderResource);
-  cmd_list->transition(viewport->deferred_shading_output, ResourceState::UnorderedAccess);
-  // currently both taa and direct-lighting write to the same UA buffer
-  cmd_list->barrier(viewport->deferred_shading_output);
-  int light_count = 0;
-  static int light_indices[] = {0, 1};
-  static Color light_colors[] = {Colors::white * 1.3, Colors::white * 1};
-  static Vec4 light_pos_dirs[] = {{Vec3(1, 2, 1).normalized(), 0}, {0, 2, 0, 1}};
-  for (int i = 0; i < light_count; i++) {
-    int light_index = light_indices[i];
-    Vec4 light_color = Vec4(light_colors[i]);
-    Vec4 light_pos_dir = light_pos_dirs[i];
-
-    // update light data
-    cmd_list->update_const_buffer(scene->punctual_lights, light_index, 0, light_pos_dir);
-    cmd_list->update_const_buffer(scene->punctual_lights, light_index, 1, light_color);
-
-    // dispatch
+  if (graph.begin_pass(cmd_list, passes.punctual_lighting) && light_count > 0) {
+    // One dispatch for all lights; the shader skips area lights
     DispatchCommand dispatch {};
     dispatch.compute_shader = m_punctual_lighting_shader;
-    dispatch.arguments = {
-      fetch_direct_punctual_lighting_arg(*scene, light_index), viewport->direct_lighting_inout_arg};
+    dispatch.arguments = {fetch_light_pass_arg(*scene, 0), viewport->direct_lighting_inout_arg};
     dispatch.dispatch_x = viewport->width / 8;
     dispatch.dispatch_y = viewport->height / 8;
     dispatch.dispatch_z = 1;
@@ -860,70 +1255,52 @@ void HybridPipeline::render(ViewportHandle viewport_h, SceneHandle scene_h) {
   }
 
   // Area lights
-  // TODO: same texture input for multibounce GI
-  cmd_list->transition(viewport->gbuffer0, ResourceState::ComputeShaderResource);
-  cmd_list->transition(viewport->gbuffer1, ResourceState::ComputeShaderResource);
-  cmd_list->transition(viewport->gbuffer2, ResourceState::ComputeShaderResource);
-  cmd_list->transition(viewport->depth_stencil_buffer, ResourceState::ComputeShaderResource);
-  cmd_list->transition(viewport->area_light.unshadowed, ResourceState::UnorderedAccess);
-  cmd_list->clear_texture(viewport->area_light.unshadowed, {0, 0, 0, 0},
-    RenderArea::full(viewport->width, viewport->height));
-  cmd_list->barrier(viewport->area_light.unshadowed);
-  static std::array<int, 2> area_light_indices = {0, 1};
-  static std::array<Vec4, 2> area_light_shapes = {
-    Vec4(-100, 50, 60, 1),
-    Vec4(-5, 4, -3, .5),
-  };
-  static std::array<Color, 2> area_light_colors {
-    Colors::white * 30000,
-    Colors::white * 400,
-  };
-  for (int i = 0; i < area_light_indices.size(); i++) {
-    int light_index = area_light_indices[i];
-    Vec4 light_color = Vec4(area_light_colors[i]);
-    Vec4 light_shape = area_light_shapes[i];
-
-    // update light data
-    cmd_list->update_const_buffer(scene->area_lights, light_index, 0, light_shape);
-    cmd_list->update_const_buffer(scene->area_lights, light_index, 1, light_color);
-
-    // dispatch
-    DispatchCommand dispatch {};
-    dispatch.compute_shader = m_area_lighting_shader;
-    dispatch.arguments = {fetch_direct_area_lighting_arg(*scene, light_index),
-      viewport->area_light.unshadowed_pass_arg};
-    dispatch.dispatch_x = viewport->width / 8;
-    dispatch.dispatch_y = viewport->height / 8;
-    dispatch.dispatch_z = 1;
-    cmd_list->dispatch(dispatch);
+  if (graph.begin_pass(cmd_list, passes.area_lighting)) {
+    cmd_list->clear_texture(viewport->area_light.unshadowed, {0, 0, 0, 0},
+      RenderArea::full(viewport->width, viewport->height));
+    cmd_list->barrier(viewport->area_light.unshadowed);
+    if (light_count > 0) {
+      // One dispatch for all lights; the shader skips punctual lights
+      DispatchCommand dispatch {};
+      dispatch.compute_shader = m_area_lighting_shader;
+      dispatch.arguments
+        = {fetch_light_pass_arg(*scene, 0), viewport->area_light.unshadowed_pass_arg};
+      dispatch.dispatch_x = viewport->width / 8;
+      dispatch.dispatch_y = viewport->height / 8;
+      dispatch.dispatch_z = 1;
+      cmd_list->dispatch(dispatch);
+    }
   }
 
   // --- End Deferred directy lighting
 
   //-------
   // Pass: Raytraced multi-bounced GI
-  if (m_enable_multibounce) {
+  if (m_enable_multibounce && graph.begin_pass(cmd_list, passes.multibounce)) {
     // TODO move this to a seperated command queue
 
-    // Update shader Tables
+    // Update shader Tables; hit group arguments only change with the scene layout
     {
       UpdateShaderTable desc = UpdateShaderTable::hitgroup();
       desc.shader = m_multibounce_shader;
       desc.shader_table = scene->multibounce_shadetable;
-      for (auto& pair : scene->models) {
-        auto& m = pair.second;
+      auto write_record = [&](const SceneProxy::ModelData& m) {
         desc.index = m.tlas_instance_id;
         desc.arguments = {m.raytrace_shadertable_arg};
-        cmd_list->update_shader_table(desc);
+        renderer->update_shader_table(desc);
+      };
+      if (scene->shader_table_dirty) {
+        for (auto& pair : scene->models)
+          write_record(pair.second);
+        scene->shader_table_dirty = false;
+      } else {
+        for (Scene::ModelUID id : scene->dirty_records)
+          if (const auto* m = scene->models.try_get(id)) write_record(*m);
       }
+      scene->dirty_records.clear();
     }
 
     // Trace
-    cmd_list->transition(viewport->gbuffer0, ResourceState::ComputeShaderResource);
-    cmd_list->transition(viewport->gbuffer1, ResourceState::ComputeShaderResource);
-    cmd_list->transition(viewport->gbuffer2, ResourceState::ComputeShaderResource);
-    cmd_list->transition(viewport->depth_stencil_buffer, ResourceState::ComputeShaderResource);
-    cmd_list->transition(viewport->raytracing_output_buffer, ResourceState::UnorderedAccess);
     {
       RaytraceCommand cmd {};
       cmd.raytrace_shader = m_multibounce_shader;
@@ -939,83 +1316,69 @@ void HybridPipeline::render(ViewportHandle viewport_h, SceneHandle scene_h) {
   // -------
   // Pass: Stochastic Shadow
 
-  cmd_list->transition(viewport->area_light.stochastic_unshadowed, ResourceState::UnorderedAccess);
-  cmd_list->transition(viewport->area_light.stochastic_shadowed, ResourceState::UnorderedAccess);
-  cmd_list->clear_texture(viewport->area_light.stochastic_unshadowed, {0, 0, 0, 0},
-    RenderArea::full(viewport->width, viewport->height));
-  cmd_list->clear_texture(viewport->area_light.stochastic_shadowed, {0, 0, 0, 0},
-    RenderArea::full(viewport->width, viewport->height));
-  cmd_list->barrier(viewport->area_light.stochastic_unshadowed);
-  cmd_list->barrier(viewport->area_light.stochastic_shadowed);
-
-  // generate stochastic sample, and trace
-  // NOTE: per light, multiple ray-per-pixel
-  HaltonSequence halton {viewport->frame_id};
-  for (int i = 0; i < area_light_indices.size(); i++) {
-    int light_index = area_light_indices[i];
-    Vec4 light_color = Vec4(area_light_colors[i]);
-    Vec4 light_shape = area_light_shapes[i];
-
-    // update light data and random data
-    cmd_list->update_const_buffer(scene->area_lights, light_index, 0, light_shape);
-    cmd_list->update_const_buffer(scene->area_lights, light_index, 1, light_color);
-
-    for (int sp = 0; sp < m_area_shadow_ssp_per_light; sp++) {
-      // update random data for each sample pass
-      cmd_list->update_const_buffer(scene->area_lights, light_index, 2, halton.next4());
-
-      // sample gen
-      cmd_list->transition(
-        viewport->area_light.stochastic_sample_ray, ResourceState::UnorderedAccess);
-      cmd_list->transition(
-        viewport->area_light.stochastic_sample_radiance, ResourceState::UnorderedAccess);
-      cmd_list->clear_texture(viewport->area_light.stochastic_sample_ray, {0, 0, 0, 0},
-        RenderArea::full(viewport->width, viewport->height));
-      cmd_list->clear_texture(viewport->area_light.stochastic_sample_radiance, {0, 0, 0, 0},
-        RenderArea::full(viewport->width, viewport->height));
-      cmd_list->barrier(viewport->area_light.stochastic_sample_ray);
-      cmd_list->barrier(viewport->area_light.stochastic_sample_radiance);
-      DispatchCommand dispatch {};
-      dispatch.compute_shader = m_stochastic_shadow_sample_gen_shader;
-      dispatch.arguments = {fetch_direct_area_lighting_arg(*scene, light_index),
-        viewport->area_light.sample_gen_pass_arg};
-      dispatch.dispatch_x = viewport->width / 8;
-      dispatch.dispatch_y = viewport->height / 8;
-      dispatch.dispatch_z = 1;
-      cmd_list->dispatch(dispatch);
-
-      // shadow trace
-      cmd_list->transition(
-        viewport->area_light.stochastic_sample_ray, ResourceState::ComputeShaderResource);
-      cmd_list->transition(
-        viewport->area_light.stochastic_sample_radiance, ResourceState::ComputeShaderResource);
-      cmd_list->barrier(viewport->area_light.stochastic_sample_ray);
-      cmd_list->barrier(viewport->area_light.stochastic_sample_radiance);
-      RaytraceCommand trace {};
-      trace.raytrace_shader = m_stochastic_shadow_trace_shader;
-      trace.arguments = {fetch_shadow_tracing_arg(viewport_h, scene_h)};
-      trace.shader_table = m_stochastic_shadow_trace_shadertable;
-      trace.width = viewport->width;
-      trace.height = viewport->height;
-      cmd_list->raytrace(trace);
-    } // end for each ssp
-
-  } // end for each area light
+  if (graph.begin_pass(cmd_list, passes.stochastic_shadow)) {
+    cmd_list->clear_texture(viewport->area_light.stochastic_unshadowed, {0, 0, 0, 0},
+      RenderArea::full(viewport->width, viewport->height));
+    cmd_list->clear_texture(viewport->area_light.stochastic_shadowed, {0, 0, 0, 0},
+      RenderArea::full(viewport->width, viewport->height));
+    cmd_list->barrier(viewport->area_light.stochastic_unshadowed);
+    cmd_list->barrier(viewport->area_light.stochastic_shadowed);
+
+    // generate stochastic sample, and trace
+    // NOTE: per shadowed area light, multiple ray-per-pixel
+    HaltonSequence halton {viewport->frame_id};
+    size_t pass_index = 1;
+    for (std::uint32_t light_index : scene->shadowed_area_lights) {
+      for (int sp = 0; sp < m_area_shadow_ssp_per_light; sp++, pass_index++) {
+        // light index and random data for each sample pass
+        const Vec4 pass_info = Vec4(double(light_index), 0, 0, 0);
+        renderer->update_const_buffer(scene->light_pass_cb, pass_index, 0, pass_info);
+        renderer->update_const_buffer(scene->light_pass_cb, pass_index, 1, halton.next4());
+
+        // sample gen
+        graph.transition(cmd_list, viewport->sample_ray_tex, ResourceState::UnorderedAccess);
+        graph.transition(cmd_list, viewport->sample_radiance_tex, ResourceState::UnorderedAccess);
+        cmd_list->clear_texture(viewport->area_light.stochastic_sample_ray, {0, 0, 0, 0},
+          RenderArea::full(viewport->width, viewport->height));
+        cmd_list->clear_texture(viewport->area_light.stochastic_sample_radiance, {0, 0, 0, 0},
+          RenderArea::full(viewport->width, viewport->height));
+        cmd_list->barrier(viewport->area_light.stochastic_sample_ray);
+        cmd_list->barrier(viewport->area_light.stochastic_sample_radiance);
+        DispatchCommand dispatch {};
+        dispatch.compute_shader = m_stochastic_shadow_sample_gen_shader;
+        dispatch.arguments
+          = {fetch_light_pass_arg(*scene, pass_index), viewport->area_light.sample_gen_pass_arg};
+        dispatch.dispatch_x = viewport->width / 8;
+        dispatch.dispatch_y = viewport->height / 8;
+        dispatch.dispatch_z = 1;
+        cmd_list->dispatch(dispatch);
+
+        // shadow trace
+        graph.transition(
+          cmd_list, viewport->sample_ray_tex, ResourceState::ComputeShaderResource);
+        graph.transition(
+          cmd_list, viewport->sample_radiance_tex, ResourceState::ComputeShaderResource);
+        RaytraceCommand trace {};
+        trace.raytrace_shader = m_stochastic_shadow_trace_shader;
+        trace.arguments = {fetch_shadow_tracing_arg(viewport_h, scene_h)};
+        trace.shader_table = m_stochastic_shadow_trace_shadertable;
+        trace.width = viewport->width;
+        trace.height = viewport->height;
+        cmd_list->raytrace(trace);
+      } // end for each ssp
+
+    } // end for each shadowed area light
+  }
 
   // Two-pass denoise -> output final shade //
-  cmd_list->transition(
-    viewport->area_light.stochastic_shadowed, ResourceState::ComputeShaderResource);
-  cmd_list->transition(
-    viewport->area_light.stochastic_unshadowed, ResourceState::ComputeShaderResource);
-  cmd_list->transition(viewport->area_light.denoised_shadowed, ResourceState::UnorderedAccess);
-  cmd_list->transition(viewport->area_light.denoised_unshadowed, ResourceState::UnorderedAccess);
-  cmd_list->clear_texture(viewport->area_light.denoised_shadowed, Vec4(0, 0, 0, 0),
-    RenderArea::full(viewport->width, viewport->height));
-  cmd_list->clear_texture(viewport->area_light.denoised_unshadowed, Vec4(0, 0, 0, 0),
-    RenderArea::full(viewport->width, viewport->height));
-  cmd_list->barrier(viewport->area_light.denoised_shadowed);
-  cmd_list->barrier(viewport->area_light.denoised_unshadowed);
-  {
+  if (graph.begin_pass(cmd_list, passes.denoise_firstpass)) {
+    cmd_list->clear_texture(viewport->area_light.denoised_shadowed, Vec4(0, 0, 0, 0),
+      RenderArea::full(viewport->width, viewport->height));
+    cmd_list->clear_texture(viewport->area_light.denoised_unshadowed, Vec4(0, 0, 0, 0),
+      RenderArea::full(viewport->width, viewport->height));
+    cmd_list->barrier(viewport->area_light.denoised_shadowed);
+    cmd_list->barrier(viewport->area_light.denoised_unshadowed);
+
     DispatchCommand dispatch {};
     dispatch.compute_shader = m_stochastic_shadow_denoise_firstpass_shader;
     dispatch.arguments
@@ -1025,11 +1388,7 @@ void HybridPipeline::render(ViewportHandle viewport_h, SceneHandle scene_h) {
     dispatch.dispatch_z = 1;
     cmd_list->dispatch(dispatch);
   }
-  cmd_list->transition(
-    viewport->area_light.denoised_shadowed, ResourceState::ComputeShaderResource);
-  cmd_list->transition(
-    viewport->area_light.denoised_unshadowed, ResourceState::ComputeShaderResource);
-  {
+  if (graph.begin_pass(cmd_list, passes.denoise_finalpass)) {
     DispatchCommand dispatch {};
     dispatch.compute_shader = m_stochastic_shadow_denoise_finalpass_shader;
     dispatch.arguments
@@ -1044,14 +1403,10 @@ void HybridPipeline::render(ViewportHandle viewport_h, SceneHandle scene_h) {
 
   // -------
   // Pass: TAA on final shading result
-  {
+  if (graph.begin_pass(cmd_list, passes.taa)) {
     Vec4 parset0 {double(viewport->frame_id), taa_blend_factor, -1, -1};
-    cmd_list->update_const_buffer(viewport->taa_cb, 0, 0, parset0);
-  }
-  cmd_list->transition(viewport->taa_curr_input(), ResourceState::ComputeShaderResource);
-  cmd_list->transition(viewport->taa_curr_output(), ResourceState::UnorderedAccess);
-  cmd_list->transition(viewport->deferred_shading_output, ResourceState::UnorderedAccess);
-  {
+    renderer->update_const_buffer(viewport->taa_cb, 0, 0, parset0);
+
     DispatchCommand dispatch {};
     dispatch.compute_shader = m_taa_shader;
     dispatch.arguments = {viewport->taa_curr_arg()};
@@ -1066,10 +1421,7 @@ void HybridPipeline::render(ViewportHandle viewport_h, SceneHandle scene_h) {
   // -------
   // Pass: Blit Post-processing reults to render target
 
-  BufferHandle render_target = renderer->fetch_swapchain_render_target_buffer(viewport->swapchain);
-  cmd_list->transition(render_target, ResourceState::RenderTarget);
-  cmd_list->transition(viewport->deferred_shading_output, ResourceState::PixelShaderResource);
-  {
+  if (graph.begin_pass(cmd_list, passes.present)) {
     RenderPassCommand render_pass {};
     render_pass.render_targets = {render_target};
     render_pass.depth_stencil = c_empty_handle;
@@ -1089,66 +1441,43 @@ void HybridPipeline::render(ViewportHandle viewport_h, SceneHandle scene_h) {
 
   // --- End blitting
 
-  // some debug blits
-#if !DEBUG
-  if (false)
-#endif
+  // some debug blits, stacked on the left side
   {
     const size_t blit_height = viewport->height / 8;
     const size_t blit_width = blit_height * viewport->width / viewport->height;
     int debug_blit_count = 0;
     const RenderViewaport full_vp = RenderViewaport::full(viewport->width, viewport->height);
     const RenderArea full_area = RenderArea::full(viewport->width, viewport->height);
-    auto debug_blit_pass
-      = [&](BufferHandle texture, ShaderArgumentHandle blit_arg, bool full = false) {
-          cmd_list->transition(texture, ResourceState::PixelShaderResource);
-          RenderPassCommand render_pass {};
-          render_pass.render_targets = {render_target};
-          render_pass.depth_stencil = c_empty_handle;
-          render_pass.clear_ds = false;
-          render_pass.clear_rt = false;
-          if (full) {
-            render_pass.viewport = full_vp;
-            render_pass.area = full_area;
-          } else {
-            render_pass.viewport = full_vp.shrink_to_upper_left(
-              blit_width, blit_height, 0, blit_height * debug_blit_count);
-            render_pass.area = full_area.shrink_to_upper_left(
-              blit_width, blit_height, 0, blit_height * debug_blit_count);
-          }
-          cmd_list->begin_render_pass(render_pass);
-
-          DrawCommand draw {};
-          draw.arguments = {blit_arg};
-          draw.shader = m_blit_shader;
-          cmd_list->draw(draw);
-
-          cmd_list->end_render_pass();
-
-          debug_blit_count++;
-        };
-
-    debug_blit_pass(viewport->area_light.unshadowed, viewport->area_light.blit_unshadowed);
-    debug_blit_pass(
-      viewport->area_light.stochastic_unshadowed, viewport->area_light.blit_stochastic_unshadowed);
-    debug_blit_pass(
-      viewport->area_light.stochastic_sample_ray, viewport->area_light.blit_stochastic_sample_ray);
-    debug_blit_pass(viewport->area_light.stochastic_sample_radiance,
-      viewport->area_light.blit_stochastic_sample_radiance);
-    debug_blit_pass(
-      viewport->area_light.stochastic_shadowed, viewport->area_light.blit_stochastic_shadowed);
-    debug_blit_pass(
-      viewport->area_light.denoised_shadowed, viewport->area_light.blit_denoised_shadowed);
-    debug_blit_pass(
-      viewport->area_light.denoised_unshadowed, viewport->area_light.blit_denoised_unshadowed);
-    debug_blit_pass(viewport->raytracing_output_buffer, viewport->blit_raytracing_output);
+    for (const ViewportProxy::DebugView& view : viewport->debug_views) {
+      if (!graph.begin_pass(cmd_list, view.pass)) continue;
+      RenderPassCommand render_pass {};
+      render_pass.render_targets = {render_target};
+      render_pass.depth_stencil = c_empty_handle;
+      render_pass.clear_ds = false;
+      render_pass.clear_rt = false;
+      render_pass.viewport = full_vp.shrink_to_upper_left(
+        blit_width, blit_height, 0, blit_height * debug_blit_count);
+      render_pass.area = full_area.shrink_to_upper_left(
+        blit_width, blit_height, 0, blit_height * debug_blit_count);
+      cmd_list->begin_render_pass(render_pass);
+
+      DrawCommand draw {};
+      draw.arguments = {view.blit_arg};
+      draw.shader = m_blit_shader;
+      cmd_list->draw(draw);
+
+      cmd_list->end_render_pass();
+
+      debug_blit_count++;
+    }
   }
 
   // Update frame-counting in the end
   viewport->advance_frame();
 
-  cmd_list->transition(render_target, ResourceState::Present);
-  cmd_list->present(viewport->swapchain, false);
+  // Leaves the render target ready to present
+  graph.end_frame(cmd_list);
+  renderer->present(viewport->swapchain, false);
 }
 
 ShaderArgumentHandle HybridPipeline::fetch_raytracing_arg(
@@ -1223,44 +1552,23 @@ ShaderArgumentHandle HybridPipeline::fetch_shadow_tracing_arg(
   return arg;
 }
 
-ShaderArgumentHandle HybridPipeline::fetch_direct_punctual_lighting_arg(
-  SceneProxy& scene, int cb_index) {
-  REI_ASSERT(cb_index >= 0);
-  if (cb_index >= scene.punctual_light_arg_cache.size()) {
-    Renderer* r = get_renderer();
-    REI_ASSERT(r);
-
-    ShaderArgumentValue val {};
-    val.const_buffers = {scene.punctual_lights};
-    val.const_buffer_offsets = {size_t(cb_index)};
-    ShaderArgumentHandle h = r->create_shader_argument(val);
-    REI_ASSERT(h);
-    scene.punctual_light_arg_cache.reserve(cb_index + 1);
-    scene.punctual_light_arg_cache.resize(cb_index + 1);
-    scene.punctual_light_arg_cache[cb_index] = h;
-  }
-
-  return scene.punctual_light_arg_cache[cb_index];
-}
-
-ShaderArgumentHandle HybridPipeline::fetch_direct_area_lighting_arg(
-  SceneProxy& scene, int cb_index) {
-  REI_ASSERT(cb_index >= 0);
-  if (cb_index >= scene.area_light_arg_cache.size()) {
+ShaderArgumentHandle HybridPipeline::fetch_light_pass_arg(SceneProxy& scene, size_t pass_index) {
+  REI_ASSERT(pass_index < scene.light_pass_capacity);
+  if (pass_index >= scene.light_pass_args.size()) scene.light_pass_args.resize(pass_index + 1);
+  ShaderArgumentHandle& cached = scene.light_pass_args[pass_index];
+  if (!cached) {
     Renderer* r = get_renderer();
     REI_ASSERT(r);
 
     ShaderArgumentValue val {};
-    val.const_buffers = {scene.area_lights};
-    val.const_buffer_offsets = {size_t(cb_index)};
-    ShaderArgumentHandle h = r->create_shader_argument(val);
-    REI_ASSERT(h);
-    scene.area_light_arg_cache.reserve(cb_index + 1);
-    scene.area_light_arg_cache.resize(cb_index + 1);
-    scene.area_light_arg_cache[cb_index] = h;
+    val.const_buffers = {scene.light_pass_cb};
+    val.const_buffer_offsets = {pass_index};
+    val.shader_resources = {scene.lights_buffer};
+    cached = r->create_shader_argument(val);
+    REI_ASSERT(cached);
   }
 
-  return scene.area_light_arg_cache[cb_index];
+  return cached;
 }
 
 } // namespace rei
@@ -4,16 +4,13 @@
 #include <functional>
 #include <string>
 
+#include "../material_block.h"
 #include "render_pipeline_base.h"
 
 namespace rei {
 
-// FIXME lazyness
-namespace d3d {
-class Renderer;
-}
-
 // Forwared decl
+class RenderGraph;
 namespace hybrid {
 struct ViewportProxy;
 struct SceneProxy;
@@ -23,9 +20,7 @@ struct SceneProxy;
 // Hybrid pipeline mixing deferred-rasterizing and raytracing
 //
 class HybridPipeline
-    : public SimplexPipeline<hybrid::ViewportProxy, hybrid::SceneProxy, d3d::Renderer> {
-  // FIXME lazyness
-  using Renderer = d3d::Renderer;
+    : public SimplexPipeline<hybrid::ViewportProxy, hybrid::SceneProxy> {
   using ViewportProxy = hybrid::ViewportProxy;
   using SceneProxy = hybrid::SceneProxy;
 
@@ -33,22 +28,35 @@ public:
   HybridPipeline(RendererPtr renderer);
 
   ViewportHandle register_viewport(ViewportConfig conf) override;
-  void remove_viewport(ViewportHandle viewport) override {}
+  void remove_viewport(ViewportHandle viewport) override;
   void transform_viewport(ViewportHandle handle, const Camera& camera) override;
 
   SceneHandle register_scene(SceneConfig conf) override;
-  void remove_scene(SceneHandle scene) override {}
+  void remove_scene(SceneHandle scene) override;
 
-  void add_model(SceneHandle scene, const Model& model, Scene::ModelUID model_id) override {}
+  void add_model(SceneHandle scene, const Model& model, Scene::ModelUID model_id) override;
   void update_model(SceneHandle scene, const Model& model, Scene::ModelUID model_id) override;
+  void remove_model(SceneHandle scene, Scene::ModelUID model_id) override;
+  void sync_scene(SceneHandle scene_handle, const Scene& scene) override;
 
   virtual void render(ViewportHandle viewport, SceneHandle scene) override;
 
+  // Frame graph of a viewport, compiled at registration; for inspection
+  const RenderGraph* render_graph(ViewportHandle viewport);
+
 private:
   const bool m_enable_jittering = true;
   const bool m_enable_multibounce = true;
   const bool m_enabled_accumulated_rtrt = true;
   const int m_area_shadow_ssp_per_light = 4;
+#if DEBUG
+  const bool m_enable_debug_views = true;
+#else
+  const bool m_enable_debug_views = false;
+#endif
+
+  // How scene materials are packed into the material constant buffer
+  MaterialSchema m_material_schema;
 
   ShaderHandle m_gpass_shader;
 
@@ -78,19 +86,31 @@ private:
     }
     size_t operator()(const CombinedArgumentKey& key) const {
       size_t seed = 0;
-      combine(seed, std::hash_value(key.first));
-      combine(seed, std::hash_value(key.second));
+      combine(seed, std::hash<ViewportHandle>()(key.first));
+      combine(seed, std::hash<SceneHandle>()(key.second));
       return seed;
     }
   };
   Hashmap<CombinedArgumentKey, ShaderArgumentHandle, RakHash> m_raytracing_args;
   Hashmap<CombinedArgumentKey, ShaderArgumentHandle, RakHash> m_shadow_tracing_args;
 
+  // Incremental scene residency
+  void register_model(SceneProxy& scene, const Model& model, Scene::ModelUID model_id);
+  void unregister_model(SceneProxy& scene, Scene::ModelUID model_id);
+  void acquire_material(SceneProxy& scene, const MaterialPtr& material);
+  void release_material(SceneProxy& scene, Scene::MaterialUID material);
+  void grow_materials(SceneProxy& scene);
+  void create_raytrace_record(SceneProxy& scene, Scene::ModelUID model_id);
+  void rebuild_tlas(SceneHandle scene_handle, SceneProxy& scene);
+  void drop_cached_args(ViewportHandle viewport, SceneHandle scene);
+
   ShaderArgumentHandle fetch_raytracing_arg(ViewportHandle viewport, SceneHandle scene);
   ShaderArgumentHandle fetch_shadow_tracing_arg(ViewportHandle viewport, SceneHandle scene);
 
-  ShaderArgumentHandle fetch_direct_punctual_lighting_arg(SceneProxy& scene, int cb_index);
-  ShaderArgumentHandle fetch_direct_area_lighting_arg(SceneProxy& scene, int cb_index);
+  // Re-pack changed lights, growing the light and light pass buffers as needed
+  void sync_lights(SceneProxy& scene, const LightStore& lights);
+  // Light pass data at `pass_index`, and all scene lights
+  ShaderArgumentHandle fetch_light_pass_arg(SceneProxy& scene, size_t pass_index);
 };
 
 } // namespace rei
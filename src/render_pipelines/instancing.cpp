@@ -0,0 +1,151 @@
+// source of instancing.h
+#include "instancing.h"
+
+namespace rei {
+
+InstanceBatchList build_instance_batches(const Scene& scene) {
+  const auto& models = scene.get_models();
+
+  // Assign batches by first appearance, and count instances
+  Hashmap<InstanceBatchKey, std::uint32_t, InstanceBatchKey::Hasher> batch_of_key;
+  std::vector<std::uint32_t> batch_of_model(models.size());
+  InstanceBatchList ret;
+  for (size_t i = 0; i < models.size(); i++) {
+    const InstanceBatchKey key {
+      scene.get_id(models[i]->get_geometry()), scene.get_id(models[i]->get_material())};
+    auto inserted = batch_of_key.insert({key, std::uint32_t(ret.batches.size())});
+    if (inserted.second) ret.batches.push_back({key.geometry, key.material, 0, 0});
+    batch_of_model[i] = inserted.first->second;
+    ret.batches[batch_of_model[i]].instance_count++;
+  }
+
+  // Lay instances out batch by batch (counting sort keeps scene order within a batch)
+  std::uint32_t offset = 0;
+  for (InstanceBatch& batch : ret.batches) {
+    batch.first_instance = offset;
+    offset += batch.instance_count;
+  }
+  std::vector<std::uint32_t> fill(ret.batches.size());
+  ret.models.resize(models.size());
+  for (size_t i = 0; i < models.size(); i++) {
+    const InstanceBatch& batch = ret.batches[batch_of_model[i]];
+    ret.models[batch.first_instance + fill[batch_of_model[i]]++] = scene.get_id(models[i]);
+  }
+  return ret;
+}
+
+namespace {
+
+std::uint32_t log2_of_pow2(std::uint32_t x) {
+  std::uint32_t n = 0;
+  while ((x >>= 1) != 0)
+    n++;
+  return n;
+}
+
+} // namespace
+
+InstanceBatcher::Slot InstanceBatcher::add(
+  Scene::ModelUID model, Scene::GeometryUID geometry, Scene::MaterialUID material) {
+  REI_ASSERT(!m_locations.has(model));
+  const InstanceBatchKey key {geometry, material};
+  std::uint32_t batch_index;
+  if (const std::uint32_t* found = m_batch_of_key.try_get(key)) {
+    batch_index = *found;
+  } else {
+    if (m_free_batches.empty()) {
+      batch_index = std::uint32_t(m_batches.size());
+      m_batches.emplace_back();
+    } else {
+      batch_index = m_free_batches.back();
+      m_free_batches.pop_back();
+    }
+    Batch& batch = m_batches[batch_index];
+    batch.key = key;
+    batch.capacity = 4;
+    batch.first_slot = allocate_range(batch.capacity);
+    m_batch_of_key.insert({key, batch_index});
+  }
+
+  Batch& batch = m_batches[batch_index];
+  if (batch.models.size() == batch.capacity) {
+    // Move the whole batch to a range twice as large
+    const Slot first = allocate_range(batch.capacity * 2);
+    free_range(batch.first_slot, batch.capacity);
+    batch.first_slot = first;
+    batch.capacity *= 2;
+    m_relocated.insert(m_relocated.end(), batch.models.begin(), batch.models.end());
+  }
+  const std::uint32_t index = std::uint32_t(batch.models.size());
+  batch.models.push_back(model);
+  m_locations.insert({model, {batch_index, index}});
+  return batch.first_slot + index;
+}
+
+void InstanceBatcher::remove(Scene::ModelUID model) {
+  const Location* found = m_locations.try_get(model);
+  REI_ASSERT(found);
+  const Location loc = *found;
+  m_locations.erase(model);
+
+  Batch& batch = m_batches[loc.batch];
+  const Scene::ModelUID last = batch.models.back();
+  batch.models.pop_back();
+  if (last != model) {
+    batch.models[loc.index] = last;
+    m_locations[last].index = loc.index;
+    m_relocated.push_back(last);
+  }
+
+  if (batch.models.empty()) {
+    free_range(batch.first_slot, batch.capacity);
+    m_batch_of_key.erase(batch.key);
+    batch.capacity = 0;
+    m_free_batches.push_back(loc.batch);
+  }
+}
+
+void InstanceBatcher::clear() {
+  m_batch_of_key.clear();
+  m_batches.clear();
+  m_free_batches.clear();
+  m_locations.clear();
+  m_relocated.clear();
+  m_free_ranges.clear();
+  m_slot_end = 0;
+}
+
+InstanceBatcher::Slot InstanceBatcher::slot(Scene::ModelUID model) const {
+  const Location* loc = m_locations.try_get(model);
+  REI_ASSERT(loc);
+  return m_batches[loc->batch].first_slot + loc->index;
+}
+
+std::vector<Scene::ModelUID> InstanceBatcher::take_relocated() {
+  std::vector<Scene::ModelUID> ret;
+  ret.reserve(m_relocated.size());
+  for (Scene::ModelUID model : m_relocated)
+    if (m_locations.has(model)) ret.push_back(model);
+  m_relocated.clear();
+  return ret;
+}
+
+InstanceBatcher::Slot InstanceBatcher::allocate_range(Slot capacity) {
+  const std::uint32_t size_class = log2_of_pow2(capacity);
+  if (size_class < m_free_ranges.size() && !m_free_ranges[size_class].empty()) {
+    const Slot first = m_free_ranges[size_class].back();
+    m_free_ranges[size_class].pop_back();
+    return first;
+  }
+  const Slot first = m_slot_end;
+  m_slot_end += capacity;
+  return first;
+}
+
+void InstanceBatcher::free_range(Slot first, Slot capacity) {
+  const std::uint32_t size_class = log2_of_pow2(capacity);
+  if (size_class >= m_free_ranges.size()) m_free_ranges.resize(size_class + 1);
+  m_free_ranges[size_class].push_back(first);
+}
+
+} // namespace rei
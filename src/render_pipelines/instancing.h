@@ -0,0 +1,116 @@
+#ifndef REI_INSTANCING_H
+#define REI_INSTANCING_H
+
+#include <cstdint>
+#include <vector>
+
+#include "../container_utils.h"
+#include "../scene.h"
+
+/*
+ * instancing.h
+ * Group scene models sharing geometry and material into instanced draws.
+ */
+
+namespace rei {
+
+// One instanced draw: instances [first_instance, first_instance + instance_count)
+struct InstanceBatch {
+  Scene::GeometryUID geometry;
+  Scene::MaterialUID material;
+  std::uint32_t first_instance;
+  std::uint32_t instance_count;
+};
+
+// Instances are laid out batch by batch; instance i draws models[i].
+// Batches come in the order their first model appears in the scene, and models keep scene order
+// within a batch, so the list is stable across rebuilds of an unchanged scene.
+struct InstanceBatchList {
+  std::vector<InstanceBatch> batches;
+  std::vector<Scene::ModelUID> models;
+
+  size_t instance_count() const { return models.size(); }
+};
+
+InstanceBatchList build_instance_batches(const Scene& scene);
+
+struct InstanceBatchKey {
+  Scene::GeometryUID geometry;
+  Scene::MaterialUID material;
+
+  bool operator==(const InstanceBatchKey& other) const {
+    return geometry == other.geometry && material == other.material;
+  }
+
+  struct Hasher {
+    std::size_t operator()(const InstanceBatchKey& key) const {
+      std::size_t h = std::hash<Scene::GeometryUID>()(key.geometry);
+      return h ^ (std::hash<Scene::MaterialUID>()(key.material) + 0x9e3779b9 + (h << 6) + (h >> 2));
+    }
+  };
+};
+
+/*
+ * Incremental version of build_instance_batches, for scenes that add and remove models.
+ * Each batch owns a power-of-two range of instance slots, so adding a model touches only its
+ * own slot unless the batch is full and moves to a range twice as large. Removal swaps the last
+ * instance of the batch into the hole. Freed ranges are reused by later batches of the same size.
+ */
+class InstanceBatcher {
+public:
+  using Slot = std::uint32_t;
+
+  // Return the instance slot of the model
+  Slot add(Scene::ModelUID model, Scene::GeometryUID geometry, Scene::MaterialUID material);
+  void remove(Scene::ModelUID model);
+  void clear();
+
+  bool contains(Scene::ModelUID model) const { return m_locations.has(model); }
+  Slot slot(Scene::ModelUID model) const;
+
+  // Models whose slot changed (by batch relocation or swap-removal) since the last call;
+  // their instance data must be written again.
+  std::vector<Scene::ModelUID> take_relocated();
+
+  // Instance buffer size needed to hold every slot handed out
+  Slot slot_count() const { return m_slot_end; }
+  size_t instance_count() const { return m_locations.size(); }
+
+  // f(const InstanceBatch&) for each non-empty batch
+  template <typename F>
+  void for_each_batch(F f) const {
+    for (const Batch& batch : m_batches)
+      if (batch.models.size() > 0)
+        f(InstanceBatch {batch.key.geometry, batch.key.material, batch.first_slot,
+          std::uint32_t(batch.models.size())});
+  }
+
+private:
+  struct Batch {
+    InstanceBatchKey key;
+    Slot first_slot;
+    Slot capacity;
+    std::vector<Scene::ModelUID> models;
+  };
+  struct Location {
+    std::uint32_t batch;
+    std::uint32_t index;
+  };
+
+  Hashmap<InstanceBatchKey, std::uint32_t, InstanceBatchKey::Hasher> m_batch_of_key;
+  std::vector<Batch> m_batches;
+  std::vector<std::uint32_t> m_free_batches;
+  Hashmap<Scene::ModelUID, Location> m_locations;
+  std::vector<Scene::ModelUID> m_relocated;
+
+  // Free slot ranges by log2 of their size
+  std::vector<std::vector<Slot>> m_free_ranges;
+  Slot m_slot_end = 0;
+
+  Slot allocate_range(Slot capacity);
+  void free_range(Slot first, Slot capacity);
+};
+
+} // namespace rei
+
+#endif
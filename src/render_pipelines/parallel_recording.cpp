@@ -0,0 +1,32 @@
+// source of parallel_recording.h
+#include "parallel_recording.h"
+
+#include <algorithm>
+#include <vector>
+
+namespace rei {
+
+size_t record_in_parallel(Renderer* renderer, CommandList* cmd_list, size_t count, size_t grain,
+  const RecordRange& record, ThreadPool& pool) {
+  grain = (std::max<size_t>)(grain, 1);
+  const size_t range_num = (std::min)(pool.concurrency(), count / grain);
+  if (range_num <= 1) {
+    record(cmd_list, 0, count);
+    return 1;
+  }
+
+  // Lists are opened here, on the render thread; each range then records on its own
+  std::vector<CommandList*> lists(range_num);
+  for (CommandList*& list : lists)
+    list = renderer->open_command_list();
+  const size_t range_size = (count + range_num - 1) / range_num;
+  pool.run_chunks(range_num, [&](size_t range) {
+    const size_t begin = range * range_size;
+    const size_t end = (std::min)(count, begin + range_size);
+    if (begin < end) record(lists[range], begin, end);
+  });
+  renderer->submit(lists.data(), lists.size());
+  return range_num;
+}
+
+} // namespace rei
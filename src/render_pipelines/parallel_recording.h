@@ -0,0 +1,38 @@
+#ifndef REI_PARALLEL_RECORDING_H
+#define REI_PARALLEL_RECORDING_H
+
+#include <functional>
+
+#include "../parallel.h"
+#include "../renderer.h"
+
+/*
+ * render_pipelines/parallel_recording.h
+ * Recording a long run of commands, e.g. the draws of a geometry pass, on several threads.
+ */
+
+namespace rei {
+
+// record(list, begin, end) records items [begin, end) on `list`
+using RecordRange = std::function<void(CommandList*, size_t, size_t)>;
+
+/*
+ * Split items [0, count) into contiguous ranges of at least `grain` items, one per thread of
+ * `pool` at most, and record each on a list from renderer->open_command_list(). The lists are
+ * submitted in range order after the commands on `cmd_list`, so the result does not depend on
+ * how the threads were scheduled. A single range (or none) is recorded on `cmd_list` directly.
+ * Return the number of ranges.
+ *
+ * Ranges record on resources already in the states they need (see CommandList); a range
+ * beginning a render pass can tell the first range by `begin == 0`, e.g. to clear only there.
+ */
+size_t record_in_parallel(Renderer* renderer, CommandList* cmd_list, size_t count, size_t grain,
+  const RecordRange& record, ThreadPool& pool);
+inline size_t record_in_parallel(Renderer* renderer, CommandList* cmd_list, size_t count,
+  size_t grain, const RecordRange& record) {
+  return record_in_parallel(renderer, cmd_list, count, grain, record, global_thread_pool());
+}
+
+} // namespace rei
+
+#endif
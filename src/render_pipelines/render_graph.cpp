@@ -0,0 +1,310 @@
+// source of render_graph.h
+#include "render_graph.h"
+
+#include <algorithm>
+
+namespace rei {
+
+namespace {
+
+// Textures of the same size and format can back each other; flags are merged
+bool can_alias(const TextureDesc& a, const TextureDesc& b) {
+  return a.width == b.width && a.height == b.height && a.format == b.format
+         && a.flags.allow_depth_stencil == b.flags.allow_depth_stencil;
+}
+
+} // namespace
+
+RenderGraph::TextureID RenderGraph::create_texture(const TextureDesc& desc, Name name) {
+  REI_ASSERT(!m_compiled);
+  Texture texture {};
+  texture.name = name;
+  texture.desc = desc;
+  texture.imported = false;
+  texture.exit_state = ResourceState::Undefined;
+  m_textures.push_back(texture);
+  return TextureID(m_textures.size() - 1);
+}
+
+RenderGraph::TextureID RenderGraph::import_texture(Name name, ResourceState exit_state) {
+  REI_ASSERT(!m_compiled);
+  Texture texture {};
+  texture.name = name;
+  texture.imported = true;
+  texture.exit_state = exit_state;
+  m_textures.push_back(texture);
+  return TextureID(m_textures.size() - 1);
+}
+
+RenderGraph::PassID RenderGraph::add_pass(Name name, bool debug_view) {
+  REI_ASSERT(!m_compiled);
+  Pass pass {};
+  pass.name = name;
+  pass.debug_view = debug_view;
+  m_passes.push_back(pass);
+  return PassID(m_passes.size() - 1);
+}
+
+void RenderGraph::read(PassID pass, TextureID texture, ResourceState state) {
+  REI_ASSERT(!m_compiled && pass < m_passes.size() && texture < m_textures.size());
+  m_passes[pass].accesses.push_back({texture, state, false});
+}
+
+void RenderGraph::write(PassID pass, TextureID texture, ResourceState state) {
+  REI_ASSERT(!m_compiled && pass < m_passes.size() && texture < m_textures.size());
+  m_passes[pass].accesses.push_back({texture, state, true});
+}
+
+bool RenderGraph::compile(const CompileOptions& options) {
+  REI_ASSERT(!m_compiled);
+
+  // A texture is used in one state per pass
+  for (const Pass& pass : m_passes) {
+    for (const Access& a : pass.accesses) {
+      for (const Access& b : pass.accesses) {
+        if (a.texture == b.texture && a.state != b.state) {
+          REI_WARNING(L"RenderGraph: pass '" + pass.name.str() + L"' uses texture '"
+                      + m_textures[a.texture].name.str() + L"' in two states");
+          return false;
+        }
+      }
+    }
+  }
+
+  cull(options);
+
+  // Live ranges; a transient texture must be written before anything reads it
+  for (PassID p = 0; p < m_passes.size(); p++) {
+    const Pass& pass = m_passes[p];
+    if (pass.culled) continue;
+    for (const Access& access : pass.accesses) {
+      Texture& texture = m_textures[access.texture];
+      if (texture.first_use == c_none) {
+        const bool written = std::any_of(pass.accesses.begin(), pass.accesses.end(),
+          [&](const Access& a) { return a.texture == access.texture && a.write; });
+        const bool read = std::any_of(pass.accesses.begin(), pass.accesses.end(),
+          [&](const Access& a) { return a.texture == access.texture && !a.write; });
+        if (!texture.imported && (read || !written)) {
+          REI_WARNING(L"RenderGraph: texture '" + texture.name.str() + L"' is read by pass '"
+                      + pass.name.str() + L"' before any pass writes it");
+          return false;
+        }
+        texture.first_use = p;
+      }
+      texture.last_use = p;
+    }
+  }
+
+  assign_physicals();
+  plan_split_transitions();
+
+  m_report = {};
+  m_report.pass_count = m_passes.size();
+  for (const Pass& pass : m_passes)
+    m_report.culled_pass_count += pass.culled;
+  for (const Texture& texture : m_textures) {
+    if (texture.imported || texture.first_use == c_none) continue;
+    m_report.transient_count++;
+    m_report.transient_bytes += texture.desc.bytes();
+  }
+  for (const Physical& physical : m_physicals) {
+    if (physical.imported) continue;
+    m_report.physical_count++;
+    m_report.physical_bytes += physical.desc.bytes();
+  }
+  for (const Pass& pass : m_passes)
+    m_report.split_transition_count += pass.split_hints.size();
+  for (PassID p = 0; p < m_passes.size(); p++) {
+    if (m_passes[p].culled) continue;
+    size_t live_bytes = 0;
+    for (const Texture& texture : m_textures) {
+      if (texture.imported || texture.first_use == c_none) continue;
+      if (texture.first_use <= p && p <= texture.last_use) live_bytes += texture.desc.bytes();
+    }
+    m_report.peak_live_bytes = (std::max)(m_report.peak_live_bytes, live_bytes);
+  }
+
+  m_compiled = true;
+  return true;
+}
+
+void RenderGraph::cull(const CompileOptions& options) {
+  // Walk backward, keeping the passes that write a texture some kept pass reads later, or an
+  // imported one; reading a texture then makes its earlier writer needed
+  std::vector<bool> needed(m_textures.size(), false);
+  for (size_t i = m_passes.size(); i-- > 0;) {
+    Pass& pass = m_passes[i];
+    pass.culled = true;
+    if (pass.debug_view && !options.debug_views) continue;
+    for (const Access& access : pass.accesses) {
+      if (access.write && (needed[access.texture] || m_textures[access.texture].imported)) {
+        pass.culled = false;
+        break;
+      }
+    }
+    if (pass.culled) continue;
+    for (const Access& access : pass.accesses)
+      if (access.write) needed[access.texture] = false;
+    for (const Access& access : pass.accesses)
+      if (!access.write) needed[access.texture] = true;
+  }
+}
+
+void RenderGraph::assign_physicals() {
+  std::vector<TextureID> order;
+  for (TextureID t = 0; t < m_textures.size(); t++) {
+    Texture& texture = m_textures[t];
+    if (texture.imported) {
+      Physical physical {};
+      physical.imported = true;
+      texture.physical = TextureID(m_physicals.size());
+      m_physicals.push_back(physical);
+    } else if (texture.first_use != c_none) {
+      order.push_back(t);
+    }
+  }
+  std::stable_sort(order.begin(), order.end(),
+    [&](TextureID a, TextureID b) { return m_textures[a].first_use < m_textures[b].first_use; });
+
+  // Greedy interval assignment: reuse the first compatible physical texture free by then
+  for (TextureID t : order) {
+    Texture& texture = m_textures[t];
+    TextureID chosen = c_none;
+    for (TextureID p = 0; p < m_physicals.size(); p++) {
+      const Physical& physical = m_physicals[p];
+      if (!physical.imported && physical.last_use < texture.first_use
+          && can_alias(physical.desc, texture.desc)) {
+        chosen = p;
+        break;
+      }
+    }
+    if (chosen == c_none) {
+      Physical physical {};
+      physical.desc = texture.desc;
+      physical.name = texture.name;
+      for (const Access& access : m_passes[texture.first_use].accesses)
+        if (access.texture == t) physical.state = access.state;
+      chosen = TextureID(m_physicals.size());
+      m_physicals.push_back(physical);
+    } else {
+      Physical& physical = m_physicals[chosen];
+      physical.desc.flags.allow_render_target |= texture.desc.flags.allow_render_target;
+      physical.desc.flags.allow_unordered_access |= texture.desc.flags.allow_unordered_access;
+      physical.name = Name(physical.name.str() + L" | " + texture.name.str());
+    }
+    m_physicals[chosen].last_use = texture.last_use;
+    texture.physical = chosen;
+  }
+}
+
+void RenderGraph::plan_split_transitions() {
+  auto next_kept_pass = [&](PassID p) {
+    do {
+      p++;
+    } while (p < m_passes.size() && m_passes[p].culled);
+    return p;
+  };
+  // Between two uses of a physical texture, begin the transition to the later use's state with
+  // the first pass after the earlier use, if that is not already the later one
+  std::vector<PassID> last_use(m_physicals.size(), c_none);
+  for (PassID p = 0; p < m_passes.size(); p++) {
+    if (m_passes[p].culled) continue;
+    for (const Access& access : m_passes[p].accesses) {
+      const TextureID physical = m_textures[access.texture].physical;
+      const PassID prev = last_use[physical];
+      last_use[physical] = p;
+      if (prev == c_none || prev == p) continue;
+      const PassID begin = next_kept_pass(prev);
+      if (begin < p) m_passes[begin].split_hints.push_back({physical, access.state});
+    }
+  }
+  // Likewise toward the exit state of an imported texture
+  for (const Texture& texture : m_textures) {
+    if (!texture.imported || texture.exit_state == ResourceState::Undefined) continue;
+    const PassID prev = last_use[texture.physical];
+    if (prev == c_none) continue;
+    const PassID begin = next_kept_pass(prev);
+    if (begin < m_passes.size())
+      m_passes[begin].split_hints.push_back({texture.physical, texture.exit_state});
+  }
+}
+
+void RenderGraph::realize(Renderer* renderer) {
+  REI_ASSERT(m_compiled && renderer);
+  for (Physical& physical : m_physicals) {
+    if (physical.imported || physical.buffer) continue;
+    physical.buffer = renderer->create_texture_2d(physical.desc, physical.state, physical.name);
+  }
+}
+
+BufferHandle RenderGraph::texture(TextureID texture) const {
+  REI_ASSERT(m_compiled && texture < m_textures.size());
+  const TextureID physical = m_textures[texture].physical;
+  if (physical == c_none) return c_empty_handle; // only used by culled passes
+  return m_physicals[physical].buffer;
+}
+
+void RenderGraph::bind_import(TextureID texture, BufferHandle buffer) {
+  REI_ASSERT(m_compiled && m_textures[texture].imported);
+  Physical& physical = m_physicals[m_textures[texture].physical];
+  if (physical.buffer == buffer) return;
+  physical.buffer = buffer;
+  // Unknown state; the first access transitions, and the renderer skips it if redundant
+  physical.state = ResourceState::Undefined;
+  physical.pending_uav_write = false;
+}
+
+bool RenderGraph::begin_pass(CommandList* cmd_list, PassID pass_id) {
+  REI_ASSERT(m_compiled && pass_id < m_passes.size());
+  REI_ASSERT(pass_id >= m_next_pass); // passes run in the order they were added
+  m_next_pass = pass_id + 1;
+  const Pass& pass = m_passes[pass_id];
+  if (pass.culled) return false;
+
+  for (const SplitHint& hint : pass.split_hints) {
+    const Physical& physical = m_physicals[hint.physical];
+    // Skipped for an import in an unknown state, or one a transition() already moved
+    if (physical.state == ResourceState::Undefined || physical.state == hint.state) continue;
+    cmd_list->begin_transition(physical.buffer, hint.state);
+  }
+  for (const Access& access : pass.accesses) {
+    Physical& physical = m_physicals[m_textures[access.texture].physical];
+    REI_ASSERT(physical.buffer);
+    if (physical.state != access.state) {
+      cmd_list->transition(physical.buffer, access.state);
+      physical.state = access.state;
+      physical.pending_uav_write = false;
+    } else if (physical.pending_uav_write) {
+      // UAV writes of the previous pass must finish before this one touches the texture
+      cmd_list->barrier(physical.buffer);
+      physical.pending_uav_write = false;
+    }
+  }
+  for (const Access& access : pass.accesses) {
+    if (access.write && access.state == ResourceState::UnorderedAccess)
+      m_physicals[m_textures[access.texture].physical].pending_uav_write = true;
+  }
+  return true;
+}
+
+void RenderGraph::transition(CommandList* cmd_list, TextureID texture, ResourceState state) {
+  Physical& physical = m_physicals[m_textures[texture].physical];
+  if (physical.state != state) {
+    cmd_list->transition(physical.buffer, state);
+    physical.state = state;
+  }
+  physical.pending_uav_write = state == ResourceState::UnorderedAccess;
+}
+
+void RenderGraph::end_frame(CommandList* cmd_list) {
+  for (const Texture& texture : m_textures) {
+    if (!texture.imported || texture.exit_state == ResourceState::Undefined) continue;
+    Physical& physical = m_physicals[texture.physical];
+    if (!physical.buffer || physical.state == texture.exit_state) continue;
+    cmd_list->transition(physical.buffer, texture.exit_state);
+    physical.state = texture.exit_state;
+  }
+  m_next_pass = 0;
+}
+
+} // namespace rei
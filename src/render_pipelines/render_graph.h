@@ -0,0 +1,142 @@
+#ifndef REI_RENDER_GRAPH_H
+#define REI_RENDER_GRAPH_H
+
+#include <cstdint>
+#include <vector>
+
+#include "../renderer.h"
+
+/*
+ * render_pipelines/render_graph.h
+ * Passes declaring the textures they read and write, from which the per-frame texture lifetimes,
+ * aliasing and state transitions are derived.
+ */
+
+namespace rei {
+
+/*
+ * Passes run in the order they are added. compile() culls the passes whose results nothing
+ * reads, computes the lifetime of every transient texture, and lets compatible textures with
+ * disjoint lifetimes share one physical texture. Compiling touches no renderer, so a schedule
+ * can be checked headless; realize() then creates the physical textures.
+ *
+ * At execution, begin_pass() issues the transitions (and UAV barriers) a pass needs before it
+ * records. A texture left idle for a pass or more has its next transition begun early, as a
+ * split barrier the renderer may overlap with the passes in between. Transient textures hold
+ * nothing across frames, and a pass reading one must be preceded by a pass writing it. Imported
+ * textures (swapchain buffers, history buffers) are bound per frame and never aliased.
+ */
+class RenderGraph {
+public:
+  using TextureID = std::uint32_t;
+  using PassID = std::uint32_t;
+
+  struct CompileOptions {
+    // Keep the passes added as debug views; they are culled otherwise
+    bool debug_views = false;
+  };
+
+  struct Report {
+    size_t pass_count = 0;
+    size_t culled_pass_count = 0;
+    size_t transient_count = 0;
+    size_t physical_count = 0;
+    // Transient textures all resident, as without aliasing
+    size_t transient_bytes = 0;
+    // Physical textures backing them after aliasing
+    size_t physical_bytes = 0;
+    // Most bytes live during any one pass; what a perfect aliasing would allocate
+    size_t peak_live_bytes = 0;
+    // Transitions begun at least a pass before the texture is used again
+    size_t split_transition_count = 0;
+  };
+
+  TextureID create_texture(const TextureDesc& desc, Name name);
+  // Leave the texture in `exit_state` after each frame; Undefined to leave it as it is
+  TextureID import_texture(Name name, ResourceState exit_state = ResourceState::Undefined);
+
+  PassID add_pass(Name name, bool debug_view = false);
+  void read(PassID pass, TextureID texture, ResourceState state);
+  void write(PassID pass, TextureID texture, ResourceState state);
+  // Accumulate into a texture: it is read as well, so the writer before is kept
+  void read_write(PassID pass, TextureID texture) {
+    read(pass, texture, ResourceState::UnorderedAccess);
+    write(pass, texture, ResourceState::UnorderedAccess);
+  }
+
+  bool compile() { return compile(CompileOptions()); }
+  bool compile(const CompileOptions& options);
+  void realize(Renderer* renderer);
+
+  bool compiled() const { return m_compiled; }
+  bool is_culled(PassID pass) const { return m_passes[pass].culled; }
+  // Physical textures of transient textures sharing memory are the same
+  TextureID physical(TextureID texture) const { return m_textures[texture].physical; }
+  BufferHandle texture(TextureID texture) const;
+  const Report& report() const { return m_report; }
+
+  // Execution, once per frame, passes in order
+
+  void bind_import(TextureID texture, BufferHandle buffer);
+  // Return false if the pass is culled; skip recording it then
+  bool begin_pass(CommandList* cmd_list, PassID pass);
+  // Transition within a pass, e.g. between two of its dispatches
+  void transition(CommandList* cmd_list, TextureID texture, ResourceState state);
+  void end_frame(CommandList* cmd_list);
+
+private:
+  static constexpr std::uint32_t c_none = std::uint32_t(-1);
+
+  struct Access {
+    TextureID texture;
+    ResourceState state;
+    bool write;
+  };
+  struct SplitHint {
+    TextureID physical;
+    ResourceState state;
+  };
+  struct Pass {
+    Name name;
+    bool debug_view;
+    bool culled = false;
+    std::vector<Access> accesses;
+    // Transitions to begin with this pass, for textures it does not use
+    std::vector<SplitHint> split_hints;
+  };
+  struct Texture {
+    Name name;
+    TextureDesc desc;
+    bool imported;
+    ResourceState exit_state;
+    // Live range in passes, culled ones excluded
+    PassID first_use = c_none;
+    PassID last_use = c_none;
+    TextureID physical = c_none;
+  };
+  struct Physical {
+    Name name;
+    TextureDesc desc;
+    bool imported = false;
+    PassID last_use = c_none;
+    BufferHandle buffer;
+    // Tracked while executing; Undefined for an import until its first access in the frame
+    ResourceState state = ResourceState::Undefined;
+    bool pending_uav_write = false;
+  };
+
+  std::vector<Pass> m_passes;
+  std::vector<Texture> m_textures;
+  std::vector<Physical> m_physicals;
+  Report m_report;
+  bool m_compiled = false;
+  PassID m_next_pass = 0;
+
+  void cull(const CompileOptions& options);
+  void assign_physicals();
+  void plan_split_transitions();
+};
+
+} // namespace rei
+
+#endif
@@ -16,6 +16,9 @@ struct ViewportConfig {
 
 struct SceneConfig {
   const Scene* scene;
+  // Bytes of new geometry uploaded per sync_scene, to keep frame time flat while a scene streams
+  // in; 0 for no limit. The models present at registration are always uploaded at once.
+  size_t geometry_upload_budget = 0;
 };
 
 class RenderPipeline {
@@ -35,6 +38,13 @@ public:
 
   virtual void add_model(SceneHandle scene, const Model& model, Scene::ModelUID model_id) = 0;
   virtual void update_model(SceneHandle scene, const Model& model, Scene::ModelUID model_id) = 0;
+  virtual void remove_model(SceneHandle scene, Scene::ModelUID model_id) = 0;
+  // Pull what changed in the scene since the last call. By default every model is pushed through
+  // update_model; pipelines tracking scene versions only visit changed models.
+  virtual void sync_scene(SceneHandle scene_handle, const Scene& scene) {
+    for (const ModelPtr& model : scene.get_models())
+      update_model(scene_handle, *model, scene.get_id(model));
+  }
 
   virtual void render(ViewportHandle viewport, SceneHandle scene) = 0;
 };
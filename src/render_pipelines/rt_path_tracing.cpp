@@ -2,7 +2,7 @@
 
 #include <vector>
 
-#include "../direct3d/d3d_renderer.h"
+#include "scene_residency.h"
 
 using std::make_shared;
 using std::make_unique;
@@ -54,17 +54,32 @@ struct ViewportData {
 struct SceneData {
   // Raytracing resources
   BufferHandle tlas_buffer;
+  bool tlas_dirty = true;
   BufferHandle shader_table;
-  Hashmap<Scene::ModelUID, GeometryBuffers> geometry_buffers;
-  // NOTE: index by instance id
+  size_t shader_table_capacity = 0;
+  GeometryCache<Renderer> geometries;
+
+  struct ModelData {
+    Scene::GeometryUID geometry;
+    ModelHandle handle;
+    SlotAllocator::Slot instance_id;
+    Mat4 trans;
+  };
+  Hashmap<Scene::ModelUID, ModelData> models;
+  SceneChangeTracker tracker;
+  UploadThrottle uploads;
+
+  // NOTE: index by instance id; only the dirty ones are written to the shader table
+  SlotAllocator instance_ids;
   std::vector<ShaderArgumentHandle> shader_table_args;
+  std::vector<SlotAllocator::Slot> dirty_records;
 };
 } // namespace rtpt
 
 using namespace rtpt;
 
 RealtimePathTracingPipeline::RealtimePathTracingPipeline(RendererPtr renderer_wptr)
-    : SimplexPipeline(std::dynamic_pointer_cast<d3d::Renderer>(renderer_wptr.lock())) {
+    : SimplexPipeline(renderer_wptr) {
   auto renderer = m_renderer.lock();
   std::wstring shader_path = L"CoreData/shader/raytracing.hlsl";
   pathtracing_shader
@@ -112,45 +127,139 @@ void RealtimePathTracingPipeline::transform_viewport(ViewportHandle handle, cons
 
 RealtimePathTracingPipeline::SceneHandle RealtimePathTracingPipeline::register_scene(
   SceneConfig conf) {
-  auto renderer = get_renderer();
+  Renderer* renderer = get_renderer();
+  REI_ASSERT(renderer);
   auto scene = make_shared<SceneData>();
+  scene->shader_table_capacity = grown_capacity(0, conf.scene->get_models().size());
+  scene->shader_table
+    = renderer->create_shader_table(scene->shader_table_capacity, pathtracing_shader);
+  scene->uploads.budget = conf.geometry_upload_budget;
+  for (auto& m : conf.scene->get_models()) {
+    if (dynamic_cast<const PendingGeometry*>(m->get_geometry().get())) continue;
+    register_model(*scene, *m, conf.scene->get_id(m));
+  }
+  scene->tracker.synced_to(conf.scene->version());
 
-  // create mesh buffesr
-  {
-    for (auto& g : conf.scene->geometries()) {
-      GeometryBuffers gb = renderer->create_geometry({g});
-      scene->geometry_buffers.insert({conf.scene->get_id(g), gb});
-    }
+  auto handle = SceneHandle(scene.get());
+  scenes.insert({handle, scene});
+  return handle;
+}
+
+void RealtimePathTracingPipeline::remove_viewport(ViewportHandle viewport) {
+  // The path tracing argument binds the output buffer of the viewport
+  pathtracing_argument = c_empty_handle;
+  viewports.erase(viewport);
+}
+
+void RealtimePathTracingPipeline::remove_scene(SceneHandle scene) {
+  pathtracing_argument = c_empty_handle;
+  scenes.erase(scene);
+}
+
+void RealtimePathTracingPipeline::add_model(
+  SceneHandle scene_handle, const Model& model, Scene::ModelUID model_id) {
+  SceneData* scene = get_scene(scene_handle);
+  REI_ASSERT(scene);
+  if (scene->models.has(model_id)) {
+    update_model(scene_handle, model, model_id);
+    return;
   }
+  register_model(*scene, model, model_id);
+}
 
-  // create shader table arguments
-  {
-    ShaderArgumentValue arg_val {};
-    for (auto& m : conf.scene->get_models()) {
-      auto* geo = scene->geometry_buffers.try_get(conf.scene->get_id(m->get_geometry()));
-      arg_val.shader_resources = {geo->index_buffer, geo->vertex_buffer};
-      ShaderArgumentHandle h = renderer->create_shader_argument(arg_val);
-      scene->shader_table_args.emplace_back(std::move(h));
-    }
+void RealtimePathTracingPipeline::update_model(
+  SceneHandle scene_handle, const Model& model, Scene::ModelUID model_id) {
+  SceneData* scene = get_scene(scene_handle);
+  REI_ASSERT(scene);
+  SceneData::ModelData* data = scene->models.try_get(model_id);
+  if (!data) return; // not registered
+  if (data->geometry != Scene::GeometryUID(model.get_geometry().get())) {
+    unregister_model(*scene, model_id);
+    register_model(*scene, model, model_id);
+    return;
   }
+  data->trans = model.get_transform();
+  scene->tlas_dirty = true;
+}
 
-  // We need Top-Level Acceleration Structure and shader table, about the whole scene
-  {
-    RaytraceSceneDesc desc;
-    size_t inst_id_next = 0;
-    for (auto& m : conf.scene->get_models()) {
-      auto* geo = scene->geometry_buffers.try_get(conf.scene->get_id(m->get_geometry()));
-      desc.blas_buffer.push_back(geo->blas_buffer);
-      desc.transform.push_back(m->get_transform());
-      desc.instance_id.push_back(inst_id_next++);
+void RealtimePathTracingPipeline::remove_model(SceneHandle scene_handle, Scene::ModelUID model_id) {
+  SceneData* scene = get_scene(scene_handle);
+  REI_ASSERT(scene);
+  if (scene->models.has(model_id)) unregister_model(*scene, model_id);
+}
+
+void RealtimePathTracingPipeline::sync_scene(SceneHandle scene_handle, const Scene& scene) {
+  SceneData* data = get_scene(scene_handle);
+  REI_ASSERT(data);
+  sync_with_budget(
+    scene, data->tracker, data->uploads,
+    [&](Scene::GeometryUID geometry) { return data->geometries.resident(geometry); },
+    [&](Scene::ModelUID id) { remove_model(scene_handle, id); },
+    [&](const Model& model, Scene::ModelUID id) { add_model(scene_handle, model, id); });
+
+  // Edited geometries get new buffers, hence new BLAS and hit group arguments
+  Renderer* renderer = get_renderer();
+  data->geometries.refresh(*renderer, [&](Scene::GeometryUID geometry) {
+    const GeometryBuffers& geo = *data->geometries.get(geometry);
+    ShaderArgumentValue arg_val {};
+    arg_val.shader_resources = {geo.index_buffer, geo.vertex_buffer};
+    for (const auto& kv : data->models) {
+      if (kv.second.geometry != geometry) continue;
+      data->shader_table_args[kv.second.instance_id] = renderer->create_shader_argument(arg_val);
+      data->dirty_records.push_back(kv.second.instance_id);
     }
-    scene->tlas_buffer = renderer->create_raytracing_accel_struct(std::move(desc));
+    data->tlas_dirty = true;
+  });
+}
+
+void RealtimePathTracingPipeline::register_model(
+  SceneData& scene, const Model& model, Scene::ModelUID model_id) {
+  Renderer* renderer = get_renderer();
+  REI_ASSERT(renderer);
+  const GeometryPtr& geometry = model.get_geometry();
+  REI_ASSERT(geometry);
+
+  SceneData::ModelData data {};
+  data.geometry = Scene::GeometryUID(geometry.get());
+  data.handle = model.handle();
+  data.instance_id = scene.instance_ids.allocate();
+  data.trans = model.get_transform();
+
+  // Hit group arguments: the shared mesh buffers
+  const GeometryBuffers& geo = scene.geometries.acquire(*renderer, geometry);
+  ShaderArgumentValue arg_val {};
+  arg_val.shader_resources = {geo.index_buffer, geo.vertex_buffer};
+  if (data.instance_id >= scene.shader_table_args.size())
+    scene.shader_table_args.resize(data.instance_id + 1);
+  scene.shader_table_args[data.instance_id] = renderer->create_shader_argument(arg_val);
+  scene.dirty_records.push_back(data.instance_id);
+
+  // Grow the shader table; all records are written again
+  if (scene.instance_ids.end() > scene.shader_table_capacity) {
+    scene.shader_table_capacity
+      = grown_capacity(scene.shader_table_capacity, scene.instance_ids.end());
+    scene.shader_table
+      = renderer->create_shader_table(scene.shader_table_capacity, pathtracing_shader);
+    scene.dirty_records.clear();
+    for (const auto& kv : scene.models)
+      scene.dirty_records.push_back(kv.second.instance_id);
+    scene.dirty_records.push_back(data.instance_id);
   }
-  scene->shader_table = renderer->create_shader_table(*conf.scene, pathtracing_shader);
 
-  auto handle = SceneHandle(scene.get());
-  scenes.insert({handle, scene});
-  return handle;
+  scene.models.insert({model_id, data});
+  scene.tracker.track(data.handle, model_id);
+  scene.tlas_dirty = true;
+}
+
+void RealtimePathTracingPipeline::unregister_model(SceneData& scene, Scene::ModelUID model_id) {
+  const SceneData::ModelData* data = scene.models.try_get(model_id);
+  REI_ASSERT(data);
+  scene.shader_table_args[data->instance_id] = c_empty_handle;
+  scene.instance_ids.free(data->instance_id);
+  scene.geometries.release(data->geometry);
+  scene.tracker.untrack(data->handle);
+  scene.models.erase(model_id);
+  scene.tlas_dirty = true;
 }
 
 void RealtimePathTracingPipeline::render(ViewportHandle viewport_handle, SceneHandle scene_handle) {
@@ -161,29 +270,44 @@ void RealtimePathTracingPipeline::render(ViewportHandle viewport_handle, SceneHa
   Renderer* renderer = get_renderer();
   REI_ASSERT(renderer);
 
-  // TODO abstract a command list object; currently just an alias
-  Renderer* cmd_list = renderer->prepare();
+  CommandList* cmd_list = renderer->prepare();
 
   // Update per-render buffer
   {
     BufferHandle per_render_buffer = viewport->per_render_buffer;
     if (viewport->camera_matrix_dirty) {
-      cmd_list->update_const_buffer(per_render_buffer, 0, 0, viewport->view_proj_matrix.inv());
-      cmd_list->update_const_buffer(per_render_buffer, 0, 1, viewport->camera_pos);
+      renderer->update_const_buffer(per_render_buffer, 0, 0, viewport->view_proj_matrix.inv());
+      renderer->update_const_buffer(per_render_buffer, 0, 1, viewport->camera_pos);
       viewport->camera_matrix_dirty = false;
     }
   }
 
+  // Rebuild Top-Level Acceleration Structure for the current instance set
+  if (scene->tlas_dirty) {
+    RaytraceSceneDesc desc;
+    for (const auto& kv : scene->models) {
+      const auto& m = kv.second;
+      desc.blas_buffer.push_back(scene->geometries.get(m.geometry)->blas_buffer);
+      desc.transform.push_back(m.trans);
+      desc.instance_id.push_back(m.instance_id);
+    }
+    scene->tlas_buffer = renderer->create_raytracing_accel_struct(std::move(desc));
+    scene->tlas_dirty = false;
+    pathtracing_argument = c_empty_handle; // binds the TLAS
+  }
+
   // Update shader Tables
   {
     UpdateShaderTable update = UpdateShaderTable::hitgroup();
     update.shader = pathtracing_shader;
     update.shader_table = scene->shader_table;
-    for (int index = 0; index < scene->shader_table_args.size(); index++) {
+    for (SlotAllocator::Slot index : scene->dirty_records) {
+      if (!scene->shader_table_args[index]) continue; // freed again
       update.index = index;
       update.arguments = {scene->shader_table_args[index]};
-      cmd_list->update_shader_table(update);
+      renderer->update_shader_table(update);
     }
+    scene->dirty_records.clear();
   }
 
   // Dispatch ray and write to raytracing output
@@ -16,39 +16,30 @@ struct ViewportData;
 struct SceneData;
 } // namespace rtpt
 
-// FIXME lazy
-namespace d3d {
-class Renderer;
-}
-
 class RealtimePathTracingPipeline
-    : public SimplexPipeline<rtpt::ViewportData, rtpt::SceneData, d3d::Renderer> {
-  // FIXME lazyness
-  using Renderer = d3d::Renderer;
-
+    : public SimplexPipeline<rtpt::ViewportData, rtpt::SceneData> {
 public:
   RealtimePathTracingPipeline(RendererPtr renderer);
 
   ViewportHandle register_viewport(ViewportConfig conf) override;
-  void remove_viewport(ViewportHandle viewport) override { /* TODO */
-  }
+  void remove_viewport(ViewportHandle viewport) override;
   void transform_viewport(ViewportHandle handle, const Camera& camera) override;
 
   SceneHandle register_scene(SceneConfig conf) override;
-  void remove_scene(SceneHandle scene) override { /* TODO */
-  }
-  void update_model(SceneHandle scene, const Model& model, Scene::ModelUID model_id) override {
-    REI_NOT_IMPLEMENTED
-  }
-  void add_model(SceneHandle scene, const Model& model, Scene::ModelUID model_id) override {
-    REI_NOT_IMPLEMENTED
-  }
+  void remove_scene(SceneHandle scene) override;
+  void update_model(SceneHandle scene, const Model& model, Scene::ModelUID model_id) override;
+  void add_model(SceneHandle scene, const Model& model, Scene::ModelUID model_id) override;
+  void remove_model(SceneHandle scene, Scene::ModelUID model_id) override;
+  void sync_scene(SceneHandle scene_handle, const Scene& scene) override;
 
   void render(ViewportHandle viewport, SceneHandle scene) override;
 
 protected:
   ShaderHandle pathtracing_shader;
   ShaderArgumentHandle pathtracing_argument;
+
+  void register_model(rtpt::SceneData& scene, const Model& model, Scene::ModelUID model_id);
+  void unregister_model(rtpt::SceneData& scene, Scene::ModelUID model_id);
 };
 
 } // namespace rei
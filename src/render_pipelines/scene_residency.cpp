@@ -0,0 +1,63 @@
+// source of scene_residency.h
+#include "scene_residency.h"
+
+#include <algorithm>
+
+namespace rei {
+
+SlotAllocator::Slot SlotAllocator::allocate() {
+  m_live++;
+  if (m_free.empty()) return m_end++;
+  const Slot slot = m_free.back();
+  m_free.pop_back();
+  return slot;
+}
+
+void SlotAllocator::free(Slot slot) {
+  REI_ASSERT(slot < m_end && m_live > 0);
+  m_free.push_back(slot);
+  m_live--;
+}
+
+void SlotAllocator::clear() {
+  m_free.clear();
+  m_end = 0;
+  m_live = 0;
+}
+
+bool LightMirror::sync(const LightStore& lights) {
+  size_t first, last;
+  lights.changed_range(m_synced, first, last);
+  const bool resized = lights.size() != m_packed.size();
+  m_synced = lights.version();
+  if (first == last && !resized) return false;
+
+  m_packed.resize(lights.size());
+  lights.pack(first, last, m_packed.data() + first);
+  // Removals only shrink the store; the light moved into the hole is in the changed range
+  if (first < last) {
+    if (!dirty()) {
+      m_dirty_first = first;
+      m_dirty_last = last;
+    } else {
+      m_dirty_first = (std::min)(m_dirty_first, first);
+      m_dirty_last = (std::max)(m_dirty_last, last);
+    }
+  }
+  m_dirty_last = (std::min)(m_dirty_last, m_packed.size());
+  if (m_dirty_first >= m_dirty_last) clear_dirty();
+  return true;
+}
+
+size_t upload_bytes(const Geometry& geometry) {
+  constexpr size_t vertex_bytes = sizeof(PackedMesh::Vertex);
+  constexpr size_t index_bytes = sizeof(PackedMesh::Index);
+  if (const Mesh* mesh = dynamic_cast<const Mesh*>(&geometry))
+    return mesh->get_vertices().size() * vertex_bytes
+           + mesh->get_triangles().size() * 3 * index_bytes;
+  if (const PackedMesh* packed = dynamic_cast<const PackedMesh*>(&geometry))
+    return packed->vertices_num() * vertex_bytes + packed->indices_num() * index_bytes;
+  return 0;
+}
+
+} // namespace rei
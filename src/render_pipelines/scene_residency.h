@@ -0,0 +1,302 @@
+#ifndef REI_SCENE_RESIDENCY_H
+#define REI_SCENE_RESIDENCY_H
+
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "../container_utils.h"
+#include "../scene.h"
+
+/*
+ * scene_residency.h
+ * CPU bookkeeping for the GPU copies of a scene, so that models can be added and removed
+ * without re-registering the scene. Nothing here touches a device.
+ */
+
+namespace rei {
+
+/*
+ * Fixed-size slots in a GPU buffer (const buffer elements, shader table records, TLAS instance
+ * ids). Freed slots are reused before new ones are handed out, so end() only grows with the
+ * peak number of live slots.
+ */
+class SlotAllocator {
+public:
+  using Slot = std::uint32_t;
+
+  Slot allocate();
+  void free(Slot slot);
+  void clear();
+
+  size_t size() const { return m_live; }
+  // One past the highest slot handed out; a buffer needs this many elements
+  Slot end() const { return m_end; }
+
+private:
+  std::vector<Slot> m_free;
+  Slot m_end = 0;
+  size_t m_live = 0;
+};
+
+/*
+ * Reference-counted GPU buffers per geometry, shared by all models using it. Buffers are
+ * created on the first acquire and dropped with the last release, and created again by
+ * refresh() once the geometry is edited.
+ * Entries are keyed by address, so each one also watches its geometry: if that was freed while
+ * models not synced yet still hold references, a new geometry at the same address gets buffers
+ * of its own on acquire instead of the stale ones. The references left on the freed geometry are
+ * set apart as stale: releases drain them first, and only the rest count for the new geometry.
+ * TRenderer only needs create_geometry({GeometryPtr}), so a stand-in renderer can drive it
+ * without a device.
+ */
+template <typename TRenderer>
+class GeometryCache {
+public:
+  using Buffers = std::decay_t<decltype(
+    std::declval<TRenderer&>().create_geometry({std::declval<GeometryPtr>()}))>;
+
+  const Buffers& acquire(TRenderer& renderer, const GeometryPtr& geometry) {
+    Entry& entry = m_entries[Scene::GeometryUID(geometry.get())];
+    if (entry.refs > 0 && entry.geometry.lock() != geometry) {
+      entry.stale_refs += entry.refs;
+      entry.refs = 0;
+    }
+    if (entry.refs++ == 0) {
+      entry.buffers = renderer.create_geometry({geometry});
+      entry.geometry = geometry;
+      entry.version = geometry->version();
+    }
+    return entry.buffers;
+  }
+
+  // Upload again every geometry edited since its buffers were created, and tell
+  // refreshed(GeometryUID) about it. Returns at once while no geometry changed anywhere.
+  template <typename F>
+  size_t refresh(TRenderer& renderer, F refreshed) {
+    const Geometry::Version latest = Geometry::latest_version();
+    if (latest == m_refreshed) return 0;
+    m_refreshed = latest;
+    size_t count = 0;
+    for (auto& kv : m_entries) {
+      Entry& entry = kv.second;
+      GeometryPtr geometry = entry.geometry.lock();
+      if (!geometry || geometry->version() == entry.version) continue;
+      entry.buffers = renderer.create_geometry({geometry});
+      entry.version = geometry->version();
+      refreshed(Scene::GeometryUID(kv.first));
+      count++;
+    }
+    return count;
+  }
+
+  // Return true if it was the last reference
+  bool release(Scene::GeometryUID geometry) {
+    Entry* entry = m_entries.try_get(geometry);
+    REI_ASSERT(entry && entry->refs + entry->stale_refs > 0);
+    if (entry->stale_refs > 0) {
+      entry->stale_refs--;
+      return false;
+    }
+    if (--entry->refs > 0) return false;
+    m_entries.erase(geometry);
+    return true;
+  }
+
+  const Buffers* get(Scene::GeometryUID geometry) const {
+    const Entry* entry = m_entries.try_get(geometry);
+    return entry ? &entry->buffers : nullptr;
+  }
+  size_t refs(Scene::GeometryUID geometry) const {
+    const Entry* entry = m_entries.try_get(geometry);
+    return entry ? entry->refs : 0;
+  }
+  // True if the buffers are uploaded from the geometry now living at this address
+  bool resident(Scene::GeometryUID geometry) const {
+    const Entry* entry = m_entries.try_get(geometry);
+    return entry && !entry->geometry.expired();
+  }
+  size_t size() const { return m_entries.size(); }
+  void clear() { m_entries.clear(); }
+
+private:
+  struct Entry {
+    Buffers buffers;
+    std::weak_ptr<Geometry> geometry;
+    Geometry::Version version = 0;
+    size_t refs = 0;
+    size_t stale_refs = 0; // still held on a freed geometry which lived at this address
+  };
+  Hashmap<Scene::GeometryUID, Entry> m_entries;
+  Geometry::Version m_refreshed = 0;
+};
+
+/*
+ * Pulls model changes out of a scene for a pipeline keeping its own copy of the models.
+ * The pipeline calls track/untrack as it registers and drops models; sync() then reports what
+ * it has to do since the last sync, using the scene's change journal, or a full comparison when
+ * the journal no longer reaches back that far.
+ */
+class SceneChangeTracker {
+public:
+  void track(ModelHandle handle, Scene::ModelUID id) { m_ids.insert({handle, id}); }
+  void untrack(ModelHandle handle) { m_ids.erase(handle); }
+  size_t size() const { return m_ids.size(); }
+
+  // Changes before `version` are considered seen
+  void synced_to(Scene::Version version) { m_synced = version; }
+  Scene::Version synced_version() const { return m_synced; }
+
+  // Report dropped models by remove(ModelUID), then new or changed ones by
+  // upsert(const Model&, ModelUID). Removals go first since a new model may reuse the address,
+  // hence the UID, of a removed one.
+  template <typename FRemove, typename FUpsert>
+  void sync(const Scene& scene, FRemove remove, FUpsert upsert) {
+    if (scene.tracks_changes_since(m_synced)) {
+      scene.model_removals_since(m_synced, [&](ModelHandle handle) {
+        const Scene::ModelUID* id = m_ids.try_get(handle);
+        if (id) remove(Scene::ModelUID(*id));
+      });
+      scene.model_changes_since(m_synced, [&](ModelHandle handle) {
+        ModelPtr model = scene.get_model(handle);
+        upsert(*model, scene.get_id(model));
+      });
+    } else {
+      std::vector<Scene::ModelUID> gone;
+      for (const auto& kv : m_ids) {
+        ModelPtr model = scene.get_model(kv.first);
+        if (!model || scene.get_id(model) != kv.second) gone.push_back(kv.second);
+      }
+      for (Scene::ModelUID id : gone)
+        remove(id);
+      for (const ModelPtr& model : scene.get_models())
+        upsert(*model, scene.get_id(model));
+    }
+    m_synced = scene.version();
+  }
+
+private:
+  Hashmap<ModelHandle, Scene::ModelUID, ModelHandle::Hasher> m_ids;
+  Scene::Version m_synced = 0;
+};
+
+// Bytes uploaded for a geometry, in the renderer's vertex and index layout; 0 if it has no data
+size_t upload_bytes(const Geometry& geometry);
+
+/*
+ * Spreads geometry uploads over frames while a large scene streams in. Models whose geometry is
+ * not resident yet are admitted while the frame's byte budget lasts; the first one of a frame
+ * always is, so a mesh larger than the budget still goes through. The others are deferred and
+ * offered again, oldest first, on the next frame.
+ */
+class UploadThrottle {
+public:
+  // Bytes of new geometry per frame; 0 for no limit
+  size_t budget = 0;
+
+  void begin_frame() {
+    m_spent = 0;
+    m_admitted = 0;
+  }
+
+  // Return false if the model has to wait for a later frame; call defer() for it then
+  bool admit(const Geometry& geometry, bool resident) {
+    if (resident || budget == 0) return true;
+    const size_t bytes = upload_bytes(geometry);
+    if (m_admitted > 0 && m_spent + bytes > budget) return false;
+    m_spent += bytes;
+    m_admitted++;
+    return true;
+  }
+  void defer(ModelHandle handle) { m_deferred.push_back(handle); }
+
+  // Offer f(const Model&, ModelUID) the deferred models still in the scene
+  template <typename F>
+  void retry(const Scene& scene, F f) {
+    std::vector<ModelHandle> waiting;
+    waiting.swap(m_deferred);
+    for (ModelHandle handle : waiting) {
+      ModelPtr model = scene.get_model(handle);
+      if (model) f(*model, scene.get_id(model));
+    }
+  }
+
+  size_t deferred() const { return m_deferred.size(); }
+  size_t spent() const { return m_spent; }
+
+private:
+  std::vector<ModelHandle> m_deferred;
+  size_t m_spent = 0;
+  size_t m_admitted = 0;
+};
+
+/*
+ * SceneChangeTracker::sync for a pipeline uploading under `throttle`: models deferred on earlier
+ * frames are offered first, then the changes. Models with PendingGeometry are dropped (or never
+ * registered) until the scene reports their real geometry. `resident(GeometryUID)` tells if a
+ * geometry is uploaded already; remove(ModelUID) must accept models that are not registered.
+ */
+template <typename FResident, typename FRemove, typename FUpsert>
+void sync_with_budget(const Scene& scene, SceneChangeTracker& tracker, UploadThrottle& throttle,
+  FResident resident, FRemove remove, FUpsert upsert) {
+  throttle.begin_frame();
+  auto offer = [&](const Model& model, Scene::ModelUID id) {
+    const GeometryPtr& geometry = model.get_geometry();
+    if (dynamic_cast<const PendingGeometry*>(geometry.get())) {
+      remove(id);
+      return;
+    }
+    if (geometry && !throttle.admit(*geometry, resident(Scene::GeometryUID(geometry.get())))) {
+      throttle.defer(model.handle());
+      return;
+    }
+    upsert(model, id);
+  };
+  throttle.retry(scene, offer);
+  tracker.sync(scene, remove, offer);
+}
+
+/*
+ * A pipeline's packed copy of the scene lights, kept in step with a LightStore. sync() re-packs
+ * only the dense range changed since the last sync and widens the range waiting for upload, so
+ * the pipeline writes it to its light buffer with one copy per frame, or none.
+ */
+class LightMirror {
+public:
+  // Return true if any light changed, was added or was removed
+  bool sync(const LightStore& lights);
+  // Everything is uploaded again, e.g. into a new buffer
+  void mark_all_dirty() {
+    m_dirty_first = 0;
+    m_dirty_last = m_packed.size();
+  }
+
+  size_t size() const { return m_packed.size(); }
+  const PackedLight* data() const { return m_packed.data(); }
+
+  // Dense range [first, last) to upload; empty when the buffer is up to date
+  bool dirty() const { return m_dirty_first < m_dirty_last; }
+  size_t dirty_first() const { return m_dirty_first; }
+  size_t dirty_last() const { return m_dirty_last; }
+  void clear_dirty() { m_dirty_first = m_dirty_last = 0; }
+
+private:
+  std::vector<PackedLight> m_packed;
+  LightStore::Version m_synced = 0;
+  size_t m_dirty_first = 0;
+  size_t m_dirty_last = 0;
+};
+
+// Capacity to allocate for at least `required` elements, growing geometrically from `current`
+inline size_t grown_capacity(size_t current, size_t required) {
+  size_t capacity = (std::max<size_t>)(current, 16);
+  while (capacity < required)
+    capacity *= 2;
+  return capacity;
+}
+
+} // namespace rei
+
+#endif
@@ -4,4 +4,23 @@
 #include <iostream>
 #include <memory>
 
-namespace rei {} // namespace rei
+namespace rei {
+
+size_t TextureDesc::bytes() const {
+  size_t texel_bytes = 0;
+  switch (format) {
+    case ResourceFormat::R32G32B32A32_FLOAT:
+      texel_bytes = 16;
+      break;
+    case ResourceFormat::B8G8R8A8_UNORM:
+    case ResourceFormat::D24_UNORM_S8_UINT:
+      texel_bytes = 4;
+      break;
+    default:
+      REI_WARNING("Texture format without a known texel size");
+      break;
+  }
+  return width * height * texel_bytes;
+}
+
+} // namespace rei
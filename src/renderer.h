@@ -8,6 +8,8 @@
 #include <windows.h>
 #endif
 
+#include "common.h"
+
 #include "container_utils.h"
 #include "type_utils.h"
 
@@ -30,6 +32,10 @@ class Geometry;
 class Model;
 class Scene;
 
+#if !WIN32
+using HWND = void*; // no system windows; only offscreen viewports
+#endif
+
 struct SystemWindowID {
   enum Platform {
     Win,
@@ -148,6 +154,9 @@ struct RasterizationShaderMetaInfo {
   FixedVec<RenderTargetDesc, 8> render_target_descs {RenderTargetDesc()};
   bool is_depth_stencil_disabled = false;
   bool is_blending_addictive = false;
+  // Vertex shader also takes per-instance world and normal matrices (INSTANCE_WORLD,
+  // INSTANCE_NORMAL) from input slot 1
+  bool is_instanced = false;
 };
 
 struct ComputeShaderMetaInfo {
@@ -196,6 +205,9 @@ struct TextureDesc {
   static TextureDesc unorder_access(size_t width, size_t height, ResourceFormat format) {
     return {width, height, format, {false, false, true}};
   }
+
+  // Memory taken by the texels, ignoring alignment and padding
+  size_t bytes() const;
 };
 
 struct GeometryDesc {
@@ -227,7 +239,7 @@ struct UpdateShaderTable {
   size_t index;
   ShaderArguments arguments;
 
-  static UpdateShaderTable hitgroup() { return {TableType::Hitgroup}; }
+  static UpdateShaderTable hitgroup() { return {TableType::Hitgroup, {}, {}, 0, {}}; }
 };
 
 struct DrawCommand {
@@ -235,6 +247,10 @@ struct DrawCommand {
   BufferHandle index_buffer = c_empty_handle;
   ShaderHandle shader = c_empty_handle;
   ShaderArguments arguments;
+  // Per-instance data, read from element `instance_offset` onward (instanced shaders only)
+  BufferHandle instance_buffer = c_empty_handle;
+  uint32_t instance_offset = 0;
+  uint32_t instance_count = 1;
 };
 
 struct DispatchCommand {
@@ -290,6 +306,49 @@ struct RenderPassCommand {
   bool clear_ds;
 };
 
+/*
+ * Commands recorded for the GPU. The list from Renderer::prepare() takes every command. Lists
+ * from Renderer::open_command_list() record render passes, draws, dispatches and traces on
+ * resources already in the states they need; transitions, barriers, clears and copies go on the
+ * prepare() list before them.
+ */
+class CommandList : private NoCopy {
+public:
+  virtual ~CommandList() {}
+
+  virtual void begin_render_pass(const RenderPassCommand& cmd) = 0;
+  virtual void end_render_pass() = 0;
+
+  // Transitions are batched by the backend and issued before the next command using them
+  virtual void transition(BufferHandle buffer, ResourceState state) = 0;
+  virtual void barrier(BufferHandle buffer) = 0;
+  // Hint that `buffer` will be transitioned to `state` but is not used until then, so the
+  // backend may start the transition early (a split barrier); it still must be transitioned
+  virtual void begin_transition(BufferHandle /*buffer*/, ResourceState /*state*/) {}
+
+  virtual void draw(const DrawCommand& cmd) = 0;
+  virtual void dispatch(const DispatchCommand& dispatch) = 0;
+  virtual void raytrace(const RaytraceCommand& cmd) = 0;
+  void raytrace(ShaderHandle raytrace_shader, ShaderArguments arguments, BufferHandle shader_table,
+    size_t width, size_t height, size_t depth = 1) {
+    RaytraceCommand cmd {};
+    cmd.raytrace_shader = raytrace_shader;
+    cmd.arguments = std::move(arguments);
+    cmd.shader_table = std::move(shader_table);
+    cmd.width = uint32_t(width);
+    cmd.height = uint32_t(height);
+    cmd.depth = uint32_t(depth);
+    raytrace(cmd);
+  }
+
+  virtual void clear_texture(BufferHandle target, Vec4 clear_value, RenderArea clear_area) = 0;
+  virtual void copy_texture(BufferHandle src, BufferHandle dest, bool revert_state = true) = 0;
+};
+
+/*
+ * The backend interface pipelines record through. Resource creation and updates are immediate;
+ * commands go to the command lists, and are submitted by present().
+ */
 class Renderer : private NoCopy {
 public:
   Renderer() {}
@@ -297,6 +356,78 @@ public:
 
   virtual bool is_depth_range_01() const = 0;
 
+  virtual SwapchainHandle create_swapchain(
+    SystemWindowID window_id, size_t width, size_t height, size_t rendertarget_count) = 0;
+  virtual BufferHandle fetch_swapchain_render_target_buffer(SwapchainHandle swapchain) = 0;
+
+  virtual BufferHandle create_texture_2d(
+    const TextureDesc& desc, ResourceState init_state, Name debug_name) = 0;
+  [[deprecated]] BufferHandle create_texture_2d(
+    size_t width, size_t height, ResourceFormat format, Name debug_name) {
+    TextureDesc desc {width, height, format, {}};
+    return create_texture_2d(desc, ResourceState::Undefined, debug_name);
+  }
+  [[deprecated]] BufferHandle create_unordered_access_buffer_2d(size_t width, size_t height,
+    ResourceFormat format, Name debug_name = L"Unnamed UA Buffer") {
+    return create_texture_2d(TextureDesc::unorder_access(width, height, format),
+      ResourceState::UnorderedAccess, debug_name);
+  }
+
+  virtual BufferHandle create_const_buffer(const ConstBufferLayout& layout, size_t num,
+    Name debug_name = L"Unnamed ConstBuffer") = 0;
+  // Tightly packed const-buffer-like data, bound as per-instance vertex input
+  virtual BufferHandle create_instance_buffer(const ConstBufferLayout& layout, size_t num,
+    Name debug_name = L"Unnamed InstanceBuffer") = 0;
+  // Tightly packed elements, bound as a StructuredBuffer shader resource
+  virtual BufferHandle create_structured_buffer(const ConstBufferLayout& layout, size_t num,
+    Name debug_name = L"Unnamed StructuredBuffer") = 0;
+
+  virtual void update_const_buffer(BufferHandle buffer, size_t index, size_t member, Vec4 value)
+    = 0;
+  virtual void update_const_buffer(BufferHandle buffer, size_t index, size_t member, Mat4 value)
+    = 0;
+  // Write a whole element at once, e.g. a compiled ParameterBlock
+  virtual void update_const_buffer(
+    BufferHandle buffer, size_t index, const void* data, size_t bytes) = 0;
+  // Overwrite elements [first, first + count) of an instance or structured buffer
+  virtual void update_buffer_elements(
+    BufferHandle buffer, size_t first, const void* data, size_t count) = 0;
+
+  virtual ShaderHandle create_shader(const std::wstring& shader_path,
+    RasterizationShaderMetaInfo&& meta, const ShaderCompileConfig& config = {}) = 0;
+  virtual ShaderHandle create_shader(const std::wstring& shader_path,
+    ComputeShaderMetaInfo&& meta, const ShaderCompileConfig& config = {}) = 0;
+  virtual ShaderHandle create_shader(const std::wstring& shader_path,
+    RaytracingShaderMetaInfo&& meta, const ShaderCompileConfig& config = {}) = 0;
+  ShaderHandle create_shader(const std::wstring& shader_path,
+    std::unique_ptr<RasterizationShaderMetaInfo>&& meta, const ShaderCompileConfig& config = {}) {
+    return create_shader(shader_path, std::move(*meta), config);
+  }
+  ShaderHandle create_raytracing_shader(const std::wstring& shader_path,
+    std::unique_ptr<RaytracingShaderMetaInfo>&& meta, const ShaderCompileConfig& config = {}) {
+    return create_shader(shader_path, std::move(*meta), config);
+  }
+
+  virtual ShaderArgumentHandle create_shader_argument(ShaderArgumentValue arg_value) = 0;
+
+  virtual GeometryBuffers create_geometry(const GeometryDesc& geometry) = 0;
+  virtual BufferHandle create_raytracing_accel_struct(const RaytraceSceneDesc& scene) = 0;
+  virtual BufferHandle create_shader_table(
+    size_t intersection_count, ShaderHandle raytracing_shader) = 0;
+  virtual BufferHandle create_shader_table(const Scene& scene, ShaderHandle raytracing_shader)
+    = 0;
+  virtual void update_shader_table(const UpdateShaderTable& cmd) = 0;
+
+  // The render thread's command list for the frame
+  virtual CommandList* prepare() = 0;
+  // A list recording on its own, so several threads can record at once, one list each. Lists
+  // are pooled, and recycled once the frame is presented.
+  virtual CommandList* open_command_list() = 0;
+  // Run the lists in the order given, after the commands recorded so far on the prepare() list;
+  // what that list records later runs after them. The lists are closed.
+  virtual void submit(CommandList* const* lists, size_t count) = 0;
+  virtual void present(SwapchainHandle swapchain, bool vsync) = 0;
+
 protected:
   // Convert from handle to data
   template <typename Handle, typename Data>
@@ -309,6 +440,14 @@ protected:
     }
     return nullptr;
   }
+
+  // Like get_data, without taking a reference; for recording, which may run on several threads
+  // using the same handles at once
+  template <typename Data, typename Handle>
+  Data* peek_data(const Handle& handle) const {
+    if (handle && (handle->owner == this)) return static_cast<Data*>(handle.get());
+    return nullptr;
+  }
 };
 
 } // namespace rei
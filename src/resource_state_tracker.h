@@ -0,0 +1,180 @@
+#ifndef REI_RESOURCE_STATE_TRACKER_H
+#define REI_RESOURCE_STATE_TRACKER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/*
+ * resource_state_tracker.h
+ * Deferred and batched resource state transitions, shared by the renderer backends.
+ */
+
+namespace rei {
+
+// Bookkeeping of a ResourceStateTracker, kept in each resource next to its state
+template <typename TState>
+struct StateTracking {
+  static constexpr std::uint32_t c_none = std::uint32_t(-1);
+  // Entry of the current batch transitioning the resource, if any
+  std::uint32_t pending = c_none;
+  // A split transition has begun and not ended; the resource must not be used meanwhile
+  bool splitting = false;
+  TState split_before {};
+};
+
+/*
+ * Collects the transitions requested between two commands and hands them to the backend as one
+ * batch on flush(). `TRecord` is the backend's resource record, with a member `state` (TState,
+ * the state after all the transitions recorded so far) and a member `tracking`
+ * (StateTracking<TState>). Records must stay alive until the next flush.
+ *
+ * A transition to the state a resource is already in is dropped, two transitions of a resource
+ * in one batch become one, and a pair cancelling out becomes none. A UAV barrier is dropped if
+ * the resource already has one, or a transition, in the batch; should that transition cancel
+ * out, the UAV barrier is issued in its place.
+ *
+ * begin_split() starts a transition early, so the GPU can overlap it with the work recorded
+ * before the resource is used again; the next transition() of the resource ends it. If nothing
+ * was recorded in between, the split is turned back into a plain transition. A UAV barrier
+ * requested during a split is dropped, as the begin barrier already orders the writes before it.
+ */
+template <typename TRecord, typename TState>
+class ResourceStateTracker {
+public:
+  enum class BarrierKind : std::uint8_t {
+    Transition,
+    BeginOnly,
+    EndOnly,
+    UAV,
+  };
+
+  struct Barrier {
+    TRecord* record;
+    TState before;
+    TState after;
+    BarrierKind kind;
+    bool folded_uav = false; // a Transition standing in for a UAV barrier too
+  };
+
+  struct Stats {
+    std::size_t transitions = 0; // requested through transition()
+    std::size_t uav_barriers = 0; // requested through uav_barrier()
+    std::size_t elided = 0; // requests issuing no barrier of their own
+    std::size_t barriers = 0; // issued, of all kinds
+    std::size_t batches = 0; // flushes issuing any barrier
+    std::size_t split_transitions = 0; // begun with begin_split() and issued as split barriers
+  };
+
+  void transition(TRecord& record, TState to) {
+    m_stats.transitions++;
+    StateTracking<TState>& tracking = record.tracking;
+    if (tracking.splitting) {
+      tracking.splitting = false;
+      if (tracking.pending != c_none) {
+        // Begun and ended within one batch; nothing to overlap
+        m_batch[tracking.pending].kind = BarrierKind::Transition;
+        m_split_begins--;
+        if (record.state == to) return;
+      } else {
+        m_batch.push_back({&record, tracking.split_before, record.state, BarrierKind::EndOnly});
+        if (record.state == to) return;
+      }
+    }
+    if (tracking.pending != c_none) {
+      // Merge with the transition already batched; the pair may cancel out
+      Barrier& barrier = m_batch[tracking.pending];
+      barrier.after = to;
+      record.state = to;
+      m_stats.elided++;
+      return;
+    }
+    if (record.state == to) {
+      m_stats.elided++;
+      return;
+    }
+    tracking.pending = std::uint32_t(m_batch.size());
+    m_batch.push_back({&record, record.state, to, BarrierKind::Transition});
+    record.state = to;
+  }
+
+  // Hint that the resource will be transitioned to `to` later; ignored if it is already there,
+  // or has a transition batched
+  void begin_split(TRecord& record, TState to) {
+    StateTracking<TState>& tracking = record.tracking;
+    if (record.state == to || tracking.splitting || tracking.pending != c_none) return;
+    tracking.splitting = true;
+    tracking.split_before = record.state;
+    tracking.pending = std::uint32_t(m_batch.size());
+    m_batch.push_back({&record, record.state, to, BarrierKind::BeginOnly});
+    record.state = to;
+    m_split_begins++;
+  }
+
+  void uav_barrier(TRecord& record) {
+    m_stats.uav_barriers++;
+    StateTracking<TState>& tracking = record.tracking;
+    if (tracking.splitting) {
+      // No barrier may touch the resource before the split ends; should it end in this batch
+      // and cancel out, the UAV barrier is issued then
+      if (tracking.pending != c_none) m_batch[tracking.pending].folded_uav = true;
+      m_stats.elided++;
+      return;
+    }
+    for (Barrier& barrier : m_batch) {
+      if (barrier.record == &record
+          && (barrier.kind == BarrierKind::UAV || barrier.kind == BarrierKind::Transition)) {
+        if (barrier.kind == BarrierKind::Transition) barrier.folded_uav = true;
+        m_stats.elided++;
+        return;
+      }
+    }
+    m_batch.push_back({&record, record.state, record.state, BarrierKind::UAV});
+  }
+
+  bool has_pending() const { return !m_batch.empty(); }
+
+  // Issue the batch through `emit(const Barrier* barriers, std::size_t count)`, once, unless it
+  // is empty after the cancelled transitions are dropped
+  template <typename Emit>
+  void flush(Emit&& emit) {
+    if (m_batch.empty()) return;
+    std::size_t count = 0;
+    for (Barrier& barrier : m_batch) {
+      barrier.record->tracking.pending = c_none;
+      if (barrier.kind == BarrierKind::Transition && barrier.before == barrier.after) {
+        if (!barrier.folded_uav) {
+          m_stats.elided++; // the request which started it
+          continue;
+        }
+        // The UAV barrier it stood in for is still needed: the transition request is elided
+        // instead of the UAV one, so the count stays
+        barrier.kind = BarrierKind::UAV;
+        barrier.folded_uav = false;
+      }
+      m_batch[count++] = barrier;
+    }
+    m_stats.split_transitions += m_split_begins;
+    m_split_begins = 0;
+    if (count > 0) {
+      emit(m_batch.data(), count);
+      m_stats.barriers += count;
+      m_stats.batches++;
+    }
+    m_batch.clear();
+  }
+
+  const Stats& stats() const { return m_stats; }
+  void reset_stats() { m_stats = {}; }
+
+private:
+  static constexpr std::uint32_t c_none = StateTracking<TState>::c_none;
+
+  std::vector<Barrier> m_batch;
+  Stats m_stats;
+  std::size_t m_split_begins = 0;
+};
+
+} // namespace rei
+
+#endif
@@ -6,11 +6,36 @@
 #include <vector>
 
 #include "algebra.h"
+#include "debug.h"
 
 using namespace std;
 
 namespace rei {
 
+void Scene::attach(ModelPtr model) {
+  ModelHandle h = m_store->create(model->get_transform(),
+    ModelStore::Id(model->get_geometry().get()), ModelStore::Id(model->get_material().get()));
+  REI_ASSERT(m_store->dense_index(h) == m_models.size());
+  model->attach(m_store, h);
+  m_index.insert(h, model->get_geometry(), model->get_transform());
+  m_models.emplace_back(std::move(model));
+}
+
+void Scene::remove_model(const ModelPtr& model) {
+  ModelHandle h = model->handle();
+  if (!m_store->valid(h) || m_models[m_store->dense_index(h)] != model) {
+    REI_WARNING("Removing a model not in this scene");
+    return;
+  }
+  const size_t dense = m_store->dense_index(h);
+  model->detach();
+  m_index.remove(h);
+  m_store->destroy(h);
+  // mirror the swap-remove of the store
+  if (dense + 1 != m_models.size()) m_models[dense] = std::move(m_models.back());
+  m_models.pop_back();
+}
+
 /*
 wstring StaticScene::summary() const {
 wostringstream oss;
@@ -8,13 +8,16 @@
 #include "graphic_handle.h"
 
 #include "geometry.h"
+#include "light_store.h"
 #include "material.h"
+#include "model_index.h"
+#include "model_store.h"
+#include "scene_graph.h"
 
 /*
  * scene.h
  * Define a Scene class
  *
- * TODO: add lights
  * TODO: add audio
  */
 
@@ -27,27 +30,67 @@ namespace rei {
 class Model {
 public:
   // Default construct
-  [[depreacated]] Model(const std::string& n) {REI_DEPRECATED} Model(const std::wstring& n)
+  [[deprecated]] Model(const std::string& /*n*/) {REI_DEPRECATED} Model(const Name& n)
       : Model(n, Mat4::I(), nullptr, nullptr) {}
-  Model(const std::wstring& n, Mat4 trans, GeometryPtr geometry, MaterialPtr material)
+  Model(const Name& n, Mat4 trans, GeometryPtr geometry, MaterialPtr material)
       : name(n), transform(trans), geometry(geometry), material(material) {}
 
+  // A copy is not in any store: it snapshots the transform instead of sharing the store slot, so
+  // editing it cannot write through to the original. Assigning writes through this model's own
+  // slot, if any.
+  Model(const Model& other)
+      : name(other.name),
+        transform(other.get_transform()),
+        geometry(other.geometry),
+        material(other.material) {}
+  Model& operator=(const Model& other) {
+    if (this == &other) return *this;
+    name = other.name;
+    set_transform(other.get_transform());
+    set_geometry(other.geometry);
+    set_material(other.material);
+    return *this;
+  }
+
   // Destructor
   virtual ~Model() = default;
 
-  void set_transform(const Mat4 trans) { this->transform = trans; }
+  void set_transform(const Mat4 trans) {
+    this->transform = trans;
+    if (m_store) m_store->set_transform(m_handle, trans);
+  }
   Mat4 get_transform(Handness from = Handness::Right, Handness to = Handness::Right,
     VectorTarget vec = VectorTarget::Column) const {
-    return convention_convert(
-      transform, from != Handness::Right, to != Handness::Right, vec != VectorTarget::Column);
+    return convention_convert(m_store ? m_store->transform(m_handle) : transform,
+      from != Handness::Right, to != Handness::Right, vec != VectorTarget::Column);
   }
 
-  void set_material(std::shared_ptr<Material> mat) { this->material = mat; }
+  void set_material(std::shared_ptr<Material> mat) {
+    this->material = mat;
+    if (m_store) m_store->set_material(m_handle, ModelStore::Id(mat.get()));
+  }
   MaterialPtr get_material() const { return material; }
 
-  void set_geometry(std::shared_ptr<Geometry> geo) { this->geometry = geo; }
+  void set_geometry(std::shared_ptr<Geometry> geo) {
+    this->geometry = geo;
+    if (m_store) m_store->set_geometry(m_handle, ModelStore::Id(geo.get()));
+  }
   GeometryPtr get_geometry() const { return geometry; }
 
+  // Mirror this model into a store slot; the store becomes authoritative for the transform
+  void attach(std::shared_ptr<ModelStore> store, ModelHandle handle) {
+    m_store = std::move(store);
+    m_handle = handle;
+  }
+  void detach() {
+    if (m_store) transform = m_store->transform(m_handle);
+    m_store = nullptr;
+    m_handle = ModelHandle();
+  }
+  ModelHandle handle() const { return m_handle; }
+
+  const Name& get_name() const { return name; }
+
   [[deprecated]] void set(const Material& mat) { REI_DEPRECATED }
   [[deprecated]] void set(Material&& mat) { REI_DEPRECATED }
 
@@ -60,6 +103,9 @@ protected:
   Mat4 transform = Mat4::I();
   GeometryPtr geometry;
   MaterialPtr material;
+
+  std::shared_ptr<ModelStore> m_store;
+  ModelHandle m_handle;
 };
 
 using ModelPtr = std::shared_ptr<Model>;
@@ -67,6 +113,10 @@ using ModelPtr = std::shared_ptr<Model>;
 /*
  * Describe a 3D environment to be rendered.
  * Typically, it contains: models, lights, ...
+ *
+ * Model data is kept in a ModelStore; the ModelPtr list is an adapter kept in the same (dense)
+ * order as the store columns, so index i of get_models() is dense index i of store(). Lights
+ * live in a LightStore only, with their own versions.
  */
 class Scene {
   using ModelContainer = std::vector<ModelPtr>;
@@ -81,6 +131,7 @@ public:
   typedef uintptr_t MaterialUID;
   typedef uintptr_t GeometryUID;
   typedef uintptr_t ModelUID;
+  typedef ModelStore::Version Version;
 
   // static const MaterialPtr default_material;
 
@@ -94,7 +145,7 @@ public:
     ModelPtr new_model = std::make_shared<Model>(name, trans, geometry, material);
     if (material) m_materials.insert(material);
     if (geometry) m_geometries.insert(geometry);
-    m_models.emplace_back(new_model);
+    attach(std::move(new_model));
   }
   void add_model(const Mat4& trans, GeometryPtr geometry, const Name& name) {
     add_model(trans, geometry, nullptr, name);
@@ -104,9 +155,20 @@ public:
     if (mat) m_materials.insert(mat);
     auto geo = mi.get_geometry();
     if (geo) m_geometries.insert(geo);
-    m_models.emplace_back(std::make_shared<Model>(mi));
+    attach(std::make_shared<Model>(mi));
   }
 
+  // Swap-remove, mirroring the store; materials and geometries are kept
+  void remove_model(const ModelPtr& model);
+
+  // Swap the geometry of a model in this scene, e.g. a loaded mesh for its placeholder
+  void set_geometry(const ModelPtr& model, GeometryPtr geometry) {
+    if (geometry) m_geometries.insert(geometry);
+    model->set_geometry(std::move(geometry));
+  }
+  // Forget a geometry no model uses anymore
+  void drop_geometry(const GeometryPtr& geometry) { m_geometries.erase(geometry); }
+
   // TODO convert to iterator
   virtual ModelsConstRef get_models() const { return m_models; }
   virtual ModelsRef get_models() { return m_models; }
@@ -115,6 +177,54 @@ public:
   inline GeometryUID get_id(const GeometryPtr& geometry) const { return uintptr_t(geometry.get()); }
   inline MaterialUID get_id(const MaterialPtr& material) const { return uintptr_t(material.get()); }
   inline ModelUID get_id(const ModelPtr& model) const { return uintptr_t(model.get()); }
+  inline ModelHandle get_handle(const ModelPtr& model) const { return model->handle(); }
+
+  // Returns nullptr for stale handles
+  ModelPtr get_model(ModelHandle handle) const {
+    return m_store->valid(handle) ? m_models[m_store->dense_index(handle)] : nullptr;
+  }
+
+  // Data-oriented view of all models
+  const ModelStore& store() const { return *m_store; }
+  ModelStore& store() { return *m_store; }
+
+  // Model changes (creation, removal, transform, geometry, material) are versioned; a consumer
+  // remembers version() after syncing and visits f(ModelHandle) for what changed since. Material
+  // parameters are versioned per material, see Material::version().
+  Version version() const { return m_store->version(); }
+  template <typename F>
+  void model_changes_since(Version since, F&& f) const {
+    m_store->changes_since(since, std::forward<F>(f));
+  }
+  template <typename F>
+  void model_removals_since(Version since, F&& f) const {
+    m_store->removals_since(since, std::forward<F>(f));
+  }
+  // False if the consumer fell too far behind and must compare against the whole scene
+  bool tracks_changes_since(Version since) const { return m_store->covers(since); }
+
+  // Transform hierarchy; models bound to its nodes get their world transform from it
+  const SceneGraph& graph() const { return m_graph; }
+  SceneGraph& graph() { return m_graph; }
+  size_t update_transforms() {
+    size_t count = m_graph.update(m_store.get());
+    update_spatial_index();
+    return count;
+  }
+
+  // World-space index over model bounds; call update_spatial_index() after moving models,
+  // swapping their geometry or editing a geometry
+  const ModelSpatialIndex& spatial_index() const { return m_index; }
+  size_t update_spatial_index() {
+    return m_index.sync(
+      *m_store, [&](ModelHandle h) { return m_models[m_store->dense_index(h)]->get_geometry(); });
+  }
+
+  // Lights; pipelines sync them by LightStore::changed_range
+  LightHandle add_light(const Light& light) { return m_lights.create(light); }
+  void remove_light(LightHandle light) { m_lights.destroy(light); }
+  const LightStore& lights() const { return m_lights; }
+  LightStore& lights() { return m_lights; }
 
   const MaterialContainer& materials() const { return m_materials; }
   const GeometryContainer& geometries() const { return m_geometries; }
@@ -129,6 +239,13 @@ protected:
   ModelContainer m_models;
   MaterialContainer m_materials;
   GeometryContainer m_geometries;
+  std::shared_ptr<ModelStore> m_store = std::make_shared<ModelStore>();
+  SceneGraph m_graph;
+  ModelSpatialIndex m_index;
+  LightStore m_lights;
+
+private:
+  void attach(ModelPtr model);
 };
 
 } // namespace rei
@@ -0,0 +1,498 @@
+// source of scene_archive.h
+#include "scene_archive.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+#include "container_utils.h"
+#include "material.h"
+
+using std::make_shared;
+using std::shared_ptr;
+using std::string;
+using std::vector;
+
+namespace rei {
+
+using namespace archive;
+
+namespace {
+
+static_assert(sizeof(PackedMesh::Vertex) == 44, "vertex layout must match the renderer");
+static_assert(sizeof(Header) % 8 == 0 && sizeof(MeshRecord) % 8 == 0, "records are 8-aligned");
+
+const size_t c_record_bytes[k_section_num] = {
+  sizeof(std::uint16_t),      // Strings
+  sizeof(MeshRecord),         // Meshes
+  sizeof(PackedMesh::Vertex), // Vertices
+  sizeof(PackedMesh::Index),  // Indices
+  sizeof(MaterialRecord),     // Materials
+  sizeof(ParamRecord),        // Params
+  sizeof(NodeRecord),         // Nodes
+  sizeof(ModelRecord),        // Models
+  sizeof(LightRecord),        // Lights
+};
+
+void write_mat(const Mat4& m, double out[16]) {
+  for (int c = 0; c < 4; c++)
+    for (int r = 0; r < 4; r++)
+      out[c * 4 + r] = m(r, c);
+}
+
+Mat4 read_mat(const double in[16]) {
+  Mat4 m;
+  for (int c = 0; c < 4; c++)
+    for (int r = 0; r < 4; r++)
+      m(r, c) = in[c * 4 + r];
+  return m;
+}
+
+std::uint64_t align_up(std::uint64_t x) {
+  return (x + k_alignment - 1) / k_alignment * k_alignment;
+}
+
+} // namespace
+
+// SceneArchive //////////////////////////////////////////////////////////////
+
+shared_ptr<const SceneArchive> SceneArchive::open(const string& filename) {
+  MappedFile file;
+  if (!file.open(filename)) {
+    REI_WARNING("SceneArchive: cannot map " + filename);
+    return nullptr;
+  }
+  shared_ptr<SceneArchive> ret(new SceneArchive(std::move(file)));
+  if (!ret->validate(filename)) return nullptr;
+  return ret;
+}
+
+bool SceneArchive::validate(const string& filename) {
+  auto fail = [&](const char* what) {
+    REI_WARNING("SceneArchive: " + filename + " is not a valid archive (" + what + ")");
+    return false;
+  };
+
+  if (m_file.size() < sizeof(Header)) return fail("truncated header");
+  m_header = reinterpret_cast<const Header*>(m_file.data());
+  const Header& h = *m_header;
+  if (std::memcmp(h.magic, k_magic, sizeof(k_magic)) != 0) return fail("magic");
+  if (h.format_version != k_format_version) return fail("format version");
+  if (h.endian_tag != k_endian_tag) return fail("endianness");
+  if (h.header_bytes != sizeof(Header)) return fail("header size");
+  if (h.file_bytes != m_file.size()) return fail("file size");
+
+  for (std::uint32_t i = 0; i < k_section_num; i++) {
+    const SectionRecord& s = h.sections[i];
+    if (s.offset % k_alignment != 0 || s.offset < sizeof(Header)) return fail("section offset");
+    if (s.offset > m_file.size() || s.bytes > m_file.size() - s.offset)
+      return fail("section range");
+    if (s.bytes != s.count * c_record_bytes[i]) return fail("section size");
+  }
+
+  // Record tables only; the bulk streams are not touched
+  auto name_ok = [&](NameRecord n) { return std::uint64_t(n.first) + n.length <= count(Strings); };
+  const MeshRecord* meshes = records<MeshRecord>(Meshes);
+  for (size_t i = 0; i < count(Meshes); i++) {
+    const MeshRecord& m = meshes[i];
+    if (!name_ok(m.name)) return fail("mesh name");
+    if (m.first_vertex + m.vertex_count > count(Vertices)) return fail("mesh vertices");
+    if (m.first_index + m.index_count > count(Indices)) return fail("mesh indices");
+    if (m.index_count % 3 != 0) return fail("mesh triangles");
+  }
+  const ParamRecord* params = records<ParamRecord>(Params);
+  for (size_t i = 0; i < count(Params); i++) {
+    if (!name_ok(params[i].name)) return fail("param name");
+    if (params[i].type > ParamDouble) return fail("param type");
+  }
+  const MaterialRecord* materials = records<MaterialRecord>(Materials);
+  for (size_t i = 0; i < count(Materials); i++) {
+    const MaterialRecord& m = materials[i];
+    if (!name_ok(m.name)) return fail("material name");
+    if (std::uint64_t(m.first_param) + m.param_count > count(Params))
+      return fail("material params");
+  }
+  const ModelRecord* models = records<ModelRecord>(Models);
+  for (size_t i = 0; i < count(Models); i++) {
+    const ModelRecord& m = models[i];
+    if (!name_ok(m.name)) return fail("model name");
+    if (m.mesh >= count(Meshes)) return fail("model mesh");
+    if (m.material != k_none && m.material >= count(Materials)) return fail("model material");
+  }
+  const NodeRecord* nodes = records<NodeRecord>(Nodes);
+  for (size_t i = 0; i < count(Nodes); i++) {
+    const NodeRecord& n = nodes[i];
+    if (!name_ok(n.name)) return fail("node name");
+    if (n.parent != k_none && n.parent >= i) return fail("node parent");
+    if (n.model != k_none && n.model >= count(Models)) return fail("node model");
+  }
+  const LightRecord* lights = records<LightRecord>(Lights);
+  for (size_t i = 0; i < count(Lights); i++) {
+    if (!name_ok(lights[i].name)) return fail("light name");
+    if (lights[i].type > std::uint32_t(LightType::Tube)) return fail("light type");
+  }
+  return true;
+}
+
+Name SceneArchive::name(NameRecord record) const {
+  const std::uint16_t* chars = records<std::uint16_t>(Strings) + record.first;
+  return Name(std::wstring(chars, chars + record.length));
+}
+
+shared_ptr<Scene> SceneArchive::instantiate() const {
+  auto scene = make_shared<Scene>(L"Scene Archive");
+  // Geometry keeps the mapping alive through this
+  shared_ptr<const void> owner = shared_from_this();
+
+  const PackedMesh::Vertex* vertices = records<PackedMesh::Vertex>(Vertices);
+  const PackedMesh::Index* indices = records<PackedMesh::Index>(Indices);
+  const MeshRecord* mesh_records = records<MeshRecord>(Meshes);
+  vector<GeometryPtr> meshes(count(Meshes));
+  for (size_t i = 0; i < meshes.size(); i++) {
+    const MeshRecord& m = mesh_records[i];
+    meshes[i] = make_shared<PackedMesh>(name(m.name), owner, vertices + m.first_vertex,
+      m.vertex_count, indices + m.first_index, m.index_count,
+      Vec3(m.bound_min[0], m.bound_min[1], m.bound_min[2]),
+      Vec3(m.bound_max[0], m.bound_max[1], m.bound_max[2]));
+  }
+
+  const ParamRecord* params = records<ParamRecord>(Params);
+  const MaterialRecord* material_records = records<MaterialRecord>(Materials);
+  vector<MaterialPtr> materials(count(Materials));
+  for (size_t i = 0; i < materials.size(); i++) {
+    const MaterialRecord& m = material_records[i];
+    materials[i] = make_shared<Material>(name(m.name));
+    for (std::uint32_t p = m.first_param; p < m.first_param + m.param_count; p++) {
+      const double* v = params[p].value;
+      Material::MaterialProperty value;
+      switch (params[p].type) {
+        case ParamColor:
+          value = Color(float(v[0]), float(v[1]), float(v[2]), float(v[3]));
+          break;
+        case ParamVec4:
+          value = Vec4(v[0], v[1], v[2], v[3]);
+          break;
+        default:
+          value = v[0];
+          break;
+      }
+      materials[i]->set(name(params[p].name), std::move(value));
+    }
+  }
+
+  const ModelRecord* model_records = records<ModelRecord>(Models);
+  vector<ModelHandle> handles(count(Models));
+  for (size_t i = 0; i < handles.size(); i++) {
+    const ModelRecord& m = model_records[i];
+    MaterialPtr material = m.material == k_none ? nullptr : materials[m.material];
+    scene->add_model(read_mat(m.transform), meshes[m.mesh], material, name(m.name));
+    handles[i] = scene->get_handle(scene->get_models().back());
+  }
+
+  SceneGraph& graph = scene->graph();
+  const NodeRecord* nodes = records<NodeRecord>(Nodes);
+  graph.reserve(count(Nodes));
+  for (size_t i = 0; i < count(Nodes); i++) {
+    const NodeRecord& n = nodes[i];
+    const SceneGraph::NodeId parent = n.parent == k_none ? SceneGraph::k_invalid_node : n.parent;
+    const SceneGraph::NodeId id = graph.add_node(parent, read_mat(n.local), name(n.name));
+    if (n.model != k_none) graph.bind(id, handles[n.model]);
+  }
+
+  const LightRecord* lights = records<LightRecord>(Lights);
+  scene->lights().reserve(count(Lights));
+  for (size_t i = 0; i < count(Lights); i++) {
+    const LightRecord& l = lights[i];
+    Light light;
+    light.name = name(l.name);
+    light.type = LightType(l.type);
+    light.flags = l.flags;
+    light.position = Vec3(l.position[0], l.position[1], l.position[2]);
+    light.direction = Vec3(l.direction[0], l.direction[1], l.direction[2]);
+    light.color = Color(l.color[0], l.color[1], l.color[2], l.color[3]);
+    light.intensity = l.intensity;
+    light.range = l.range;
+    light.inner_angle = l.inner_angle;
+    light.outer_angle = l.outer_angle;
+    light.radius = l.radius;
+    light.length = l.length;
+    scene->add_light(light);
+  }
+  scene->update_transforms();
+  return scene;
+}
+
+shared_ptr<Camera> SceneArchive::camera() const {
+  const CameraRecord& c = m_header->camera;
+  if (!c.valid) return nullptr;
+  auto ret = make_shared<Camera>(Vec3(c.position[0], c.position[1], c.position[2]),
+    Vec3(c.forward[0], c.forward[1], c.forward[2]), Vec3(c.up[0], c.up[1], c.up[2]));
+  ret->set_params(c.aspect, c.fov_h, c.near_plane, c.far_plane);
+  return ret;
+}
+
+void SceneArchive::prefetch_geometry() const {
+  for (Section s : {Vertices, Indices}) {
+    const SectionRecord& section = m_header->sections[s];
+    m_file.prefetch(section.offset, section.bytes);
+  }
+}
+
+// Writer ////////////////////////////////////////////////////////////////////
+
+namespace {
+
+// Addressable by PackedMesh::Index
+constexpr size_t k_max_mesh_vertices = size_t(1) << (8 * sizeof(PackedMesh::Index));
+
+struct ArchiveBuilder {
+  vector<std::uint16_t> strings;
+  vector<MeshRecord> meshes;
+  vector<PackedMesh::Vertex> vertices;
+  vector<PackedMesh::Index> indices;
+  vector<MaterialRecord> materials;
+  vector<ParamRecord> params;
+  vector<NodeRecord> nodes;
+  vector<ModelRecord> models;
+  vector<LightRecord> lights;
+
+  NameRecord add_name(const Name& name) {
+    NameRecord ret {std::uint32_t(strings.size()), std::uint32_t(name.size())};
+    for (wchar_t c : name.str())
+      strings.push_back(std::uint16_t(c));
+    return ret;
+  }
+
+  // Return k_none if the geometry cannot be stored
+  std::uint32_t add_mesh(const Geometry& geometry) {
+    MeshRecord rec {};
+    rec.name = add_name(geometry.get_name());
+    rec.first_vertex = vertices.size();
+    rec.first_index = indices.size();
+    if (const Mesh* mesh = dynamic_cast<const Mesh*>(&geometry)) {
+      if (mesh->get_vertices().size() > k_max_mesh_vertices) {
+        REI_ERROR("SceneArchive: mesh has too many vertices for 16-bit indices; skipped");
+        return k_none;
+      }
+      for (const Mesh::Vertex& v : mesh->get_vertices()) {
+        PackedMesh::Vertex pv;
+        pv.position[0] = float(v.coord.x);
+        pv.position[1] = float(v.coord.y);
+        pv.position[2] = float(v.coord.z);
+        pv.position[3] = float(v.coord.h);
+        pv.color[0] = v.color.r;
+        pv.color[1] = v.color.g;
+        pv.color[2] = v.color.b;
+        pv.color[3] = v.color.a;
+        pv.normal[0] = float(v.normal.x);
+        pv.normal[1] = float(v.normal.y);
+        pv.normal[2] = float(v.normal.z);
+        vertices.push_back(pv);
+      }
+      for (const Mesh::Triangle& t : mesh->get_triangles()) {
+        indices.push_back(PackedMesh::Index(t.a));
+        indices.push_back(PackedMesh::Index(t.b));
+        indices.push_back(PackedMesh::Index(t.c));
+      }
+    } else if (const PackedMesh* packed = dynamic_cast<const PackedMesh*>(&geometry)) {
+      vertices.insert(
+        vertices.end(), packed->vertices(), packed->vertices() + packed->vertices_num());
+      indices.insert(indices.end(), packed->indices(), packed->indices() + packed->indices_num());
+    } else {
+      REI_ERROR("SceneArchive: only triangle meshes can be stored; skipped");
+      return k_none;
+    }
+    rec.vertex_count = std::uint32_t(vertices.size() - rec.first_vertex);
+    rec.index_count = std::uint32_t(indices.size() - rec.first_index);
+
+    // Bounds, so that loading never has to scan vertices
+    float lo[3] = {0, 0, 0}, hi[3] = {0, 0, 0};
+    for (size_t i = rec.first_vertex; i < vertices.size(); i++) {
+      for (int k = 0; k < 3; k++) {
+        const float x = vertices[i].position[k];
+        lo[k] = i == rec.first_vertex ? x : (std::min)(lo[k], x);
+        hi[k] = i == rec.first_vertex ? x : (std::max)(hi[k], x);
+      }
+    }
+    std::copy(lo, lo + 3, rec.bound_min);
+    std::copy(hi, hi + 3, rec.bound_max);
+
+    meshes.push_back(rec);
+    return std::uint32_t(meshes.size() - 1);
+  }
+
+  std::uint32_t add_material(const Material& material) {
+    MaterialRecord rec {};
+    rec.name = add_name(material.name());
+    rec.first_param = std::uint32_t(params.size());
+    material.for_each_property([&](const Name& prop, const Material::MaterialProperty& value) {
+      ParamRecord p {};
+      p.name = add_name(prop);
+      if (const Color* c = std::get_if<Color>(&value)) {
+        p.type = ParamColor;
+        p.value[0] = c->r, p.value[1] = c->g, p.value[2] = c->b, p.value[3] = c->a;
+      } else if (const Vec4* v = std::get_if<Vec4>(&value)) {
+        p.type = ParamVec4;
+        p.value[0] = v->x, p.value[1] = v->y, p.value[2] = v->z, p.value[3] = v->h;
+      } else if (const double* d = std::get_if<double>(&value)) {
+        p.type = ParamDouble;
+        p.value[0] = *d;
+      } else {
+        return; // empty, or a texture (those are cached on their own by TextureImporter)
+      }
+      params.push_back(p);
+    });
+    rec.param_count = std::uint32_t(params.size() - rec.first_param);
+    materials.push_back(rec);
+    return std::uint32_t(materials.size() - 1);
+  }
+};
+
+template <typename T>
+void fill_section(Header& header, Section section, const vector<T>& data, std::uint64_t& end) {
+  SectionRecord& s = header.sections[section];
+  s.offset = align_up(end);
+  s.bytes = data.size() * sizeof(T);
+  s.count = data.size();
+  end = s.offset + s.bytes;
+}
+
+template <typename T>
+void write_section(
+  std::ofstream& out, const Header& header, Section section, const vector<T>& data) {
+  static const char zeros[k_alignment] = {};
+  const std::uint64_t at = std::uint64_t(out.tellp());
+  out.write(zeros, std::streamsize(header.sections[section].offset - at));
+  out.write(reinterpret_cast<const char*>(data.data()), std::streamsize(data.size() * sizeof(T)));
+}
+
+} // namespace
+
+bool archivable(const Geometry& geometry) {
+  // Skins are not archived (yet), so skinned meshes are always imported
+  if (const Mesh* mesh = dynamic_cast<const Mesh*>(&geometry))
+    return !mesh->skinned() && mesh->get_vertices().size() <= k_max_mesh_vertices;
+  return dynamic_cast<const PackedMesh*>(&geometry) != nullptr;
+}
+
+bool write_scene_archive(const string& filename, const Scene& scene, const Camera* camera) {
+  ArchiveBuilder b;
+
+  // Models, with their meshes and materials each stored once
+  Hashmap<const Geometry*, std::uint32_t> mesh_of_geometry;
+  Hashmap<const Material*, std::uint32_t> material_index;
+  Hashmap<ModelHandle, std::uint32_t, ModelHandle::Hasher> model_of_handle;
+  for (const ModelPtr& model : scene.get_models()) {
+    const Geometry* geometry = model->get_geometry().get();
+    if (!geometry) continue;
+    auto mesh = mesh_of_geometry.try_get(geometry);
+    const std::uint32_t mesh_index = mesh ? *mesh : b.add_mesh(*geometry);
+    if (!mesh) mesh_of_geometry.insert({geometry, mesh_index});
+    if (mesh_index == k_none) continue;
+
+    std::uint32_t mat_index = k_none;
+    if (const Material* material = model->get_material().get()) {
+      auto found = material_index.try_get(material);
+      mat_index = found ? *found : b.add_material(*material);
+      if (!found) material_index.insert({material, mat_index});
+    }
+
+    ModelRecord rec {};
+    rec.name = b.add_name(model->get_name());
+    rec.mesh = mesh_index;
+    rec.material = mat_index;
+    write_mat(model->get_transform(), rec.transform);
+    model_of_handle.insert({model->handle(), std::uint32_t(b.models.size())});
+    b.models.push_back(rec);
+  }
+
+  // Node hierarchy; node ids are creation order, so parents come first
+  const SceneGraph& graph = scene.graph();
+  b.nodes.reserve(graph.size());
+  for (SceneGraph::NodeId id = 0; id < graph.size(); id++) {
+    NodeRecord rec {};
+    rec.name = b.add_name(graph.name(id));
+    const SceneGraph::NodeId parent = graph.parent(id);
+    rec.parent = parent == SceneGraph::k_invalid_node ? k_none : parent;
+    const std::uint32_t* model = model_of_handle.try_get(graph.bound_model(id));
+    rec.model = model ? *model : k_none;
+    write_mat(graph.local(id), rec.local);
+    b.nodes.push_back(rec);
+  }
+
+  const LightStore& lights = scene.lights();
+  b.lights.reserve(lights.size());
+  for (size_t i = 0; i < lights.size(); i++) {
+    const Light light = lights.get(lights.handles()[i]);
+    LightRecord rec {};
+    rec.name = b.add_name(light.name);
+    rec.type = std::uint32_t(light.type);
+    rec.flags = light.flags;
+    for (int k = 0; k < 3; k++) {
+      rec.position[k] = light.position[k];
+      rec.direction[k] = light.direction[k];
+    }
+    rec.color[0] = light.color.r;
+    rec.color[1] = light.color.g;
+    rec.color[2] = light.color.b;
+    rec.color[3] = light.color.a;
+    rec.intensity = light.intensity;
+    rec.range = light.range;
+    rec.inner_angle = light.inner_angle;
+    rec.outer_angle = light.outer_angle;
+    rec.radius = light.radius;
+    rec.length = light.length;
+    b.lights.push_back(rec);
+  }
+
+  Header header {};
+  std::memcpy(header.magic, k_magic, sizeof(k_magic));
+  header.format_version = k_format_version;
+  header.endian_tag = k_endian_tag;
+  header.header_bytes = sizeof(Header);
+  if (camera) {
+    CameraRecord& c = header.camera;
+    auto store = [](const Vec3& v, double out[3]) {
+      out[0] = v.x, out[1] = v.y, out[2] = v.z;
+    };
+    store(camera->position(), c.position);
+    store(camera->forward(), c.forward);
+    store(camera->up(), c.up);
+    c.aspect = camera->aspect();
+    c.fov_h = camera->fov_h();
+    c.near_plane = camera->near_plane();
+    c.far_plane = camera->far_plane();
+    c.valid = 1;
+  }
+  std::uint64_t end = sizeof(Header);
+  fill_section(header, Strings, b.strings, end);
+  fill_section(header, Meshes, b.meshes, end);
+  fill_section(header, Vertices, b.vertices, end);
+  fill_section(header, Indices, b.indices, end);
+  fill_section(header, Materials, b.materials, end);
+  fill_section(header, Params, b.params, end);
+  fill_section(header, Nodes, b.nodes, end);
+  fill_section(header, Models, b.models, end);
+  fill_section(header, Lights, b.lights, end);
+  header.file_bytes = end;
+
+  std::ofstream out(filename, std::ios::binary | std::ios::trunc);
+  if (!out) {
+    REI_WARNING("SceneArchive: cannot write " + filename);
+    return false;
+  }
+  out.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+  write_section(out, header, Strings, b.strings);
+  write_section(out, header, Meshes, b.meshes);
+  write_section(out, header, Vertices, b.vertices);
+  write_section(out, header, Indices, b.indices);
+  write_section(out, header, Materials, b.materials);
+  write_section(out, header, Params, b.params);
+  write_section(out, header, Nodes, b.nodes);
+  write_section(out, header, Models, b.models);
+  write_section(out, header, Lights, b.lights);
+  return bool(out);
+}
+
+} // namespace rei
@@ -0,0 +1,201 @@
+#ifndef REI_SCENE_ARCHIVE_H
+#define REI_SCENE_ARCHIVE_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "camera.h"
+#include "geometry.h"
+#include "mapped_file.h"
+#include "scene.h"
+
+/*
+ * scene_archive.h
+ * Binary scene container laid out for direct memory mapping: meshes in upload-ready layout,
+ * material parameters, models, lights and the node hierarchy.
+ */
+
+namespace rei {
+
+/*
+ * File layout (little-endian, no pointers; every reference is an index or a byte offset):
+ *
+ *   archive::Header
+ *   section 0 .. k_section_num-1, each starting at a multiple of k_alignment
+ *
+ * Records are plain fixed-size structs, read in place from the mapped pages. Opening an archive
+ * validates the header and the record tables (O(records), never O(vertices)); vertex and index
+ * streams are handed to the renderer as views into the mapping.
+ */
+namespace archive {
+
+constexpr char k_magic[8] = {'R', 'E', 'I', 'S', 'C', 'E', 'N', 'E'};
+constexpr std::uint32_t k_format_version = 2;
+constexpr std::uint32_t k_endian_tag = 0x01020304;
+constexpr std::uint64_t k_alignment = 256; // also satisfies D3D12 buffer placement
+constexpr std::uint32_t k_none = UINT32_MAX;
+
+enum Section : std::uint32_t {
+  Strings,   // UTF-16 code units
+  Meshes,    // MeshRecord
+  Vertices,  // PackedMesh::Vertex
+  Indices,   // PackedMesh::Index
+  Materials, // MaterialRecord
+  Params,    // ParamRecord
+  Nodes,     // NodeRecord, parents before children
+  Models,    // ModelRecord
+  Lights,    // LightRecord
+  k_section_num,
+};
+
+struct SectionRecord {
+  std::uint64_t offset; // from the start of the file
+  std::uint64_t bytes;
+  std::uint64_t count;
+};
+
+// [first, first + length) in the string section
+struct NameRecord {
+  std::uint32_t first;
+  std::uint32_t length;
+};
+
+struct CameraRecord {
+  double position[3];
+  double forward[3];
+  double up[3];
+  double aspect;
+  double fov_h;
+  double near_plane;
+  double far_plane;
+  std::uint32_t valid;
+  std::uint32_t pad;
+};
+
+struct Header {
+  char magic[8];
+  std::uint32_t format_version;
+  std::uint32_t endian_tag;
+  std::uint32_t header_bytes;
+  std::uint32_t pad;
+  std::uint64_t file_bytes;
+  SectionRecord sections[k_section_num];
+  CameraRecord camera;
+};
+
+struct MeshRecord {
+  NameRecord name;
+  std::uint64_t first_vertex;
+  std::uint64_t first_index;
+  std::uint32_t vertex_count;
+  std::uint32_t index_count;
+  float bound_min[3];
+  float bound_max[3];
+};
+
+enum ParamType : std::uint32_t {
+  ParamColor,
+  ParamVec4,
+  ParamDouble,
+};
+
+struct ParamRecord {
+  NameRecord name;
+  std::uint32_t type;
+  std::uint32_t pad;
+  double value[4];
+};
+
+struct MaterialRecord {
+  NameRecord name;
+  std::uint32_t first_param;
+  std::uint32_t param_count;
+};
+
+struct NodeRecord {
+  NameRecord name;
+  std::uint32_t parent; // k_none for roots
+  std::uint32_t model;  // bound model, or k_none
+  double local[16];     // column-major
+};
+
+struct ModelRecord {
+  NameRecord name;
+  std::uint32_t mesh;
+  std::uint32_t material; // k_none for no material
+  double transform[16];   // column-major; overwritten by the bound node, if any
+};
+
+struct LightRecord {
+  NameRecord name;
+  std::uint32_t type; // LightType
+  std::uint32_t flags;
+  double position[3];
+  double direction[3];
+  float color[4];
+  double intensity;
+  double range;
+  double inner_angle;
+  double outer_angle;
+  double radius;
+  double length;
+};
+
+} // namespace archive
+
+/*
+ * A validated, mapped archive. Geometry created from it shares ownership of the mapping, so the
+ * archive object itself may be dropped once the scene is instantiated.
+ * Index values are not checked against the vertex count of their mesh, since that would read
+ * every index; archives are trusted to come from write_scene_archive.
+ */
+class SceneArchive : public std::enable_shared_from_this<SceneArchive>, NoCopy {
+public:
+  // Map and validate; return nullptr (with a warning) if the file is missing or malformed
+  static std::shared_ptr<const SceneArchive> open(const std::string& filename);
+
+  const archive::Header& header() const { return *m_header; }
+  size_t file_bytes() const { return m_file.size(); }
+
+  template <typename T>
+  const T* records(archive::Section section) const {
+    return reinterpret_cast<const T*>(m_file.data() + m_header->sections[section].offset);
+  }
+  size_t count(archive::Section section) const { return m_header->sections[section].count; }
+
+  Name name(archive::NameRecord record) const;
+
+  // Build a scene over the archive; meshes are PackedMesh views, nothing is copied
+  std::shared_ptr<Scene> instantiate() const;
+  // nullptr if the archive has no camera
+  std::shared_ptr<Camera> camera() const;
+
+  // Ask the OS to start paging in all geometry streams (e.g. before uploading)
+  void prefetch_geometry() const;
+
+private:
+  SceneArchive(MappedFile&& file) : m_file(std::move(file)) {}
+
+  MappedFile m_file;
+  const archive::Header* m_header = nullptr;
+
+  bool validate(const std::string& filename);
+};
+
+// True if write_scene_archive can store the geometry: a triangle mesh whose vertices 16-bit
+// indices can address
+bool archivable(const Geometry& geometry);
+
+/*
+ * Write `scene` (e.g. from AssetLoader::load_world) and optionally its camera as an archive.
+ * Mesh vertices are converted to float once here instead of on every load. The renderer takes
+ * 16-bit indices, so meshes with more vertices than that can address are skipped with an error.
+ * Return false if the file could not be written.
+ */
+bool write_scene_archive(
+  const std::string& filename, const Scene& scene, const Camera* camera = nullptr);
+
+} // namespace rei
+
+#endif
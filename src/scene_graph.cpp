@@ -0,0 +1,213 @@
+// source of scene_graph.h
+#include "scene_graph.h"
+
+#include <algorithm>
+
+#include "debug.h"
+#include "parallel.h"
+
+using std::vector;
+
+namespace rei {
+
+SceneGraph::NodeId SceneGraph::add_node(NodeId parent, const Mat4& local, const Name& name) {
+  REI_ASSERT(parent == k_invalid_node || parent < m_index.size());
+  const NodeId id = NodeId(m_index.size());
+  // Appended out of order; the breadth-first order is rebuilt on the next update
+  m_index.push_back(Index(m_ids.size()));
+  m_parent_id.push_back(parent);
+  m_names.push_back(name);
+  m_ids.push_back(id);
+  m_parent.push_back(parent == k_invalid_node ? k_no_parent : m_index[parent]);
+  m_local.push_back(local);
+  m_world.push_back(local);
+  m_model.push_back(ModelHandle());
+  m_order_dirty = true;
+  return id;
+}
+
+void SceneGraph::clear() {
+  *this = SceneGraph();
+}
+
+void SceneGraph::reserve(size_t n) {
+  m_index.reserve(n);
+  m_parent_id.reserve(n);
+  m_names.reserve(n);
+  m_ids.reserve(n);
+  m_parent.reserve(n);
+  m_child_begin.reserve(n + 1);
+  m_local.reserve(n);
+  m_world.reserve(n);
+  m_model.reserve(n);
+}
+
+SceneGraph::NodeId SceneGraph::parent(NodeId node) const {
+  return m_parent_id[node];
+}
+
+void SceneGraph::set_local(NodeId node, const Mat4& local) {
+  m_local[m_index[node]] = local;
+  m_dirty_nodes.push_back(node);
+}
+
+void SceneGraph::bind(NodeId node, ModelHandle model) {
+  m_model[m_index[node]] = model;
+  m_dirty_nodes.push_back(node);
+}
+
+SceneGraph::Index SceneGraph::child_end(Index i) const {
+  return m_child_begin[i + 1];
+}
+
+void SceneGraph::rebuild_order() {
+  const size_t n = m_parent_id.size();
+
+  // Children of each node by id, in insertion order (CSR)
+  vector<Index> child_offset(n + 2, 0);
+  for (NodeId id = 0; id < n; id++)
+    child_offset[(m_parent_id[id] == k_invalid_node ? n : m_parent_id[id]) + 1]++;
+  for (size_t i = 1; i < child_offset.size(); i++)
+    child_offset[i] += child_offset[i - 1];
+  vector<NodeId> children(n);
+  {
+    vector<Index> fill(child_offset.begin(), child_offset.end() - 1);
+    for (NodeId id = 0; id < n; id++)
+      children[fill[m_parent_id[id] == k_invalid_node ? n : m_parent_id[id]]++] = id;
+  }
+
+  // Breadth-first; roots are the children of the virtual node n
+  vector<NodeId> order;
+  order.reserve(n);
+  order.insert(
+    order.end(), children.begin() + child_offset[n], children.begin() + child_offset[n + 1]);
+  for (size_t head = 0; head < order.size(); head++) {
+    const NodeId id = order[head];
+    order.insert(order.end(), children.begin() + child_offset[id],
+      children.begin() + child_offset[id + 1]);
+  }
+  REI_ASSERT(order.size() == n);
+
+  // Permute per-node arrays
+  vector<Index> new_index(n);
+  for (Index i = 0; i < n; i++)
+    new_index[order[i]] = i;
+  vector<Mat4> local(n), world(n);
+  vector<ModelHandle> model(n);
+  for (Index i = 0; i < n; i++) {
+    const Index old = m_index[order[i]];
+    local[i] = m_local[old];
+    world[i] = m_world[old];
+    model[i] = m_model[old];
+  }
+  m_local.swap(local);
+  m_world.swap(world);
+  m_model.swap(model);
+  m_index.swap(new_index);
+  m_ids.swap(order);
+
+  // Parents, children ranges and levels
+  vector<Index> level(n);
+  m_level_begin.clear();
+  m_child_begin.resize(n + 1);
+  Index next_child = Index(child_offset[n + 1] - child_offset[n]); // after the roots
+  for (Index i = 0; i < n; i++) {
+    const NodeId id = m_ids[i];
+    const NodeId p = m_parent_id[id];
+    m_parent[i] = p == k_invalid_node ? k_no_parent : m_index[p];
+    level[i] = p == k_invalid_node ? 0 : level[m_parent[i]] + 1;
+    if (i == 0 || level[i] != level[i - 1]) m_level_begin.push_back(i);
+    m_child_begin[i] = next_child;
+    next_child += child_offset[id + 1] - child_offset[id];
+  }
+  m_child_begin[n] = Index(n);
+  m_level_begin.push_back(Index(n));
+
+  m_order_dirty = false;
+  m_all_dirty = true;
+}
+
+size_t SceneGraph::update(ModelStore* store) {
+  if (m_order_dirty) rebuild_order();
+  if (!dirty()) return 0;
+
+  auto process = [&](Index b, Index e) {
+    for (Index i = b; i < e; i++) {
+      const Index p = m_parent[i];
+      m_world[i] = p == k_no_parent ? m_local[i] : m_world[p] * m_local[i];
+      if (store && m_model[i] && store->valid(m_model[i]))
+        store->set_transform(m_model[i], m_world[i]);
+    }
+  };
+
+  // Dirty nodes as sorted indices; levels are contiguous, so this is also sorted by level
+  vector<Index> dirty;
+  if (!m_all_dirty) {
+    dirty.reserve(m_dirty_nodes.size());
+    for (NodeId id : m_dirty_nodes)
+      dirty.push_back(m_index[id]);
+    std::sort(dirty.begin(), dirty.end());
+    dirty.erase(std::unique(dirty.begin(), dirty.end()), dirty.end());
+  }
+
+  const size_t grain = 1024;
+  size_t count = 0;
+  size_t next_dirty = 0;
+  m_ranges.clear();
+  for (size_t level = 0; level + 1 < m_level_begin.size(); level++) {
+    const Index level_end = m_level_begin[level + 1];
+    if (m_all_dirty) {
+      m_ranges.assign(1, Range {m_level_begin[level], level_end});
+    } else {
+      // Merge subtree ranges carried from the parent level with dirty nodes on this level
+      m_next_ranges.clear();
+      size_t r = 0;
+      while (r < m_ranges.size() || (next_dirty < dirty.size() && dirty[next_dirty] < level_end)) {
+        Range cur;
+        if (next_dirty < dirty.size() && dirty[next_dirty] < level_end
+            && (r == m_ranges.size() || dirty[next_dirty] < m_ranges[r].begin)) {
+          cur = Range {dirty[next_dirty], dirty[next_dirty] + 1};
+          next_dirty++;
+        } else {
+          cur = m_ranges[r++];
+        }
+        if (!m_next_ranges.empty() && cur.begin <= m_next_ranges.back().end)
+          m_next_ranges.back().end = (std::max)(m_next_ranges.back().end, cur.end);
+        else
+          m_next_ranges.push_back(cur);
+      }
+      m_ranges.swap(m_next_ranges);
+    }
+    if (m_ranges.empty()) {
+      if (next_dirty == dirty.size()) break;
+      continue;
+    }
+
+    // Nodes on a level only read their parents, so a level is processed in parallel
+    size_t level_count = 0;
+    for (const Range& range : m_ranges)
+      level_count += range.end - range.begin;
+    count += level_count;
+    if (m_ranges.size() == 1) {
+      parallel_for_range(m_ranges[0].begin, m_ranges[0].end, grain, process);
+    } else {
+      const size_t range_grain = (std::max<size_t>)(1, grain * m_ranges.size() / level_count);
+      parallel_for(0, m_ranges.size(), range_grain,
+        [&](size_t r) { process(m_ranges[r].begin, m_ranges[r].end); });
+    }
+
+    // Descendants on the next level
+    m_next_ranges.clear();
+    for (const Range& range : m_ranges) {
+      Range child {m_child_begin[range.begin], child_end(range.end - 1)};
+      if (child.begin < child.end) m_next_ranges.push_back(child);
+    }
+    m_ranges.swap(m_next_ranges);
+  }
+
+  m_dirty_nodes.clear();
+  m_all_dirty = false;
+  return count;
+}
+
+} // namespace rei
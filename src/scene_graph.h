@@ -0,0 +1,97 @@
+#ifndef REI_SCENE_GRAPH_H
+#define REI_SCENE_GRAPH_H
+
+#include <cstdint>
+#include <vector>
+
+#include "algebra.h"
+#include "common.h"
+#include "model_store.h"
+
+/*
+ * scene_graph.h
+ * Transform hierarchy, stored flat in breadth-first order for level-by-level propagation.
+ */
+
+namespace rei {
+
+/*
+ * Nodes are referred to by a stable NodeId (insertion order). Internally the per-node arrays
+ * are kept in breadth-first order, children grouped by parent, so:
+ *   - a parent always precedes its children, and every level is a contiguous range;
+ *   - the descendants of any node on a given level are also a contiguous range.
+ * The second property lets update() walk only the dirty subtrees, one level at a time, as a
+ * short list of index ranges; each level is processed in parallel.
+ */
+class SceneGraph {
+public:
+  using NodeId = std::uint32_t;
+  static constexpr NodeId k_invalid_node = UINT32_MAX;
+
+  SceneGraph() = default;
+
+  // Parent must exist already (or be k_invalid_node for a root)
+  NodeId add_node(NodeId parent, const Mat4& local, const Name& name = L"");
+  void clear();
+  void reserve(size_t n);
+
+  size_t size() const { return m_ids.size(); }
+  size_t depth() const { return m_level_begin.empty() ? 0 : m_level_begin.size() - 1; }
+
+  NodeId parent(NodeId node) const;
+  const Name& name(NodeId node) const { return m_names[node]; }
+
+  const Mat4& local(NodeId node) const { return m_local[m_index[node]]; }
+  // Marks the subtree of `node` dirty
+  void set_local(NodeId node, const Mat4& local);
+
+  // Valid after update()
+  const Mat4& world(NodeId node) const { return m_world[m_index[node]]; }
+
+  // World transform of the node is written into the model store on update
+  void bind(NodeId node, ModelHandle model);
+  ModelHandle bound_model(NodeId node) const { return m_model[m_index[node]]; }
+
+  bool dirty() const { return m_all_dirty || !m_dirty_nodes.empty(); }
+
+  // Recompute world transforms of dirty subtrees; bound models still alive in `store` receive
+  // their new world transform. Returns the number of nodes recomputed.
+  size_t update(ModelStore* store = nullptr);
+
+private:
+  using Index = std::uint32_t; // position in breadth-first order
+  static constexpr Index k_no_parent = UINT32_MAX;
+
+  struct Range {
+    Index begin, end;
+  };
+
+  // Per NodeId
+  std::vector<Index> m_index;
+  std::vector<NodeId> m_parent_id;
+  std::vector<Name> m_names;
+
+  // Per Index (breadth-first order)
+  std::vector<NodeId> m_ids;
+  std::vector<Index> m_parent;
+  std::vector<Index> m_child_begin; // children of i are [m_child_begin[i], m_child_begin[i + 1])
+  std::vector<Mat4> m_local;
+  std::vector<Mat4> m_world;
+  std::vector<ModelHandle> m_model;
+  std::vector<Index> m_level_begin; // size is level count + 1
+
+  std::vector<NodeId> m_dirty_nodes;
+  bool m_order_dirty = false;
+  bool m_all_dirty = false;
+
+  // Scratch, reused across updates
+  std::vector<Range> m_ranges;
+  std::vector<Range> m_next_ranges;
+
+  Index child_end(Index i) const;
+  void rebuild_order();
+};
+
+} // namespace rei
+
+#endif
@@ -0,0 +1,391 @@
+// source of sdf.h
+#include "sdf.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <istream>
+#include <limits>
+#include <ostream>
+
+#include "debug.h"
+#include "parallel.h"
+#include "rmath.h"
+
+using std::int16_t;
+using std::int32_t;
+using std::uint32_t;
+using std::vector;
+
+namespace rei {
+
+namespace {
+
+// Three non-axis-aligned directions, to avoid grazing mesh edges on axis-aligned geometry
+const Vec3 k_parity_dirs[3] = {
+  Vec3(0.8527, 0.3261, 0.4081),
+  Vec3(-0.2417, 0.9173, -0.3165),
+  Vec3(0.3307, -0.4290, -0.8406),
+};
+
+bool inside_by_parity(const TriangleBVH& bvh, const Vec3& p) {
+  const double inf = std::numeric_limits<double>::infinity();
+  int votes = 0;
+  for (const Vec3& dir : k_parity_dirs) {
+    if (bvh.count_intersections(p, dir, inf) % 2 == 1) votes++;
+  }
+  return votes >= 2;
+}
+
+// Generalized winding number (Jacobson et al. 2013); ~1 inside, ~0 outside
+bool inside_by_winding_number(const TriangleBVH& bvh, const Vec3& p) {
+  double total = 0;
+  const size_t tri_num = bvh.triangle_num();
+  for (size_t t = 0; t < tri_num; t++) {
+    TriangleBVH::TriangleId tri = TriangleBVH::TriangleId(t);
+    Vec3 a = bvh.vertex(tri, 0) - p, b = bvh.vertex(tri, 1) - p, c = bvh.vertex(tri, 2) - p;
+    double la = a.norm(), lb = b.norm(), lc = c.norm();
+    // Van Oosterom-Strackee solid angle
+    double num = dot(a, cross(b, c));
+    double den = la * lb * lc + dot(a, b) * lc + dot(b, c) * la + dot(c, a) * lb;
+    total += 2.0 * std::atan2(num, den);
+  }
+  return total / (4.0 * pi) > 0.5;
+}
+
+double signed_distance_to(const TriangleBVH& bvh, SignedDistanceField::SignMethod method,
+  const Vec3& p, double max_distance) {
+  TriangleBVH::ClosestPoint closest;
+  double d = bvh.closest_point(p, max_distance, closest) ? std::sqrt(closest.distance2)
+                                                         : max_distance;
+  bool inside = (method == SignedDistanceField::SignMethod::WindingNumber)
+                  ? inside_by_winding_number(bvh, p)
+                  : inside_by_parity(bvh, p);
+  return inside ? -d : d;
+}
+
+struct FileHeader {
+  char magic[4];
+  uint32_t version;
+  double origin[3];
+  double voxel_size;
+  int32_t dims[3];
+  uint32_t dense_brick_num;
+  float quantize_scale; // sample = int16 * quantize_scale
+  uint32_t reserved;
+};
+
+constexpr char k_magic[4] = {'R', 'S', 'D', 'F'};
+constexpr uint32_t k_version = 1;
+
+// Sanity limits for reading, well beyond what bake() is used for: up to 4096 cells along an axis
+// and 2^20 bricks in all (at most 1 GiB of quantized samples)
+constexpr int32_t k_max_dim = 4096 / SignedDistanceField::k_brick_cells + 1;
+constexpr size_t k_max_brick_num = size_t(1) << 20;
+
+// Bytes between the read position and the end of `is`, or -1 if the stream cannot seek
+std::streamoff bytes_left(std::istream& is) {
+  const std::streampos pos = is.tellg();
+  if (pos == std::streampos(-1)) return -1;
+  is.seekg(0, std::ios::end);
+  const std::streampos end = is.tellg();
+  is.seekg(pos);
+  if (end == std::streampos(-1) || !is) {
+    is.clear();
+    is.seekg(pos);
+    return -1;
+  }
+  return end - pos;
+}
+
+} // namespace
+
+SignedDistanceField SignedDistanceField::bake(const Mesh& mesh, const BakeOptions& options) {
+  TriangleBVH bvh;
+  bvh.build(mesh);
+  return bake(bvh, options);
+}
+
+SignedDistanceField SignedDistanceField::bake(const TriangleBVH& bvh, const BakeOptions& options) {
+  SignedDistanceField sdf;
+  if (bvh.empty()) {
+    REI_WARNING("Baking SDF from an empty mesh");
+    return sdf;
+  }
+  REI_ASSERT(options.resolution > 0);
+
+  // Grid placement
+  Aabb bounds = bvh.bounds();
+  const double longest = (std::max)({bounds.extent().x, bounds.extent().y, bounds.extent().z});
+  const double voxel = longest / (std::max)(options.resolution - 2 * options.padding, 1.0);
+  bounds.inflate(options.padding * voxel);
+  sdf.m_voxel_size = voxel;
+  sdf.m_origin = bounds.min;
+  for (int i = 0; i < 3; i++) {
+    int cells = int(std::ceil(bounds.extent()[i] / voxel));
+    sdf.m_dims[i] = (std::max)(1, (cells + k_brick_cells - 1) / k_brick_cells);
+  }
+  const size_t brick_num = size_t(sdf.m_dims[0]) * sdf.m_dims[1] * sdf.m_dims[2];
+  sdf.m_brick_table.assign(brick_num, k_coarse_brick);
+  sdf.m_brick_center_distance.assign(brick_num, 0.f);
+
+  // Classify bricks by their center distance, in parallel
+  const double half_diag = 0.5 * k_brick_cells * voxel * std::sqrt(3.0);
+  const double band = options.narrow_band * voxel;
+  const double far_distance = longest * 4 + half_diag;
+  parallel_for(0, brick_num, 16, [&](size_t i) {
+    int x = int(i % sdf.m_dims[0]);
+    int y = int((i / sdf.m_dims[0]) % sdf.m_dims[1]);
+    int z = int(i / (size_t(sdf.m_dims[0]) * sdf.m_dims[1]));
+    Vec3 center = sdf.brick_center(x, y, z);
+    double d = signed_distance_to(bvh, options.sign_method, center, far_distance);
+    sdf.m_brick_center_distance[i] = float(d);
+  });
+
+  // Allocate dense bricks for the narrow band (serial, to keep the pool order deterministic)
+  vector<size_t> dense_bricks;
+  for (size_t i = 0; i < brick_num; i++) {
+    if (std::abs(sdf.m_brick_center_distance[i]) <= half_diag + band) {
+      sdf.m_brick_table[i] = int32_t(dense_bricks.size());
+      dense_bricks.push_back(i);
+    }
+  }
+  sdf.m_samples.resize(dense_bricks.size() * k_brick_sample_num);
+
+  // Fill dense bricks; each brick sample is independent
+  const double sample_max_distance = 2 * half_diag + band;
+  parallel_for(0, dense_bricks.size() * k_brick_samples, 4, [&](size_t job) {
+    const size_t dense = job / k_brick_samples;
+    const int sz = int(job % k_brick_samples);
+    const size_t i = dense_bricks[dense];
+    int bx = int(i % sdf.m_dims[0]);
+    int by = int((i / sdf.m_dims[0]) % sdf.m_dims[1]);
+    int bz = int(i / (size_t(sdf.m_dims[0]) * sdf.m_dims[1]));
+    float* out = sdf.m_samples.data() + dense * k_brick_sample_num
+                 + size_t(sz) * k_brick_samples * k_brick_samples;
+    for (int sy = 0; sy < k_brick_samples; sy++) {
+      for (int sx = 0; sx < k_brick_samples; sx++) {
+        Vec3 p = sdf.m_origin
+                 + Vec3(bx * k_brick_cells + sx, by * k_brick_cells + sy, bz * k_brick_cells + sz)
+                     * voxel;
+        double d = signed_distance_to(bvh, options.sign_method, p, sample_max_distance);
+        out[sy * k_brick_samples + sx] = float(d);
+      }
+    }
+  });
+
+  return sdf;
+}
+
+Vec3 SignedDistanceField::brick_center(int x, int y, int z) const {
+  const double half = 0.5 * k_brick_cells;
+  return m_origin
+         + Vec3(x * k_brick_cells + half, y * k_brick_cells + half, z * k_brick_cells + half)
+             * m_voxel_size;
+}
+
+Aabb SignedDistanceField::bounds() const {
+  if (empty()) return Aabb();
+  Vec3 size(m_dims[0], m_dims[1], m_dims[2]);
+  return Aabb(m_origin, m_origin + size * (k_brick_cells * m_voxel_size));
+}
+
+size_t SignedDistanceField::memory_bytes() const {
+  return m_brick_table.size() * sizeof(int32_t) + m_brick_center_distance.size() * sizeof(float)
+         + m_samples.size() * sizeof(float);
+}
+
+double SignedDistanceField::distance(const Vec3& p) const {
+  if (empty()) return (std::numeric_limits<double>::max)();
+
+  // Clamp into the volume; the extra distance keeps the result a lower bound
+  const Aabb box = bounds();
+  Vec3 q = p;
+  for (int i = 0; i < 3; i++)
+    q[i] = (std::min)((std::max)(q[i], box.min[i]), box.max[i]);
+  const double outside = (p - q).norm();
+
+  Vec3 g = (q - m_origin) * (1.0 / m_voxel_size);
+  int b[3];
+  double local[3];
+  for (int i = 0; i < 3; i++) {
+    b[i] = (std::min)(int(g[i] / k_brick_cells), m_dims[i] - 1);
+    local[i] = (std::min)((std::max)(g[i] - b[i] * k_brick_cells, 0.0), double(k_brick_cells));
+  }
+
+  const size_t brick = brick_index(b[0], b[1], b[2]);
+  const int32_t dense = m_brick_table[brick];
+  if (dense == k_coarse_brick) {
+    // Lipschitz bound from the brick center
+    const double dc = m_brick_center_distance[brick];
+    const double r = (q - brick_center(b[0], b[1], b[2])).norm();
+    const double bound = (std::max)(std::abs(dc) - r, 0.0);
+    return (dc < 0 ? -bound : bound) + outside;
+  }
+
+  // Trilinear interpolation inside the brick
+  int i0[3];
+  double f[3];
+  for (int i = 0; i < 3; i++) {
+    i0[i] = (std::min)(int(local[i]), k_brick_cells - 1);
+    f[i] = local[i] - i0[i];
+  }
+  const float* s = m_samples.data() + size_t(dense) * k_brick_sample_num;
+  auto at = [&](int x, int y, int z) {
+    return double(s[(z * k_brick_samples + y) * k_brick_samples + x]);
+  };
+  double c00 = at(i0[0], i0[1], i0[2]) * (1 - f[0]) + at(i0[0] + 1, i0[1], i0[2]) * f[0];
+  double c10 = at(i0[0], i0[1] + 1, i0[2]) * (1 - f[0]) + at(i0[0] + 1, i0[1] + 1, i0[2]) * f[0];
+  double c01 = at(i0[0], i0[1], i0[2] + 1) * (1 - f[0]) + at(i0[0] + 1, i0[1], i0[2] + 1) * f[0];
+  double c11
+    = at(i0[0], i0[1] + 1, i0[2] + 1) * (1 - f[0]) + at(i0[0] + 1, i0[1] + 1, i0[2] + 1) * f[0];
+  double c0 = c00 * (1 - f[1]) + c10 * f[1];
+  double c1 = c01 * (1 - f[1]) + c11 * f[1];
+  return c0 * (1 - f[2]) + c1 * f[2] + outside;
+}
+
+Vec3 SignedDistanceField::gradient(const Vec3& p) const {
+  const double h = 0.5 * m_voxel_size;
+  return Vec3(distance(p + Vec3(h, 0, 0)) - distance(p - Vec3(h, 0, 0)),
+    distance(p + Vec3(0, h, 0)) - distance(p - Vec3(0, h, 0)),
+    distance(p + Vec3(0, 0, h)) - distance(p - Vec3(0, 0, h)));
+}
+
+bool SignedDistanceField::trace(
+  const Vec3& origin, const Vec3& dir, double t_max, double& t_hit, int max_steps) const {
+  if (empty()) return false;
+  const double epsilon = 0.25 * m_voxel_size;
+  double t = 0;
+  for (int step = 0; step < max_steps && t < t_max; step++) {
+    double d = distance(origin + dir * t);
+    if (d < epsilon) {
+      t_hit = t;
+      return true;
+    }
+    t += d;
+  }
+  return false;
+}
+
+double SignedDistanceField::soft_shadow(const Vec3& origin, const Vec3& dir, double t_min,
+  double t_max, double k, int max_steps) const {
+  if (empty()) return 1.0;
+  // Ref: https://iquilezles.org/articles/rmshadows/
+  const double epsilon = 0.25 * m_voxel_size;
+  double shadow = 1.0;
+  double t = t_min;
+  for (int step = 0; step < max_steps && t < t_max; step++) {
+    double d = distance(origin + dir * t);
+    if (d < epsilon) return 0.0;
+    shadow = (std::min)(shadow, k * d / t);
+    t += (std::max)(d, epsilon);
+  }
+  return (std::min)((std::max)(shadow, 0.0), 1.0);
+}
+
+double SignedDistanceField::occlusion(
+  const Vec3& p, const Vec3& normal, int steps, double step_size) const {
+  if (empty()) return 1.0;
+  if (step_size <= 0) step_size = 2 * m_voxel_size;
+  double occ = 0;
+  double weight = 1.0;
+  for (int i = 1; i <= steps; i++) {
+    double h = step_size * i;
+    double d = distance(p + normal * h);
+    occ += weight * (std::max)(h - d, 0.0) / h;
+    weight *= 0.5;
+  }
+  return (std::min)((std::max)(1.0 - occ, 0.0), 1.0);
+}
+
+bool SignedDistanceField::write(std::ostream& os) const {
+  FileHeader header {};
+  std::memcpy(header.magic, k_magic, 4);
+  header.version = k_version;
+  for (int i = 0; i < 3; i++) {
+    header.origin[i] = m_origin[i];
+    header.dims[i] = m_dims[i];
+  }
+  header.voxel_size = m_voxel_size;
+  header.dense_brick_num = uint32_t(dense_brick_num());
+
+  float max_abs = 0;
+  for (float s : m_samples)
+    max_abs = (std::max)(max_abs, std::abs(s));
+  header.quantize_scale = max_abs > 0 ? max_abs / 32767.f : 1.f;
+
+  os.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  os.write(reinterpret_cast<const char*>(m_brick_table.data()),
+    m_brick_table.size() * sizeof(int32_t));
+  os.write(reinterpret_cast<const char*>(m_brick_center_distance.data()),
+    m_brick_center_distance.size() * sizeof(float));
+
+  vector<int16_t> quantized(m_samples.size());
+  const float inv_scale = 1.f / header.quantize_scale;
+  for (size_t i = 0; i < m_samples.size(); i++)
+    quantized[i] = int16_t(std::lround(m_samples[i] * inv_scale));
+  os.write(reinterpret_cast<const char*>(quantized.data()), quantized.size() * sizeof(int16_t));
+
+  return bool(os);
+}
+
+bool SignedDistanceField::read(std::istream& is) {
+  FileHeader header {};
+  if (!is.read(reinterpret_cast<char*>(&header), sizeof(header))) return false;
+  if (std::memcmp(header.magic, k_magic, 4) != 0 || header.version != k_version) {
+    REI_WARNING("Invalid SDF file header");
+    return false;
+  }
+
+  // Validate every size before allocating for it
+  for (int i = 0; i < 3; i++) {
+    if (header.dims[i] <= 0 || header.dims[i] > k_max_dim) {
+      REI_WARNING("Invalid SDF dimensions");
+      return false;
+    }
+  }
+  const size_t brick_num = size_t(header.dims[0]) * header.dims[1] * header.dims[2];
+  if (brick_num > k_max_brick_num || header.dense_brick_num > brick_num
+      || !(header.voxel_size > 0) || !std::isfinite(header.quantize_scale)) {
+    REI_WARNING("Invalid SDF file header");
+    return false;
+  }
+  const size_t payload_bytes = brick_num * (sizeof(int32_t) + sizeof(float))
+                               + size_t(header.dense_brick_num) * k_brick_sample_num
+                                   * sizeof(int16_t);
+  const std::streamoff available = bytes_left(is);
+  if (available >= 0 && size_t(available) < payload_bytes) {
+    REI_WARNING("Truncated SDF file");
+    return false;
+  }
+
+  SignedDistanceField sdf;
+  for (int i = 0; i < 3; i++) {
+    sdf.m_origin[i] = header.origin[i];
+    sdf.m_dims[i] = header.dims[i];
+  }
+  sdf.m_voxel_size = header.voxel_size;
+  sdf.m_brick_table.resize(brick_num);
+  sdf.m_brick_center_distance.resize(brick_num);
+  is.read(reinterpret_cast<char*>(sdf.m_brick_table.data()), brick_num * sizeof(int32_t));
+  is.read(reinterpret_cast<char*>(sdf.m_brick_center_distance.data()), brick_num * sizeof(float));
+
+  vector<int16_t> quantized(size_t(header.dense_brick_num) * k_brick_sample_num);
+  is.read(reinterpret_cast<char*>(quantized.data()), quantized.size() * sizeof(int16_t));
+  if (!is) return false;
+  sdf.m_samples.resize(quantized.size());
+  for (size_t i = 0; i < quantized.size(); i++)
+    sdf.m_samples[i] = quantized[i] * header.quantize_scale;
+
+  for (int32_t entry : sdf.m_brick_table) {
+    if (entry != k_coarse_brick && uint32_t(entry) >= header.dense_brick_num) {
+      REI_WARNING("Corrupted SDF brick table");
+      return false;
+    }
+  }
+
+  *this = std::move(sdf);
+  return true;
+}
+
+} // namespace rei
@@ -0,0 +1,99 @@
+#ifndef REI_SDF_H
+#define REI_SDF_H
+
+#include <cstdint>
+#include <iosfwd>
+#include <vector>
+
+#include "aabb.h"
+#include "algebra.h"
+#include "bvh.h"
+#include "geometry.h"
+
+/*
+ * sdf.h
+ * Sparse, brick-based signed distance field baked from triangle meshes, with CPU sphere-tracing
+ * queries for soft shadows and ambient occlusion.
+ */
+
+namespace rei {
+
+/*
+ * The volume is split into bricks of 7^3 cells (8^3 samples, so a brick interpolates on its
+ * own). Only bricks intersecting the narrow band around the surface store samples; every
+ * other brick keeps a single signed distance at its center, which still gives a conservative
+ * step size for sphere tracing.
+ */
+class SignedDistanceField {
+public:
+  static constexpr int k_brick_cells = 7;
+  static constexpr int k_brick_samples = k_brick_cells + 1;
+  static constexpr int k_brick_sample_num = k_brick_samples * k_brick_samples * k_brick_samples;
+
+  enum class SignMethod {
+    RayParity,     // majority vote of 3 ray crossing counts; needs a closed mesh
+    WindingNumber, // generalized winding number; robust to holes, O(triangles) per sample
+  };
+
+  struct BakeOptions {
+    int resolution = 64;      // cells along the longest axis of the padded bounds
+    double narrow_band = 2.0; // in cells; bricks farther from the surface are stored coarse
+    double padding = 2.0;     // in cells, added around the mesh bounds
+    SignMethod sign_method = SignMethod::RayParity;
+  };
+
+  SignedDistanceField() = default;
+
+  static SignedDistanceField bake(const Mesh& mesh, const BakeOptions& options);
+  static SignedDistanceField bake(const TriangleBVH& bvh, const BakeOptions& options);
+  static SignedDistanceField bake(const Mesh& mesh) { return bake(mesh, BakeOptions()); }
+
+  bool empty() const { return m_brick_table.empty(); }
+  Aabb bounds() const;
+  double voxel_size() const { return m_voxel_size; }
+  size_t brick_num() const { return m_brick_table.size(); }
+  size_t dense_brick_num() const { return m_samples.size() / k_brick_sample_num; }
+  size_t memory_bytes() const;
+
+  // Signed distance (negative inside). Outside the dense band the value is a conservative
+  // lower bound of the true distance, which is what sphere tracing needs.
+  double distance(const Vec3& p) const;
+  // Central-difference gradient; not normalized
+  Vec3 gradient(const Vec3& p) const;
+
+  // Sphere tracing; return true and the hit distance if the surface is reached within t_max
+  bool trace(const Vec3& origin, const Vec3& dir, double t_max, double& t_hit,
+    int max_steps = 128) const;
+  // Soft shadow factor in [0, 1] (1 is fully lit); `k` controls penumbra sharpness
+  double soft_shadow(const Vec3& origin, const Vec3& dir, double t_min, double t_max,
+    double k = 8.0, int max_steps = 64) const;
+  // Ambient occlusion estimate in [0, 1] (1 is unoccluded), sampled along the normal
+  double occlusion(const Vec3& p, const Vec3& normal, int steps = 5, double step_size = 0) const;
+
+  // Compact binary serialization; samples are quantized to 16 bits
+  bool write(std::ostream& os) const;
+  bool read(std::istream& is);
+
+private:
+  Vec3 m_origin;
+  double m_voxel_size = 0;
+  int m_dims[3] = {0, 0, 0}; // in bricks
+
+  // Per brick: index into the dense brick pool, or k_coarse_brick
+  std::vector<std::int32_t> m_brick_table;
+  // Per brick: signed distance at the brick center
+  std::vector<float> m_brick_center_distance;
+  // Dense brick pool, k_brick_sample_num samples each, x-major
+  std::vector<float> m_samples;
+
+  static constexpr std::int32_t k_coarse_brick = -1;
+
+  size_t brick_index(int x, int y, int z) const {
+    return (size_t(z) * m_dims[1] + y) * m_dims[0] + x;
+  }
+  Vec3 brick_center(int x, int y, int z) const;
+};
+
+} // namespace rei
+
+#endif
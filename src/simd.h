@@ -0,0 +1,175 @@
+#ifndef REI_SIMD_H
+#define REI_SIMD_H
+
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define REI_SIMD_SSE 1
+#include <emmintrin.h>
+#else
+#define REI_SIMD_SSE 0
+#endif
+
+/*
+ * simd.h
+ * Thin 4-wide float and 2-wide double vectors, mapped to SSE when available and to scalar code
+ * otherwise.
+ * Only what the CPU-side geometry kernels need; not a general math library.
+ * (min/max are named vmin/vmax to stay clear of the windows.h macros.)
+ */
+
+namespace rei {
+
+struct alignas(16) Float4 {
+#if REI_SIMD_SSE
+  __m128 v;
+
+  Float4() : v(_mm_setzero_ps()) {}
+  Float4(__m128 v) : v(v) {}
+  explicit Float4(float s) : v(_mm_set1_ps(s)) {}
+  Float4(float x, float y, float z, float w) : v(_mm_setr_ps(x, y, z, w)) {}
+
+  static Float4 load(const float* p) { return _mm_loadu_ps(p); }
+  void store(float* p) const { _mm_storeu_ps(p, v); }
+
+  friend Float4 operator+(Float4 a, Float4 b) { return _mm_add_ps(a.v, b.v); }
+  friend Float4 operator-(Float4 a, Float4 b) { return _mm_sub_ps(a.v, b.v); }
+  friend Float4 operator*(Float4 a, Float4 b) { return _mm_mul_ps(a.v, b.v); }
+  friend Float4 operator/(Float4 a, Float4 b) { return _mm_div_ps(a.v, b.v); }
+  friend Float4 vmin(Float4 a, Float4 b) { return _mm_min_ps(a.v, b.v); }
+  friend Float4 vmax(Float4 a, Float4 b) { return _mm_max_ps(a.v, b.v); }
+  friend Float4 sqrt(Float4 a) { return _mm_sqrt_ps(a.v); }
+  friend Float4 abs(Float4 a) { return _mm_andnot_ps(_mm_set1_ps(-0.f), a.v); }
+
+  // Comparisons return lane masks; use with `mask_bits`, `select`
+  friend Float4 operator<(Float4 a, Float4 b) { return _mm_cmplt_ps(a.v, b.v); }
+  friend Float4 operator<=(Float4 a, Float4 b) { return _mm_cmple_ps(a.v, b.v); }
+  friend Float4 operator>(Float4 a, Float4 b) { return _mm_cmpgt_ps(a.v, b.v); }
+  friend Float4 operator>=(Float4 a, Float4 b) { return _mm_cmpge_ps(a.v, b.v); }
+  friend Float4 operator&(Float4 a, Float4 b) { return _mm_and_ps(a.v, b.v); }
+  friend Float4 operator|(Float4 a, Float4 b) { return _mm_or_ps(a.v, b.v); }
+
+  // Bit i is set if lane i of the mask is set
+  friend int mask_bits(Float4 m) { return _mm_movemask_ps(m.v); }
+  // Lane-wise (mask ? a : b)
+  friend Float4 select(Float4 m, Float4 a, Float4 b) {
+    return _mm_or_ps(_mm_and_ps(m.v, a.v), _mm_andnot_ps(m.v, b.v));
+  }
+
+  float operator[](int i) const {
+    alignas(16) float f[4];
+    _mm_store_ps(f, v);
+    return f[i];
+  }
+#else
+  float f[4];
+
+  Float4() : f {0, 0, 0, 0} {}
+  explicit Float4(float s) : f {s, s, s, s} {}
+  Float4(float x, float y, float z, float w) : f {x, y, z, w} {}
+
+  static Float4 load(const float* p) { return Float4(p[0], p[1], p[2], p[3]); }
+  void store(float* p) const {
+    for (int i = 0; i < 4; i++)
+      p[i] = f[i];
+  }
+
+  template <typename Op>
+  static Float4 map(Float4 a, Float4 b, Op op) {
+    return Float4(
+      op(a.f[0], b.f[0]), op(a.f[1], b.f[1]), op(a.f[2], b.f[2]), op(a.f[3], b.f[3]));
+  }
+  static float mask_of(bool b) {
+    union {
+      unsigned u;
+      float f;
+    } m = {b ? 0xFFFFFFFFu : 0u};
+    return m.f;
+  }
+  static bool is_set(float f) { return std::signbit(f); }
+
+// Lane-wise binary operation, scalar path
+#define REI_FLOAT4_LANEWISE(name, expr) \
+  friend Float4 name(Float4 a, Float4 b) { \
+    return map(a, b, [](float x, float y) { return expr; }); \
+  }
+
+  REI_FLOAT4_LANEWISE(operator+, x + y)
+  REI_FLOAT4_LANEWISE(operator-, x - y)
+  REI_FLOAT4_LANEWISE(operator*, x * y)
+  REI_FLOAT4_LANEWISE(operator/, x / y)
+  REI_FLOAT4_LANEWISE(vmin, x < y ? x : y)
+  REI_FLOAT4_LANEWISE(vmax, x > y ? x : y)
+  REI_FLOAT4_LANEWISE(operator<, mask_of(x < y))
+  REI_FLOAT4_LANEWISE(operator<=, mask_of(x <= y))
+  REI_FLOAT4_LANEWISE(operator>, mask_of(x > y))
+  REI_FLOAT4_LANEWISE(operator>=, mask_of(x >= y))
+  REI_FLOAT4_LANEWISE(operator&, mask_of(is_set(x) && is_set(y)))
+  REI_FLOAT4_LANEWISE(operator|, mask_of(is_set(x) || is_set(y)))
+#undef REI_FLOAT4_LANEWISE
+
+  friend Float4 sqrt(Float4 a) { return map(a, a, [](float x, float) { return std::sqrt(x); }); }
+  friend Float4 abs(Float4 a) { return map(a, a, [](float x, float) { return std::abs(x); }); }
+
+  friend int mask_bits(Float4 m) {
+    return (is_set(m.f[0]) ? 1 : 0) | (is_set(m.f[1]) ? 2 : 0) | (is_set(m.f[2]) ? 4 : 0)
+           | (is_set(m.f[3]) ? 8 : 0);
+  }
+  friend Float4 select(Float4 m, Float4 a, Float4 b) {
+    return Float4(is_set(m.f[0]) ? a.f[0] : b.f[0], is_set(m.f[1]) ? a.f[1] : b.f[1],
+      is_set(m.f[2]) ? a.f[2] : b.f[2], is_set(m.f[3]) ? a.f[3] : b.f[3]);
+  }
+
+  float operator[](int i) const { return f[i]; }
+#endif
+
+  Float4& operator+=(Float4 b) { return *this = *this + b; }
+  Float4& operator-=(Float4 b) { return *this = *this - b; }
+  Float4& operator*=(Float4 b) { return *this = *this * b; }
+
+  // Fused-looking multiply-add; plain mul+add on SSE2
+  friend Float4 madd(Float4 a, Float4 b, Float4 c) { return a * b + c; }
+};
+
+/*
+ * 2-wide double vector, for kernels that must round exactly like the scalar double code they
+ * replace: every lane does the same IEEE operations in the same order (no fused multiply-add).
+ */
+struct alignas(16) Double2 {
+#if REI_SIMD_SSE
+  __m128d v;
+
+  Double2() : v(_mm_setzero_pd()) {}
+  Double2(__m128d v) : v(v) {}
+  explicit Double2(double s) : v(_mm_set1_pd(s)) {}
+  Double2(double x, double y) : v(_mm_setr_pd(x, y)) {}
+
+  friend Double2 operator+(Double2 a, Double2 b) { return _mm_add_pd(a.v, b.v); }
+  friend Double2 operator-(Double2 a, Double2 b) { return _mm_sub_pd(a.v, b.v); }
+  friend Double2 operator*(Double2 a, Double2 b) { return _mm_mul_pd(a.v, b.v); }
+  friend Double2 operator/(Double2 a, Double2 b) { return _mm_div_pd(a.v, b.v); }
+  friend Double2 sqrt(Double2 a) { return _mm_sqrt_pd(a.v); }
+
+  double lo() const { return _mm_cvtsd_f64(v); }
+  double hi() const { return _mm_cvtsd_f64(_mm_unpackhi_pd(v, v)); }
+#else
+  double d[2];
+
+  Double2() : d {0, 0} {}
+  explicit Double2(double s) : d {s, s} {}
+  Double2(double x, double y) : d {x, y} {}
+
+  friend Double2 operator+(Double2 a, Double2 b) { return {a.d[0] + b.d[0], a.d[1] + b.d[1]}; }
+  friend Double2 operator-(Double2 a, Double2 b) { return {a.d[0] - b.d[0], a.d[1] - b.d[1]}; }
+  friend Double2 operator*(Double2 a, Double2 b) { return {a.d[0] * b.d[0], a.d[1] * b.d[1]}; }
+  friend Double2 operator/(Double2 a, Double2 b) { return {a.d[0] / b.d[0], a.d[1] / b.d[1]}; }
+  friend Double2 sqrt(Double2 a) { return {std::sqrt(a.d[0]), std::sqrt(a.d[1])}; }
+
+  double lo() const { return d[0]; }
+  double hi() const { return d[1]; }
+#endif
+};
+
+} // namespace rei
+
+#endif
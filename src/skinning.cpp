@@ -0,0 +1,278 @@
+// source of skinning.h
+#include "skinning.h"
+
+#include <cmath>
+#include <unordered_map>
+
+#include "debug.h"
+#include "parallel.h"
+#include "simd.h"
+
+using std::uint32_t;
+using std::vector;
+
+namespace rei {
+
+void SkinPalette::set(const Mat4* transforms, size_t bone_num, SkinningMethod method) {
+  matrices.resize(bone_num);
+  for (size_t i = 0; i < bone_num; i++) {
+    BoneMatrix& m = matrices[i];
+    for (int c = 0; c < 4; c++) {
+      for (int r = 0; r < 3; r++)
+        m.columns[c][r] = float(transforms[i](r, c));
+      m.columns[c][3] = 0.f;
+    }
+  }
+  if (method != SkinningMethod::DualQuaternion) {
+    dual_quats.clear();
+    return;
+  }
+  // The dual part is half the translation (as a pure quaternion) times the rotation
+  dual_quats.resize(bone_num);
+  for (size_t i = 0; i < bone_num; i++) {
+    const Trs trs = Trs::decompose(transforms[i]);
+    const Quat& r = trs.rotation;
+    const Quat d = Quat(trs.translation.x, trs.translation.y, trs.translation.z, 0) * r * 0.5;
+    for (int k = 0; k < 4; k++) {
+      dual_quats[i].real[k] = float(r[k]);
+      dual_quats[i].dual[k] = float(d[k]);
+    }
+  }
+}
+
+// SkinnedMesh ///////////////////////////////////////////////////////////////
+
+SkinnedMesh::SkinnedMesh(std::shared_ptr<const Mesh> mesh) : m_mesh(std::move(mesh)) {
+  REI_ASSERT(m_mesh && m_mesh->skinned());
+  const auto& vertices = m_mesh->get_vertices();
+  const auto& weights = m_mesh->get_bone_weights();
+  m_vertices.resize(vertices.size());
+  parallel_for(0, vertices.size(), 4096, [&](size_t i) {
+    const Mesh::Vertex& src = vertices[i];
+    Vertex& v = m_vertices[i];
+    for (int k = 0; k < 3; k++) {
+      v.position[k] = float(src.coord[k]);
+      v.normal[k] = float(src.normal[k]);
+    }
+    v.position[3] = 1.f;
+    v.normal[3] = 0.f;
+    // Unused slots point at bone 0 with no weight, so the kernels blend 4 bones unconditionally
+    for (int k = 0; k < 4; k++) {
+      v.weights[k] = weights[i].weights[k];
+      v.bones[k] = v.weights[k] != 0 ? weights[i].bones[k] : 0;
+    }
+  });
+}
+
+// Kernels ///////////////////////////////////////////////////////////////////
+
+namespace {
+
+// Columns of a blended affine matrix; the 4th lanes are zero
+struct Columns {
+  Float4 c[4];
+};
+
+inline Columns blend_matrices(const SkinnedMesh::Vertex& v, const BoneMatrix* palette) {
+  Columns m;
+  const BoneMatrix& first = palette[v.bones[0]];
+  const Float4 w0(v.weights[0]);
+  for (int c = 0; c < 4; c++)
+    m.c[c] = Float4::load(first.columns[c]) * w0;
+  for (int i = 1; i < 4; i++) {
+    const BoneMatrix& bone = palette[v.bones[i]];
+    const Float4 w(v.weights[i]);
+    for (int c = 0; c < 4; c++)
+      m.c[c] = madd(Float4::load(bone.columns[c]), w, m.c[c]);
+  }
+  return m;
+}
+
+inline float dot4(const float* a, const float* b) {
+  return a[0] * b[0] + a[1] * b[1] + a[2] * b[2] + a[3] * b[3];
+}
+
+// Blend in the hemisphere of the first bone (q and -q are the same rotation), normalize, and
+// expand to a matrix so the transform is shared with the linear kernel
+inline Columns blend_dual_quats(const SkinnedMesh::Vertex& v, const BoneDualQuat* palette) {
+  const BoneDualQuat& first = palette[v.bones[0]];
+  const Float4 w0(v.weights[0]);
+  Float4 real = Float4::load(first.real) * w0;
+  Float4 dual = Float4::load(first.dual) * w0;
+  for (int i = 1; i < 4; i++) {
+    const BoneDualQuat& bone = palette[v.bones[i]];
+    const Float4 w(dot4(first.real, bone.real) < 0 ? -v.weights[i] : v.weights[i]);
+    real = madd(Float4::load(bone.real), w, real);
+    dual = madd(Float4::load(bone.dual), w, dual);
+  }
+  alignas(16) float r[4], d[4];
+  real.store(r);
+  dual.store(d);
+  const float inv_norm = 1.f / std::sqrt(dot4(r, r));
+  const float x = r[0] * inv_norm, y = r[1] * inv_norm, z = r[2] * inv_norm, w = r[3] * inv_norm;
+  const float dx = d[0] * inv_norm, dy = d[1] * inv_norm, dz = d[2] * inv_norm;
+  const float dw = d[3] * inv_norm;
+  // translation = 2 * (w * dual.xyz - dual.w * real.xyz + cross(real.xyz, dual.xyz))
+  const float tx = 2.f * (w * dx - dw * x + (y * dz - z * dy));
+  const float ty = 2.f * (w * dy - dw * y + (z * dx - x * dz));
+  const float tz = 2.f * (w * dz - dw * z + (x * dy - y * dx));
+  Columns m;
+  m.c[0] = Float4(1.f - 2.f * (y * y + z * z), 2.f * (x * y + w * z), 2.f * (x * z - w * y), 0.f);
+  m.c[1] = Float4(2.f * (x * y - w * z), 1.f - 2.f * (x * x + z * z), 2.f * (y * z + w * x), 0.f);
+  m.c[2] = Float4(2.f * (x * z + w * y), 2.f * (y * z - w * x), 1.f - 2.f * (x * x + y * y), 0.f);
+  m.c[3] = Float4(tx, ty, tz, 0.f);
+  return m;
+}
+
+inline void transform_vertex(
+  const Columns& m, const SkinnedMesh::Vertex& v, PackedMesh::Vertex& out) {
+  const Float4 p = madd(m.c[0], Float4(v.position[0]),
+    madd(m.c[1], Float4(v.position[1]), madd(m.c[2], Float4(v.position[2]), m.c[3])));
+  p.store(out.position);
+  out.position[3] = 1.f;
+  const Float4 n = madd(m.c[0], Float4(v.normal[0]),
+    madd(m.c[1], Float4(v.normal[1]), m.c[2] * Float4(v.normal[2])));
+  alignas(16) float nf[4];
+  n.store(nf);
+  const float inv_norm = 1.f / std::sqrt(nf[0] * nf[0] + nf[1] * nf[1] + nf[2] * nf[2]);
+  out.normal[0] = nf[0] * inv_norm;
+  out.normal[1] = nf[1] * inv_norm;
+  out.normal[2] = nf[2] * inv_norm;
+}
+
+} // namespace
+
+void skin_vertices(const SkinnedMesh& mesh, const SkinPalette& palette, SkinningMethod method,
+  PackedMesh::Vertex* out, size_t begin, size_t end) {
+  REI_ASSERT(end <= mesh.vertex_num() && palette.matrices.size() >= mesh.bone_num());
+  const SkinnedMesh::Vertex* vertices = mesh.vertices();
+  if (method == SkinningMethod::Linear) {
+    const BoneMatrix* bones = palette.matrices.data();
+    for (size_t i = begin; i < end; i++)
+      transform_vertex(blend_matrices(vertices[i], bones), vertices[i], out[i]);
+  } else {
+    REI_ASSERT(palette.dual_quats.size() >= mesh.bone_num());
+    const BoneDualQuat* bones = palette.dual_quats.data();
+    for (size_t i = begin; i < end; i++)
+      transform_vertex(blend_dual_quats(vertices[i], bones), vertices[i], out[i]);
+  }
+}
+
+// SkinInstance //////////////////////////////////////////////////////////////
+
+SkinInstance::SkinInstance(std::shared_ptr<const SkinnedMesh> mesh, SkinningMethod method)
+    : m_mesh(std::move(mesh)), m_method(method) {
+  const size_t bone_num = m_mesh->bone_num();
+  m_bone_nodes.assign(bone_num, SceneGraph::k_invalid_node);
+  m_pose.assign(bone_num, Mat4::I());
+  m_palette.set(m_pose.data(), bone_num, m_method);
+
+  // Start in the bind pose, with the colors that skinning never touches
+  const auto& src = m_mesh->mesh().get_vertices();
+  m_vertices.resize(src.size());
+  for (size_t i = 0; i < src.size(); i++) {
+    PackedMesh::Vertex& v = m_vertices[i];
+    for (int k = 0; k < 3; k++) {
+      v.position[k] = float(src[i].coord[k]);
+      v.normal[k] = float(src[i].normal[k]);
+    }
+    v.position[3] = 1.f;
+    const Color& c = src[i].color;
+    v.color[0] = c.r;
+    v.color[1] = c.g;
+    v.color[2] = c.b;
+    v.color[3] = c.a;
+  }
+}
+
+size_t SkinInstance::bind(const SceneGraph& graph, SceneGraph::NodeId mesh_node) {
+  m_mesh_node = mesh_node;
+  std::unordered_map<Name, SceneGraph::NodeId> node_of;
+  node_of.reserve(graph.size());
+  for (SceneGraph::NodeId node = 0; node < graph.size(); node++)
+    node_of.emplace(graph.name(node), node); // the first node of a name wins
+  const auto& bones = m_mesh->mesh().get_bones();
+  size_t found = 0;
+  for (size_t i = 0; i < bones.size(); i++) {
+    auto it = node_of.find(bones[i].name);
+    m_bone_nodes[i] = it != node_of.end() ? it->second : SceneGraph::k_invalid_node;
+    if (it != node_of.end()) found++;
+  }
+  return found;
+}
+
+void SkinInstance::update_palette(const SceneGraph& graph) {
+  const auto& bones = m_mesh->mesh().get_bones();
+  const Mat4 to_mesh
+    = m_mesh_node != SceneGraph::k_invalid_node ? graph.world(m_mesh_node).inv() : Mat4::I();
+  for (size_t i = 0; i < bones.size(); i++) {
+    const SceneGraph::NodeId node = m_bone_nodes[i];
+    m_pose[i] = node != SceneGraph::k_invalid_node ? to_mesh * graph.world(node) * bones[i].offset
+                                                   : Mat4::I();
+  }
+  m_palette.set(m_pose.data(), bones.size(), m_method);
+}
+
+void SkinInstance::set_pose(const Mat4* bone_transforms) {
+  const auto& bones = m_mesh->mesh().get_bones();
+  for (size_t i = 0; i < bones.size(); i++)
+    m_pose[i] = bone_transforms[i] * bones[i].offset;
+  m_palette.set(m_pose.data(), bones.size(), m_method);
+}
+
+void SkinInstance::enable_bvh() {
+  if (m_bvh) return;
+  vector<Vec3> positions(m_vertices.size());
+  for (size_t i = 0; i < m_vertices.size(); i++) {
+    const float* p = m_vertices[i].position;
+    positions[i] = Vec3(p[0], p[1], p[2]);
+  }
+  const auto& triangles = m_mesh->mesh().get_triangles();
+  vector<uint32_t> indices;
+  indices.reserve(triangles.size() * 3);
+  for (const Mesh::Triangle& t : triangles)
+    indices.insert(indices.end(), {uint32_t(t.a), uint32_t(t.b), uint32_t(t.c)});
+  m_bvh = std::make_unique<TriangleBVH>();
+  m_bvh->build(std::move(positions), std::move(indices));
+}
+
+// Batch /////////////////////////////////////////////////////////////////////
+
+void skin(SkinInstance* const* instances, size_t count, const SceneGraph* graph) {
+  if (graph)
+    parallel_for(0, count, 4, [&](size_t i) { instances[i]->update_palette(*graph); });
+
+  // Large meshes are split so a few big characters still spread over the pool; small ones are
+  // a chunk each, and parallel_for groups chunks into tasks
+  constexpr uint32_t k_chunk = 4096;
+  struct Chunk {
+    SkinInstance* instance;
+    uint32_t begin, end;
+  };
+  vector<Chunk> chunks;
+  chunks.reserve(count);
+  for (size_t i = 0; i < count; i++) {
+    const uint32_t n = uint32_t(instances[i]->m_vertices.size());
+    for (uint32_t b = 0; b < n; b += k_chunk)
+      chunks.push_back({instances[i], b, (std::min)(n, b + k_chunk)});
+  }
+  parallel_for(0, chunks.size(), 1, [&](size_t c) {
+    const Chunk& chunk = chunks[c];
+    SkinInstance& inst = *chunk.instance;
+    skin_vertices(*inst.m_mesh, inst.m_palette, inst.m_method, inst.m_vertices.data(),
+      chunk.begin, chunk.end);
+    if (inst.m_bvh) {
+      vector<Vec3>& positions = inst.m_bvh->positions();
+      for (uint32_t v = chunk.begin; v < chunk.end; v++) {
+        const float* p = inst.m_vertices[v].position;
+        positions[v] = Vec3(p[0], p[1], p[2]);
+      }
+    }
+  });
+
+  parallel_for(0, count, 1, [&](size_t i) {
+    if (instances[i]->m_bvh) instances[i]->m_bvh->refit();
+  });
+}
+
+} // namespace rei
@@ -0,0 +1,137 @@
+#ifndef REI_SKINNING_H
+#define REI_SKINNING_H
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "algebra.h"
+#include "bvh.h"
+#include "common.h"
+#include "geometry.h"
+#include "scene_graph.h"
+#include "type_utils.h"
+
+/*
+ * skinning.h
+ * CPU skinning of skinned meshes: bone palettes, linear-blend and dual-quaternion kernels, and
+ * batched skinning of many instances into upload-ready vertex buffers.
+ */
+
+namespace rei {
+
+enum class SkinningMethod {
+  Linear,         // blend bone matrices; cheapest, but twisting joints lose volume
+  DualQuaternion, // blend rigid bone transforms; keeps volume, ignores bone scale
+};
+
+// Skinning matrix as the kernels read it: the top three rows of each column of an affine
+// matrix, one 16-byte column each (4th lane zero)
+struct alignas(16) BoneMatrix {
+  float columns[4][4];
+};
+
+// Unit dual quaternion of a rigid transform; (x, y, z, w) each
+struct alignas(16) BoneDualQuat {
+  float real[4];
+  float dual[4];
+};
+
+// Per-bone transforms from bind-pose mesh space to posed mesh space
+struct SkinPalette {
+  std::vector<BoneMatrix> matrices;
+  std::vector<BoneDualQuat> dual_quats; // DualQuaternion only
+
+  void set(const Mat4* transforms, size_t bone_num, SkinningMethod method);
+};
+
+/*
+ * Bind pose of a skinned Mesh, packed for the kernels: one 64-byte record per vertex holding the
+ * position, normal and bone influences. Shared by every instance of the mesh.
+ */
+class SkinnedMesh : NoCopy {
+public:
+  struct alignas(64) Vertex {
+    float position[4]; // w = 1
+    float normal[4];   // w = 0
+    float weights[4];
+    std::uint16_t bones[4];
+  };
+
+  explicit SkinnedMesh(std::shared_ptr<const Mesh> mesh);
+
+  const Mesh& mesh() const { return *m_mesh; }
+  const std::shared_ptr<const Mesh>& mesh_ptr() const { return m_mesh; }
+  size_t vertex_num() const { return m_vertices.size(); }
+  size_t bone_num() const { return m_mesh->get_bones().size(); }
+  const Vertex* vertices() const { return m_vertices.data(); }
+
+private:
+  std::shared_ptr<const Mesh> m_mesh;
+  std::vector<Vertex> m_vertices;
+};
+
+/*
+ * Skin vertices [begin, end) of `mesh` with `palette` into `out` (same positions). Positions and
+ * normals are written; colors are left alone. Normals are transformed by the blended matrix and
+ * renormalized, which is exact for rotations and uniform scales.
+ * One vertex is blended per iteration, a 4-wide vector per matrix column (or dual quaternion
+ * half), so the bone loads are aligned vector loads rather than gathers.
+ */
+void skin_vertices(const SkinnedMesh& mesh, const SkinPalette& palette, SkinningMethod method,
+  PackedMesh::Vertex* out, size_t begin, size_t end);
+
+/*
+ * A posed copy of a skinned mesh, e.g. one character. Its vertex buffer has the layout of
+ * PackedMesh::Vertex, which is what pipelines upload, and is rewritten by skin().
+ *
+ * The palette comes either from the scene graph (bones are nodes named after Mesh::Bone::name,
+ * posed relative to the node carrying the mesh) or from set_pose().
+ */
+class SkinInstance : NoCopy {
+public:
+  SkinInstance(
+    std::shared_ptr<const SkinnedMesh> mesh, SkinningMethod method = SkinningMethod::Linear);
+
+  const SkinnedMesh& mesh() const { return *m_mesh; }
+  SkinningMethod method() const { return m_method; }
+
+  // Find the bone nodes in `graph` by name; returns the number found. Bones without a node stay
+  // in their bind pose.
+  size_t bind(const SceneGraph& graph, SceneGraph::NodeId mesh_node);
+  // Palette from the world transforms of the bound nodes; valid after a graph update
+  void update_palette(const SceneGraph& graph);
+  // Palette from the mesh-space transform of every bone (bone space to mesh space)
+  void set_pose(const Mat4* bone_transforms);
+
+  // Keep a ray tracing BVH over the skinned vertices. It is built once in the bind pose and
+  // refit (not rebuilt) by every skin() after.
+  void enable_bvh();
+  const TriangleBVH* bvh() const { return m_bvh.get(); }
+
+  const std::vector<PackedMesh::Vertex>& vertices() const { return m_vertices; }
+  const SkinPalette& palette() const { return m_palette; }
+
+private:
+  friend void skin(SkinInstance* const*, size_t, const SceneGraph*);
+
+  std::shared_ptr<const SkinnedMesh> m_mesh;
+  SkinningMethod m_method;
+  SceneGraph::NodeId m_mesh_node = SceneGraph::k_invalid_node;
+  std::vector<SceneGraph::NodeId> m_bone_nodes; // per bone; k_invalid_node if not found
+  std::vector<Mat4> m_pose;                     // scratch for the palette
+  SkinPalette m_palette;
+  std::vector<PackedMesh::Vertex> m_vertices;
+  std::unique_ptr<TriangleBVH> m_bvh;
+};
+
+/*
+ * Skin every instance: palettes are updated from `graph` first when given (in parallel across
+ * instances), then vertices are skinned in parallel across instances and chunks of vertices,
+ * and the BVHs refit.
+ */
+void skin(SkinInstance* const* instances, size_t count, const SceneGraph* graph = nullptr);
+
+} // namespace rei
+
+#endif
@@ -1,6 +1,7 @@
 #ifndef REI_STRING_UTILS_H
 #define REI_STRING_UTILS_H
 
+#include <cctype>
 #include <ostream>
 #include <string>
 
@@ -32,6 +33,16 @@ static inline int to_cstr(const wchar_t* wchars, char* buffer) {
   return i;
 }
 
+// ".ext" of the file name in lower case, or an empty string
+static inline std::string lower_extension(const std::string& filename) {
+  const size_t dot = filename.find_last_of('.');
+  if (dot == std::string::npos) return std::string();
+  std::string ext = filename.substr(dot);
+  for (char& c : ext)
+    c = char(std::tolower(static_cast<unsigned char>(c)));
+  return ext;
+}
+
 } // namespace rei
 
 #endif
@@ -0,0 +1,171 @@
+// source of texture.h
+#include "texture.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+using std::shared_ptr;
+using std::string;
+using std::uint32_t;
+using std::uint64_t;
+
+namespace rei {
+
+using namespace texture_file;
+
+static_assert(sizeof(Header) % 8 == 0, "header is 8-aligned");
+
+bool is_block_compressed(TextureFormat format) {
+  return format >= TextureFormat::BC1;
+}
+
+bool is_srgb(TextureFormat format) {
+  switch (format) {
+    case TextureFormat::RGBA8_SRGB:
+    case TextureFormat::BC1_SRGB:
+    case TextureFormat::BC3_SRGB:
+    case TextureFormat::BC7_SRGB: return true;
+    default: return false;
+  }
+}
+
+const char* format_name(TextureFormat format) {
+  switch (format) {
+    case TextureFormat::RGBA8: return "RGBA8";
+    case TextureFormat::RGBA8_SRGB: return "RGBA8_SRGB";
+    case TextureFormat::RGBA16F: return "RGBA16F";
+    case TextureFormat::BC1: return "BC1";
+    case TextureFormat::BC1_SRGB: return "BC1_SRGB";
+    case TextureFormat::BC3: return "BC3";
+    case TextureFormat::BC3_SRGB: return "BC3_SRGB";
+    case TextureFormat::BC5: return "BC5";
+    case TextureFormat::BC7: return "BC7";
+    case TextureFormat::BC7_SRGB: return "BC7_SRGB";
+  }
+  return "unknown";
+}
+
+size_t row_pitch(TextureFormat format, uint32_t width) {
+  switch (format) {
+    case TextureFormat::RGBA8:
+    case TextureFormat::RGBA8_SRGB: return size_t(width) * 4;
+    case TextureFormat::RGBA16F: return size_t(width) * 8;
+    case TextureFormat::BC1:
+    case TextureFormat::BC1_SRGB: return size_t((width + 3) / 4) * 8;
+    default: return size_t((width + 3) / 4) * 16;
+  }
+}
+
+size_t level_bytes(TextureFormat format, uint32_t width, uint32_t height) {
+  const size_t rows = is_block_compressed(format) ? (height + 3) / 4 : height;
+  return row_pitch(format, width) * rows;
+}
+
+uint32_t full_mip_count(uint32_t width, uint32_t height) {
+  uint32_t n = 1;
+  while ((width | height) >> n)
+    n++;
+  return n;
+}
+
+// Texture ///////////////////////////////////////////////////////////////////
+
+Texture::Texture(Name name, TextureFormat format, uint32_t width, uint32_t height)
+    : m_name(std::move(name)), m_format(format), m_width(width), m_height(height) {}
+
+void Texture::add_level(const void* data, size_t bytes) {
+  const uint32_t i = level_count();
+  const uint32_t w = (std::max)(m_width >> i, 1u), h = (std::max)(m_height >> i, 1u);
+  REI_ASSERT(!m_file.is_open() && i < k_max_levels && bytes == level_bytes(m_format, w, h));
+  const size_t offset = m_owned.size();
+  m_owned.resize(offset + bytes);
+  std::memcpy(m_owned.data() + offset, data, bytes);
+  m_levels.push_back({w, h, offset, bytes});
+}
+
+size_t Texture::total_bytes() const {
+  size_t n = 0;
+  for (const Level& l : m_levels)
+    n += l.bytes;
+  return n;
+}
+
+shared_ptr<Texture> Texture::open(const string& filename, Name name) {
+  MappedFile file;
+  if (!file.open(filename)) {
+    REI_WARNING("Texture: cannot map " + filename);
+    return nullptr;
+  }
+  auto fail = [&](const char* what) {
+    REI_WARNING("Texture: " + filename + " is not a valid texture (" + what + ")");
+    return nullptr;
+  };
+  if (file.size() < sizeof(Header)) return fail("truncated header");
+  const Header& h = *reinterpret_cast<const Header*>(file.data());
+  if (std::memcmp(h.magic, k_magic, sizeof(k_magic)) != 0) return fail("magic");
+  if (h.format_version != k_format_version) return fail("format version");
+  if (h.endian_tag != k_endian_tag) return fail("endianness");
+  if (h.file_bytes != file.size()) return fail("file size");
+  if (h.format > uint32_t(TextureFormat::BC7_SRGB)) return fail("pixel format");
+  const uint32_t max_levels = (std::min)(k_max_levels, full_mip_count(h.width, h.height));
+  if (h.width == 0 || h.height == 0 || h.level_count == 0 || h.level_count > max_levels)
+    return fail("level count");
+
+  const TextureFormat format = TextureFormat(h.format);
+  shared_ptr<Texture> ret = std::make_shared<Texture>(std::move(name), format, h.width, h.height);
+  for (uint32_t i = 0; i < h.level_count; i++) {
+    const LevelRecord& l = h.levels[i];
+    const uint32_t w = (std::max)(h.width >> i, 1u), hh = (std::max)(h.height >> i, 1u);
+    if (l.width != w || l.height != hh || l.bytes != level_bytes(format, w, hh)
+        || l.offset % k_alignment || l.offset > file.size() || l.bytes > file.size() - l.offset)
+      return fail("level record");
+    ret->m_levels.push_back({w, hh, size_t(l.offset), size_t(l.bytes)});
+  }
+  ret->m_file = std::move(file);
+  return ret;
+}
+
+bool write_texture_file(const string& filename, const Texture& texture) {
+  Header header {};
+  std::memcpy(header.magic, k_magic, sizeof(k_magic));
+  header.format_version = k_format_version;
+  header.endian_tag = k_endian_tag;
+  header.format = uint32_t(texture.format());
+  header.width = texture.width();
+  header.height = texture.height();
+  header.level_count = texture.level_count();
+  uint64_t end = sizeof(Header);
+  for (uint32_t i = 0; i < texture.level_count(); i++) {
+    const Texture::Level& l = texture.level(i);
+    LevelRecord& rec = header.levels[i];
+    rec.width = l.width;
+    rec.height = l.height;
+    rec.offset = (end + k_alignment - 1) / k_alignment * k_alignment;
+    rec.bytes = l.bytes;
+    end = rec.offset + rec.bytes;
+  }
+  header.file_bytes = end;
+
+  std::ofstream out(filename, std::ios::binary | std::ios::trunc);
+  if (!out) {
+    REI_WARNING("Texture: cannot write " + filename);
+    return false;
+  }
+  out.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+  static const char zeros[k_alignment] = {};
+  for (uint32_t i = 0; i < texture.level_count(); i++) {
+    const LevelRecord& rec = header.levels[i];
+    out.write(zeros, std::streamsize(rec.offset - uint64_t(out.tellp())));
+    out.write(reinterpret_cast<const char*>(texture.level_data(i)), std::streamsize(rec.bytes));
+  }
+  return bool(out);
+}
+
+std::wostream& operator<<(std::wostream& os, const TexturePtr& texture) {
+  if (!texture) return os << "<no texture>";
+  return os << "<texture " << texture->name() << " " << texture->width() << "x"
+            << texture->height() << " " << format_name(texture->format()) << ">";
+}
+
+} // namespace rei
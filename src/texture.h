@@ -0,0 +1,133 @@
+#ifndef REI_TEXTURE_H
+#define REI_TEXTURE_H
+
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "common.h"
+#include "mapped_file.h"
+
+/*
+ * texture.h
+ * Texture assets: GPU pixel formats, mip chains, and the file container the asset cache keeps
+ * converted textures in.
+ */
+
+namespace rei {
+
+// Formats a converted texture can have; the BC formats take 4x4 pixel blocks
+enum class TextureFormat : std::uint32_t {
+  RGBA8,
+  RGBA8_SRGB,
+  RGBA16F,
+  BC1, // rgb + 1-bit alpha, 8 bytes per block
+  BC1_SRGB,
+  BC3, // rgba, 16 bytes per block
+  BC3_SRGB,
+  BC5, // two channels (e.g. normal map xy), 16 bytes per block
+  BC7, // rgba, 16 bytes per block
+  BC7_SRGB,
+};
+
+bool is_block_compressed(TextureFormat format);
+bool is_srgb(TextureFormat format);
+const char* format_name(TextureFormat format);
+
+// Bytes of a row of pixels (of blocks, for the BC formats)
+size_t row_pitch(TextureFormat format, std::uint32_t width);
+// Bytes of a width x height image; BC formats round partial edge blocks up
+size_t level_bytes(TextureFormat format, std::uint32_t width, std::uint32_t height);
+// Levels of the full mip chain, down to 1x1
+std::uint32_t full_mip_count(std::uint32_t width, std::uint32_t height);
+
+/*
+ * Container layout (little-endian): texture_file::Header, then each level at a multiple of
+ * k_alignment, largest first. Levels are stored in the GPU layout of their format, so uploading
+ * is a copy out of the mapping.
+ */
+namespace texture_file {
+
+constexpr char k_magic[8] = {'R', 'E', 'I', 'T', 'E', 'X', 'T', 'R'};
+constexpr std::uint32_t k_format_version = 1;
+constexpr std::uint32_t k_endian_tag = 0x01020304;
+constexpr std::uint64_t k_alignment = 512; // D3D12 texture data placement alignment
+constexpr std::uint32_t k_max_levels = 16;
+
+struct LevelRecord {
+  std::uint32_t width;
+  std::uint32_t height;
+  std::uint64_t offset; // from the start of the file
+  std::uint64_t bytes;
+};
+
+struct Header {
+  char magic[8];
+  std::uint32_t format_version;
+  std::uint32_t endian_tag;
+  std::uint32_t format; // TextureFormat
+  std::uint32_t width;
+  std::uint32_t height;
+  std::uint32_t level_count;
+  std::uint64_t file_bytes;
+  LevelRecord levels[k_max_levels];
+};
+
+} // namespace texture_file
+
+/*
+ * An image with its mip chain in one format. The pixel data is either owned (as built by the
+ * import pipeline) or a view into a mapped container file.
+ */
+class Texture : NoCopy {
+public:
+  struct Level {
+    std::uint32_t width;
+    std::uint32_t height;
+    size_t offset;
+    size_t bytes;
+  };
+
+  Texture(Name name, TextureFormat format, std::uint32_t width, std::uint32_t height);
+
+  // Map and validate a container; return nullptr (with a warning) if it is missing or malformed
+  static std::shared_ptr<Texture> open(const std::string& filename, Name name);
+
+  // Append the next level (half the size of the previous one); `bytes` must be its level_bytes
+  void add_level(const void* data, size_t bytes);
+
+  const Name& name() const { return m_name; }
+  TextureFormat format() const { return m_format; }
+  std::uint32_t width() const { return m_width; }
+  std::uint32_t height() const { return m_height; }
+  std::uint32_t level_count() const { return std::uint32_t(m_levels.size()); }
+  const Level& level(std::uint32_t i) const { return m_levels[i]; }
+  const std::uint8_t* level_data(std::uint32_t i) const { return base() + m_levels[i].offset; }
+  // Pixel data of all levels
+  size_t total_bytes() const;
+
+private:
+  Name m_name;
+  TextureFormat m_format;
+  std::uint32_t m_width;
+  std::uint32_t m_height;
+  std::vector<Level> m_levels;
+  std::vector<std::uint8_t> m_owned;
+  MappedFile m_file;
+
+  const std::uint8_t* base() const { return m_file.is_open() ? m_file.data() : m_owned.data(); }
+};
+
+using TexturePtr = std::shared_ptr<Texture>;
+
+// Write the texture as a container; return false if the file could not be written
+bool write_texture_file(const std::string& filename, const Texture& texture);
+
+// Printing, for Material
+std::wostream& operator<<(std::wostream& os, const TexturePtr& texture);
+
+} // namespace rei
+
+#endif
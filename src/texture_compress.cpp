@@ -0,0 +1,639 @@
+// source of texture_compress.h
+#include "texture_compress.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#include "debug.h"
+#include "parallel.h"
+
+using std::uint16_t;
+using std::uint32_t;
+using std::uint64_t;
+using std::uint8_t;
+using std::vector;
+
+namespace rei {
+
+namespace {
+
+constexpr uint32_t k_max_error = (std::numeric_limits<uint32_t>::max)();
+
+int clamp_byte(float v) {
+  return int((std::min)((std::max)(v + 0.5f, 0.f), 255.f));
+}
+
+uint32_t square(int v) {
+  return uint32_t(v * v);
+}
+
+// Endpoint fitting ////////////////////////////////////////////////////////////
+
+/*
+ * Endpoints spanning the first N channels of `px` (n pixels, as 0-255 floats) along an axis:
+ * the bounding box diagonal oriented by the covariance with the widest channel (Fast, inset by
+ * 1/16 of the range like most fast encoders), or the principal axis (otherwise).
+ */
+template <int N>
+void fit_endpoints(
+  const float (*px)[4], int n, CompressionQuality quality, float* e0, float* e1) {
+  float mean[N] = {}, lo[N], hi[N];
+  for (int c = 0; c < N; c++)
+    lo[c] = 255.f, hi[c] = 0.f;
+  for (int i = 0; i < n; i++)
+    for (int c = 0; c < N; c++) {
+      mean[c] += px[i][c];
+      lo[c] = (std::min)(lo[c], px[i][c]);
+      hi[c] = (std::max)(hi[c], px[i][c]);
+    }
+  for (int c = 0; c < N; c++)
+    mean[c] /= float(n);
+
+  float cov[N][N] = {};
+  for (int i = 0; i < n; i++)
+    for (int a = 0; a < N; a++)
+      for (int b = a; b < N; b++)
+        cov[a][b] += (px[i][a] - mean[a]) * (px[i][b] - mean[b]);
+  for (int a = 0; a < N; a++)
+    for (int b = 0; b < a; b++)
+      cov[a][b] = cov[b][a];
+
+  int widest = 0;
+  for (int c = 1; c < N; c++)
+    if (hi[c] - lo[c] > hi[widest] - lo[widest]) widest = c;
+
+  if (quality == CompressionQuality::Fast) {
+    for (int c = 0; c < N; c++) {
+      const float inset = (hi[c] - lo[c]) / 16.f;
+      const bool flip = cov[widest][c] < 0.f;
+      e0[c] = flip ? hi[c] - inset : lo[c] + inset;
+      e1[c] = flip ? lo[c] + inset : hi[c] - inset;
+    }
+    return;
+  }
+
+  // Power iteration, from the widest channel's covariance column
+  float axis[N];
+  for (int c = 0; c < N; c++)
+    axis[c] = cov[widest][c];
+  for (int iter = 0; iter < 8; iter++) {
+    float next[N] = {}, norm = 0.f;
+    for (int a = 0; a < N; a++) {
+      for (int b = 0; b < N; b++)
+        next[a] += cov[a][b] * axis[b];
+      norm = (std::max)(norm, std::fabs(next[a]));
+    }
+    if (norm == 0.f) break;
+    for (int c = 0; c < N; c++)
+      axis[c] = next[c] / norm;
+  }
+  float len2 = 0.f;
+  for (int c = 0; c < N; c++)
+    len2 += axis[c] * axis[c];
+  if (len2 < 1e-12f) { // flat block
+    for (int c = 0; c < N; c++)
+      e0[c] = e1[c] = mean[c];
+    return;
+  }
+  float tmin = (std::numeric_limits<float>::max)(), tmax = -tmin;
+  for (int i = 0; i < n; i++) {
+    float t = 0.f;
+    for (int c = 0; c < N; c++)
+      t += (px[i][c] - mean[c]) * axis[c];
+    tmin = (std::min)(tmin, t);
+    tmax = (std::max)(tmax, t);
+  }
+  for (int c = 0; c < N; c++) {
+    e0[c] = (std::min)((std::max)(mean[c] + tmin / len2 * axis[c], 0.f), 255.f);
+    e1[c] = (std::min)((std::max)(mean[c] + tmax / len2 * axis[c], 0.f), 255.f);
+  }
+}
+
+/*
+ * Least-squares endpoints for fixed interpolation weights w[i] (0 at e0, 1 at e1); false if the
+ * weights do not determine them (e.g. all equal).
+ */
+template <int N>
+bool refine_endpoints(const float (*px)[4], const float* w, int n, float* e0, float* e1) {
+  float aa = 0.f, ab = 0.f, bb = 0.f, ap[N] = {}, bp[N] = {};
+  for (int i = 0; i < n; i++) {
+    const float a = 1.f - w[i], b = w[i];
+    aa += a * a, ab += a * b, bb += b * b;
+    for (int c = 0; c < N; c++)
+      ap[c] += a * px[i][c], bp[c] += b * px[i][c];
+  }
+  const float det = aa * bb - ab * ab;
+  if (std::fabs(det) < 1e-6f) return false;
+  for (int c = 0; c < N; c++) {
+    e0[c] = (std::min)((std::max)((ap[c] * bb - bp[c] * ab) / det, 0.f), 255.f);
+    e1[c] = (std::min)((std::max)((bp[c] * aa - ap[c] * ab) / det, 0.f), 255.f);
+  }
+  return true;
+}
+
+void to_floats(const uint8_t rgba[64], float px[16][4]) {
+  for (int i = 0; i < 16; i++)
+    for (int c = 0; c < 4; c++)
+      px[i][c] = float(rgba[i * 4 + c]);
+}
+
+// BC1 color block /////////////////////////////////////////////////////////////
+
+uint16_t pack_565(const float* rgb) {
+  const int r = int(std::lround(rgb[0] * 31.f / 255.f));
+  const int g = int(std::lround(rgb[1] * 63.f / 255.f));
+  const int b = int(std::lround(rgb[2] * 31.f / 255.f));
+  return uint16_t(r << 11 | g << 5 | b);
+}
+
+void unpack_565(uint16_t c, int* rgb) {
+  const int r = c >> 11, g = (c >> 5) & 63, b = c & 31;
+  rgb[0] = (r << 3) | (r >> 2);
+  rgb[1] = (g << 2) | (g >> 4);
+  rgb[2] = (b << 3) | (b >> 2);
+}
+
+// Palette of a color block, as decoders compute it; entry 3 is transparent in 3-color mode
+void bc1_palette(uint16_t c0, uint16_t c1, bool four_color, int palette[4][4]) {
+  unpack_565(c0, palette[0]);
+  unpack_565(c1, palette[1]);
+  for (int c = 0; c < 3; c++) {
+    const int a = palette[0][c], b = palette[1][c];
+    if (four_color) {
+      palette[2][c] = (2 * a + b) / 3;
+      palette[3][c] = (a + 2 * b) / 3;
+    } else {
+      palette[2][c] = (a + b) / 2;
+      palette[3][c] = 0;
+    }
+  }
+  palette[0][3] = palette[1][3] = palette[2][3] = 255;
+  palette[3][3] = four_color ? 255 : 0;
+}
+
+struct ColorBlock {
+  uint16_t c0 = 0, c1 = 0;
+  uint32_t indices = 0;
+  uint32_t error = k_max_error;
+};
+
+/*
+ * Encode with the given endpoints; 4-color mode needs c0 > c1 and 3-color mode c0 <= c1, so the
+ * endpoints are ordered here. `transparent` pixels take index 3 in 3-color mode.
+ */
+ColorBlock bc1_try(const float px[16][4], const bool* transparent, const float* e0,
+  const float* e1, bool four_color) {
+  ColorBlock b;
+  b.c0 = pack_565(e0);
+  b.c1 = pack_565(e1);
+  if (four_color ? b.c0 < b.c1 : b.c0 > b.c1) std::swap(b.c0, b.c1);
+  // c0 == c1 reads as 3-color mode; index 0 is still the endpoint color
+  const bool decoded_four = b.c0 > b.c1;
+  int palette[4][4];
+  bc1_palette(b.c0, b.c1, decoded_four, palette);
+  const int choices = decoded_four ? 4 : 3;
+  b.error = 0;
+  for (int i = 0; i < 16; i++) {
+    if (transparent && transparent[i]) {
+      b.indices |= 3u << (i * 2);
+      continue;
+    }
+    uint32_t best = k_max_error, best_index = 0;
+    for (int k = 0; k < choices; k++) {
+      uint32_t e = 0;
+      for (int c = 0; c < 3; c++)
+        e += square(int(px[i][c]) - palette[k][c]);
+      if (e < best) best = e, best_index = uint32_t(k);
+    }
+    b.indices |= best_index << (i * 2);
+    b.error += best;
+  }
+  return b;
+}
+
+// Interpolation weight of each index, for refine_endpoints
+float bc1_weight(uint32_t index, bool four_color) {
+  static const float k_four[4] = {0.f, 1.f, 1.f / 3.f, 2.f / 3.f};
+  static const float k_three[4] = {0.f, 1.f, 0.5f, 0.f};
+  return four_color ? k_four[index] : k_three[index];
+}
+
+// `allow_transparent` is false for the color half of BC3, which always decodes as 4-color
+void encode_color_block(
+  const uint8_t rgba[64], uint8_t out[8], CompressionQuality quality, bool allow_transparent) {
+  float px[16][4];
+  to_floats(rgba, px);
+  bool transparent[16] = {};
+  float opaque[16][4];
+  int n = 0;
+  for (int i = 0; i < 16; i++) {
+    transparent[i] = allow_transparent && rgba[i * 4 + 3] < 128;
+    if (!transparent[i]) std::memcpy(opaque[n++], px[i], sizeof(px[i]));
+  }
+
+  ColorBlock best;
+  if (n == 0) { // fully transparent: 3-color mode, every index 3
+    best.c0 = best.c1 = 0;
+    best.indices = 0xFFFFFFFFu;
+  } else {
+    const bool needs_transparent = n < 16;
+    float e0[3], e1[3];
+    fit_endpoints<3>(opaque, n, quality, e0, e1);
+    best = bc1_try(px, transparent, e0, e1, !needs_transparent);
+    // Opaque blocks may still do better in 3-color mode (the half-way color is exact)
+    if (quality == CompressionQuality::High && allow_transparent && !needs_transparent) {
+      const ColorBlock three = bc1_try(px, nullptr, e0, e1, false);
+      if (three.error < best.error) best = three;
+    }
+    if (quality == CompressionQuality::High) {
+      for (int iter = 0; iter < 2 && best.error; iter++) {
+        const bool four = best.c0 > best.c1;
+        float w[16];
+        int m = 0;
+        for (int i = 0; i < 16; i++)
+          if (!transparent[i]) w[m++] = bc1_weight((best.indices >> (i * 2)) & 3, four);
+        if (!refine_endpoints<3>(opaque, w, n, e0, e1)) break;
+        const ColorBlock refined = bc1_try(px, transparent, e0, e1, four && !needs_transparent);
+        if (refined.error >= best.error) break;
+        best = refined;
+      }
+    }
+  }
+  out[0] = uint8_t(best.c0), out[1] = uint8_t(best.c0 >> 8);
+  out[2] = uint8_t(best.c1), out[3] = uint8_t(best.c1 >> 8);
+  for (int k = 0; k < 4; k++)
+    out[4 + k] = uint8_t(best.indices >> (k * 8));
+}
+
+void decode_color_block(const uint8_t in[8], uint8_t rgba[64], bool force_four_color) {
+  const uint16_t c0 = uint16_t(in[0] | in[1] << 8), c1 = uint16_t(in[2] | in[3] << 8);
+  int palette[4][4];
+  bc1_palette(c0, c1, force_four_color || c0 > c1, palette);
+  const uint32_t indices = uint32_t(in[4]) | uint32_t(in[5]) << 8 | uint32_t(in[6]) << 16
+                           | uint32_t(in[7]) << 24;
+  for (int i = 0; i < 16; i++) {
+    const int* p = palette[(indices >> (i * 2)) & 3];
+    for (int c = 0; c < 4; c++)
+      rgba[i * 4 + c] = uint8_t(p[c]);
+  }
+}
+
+// BC4 single channel //////////////////////////////////////////////////////////
+
+void bc4_palette(int a0, int a1, int palette[8]) {
+  palette[0] = a0, palette[1] = a1;
+  if (a0 > a1) {
+    for (int i = 2; i < 8; i++)
+      palette[i] = ((8 - i) * a0 + (i - 1) * a1) / 7;
+  } else {
+    for (int i = 2; i < 6; i++)
+      palette[i] = ((6 - i) * a0 + (i - 1) * a1) / 5;
+    palette[6] = 0, palette[7] = 255;
+  }
+}
+
+// Encode with the endpoints in this order (a0 > a1 selects the 8-value mode); return the error
+uint32_t bc4_try(const uint8_t values[16], int a0, int a1, uint64_t& bits) {
+  int palette[8];
+  bc4_palette(a0, a1, palette);
+  bits = uint64_t(a0) | uint64_t(a1) << 8;
+  uint32_t error = 0;
+  for (int i = 0; i < 16; i++) {
+    uint32_t best = k_max_error, best_index = 0;
+    for (int k = 0; k < 8; k++) {
+      const uint32_t e = square(values[i] - palette[k]);
+      if (e < best) best = e, best_index = uint32_t(k);
+    }
+    bits |= uint64_t(best_index) << (16 + i * 3);
+    error += best;
+  }
+  return error;
+}
+
+} // namespace
+
+void encode_bc1(const uint8_t rgba[64], uint8_t out[8], CompressionQuality quality) {
+  encode_color_block(rgba, out, quality, true);
+}
+
+void encode_bc4(const uint8_t values[16], uint8_t out[8], CompressionQuality quality) {
+  int lo = 255, hi = 0, inner_lo = 255, inner_hi = 0;
+  for (int i = 0; i < 16; i++) {
+    lo = (std::min)(lo, int(values[i]));
+    hi = (std::max)(hi, int(values[i]));
+    if (values[i] != 0 && values[i] != 255) {
+      inner_lo = (std::min)(inner_lo, int(values[i]));
+      inner_hi = (std::max)(inner_hi, int(values[i]));
+    }
+  }
+  uint64_t best_bits;
+  uint32_t best = bc4_try(values, hi, lo, best_bits);
+  auto consider = [&](int a0, int a1) {
+    uint64_t bits;
+    const uint32_t e = bc4_try(values, a0, a1, bits);
+    if (e < best) best = e, best_bits = bits;
+  };
+  if (quality != CompressionQuality::Fast && best) {
+    // Six-value mode has exact 0 and 255, so the other values get a narrower range
+    if (inner_lo <= inner_hi && (lo == 0 || hi == 255)) consider(inner_lo, inner_hi);
+    if (quality == CompressionQuality::High) {
+      const int a0 = hi, a1 = lo;
+      for (int d0 = -2; d0 <= 2; d0++)
+        for (int d1 = -2; d1 <= 2; d1++) {
+          const int b0 = a0 + d0, b1 = a1 + d1;
+          if (b0 > b1 && b0 <= 255 && b1 >= 0) consider(b0, b1);
+        }
+    }
+  }
+  for (int k = 0; k < 8; k++)
+    out[k] = uint8_t(best_bits >> (k * 8));
+}
+
+void encode_bc3(const uint8_t rgba[64], uint8_t out[16], CompressionQuality quality) {
+  uint8_t alpha[16];
+  for (int i = 0; i < 16; i++)
+    alpha[i] = rgba[i * 4 + 3];
+  encode_bc4(alpha, out, quality);
+  encode_color_block(rgba, out + 8, quality, false);
+}
+
+void encode_bc5(const uint8_t rgba[64], uint8_t out[16], CompressionQuality quality) {
+  uint8_t channel[16];
+  for (int c = 0; c < 2; c++) {
+    for (int i = 0; i < 16; i++)
+      channel[i] = rgba[i * 4 + c];
+    encode_bc4(channel, out + c * 8, quality);
+  }
+}
+
+// BC7 mode 6 //////////////////////////////////////////////////////////////////
+
+namespace {
+
+const int k_bc7_weights[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+struct Bc7Block {
+  int e[2][4]; // 7-bit endpoints
+  int p[2];    // p-bits
+  uint8_t indices[16];
+  uint32_t error = k_max_error;
+};
+
+// Nearest 7-bit value with the p-bit appended
+int quantize_7(float v, int p) {
+  return (std::min)((std::max)(int(std::lround((v - float(p)) / 2.f)), 0), 127);
+}
+
+Bc7Block bc7_try(const float px[16][4], const float* e0, const float* e1, int p0, int p1) {
+  Bc7Block b;
+  b.p[0] = p0, b.p[1] = p1;
+  int full[2][4];
+  for (int c = 0; c < 4; c++) {
+    b.e[0][c] = quantize_7(e0[c], p0);
+    b.e[1][c] = quantize_7(e1[c], p1);
+    full[0][c] = b.e[0][c] << 1 | p0;
+    full[1][c] = b.e[1][c] << 1 | p1;
+  }
+  int palette[16][4];
+  for (int k = 0; k < 16; k++)
+    for (int c = 0; c < 4; c++)
+      palette[k][c]
+        = ((64 - k_bc7_weights[k]) * full[0][c] + k_bc7_weights[k] * full[1][c] + 32) >> 6;
+
+  // The projection onto the endpoint line gives the index up to rounding; check its neighbors
+  float axis[4], len2 = 0.f;
+  for (int c = 0; c < 4; c++) {
+    axis[c] = float(full[1][c] - full[0][c]);
+    len2 += axis[c] * axis[c];
+  }
+  b.error = 0;
+  for (int i = 0; i < 16; i++) {
+    int guess = 0;
+    if (len2 > 0.f) {
+      float t = 0.f;
+      for (int c = 0; c < 4; c++)
+        t += (px[i][c] - float(full[0][c])) * axis[c];
+      guess = (std::min)((std::max)(int(std::lround(t / len2 * 15.f)), 0), 15);
+    }
+    uint32_t best = k_max_error;
+    int best_index = guess;
+    for (int k = (std::max)(guess - 1, 0); k <= (std::min)(guess + 1, 15); k++) {
+      uint32_t e = 0;
+      for (int c = 0; c < 4; c++)
+        e += square(int(px[i][c]) - palette[k][c]);
+      if (e < best) best = e, best_index = k;
+    }
+    b.indices[i] = uint8_t(best_index);
+    b.error += best;
+  }
+  return b;
+}
+
+// Best p-bit of an endpoint on its own, by the quantization error of its channels
+int best_pbit(const float* e) {
+  float err[2] = {0.f, 0.f};
+  for (int p = 0; p < 2; p++)
+    for (int c = 0; c < 4; c++) {
+      const float d = float(quantize_7(e[c], p) << 1 | p) - e[c];
+      err[p] += d * d;
+    }
+  return err[1] < err[0] ? 1 : 0;
+}
+
+// Little-endian bit stream over a 16-byte block
+struct BlockBits {
+  uint8_t* out;
+  int pos = 0;
+  void write(uint32_t v, int bits) {
+    for (int i = 0; i < bits; i++, pos++)
+      if ((v >> i) & 1) out[pos >> 3] |= uint8_t(1 << (pos & 7));
+  }
+};
+
+struct BlockReader {
+  const uint8_t* in;
+  int pos = 0;
+  uint32_t read(int bits) {
+    uint32_t v = 0;
+    for (int i = 0; i < bits; i++, pos++)
+      v |= uint32_t((in[pos >> 3] >> (pos & 7)) & 1) << i;
+    return v;
+  }
+};
+
+} // namespace
+
+void encode_bc7(const uint8_t rgba[64], uint8_t out[16], CompressionQuality quality) {
+  float px[16][4];
+  to_floats(rgba, px);
+  float e0[4], e1[4];
+  fit_endpoints<4>(px, 16, quality, e0, e1);
+
+  Bc7Block best;
+  if (quality == CompressionQuality::High) {
+    for (int p = 0; p < 4; p++) {
+      const Bc7Block b = bc7_try(px, e0, e1, p & 1, p >> 1);
+      if (b.error < best.error) best = b;
+    }
+    for (int iter = 0; iter < 2 && best.error; iter++) {
+      float w[16];
+      for (int i = 0; i < 16; i++)
+        w[i] = float(k_bc7_weights[best.indices[i]]) / 64.f;
+      if (!refine_endpoints<4>(px, w, 16, e0, e1)) break;
+      bool improved = false;
+      for (int p = 0; p < 4; p++) {
+        const Bc7Block b = bc7_try(px, e0, e1, p & 1, p >> 1);
+        if (b.error < best.error) best = b, improved = true;
+      }
+      if (!improved) break;
+    }
+  } else {
+    best = bc7_try(px, e0, e1, best_pbit(e0), best_pbit(e1));
+  }
+
+  // The first index is stored without its top bit, so it must be below 8
+  if (best.indices[0] >= 8) {
+    for (int c = 0; c < 4; c++)
+      std::swap(best.e[0][c], best.e[1][c]);
+    std::swap(best.p[0], best.p[1]);
+    for (uint8_t& index : best.indices)
+      index = uint8_t(15 - index);
+  }
+
+  std::memset(out, 0, 16);
+  BlockBits bits {out};
+  bits.write(1u << 6, 7); // mode 6
+  for (int c = 0; c < 4; c++) {
+    bits.write(uint32_t(best.e[0][c]), 7);
+    bits.write(uint32_t(best.e[1][c]), 7);
+  }
+  bits.write(uint32_t(best.p[0]), 1);
+  bits.write(uint32_t(best.p[1]), 1);
+  bits.write(best.indices[0], 3);
+  for (int i = 1; i < 16; i++)
+    bits.write(best.indices[i], 4);
+}
+
+// Decoders //////////////////////////////////////////////////////////////////
+
+void decode_bc1(const uint8_t in[8], uint8_t rgba[64]) {
+  decode_color_block(in, rgba, false);
+}
+
+void decode_bc4(const uint8_t in[8], uint8_t values[16]) {
+  int palette[8];
+  bc4_palette(in[0], in[1], palette);
+  uint64_t bits = 0;
+  for (int k = 0; k < 6; k++)
+    bits |= uint64_t(in[2 + k]) << (k * 8);
+  for (int i = 0; i < 16; i++)
+    values[i] = uint8_t(palette[(bits >> (i * 3)) & 7]);
+}
+
+void decode_bc3(const uint8_t in[16], uint8_t rgba[64]) {
+  decode_color_block(in + 8, rgba, true);
+  uint8_t alpha[16];
+  decode_bc4(in, alpha);
+  for (int i = 0; i < 16; i++)
+    rgba[i * 4 + 3] = alpha[i];
+}
+
+void decode_bc5(const uint8_t in[16], uint8_t rgba[64]) {
+  uint8_t r[16], g[16];
+  decode_bc4(in, r);
+  decode_bc4(in + 8, g);
+  for (int i = 0; i < 16; i++) {
+    rgba[i * 4] = r[i], rgba[i * 4 + 1] = g[i];
+    rgba[i * 4 + 2] = 0, rgba[i * 4 + 3] = 255;
+  }
+}
+
+bool decode_bc7(const uint8_t in[16], uint8_t rgba[64]) {
+  BlockReader bits {in};
+  if (bits.read(7) != 1u << 6) return false;
+  int e[2][4];
+  for (int c = 0; c < 4; c++) {
+    e[0][c] = int(bits.read(7));
+    e[1][c] = int(bits.read(7));
+  }
+  const int p0 = int(bits.read(1)), p1 = int(bits.read(1));
+  for (int c = 0; c < 4; c++) {
+    e[0][c] = e[0][c] << 1 | p0;
+    e[1][c] = e[1][c] << 1 | p1;
+  }
+  for (int i = 0; i < 16; i++) {
+    const int w = k_bc7_weights[bits.read(i == 0 ? 3 : 4)];
+    for (int c = 0; c < 4; c++)
+      rgba[i * 4 + c] = uint8_t(((64 - w) * e[0][c] + w * e[1][c] + 32) >> 6);
+  }
+  return true;
+}
+
+// Images ////////////////////////////////////////////////////////////////////
+
+vector<uint8_t> compress_image(const uint8_t* rgba, uint32_t width, uint32_t height,
+  TextureFormat format, CompressionQuality quality) {
+  if (!is_block_compressed(format)) {
+    REI_ASSERT(format == TextureFormat::RGBA8 || format == TextureFormat::RGBA8_SRGB);
+    return vector<uint8_t>(rgba, rgba + size_t(width) * height * 4);
+  }
+  vector<uint8_t> ret(level_bytes(format, width, height));
+  const uint32_t blocks_x = (width + 3) / 4, blocks_y = (height + 3) / 4;
+  const size_t pitch = row_pitch(format, width);
+  const size_t block_bytes = pitch / blocks_x;
+  parallel_for(0, blocks_y, 1, [&](size_t by) {
+    uint8_t block[64];
+    for (uint32_t bx = 0; bx < blocks_x; bx++) {
+      for (uint32_t i = 0; i < 16; i++) {
+        const uint32_t x = (std::min)(bx * 4 + i % 4, width - 1);
+        const uint32_t y = (std::min)(uint32_t(by) * 4 + i / 4, height - 1);
+        std::memcpy(block + i * 4, rgba + (size_t(y) * width + x) * 4, 4);
+      }
+      uint8_t* out = &ret[by * pitch + bx * block_bytes];
+      switch (format) {
+        case TextureFormat::BC1:
+        case TextureFormat::BC1_SRGB: encode_bc1(block, out, quality); break;
+        case TextureFormat::BC3:
+        case TextureFormat::BC3_SRGB: encode_bc3(block, out, quality); break;
+        case TextureFormat::BC5: encode_bc5(block, out, quality); break;
+        default: encode_bc7(block, out, quality); break;
+      }
+    }
+  });
+  return ret;
+}
+
+vector<uint8_t> decompress_image(
+  const uint8_t* data, uint32_t width, uint32_t height, TextureFormat format) {
+  if (!is_block_compressed(format)) return vector<uint8_t>(data, data + size_t(width) * height * 4);
+  vector<uint8_t> ret(size_t(width) * height * 4);
+  const uint32_t blocks_x = (width + 3) / 4, blocks_y = (height + 3) / 4;
+  const size_t pitch = row_pitch(format, width);
+  const size_t block_bytes = pitch / blocks_x;
+  parallel_for(0, blocks_y, 1, [&](size_t by) {
+    uint8_t block[64];
+    for (uint32_t bx = 0; bx < blocks_x; bx++) {
+      const uint8_t* in = data + by * pitch + bx * block_bytes;
+      switch (format) {
+        case TextureFormat::BC1:
+        case TextureFormat::BC1_SRGB: decode_bc1(in, block); break;
+        case TextureFormat::BC3:
+        case TextureFormat::BC3_SRGB: decode_bc3(in, block); break;
+        case TextureFormat::BC5: decode_bc5(in, block); break;
+        default:
+          if (!decode_bc7(in, block)) std::memset(block, 0, sizeof(block));
+          break;
+      }
+      for (uint32_t i = 0; i < 16; i++) {
+        const uint32_t x = bx * 4 + i % 4, y = uint32_t(by) * 4 + i / 4;
+        if (x < width && y < height)
+          std::memcpy(&ret[(size_t(y) * width + x) * 4], block + i * 4, 4);
+      }
+    }
+  });
+  return ret;
+}
+
+} // namespace rei
@@ -0,0 +1,63 @@
+#ifndef REI_TEXTURE_COMPRESS_H
+#define REI_TEXTURE_COMPRESS_H
+
+#include <cstdint>
+#include <vector>
+
+#include "texture.h"
+
+/*
+ * texture_compress.h
+ * CPU encoders (and reference decoders) for the BC1/BC3/BC5/BC7 block formats.
+ */
+
+namespace rei {
+
+/*
+ * Fast: bounding-box endpoints.
+ * Normal: endpoints along the principal axis of the block.
+ * High: Normal, then least-squares endpoint refinement and a wider search (BC1/BC3 transparent
+ *   mode, BC4 six-value mode and endpoint jitter, every BC7 p-bit combination).
+ */
+enum class CompressionQuality {
+  Fast,
+  Normal,
+  High,
+};
+
+/*
+ * Single 4x4 blocks. `rgba` holds the 16 pixels row by row, 4 bytes each.
+ *
+ * BC1 blocks use the transparent (3-color) mode when a pixel has alpha below 128. BC5 encodes
+ * the red and green channels. BC7 blocks are all mode 6 (one subset, RGBA endpoints with p-bits,
+ * 16 interpolation steps), which any BC7 decoder reads.
+ */
+void encode_bc1(const std::uint8_t rgba[64], std::uint8_t out[8], CompressionQuality quality);
+void encode_bc3(const std::uint8_t rgba[64], std::uint8_t out[16], CompressionQuality quality);
+void encode_bc4(const std::uint8_t values[16], std::uint8_t out[8], CompressionQuality quality);
+void encode_bc5(const std::uint8_t rgba[64], std::uint8_t out[16], CompressionQuality quality);
+void encode_bc7(const std::uint8_t rgba[64], std::uint8_t out[16], CompressionQuality quality);
+
+// Decoders, for checking the encoders; BC5 gives (r, g, 0, 255). decode_bc7 only reads mode 6
+// blocks and returns false for any other mode.
+void decode_bc1(const std::uint8_t in[8], std::uint8_t rgba[64]);
+void decode_bc3(const std::uint8_t in[16], std::uint8_t rgba[64]);
+void decode_bc4(const std::uint8_t in[8], std::uint8_t values[16]);
+void decode_bc5(const std::uint8_t in[16], std::uint8_t rgba[64]);
+bool decode_bc7(const std::uint8_t in[16], std::uint8_t rgba[64]);
+
+/*
+ * A width x height RGBA8 image in `format` (RGBA8 or a BC format; sRGB variants encode the
+ * bytes as they are). Rows of blocks are encoded on the thread pool; partial edge blocks repeat
+ * the last row and column.
+ */
+std::vector<std::uint8_t> compress_image(const std::uint8_t* rgba, std::uint32_t width,
+  std::uint32_t height, TextureFormat format, CompressionQuality quality);
+
+// Back to RGBA8, e.g. to measure the error of compress_image
+std::vector<std::uint8_t> decompress_image(
+  const std::uint8_t* data, std::uint32_t width, std::uint32_t height, TextureFormat format);
+
+} // namespace rei
+
+#endif
@@ -0,0 +1,356 @@
+// source of texture_import.h
+#include "texture_import.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+
+#include "debug.h"
+#include "parallel.h"
+#include "simd.h"
+
+using std::string;
+using std::uint16_t;
+using std::uint32_t;
+using std::uint64_t;
+using std::uint8_t;
+using std::vector;
+
+namespace rei {
+
+namespace {
+
+// Resampling ////////////////////////////////////////////////////////////////
+
+constexpr double k_pi = 3.14159265358979323846;
+constexpr double k_kaiser_radius = 3.0; // in output pixels
+constexpr double k_kaiser_alpha = 4.0;
+
+double bessel_i0(double x) {
+  double sum = 1.0, term = 1.0;
+  for (int k = 1; k < 32; k++) {
+    const double q = x / (2.0 * k);
+    term *= q * q;
+    sum += term;
+  }
+  return sum;
+}
+
+double kaiser_sinc(double t) {
+  const double x = t / k_kaiser_radius;
+  if (std::fabs(x) >= 1.0) return 0.0;
+  const double window
+    = bessel_i0(k_kaiser_alpha * std::sqrt(1.0 - x * x)) / bessel_i0(k_kaiser_alpha);
+  const double sinc = t == 0.0 ? 1.0 : std::sin(k_pi * t) / (k_pi * t);
+  return sinc * window;
+}
+
+// Source taps of every output coordinate along one axis, with normalized weights
+struct FilterTable {
+  vector<uint32_t> first; // per output coordinate, into index/weight; one extra end entry
+  vector<uint32_t> index;
+  vector<float> weight;
+};
+
+FilterTable make_table(uint32_t src_size, uint32_t dst_size, MipFilter filter, bool wrap) {
+  FilterTable table;
+  const double scale = double(src_size) / double(dst_size);
+  auto address = [&](long long i) {
+    const long long n = src_size;
+    if (wrap) return uint32_t(((i % n) + n) % n);
+    return uint32_t((std::min)((std::max)(i, 0ll), n - 1));
+  };
+  vector<double> weights;
+  vector<long long> taps;
+  for (uint32_t d = 0; d < dst_size; d++) {
+    weights.clear();
+    taps.clear();
+    if (filter == MipFilter::Box) {
+      // Overlap of each source pixel with the output pixel's footprint
+      const double lo = d * scale, hi = (d + 1) * scale;
+      for (long long i = (long long)std::floor(lo); double(i) < hi; i++) {
+        const double w = (std::min)(hi, double(i + 1)) - (std::max)(lo, double(i));
+        if (w > 0.0) taps.push_back(i), weights.push_back(w);
+      }
+    } else {
+      // The kernel stretches with the reduction, so that it stays band-limiting
+      const double stretch = (std::max)(scale, 1.0);
+      const double center = (d + 0.5) * scale;
+      const double support = k_kaiser_radius * stretch;
+      for (long long i = (long long)std::floor(center - support);
+           double(i) < center + support; i++) {
+        const double w = kaiser_sinc((i + 0.5 - center) / stretch);
+        if (w != 0.0) taps.push_back(i), weights.push_back(w);
+      }
+    }
+    double sum = 0.0;
+    for (double w : weights)
+      sum += w;
+    table.first.push_back(uint32_t(table.index.size()));
+    for (size_t k = 0; k < taps.size(); k++) {
+      table.index.push_back(address(taps[k]));
+      table.weight.push_back(float(weights[k] / sum));
+    }
+  }
+  table.first.push_back(uint32_t(table.index.size()));
+  return table;
+}
+
+// Color conversions /////////////////////////////////////////////////////////
+
+float srgb_to_linear(uint8_t v) {
+  static const vector<float> table = [] {
+    vector<float> t(256);
+    for (int i = 0; i < 256; i++) {
+      const double c = i / 255.0;
+      t[i] = float(c <= 0.04045 ? c / 12.92 : std::pow((c + 0.055) / 1.055, 2.4));
+    }
+    return t;
+  }();
+  return table[v];
+}
+
+float linear_to_srgb(float l) {
+  l = (std::min)((std::max)(l, 0.f), 1.f);
+  return l <= 0.0031308f ? l * 12.92f : 1.055f * std::pow(l, 1.f / 2.4f) - 0.055f;
+}
+
+uint8_t to_unorm8(float v) {
+  return uint8_t((std::min)((std::max)(v, 0.f), 1.f) * 255.f + 0.5f);
+}
+
+// Round to nearest even; overflow goes to infinity, underflow to half denormals or zero
+uint16_t float_to_half(float f) {
+  uint32_t x;
+  std::memcpy(&x, &f, 4);
+  const uint32_t sign = (x >> 16) & 0x8000;
+  const uint32_t abs = x & 0x7FFFFFFF;
+  if (abs >= 0x7F800000) return uint16_t(sign | 0x7C00 | (abs > 0x7F800000 ? 0x200 : 0));
+  if (abs >= 0x477FF000) return uint16_t(sign | 0x7C00); // rounds past the largest half
+  if (abs < 0x38800000) {                                 // half denormal
+    if (abs < 0x33000000) return uint16_t(sign);
+    const uint32_t e = abs >> 23;
+    const uint32_t m = (abs & 0x7FFFFF) | 0x800000;
+    const uint32_t shift = 126 - e;
+    uint32_t h = m >> shift;
+    const uint32_t rest = m & ((1u << shift) - 1), half = 1u << (shift - 1);
+    if (rest > half || (rest == half && (h & 1))) h++;
+    return uint16_t(sign | h);
+  }
+  uint32_t h = ((abs - 0x38000000) >> 13);
+  const uint32_t rest = abs & 0x1FFF;
+  if (rest > 0x1000 || (rest == 0x1000 && (h & 1))) h++;
+  return uint16_t(sign | h);
+}
+
+using Usage = TextureImportOptions::Usage;
+using Compression = TextureImportOptions::Compression;
+
+FloatImage to_float_image(const Image& image, Usage usage) {
+  FloatImage ret;
+  ret.width = image.width;
+  ret.height = image.height;
+  if (image.hdr) {
+    ret.rgba = image.rgba32f;
+    return ret;
+  }
+  ret.rgba.resize(image.pixel_num() * 4);
+  parallel_for_range(0, image.pixel_num(), 1 << 14, [&](size_t begin, size_t end) {
+    for (size_t i = begin * 4; i < end * 4; i++) {
+      const uint8_t v = image.rgba8[i];
+      const bool alpha = i % 4 == 3;
+      if (usage == Usage::Color && !alpha)
+        ret.rgba[i] = srgb_to_linear(v);
+      else if (usage == Usage::NormalMap && !alpha)
+        ret.rgba[i] = v / 127.5f - 1.f;
+      else
+        ret.rgba[i] = v / 255.f;
+    }
+  });
+  return ret;
+}
+
+// Filtered values back in range: unit normals, or colors clamped after the sinc's ringing
+void condition(FloatImage& image, Usage usage, bool hdr) {
+  const size_t n = size_t(image.width) * image.height;
+  parallel_for_range(0, n, 1 << 14, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++) {
+      float* p = &image.rgba[i * 4];
+      if (usage == Usage::NormalMap && !hdr) {
+        const float len = std::sqrt(p[0] * p[0] + p[1] * p[1] + p[2] * p[2]);
+        for (int c = 0; c < 3; c++)
+          p[c] = len > 1e-6f ? p[c] / len : (c == 2 ? 1.f : 0.f);
+      } else {
+        for (int c = 0; c < 3; c++)
+          p[c] = (std::max)(p[c], 0.f);
+      }
+      p[3] = (std::min)((std::max)(p[3], 0.f), 1.f);
+    }
+  });
+}
+
+vector<uint8_t> to_bytes(const FloatImage& image, Usage usage) {
+  vector<uint8_t> ret(image.rgba.size());
+  parallel_for_range(0, size_t(image.width) * image.height, 1 << 14, [&](size_t begin, size_t end) {
+    for (size_t i = begin * 4; i < end * 4; i++) {
+      const float v = image.rgba[i];
+      const bool alpha = i % 4 == 3;
+      if (usage == Usage::Color && !alpha)
+        ret[i] = to_unorm8(linear_to_srgb(v));
+      else if (usage == Usage::NormalMap && !alpha)
+        ret[i] = to_unorm8(v * 0.5f + 0.5f);
+      else
+        ret[i] = to_unorm8(v);
+    }
+  });
+  return ret;
+}
+
+TextureFormat choose_format(const Image& image, const TextureImportOptions& options) {
+  if (image.hdr) {
+    if (options.compression != Compression::Auto && options.compression != Compression::None)
+      REI_WARNING("TextureImport: HDR images are stored as RGBA16F");
+    return TextureFormat::RGBA16F;
+  }
+  const bool srgb = options.usage == Usage::Color;
+  switch (options.compression) {
+    case Compression::None: return srgb ? TextureFormat::RGBA8_SRGB : TextureFormat::RGBA8;
+    case Compression::BC1: return srgb ? TextureFormat::BC1_SRGB : TextureFormat::BC1;
+    case Compression::BC3: return srgb ? TextureFormat::BC3_SRGB : TextureFormat::BC3;
+    case Compression::BC5: return TextureFormat::BC5;
+    case Compression::BC7: return srgb ? TextureFormat::BC7_SRGB : TextureFormat::BC7;
+    default: break;
+  }
+  if (options.usage == Usage::NormalMap) return TextureFormat::BC5;
+  bool opaque = true;
+  for (size_t i = 3; opaque && i < image.rgba8.size(); i += 4)
+    opaque = image.rgba8[i] == 255;
+  if (opaque) return srgb ? TextureFormat::BC1_SRGB : TextureFormat::BC1;
+  return srgb ? TextureFormat::BC7_SRGB : TextureFormat::BC7;
+}
+
+// Bump when the conversion changes its output, so that older entries are missed
+constexpr uint64_t k_converter_version = 1;
+
+uint64_t cache_options(const TextureImportOptions& o) {
+  const uint64_t fields[] = {k_converter_version, texture_file::k_format_version,
+    uint64_t(o.usage), uint64_t(o.compression), uint64_t(o.quality), uint64_t(o.filter),
+    uint64_t(o.mips), uint64_t(o.wrap)};
+  return hash_bytes(fields, sizeof(fields));
+}
+
+} // namespace
+
+FloatImage resample(
+  const FloatImage& src, uint32_t width, uint32_t height, MipFilter filter, bool wrap) {
+  const FilterTable hx = make_table(src.width, width, filter, wrap);
+  const FilterTable vy = make_table(src.height, height, filter, wrap);
+
+  // Rows first, into width x src.height
+  vector<float> tmp(size_t(width) * src.height * 4);
+  parallel_for(0, src.height, 8, [&](size_t y) {
+    const float* row = &src.rgba[y * src.width * 4];
+    float* out = &tmp[y * width * 4];
+    for (uint32_t x = 0; x < width; x++) {
+      Float4 acc;
+      for (uint32_t k = hx.first[x]; k < hx.first[x + 1]; k++)
+        acc = madd(Float4(hx.weight[k]), Float4::load(row + size_t(hx.index[k]) * 4), acc);
+      acc.store(out + size_t(x) * 4);
+    }
+  });
+
+  // Then columns, over whole rows of tmp
+  FloatImage dst;
+  dst.width = width;
+  dst.height = height;
+  dst.rgba.resize(size_t(width) * height * 4);
+  parallel_for(0, height, 8, [&](size_t y) {
+    float* out = &dst.rgba[y * width * 4];
+    for (uint32_t x = 0; x < width; x++) {
+      Float4 acc;
+      for (uint32_t k = vy.first[y]; k < vy.first[y + 1]; k++) {
+        const float* p = &tmp[(size_t(vy.index[k]) * width + x) * 4];
+        acc = madd(Float4(vy.weight[k]), Float4::load(p), acc);
+      }
+      acc.store(out + size_t(x) * 4);
+    }
+  });
+  return dst;
+}
+
+TexturePtr build_texture(const Image& image, const TextureImportOptions& options, Name name) {
+  const TextureFormat format = choose_format(image, options);
+
+  // Block formats need whole blocks on the top level
+  uint32_t width = image.width, height = image.height;
+  if (is_block_compressed(format)) {
+    width = (width + 3) & ~3u;
+    height = (height + 3) & ~3u;
+  }
+  const bool resized = width != image.width || height != image.height;
+
+  const uint32_t level_num
+    = options.mips ? (std::min)(full_mip_count(width, height), texture_file::k_max_levels) : 1;
+  FloatImage level;
+  if (level_num > 1 || resized || image.hdr) level = to_float_image(image, options.usage);
+  if (resized) {
+    level = resample(level, width, height, options.filter, options.wrap);
+    condition(level, options.usage, image.hdr);
+  }
+
+  auto ret = std::make_shared<Texture>(std::move(name), format, width, height);
+  for (uint32_t i = 0; i < level_num; i++) {
+    const uint32_t w = (std::max)(width >> i, 1u), h = (std::max)(height >> i, 1u);
+    if (i > 0) {
+      level = resample(level, w, h, options.filter, options.wrap);
+      condition(level, options.usage, image.hdr);
+    }
+    if (format == TextureFormat::RGBA16F) {
+      vector<uint16_t> half(level.rgba.size());
+      parallel_for_range(0, half.size(), 1 << 16, [&](size_t begin, size_t end) {
+        for (size_t k = begin; k < end; k++)
+          half[k] = float_to_half(level.rgba[k]);
+      });
+      ret->add_level(half.data(), half.size() * sizeof(uint16_t));
+      continue;
+    }
+    // The top level is encoded from the source bytes, so it does not go through float
+    vector<uint8_t> bytes;
+    const uint8_t* rgba = image.rgba8.data();
+    if (i > 0 || resized) {
+      bytes = to_bytes(level, options.usage);
+      rgba = bytes.data();
+    }
+    const vector<uint8_t> encoded = compress_image(rgba, w, h, format, options.quality);
+    ret->add_level(encoded.data(), encoded.size());
+  }
+  return ret;
+}
+
+// TextureImporter /////////////////////////////////////////////////////////////
+
+TextureImporter::TextureImporter(std::shared_ptr<AssetCache> cache) : m_cache(std::move(cache)) {}
+
+TexturePtr TextureImporter::load(const string& filename, const TextureImportOptions& options) {
+  const string stem = std::filesystem::path(filename).stem().string();
+  const Name name = make_wstring(stem.c_str());
+  const uint64_t key = m_cache ? AssetCache::key(filename, cache_options(options)) : 0;
+  if (key) {
+    const string path = m_cache->find(key);
+    if (!path.empty())
+      if (TexturePtr cached = Texture::open(path, name)) return cached;
+  }
+
+  Image image;
+  if (!decode_image(filename, image)) {
+    REI_WARNING("TextureImport: cannot decode " + filename);
+    return nullptr;
+  }
+  TexturePtr texture = build_texture(image, options, name);
+  if (key)
+    m_cache->store(key, [&](const string& path) { return write_texture_file(path, *texture); });
+  return texture;
+}
+
+} // namespace rei
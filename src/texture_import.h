@@ -0,0 +1,86 @@
+#ifndef REI_TEXTURE_IMPORT_H
+#define REI_TEXTURE_IMPORT_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "asset_cache.h"
+#include "image_codec.h"
+#include "texture.h"
+#include "texture_compress.h"
+
+/*
+ * texture_import.h
+ * Texture import pipeline: decode a source image, build its mip chain with gamma-correct
+ * filtering, and encode every level to a GPU format.
+ */
+
+namespace rei {
+
+enum class MipFilter {
+  Box,    // average of the covered pixels; cheap and soft
+  Kaiser, // Kaiser-windowed sinc (3 lobes); sharper, with little ringing
+};
+
+struct TextureImportOptions {
+  enum class Usage {
+    Color,     // sRGB-encoded; filtered in linear space and stored as an sRGB format
+    Linear,    // data such as roughness or masks; filtered as it is
+    NormalMap, // tangent-space xyz in rgb; renormalized on every level
+  };
+  enum class Compression {
+    Auto, // BC5 for normal maps, BC1 for opaque images, BC7 otherwise
+    None, // RGBA8
+    BC1,
+    BC3,
+    BC5,
+    BC7,
+  };
+
+  Usage usage = Usage::Color;
+  Compression compression = Compression::Auto;
+  CompressionQuality quality = CompressionQuality::Normal;
+  MipFilter filter = MipFilter::Kaiser;
+  bool mips = true;
+  bool wrap = true; // sample across the edges when filtering, for tiling textures
+};
+
+// Linear RGBA image, as the mip filters work on it
+struct FloatImage {
+  std::uint32_t width = 0;
+  std::uint32_t height = 0;
+  std::vector<float> rgba;
+};
+
+/*
+ * Resample `src` to width x height with a separable filter; rows are processed on the thread
+ * pool, one RGBA pixel per SIMD vector. Filtering is done on the values as they are, so color
+ * must already be linear.
+ */
+FloatImage resample(const FloatImage& src, std::uint32_t width, std::uint32_t height,
+  MipFilter filter, bool wrap);
+
+// The converted texture of a decoded image. HDR sources are stored as RGBA16F (no BC6H encoder).
+TexturePtr build_texture(const Image& image, const TextureImportOptions& options, Name name);
+
+/*
+ * Texture counterpart of AssetLoader: converted textures are kept in `cache` if one is given,
+ * keyed by the content of the source file and the import options. Cache hits are mapped, so
+ * uploading them reads straight from the cache file.
+ */
+class TextureImporter {
+public:
+  explicit TextureImporter(std::shared_ptr<AssetCache> cache = nullptr);
+
+  // nullptr (with a warning) if the file cannot be decoded
+  TexturePtr load(const std::string& filename, const TextureImportOptions& options = {});
+
+private:
+  std::shared_ptr<AssetCache> m_cache;
+};
+
+} // namespace rei
+
+#endif
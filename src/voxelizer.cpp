@@ -0,0 +1,569 @@
+// source of voxelizer.h
+#include "voxelizer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+
+#include "debug.h"
+#include "geometry.h"
+#include "material.h"
+#include "parallel.h"
+#include "simd.h"
+
+using std::uint16_t;
+using std::uint32_t;
+using std::uint64_t;
+using std::uint8_t;
+using std::vector;
+
+namespace rei {
+
+namespace {
+
+inline uint64_t part1by2(uint64_t x) {
+  x &= 0x1fffff;
+  x = (x | x << 32) & 0x1f00000000ffffull;
+  x = (x | x << 16) & 0x1f0000ff0000ffull;
+  x = (x | x << 8) & 0x100f00f00f00f00full;
+  x = (x | x << 4) & 0x10c30c30c30c30c3ull;
+  x = (x | x << 2) & 0x1249249249249249ull;
+  return x;
+}
+
+inline uint64_t morton(uint32_t x, uint32_t y, uint32_t z) {
+  return part1by2(x) | (part1by2(y) << 1) | (part1by2(z) << 2);
+}
+
+inline int log2_int(int v) {
+  int l = 0;
+  while ((1 << l) < v)
+    l++;
+  return l;
+}
+
+inline uint32_t pack_rgba8(float r, float g, float b, float a) {
+  auto q = [](float f) {
+    return uint32_t(std::lround((std::min)((std::max)(f, 0.f), 1.f) * 255.f));
+  };
+  return q(r) | (q(g) << 8) | (q(b) << 16) | (q(a) << 24);
+}
+
+struct SurfaceSample {
+  float r, g, b;
+  float emissive;
+};
+
+// All scene triangles, in grid space
+struct TriangleSoup {
+  vector<float> positions; // 9 floats per triangle
+  vector<uint32_t> surface; // per triangle, index into `surfaces`
+  vector<SurfaceSample> surfaces;
+
+  size_t size() const { return surface.size(); }
+  const float* vertices(size_t tri) const { return positions.data() + tri * 9; }
+};
+
+// Per-triangle constants of the conservative overlap test (Schwarz and Seidel 2010, "Fast
+// Parallel Surface and Solid Voxelization on GPUs"). Voxels are unit boxes at integer corners.
+struct TriangleSetup {
+  float n[3];
+  float d1, d2;
+  float ne_xy[3][2], de_xy[3];
+  float ne_yz[3][2], de_yz[3];
+  float ne_zx[3][2], de_zx[3];
+  int lo[3], hi[3]; // inclusive voxel bounds
+};
+
+bool setup_triangle(const float* v, int resolution, TriangleSetup& s) {
+  const float* v0 = v;
+  const float* v1 = v + 3;
+  const float* v2 = v + 6;
+  float e[3][3];
+  for (int i = 0; i < 3; i++) {
+    e[0][i] = v1[i] - v0[i];
+    e[1][i] = v2[i] - v1[i];
+    e[2][i] = v0[i] - v2[i];
+  }
+  s.n[0] = e[0][1] * e[1][2] - e[0][2] * e[1][1];
+  s.n[1] = e[0][2] * e[1][0] - e[0][0] * e[1][2];
+  s.n[2] = e[0][0] * e[1][1] - e[0][1] * e[1][0];
+  if (s.n[0] == 0 && s.n[1] == 0 && s.n[2] == 0) return false; // degenerate
+
+  float c[3];
+  for (int i = 0; i < 3; i++)
+    c[i] = s.n[i] > 0 ? 1.f : 0.f;
+  s.d1 = s.n[0] * (c[0] - v0[0]) + s.n[1] * (c[1] - v0[1]) + s.n[2] * (c[2] - v0[2]);
+  s.d2 = s.n[0] * (1 - c[0] - v0[0]) + s.n[1] * (1 - c[1] - v0[1]) + s.n[2] * (1 - c[2] - v0[2]);
+
+  const float* vs[3] = {v0, v1, v2};
+  // Edge functions for a 2D projection onto axes (a, b), oriented by the normal component
+  auto edges = [&](int a, int b, int normal_axis, float(&ne)[3][2], float(&de)[3]) {
+    float sign = s.n[normal_axis] >= 0 ? 1.f : -1.f;
+    for (int i = 0; i < 3; i++) {
+      ne[i][0] = -e[i][b] * sign;
+      ne[i][1] = e[i][a] * sign;
+      de[i] = -(ne[i][0] * vs[i][a] + ne[i][1] * vs[i][b]) + (std::max)(0.f, ne[i][0])
+              + (std::max)(0.f, ne[i][1]);
+    }
+  };
+  edges(0, 1, 2, s.ne_xy, s.de_xy);
+  edges(1, 2, 0, s.ne_yz, s.de_yz);
+  edges(2, 0, 1, s.ne_zx, s.de_zx);
+
+  for (int i = 0; i < 3; i++) {
+    float lo = (std::min)({v0[i], v1[i], v2[i]});
+    float hi = (std::max)({v0[i], v1[i], v2[i]});
+    s.lo[i] = (std::max)(int(std::floor(lo)), 0);
+    s.hi[i] = (std::min)(int(std::floor(hi)), resolution - 1);
+    if (s.lo[i] > s.hi[i]) return false;
+  }
+  return true;
+}
+
+struct Voxel {
+  uint64_t code;
+  SurfaceSample sample;
+};
+
+// Scratch buffers for one tile, reused across tiles on the same thread
+struct TileScratch {
+  vector<float> accum; // r, g, b, emissive per voxel
+  vector<uint16_t> count;
+  vector<uint32_t> touched;
+};
+
+void voxelize_tile(const TriangleSoup& soup, const uint32_t* tris, size_t tri_num,
+  const int tile_min[3], int tile_size, int resolution, TileScratch& scratch,
+  vector<Voxel>& out) {
+  const size_t tile_voxels = size_t(tile_size) * tile_size * tile_size;
+  if (scratch.count.size() != tile_voxels) {
+    scratch.accum.assign(tile_voxels * 4, 0.f);
+    scratch.count.assign(tile_voxels, 0);
+  }
+  scratch.touched.clear();
+
+  const Float4 lane_offset(0.f, 1.f, 2.f, 3.f);
+  for (size_t t = 0; t < tri_num; t++) {
+    TriangleSetup s;
+    if (!setup_triangle(soup.vertices(tris[t]), resolution, s)) continue;
+    const SurfaceSample& surface = soup.surfaces[soup.surface[tris[t]]];
+
+    int lo[3], hi[3];
+    for (int i = 0; i < 3; i++) {
+      lo[i] = (std::max)(s.lo[i], tile_min[i]);
+      hi[i] = (std::min)(s.hi[i], tile_min[i] + tile_size - 1);
+    }
+
+    const Float4 nx(s.n[0]), d1(s.d1), d2(s.d2), zero(0.f);
+    for (int z = lo[2]; z <= hi[2]; z++) {
+      const float fz = float(z);
+      for (int y = lo[1]; y <= hi[1]; y++) {
+        const float fy = float(y);
+        // The yz projection does not depend on x
+        bool yz_pass = true;
+        for (int i = 0; i < 3 && yz_pass; i++)
+          yz_pass = s.ne_yz[i][0] * fy + s.ne_yz[i][1] * fz + s.de_yz[i] >= 0;
+        if (!yz_pass) continue;
+
+        const Float4 plane_yz(s.n[1] * fy + s.n[2] * fz);
+        Float4 xy_const[3], zx_const[3], ne_xy_x[3], ne_zx_x[3];
+        for (int i = 0; i < 3; i++) {
+          xy_const[i] = Float4(s.ne_xy[i][1] * fy + s.de_xy[i]);
+          ne_xy_x[i] = Float4(s.ne_xy[i][0]);
+          zx_const[i] = Float4(s.ne_zx[i][0] * fz + s.de_zx[i]);
+          ne_zx_x[i] = Float4(s.ne_zx[i][1]);
+        }
+
+        // 4 voxels along x at a time
+        for (int x = lo[0]; x <= hi[0]; x += 4) {
+          const Float4 px = Float4(float(x)) + lane_offset;
+          const Float4 np = madd(nx, px, plane_yz);
+          Float4 mask = ((np + d1) * (np + d2)) <= zero;
+          for (int i = 0; i < 3; i++) {
+            mask = mask & (madd(ne_xy_x[i], px, xy_const[i]) >= zero);
+            mask = mask & (madd(ne_zx_x[i], px, zx_const[i]) >= zero);
+          }
+          int bits = mask_bits(mask);
+          const int lanes = (std::min)(4, hi[0] - x + 1);
+          bits &= (1 << lanes) - 1;
+          while (bits) {
+            int lane = 0;
+            while (!(bits & (1 << lane)))
+              lane++;
+            bits &= ~(1 << lane);
+            const int lx = x + lane - tile_min[0];
+            const int ly = y - tile_min[1];
+            const int lz = z - tile_min[2];
+            const uint32_t local = uint32_t((lz * tile_size + ly) * tile_size + lx);
+            if (scratch.count[local] == 0) scratch.touched.push_back(local);
+            if (scratch.count[local] < UINT16_MAX) {
+              scratch.count[local]++;
+              float* acc = scratch.accum.data() + local * 4;
+              acc[0] += surface.r;
+              acc[1] += surface.g;
+              acc[2] += surface.b;
+              acc[3] += surface.emissive;
+            }
+          }
+        }
+      }
+    }
+  }
+
+  // Emit averaged voxels, and reset the touched scratch entries
+  out.reserve(scratch.touched.size());
+  const uint32_t tile_mask = uint32_t(tile_size - 1);
+  const int tile_bits = log2_int(tile_size);
+  for (uint32_t local : scratch.touched) {
+    uint32_t lx = local & tile_mask;
+    uint32_t ly = (local >> tile_bits) & tile_mask;
+    uint32_t lz = local >> (2 * tile_bits);
+    float* acc = scratch.accum.data() + local * 4;
+    float inv = 1.f / scratch.count[local];
+    Voxel voxel;
+    voxel.code = morton(tile_min[0] + lx, tile_min[1] + ly, tile_min[2] + lz);
+    voxel.sample = {acc[0] * inv, acc[1] * inv, acc[2] * inv, acc[3] * inv};
+    out.push_back(voxel);
+    acc[0] = acc[1] = acc[2] = acc[3] = 0.f;
+    scratch.count[local] = 0;
+  }
+  std::sort(out.begin(), out.end(), [](const Voxel& a, const Voxel& b) { return a.code < b.code; });
+}
+
+} // namespace
+
+SparseVoxelOctree SparseVoxelOctree::voxelize(const Scene& scene, const VoxelizeOptions& options) {
+  SparseVoxelOctree svo;
+
+  // Collect mesh models
+  struct Source {
+    const Mesh* mesh;
+    Mat4 transform;
+    uint32_t surface;
+    size_t tri_offset;
+  };
+  vector<Source> sources;
+  TriangleSoup soup;
+  Hashmap<const Material*, uint32_t> surface_ids;
+  size_t tri_total = 0;
+  for (const ModelPtr& model : scene.get_models()) {
+    const Mesh* mesh = dynamic_cast<const Mesh*>(model->get_geometry().get());
+    if (!mesh || mesh->empty()) continue;
+    const Material* mat = model->get_material().get();
+    uint32_t surface;
+    if (const uint32_t* found = surface_ids.try_get(mat)) {
+      surface = *found;
+    } else {
+      Color albedo
+        = mat ? mat->get<Color>(MaterialKeys::albedo).value_or(Colors::white) : Colors::white;
+      double emissive = mat ? mat->get<double>(MaterialKeys::emissive).value_or(0) : 0;
+      surface = uint32_t(soup.surfaces.size());
+      soup.surfaces.push_back({albedo.r, albedo.g, albedo.b, float(emissive)});
+      surface_ids.insert({mat, surface});
+    }
+    sources.push_back({mesh, model->get_transform(), surface, tri_total});
+    tri_total += mesh->get_triangles().size();
+  }
+  if (tri_total == 0) return svo;
+
+  // World bounds, per model in parallel
+  vector<Aabb> model_bounds(sources.size());
+  parallel_for(0, sources.size(), 1, [&](size_t i) {
+    for (const auto& v : sources[i].mesh->get_vertices())
+      model_bounds[i].expand(Vec3(sources[i].transform * v.coord));
+  });
+  Aabb world;
+  for (const Aabb& b : model_bounds)
+    world.expand(b);
+
+  // Cubic grid over the scene
+  const int tile_size = 1 << log2_int((std::max)(options.tile_size, 4));
+  const int resolution = 1 << log2_int((std::max)(options.resolution, tile_size));
+  const Vec3 extent = world.extent();
+  const double longest = (std::max)({extent.x, extent.y, extent.z, 1e-6});
+  svo.m_max_depth = log2_int(resolution);
+  svo.m_voxel_size = longest * (1.0 + 1e-4) / resolution; // keep the max corner inside the grid
+  svo.m_origin = world.center() - Vec3(1, 1, 1) * (0.5 * resolution * svo.m_voxel_size);
+
+  // Triangles in grid space
+  soup.positions.resize(tri_total * 9);
+  soup.surface.resize(tri_total);
+  const double inv_voxel = 1.0 / svo.m_voxel_size;
+  parallel_for(0, sources.size(), 1, [&](size_t i) {
+    const Source& src = sources[i];
+    const auto& vertices = src.mesh->get_vertices();
+    const auto& triangles = src.mesh->get_triangles();
+    vector<Vec3> grid_pos(vertices.size());
+    for (size_t v = 0; v < vertices.size(); v++)
+      grid_pos[v] = (Vec3(src.transform * vertices[v].coord) - svo.m_origin) * inv_voxel;
+    for (size_t t = 0; t < triangles.size(); t++) {
+      float* out = soup.positions.data() + (src.tri_offset + t) * 9;
+      const size_t corners[3] = {triangles[t].a, triangles[t].b, triangles[t].c};
+      for (int c = 0; c < 3; c++)
+        for (int k = 0; k < 3; k++)
+          out[c * 3 + k] = float(grid_pos[corners[c]][k]);
+      soup.surface[src.tri_offset + t] = src.surface;
+    }
+  });
+
+  // Bin triangles into tiles (count, prefix-sum, fill)
+  const int tiles_per_axis = resolution / tile_size;
+  const size_t tile_num = size_t(tiles_per_axis) * tiles_per_axis * tiles_per_axis;
+  auto tile_range = [&](size_t tri, int lo[3], int hi[3]) {
+    const float* v = soup.vertices(tri);
+    for (int k = 0; k < 3; k++) {
+      float vmin = (std::min)({v[k], v[3 + k], v[6 + k]});
+      float vmax = (std::max)({v[k], v[3 + k], v[6 + k]});
+      lo[k] = (std::max)(int(std::floor(vmin)), 0) / tile_size;
+      hi[k] = (std::min)(int(std::floor(vmax)), resolution - 1) / tile_size;
+    }
+  };
+  auto tile_index = [&](int x, int y, int z) {
+    return (size_t(z) * tiles_per_axis + y) * tiles_per_axis + x;
+  };
+  vector<std::atomic<uint32_t>> tile_count(tile_num);
+  for (auto& c : tile_count)
+    c.store(0, std::memory_order_relaxed);
+  parallel_for(0, tri_total, 1024, [&](size_t tri) {
+    int lo[3], hi[3];
+    tile_range(tri, lo, hi);
+    for (int z = lo[2]; z <= hi[2]; z++)
+      for (int y = lo[1]; y <= hi[1]; y++)
+        for (int x = lo[0]; x <= hi[0]; x++)
+          tile_count[tile_index(x, y, z)].fetch_add(1, std::memory_order_relaxed);
+  });
+  vector<size_t> tile_offset(tile_num + 1, 0);
+  for (size_t i = 0; i < tile_num; i++)
+    tile_offset[i + 1] = tile_offset[i] + tile_count[i].load(std::memory_order_relaxed);
+  vector<uint32_t> binned(tile_offset[tile_num]);
+  vector<std::atomic<uint32_t>> tile_cursor(tile_num);
+  for (auto& c : tile_cursor)
+    c.store(0, std::memory_order_relaxed);
+  parallel_for(0, tri_total, 1024, [&](size_t tri) {
+    int lo[3], hi[3];
+    tile_range(tri, lo, hi);
+    for (int z = lo[2]; z <= hi[2]; z++)
+      for (int y = lo[1]; y <= hi[1]; y++)
+        for (int x = lo[0]; x <= hi[0]; x++) {
+          size_t tile = tile_index(x, y, z);
+          uint32_t slot = tile_cursor[tile].fetch_add(1, std::memory_order_relaxed);
+          binned[tile_offset[tile] + slot] = uint32_t(tri);
+        }
+  });
+
+  // Process non-empty tiles in Morton order, so their outputs concatenate into a sorted list
+  struct Tile {
+    uint64_t code;
+    size_t index;
+    int min[3];
+  };
+  vector<Tile> tiles;
+  for (int z = 0; z < tiles_per_axis; z++)
+    for (int y = 0; y < tiles_per_axis; y++)
+      for (int x = 0; x < tiles_per_axis; x++) {
+        size_t index = tile_index(x, y, z);
+        if (tile_offset[index + 1] == tile_offset[index]) continue;
+        tiles.push_back({morton(x, y, z), index, {x * tile_size, y * tile_size, z * tile_size}});
+      }
+  std::sort(
+    tiles.begin(), tiles.end(), [](const Tile& a, const Tile& b) { return a.code < b.code; });
+
+  vector<vector<Voxel>> tile_voxels(tiles.size());
+  parallel_for(0, tiles.size(), 1, [&](size_t i) {
+    thread_local TileScratch scratch;
+    const Tile& tile = tiles[i];
+    uint32_t* tris = binned.data() + tile_offset[tile.index];
+    size_t tri_num = tile_offset[tile.index + 1] - tile_offset[tile.index];
+    std::sort(tris, tris + tri_num); // deterministic accumulation order
+    voxelize_tile(
+      soup, tris, tri_num, tile.min, tile_size, resolution, scratch, tile_voxels[i]);
+  });
+
+  // Build the octree bottom-up, one level at a time
+  struct LevelNode {
+    uint64_t code;
+    uint32_t first_child; // within the next level
+    uint8_t child_mask;
+    float r, g, b, a, e;
+  };
+  const int depth = svo.m_max_depth;
+  vector<vector<LevelNode>> levels(depth + 1);
+  {
+    size_t leaf_num = 0;
+    for (const auto& v : tile_voxels)
+      leaf_num += v.size();
+    auto& leaves = levels[depth];
+    leaves.reserve(leaf_num);
+    for (const auto& v : tile_voxels)
+      for (const Voxel& voxel : v) {
+        const SurfaceSample& s = voxel.sample;
+        leaves.push_back({voxel.code, 0, 0, s.r, s.g, s.b, 1.f, s.emissive});
+      }
+    svo.m_leaf_num = leaf_num;
+  }
+  for (int d = depth - 1; d >= 0; d--) {
+    const auto& children = levels[d + 1];
+    auto& parents = levels[d];
+    for (uint32_t i = 0; i < children.size(); i++) {
+      const LevelNode& c = children[i];
+      const uint64_t parent_code = c.code >> 3;
+      if (parents.empty() || parents.back().code != parent_code) {
+        parents.push_back({parent_code, i, 0, 0, 0, 0, 0, 0});
+      }
+      LevelNode& p = parents.back();
+      p.child_mask |= uint8_t(1 << (c.code & 7));
+      // coverage-weighted sums; normalized below
+      p.r += c.r * c.a;
+      p.g += c.g * c.a;
+      p.b += c.b * c.a;
+      p.e += c.e * c.a;
+      p.a += c.a;
+    }
+    for (LevelNode& p : parents) {
+      float inv = p.a > 0 ? 1.f / p.a : 0.f;
+      p.r *= inv;
+      p.g *= inv;
+      p.b *= inv;
+      p.e *= inv;
+      p.a *= 1.f / 8.f;
+    }
+  }
+  REI_ASSERT(levels[0].size() == 1);
+
+  // Flatten, root first
+  vector<size_t> level_offset(depth + 2, 0);
+  for (int d = 0; d <= depth; d++)
+    level_offset[d + 1] = level_offset[d] + levels[d].size();
+  const size_t node_num = level_offset[depth + 1];
+  svo.m_nodes.resize(node_num);
+  svo.m_albedo.resize(node_num);
+  svo.m_emissive.resize(node_num);
+  parallel_for(0, size_t(depth + 1), 1, [&](size_t d) {
+    for (size_t i = 0; i < levels[d].size(); i++) {
+      const LevelNode& n = levels[d][i];
+      size_t index = level_offset[d] + i;
+      svo.m_nodes[index].first_child
+        = n.child_mask ? uint32_t(level_offset[d + 1] + n.first_child) : 0;
+      svo.m_nodes[index].child_mask = n.child_mask;
+      svo.m_albedo[index] = pack_rgba8(n.r, n.g, n.b, n.a);
+      svo.m_emissive[index] = n.e;
+    }
+  });
+
+  return svo;
+}
+
+size_t SparseVoxelOctree::memory_bytes() const {
+  return m_nodes.size() * sizeof(Node) + m_albedo.size() * sizeof(uint32_t)
+         + m_emissive.size() * sizeof(float);
+}
+
+SparseVoxelOctree::NodeIndex SparseVoxelOctree::child(NodeIndex node, int octant) const {
+  const Node& n = m_nodes[node];
+  const uint32_t bit = 1u << octant;
+  if (!(n.child_mask & bit)) return k_invalid_node;
+  uint32_t lower = n.child_mask & (bit - 1);
+  int rank = 0;
+  while (lower) {
+    lower &= lower - 1;
+    rank++;
+  }
+  return n.first_child + rank;
+}
+
+Color SparseVoxelOctree::albedo(NodeIndex node) const {
+  uint32_t c = m_albedo[node];
+  return Color(
+    (c & 0xFF) / 255.f, ((c >> 8) & 0xFF) / 255.f, ((c >> 16) & 0xFF) / 255.f, (c >> 24) / 255.f);
+}
+
+SparseVoxelOctree::NodeIndex SparseVoxelOctree::find(
+  const Vec3& p, int depth, int* found_depth) const {
+  if (empty()) return k_invalid_node;
+  if (depth < 0 || depth > m_max_depth) depth = m_max_depth;
+  const Vec3 g = (p - m_origin) * (1.0 / m_voxel_size);
+  const int res = resolution();
+  int coord[3];
+  for (int i = 0; i < 3; i++) {
+    if (g[i] < 0 || g[i] >= res) return k_invalid_node;
+    coord[i] = int(g[i]);
+  }
+  NodeIndex node = 0;
+  int level = 0;
+  for (; level < depth; level++) {
+    const int shift = m_max_depth - 1 - level;
+    const int octant = ((coord[0] >> shift) & 1) | (((coord[1] >> shift) & 1) << 1)
+                       | (((coord[2] >> shift) & 1) << 2);
+    NodeIndex next = child(node, octant);
+    if (next == k_invalid_node) break;
+    node = next;
+  }
+  if (found_depth) *found_depth = level;
+  return node;
+}
+
+bool SparseVoxelOctree::occupied(const Vec3& p) const {
+  int found_depth = -1;
+  NodeIndex node = find(p, m_max_depth, &found_depth);
+  return node != k_invalid_node && found_depth == m_max_depth;
+}
+
+bool SparseVoxelOctree::ray_march(
+  const Vec3& origin, const Vec3& dir, double t_max, RayHit& hit, int depth) const {
+  if (empty()) return false;
+  if (depth < 0 || depth > m_max_depth) depth = m_max_depth;
+
+  // Grid space, with t kept in the caller's units
+  const double res = resolution();
+  const Vec3 o = (origin - m_origin) * (1.0 / m_voxel_size);
+  const Vec3 d = dir * (1.0 / m_voxel_size);
+  const Vec3 inv_d(1.0 / d.x, 1.0 / d.y, 1.0 / d.z);
+  double t = 0, t_end = t_max;
+  if (!Aabb(Vec3(0, 0, 0), Vec3(res, res, res)).intersect(o, inv_d, t, t_end)) return false;
+  const double t_eps = 1e-5 / d.norm();
+
+  while (t <= t_end) {
+    const Vec3 p = o + d * t;
+    if (p.x < 0 || p.y < 0 || p.z < 0 || p.x >= res || p.y >= res || p.z >= res) break;
+
+    // Descend to the deepest existing node containing p
+    NodeIndex node = 0;
+    Vec3 cell_min(0, 0, 0);
+    double cell_size = res;
+    int level = 0;
+    while (level < depth) {
+      const double half = cell_size * 0.5;
+      int octant = 0;
+      Vec3 child_min = cell_min;
+      for (int i = 0; i < 3; i++) {
+        if (p[i] >= cell_min[i] + half) {
+          octant |= 1 << i;
+          child_min[i] += half;
+        }
+      }
+      NodeIndex next = child(node, octant);
+      cell_size = half;
+      cell_min = child_min;
+      if (next == k_invalid_node) break;
+      node = next;
+      level++;
+    }
+    if (level == depth) {
+      hit = {t, node, level};
+      return true;
+    }
+
+    // Skip the empty cell: advance to its exit
+    double t_exit = t_end;
+    for (int i = 0; i < 3; i++) {
+      if (d[i] == 0) continue;
+      double bound = d[i] > 0 ? cell_min[i] + cell_size : cell_min[i];
+      t_exit = (std::min)(t_exit, (bound - o[i]) * inv_d[i]);
+    }
+    t = (std::max)(t_exit, t) + t_eps;
+  }
+  return false;
+}
+
+} // namespace rei
@@ -0,0 +1,88 @@
+#ifndef REI_VOXELIZER_H
+#define REI_VOXELIZER_H
+
+#include <cstdint>
+#include <vector>
+
+#include "aabb.h"
+#include "algebra.h"
+#include "color.h"
+#include "scene.h"
+
+/*
+ * voxelizer.h
+ * Conservative, tiled, multi-threaded scene voxelization into a sparse voxel octree.
+ */
+
+namespace rei {
+
+struct VoxelizeOptions {
+  int resolution = 256; // leaf voxels along each axis; rounded up to a power of two
+  int tile_size = 32;   // voxels along each axis of a work tile; a power of two
+};
+
+/*
+ * Octree nodes are stored level by level (root first). The children of a node are contiguous
+ * and ordered by octant, so a child is found with a popcount on the child mask.
+ * Every node keeps an averaged albedo (alpha is the occupied fraction) and emissive intensity,
+ * so coarser levels can be sampled directly.
+ */
+class SparseVoxelOctree {
+public:
+  using NodeIndex = std::uint32_t;
+  static constexpr NodeIndex k_invalid_node = UINT32_MAX;
+
+  struct RayHit {
+    double t;
+    NodeIndex node;
+    int depth;
+  };
+
+  SparseVoxelOctree() = default;
+
+  static SparseVoxelOctree voxelize(const Scene& scene, const VoxelizeOptions& options);
+
+  bool empty() const { return m_nodes.empty(); }
+  int max_depth() const { return m_max_depth; }
+  int resolution() const { return 1 << m_max_depth; }
+  double voxel_size() const { return m_voxel_size; }
+  Aabb bounds() const {
+    return Aabb(m_origin, m_origin + Vec3(1, 1, 1) * (resolution() * m_voxel_size));
+  }
+  size_t node_num() const { return m_nodes.size(); }
+  size_t leaf_num() const { return m_leaf_num; }
+  size_t memory_bytes() const;
+
+  // Deepest node containing p, not deeper than `depth` (-1 for leaf level)
+  NodeIndex find(const Vec3& p, int depth = -1, int* found_depth = nullptr) const;
+  bool occupied(const Vec3& p) const;
+
+  Color albedo(NodeIndex node) const;
+  float emissive(NodeIndex node) const { return m_emissive[node]; }
+
+  // Hierarchical DDA: skips empty octree cells of any size, and reports the first node at
+  // `depth` (-1 for leaf level) along the ray
+  bool ray_march(const Vec3& origin, const Vec3& dir, double t_max, RayHit& hit,
+    int depth = -1) const;
+
+private:
+  struct Node {
+    std::uint32_t first_child = 0;
+    std::uint8_t child_mask = 0;
+  };
+
+  Vec3 m_origin;
+  double m_voxel_size = 0;
+  int m_max_depth = 0;
+  size_t m_leaf_num = 0;
+
+  std::vector<Node> m_nodes;
+  std::vector<std::uint32_t> m_albedo; // RGBA8; alpha is coverage
+  std::vector<float> m_emissive;
+
+  NodeIndex child(NodeIndex node, int octant) const;
+};
+
+} // namespace rei
+
+#endif
@@ -0,0 +1,158 @@
+// Benchmark the dynamic AABB tree: build, incremental updates, and queries vs. linear scans
+
+#include <chrono>
+#include <random>
+#include <string>
+
+#include <aabb_tree.h>
+#include <camera.h>
+#include <console.h>
+#include <parallel.h>
+#include <scene.h>
+
+using namespace std;
+using namespace rei;
+
+using Clock = chrono::high_resolution_clock;
+
+static double ms_since(Clock::time_point start) {
+  return chrono::duration<double, milli>(Clock::now() - start).count();
+}
+
+// A scene's spatial index follows geometry as well as transforms, once synced
+static bool check_scene_index() {
+  Scene scene;
+  scene.add_model(Mat4::translate({100, 0, 0}), nullptr, L"empty");
+  const ModelPtr model = scene.get_models()[0];
+  const ModelSpatialIndex& index = scene.spatial_index();
+  auto hits = [&](const Vec3& p) {
+    size_t n = 0;
+    index.query(Aabb(p - Vec3(0.1, 0.1, 0.1), p + Vec3(0.1, 0.1, 0.1)), [&](ModelHandle h) {
+      n += h == model->handle();
+    });
+    return n == 1;
+  };
+  bool ok = index.size() == 0;
+
+  // Enters the index when it gets bounds
+  auto pending = make_shared<PendingGeometry>(L"pending", Vec3(-1, -1, -1), Vec3(1, 1, 1));
+  scene.set_geometry(model, pending);
+  scene.update_spatial_index();
+  ok &= index.size() == 1 && hits({100, 0, 0}) && !hits({110, 0, 0});
+
+  // The real mesh replaces the placeholder bounds
+  auto mesh = make_shared<Mesh>(Mesh::procudure_cube({10, 1, 1}));
+  scene.set_geometry(model, mesh);
+  scene.update_spatial_index();
+  ok &= hits({109, 0, 0});
+
+  // Editing the mesh in place refits its models
+  Mesh grown = Mesh::procudure_cube({20, 1, 1});
+  vector<Mesh::Vertex> vertices = grown.get_vertices();
+  vector<Mesh::Triangle> triangles = grown.get_triangles();
+  mesh->set(std::move(vertices), std::move(triangles));
+  ok &= !hits({119, 0, 0});
+  ok &= scene.update_spatial_index() == 1 && hits({119, 0, 0});
+  ok &= scene.update_spatial_index() == 0;
+
+  // Leaves it when the bounds are gone
+  scene.set_geometry(model, nullptr);
+  scene.update_spatial_index();
+  ok &= index.size() == 0;
+  return ok;
+}
+
+int main() {
+  console << "threads: " << global_thread_pool().concurrency() << endl;
+
+  const size_t object_num = 200000;
+  mt19937 rng(7);
+  uniform_real_distribution<double> pos(-500.0, 500.0);
+  uniform_real_distribution<double> size(0.5, 4.0);
+  uniform_real_distribution<double> unit(-1.0, 1.0);
+
+  vector<Aabb> boxes(object_num);
+  for (Aabb& b : boxes) {
+    Vec3 c(pos(rng), pos(rng) * 0.05, pos(rng));
+    Vec3 e(size(rng), size(rng), size(rng));
+    b = Aabb(c - e, c + e);
+  }
+
+  DynamicAabbTree tree;
+  vector<DynamicAabbTree::ProxyId> proxies(object_num);
+  auto start = Clock::now();
+  for (size_t i = 0; i < object_num; i++)
+    proxies[i] = tree.insert(boxes[i], uint32_t(i));
+  console << "insert " << object_num << ": " << ms_since(start) << " ms, height " << tree.height()
+          << ", SAH cost " << tree.sah_cost() << ", valid " << tree.validate() << endl;
+
+  // Move 1% of the objects per frame
+  const int frame_num = 20;
+  const size_t moved_per_frame = object_num / 100;
+  size_t reinserted = 0;
+  start = Clock::now();
+  for (int f = 0; f < frame_num; f++) {
+    for (size_t k = 0; k < moved_per_frame; k++) {
+      size_t i = rng() % object_num;
+      Vec3 d(unit(rng), unit(rng) * 0.1, unit(rng));
+      boxes[i] = Aabb(boxes[i].min + d, boxes[i].max + d);
+      reinserted += tree.move(proxies[i], boxes[i]);
+    }
+    tree.rebalance(64);
+  }
+  double move_ms = ms_since(start) / frame_num;
+  console << "move " << moved_per_frame << "/frame: " << move_ms << " ms/frame, "
+          << double(reinserted) / (frame_num * moved_per_frame) << " reinsert rate, height "
+          << tree.height() << ", SAH cost " << tree.sah_cost() << ", valid " << tree.validate()
+          << endl;
+
+  // Frustum culling: batched tree query vs. linear scan over the fat boxes
+  vector<Frustum> frustums;
+  for (int i = 0; i < 64; i++) {
+    Camera cam(Vec3(pos(rng), 20, pos(rng)), Vec3(unit(rng), -0.3, unit(rng)).normalized());
+    cam.set_params(16.0 / 9.0, 60, 0.1, 300);
+    frustums.emplace_back(cam.world_to_device());
+  }
+  DynamicAabbTree::BatchResult result;
+  start = Clock::now();
+  tree.query(frustums, result);
+  double tree_ms = ms_since(start);
+
+  size_t linear_hits = 0;
+  start = Clock::now();
+  for (const Frustum& fr : frustums)
+    for (size_t i = 0; i < object_num; i++)
+      linear_hits += fr.overlaps(tree.fat_bounds(proxies[i]));
+  double linear_ms = ms_since(start);
+  console << "frustum x" << frustums.size() << ": tree " << tree_ms << " ms, linear " << linear_ms
+          << " ms, hits " << result.items.size() << " vs " << linear_hits << endl;
+
+  // Picking rays
+  vector<DynamicAabbTree::Ray> rays(4096);
+  for (auto& r : rays)
+    r = {Vec3(pos(rng), 50, pos(rng)), Vec3(unit(rng), -1, unit(rng)).normalized(), 1000.0};
+  start = Clock::now();
+  tree.query(rays, result);
+  console << "rays x" << rays.size() << ": " << ms_since(start) << " ms, "
+          << double(result.items.size()) / rays.size() << " candidates/ray" << endl;
+
+  // Spheres
+  vector<Sphere> spheres(4096);
+  for (auto& s : spheres)
+    s = Sphere(Vec3(pos(rng), 0, pos(rng)), 10.0);
+  start = Clock::now();
+  tree.query(spheres, result);
+  console << "spheres x" << spheres.size() << ": " << ms_since(start) << " ms, "
+          << double(result.items.size()) / spheres.size() << " hits/sphere" << endl;
+
+  // Remove half
+  start = Clock::now();
+  for (size_t i = 0; i < object_num; i += 2)
+    tree.remove(proxies[i]);
+  console << "remove " << object_num / 2 << ": " << ms_since(start) << " ms, valid "
+          << tree.validate() << endl;
+
+  const bool ok = check_scene_index();
+  console << "Spatial index check: " << (ok ? "passed" : "FAILED") << endl;
+  return ok ? 0 : 1;
+}
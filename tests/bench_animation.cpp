@@ -0,0 +1,245 @@
+// Benchmark keyframe sampling into a model store, and check the interpolation, the key cursor
+// and the change tracking of the Animator
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include <animation.h>
+#include <console.h>
+#include <model_store.h>
+#include <parallel.h>
+#include <rmath.h>
+#include <scene_graph.h>
+
+using namespace std;
+using namespace rei;
+
+using Clock = chrono::high_resolution_clock;
+
+static double ms_since(Clock::time_point start) {
+  return chrono::duration<double, milli>(Clock::now() - start).count();
+}
+
+static bool near(const Mat4& a, const Mat4& b, double eps = 1e-5) {
+  return (a - b).norm() < eps;
+}
+
+static bool near(const Vec3& a, const Vec3& b, double eps = 1e-5) {
+  return (a - b).norm() < eps;
+}
+
+// A channel wobbling around `center` with keys every 1/30 s
+static void fill_channel(AnimationChannel& ch, const Vec3& center, size_t keys, mt19937& rng) {
+  uniform_real_distribution<double> jitter(-1.0, 1.0);
+  for (size_t k = 0; k < keys; k++) {
+    const double t = k / 30.0;
+    ch.translation.add_key(t, center + Vec3(jitter(rng), jitter(rng), jitter(rng)));
+    const Vec3 axis = Vec3(jitter(rng), jitter(rng), jitter(rng)).normalized();
+    ch.rotation.add_key(t, Quat::rotate(axis, jitter(rng) * pi));
+    ch.scale.add_key(t, Vec3(1, 1, 1) * (1.0 + 0.5 * jitter(rng)));
+  }
+}
+
+// Reference for one channel: binary search on every call
+static Mat4 reference_sample(const AnimationChannel& ch, float t) {
+  uint32_t cursor = 0;
+  Trs trs;
+  trs.translation = sample(ch.translation, t, cursor);
+  cursor = 0;
+  trs.rotation = sample(ch.rotation, t, cursor);
+  cursor = 0;
+  trs.scale = sample(ch.scale, t, cursor);
+  return trs.matrix();
+}
+
+int main() {
+  mt19937 rng(11);
+  bool ok = true;
+
+  // Quaternion and TRS conversions
+  {
+    uniform_real_distribution<double> u(-1.0, 1.0);
+    for (int i = 0; i < 100; i++) {
+      Trs trs;
+      trs.translation = {u(rng) * 10, u(rng) * 10, u(rng) * 10};
+      trs.rotation = Quat::rotate(Vec3(u(rng), u(rng), u(rng)).normalized(), u(rng) * pi);
+      trs.scale = {0.5 + u(rng) * 0.4, 1.5 + u(rng), 1.0 + u(rng) * 0.5};
+      if (i % 4 == 0) trs.scale.x = -trs.scale.x; // mirrored
+      const Mat4 m = trs.matrix();
+      ok &= near(Trs::decompose(m).matrix(), m);
+      const Vec3 v {u(rng), u(rng), u(rng)};
+      const Vec4 rotated = trs.rotation.matrix() * Vec4(v, 0);
+      ok &= near(trs.rotation.rotate_vector(v), rotated.truncated());
+    }
+    if (!ok) console << "Mismatch: TRS decomposition" << endl;
+  }
+
+  // Step, linear and cubic interpolation
+  {
+    Vec3Track track;
+    for (int k = 0; k < 5; k++)
+      track.add_key(k * 0.5, Vec3(k, 2.0 * k, -k));
+    uint32_t cursor = 0;
+    ok &= near(sample(track, 0.75f, cursor), Vec3(1.5, 3.0, -1.5));
+    ok &= near(sample(track, -1.f, cursor), Vec3(0, 0, 0));
+    ok &= near(sample(track, 9.f, cursor), Vec3(4, 8, -4));
+    track.interpolation = Interpolation::Step;
+    ok &= near(sample(track, 0.99f, cursor), Vec3(1, 2, -1));
+    // Catmull-Rom through evenly spaced collinear keys is the line itself
+    track.interpolation = Interpolation::Cubic;
+    track.auto_tangents();
+    ok &= near(sample(track, 1.3f, cursor), Vec3(2.6, 5.2, -2.6), 1e-4);
+
+    QuatTrack spin;
+    spin.add_key(0.0, Quat());
+    spin.add_key(1.0, Quat::rotate({0, 1, 0}, pi / 2));
+    const Quat half = sample(spin, 0.5f, cursor);
+    ok &= fabs(dot(half, Quat::rotate({0, 1, 0}, pi / 4)) - 1.0) < 1e-6;
+    if (!ok) console << "Mismatch: interpolation" << endl;
+  }
+
+  // The key cursor agrees with a binary search, going forward, back and jumping
+  {
+    vector<float> times;
+    for (int k = 0; k < 200; k++)
+      times.push_back(k * 0.1f + (k % 3) * 0.01f);
+    uniform_real_distribution<float> jump(-2.f, 22.f);
+    uint32_t cursor = 0;
+    float t = -0.5f;
+    bool same = true;
+    for (int i = 0; i < 10000; i++) {
+      t = i % 97 == 0 ? jump(rng) : t + 0.013f;
+      const uint32_t k = find_key(times, t, cursor);
+      const auto it = upper_bound(times.begin(), times.end(), t);
+      const uint32_t expect = it == times.begin() ? 0 : uint32_t(it - times.begin()) - 1;
+      same &= k == expect;
+    }
+    if (!same) console << "Mismatch: key cursor" << endl;
+    ok &= same;
+  }
+
+  // Models bound directly: every other one animated; only those are reported as changed
+  {
+    ModelStore store;
+    const size_t model_num = 2000;
+    vector<ModelHandle> handles;
+    for (size_t i = 0; i < model_num; i++)
+      handles.push_back(store.create(Mat4::translate({double(i), 0, 0}), 0, 0));
+    auto clip = make_shared<AnimationClip>();
+    for (size_t i = 0; i < model_num; i += 2)
+      fill_channel(clip->add_channel(L"model"), {double(i), 0, 0}, 8, rng);
+    clip->fit_duration();
+    Animator animator;
+    const Animator::PlaybackId playback = animator.play(clip);
+    for (size_t i = 0; i < model_num; i += 2)
+      animator.bind(playback, i / 2, store, handles[i]);
+
+    bool same = true;
+    for (int frame = 0; frame < 30; frame++) {
+      const ModelStore::Version since = store.version();
+      animator.advance(1.0 / 60);
+      same &= animator.apply(store) == model_num / 2;
+      size_t changed = 0;
+      store.changes_since(since, [&](ModelHandle h) {
+        changed++;
+        same &= store.dense_index(h) % 2 == 0;
+      });
+      same &= changed == model_num / 2;
+      const float t = float(fmod(animator.time(playback), clip->duration));
+      for (size_t i = 0; i < model_num; i += 2)
+        same &= near(store.transform(handles[i]), reference_sample(clip->channels[i / 2], t));
+      same &= near(store.transform(handles[1]), Mat4::translate({1, 0, 0}));
+    }
+    // Stale handles are skipped
+    store.destroy(handles[0]);
+    same &= animator.apply(store) == model_num / 2 - 1;
+    if (!same) console << "Mismatch: model bindings" << endl;
+    ok &= same;
+  }
+
+  // Nodes bound by name; children follow through the graph update
+  {
+    ModelStore store;
+    SceneGraph graph;
+    const ModelHandle model = store.create(Mat4::I(), 0, 0);
+    const SceneGraph::NodeId arm
+      = graph.add_node(SceneGraph::k_invalid_node, Mat4::I(), L"arm");
+    const SceneGraph::NodeId hand = graph.add_node(arm, Mat4::translate({2, 0, 0}), L"hand");
+    graph.bind(hand, model);
+    graph.update(&store);
+
+    auto clip = make_shared<AnimationClip>();
+    clip->add_channel(L"arm").rotation.add_key(0.0, Quat());
+    clip->channels[0].rotation.add_key(1.0, Quat::rotate({0, 0, 1}, pi));
+    clip->add_channel(L"missing").translation.add_key(0.0, Vec3());
+    clip->fit_duration();
+    Animator animator;
+    const Animator::PlaybackId playback = animator.play(clip, false);
+    bool same = animator.bind(playback, graph) == 1;
+    animator.seek(playback, 0.5);
+    same &= animator.apply(store, &graph) == 1;
+    graph.update(&store);
+    // A quarter turn around z takes the hand from +x to +y
+    same &= near(store.transform(model)[3].truncated(), Vec3(0, 2, 0));
+    animator.seek(playback, 5.0); // clamped to the end when not looping
+    animator.apply(store, &graph);
+    graph.update(&store);
+    same &= near(store.transform(model)[3].truncated(), Vec3(-2, 0, 0));
+    if (!same) console << "Mismatch: node bindings" << endl;
+    ok &= same;
+  }
+
+  // Throughput: a crowd of models, each playing one of 256 channels (64 keys per track) at its
+  // own offset in the clip
+  {
+    const size_t channel_num = 256, crowd = 200, model_num = channel_num * crowd, frames = 240;
+    auto clip = make_shared<AnimationClip>();
+    for (size_t c = 0; c < channel_num; c++)
+      fill_channel(clip->add_channel(L"model"), {double(c), 0, 0}, 64, rng);
+    clip->fit_duration();
+    ModelStore store;
+    store.reserve(model_num);
+    Animator animator;
+    vector<ModelHandle> handles;
+    vector<double> offsets;
+    uniform_real_distribution<double> offset(0.0, clip->duration);
+    for (size_t p = 0; p < crowd; p++) {
+      const Animator::PlaybackId playback = animator.play(clip);
+      offsets.push_back(offset(rng));
+      animator.seek(playback, offsets.back());
+      for (size_t c = 0; c < channel_num; c++) {
+        handles.push_back(store.create(Mat4::translate({double(c), double(p), 0}), 0, 0));
+        animator.bind(playback, c, store, handles.back());
+      }
+    }
+    console << "Models: " << model_num << ", keys per track: 64, "
+            << global_thread_pool().concurrency() << " threads" << endl;
+
+    auto start = Clock::now();
+    for (size_t f = 0; f < frames; f++) {
+      animator.advance(1.0 / 60);
+      animator.apply(store);
+    }
+    const double batched = ms_since(start) / frames;
+
+    // Per-model setters with a binary search per track, as hand-written animation would do
+    start = Clock::now();
+    double time = 0;
+    for (size_t f = 0; f < frames; f++) {
+      time += 1.0 / 60;
+      for (size_t i = 0; i < model_num; i++) {
+        const float t = float(fmod(time + offsets[i / channel_num], clip->duration));
+        store.set_transform(handles[i], reference_sample(clip->channels[i % channel_num], t));
+      }
+    }
+    const double naive = ms_since(start) / frames;
+    console << "Animator: " << batched << " ms/frame; per-model set_transform: " << naive
+            << " ms/frame (" << naive / batched << "x)" << endl;
+  }
+
+  console << "Animation check: " << (ok ? "passed" : "FAILED") << endl;
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,108 @@
+// Check vertex AO baking for determinism and progressive convergence, and time a bake
+
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <ao_baker.h>
+#include <console.h>
+#include <geometry.h>
+#include <parallel.h>
+#include <scene.h>
+
+using namespace std;
+using namespace rei;
+
+using Clock = chrono::high_resolution_clock;
+using AoStreams = vector<AmbientOcclusionBaker::AoStream>;
+
+static double ms_since(Clock::time_point start) {
+  return chrono::duration<double, milli>(Clock::now() - start).count();
+}
+
+// Spheres resting on a floor slab, each with a mesh of its own
+static void build_scene(Scene& scene, int sphere_num) {
+  scene.add_model(Mat4::I(), make_shared<Mesh>(Mesh::procudure_cube({8, 0.1, 8})), L"floor");
+  for (int i = 0; i < sphere_num; i++) {
+    const double x = -6.0 + 12.0 * i / (std::max)(sphere_num - 1, 1);
+    auto sphere = make_shared<Mesh>(Mesh::procudure_sphere_icosahedron(3, 0.5, {x, 0.6, 0}));
+    scene.add_model(Mat4::I(), sphere, L"sphere");
+  }
+}
+
+static AoStreams bake_progressive(
+  AmbientOcclusionBaker& baker, const AoBakeOptions& options, int samples_per_pass) {
+  baker.start_progressive(options, samples_per_pass);
+  while (!baker.progressive_finished())
+    this_thread::sleep_for(chrono::milliseconds(1));
+  baker.stop_progressive();
+  AoStreams ao;
+  baker.fetch_progressive(ao);
+  return ao;
+}
+
+int main() {
+  bool ok = true;
+  Scene scene(L"AO Bench");
+  build_scene(scene, 8);
+  AmbientOcclusionBaker baker(scene);
+  ok &= baker.models().size() == 9;
+
+  AoBakeOptions options;
+  options.sample_num = 64;
+  options.seed = 7;
+
+  // The same result whatever the thread count
+  const auto start = Clock::now();
+  const AoStreams reference = baker.bake(options);
+  const double bake_ms = ms_since(start);
+  for (size_t worker_num : {1, 3, 7}) {
+    ThreadPool pool(worker_num);
+    ok &= baker.bake(options, pool) == reference;
+  }
+
+  // Progressive passes of any size converge to exactly the one-shot result
+  for (int samples_per_pass : {1, 5, 64}) {
+    const AoStreams progressive = bake_progressive(baker, options, samples_per_pass);
+    ok &= progressive == reference && baker.progressive_samples() == options.sample_num;
+  }
+
+  // Plausible values: the floor far from the spheres is open, sphere bottoms touching it are not
+  size_t vertex_num = 0;
+  double floor_max = 0, sphere_min = 1;
+  for (size_t m = 0; m < reference.size(); m++) {
+    for (float occ : reference[m]) {
+      ok &= occ >= 0 && occ <= 1;
+      if (m == 0) floor_max = (std::max)(floor_max, double(occ));
+      else sphere_min = (std::min)(sphere_min, double(occ));
+    }
+    vertex_num += reference[m].size();
+  }
+  ok &= floor_max == 1 && sphere_min < 0.5;
+  // Another seed gives another (still valid) result
+  AoBakeOptions reseeded = options;
+  reseeded.seed = 8;
+  ok &= baker.bake(reseeded) != reference;
+
+  // Writing AO is idempotent, and stamps a new geometry version each time
+  const MeshPtr floor = dynamic_pointer_cast<Mesh>(baker.models()[0]->get_geometry());
+  const Geometry::Version before = floor->version();
+  AmbientOcclusionBaker::write_vertex_colors(baker.models(), reference);
+  const vector<Mesh::Vertex> first = floor->get_vertices();
+  const Geometry::Version first_version = floor->version();
+  AmbientOcclusionBaker::write_vertex_colors(baker.models(), reference);
+  const vector<Mesh::Vertex>& second = floor->get_vertices();
+  ok &= first_version > before && floor->version() > first_version;
+  for (size_t v = 0; v < first.size(); v++) {
+    const float occ = reference[0][v];
+    ok &= second[v].color.r == first[v].color.r && second[v].color.a == first[v].color.a;
+    ok &= first[v].color.r == Colors::white.r * occ;
+  }
+
+  console << "AO bake: " << vertex_num << " vertices x " << options.sample_num << " rays in "
+          << bake_ms << " ms (" << vertex_num * options.sample_num / (bake_ms * 1e3)
+          << " Mrays/s, " << global_thread_pool().concurrency() << " threads)" << endl;
+  console << "AO baker check: " << (ok ? "passed" : "FAILED") << endl;
+  return ok ? 0 : 1;
+}
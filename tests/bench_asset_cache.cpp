@@ -0,0 +1,141 @@
+// Benchmark the content hash of the asset cache, and check its store/find/evict behavior in a
+// scratch directory
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <asset_cache.h>
+#include <console.h>
+#include <scene.h>
+#include <scene_archive.h>
+
+using namespace std;
+using namespace rei;
+namespace fs = std::filesystem;
+
+using Clock = chrono::high_resolution_clock;
+
+static double ms_since(Clock::time_point start) {
+  return chrono::duration<double, milli>(Clock::now() - start).count();
+}
+
+static bool write_file(const string& path, const vector<char>& bytes) {
+  ofstream out(path, ios::binary);
+  out.write(bytes.data(), bytes.size());
+  return bool(out);
+}
+
+static size_t file_count(const fs::path& dir) {
+  size_t n = 0;
+  for (const auto& entry : fs::directory_iterator(dir))
+    n += entry.is_regular_file();
+  return n;
+}
+
+int main() {
+  bool ok = true;
+
+  // Published XXH64 values, covering the 32-byte stripes and every tail length
+  auto pattern = [](size_t n) {
+    vector<unsigned char> bytes(n);
+    for (size_t i = 0; i < n; i++)
+      bytes[i] = (unsigned char)(i * 7 % 251);
+    return bytes;
+  };
+  ok &= hash_bytes("", 0) == 0xEF46DB3751D8E999ull;
+  ok &= hash_bytes("abc", 3) == 0x44BC2CF5AD770999ull;
+  ok &= hash_bytes(pattern(37).data(), 37) == 0x478890C607390313ull;
+  ok &= hash_bytes(pattern(37).data(), 37, 42) == 0x965D24D3583EB628ull;
+  ok &= hash_bytes(pattern(1000).data(), 1000) == 0x023FD2ED1FF957D5ull;
+  ok &= hash_bytes(pattern(1000).data(), 1000, 42) == 0x72A2DDA94EEC1E7Eull;
+  const bool hash_ok = ok;
+
+  // Throughput; a cache hit costs one pass like this over the source file
+  vector<char> big(size_t(256) << 20);
+  mt19937_64 rng(3);
+  for (size_t i = 0; i < big.size(); i += 8)
+    *reinterpret_cast<uint64_t*>(&big[i]) = rng();
+  auto start = Clock::now();
+  const uint64_t big_hash = hash_bytes(big.data(), big.size());
+  const double hash_ms = ms_since(start);
+  ok &= big_hash != 0;
+
+  // A scratch cache, small enough to evict: room for three 1 MiB entries
+  const fs::path dir = fs::temp_directory_path() / "rei_bench_asset_cache";
+  fs::remove_all(dir);
+  AssetCache::Options options;
+  options.directory = dir.string();
+  options.max_bytes = (uint64_t(3) << 20) + 1024;
+  AssetCache cache(options);
+
+  // Keys follow the content and the options
+  const string source = (dir / "source.bin").string();
+  vector<char> content(1 << 20, 'a');
+  ok &= write_file(source, content);
+  const uint64_t key = AssetCache::key(source, 1);
+  ok &= key != 0 && key == AssetCache::key(source, 1) && key != AssetCache::key(source, 2);
+  content[content.size() / 2] = 'b';
+  ok &= write_file(source, content);
+  ok &= AssetCache::key(source, 1) != key;
+  ok &= AssetCache::key((dir / "missing.bin").string(), 1) == 0;
+  fs::remove(source);
+
+  // Miss, store, hit
+  ok &= cache.find(key).empty();
+  ok &= cache.store(key, [&](const string& path) { return write_file(path, content); });
+  const string hit = cache.find(key);
+  ok &= !hit.empty() && fs::file_size(hit) == content.size();
+
+  // A failed write publishes nothing and leaves no temporary file
+  const size_t files_before = file_count(dir);
+  ok &= !cache.store(key + 1, [&](const string& path) {
+    write_file(path, content);
+    return false;
+  });
+  ok &= cache.find(key + 1).empty() && file_count(dir) == files_before;
+
+  // Least recently used entries go first: entry `key` is refreshed, so `key + 2` is the oldest
+  // once the fourth entry is stored
+  for (uint64_t k = key + 2; k < key + 4; k++) {
+    this_thread::sleep_for(chrono::milliseconds(20));
+    ok &= cache.store(k, [&](const string& path) { return write_file(path, content); });
+  }
+  this_thread::sleep_for(chrono::milliseconds(20));
+  ok &= !cache.find(key).empty();
+  this_thread::sleep_for(chrono::milliseconds(20));
+  ok &= cache.store(key + 4, [&](const string& path) { return write_file(path, content); });
+  ok &= cache.find(key + 2).empty();
+  ok &= !cache.find(key).empty() && !cache.find(key + 3).empty() && !cache.find(key + 4).empty();
+  ok &= cache.evict() <= options.max_bytes;
+
+  // Scene archives round-trip through the cache, as AssetLoader stores them
+  Scene scene;
+  for (int i = 0; i < 16; i++) {
+    auto sphere = make_shared<Mesh>(Mesh::procudure_sphere(3));
+    scene.add_model(Mat4::translate({double(i), 0, 0}), sphere, L"sphere");
+  }
+  const uint64_t scene_key = key + 5;
+  ok &= cache.store(
+    scene_key, [&](const string& path) { return write_scene_archive(path, scene); });
+  start = Clock::now();
+  shared_ptr<const SceneArchive> archive = SceneArchive::open(cache.find(scene_key));
+  shared_ptr<Scene> cached = archive ? archive->instantiate() : nullptr;
+  const double open_ms = ms_since(start);
+  ok &= cached && cached->get_models().size() == scene.get_models().size();
+
+  archive.reset();
+  cached.reset();
+  fs::remove_all(dir);
+
+  console << "Hash reference values: " << (hash_ok ? "match" : "MISMATCH") << endl;
+  console << "Hash: " << (big.size() >> 20) << " MiB in " << hash_ms << " ms ("
+          << big.size() / (hash_ms * 1e6) << " GB/s)" << endl;
+  console << "Cached scene opened in " << open_ms << " ms" << endl;
+  console << "Cache check: " << (ok ? "passed" : "FAILED") << endl;
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,217 @@
+// Check recording on several command lists against the null renderer: a G-pass worth of draws
+// split over 1 to 8 threads records the same commands
+
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <console.h>
+#include <null/null_renderer.h>
+#include <parallel.h>
+#include <render_pipeline.h>
+#include <render_pipelines/parallel_recording.h>
+#include <scene.h>
+
+using namespace std;
+using namespace rei;
+
+using Call = null::Renderer::Call;
+
+// What a G-pass binds, created once per renderer
+struct GPassSetup {
+  SwapchainHandle swapchain;
+  BufferHandle target;
+  BufferHandle instances;
+  ShaderHandle shader;
+  vector<GeometryBuffers> geometries;
+  RenderPassCommand pass;
+
+  GPassSetup(null::Renderer& renderer, size_t draw_num) {
+    swapchain = renderer.create_swapchain(
+      SystemWindowID {SystemWindowID::Offscreen, {}}, 64, 64, 2);
+    target = renderer.create_texture_2d(
+      TextureDesc::render_target(64, 64, ResourceFormat::B8G8R8A8_UNORM),
+      ResourceState::RenderTarget, L"Target");
+    ConstBufferLayout lo = {ShaderDataType::Float4x4, ShaderDataType::Float4x4};
+    instances = renderer.create_instance_buffer(lo, draw_num * 2, L"Instances");
+    RasterizationShaderMetaInfo meta;
+    meta.is_instanced = true;
+    shader = renderer.create_shader(L"gpass", std::move(meta));
+    auto cube = make_shared<Mesh>(Mesh::procudure_cube());
+    for (size_t i = 0; i < draw_num; i++)
+      geometries.push_back(renderer.create_geometry({cube}));
+    pass.render_targets = {target};
+    pass.viewport = RenderViewaport::full(64, 64);
+    pass.area = RenderArea::full(64, 64);
+  }
+
+  // Draws [begin, end), two instances each, in a pass only the first range clears
+  void record(CommandList* list, size_t begin, size_t end) const {
+    RenderPassCommand range_pass = pass;
+    range_pass.clear_rt = begin == 0;
+    list->begin_render_pass(range_pass);
+    DrawCommand draw = {};
+    draw.shader = shader;
+    draw.instance_buffer = instances;
+    for (size_t i = begin; i < end; i++) {
+      draw.vertex_buffer = geometries[i].vertex_buffer;
+      draw.index_buffer = geometries[i].index_buffer;
+      draw.instance_offset = i * 2;
+      draw.instance_count = 2;
+      list->draw(draw);
+    }
+    list->end_render_pass();
+  }
+};
+
+// Ranges finishing in reverse order still land in range order
+static bool check_merge_order() {
+  null::Renderer::Options options;
+  options.record_commands = true;
+  null::Renderer renderer(options);
+  const size_t range_num = 4;
+  GPassSetup setup(renderer, range_num * 10);
+  ThreadPool pool(range_num - 1);
+
+  CommandList* cmd_list = renderer.prepare();
+  cmd_list->transition(setup.target, ResourceState::RenderTarget);
+  const size_t ranges = record_in_parallel(&renderer, cmd_list, range_num * 10, 10,
+    [&](CommandList* list, size_t begin, size_t /*end*/) {
+      // Range r draws r + 1 times, so the ranges can be told apart
+      const size_t r = begin / 10;
+      this_thread::sleep_for(chrono::milliseconds(5 * (range_num - r)));
+      setup.record(list, begin, begin + r + 1);
+    },
+    pool);
+  cmd_list->transition(setup.target, ResourceState::Present);
+  renderer.present(setup.swapchain, false);
+
+  vector<Call> expected = {Call::Transition, Call::Submit};
+  for (size_t r = 0; r < range_num; r++) {
+    expected.push_back(Call::BeginRenderPass);
+    expected.insert(expected.end(), r + 1, Call::Draw);
+    expected.push_back(Call::EndRenderPass);
+  }
+  expected.push_back(Call::Transition);
+  expected.push_back(Call::Present);
+
+  const null::Renderer::Stats& stats = renderer.stats();
+  bool ok = ranges == range_num && renderer.commands() == expected;
+  ok &= stats.submitted_lists == range_num && stats[Call::Draw] == 10;
+  ok &= stats.drawn_instances == 20 && stats.failed_checks == 0;
+  return ok;
+}
+
+// Only the prepare() list transitions, and every list opened must be submitted before present()
+static bool check_misuse() {
+  null::Renderer renderer;
+  GPassSetup setup(renderer, 1);
+  renderer.prepare();
+  CommandList* list = renderer.open_command_list();
+  console << "(two warnings are expected below)" << endl;
+  list->transition(setup.target, ResourceState::PixelShaderResource);
+  bool ok = renderer.stats().failed_checks == 0; // counted on the list until submitted
+  renderer.present(setup.swapchain, false);
+  ok &= renderer.stats().failed_checks == 1;
+  renderer.submit(&list, 1);
+  ok &= renderer.stats().failed_checks == 2;
+  return ok;
+}
+
+struct Recording {
+  size_t lists = 0;
+  null::Renderer::Stats stats;
+};
+
+// `thread_num` == 1 records on the prepare() list alone
+static Recording record_gpass(size_t thread_num, size_t draw_num, int frame_num) {
+  null::Renderer renderer;
+  GPassSetup setup(renderer, draw_num);
+  ThreadPool pool(thread_num - 1);
+  const size_t grain = thread_num == 1 ? draw_num : 128;
+  auto record = [&](CommandList* list, size_t begin, size_t end) {
+    setup.record(list, begin, end);
+  };
+
+  Recording t;
+  renderer.reset_stats();
+  for (int frame = 0; frame < frame_num; frame++) {
+    CommandList* cmd_list = renderer.prepare();
+    cmd_list->transition(setup.target, ResourceState::RenderTarget);
+    t.lists = record_in_parallel(&renderer, cmd_list, draw_num, grain, record, pool);
+    cmd_list->transition(setup.target, ResourceState::Present);
+    renderer.present(setup.swapchain, false);
+  }
+  t.stats = renderer.stats();
+  return t;
+}
+
+// The deferred pipeline on a scene of many geometries, so the G-pass gets several lists where
+// the global pool has more than one thread
+static bool check_deferred(size_t geometry_num, int frame_num) {
+  Scene scene(L"Command List Bench");
+  auto mat = make_shared<Material>(L"material");
+  for (size_t i = 0; i < geometry_num; i++) {
+    auto cube = make_shared<Mesh>(Mesh::procudure_cube());
+    scene.add_model(Mat4::translate({i * 2.0, 0, 0}), cube, mat, L"cube");
+  }
+  scene.add_light(Light::point({0, 10, 0}, Colors::white, 100));
+
+  auto renderer = make_shared<null::Renderer>();
+  DeferredPipeline pipeline(renderer);
+  ViewportConfig view_conf = {};
+  view_conf.width = 1280;
+  view_conf.height = 720;
+  view_conf.window_id.platform = SystemWindowID::Offscreen;
+  const auto viewport = pipeline.register_viewport(view_conf);
+  pipeline.transform_viewport(viewport, Camera({0, 5, 30}));
+  SceneConfig scene_conf = {};
+  scene_conf.scene = &scene;
+  const auto scene_h = pipeline.register_scene(scene_conf);
+
+  pipeline.sync_scene(scene_h, scene);
+  pipeline.render(viewport, scene_h);
+  const size_t failed_before = renderer->stats().failed_checks;
+  renderer->reset_stats();
+  for (int frame = 0; frame < frame_num; frame++) {
+    pipeline.sync_scene(scene_h, scene);
+    pipeline.render(viewport, scene_h);
+  }
+
+  const null::Renderer::Stats& stats = renderer->stats();
+  const size_t failed_checks = failed_before + stats.failed_checks;
+  const size_t gpass_draws = stats[Call::Draw] / frame_num - 1; // and one shading draw
+  console << "Deferred with " << geometry_num << " geometries: " << gpass_draws
+          << " G-pass draws on " << stats.submitted_lists / frame_num << " extra lists ("
+          << global_thread_pool().concurrency() << " threads); " << failed_checks
+          << " failed checks" << endl;
+  pipeline.remove_scene(scene_h);
+  return failed_checks == 0 && gpass_draws == geometry_num;
+}
+
+int main() {
+  bool ok = true;
+  ok &= check_merge_order();
+  ok &= check_misuse();
+
+  const size_t draw_num = 4096;
+  const int frame_num = 50;
+  const Recording single = record_gpass(1, draw_num, frame_num);
+  ok &= single.lists == 1 && single.stats.failed_checks == 0;
+  for (size_t thread_num : {2, 4, 8}) {
+    const Recording t = record_gpass(thread_num, draw_num, frame_num);
+    // Same commands whichever way they were split
+    ok &= t.lists == thread_num && t.stats.failed_checks == 0;
+    ok &= t.stats[Call::Draw] == single.stats[Call::Draw];
+    ok &= t.stats.drawn_instances == single.stats.drawn_instances;
+    ok &= t.stats[Call::BeginRenderPass] == frame_num * thread_num;
+    console << "G-pass of " << draw_num << " draws on " << thread_num << " threads: " << t.lists
+            << " lists, " << t.stats[Call::Draw] / frame_num << " draws per frame" << endl;
+  }
+
+  ok &= check_deferred(1000, 20);
+
+  console << "Command list check: " << (ok ? "passed" : "FAILED") << endl;
+  return ok ? 0 : 1;
+}
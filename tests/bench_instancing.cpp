@@ -0,0 +1,72 @@
+// Benchmark grouping scene models into instanced draws
+
+#include <chrono>
+#include <random>
+#include <string>
+
+#include <console.h>
+#include <container_utils.h>
+#include <render_pipelines/instancing.h>
+#include <scene.h>
+
+using namespace std;
+using namespace rei;
+
+using Clock = chrono::high_resolution_clock;
+
+static double ms_since(Clock::time_point start) {
+  return chrono::duration<double, milli>(Clock::now() - start).count();
+}
+
+int main() {
+  const size_t model_num = 200000;
+  const size_t geometry_num = 64;
+  const size_t material_num = 4;
+  const int repeat = 10;
+
+  Scene scene;
+  vector<GeometryPtr> geometries;
+  vector<MaterialPtr> materials;
+  for (size_t i = 0; i < geometry_num; i++)
+    geometries.push_back(make_shared<Mesh>(L"mesh"));
+  for (size_t i = 0; i < material_num; i++)
+    materials.push_back(make_shared<Material>(L"material"));
+
+  mt19937 rng(11);
+  uniform_real_distribution<double> unit(-100.0, 100.0);
+  for (size_t i = 0; i < model_num; i++) {
+    const Mat4 t = Mat4::translate({unit(rng), unit(rng), unit(rng)});
+    scene.add_model(
+      t, geometries[rng() % geometry_num], materials[rng() % material_num], L"model");
+  }
+
+  InstanceBatchList list;
+  auto start = Clock::now();
+  for (int r = 0; r < repeat; r++)
+    list = build_instance_batches(scene);
+  double build_ms = ms_since(start) / repeat;
+
+  // Every model is drawn exactly once, by the batch of its geometry and material
+  Hashmap<Scene::ModelUID, const Model*> model_of_id;
+  for (const ModelPtr& m : scene.get_models())
+    model_of_id.insert({scene.get_id(m), m.get()});
+  bool ok = list.instance_count() == model_num;
+  size_t next = 0;
+  for (const InstanceBatch& batch : list.batches) {
+    ok &= batch.first_instance == next;
+    next += batch.instance_count;
+    for (size_t i = batch.first_instance; i < next && ok; i++) {
+      const Model* const* m = model_of_id.try_get(list.models[i]);
+      ok &= m && scene.get_id((*m)->get_geometry()) == batch.geometry
+            && scene.get_id((*m)->get_material()) == batch.material;
+      model_of_id.erase(list.models[i]); // a repeated model is not found again
+    }
+  }
+  ok &= next == model_num;
+
+  console << "Models: " << model_num << ", draws: " << list.batches.size() << " (at most "
+          << geometry_num * material_num << ")" << endl;
+  console << "Build batches: " << build_ms << " ms" << endl;
+  console << "Layout check: " << (ok ? "passed" : "FAILED") << endl;
+  return ok ? 0 : 1;
+}
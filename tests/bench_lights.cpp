@@ -0,0 +1,192 @@
+// Benchmark the light store and the packed light copy pipelines keep of it
+
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include <console.h>
+#include <light_store.h>
+#include <render_pipelines/scene_residency.h>
+
+using namespace std;
+using namespace rei;
+
+using Clock = chrono::high_resolution_clock;
+
+static double ms_since(Clock::time_point start) {
+  return chrono::duration<double, milli>(Clock::now() - start).count();
+}
+
+// What a pipeline's light buffer holds after uploading the dirty range of a mirror
+struct StandInLightBuffer {
+  vector<PackedLight> elements;
+  size_t uploaded = 0;
+
+  void upload(LightMirror& mirror) {
+    elements.resize(mirror.size());
+    if (!mirror.dirty()) return;
+    const size_t first = mirror.dirty_first();
+    const size_t count = mirror.dirty_last() - first;
+    memcpy(elements.data() + first, mirror.data() + first, count * sizeof(PackedLight));
+    uploaded += count;
+    mirror.clear_dirty();
+  }
+};
+
+static bool same_as_store(const StandInLightBuffer& buffer, const LightStore& store) {
+  vector<PackedLight> expected(store.size());
+  store.pack(0, store.size(), expected.data());
+  return buffer.elements.size() == expected.size()
+         && memcmp(buffer.elements.data(), expected.data(), expected.size() * sizeof(PackedLight))
+              == 0;
+}
+
+int main() {
+  const size_t light_num = 10000;
+  const size_t moving_num = 8;
+  const int frame_num = 1000;
+
+  mt19937 rng(11);
+  uniform_real_distribution<double> unit(-1, 1);
+  auto random_light = [&](size_t i) {
+    Light l = Light::point({unit(rng) * 50, 5 + unit(rng), unit(rng) * 50}, Colors::white, 100);
+    l.type = LightType(i % 5);
+    l.direction = Vec3(unit(rng), -1, unit(rng)).normalized();
+    l.range = 10;
+    l.inner_angle = 0.3;
+    l.outer_angle = 0.5;
+    l.radius = 0.2;
+    l.length = (l.type == LightType::Tube) ? 1.0 : 0.0;
+    return l;
+  };
+
+  bool ok = true;
+
+  // Handles survive swap-removal, and stale handles are rejected
+  LightStore store;
+  vector<LightHandle> handles;
+  for (size_t i = 0; i < 16; i++)
+    handles.push_back(store.create(random_light(i)));
+  const Light kept = store.get(handles[15]);
+  store.destroy(handles[3]);
+  ok &= !store.valid(handles[3]) && store.valid(handles[15]) && store.size() == 15;
+  ok &= store.dense_index(handles[15]) == 3; // the last light moved into the hole
+  ok &= store.get(handles[15]).position == kept.position;
+  const LightHandle reused = store.create(random_light(3));
+  ok &= reused.index() == handles[3].index() && reused != handles[3] && !store.valid(handles[3]);
+  handles[3] = reused;
+
+  // Changed ranges cover exactly what was touched since a version
+  LightStore::Version since = store.version();
+  size_t first, last;
+  store.changed_range(since, first, last);
+  ok &= first == last;
+  store.set_position(handles[5], {1, 2, 3});
+  store.set_intensity(handles[9], 7);
+  store.changed_range(since, first, last);
+  ok &= first == store.dense_index(handles[5]) && last == store.dense_index(handles[9]) + 1;
+  since = store.version();
+  store.destroy(handles[15]); // at dense 3, so the last light moves there
+  store.changed_range(since, first, last);
+  ok &= first == 3 && last == 4;
+
+  // Packing follows the shader layout
+  {
+    Light spot = random_light(1);
+    spot.color = Color(1.f, .5f, .25f);
+    spot.intensity = 4;
+    spot.flags = Light::Enabled;
+    const LightHandle h = store.create(spot);
+    PackedLight p;
+    store.pack(store.dense_index(h), store.dense_index(h) + 1, &p);
+    ok &= p.direction_type[3] == float(LightType::Spot) && p.radiance[3] == float(Light::Enabled);
+    ok &= p.radiance[0] == 4.0f && p.radiance[1] == 2.0f && p.radiance[2] == 1.0f;
+    ok &= std::abs(p.shape[0] - std::cos(0.5f)) < 1e-6f && p.position_range[3] == 10.0f;
+  }
+  store.clear();
+  ok &= store.empty();
+
+  // Many lights, a few moving per frame: only the changed range is re-packed and uploaded
+  handles.clear();
+  store.reserve(light_num);
+  auto start = Clock::now();
+  for (size_t i = 0; i < light_num; i++)
+    handles.push_back(store.create(random_light(i)));
+  const double create_ms = ms_since(start);
+
+  LightMirror mirror;
+  StandInLightBuffer buffer;
+  mirror.sync(store);
+  buffer.upload(mirror);
+  ok &= same_as_store(buffer, store);
+  const size_t initial_upload = buffer.uploaded;
+
+  // The movers are adjacent, like lights added together (e.g. one imported fixture)
+  const size_t mover_base = light_num / 2;
+  buffer.uploaded = 0;
+  start = Clock::now();
+  for (int frame = 0; frame < frame_num; frame++) {
+    const double t = frame * 0.01;
+    for (size_t k = 0; k < moving_num; k++) {
+      const Vec3 pos = {std::cos(t + k) * 10, 5, std::sin(t + k) * 10};
+      store.set_position(handles[mover_base + k], pos);
+    }
+    mirror.sync(store);
+    buffer.upload(mirror);
+  }
+  const double incremental_ms = ms_since(start);
+  const size_t incremental_upload = buffer.uploaded;
+  ok &= same_as_store(buffer, store);
+  ok &= incremental_upload == size_t(frame_num) * moving_num;
+
+  // Nothing changed: syncing is free
+  start = Clock::now();
+  for (int frame = 0; frame < frame_num; frame++)
+    ok &= !mirror.sync(store);
+  const double idle_ms = ms_since(start);
+
+  // Baseline: re-pack and upload every light every frame
+  vector<PackedLight> full(light_num);
+  start = Clock::now();
+  for (int frame = 0; frame < frame_num; frame++) {
+    const double t = frame * 0.01;
+    for (size_t k = 0; k < moving_num; k++) {
+      const Vec3 pos = {std::cos(t + k) * 10, 5, std::sin(t + k) * 10};
+      store.set_position(handles[mover_base + k], pos);
+    }
+    store.pack(0, store.size(), full.data());
+    memcpy(buffer.elements.data(), full.data(), full.size() * sizeof(PackedLight));
+  }
+  const double full_ms = ms_since(start);
+  mirror.sync(store);
+  buffer.upload(mirror);
+
+  // Churn: removals and additions keep the mirror equal to the store
+  for (int frame = 0; frame < 100; frame++) {
+    for (int k = 0; k < 16; k++) {
+      const size_t i = rng() % handles.size();
+      if (rng() % 2) {
+        store.destroy(handles[i]);
+        handles[i] = handles.back();
+        handles.pop_back();
+      } else {
+        handles.push_back(store.create(random_light(rng())));
+      }
+    }
+    mirror.sync(store);
+    buffer.upload(mirror);
+    ok &= same_as_store(buffer, store);
+  }
+
+  console << "Lights: " << light_num << ", created in " << create_ms << " ms" << endl;
+  console << "Initial upload: " << initial_upload << " lights" << endl;
+  console << "Incremental: " << moving_num << " moving lights, " << incremental_ms / frame_num
+          << " ms/frame, " << incremental_upload / frame_num << " lights uploaded/frame" << endl;
+  console << "Idle sync: " << idle_ms * 1e6 / frame_num << " ns/frame" << endl;
+  console << "Full repack: " << full_ms / frame_num << " ms/frame, " << light_num
+          << " lights uploaded/frame" << endl;
+  console << "Light check: " << (ok ? "passed" : "FAILED") << endl;
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,143 @@
+// Benchmark material property lookup by interned key, and compiling materials into blocks
+
+#include <chrono>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include <console.h>
+#include <material.h>
+#include <material_block.h>
+
+using namespace std;
+using namespace rei;
+
+using Clock = chrono::high_resolution_clock;
+
+static double ms_since(Clock::time_point start) {
+  return chrono::duration<double, milli>(Clock::now() - start).count();
+}
+
+int main() {
+  const size_t material_num = 2000;
+  const int lookup_rounds = 200;
+  const int frame_num = 1000;
+
+  bool ok = true;
+
+  // Built-in keys are fixed; other names get stable ids on first use
+  ok &= material_key(L"albedo") == MaterialKeys::albedo;
+  ok &= material_key(L"emissive") == MaterialKeys::emissive;
+  const MaterialKey roughness = material_key(L"clearcoat_roughness");
+  ok &= roughness >= MaterialKeys::builtin_count;
+  ok &= material_key(L"clearcoat_roughness") == roughness;
+  ok &= material_key_name(roughness) == Name(L"clearcoat_roughness");
+
+  MaterialSchema schema;
+  schema.add_float4(MaterialKeys::albedo, 0, Vec4(Colors::magenta))
+    .add_float(MaterialKeys::smoothness, 1, 0, 0)
+    .add_float(MaterialKeys::metalness, 1, 1, 0)
+    .add_float(MaterialKeys::emissive, 1, 2, 0)
+    .add_float(roughness, 1, 3, 0.5);
+  ok &= schema.row_count() == 2 && schema.layout().size() == 2;
+
+  // Compiled values land in their rows and lanes; missing or mistyped properties fall back
+  {
+    Material mat(L"Test");
+    mat.set(MaterialKeys::albedo, Color(1.f, .5f, .25f, 1.f));
+    mat.set(L"metalness", 1.0);
+    mat.set(MaterialKeys::smoothness, Colors::white); // wrong type
+    ParameterBlock block;
+    ok &= schema.compile(mat, block);
+    ok &= block.rows[0][0] == 1.f && block.rows[0][1] == .5f && block.rows[0][2] == .25f;
+    ok &= block.rows[1][0] == 0.f && block.rows[1][1] == 1.f && block.rows[1][2] == 0.f;
+    ok &= block.rows[1][3] == .5f && block.bytes() == 2 * 4 * sizeof(float);
+
+    // Unchanged materials are not compiled again
+    ok &= !schema.compile(mat, block);
+    const Material::Version before = Material::latest_version();
+    mat.set(L"emissive", 3.0);
+    ok &= Material::latest_version() > before && mat.version() == Material::latest_version();
+    ok &= schema.compile(mat, block) && block.rows[1][2] == 3.f;
+
+    Material empty;
+    ParameterBlock fallback;
+    ok &= schema.compile(empty, fallback);
+    ok &= fallback.rows[0][0] == 1.f && fallback.rows[0][1] == 0.f && fallback.rows[0][2] == 1.f;
+  }
+
+  mt19937 rng(5);
+  uniform_real_distribution<double> unit(0, 1);
+  vector<MaterialPtr> materials;
+  for (size_t i = 0; i < material_num; i++) {
+    auto mat = make_shared<Material>(L"Material");
+    mat->set(MaterialKeys::albedo, Color(float(unit(rng)), float(unit(rng)), float(unit(rng))));
+    mat->set(MaterialKeys::smoothness, unit(rng));
+    mat->set(MaterialKeys::metalness, unit(rng));
+    materials.push_back(mat);
+  }
+
+  // Lookup: by interned key vs by name
+  double sum_by_key = 0;
+  auto start = Clock::now();
+  for (int round = 0; round < lookup_rounds; round++)
+    for (const MaterialPtr& mat : materials)
+      sum_by_key += mat->get<double>(MaterialKeys::smoothness).value_or(0);
+  const double by_key_ms = ms_since(start);
+
+  double sum_by_name = 0;
+  start = Clock::now();
+  for (int round = 0; round < lookup_rounds; round++)
+    for (const MaterialPtr& mat : materials)
+      sum_by_name += mat->get<double>(L"smoothness").value_or(0);
+  const double by_name_ms = ms_since(start);
+  ok &= sum_by_key == sum_by_name;
+
+  // Per frame sync: a few materials edited, the rest skipped by version
+  vector<ParameterBlock> blocks(material_num);
+  start = Clock::now();
+  for (size_t i = 0; i < material_num; i++)
+    ok &= schema.compile(*materials[i], blocks[i]);
+  const double full_compile_ms = ms_since(start);
+
+  const size_t edited_num = 4;
+  size_t compiled = 0;
+  Material::Version synced = Material::latest_version();
+  start = Clock::now();
+  for (int frame = 0; frame < frame_num; frame++) {
+    for (size_t k = 0; k < edited_num; k++)
+      materials[rng() % material_num]->set(MaterialKeys::emissive, frame * 0.01);
+    const Material::Version latest = Material::latest_version();
+    if (latest == synced) continue;
+    for (size_t i = 0; i < material_num; i++)
+      compiled += schema.compile(*materials[i], blocks[i]);
+    synced = latest;
+  }
+  const double incremental_ms = ms_since(start);
+  ok &= compiled <= size_t(frame_num) * edited_num && compiled > 0;
+
+  // Idle frames: one counter compare
+  size_t idle_walks = 0;
+  start = Clock::now();
+  for (int frame = 0; frame < frame_num; frame++) {
+    const Material::Version latest = Material::latest_version();
+    if (latest == synced) continue;
+    idle_walks++;
+  }
+  const double idle_ms = ms_since(start);
+  ok &= idle_walks == 0;
+
+  for (size_t i = 0; i < material_num; i++)
+    ok &= blocks[i].version == materials[i]->version();
+
+  console << "Materials: " << material_num << endl;
+  const double lookup_num = double(lookup_rounds) * material_num;
+  console << "Lookup by key: " << by_key_ms * 1e6 / lookup_num
+          << " ns, by name: " << by_name_ms * 1e6 / lookup_num << " ns" << endl;
+  console << "Full compile: " << full_compile_ms << " ms" << endl;
+  console << "Incremental: " << edited_num << " edited materials, " << incremental_ms / frame_num
+          << " ms/frame, " << double(compiled) / frame_num << " compiled/frame" << endl;
+  console << "Idle sync: " << idle_ms * 1e6 / frame_num << " ns/frame" << endl;
+  console << "Material block check: " << (ok ? "passed" : "FAILED") << endl;
+  return ok ? 0 : 1;
+}
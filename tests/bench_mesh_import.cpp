@@ -0,0 +1,330 @@
+// Benchmark converting imported vertex streams into meshes, against the per-vertex scalar loop
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <vector>
+
+#include <asset_cache.h>
+#include <asset_loader.h>
+#include <console.h>
+#include <mesh_import.h>
+#include <parallel.h>
+#include <scene.h>
+
+using namespace std;
+using namespace rei;
+
+using Clock = chrono::high_resolution_clock;
+
+static double ms_since(Clock::time_point start) {
+  return chrono::duration<double, milli>(Clock::now() - start).count();
+}
+
+struct Streams {
+  vector<float> positions, normals, colors;
+  MeshStreams view(bool with_colors) const {
+    MeshStreams s;
+    s.positions = positions.data();
+    s.normals = normals.data();
+    s.colors = with_colors ? colors.data() : nullptr;
+    s.vertex_num = positions.size() / 3;
+    return s;
+  }
+};
+
+static Streams random_streams(mt19937& rng, size_t vertex_num) {
+  uniform_real_distribution<float> unit(-1.f, 1.f);
+  Streams s;
+  for (size_t i = 0; i < vertex_num * 3; i++) {
+    s.positions.push_back(unit(rng) * 100.f);
+    s.normals.push_back(unit(rng));
+  }
+  for (size_t i = 0; i < vertex_num * 4; i++)
+    s.colors.push_back(unit(rng) * 0.5f + 0.5f);
+  return s;
+}
+
+// The conversion loop as the importer used to do it, vertex by vertex
+static vector<Mesh::Vertex> reference_convert(const MeshStreams& src, const Mat4& trans) {
+  vector<Mesh::Vertex> va;
+  Mat3 trans_normal = trans.adj3();
+  for (size_t i = 0; i < src.vertex_num; ++i) {
+    const float* v = src.positions + i * 3;
+    const float* n = src.normals + i * 3;
+    Vec4 coord = Vec4(v[0], v[1], v[2], 1.0) * trans;
+    Vec3 normal = (Vec3(n[0], n[1], n[2]) * trans_normal).normalized();
+    Color color;
+    if (src.colors) {
+      const float* c = src.colors + i * 4;
+      color = Color(c[0], c[1], c[2], c[3]);
+    } else {
+      color = Color {0.5f, 0.5f, 0.5f, 1.0f};
+    }
+    va.push_back(Mesh::Vertex(coord, normal, color));
+  }
+  return va;
+}
+
+static bool same_bits(const vector<Mesh::Vertex>& a, const vector<Mesh::Vertex>& b) {
+  if (a.size() != b.size()) return false;
+  for (size_t i = 0; i < a.size(); i++) {
+    const Mesh::Vertex &x = a[i], &y = b[i];
+    if (memcmp(&x.coord, &y.coord, sizeof(Vec4)) != 0) return false;
+    if (memcmp(&x.normal, &y.normal, sizeof(Vec3)) != 0) return false;
+    if (memcmp(&x.color, &y.color, sizeof(Color)) != 0) return false;
+  }
+  return true;
+}
+
+// A triangle under two nested nodes, both rotating or scaling and translating. COLLADA matrices
+// are row-major and act on column vectors, so the world positions are parent * child * v.
+static const char k_nested_nodes_dae[] = R"(<?xml version="1.0" encoding="utf-8"?>
+<COLLADA xmlns="http://www.collada.org/2005/11/COLLADASchema" version="1.4.1">
+  <asset><unit name="meter" meter="1"/><up_axis>Y_UP</up_axis></asset>
+  <library_geometries>
+    <geometry id="tri" name="tri">
+      <mesh>
+        <source id="tri-pos">
+          <float_array id="tri-pos-array" count="9">0 0 0 1 0 0 0 2 0</float_array>
+          <technique_common>
+            <accessor source="#tri-pos-array" count="3" stride="3">
+              <param name="X" type="float"/><param name="Y" type="float"/>
+              <param name="Z" type="float"/>
+            </accessor>
+          </technique_common>
+        </source>
+        <source id="tri-nrm">
+          <float_array id="tri-nrm-array" count="9">0 0 1 0 0 1 0 0 1</float_array>
+          <technique_common>
+            <accessor source="#tri-nrm-array" count="3" stride="3">
+              <param name="X" type="float"/><param name="Y" type="float"/>
+              <param name="Z" type="float"/>
+            </accessor>
+          </technique_common>
+        </source>
+        <vertices id="tri-vtx">
+          <input semantic="POSITION" source="#tri-pos"/>
+          <input semantic="NORMAL" source="#tri-nrm"/>
+        </vertices>
+        <triangles count="1">
+          <input semantic="VERTEX" source="#tri-vtx" offset="0"/>
+          <p>0 1 2</p>
+        </triangles>
+      </mesh>
+    </geometry>
+  </library_geometries>
+  <library_visual_scenes>
+    <visual_scene id="scene" name="scene">
+      <node id="parent" name="parent">
+        <matrix>0 -1 0 3 1 0 0 4 0 0 1 5 0 0 0 1</matrix>
+        <node id="child" name="child">
+          <matrix>2 0 0 0 0 1 0 -1 0 0 1 0 0 0 0 1</matrix>
+          <instance_geometry url="#tri"/>
+        </node>
+      </node>
+    </visual_scene>
+  </library_visual_scenes>
+  <scene><instance_visual_scene url="#scene"/></scene>
+</COLLADA>
+)";
+
+// Node transforms of an imported world compose like the file says, as baked vertices do
+static bool check_node_transforms() {
+  namespace fs = std::filesystem;
+  const fs::path path = fs::temp_directory_path() / "rei_bench_nested_nodes.dae";
+  ofstream(path) << k_nested_nodes_dae;
+  const Vec3 expected[] = {{4, 4, 5}, {4, 6, 5}, {2, 4, 5}};
+  auto matches = [&](const vector<Vec3>& positions) {
+    bool ok = positions.size() == 3;
+    for (const Vec3& e : expected) {
+      bool found = false;
+      for (const Vec3& p : positions)
+        found |= (p - e).norm() < 1e-5;
+      ok &= found;
+    }
+    return ok;
+  };
+
+  AssetLoader loader(nullptr);
+  bool ok = true;
+  vector<Vec3> baked;
+  for (const MeshPtr& mesh : loader.load_meshes(path.string()))
+    for (const Mesh::Vertex& v : mesh->get_vertices())
+      baked.push_back(v.coord.truncated());
+  ok &= matches(baked);
+
+  vector<Vec3> placed;
+  ScenePtr world = get<0>(loader.load_world(path.string()));
+  for (const ModelPtr& model : world->get_models()) {
+    const Mat4 trans = model->get_transform();
+    const Mesh* mesh = dynamic_cast<const Mesh*>(model->get_geometry().get());
+    for (const Mesh::Vertex& v : mesh->get_vertices()) {
+      const Vec4 p = trans * v.coord;
+      placed.push_back(Vec3(p.x, p.y, p.z));
+    }
+  }
+  ok &= matches(placed);
+  fs::remove(path);
+  return ok;
+}
+
+// A triangle whose vertices and indices are in an external buffer, triangle.bin: positions
+// (36 bytes), normals (36 bytes), then 16-bit indices (6 bytes)
+static const char k_triangle_gltf[] = R"({
+  "asset": {"version": "2.0"},
+  "scene": 0,
+  "scenes": [{"nodes": [0]}],
+  "nodes": [{"mesh": 0}],
+  "meshes": [{"primitives": [{"attributes": {"POSITION": 0, "NORMAL": 1}, "indices": 2}]}],
+  "buffers": [{"uri": "triangle.bin", "byteLength": 78}],
+  "bufferViews": [
+    {"buffer": 0, "byteOffset": 0, "byteLength": 36},
+    {"buffer": 0, "byteOffset": 36, "byteLength": 36},
+    {"buffer": 0, "byteOffset": 72, "byteLength": 6}
+  ],
+  "accessors": [
+    {"bufferView": 0, "componentType": 5126, "count": 3, "type": "VEC3",
+     "min": [0, 0, 0], "max": [1, 2, 0]},
+    {"bufferView": 1, "componentType": 5126, "count": 3, "type": "VEC3"},
+    {"bufferView": 2, "componentType": 5123, "count": 3, "type": "SCALAR"}
+  ]
+}
+)";
+
+static void write_triangle_bin(const std::filesystem::path& path, float height) {
+  const float floats[] = {0, 0, 0, 1, 0, 0, 0, height, 0, 0, 0, 1, 0, 0, 1, 0, 0, 1};
+  const uint16_t indices[] = {0, 1, 2};
+  ofstream out(path, ios::binary);
+  out.write(reinterpret_cast<const char*>(floats), sizeof(floats));
+  out.write(reinterpret_cast<const char*>(indices), sizeof(indices));
+}
+
+// Self-contained files are cached; files reading others are imported every time, since the
+// cache key only covers the file itself and edits of the others would go unseen
+static bool check_import_cache() {
+  namespace fs = std::filesystem;
+  const fs::path dir = fs::temp_directory_path() / "rei_bench_import_cache";
+  fs::remove_all(dir);
+  fs::create_directories(dir);
+  AssetCache::Options options;
+  options.directory = (dir / "cache").string();
+  AssetLoader loader(make_shared<AssetCache>(options));
+  auto entries = [&]() {
+    size_t n = 0;
+    for (const auto& entry : fs::directory_iterator(options.directory))
+      n += entry.path().extension() == ".cache";
+    return n;
+  };
+  auto height = [](const vector<MeshPtr>& meshes) {
+    double h = 0;
+    for (const MeshPtr& mesh : meshes)
+      for (const Mesh::Vertex& v : mesh->get_vertices())
+        h = (std::max)(h, v.coord.y);
+    return h;
+  };
+
+  const fs::path dae = dir / "nested_nodes.dae";
+  ofstream(dae) << k_nested_nodes_dae;
+  bool ok = loader.load_meshes(dae.string()).size() == 1 && entries() == 1;
+  ok &= loader.load_meshes(dae.string()).size() == 1 && entries() == 1; // a hit
+
+  const fs::path gltf = dir / "triangle.gltf";
+  ofstream(gltf) << k_triangle_gltf;
+  write_triangle_bin(dir / "triangle.bin", 2);
+  ok &= height(loader.load_meshes(gltf.string())) == 2 && entries() == 1;
+  write_triangle_bin(dir / "triangle.bin", 4);
+  ok &= height(loader.load_meshes(gltf.string())) == 4 && entries() == 1;
+
+  fs::remove_all(dir);
+  return ok;
+}
+
+int main() {
+  mt19937 rng(11);
+
+  // Transforms as node hierarchies produce them, including a non-affine last column
+  Mat4 rotate_scale = Mat4::translate({3, -2, 7});
+  rotate_scale(0, 0) = 0.8;
+  rotate_scale(0, 1) = -0.6;
+  rotate_scale(1, 0) = 0.6 * 2.5;
+  rotate_scale(1, 1) = 0.8 * 2.5;
+  rotate_scale(2, 2) = 0.3;
+  Mat4 projective = rotate_scale;
+  projective(0, 3) = 0.01;
+  projective(3, 3) = 1.5;
+  const Mat4 transforms[] = {Mat4::I(), Mat4::translate({1.5, 0, -4}), rotate_scale, projective};
+
+  // Bit-identical to the scalar loop, for odd and even sizes, with and without colors
+  bool ok = true;
+  for (size_t vertex_num : {0, 1, 2, 7, 64, 1001, 50000}) {
+    const Streams s = random_streams(rng, vertex_num);
+    for (const Mat4& trans : transforms) {
+      for (bool colors : {false, true}) {
+        const MeshStreams view = s.view(colors);
+        ok &= same_bits(convert_vertices(view, trans), reference_convert(view, trans));
+      }
+    }
+  }
+
+  // A 500-mesh scene, converted mesh by mesh on one thread, then in parallel across meshes (and
+  // across vertex ranges of the large ones)
+  const size_t mesh_num = 500;
+  vector<Streams> meshes;
+  size_t total_vertices = 0;
+  for (size_t i = 0; i < mesh_num; i++) {
+    const size_t vertex_num = i % 50 == 0 ? 200000 : 2000 + rng() % 20000;
+    meshes.push_back(random_streams(rng, vertex_num));
+    total_vertices += vertex_num;
+  }
+  vector<vector<Mesh::Vertex>> serial(mesh_num), parallel(mesh_num);
+  auto start = Clock::now();
+  for (size_t i = 0; i < mesh_num; i++)
+    serial[i] = reference_convert(meshes[i].view(true), rotate_scale);
+  const double serial_ms = ms_since(start);
+
+  start = Clock::now();
+  parallel_for(0, mesh_num, 1,
+    [&](size_t i) { parallel[i] = convert_vertices(meshes[i].view(true), rotate_scale); });
+  const double parallel_ms = ms_since(start);
+  for (size_t i = 0; i < mesh_num; i++)
+    ok &= same_bits(serial[i], parallel[i]);
+
+  // Instanced import keeps a part in mesh space and transforms it at render time, with the
+  // normal matrix for normals; same result as baking, for any affine node transform
+  const Streams part = random_streams(rng, 20000);
+  const vector<Mesh::Vertex> local = convert_vertices(part.view(true), Mat4::I());
+  for (const Mat4& world : {transforms[0], transforms[1], transforms[2]}) {
+    // The importer bakes with row vectors
+    const vector<Mesh::Vertex> baked = convert_vertices(part.view(true), world.T());
+    const Mat4 normal = world.normal_matrix();
+    for (size_t i = 0; i < local.size(); i++) {
+      const Vec4 p = world * local[i].coord;
+      const Vec4 n4 = normal * Vec4(local[i].normal, 0);
+      const Vec3 n = Vec3(n4.x, n4.y, n4.z).normalized();
+      ok &= (Vec3(p.x, p.y, p.z) - baked[i].coord.truncated()).norm() < 1e-9;
+      ok &= (n - baked[i].normal).norm() < 1e-6;
+    }
+  }
+  // Memory for the part placed 1000 times, e.g. a bolt in a CAD assembly
+  const size_t placements = 1000;
+  const size_t baked_bytes = placements * local.size() * sizeof(Mesh::Vertex);
+  const size_t instanced_bytes
+    = local.size() * sizeof(Mesh::Vertex) + placements * 2 * sizeof(Mat4);
+
+  console << "Meshes: " << mesh_num << ", vertices: " << total_vertices << endl;
+  console << "Scalar loop: " << serial_ms << " ms, vectorized + parallel: " << parallel_ms
+          << " ms on " << global_thread_pool().concurrency() << " threads ("
+          << serial_ms / parallel_ms << "x)" << endl;
+  console << "Part with " << local.size() << " vertices placed " << placements << " times: baked "
+          << baked_bytes / (1 << 20) << " MiB, instanced " << instanced_bytes / (1 << 20) << " MiB"
+          << endl;
+  ok &= check_node_transforms();
+  ok &= check_import_cache();
+  console << "Import check: " << (ok ? "passed" : "FAILED") << endl;
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,215 @@
+// Benchmark the native OBJ/PLY readers on a generated height field, and check them against the
+// generating data
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <console.h>
+#include <mesh_reader.h>
+#include <parallel.h>
+
+using namespace std;
+using namespace rei;
+namespace fs = std::filesystem;
+
+using Clock = chrono::high_resolution_clock;
+
+static double ms_since(Clock::time_point start) {
+  return chrono::duration<double, milli>(Clock::now() - start).count();
+}
+
+// A side x side grid of vertices, with quads between them
+struct Grid {
+  size_t side;
+  vector<float> positions, normals;
+  vector<unsigned char> colors; // rgb
+  vector<uint32_t> quads;
+
+  Grid(size_t side, mt19937& rng) : side(side) {
+    uniform_real_distribution<float> height(-0.5f, 0.5f);
+    for (size_t y = 0; y < side; y++)
+      for (size_t x = 0; x < side; x++) {
+        positions.insert(positions.end(), {float(x) * 0.25f, height(rng), float(y) * -0.125f});
+        normals.insert(normals.end(), {0.f, 1.f, 0.f});
+        colors.insert(colors.end(), {(unsigned char)(x), (unsigned char)(y), 200});
+      }
+    for (size_t y = 0; y + 1 < side; y++)
+      for (size_t x = 0; x + 1 < side; x++) {
+        const uint32_t a = uint32_t(y * side + x);
+        quads.insert(quads.end(), {a, a + 1, a + 1 + uint32_t(side), a + uint32_t(side)});
+      }
+  }
+  size_t vertex_num() const { return side * side; }
+
+  // Quads fan-triangulated, as the readers do
+  vector<uint32_t> triangles() const {
+    vector<uint32_t> ret;
+    for (size_t q = 0; q < quads.size(); q += 4)
+      ret.insert(ret.end(),
+        {quads[q], quads[q + 1], quads[q + 2], quads[q], quads[q + 2], quads[q + 3]});
+    return ret;
+  }
+};
+
+// Rows of faces alternate between absolute and relative indices
+static void write_obj(const string& path, const Grid& g) {
+  FILE* f = fopen(path.c_str(), "wb");
+  fprintf(f, "# generated\no grid\n");
+  for (size_t v = 0; v < g.vertex_num(); v++) {
+    const float* p = &g.positions[v * 3];
+    const unsigned char* c = &g.colors[v * 3];
+    fprintf(f, "v %.9g %.9g %.9g %.9g %.9g %.9g\n", p[0], p[1], p[2], c[0] / 255.0, c[1] / 255.0,
+      c[2] / 255.0);
+  }
+  for (size_t v = 0; v < g.vertex_num(); v++)
+    fprintf(f, "vn 0 1 0\n");
+  const long long n = (long long)g.vertex_num();
+  for (size_t q = 0; q < g.quads.size(); q += 4) {
+    fprintf(f, "f");
+    for (int k = 0; k < 4; k++) {
+      const long long index = g.quads[q + k];
+      if ((q / 4 / (g.side - 1)) % 2)
+        fprintf(f, " %lld//%lld", index - n, index - n);
+      else
+        fprintf(f, " %lld/%lld/%lld", index + 1, index + 1, index + 1);
+    }
+    fprintf(f, "\n");
+  }
+  fclose(f);
+}
+
+static void write_ply(const string& path, const Grid& g, const char* format, bool triangulate) {
+  const bool big = strcmp(format, "binary_big_endian") == 0;
+  const bool ascii = strcmp(format, "ascii") == 0;
+  const vector<uint32_t> faces = triangulate ? g.triangles() : g.quads;
+  const size_t face_size = triangulate ? 3 : 4;
+  FILE* f = fopen(path.c_str(), "wb");
+  fprintf(f, "ply\nformat %s 1.0\ncomment generated\n", format);
+  fprintf(f, "element vertex %zu\n", g.vertex_num());
+  fprintf(f, "property float x\nproperty float y\nproperty float z\n");
+  fprintf(f, "property uchar red\nproperty uchar green\nproperty uchar blue\n");
+  fprintf(f, "element face %zu\nproperty list uchar int vertex_indices\n",
+    faces.size() / face_size);
+  fprintf(f, "end_header\n");
+  auto put = [&](const void* data, size_t bytes) {
+    unsigned char b[8];
+    memcpy(b, data, bytes);
+    if (big) reverse(b, b + bytes);
+    fwrite(b, 1, bytes, f);
+  };
+  for (size_t v = 0; v < g.vertex_num(); v++) {
+    const float* p = &g.positions[v * 3];
+    const unsigned char* c = &g.colors[v * 3];
+    if (ascii) {
+      fprintf(f, "%.9g %.9g %.9g %d %d %d\n", p[0], p[1], p[2], c[0], c[1], c[2]);
+    } else {
+      for (int k = 0; k < 3; k++)
+        put(p + k, 4);
+      fwrite(c, 1, 3, f);
+    }
+  }
+  for (size_t i = 0; i < faces.size(); i += face_size) {
+    const unsigned char n = (unsigned char)face_size;
+    if (ascii) {
+      fprintf(f, "%d", n);
+      for (size_t k = 0; k < face_size; k++)
+        fprintf(f, " %u", faces[i + k]);
+      fprintf(f, "\n");
+    } else {
+      fwrite(&n, 1, 1, f);
+      for (size_t k = 0; k < face_size; k++) {
+        const int32_t index = int32_t(faces[i + k]);
+        put(&index, 4);
+      }
+    }
+  }
+  fclose(f);
+}
+
+static bool matches(const MeshData& mesh, const Grid& g) {
+  bool ok = mesh.positions == g.positions && mesh.indices == g.triangles();
+  ok &= mesh.colors.size() == g.vertex_num() * 4 && mesh.normals.size() == g.positions.size();
+  for (size_t v = 0; ok && v < g.vertex_num(); v++) {
+    for (int k = 0; k < 3; k++)
+      ok &= fabs(mesh.colors[v * 4 + k] - g.colors[v * 3 + k] / 255.f) <= 1e-6f;
+    ok &= mesh.colors[v * 4 + 3] == 1.f;
+  }
+  return ok;
+}
+
+int main() {
+  mt19937 rng(5);
+  const fs::path dir = fs::temp_directory_path() / "rei_bench_mesh_reader";
+  fs::remove_all(dir);
+  fs::create_directories(dir);
+  auto path = [&](const char* name) { return (dir / name).string(); };
+
+  // Every format and code path on a small grid
+  bool ok = true;
+  const Grid small(37, rng);
+  write_obj(path("small.obj"), small);
+  write_ply(path("small_ascii.ply"), small, "ascii", false);
+  write_ply(path("small_le.ply"), small, "binary_little_endian", true);
+  write_ply(path("small_be.ply"), small, "binary_big_endian", true);
+  write_ply(path("small_quads.ply"), small, "binary_little_endian", false);
+  for (const char* name : {"small.obj", "small_ascii.ply", "small_le.ply", "small_be.ply",
+         "small_quads.ply"}) {
+    MeshData mesh;
+    const bool read = read_mesh_data(path(name), mesh);
+    const bool same = read && matches(mesh, small);
+    if (!same) console << "Mismatch: " << name << endl;
+    ok &= same;
+  }
+  // OBJ normals are kept; PLY normals are computed, unit length and facing up the height field
+  {
+    MeshData mesh;
+    ok &= read_mesh_data(path("small.obj"), mesh) && mesh.normals == small.normals;
+  }
+  {
+    MeshData mesh;
+    ok &= read_mesh_data(path("small_le.ply"), mesh);
+    for (size_t v = 0; ok && v < mesh.vertex_num(); v++) {
+      const float* n = &mesh.normals[v * 3];
+      ok &= n[1] > 0.f && fabs(n[0] * n[0] + n[1] * n[1] + n[2] * n[2] - 1.f) < 1e-4f;
+    }
+    auto built = build_mesh(mesh, L"grid");
+    ok &= built->get_vertices().size() == mesh.vertex_num()
+          && built->get_triangles().size() == mesh.triangle_num();
+  }
+  // Malformed input is rejected
+  {
+    const char bad_obj[] = "v 0 0 0\nv 1 0 0\nf 1 2 3\n";
+    const char bad_ply[]
+      = "ply\nformat ascii 1.0\nelement vertex 2\nproperty float x\nend_header\n";
+    MeshData mesh;
+    ok &= !read_obj(reinterpret_cast<const uint8_t*>(bad_obj), sizeof(bad_obj) - 1, mesh);
+    ok &= !read_ply(reinterpret_cast<const uint8_t*>(bad_ply), sizeof(bad_ply) - 1, mesh);
+  }
+
+  // Throughput on a large grid
+  const Grid large(1500, rng);
+  write_obj(path("large.obj"), large);
+  write_ply(path("large.ply"), large, "binary_little_endian", true);
+  console << "Vertices: " << large.vertex_num() << ", triangles: " << large.triangles().size() / 3
+          << ", " << global_thread_pool().concurrency() << " threads" << endl;
+  for (const char* name : {"large.obj", "large.ply"}) {
+    const double mib = double(fs::file_size(path(name))) / (1 << 20);
+    MeshData mesh;
+    auto start = Clock::now();
+    ok &= read_mesh_data(path(name), mesh);
+    const double ms = ms_since(start);
+    ok &= mesh.positions == large.positions;
+    console << name << ": " << mib << " MiB in " << ms << " ms (" << mib / ms * 1000.0
+            << " MiB/s)" << endl;
+  }
+
+  fs::remove_all(dir);
+  console << "Reader check: " << (ok ? "passed" : "FAILED") << endl;
+  return ok ? 0 : 1;
+}
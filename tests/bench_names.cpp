@@ -0,0 +1,127 @@
+// Benchmark interned names against plain wide strings, and check interning across threads
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <common.h>
+#include <console.h>
+
+using namespace std;
+using namespace rei;
+
+using Clock = chrono::high_resolution_clock;
+
+static double ms_since(Clock::time_point start) {
+  return chrono::duration<double, milli>(Clock::now() - start).count();
+}
+
+int main() {
+  const size_t name_num = 20000;
+  const int rounds = 50;
+  const int thread_num = 8;
+
+  bool ok = true;
+
+  // Equal strings share a symbol; the empty name is the default one
+  ok &= Name(L"Model-Un-Named") == Name(wstring(L"Model-Un-Named"));
+  ok &= Name(L"a") != Name(L"b") && Name(L"a").str() == L"a";
+  ok &= Name().empty() && Name(L"") == Name() && Name().str().empty();
+  ok &= sizeof(Name) == 4;
+
+  vector<wstring> strings;
+  for (size_t i = 0; i < name_num; i++)
+    strings.push_back(L"scene/node_" + to_wstring(i) + L"/mesh");
+
+  // Threads interning the same strings concurrently, in different orders, agree on the symbols
+  vector<vector<Name::Symbol>> symbols(thread_num, vector<Name::Symbol>(name_num));
+  atomic<bool> reads_ok {true};
+  {
+    vector<thread> threads;
+    for (int t = 0; t < thread_num; t++) {
+      threads.emplace_back([&, t]() {
+        for (size_t k = 0; k < name_num; k++) {
+          // Each thread starts elsewhere, every other one walking backwards
+          const size_t step = (t % 2) ? name_num - 1 - k : k;
+          const size_t i = (step + t * name_num / thread_num) % name_num;
+          const Name name(strings[i]);
+          symbols[t][i] = name.symbol();
+          if (name.str() != strings[i]) reads_ok = false;
+        }
+      });
+    }
+    for (thread& th : threads)
+      th.join();
+  }
+  ok &= reads_ok;
+  for (int t = 1; t < thread_num; t++)
+    ok &= symbols[t] == symbols[0];
+
+  vector<Name> names(strings.begin(), strings.end());
+  for (size_t i = 0; i < name_num; i++)
+    ok &= names[i].symbol() == symbols[0][i];
+
+  // Interning a string seen before: a lookup, no allocation
+  auto start = Clock::now();
+  size_t checksum = 0;
+  for (int r = 0; r < rounds; r++)
+    for (const wstring& s : strings)
+      checksum += Name(s).symbol();
+  const double intern_ms = ms_since(start);
+
+  // Copy and compare, as scene objects do with their names
+  start = Clock::now();
+  size_t equal_names = 0;
+  for (int r = 0; r < rounds; r++) {
+    vector<Name> copies(names);
+    for (size_t i = 0; i < name_num; i++)
+      equal_names += copies[i] == names[(i + r) % name_num];
+  }
+  const double name_copy_ms = ms_since(start);
+
+  start = Clock::now();
+  size_t equal_strings = 0;
+  for (int r = 0; r < rounds; r++) {
+    vector<wstring> copies(strings);
+    for (size_t i = 0; i < name_num; i++)
+      equal_strings += copies[i] == strings[(i + r) % name_num];
+  }
+  const double string_copy_ms = ms_since(start);
+  ok &= equal_names == equal_strings;
+
+  // Lookup by name in a hash map
+  unordered_map<Name, size_t> by_name;
+  unordered_map<wstring, size_t> by_string;
+  for (size_t i = 0; i < name_num; i++) {
+    by_name.emplace(names[i], i);
+    by_string.emplace(strings[i], i);
+  }
+  start = Clock::now();
+  size_t found_names = 0;
+  for (int r = 0; r < rounds; r++)
+    for (const Name& n : names)
+      found_names += by_name.find(n)->second;
+  const double name_map_ms = ms_since(start);
+  start = Clock::now();
+  size_t found_strings = 0;
+  for (int r = 0; r < rounds; r++)
+    for (const wstring& s : strings)
+      found_strings += by_string.find(s)->second;
+  const double string_map_ms = ms_since(start);
+  ok &= found_names == found_strings;
+
+  const double ops = double(rounds) * name_num;
+  console << "Names: " << Name::interned_count() << " interned, " << sizeof(Name) << " bytes vs "
+          << sizeof(wstring) << " bytes per wstring" << endl;
+  console << "Re-intern: " << intern_ms * 1e6 / ops << " ns (checksum " << checksum % 1000 << ")"
+          << endl;
+  console << "Copy and compare: " << name_copy_ms * 1e6 / ops << " ns by Name, "
+          << string_copy_ms * 1e6 / ops << " ns by wstring" << endl;
+  console << "Map lookup: " << name_map_ms * 1e6 / ops << " ns by Name, "
+          << string_map_ms * 1e6 / ops << " ns by wstring" << endl;
+  console << "Name check: " << (ok ? "passed" : "FAILED") << endl;
+  return ok ? 0 : 1;
+}
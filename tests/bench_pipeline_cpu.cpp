@@ -0,0 +1,250 @@
+// Benchmark the CPU side of the render pipelines, recording into the null renderer
+
+#include <chrono>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <camera.h>
+#include <console.h>
+#include <null/null_renderer.h>
+#include <render_pipeline.h>
+#include <scene.h>
+
+using namespace std;
+using namespace rei;
+
+using Clock = chrono::high_resolution_clock;
+
+static double ms_since(Clock::time_point start) {
+  return chrono::duration<double, milli>(Clock::now() - start).count();
+}
+
+struct Measure {
+  double register_ms = 0;
+  double frame_ms = 0;
+  null::Renderer::Stats per_frame;
+  size_t failed_checks = 0;
+};
+
+template <typename Pipeline>
+static Measure measure(Scene& scene, const vector<ModelPtr>& movers, int frame_num) {
+  using Call = null::Renderer::Call;
+  auto renderer = make_shared<null::Renderer>();
+  Pipeline pipeline(renderer);
+
+  ViewportConfig view_conf = {};
+  view_conf.width = 1280;
+  view_conf.height = 720;
+  view_conf.window_id.platform = SystemWindowID::Offscreen;
+  const auto viewport = pipeline.register_viewport(view_conf);
+  pipeline.transform_viewport(viewport, Camera({0, 50, 200}));
+
+  Measure m;
+  auto start = Clock::now();
+  SceneConfig scene_conf = {};
+  scene_conf.scene = &scene;
+  const auto scene_h = pipeline.register_scene(scene_conf);
+  m.register_ms = ms_since(start);
+
+  // Warm up: the first frame creates per-viewport arguments
+  pipeline.sync_scene(scene_h, scene);
+  pipeline.render(viewport, scene_h);
+
+  const size_t failed_before = renderer->stats().failed_checks;
+  renderer->reset_stats();
+  start = Clock::now();
+  for (int frame = 0; frame < frame_num; frame++) {
+    for (size_t i = 0; i < movers.size(); i++)
+      movers[i]->set_transform(Mat4::translate({double(frame), double(i), 0}));
+    pipeline.sync_scene(scene_h, scene);
+    pipeline.render(viewport, scene_h);
+  }
+  m.frame_ms = ms_since(start) / frame_num;
+
+  const null::Renderer::Stats& stats = renderer->stats();
+  for (size_t c = 0; c < size_t(Call::Count); c++)
+    m.per_frame.calls[c] = stats.calls[c] / frame_num;
+  m.per_frame.uploaded_bytes = stats.uploaded_bytes / frame_num;
+  m.per_frame.drawn_instances = stats.drawn_instances / frame_num;
+  m.per_frame.presented_frames = stats.presented_frames;
+  m.failed_checks = failed_before + stats.failed_checks;
+
+  pipeline.remove_scene(scene_h);
+  return m;
+}
+
+// Editing a shared mesh uploads it again on the next sync, once, and only then
+template <typename Pipeline>
+static bool check_geometry_edit() {
+  using Call = null::Renderer::Call;
+  Scene scene(L"Geometry Edit");
+  auto edited = make_shared<Mesh>(Mesh::procudure_cube());
+  auto mat = make_shared<Material>(L"material");
+  for (int i = 0; i < 3; i++)
+    scene.add_model(Mat4::translate({i * 2.0, 0, 0}), edited, mat, L"edited");
+  scene.add_model(Mat4::I(), make_shared<Mesh>(Mesh::procudure_cube()), mat, L"untouched");
+
+  auto renderer = make_shared<null::Renderer>();
+  Pipeline pipeline(renderer);
+  ViewportConfig view_conf = {};
+  view_conf.width = 64;
+  view_conf.height = 64;
+  view_conf.window_id.platform = SystemWindowID::Offscreen;
+  const auto viewport = pipeline.register_viewport(view_conf);
+  SceneConfig scene_conf = {};
+  scene_conf.scene = &scene;
+  const auto scene_h = pipeline.register_scene(scene_conf);
+  pipeline.sync_scene(scene_h, scene);
+  pipeline.render(viewport, scene_h);
+
+  renderer->reset_stats();
+  edited->set_vertex_colors(vector<Color>(edited->get_vertices().size(), Colors::red));
+  pipeline.sync_scene(scene_h, scene);
+  pipeline.render(viewport, scene_h);
+  bool ok = renderer->stats()[Call::CreateGeometry] == 1;
+  renderer->reset_stats();
+  pipeline.sync_scene(scene_h, scene);
+  pipeline.render(viewport, scene_h);
+  ok &= renderer->stats()[Call::CreateGeometry] == 0 && renderer->stats().failed_checks == 0;
+  pipeline.remove_scene(scene_h);
+  return ok;
+}
+
+// Models added and removed after registration are drawn, and dropped, from the next sync on
+template <typename Pipeline>
+static bool check_add_remove() {
+  Scene scene(L"Add Remove");
+  auto cube = make_shared<Mesh>(Mesh::procudure_cube());
+  auto mat = make_shared<Material>(L"material");
+  scene.add_model(Mat4::I(), cube, mat, L"first");
+
+  auto renderer = make_shared<null::Renderer>();
+  Pipeline pipeline(renderer);
+  ViewportConfig view_conf = {};
+  view_conf.width = 64;
+  view_conf.height = 64;
+  view_conf.window_id.platform = SystemWindowID::Offscreen;
+  const auto viewport = pipeline.register_viewport(view_conf);
+  SceneConfig scene_conf = {};
+  scene_conf.scene = &scene;
+  const auto scene_h = pipeline.register_scene(scene_conf);
+  pipeline.sync_scene(scene_h, scene);
+  pipeline.render(viewport, scene_h);
+  const size_t one_model = renderer->stats().drawn_instances;
+
+  // Two more, one of them with another geometry
+  scene.add_model(Mat4::translate({2, 0, 0}), cube, mat, L"second");
+  scene.add_model(
+    Mat4::translate({4, 0, 0}), make_shared<Mesh>(Mesh::procudure_cube()), mat, L"third");
+  renderer->reset_stats();
+  pipeline.sync_scene(scene_h, scene);
+  pipeline.render(viewport, scene_h);
+  bool ok = renderer->stats().drawn_instances == one_model + 2;
+
+  scene.remove_model(scene.get_models().front());
+  renderer->reset_stats();
+  pipeline.sync_scene(scene_h, scene);
+  pipeline.render(viewport, scene_h);
+  ok &= renderer->stats().drawn_instances == one_model + 1;
+
+  // Models the pipeline never saw are ignored
+  pipeline.update_model(scene_h, *scene.get_models().front(), 0);
+  ok &= renderer->stats().failed_checks == 0;
+  pipeline.remove_scene(scene_h);
+  return ok;
+}
+
+// A model without geometry is kept but draws nothing: one G-pass instance, then the shading draw
+static bool check_geometry_less() {
+  using Call = null::Renderer::Call;
+  Scene scene(L"Geometry Less");
+  auto mat = make_shared<Material>(L"material");
+  scene.add_model(Mat4::I(), make_shared<Mesh>(Mesh::procudure_cube()), mat, L"cube");
+  scene.add_model(Mat4::I(), nullptr, mat, L"empty");
+
+  auto renderer = make_shared<null::Renderer>();
+  DeferredPipeline pipeline(renderer);
+  ViewportConfig view_conf = {};
+  view_conf.width = 64;
+  view_conf.height = 64;
+  view_conf.window_id.platform = SystemWindowID::Offscreen;
+  const auto viewport = pipeline.register_viewport(view_conf);
+  SceneConfig scene_conf = {};
+  scene_conf.scene = &scene;
+  const auto scene_h = pipeline.register_scene(scene_conf);
+  pipeline.sync_scene(scene_h, scene);
+  pipeline.render(viewport, scene_h);
+  const null::Renderer::Stats& stats = renderer->stats();
+  bool ok = stats[Call::Draw] == 2 && stats.drawn_instances == 2 && stats.failed_checks == 0;
+  pipeline.remove_scene(scene_h);
+  return ok;
+}
+
+static void report(const char* name, const Measure& m) {
+  using Call = null::Renderer::Call;
+  console << name << ": register " << m.register_ms << " ms, frame " << m.frame_ms << " ms, "
+          << m.per_frame[Call::Draw] << " draws (" << m.per_frame.drawn_instances
+          << " instances), " << m.per_frame[Call::Dispatch] << " dispatches, "
+          << m.per_frame[Call::Raytrace] << " traces, " << m.per_frame.uploaded_bytes / 1024
+          << " KiB uploaded per frame; " << m.failed_checks << " failed checks" << endl;
+}
+
+int main() {
+  const size_t model_num = 20000;
+  const size_t geometry_num = 64;
+  const size_t material_num = 16;
+  const size_t moving_num = 200;
+  const int frame_num = 50;
+
+  Scene scene(L"Headless Bench");
+  vector<GeometryPtr> geometries;
+  vector<MaterialPtr> materials;
+  for (size_t i = 0; i < geometry_num; i++)
+    geometries.push_back(make_shared<Mesh>(Mesh::procudure_cube()));
+  for (size_t i = 0; i < material_num; i++) {
+    auto mat = make_shared<Material>(L"material");
+    mat->set(MaterialKeys::albedo, Colors::white);
+    mat->set(MaterialKeys::smoothness, i / double(material_num));
+    materials.push_back(mat);
+  }
+
+  mt19937 rng(3);
+  uniform_real_distribution<double> unit(-100.0, 100.0);
+  for (size_t i = 0; i < model_num; i++) {
+    const Mat4 t = Mat4::translate({unit(rng), unit(rng), unit(rng)});
+    scene.add_model(
+      t, geometries[rng() % geometry_num], materials[rng() % material_num], L"model");
+  }
+  for (int i = 0; i < 8; i++) {
+    Light light = Light::point({unit(rng), 20, unit(rng)}, Colors::white, 100);
+    light.type = (i % 2) ? LightType::Sphere : LightType::Point;
+    light.radius = 0.5;
+    scene.add_light(light);
+  }
+  vector<ModelPtr> movers(scene.get_models().begin(), scene.get_models().begin() + moving_num);
+
+  const Measure deferred = measure<DeferredPipeline>(scene, movers, frame_num);
+  const Measure hybrid = measure<HybridPipeline>(scene, movers, frame_num);
+
+  using Call = null::Renderer::Call;
+  bool ok = true;
+  for (const Measure* m : {&deferred, &hybrid}) {
+    ok &= m->failed_checks == 0;
+    ok &= m->per_frame[Call::Draw] > 0 && m->per_frame.presented_frames == size_t(frame_num);
+    // Instanced: far fewer draws than models, but every model drawn
+    ok &= m->per_frame[Call::Draw] <= geometry_num * material_num + 2;
+    ok &= m->per_frame.drawn_instances >= model_num;
+  }
+  ok &= hybrid.per_frame[Call::Dispatch] > 0 && hybrid.per_frame[Call::Raytrace] > 0;
+  ok &= check_geometry_edit<DeferredPipeline>() && check_geometry_edit<HybridPipeline>();
+  ok &= check_add_remove<DeferredPipeline>() && check_add_remove<HybridPipeline>();
+  ok &= check_geometry_less();
+
+  console << "Models: " << model_num << ", moving: " << moving_num << endl;
+  report("Deferred", deferred);
+  report("Hybrid", hybrid);
+  console << "Pipeline CPU check: " << (ok ? "passed" : "FAILED") << endl;
+  return ok ? 0 : 1;
+}
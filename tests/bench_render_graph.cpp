@@ -0,0 +1,174 @@
+// Check render graph culling and aliasing, and report the hybrid pipeline's texture memory at 4K
+
+#include <chrono>
+#include <memory>
+#include <vector>
+
+#include <console.h>
+#include <null/null_renderer.h>
+#include <render_pipeline.h>
+#include <render_pipelines/render_graph.h>
+#include <scene.h>
+
+using namespace std;
+using namespace rei;
+
+using Clock = chrono::high_resolution_clock;
+
+static double ms_since(Clock::time_point start) {
+  return chrono::duration<double, milli>(Clock::now() - start).count();
+}
+
+static double mib(size_t bytes) {
+  return bytes / (1024.0 * 1024.0);
+}
+
+// A small chain: two scratch textures used one after another can share memory, a pass nobody
+// reads is culled, and a debug view is kept only on request
+static bool check_small_graph(bool debug_views) {
+  using RS = ResourceState;
+  const TextureDesc desc
+    = TextureDesc::unorder_access(64, 64, ResourceFormat::R32G32B32A32_FLOAT);
+  RenderGraph graph;
+  const auto a = graph.create_texture(desc, L"A");
+  const auto b = graph.create_texture(desc, L"B");
+  const auto c = graph.create_texture(desc, L"C");
+  const auto unused = graph.create_texture(desc, L"Unused");
+  const auto output = graph.import_texture(L"Output", RS::Present);
+
+  const auto write_a = graph.add_pass(L"Write A");
+  graph.write(write_a, a, RS::UnorderedAccess);
+  const auto a_to_b = graph.add_pass(L"A to B");
+  graph.read(a_to_b, a, RS::ComputeShaderResource);
+  graph.write(a_to_b, b, RS::UnorderedAccess);
+  const auto dead = graph.add_pass(L"Dead");
+  graph.read(dead, a, RS::ComputeShaderResource);
+  graph.write(dead, unused, RS::UnorderedAccess);
+  const auto b_to_c = graph.add_pass(L"B to C");
+  graph.read(b_to_c, b, RS::ComputeShaderResource);
+  graph.write(b_to_c, c, RS::UnorderedAccess);
+  const auto present = graph.add_pass(L"Present");
+  graph.read(present, c, RS::PixelShaderResource);
+  graph.write(present, output, RS::RenderTarget);
+  const auto debug = graph.add_pass(L"Debug A", true);
+  graph.read(debug, a, RS::PixelShaderResource);
+  graph.write(debug, output, RS::RenderTarget);
+
+  RenderGraph::CompileOptions options {};
+  options.debug_views = debug_views;
+  bool ok = graph.compile(options);
+  ok &= graph.is_culled(dead) && !graph.is_culled(present);
+  ok &= graph.is_culled(debug) != debug_views;
+  const auto& report = graph.report();
+  ok &= report.transient_count == 3;
+  if (debug_views) {
+    // The debug view reads A last, so all three are live together
+    ok &= report.physical_count == 3;
+  } else {
+    ok &= report.physical_count == 2;
+    ok &= graph.physical(c) == graph.physical(a) && graph.physical(b) != graph.physical(a);
+  }
+  ok &= report.physical_bytes == report.peak_live_bytes;
+
+  // Executing on the null renderer leaves every texture in the state its pass needs
+  auto renderer = make_shared<null::Renderer>();
+  graph.realize(renderer.get());
+  const auto swapchain
+    = renderer->create_swapchain(SystemWindowID {SystemWindowID::Offscreen, {}}, 64, 64, 2);
+  for (int frame = 0; frame < 3; frame++) {
+    CommandList* cmd_list = renderer->prepare();
+    graph.bind_import(output, renderer->fetch_swapchain_render_target_buffer(swapchain));
+    for (auto pass : {write_a, a_to_b, dead, b_to_c, present, debug})
+      graph.begin_pass(cmd_list, pass);
+    graph.end_frame(cmd_list);
+    renderer->present(swapchain, false);
+  }
+  ok &= renderer->stats().failed_checks == 0;
+  const size_t swapchain_bytes = 2 * 64 * 64 * 4;
+  ok &= renderer->stats().texture_bytes == report.physical_bytes + swapchain_bytes;
+  return ok;
+}
+
+// Reading a scratch texture no pass wrote is a compile error
+static bool check_read_before_write() {
+  RenderGraph graph;
+  const auto t = graph.create_texture(
+    TextureDesc::unorder_access(8, 8, ResourceFormat::R32G32B32A32_FLOAT), L"Never Written");
+  const auto out = graph.import_texture(L"Output");
+  const auto pass = graph.add_pass(L"Reader");
+  graph.read(pass, t, ResourceState::ComputeShaderResource);
+  graph.write(pass, out, ResourceState::UnorderedAccess);
+  console << "(a warning is expected below)" << endl;
+  return !graph.compile();
+}
+
+int main() {
+  bool ok = true;
+  ok &= check_small_graph(false);
+  ok &= check_small_graph(true);
+  ok &= check_read_before_write();
+
+  // The hybrid pipeline at 4K, headless
+  const size_t width = 3840;
+  const size_t height = 2160;
+  const int frame_num = 10;
+
+  Scene scene(L"Render Graph Bench");
+  auto cube = make_shared<Mesh>(Mesh::procudure_cube());
+  auto mat = make_shared<Material>(L"material");
+  for (int i = 0; i < 100; i++)
+    scene.add_model(Mat4::translate({i * 2.0, 0, 0}), cube, mat, L"cube");
+  Light area = Light::point({0, 10, 0}, Colors::white, 100);
+  area.type = LightType::Sphere;
+  area.radius = 1;
+  scene.add_light(area);
+
+  auto renderer = make_shared<null::Renderer>();
+  HybridPipeline pipeline(renderer);
+  const size_t bytes_before_viewport = renderer->stats().texture_bytes;
+
+  ViewportConfig view_conf = {};
+  view_conf.width = width;
+  view_conf.height = height;
+  view_conf.window_id.platform = SystemWindowID::Offscreen;
+  auto start = Clock::now();
+  const auto viewport = pipeline.register_viewport(view_conf);
+  const double register_ms = ms_since(start);
+  const size_t viewport_bytes = renderer->stats().texture_bytes - bytes_before_viewport;
+
+  SceneConfig scene_conf = {};
+  scene_conf.scene = &scene;
+  const auto scene_h = pipeline.register_scene(scene_conf);
+  pipeline.transform_viewport(viewport, Camera({0, 5, 30}));
+
+  renderer->reset_stats();
+  for (int frame = 0; frame < frame_num; frame++) {
+    pipeline.sync_scene(scene_h, scene);
+    pipeline.render(viewport, scene_h);
+  }
+  using Call = null::Renderer::Call;
+  const null::Renderer::Stats& stats = renderer->stats();
+  ok &= stats.failed_checks == 0 && stats.presented_frames == size_t(frame_num);
+
+  const RenderGraph* graph = pipeline.render_graph(viewport);
+  ok &= graph != nullptr;
+  if (graph) {
+    const RenderGraph::Report& report = graph->report();
+    ok &= report.physical_bytes < report.transient_bytes;
+    ok &= report.physical_bytes >= report.peak_live_bytes;
+    console << "Hybrid frame graph at " << width << "x" << height << ": " << report.pass_count
+            << " passes (" << report.culled_pass_count << " culled), "
+            << report.transient_count << " transient textures on " << report.physical_count
+            << " physical, " << report.split_transition_count << " split transitions" << endl;
+    console << "Transient memory: " << mib(report.transient_bytes) << " MiB without aliasing, "
+            << mib(report.physical_bytes) << " MiB aliased (peak live "
+            << mib(report.peak_live_bytes) << " MiB)" << endl;
+  }
+  console << "Viewport textures created: " << mib(viewport_bytes) << " MiB, registered in "
+          << register_ms << " ms" << endl;
+  console << "Per frame: " << stats[Call::Transition] / frame_num << " transitions, "
+          << stats[Call::Barrier] / frame_num << " UAV barriers; " << stats.failed_checks
+          << " failed checks" << endl;
+  console << "Render graph check: " << (ok ? "passed" : "FAILED") << endl;
+  return ok ? 0 : 1;
+}
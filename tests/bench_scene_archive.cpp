@@ -0,0 +1,137 @@
+// Benchmark writing and mapping a binary scene archive, against building the scene in memory
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <random>
+#include <string>
+
+#include <console.h>
+#include <material.h>
+#include <scene.h>
+#include <scene_archive.h>
+
+using namespace std;
+using namespace rei;
+
+using Clock = chrono::high_resolution_clock;
+
+static double ms_since(Clock::time_point start) {
+  return chrono::duration<double, milli>(Clock::now() - start).count();
+}
+
+int main() {
+  const size_t mesh_num = 64;
+  const size_t material_num = 8;
+  const size_t node_num = 20000;
+  const string path = "bench_scene_archive.rsa";
+
+  // Scene as the asset loader produces it: meshes in node space, bound to graph nodes
+  auto start = Clock::now();
+  Scene scene;
+  vector<GeometryPtr> meshes;
+  for (size_t i = 0; i < mesh_num; i++)
+    meshes.push_back(make_shared<Mesh>(Mesh::procudure_sphere(3, 1.0 + i * 0.01)));
+  vector<MaterialPtr> materials;
+  for (size_t i = 0; i < material_num; i++) {
+    auto mat = make_shared<Material>(L"material" + to_wstring(i));
+    mat->set(L"albedo", Color(0.1f * i, 0.5f, 0.25f, 1.0f));
+    mat->set(L"smoothness", 0.125 * i);
+    materials.push_back(mat);
+  }
+  mt19937 rng(3);
+  uniform_real_distribution<double> unit(-1.0, 1.0);
+  SceneGraph& graph = scene.graph();
+  for (size_t i = 0; i < node_num; i++) {
+    const SceneGraph::NodeId parent
+      = i < 16 ? SceneGraph::k_invalid_node : SceneGraph::NodeId(rng() % i);
+    Mat4 local = Mat4::translate({unit(rng) * 10, unit(rng) * 10, unit(rng) * 10});
+    SceneGraph::NodeId node = graph.add_node(parent, local, L"node");
+    if (i % 2 == 0) {
+      const GeometryPtr& mesh = meshes[rng() % mesh_num];
+      scene.add_model(Mat4::I(), mesh, materials[rng() % material_num], L"model");
+      graph.bind(node, scene.get_handle(scene.get_models().back()));
+    }
+  }
+  for (int i = 0; i < 32; i++) {
+    Light light = Light::point({unit(rng) * 10, 5, unit(rng) * 10}, Colors::white, 10.0 + i);
+    light.type = LightType(i % 5);
+    light.radius = 0.25;
+    light.name = L"light" + to_wstring(i);
+    scene.add_light(light);
+  }
+  scene.update_transforms();
+  const double build_ms = ms_since(start);
+  Camera camera({1, 2, 3}, {0, 0, -1});
+  camera.set_params(1.5, 60, 0.1, 500);
+
+  start = Clock::now();
+  bool ok = write_scene_archive(path, scene, &camera);
+  const double write_ms = ms_since(start);
+
+  start = Clock::now();
+  shared_ptr<const SceneArchive> archive = SceneArchive::open(path);
+  const double open_ms = ms_since(start);
+  ok &= archive != nullptr;
+  if (!archive) {
+    console << "Archive check: FAILED (cannot open)" << endl;
+    return 1;
+  }
+
+  start = Clock::now();
+  shared_ptr<Scene> loaded = archive->instantiate();
+  const double instantiate_ms = ms_since(start);
+  shared_ptr<Camera> loaded_camera = archive->camera();
+  const size_t file_bytes = archive->file_bytes();
+  archive = nullptr; // geometry keeps the mapping alive
+
+  // Same models in the same order, with the same world transforms, geometry and materials
+  const auto& a = scene.get_models();
+  const auto& b = loaded->get_models();
+  ok &= a.size() == b.size() && loaded->graph().size() == graph.size();
+  double max_err = 0;
+  for (size_t i = 0; ok && i < a.size(); i++) {
+    max_err = (std::max)(max_err, (a[i]->get_transform() - b[i]->get_transform()).norm());
+    auto src = dynamic_pointer_cast<Mesh>(a[i]->get_geometry());
+    auto dst = dynamic_pointer_cast<PackedMesh>(b[i]->get_geometry());
+    ok &= dst && dst->vertices_num() == src->get_vertices().size()
+          && dst->indices_num() == src->get_triangles().size() * 3;
+    ok &= dst && float(src->get_vertices()[0].coord.y) == dst->vertices()[0].position[1];
+    ok &= b[i]->get_material()->get<double>(L"smoothness")
+          == a[i]->get_material()->get<double>(L"smoothness");
+    ok &= b[i]->get_material()->get<Color>(L"albedo")->r
+          == a[i]->get_material()->get<Color>(L"albedo")->r;
+  }
+  ok &= max_err < 1e-9;
+  ok &= loaded->materials().size() == material_num && loaded->geometries().size() <= mesh_num;
+  ok &= loaded_camera && (loaded_camera->position() - camera.position()).norm() == 0
+        && loaded_camera->far_plane() == camera.far_plane();
+  ok &= loaded->lights().size() == scene.lights().size();
+  for (size_t i = 0; ok && i < scene.lights().size(); i++) {
+    const Light l0 = scene.lights().get(scene.lights().handles()[i]);
+    const Light l1 = loaded->lights().get(loaded->lights().handles()[i]);
+    ok &= l0.type == l1.type && l0.position == l1.position && l0.intensity == l1.intensity
+          && l0.radius == l1.radius && l0.name == l1.name;
+  }
+
+  // A damaged file is rejected when opened, not when used
+  loaded = nullptr; // unmaps the file
+  {
+    ifstream in(path, ios::binary);
+    string bytes((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+    in.close();
+    ofstream out(path, ios::binary | ios::trunc);
+    out.write(bytes.data(), bytes.size() / 2);
+  }
+  ok &= SceneArchive::open(path) == nullptr;
+  std::remove(path.c_str());
+
+  console << "Models: " << a.size() << ", nodes: " << node_num << ", archive: "
+          << file_bytes / 1024 << " KiB" << endl;
+  console << "Build in memory: " << build_ms << " ms, write archive: " << write_ms << " ms"
+          << endl;
+  console << "Open (map + validate): " << open_ms << " ms, instantiate: " << instantiate_ms
+          << " ms" << endl;
+  console << "Archive check: " << (ok ? "passed" : "FAILED") << endl;
+  return ok ? 0 : 1;
+}
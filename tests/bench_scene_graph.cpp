@@ -0,0 +1,76 @@
+// Benchmark world-transform propagation on a large transform hierarchy
+
+#include <chrono>
+#include <random>
+#include <string>
+
+#include <console.h>
+#include <parallel.h>
+#include <scene_graph.h>
+
+using namespace std;
+using namespace rei;
+
+using Clock = chrono::high_resolution_clock;
+
+static double ms_since(Clock::time_point start) {
+  return chrono::duration<double, milli>(Clock::now() - start).count();
+}
+
+// Max abs difference between graph worlds and a naive recompute in insertion order
+static double verify(const SceneGraph& graph) {
+  vector<Mat4> world(graph.size());
+  double err = 0;
+  for (SceneGraph::NodeId id = 0; id < graph.size(); id++) {
+    SceneGraph::NodeId p = graph.parent(id);
+    world[id] = p == SceneGraph::k_invalid_node ? graph.local(id) : world[p] * graph.local(id);
+    err = (std::max)(err, (world[id] - graph.world(id)).norm());
+  }
+  return err;
+}
+
+int main() {
+  console << "threads: " << global_thread_pool().concurrency() << endl;
+
+  // A forest of rigs: each node picks a random parent among recent nodes, giving deep chains
+  // with some fan-out, similar to skeletons with attachments
+  const size_t node_num = 100000;
+  mt19937 rng(7);
+  uniform_real_distribution<double> unit(-1.0, 1.0);
+  SceneGraph graph;
+  graph.reserve(node_num);
+  for (size_t i = 0; i < node_num; i++) {
+    SceneGraph::NodeId parent = SceneGraph::k_invalid_node;
+    if (i % 1000 != 0) parent = SceneGraph::NodeId(i - 1 - rng() % (std::min<size_t>)(i % 1000, 8));
+    Mat4 local = Mat4::translate_rotate({unit(rng), unit(rng), unit(rng)},
+      Vec3(unit(rng), unit(rng), unit(rng)).normalized(), unit(rng));
+    graph.add_node(parent, local);
+  }
+
+  auto start = Clock::now();
+  size_t count = graph.update();
+  double full_ms = ms_since(start);
+  console << "nodes: " << graph.size() << ", levels: " << graph.depth() << endl;
+  console << "first update (order + all nodes): " << full_ms << " ms, " << count << " nodes"
+          << endl;
+
+  for (int moved : {1, 8, 64, 1024}) {
+    const int repeat = 20;
+    double total_ms = 0;
+    size_t total_count = 0;
+    for (int r = 0; r < repeat; r++) {
+      for (int k = 0; k < moved; k++) {
+        SceneGraph::NodeId id = SceneGraph::NodeId(rng() % node_num);
+        graph.set_local(id, Mat4::translate({unit(rng), unit(rng), unit(rng)}) * graph.local(id));
+      }
+      start = Clock::now();
+      total_count += graph.update();
+      total_ms += ms_since(start);
+    }
+    console << "moved " << moved << " branches: " << total_ms / repeat << " ms, "
+            << total_count / repeat << " nodes recomputed" << endl;
+  }
+
+  console << "max error vs naive: " << verify(graph) << endl;
+  return 0;
+}
@@ -0,0 +1,281 @@
+// Benchmark incremental add/remove bookkeeping of a render pipeline, with a stand-in renderer
+
+#include <algorithm>
+#include <chrono>
+#include <new>
+#include <random>
+#include <unordered_set>
+#include <vector>
+
+#include <console.h>
+#include <container_utils.h>
+#include <render_pipelines/instancing.h>
+#include <render_pipelines/scene_residency.h>
+#include <scene.h>
+
+using namespace std;
+using namespace rei;
+
+using Clock = chrono::high_resolution_clock;
+
+static double ms_since(Clock::time_point start) {
+  return chrono::duration<double, milli>(Clock::now() - start).count();
+}
+
+// Counts geometry uploads instead of talking to a device
+struct StandInRenderer {
+  struct GeometryDesc {
+    GeometryPtr geometry;
+  };
+  struct GeometryBuffers {
+    size_t upload_id = 0;
+  };
+
+  size_t uploads = 0;
+
+  GeometryBuffers create_geometry(const GeometryDesc& desc) {
+    REI_ASSERT(desc.geometry);
+    return {++uploads};
+  }
+};
+
+struct LiveModel {
+  Scene::ModelUID id;
+  Scene::GeometryUID geometry;
+  Scene::MaterialUID material;
+  SlotAllocator::Slot slot;
+};
+
+int main() {
+  const size_t geometry_num = 32;
+  const size_t material_num = 4;
+  const size_t op_num = 200000;
+
+  vector<GeometryPtr> geometries;
+  for (size_t i = 0; i < geometry_num; i++)
+    geometries.push_back(make_shared<Mesh>(L"mesh"));
+
+  StandInRenderer renderer;
+  GeometryCache<StandInRenderer> geometry_cache;
+  SlotAllocator slots;
+  InstanceBatcher batcher;
+
+  // Random adds and removes, biased towards adding so the scene grows then churns
+  mt19937 rng(7);
+  vector<LiveModel> live;
+  Scene::ModelUID next_id = 1;
+  auto start = Clock::now();
+  for (size_t op = 0; op < op_num; op++) {
+    if (live.empty() || rng() % 8 < 5) {
+      const GeometryPtr& geo = geometries[rng() % geometry_num];
+      LiveModel m {next_id++, Scene::GeometryUID(geo.get()), rng() % material_num + 1, 0};
+      geometry_cache.acquire(renderer, geo);
+      m.slot = slots.allocate();
+      batcher.add(m.id, m.geometry, m.material);
+      live.push_back(m);
+    } else {
+      const size_t i = rng() % live.size();
+      const LiveModel m = live[i];
+      live[i] = live.back();
+      live.pop_back();
+      geometry_cache.release(m.geometry);
+      slots.free(m.slot);
+      batcher.remove(m.id);
+    }
+  }
+  const double churn_ms = ms_since(start);
+  const size_t relocated = batcher.take_relocated().size();
+
+  // Geometry buffers are shared: uploaded once per distinct geometry while it stays referenced
+  bool ok = true;
+  Hashmap<Scene::GeometryUID, size_t> refs;
+  for (const LiveModel& m : live)
+    refs[m.geometry]++;
+  ok &= geometry_cache.size() == refs.size();
+  for (const auto& kv : refs)
+    ok &= geometry_cache.refs(kv.first) == kv.second && geometry_cache.get(kv.first);
+
+  // Slots are unique and dense up to the peak live count
+  vector<bool> slot_used(slots.end(), false);
+  for (const LiveModel& m : live) {
+    ok &= m.slot < slots.end() && !slot_used[m.slot];
+    slot_used[m.slot] = true;
+  }
+  ok &= slots.size() == live.size();
+
+  // Every live model owns one instance slot inside the range of its batch
+  vector<bool> instance_used(batcher.slot_count(), false);
+  size_t batched = 0;
+  batcher.for_each_batch([&](const InstanceBatch& batch) {
+    batched += batch.instance_count;
+    ok &= batch.first_instance + batch.instance_count <= batcher.slot_count();
+  });
+  for (const LiveModel& m : live) {
+    const InstanceBatcher::Slot s = batcher.slot(m.id);
+    ok &= s < batcher.slot_count() && !instance_used[s];
+    instance_used[s] = true;
+    bool in_batch = false;
+    batcher.for_each_batch([&](const InstanceBatch& batch) {
+      if (batch.geometry == m.geometry && batch.material == m.material)
+        in_batch = s >= batch.first_instance && s < batch.first_instance + batch.instance_count;
+    });
+    ok &= in_batch;
+  }
+  ok &= batched == live.size() && batcher.instance_count() == live.size();
+
+  // Dropping everything releases all buffers and slots
+  for (const LiveModel& m : live) {
+    geometry_cache.release(m.geometry);
+    slots.free(m.slot);
+    batcher.remove(m.id);
+  }
+  ok &= geometry_cache.size() == 0 && slots.size() == 0 && batcher.instance_count() == 0;
+
+  // A geometry freed while a model not synced yet still holds its entry: the entry is not
+  // resident anymore, and a new geometry at the same address gets its own buffers. Both are
+  // built in the same storage, so the address is reused for sure.
+  {
+    alignas(Mesh) unsigned char storage[sizeof(Mesh)];
+    auto place = [&](const wchar_t* name) {
+      return GeometryPtr(new (storage) Mesh(name), [](Mesh* m) { m->~Mesh(); });
+    };
+    const auto uid = reinterpret_cast<Scene::GeometryUID>(storage);
+    GeometryPtr old_geo = place(L"swapped out");
+    const size_t old_upload = geometry_cache.acquire(renderer, old_geo).upload_id;
+    geometry_cache.acquire(renderer, old_geo);
+    ok &= geometry_cache.resident(uid) && geometry_cache.refs(uid) == 2;
+    old_geo.reset();
+    ok &= !geometry_cache.resident(uid);
+    GeometryPtr new_geo = place(L"swapped in");
+    ok &= geometry_cache.acquire(renderer, new_geo).upload_id != old_upload;
+    ok &= geometry_cache.resident(uid) && geometry_cache.refs(uid) == 1;
+    // The two stale references go first, and do not drop the new geometry's buffers
+    ok &= !geometry_cache.release(uid) && !geometry_cache.release(uid);
+    ok &= geometry_cache.resident(uid) && geometry_cache.refs(uid) == 1;
+    ok &= geometry_cache.release(uid) && geometry_cache.size() == 0;
+  }
+
+  // Mirror a churning scene through the change tracker, as a pipeline does in sync_scene
+  Scene scene;
+  MaterialPtr material = make_shared<Material>(L"material");
+  SceneChangeTracker tracker;
+  Hashmap<Scene::ModelUID, ModelHandle> mirror;
+  size_t removed = 0, upserted = 0;
+  auto remove = [&](Scene::ModelUID id) {
+    tracker.untrack(mirror[id]);
+    mirror.erase(id);
+    removed++;
+  };
+  auto upsert = [&](const Model& model, Scene::ModelUID id) {
+    if (!mirror.has(id)) {
+      mirror.insert({id, model.handle()});
+      tracker.track(model.handle(), id);
+    }
+    upserted++;
+  };
+  auto churn_scene = [&](size_t ops) {
+    for (size_t op = 0; op < ops; op++) {
+      const auto& models = scene.get_models();
+      const size_t pick = rng() % 8;
+      if (models.empty() || pick < 4) {
+        const Mat4 t = Mat4::translate({double(rng() % 100), 0, 0});
+        scene.add_model(t, geometries[rng() % geometry_num], material, L"model");
+      } else if (pick < 6) {
+        ModelPtr m = models[rng() % models.size()];
+        scene.remove_model(m);
+      } else {
+        models[rng() % models.size()]->set_transform(Mat4::translate({1, 2, 3}));
+      }
+    }
+  };
+  auto mirrored = [&]() {
+    bool same = mirror.size() == scene.get_models().size() && tracker.size() == mirror.size();
+    for (const ModelPtr& m : scene.get_models()) {
+      const ModelHandle* h = mirror.try_get(scene.get_id(m));
+      same &= h && *h == m->handle();
+    }
+    return same;
+  };
+
+  size_t synced_changes = 0;
+  start = Clock::now();
+  for (int frame = 0; frame < 1000; frame++) {
+    churn_scene(20);
+    removed = upserted = 0;
+    tracker.sync(scene, remove, upsert);
+    synced_changes += removed + upserted;
+    ok &= mirrored();
+  }
+  const double sync_ms = ms_since(start);
+  const size_t synced_models = scene.get_models().size();
+
+  // Too many changes between syncs: the journal is compacted and the tracker falls back to a full
+  // comparison, with the same result
+  const Scene::Version behind = tracker.synced_version();
+  while (!scene.get_models().empty())
+    scene.remove_model(scene.get_models().back());
+  churn_scene(200);
+  const bool fell_behind = !scene.tracks_changes_since(behind);
+  tracker.sync(scene, remove, upsert);
+  ok &= mirrored();
+
+  // A world streaming in: models start with placeholder geometry, real meshes arrive in batches
+  // and are uploaded under a per-frame budget
+  Scene world;
+  vector<GeometryPtr> streamed;
+  for (size_t i = 0; i < geometry_num; i++) {
+    streamed.push_back(make_shared<Mesh>(Mesh::procudure_sphere(2 + i % 3)));
+    for (int k = 0; k < 8; k++)
+      world.add_model(Mat4::I(), make_shared<PendingGeometry>(L"pending", Vec3(-1, -1, -1),
+        Vec3(1, 1, 1)), material, L"model");
+  }
+  ok &= world.spatial_index().size() == world.get_models().size();
+  StandInRenderer stream_renderer;
+  GeometryCache<StandInRenderer> stream_cache;
+  SceneChangeTracker stream_tracker;
+  UploadThrottle throttle;
+  throttle.budget = upload_bytes(*streamed[2]) * 2; // two of the largest meshes
+  unordered_set<Scene::ModelUID> registered;
+  auto stream_sync = [&]() {
+    sync_with_budget(
+      world, stream_tracker, throttle,
+      [&](Scene::GeometryUID geometry) { return stream_cache.resident(geometry); },
+      [&](Scene::ModelUID id) { registered.erase(id); },
+      [&](const Model& model, Scene::ModelUID id) {
+        ok &= !dynamic_cast<const PendingGeometry*>(model.get_geometry().get());
+        if (registered.insert(id).second)
+          stream_cache.acquire(stream_renderer, model.get_geometry());
+      });
+  };
+  stream_sync();
+  ok &= registered.empty(); // nothing to draw yet
+  size_t frames = 0, max_frame_bytes = 0, max_single = 0;
+  for (size_t next = 0; registered.size() < world.get_models().size() && frames < 1000; frames++) {
+    // A few meshes arrive per frame, for all of their models
+    for (int i = 0; i < 4 && next < streamed.size(); i++, next++) {
+      max_single = (std::max)(max_single, upload_bytes(*streamed[next]));
+      for (size_t k = 0; k < 8; k++)
+        world.set_geometry(world.get_models()[next * 8 + k], streamed[next]);
+    }
+    stream_sync();
+    max_frame_bytes = (std::max)(max_frame_bytes, throttle.spent());
+  }
+  ok &= registered.size() == world.get_models().size() && throttle.deferred() == 0;
+  ok &= max_frame_bytes <= (std::max)(throttle.budget, max_single);
+  ok &= stream_renderer.uploads == streamed.size();
+
+  console << "Operations: " << op_num << ", live models: " << live.size() << endl;
+  console << "Geometry uploads: " << renderer.uploads << " for " << geometry_num << " geometries"
+          << endl;
+  console << "Slots: " << slots.end() << ", instance slots: " << batcher.slot_count()
+          << ", relocated instances: " << relocated << endl;
+  console << "Churn: " << churn_ms << " ms (" << churn_ms * 1e6 / op_num << " ns/op)" << endl;
+  console << "Scene sync: " << synced_changes << " changes over 1000 frames in " << sync_ms
+          << " ms (" << synced_models << " models), full resync needed: "
+          << (fell_behind ? "yes" : "no") << endl;
+  console << "Streaming: " << streamed.size() << " meshes uploaded over " << frames
+          << " frames, at most " << max_frame_bytes / 1024 << " KiB per frame (budget "
+          << throttle.budget / 1024 << " KiB)" << endl;
+  console << "Bookkeeping check: " << (ok ? "passed" : "FAILED") << endl;
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,148 @@
+// Benchmark iterating models: shared_ptr vector vs. the SoA model store
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <string>
+
+#include <console.h>
+#include <model_store.h>
+#include <scene.h>
+
+using namespace std;
+using namespace rei;
+
+using Clock = chrono::high_resolution_clock;
+
+static double ms_since(Clock::time_point start) {
+  return chrono::duration<double, milli>(Clock::now() - start).count();
+}
+
+int main() {
+  const size_t model_num = 1000000;
+  const int repeat = 10;
+
+  mt19937 rng(7);
+  uniform_real_distribution<double> unit(-100.0, 100.0);
+  vector<Mat4> transforms(model_num);
+  for (Mat4& t : transforms)
+    t = Mat4::translate({unit(rng), unit(rng), unit(rng)});
+
+  // Models interleaved with other allocations, like a scene built while loading assets
+  vector<ModelPtr> models;
+  vector<unique_ptr<char[]>> noise;
+  models.reserve(model_num);
+  noise.reserve(model_num);
+  for (size_t i = 0; i < model_num; i++) {
+    models.push_back(make_shared<Model>(L"model", transforms[i], nullptr, nullptr));
+    noise.emplace_back(new char[16 + (rng() % 256)]);
+  }
+  shuffle(models.begin(), models.end(), rng);
+
+  ModelStore store;
+  store.reserve(model_num);
+  for (size_t i = 0; i < model_num; i++)
+    store.create(transforms[i], 0, 0);
+
+  // Sum of translations: read-only pass
+  Vec3 sum;
+  auto start = Clock::now();
+  for (int r = 0; r < repeat; r++)
+    for (const ModelPtr& m : models) {
+      const Vec4 t = m->get_transform()[3];
+      sum += Vec3(t.x, t.y, t.z);
+    }
+  double ptr_read_ms = ms_since(start) / repeat;
+
+  Vec3 soa_sum;
+  start = Clock::now();
+  for (int r = 0; r < repeat; r++) {
+    const Mat4* ts = store.transforms();
+    const uint32_t* flags = store.flags();
+    for (size_t i = 0; i < store.size(); i++) {
+      if (!(flags[i] & ModelStore::Visible)) continue;
+      const Vec4& t = ts[i][3];
+      soa_sum += Vec3(t.x, t.y, t.z);
+    }
+  }
+  double soa_read_ms = ms_since(start) / repeat;
+
+  // Move every model: read-modify-write pass
+  const Mat4 delta = Mat4::translate({0.0, 0.01, 0.0});
+  start = Clock::now();
+  for (int r = 0; r < repeat; r++)
+    for (const ModelPtr& m : models)
+      m->set_transform(delta * m->get_transform());
+  double ptr_write_ms = ms_since(start) / repeat;
+
+  start = Clock::now();
+  for (int r = 0; r < repeat; r++) {
+    Mat4* ts = store.transforms();
+    for (size_t i = 0; i < store.size(); i++)
+      ts[i] = delta * ts[i];
+  }
+  double soa_write_ms = ms_since(start) / repeat;
+
+  console << "models: " << model_num << endl;
+  console << "read  shared_ptr: " << ptr_read_ms << " ms, store: " << soa_read_ms << " ms ("
+          << ptr_read_ms / soa_read_ms << "x)" << endl;
+  console << "write shared_ptr: " << ptr_write_ms << " ms, store: " << soa_write_ms << " ms ("
+          << ptr_write_ms / soa_write_ms << "x)" << endl;
+  console << "checksum: " << (sum - soa_sum).norm() << endl;
+
+  // Handle churn: destroy half, recreate, validate stale handles
+  vector<ModelHandle> handles(store.handles(), store.handles() + store.size());
+  start = Clock::now();
+  for (size_t i = 0; i < handles.size(); i += 2)
+    store.destroy(handles[i]);
+  for (size_t i = 0; i < handles.size(); i += 2)
+    store.create(Mat4::I(), 0, 0);
+  double churn_ms = ms_since(start);
+  size_t stale = 0;
+  for (size_t i = 0; i < handles.size(); i += 2)
+    stale += !store.valid(handles[i]);
+  console << "destroy + create " << handles.size() << ": " << churn_ms << " ms, stale handles "
+          << stale << "/" << (handles.size() + 1) / 2 << endl;
+
+  // Change tracking: a consumer synced to a version only visits what moved since
+  const size_t moved_num = 100;
+  ModelStore::Version synced = store.version();
+  for (int pass = 0; pass < 2; pass++) // each model moved twice, reported once
+    for (size_t i = 0; i < moved_num; i++) {
+      const ModelHandle h = store.handles()[i * (store.size() / moved_num)];
+      store.set_transform(h, delta * store.transform(h));
+    }
+  size_t visited = 0;
+  start = Clock::now();
+  for (int r = 0; r < repeat; r++) {
+    visited = 0;
+    store.changes_since(synced, [&](ModelHandle) { visited++; });
+  }
+  double changes_ms = ms_since(start) / repeat;
+  synced = store.version();
+  size_t visited_after = 0;
+  store.changes_since(synced, [&](ModelHandle) { visited_after++; });
+  console << "changes since sync: " << visited << "/" << moved_num << " in " << changes_ms
+          << " ms, then " << visited_after << endl;
+
+  // A copy of a scene model is detached: editing it leaves the original's store slot alone
+  auto translation = [](const Mat4& m) {
+    const Vec4 t = m[3];
+    return Vec3(t.x, t.y, t.z);
+  };
+  Scene scene;
+  scene.add_model(Mat4::translate({1, 2, 3}), nullptr, L"original");
+  const ModelPtr& original = scene.get_models()[0];
+  Model copy = *original;
+  bool ok = copy.handle().null() && translation(copy.get_transform()) == Vec3(1, 2, 3);
+  copy.set_transform(Mat4::translate({4, 5, 6}));
+  ok &= translation(original->get_transform()) == Vec3(1, 2, 3);
+  ok &= translation(scene.store().transform(original->handle())) == Vec3(1, 2, 3);
+  // Assigning to the scene model writes through its own slot
+  *original = copy;
+  ok &= !original->handle().null();
+  ok &= translation(scene.store().transform(original->handle())) == Vec3(4, 5, 6);
+  console << "Scene store check: " << (ok ? "passed" : "FAILED") << endl;
+
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,165 @@
+// Check SDF baking against analytic shapes, and benchmark baking and sphere-tracing queries
+
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <random>
+#include <sstream>
+#include <string>
+
+#include <asset_loader.h>
+#include <console.h>
+#include <geometry.h>
+#include <parallel.h>
+#include <sdf.h>
+
+using namespace std;
+using namespace rei;
+
+using Clock = chrono::high_resolution_clock;
+
+static double ms_since(Clock::time_point start) {
+  return chrono::duration<double, milli>(Clock::now() - start).count();
+}
+
+using Analytic = function<double(const Vec3&)>;
+
+static double box_distance(const Vec3& p) {
+  const Vec3 q(abs(p.x) - 1, abs(p.y) - 1, abs(p.z) - 1);
+  const Vec3 outside((max)(q.x, 0.0), (max)(q.y, 0.0), (max)(q.z, 0.0));
+  return outside.norm() + (min)((max)({q.x, q.y, q.z}), 0.0);
+}
+
+static double sphere_distance(const Vec3& p) {
+  return p.norm() - 1;
+}
+
+// Signs match away from the surface, distances match in the dense band, and are never
+// overestimated elsewhere (sphere tracing relies on that)
+static bool check_distances(const SignedDistanceField& sdf, const Analytic& analytic) {
+  const double voxel = sdf.voxel_size();
+  const Aabb box = sdf.bounds();
+  mt19937 rng(7);
+  uniform_real_distribution<double> unit(0.0, 1.0);
+  size_t wrong_sign = 0, wrong_distance = 0, overestimated = 0;
+  for (int i = 0; i < 20000; i++) {
+    const Vec3 e = box.extent();
+    const Vec3 p = box.min + Vec3(unit(rng) * e.x, unit(rng) * e.y, unit(rng) * e.z);
+    const double expected = analytic(p);
+    const double d = sdf.distance(p);
+    if (abs(expected) > 1.5 * voxel && (d < 0) != (expected < 0)) wrong_sign++;
+    if (abs(expected) < voxel && abs(d - expected) > voxel) wrong_distance++;
+    if (abs(d) > abs(expected) + voxel) overestimated++;
+  }
+  const bool ok = wrong_sign == 0 && wrong_distance == 0 && overestimated == 0;
+  if (!ok)
+    console << "distance check FAILED: " << wrong_sign << " wrong signs, " << wrong_distance
+            << " wrong near the surface, " << overestimated << " overestimated" << endl;
+  return ok;
+}
+
+// A header with nonsense sizes is rejected without allocating for it
+static bool check_corrupted_header(const SignedDistanceField& sdf) {
+  stringstream buffer;
+  sdf.write(buffer);
+  string bytes = buffer.str();
+  const size_t dims_offset = 4 + 4 + 3 * sizeof(double) + sizeof(double);
+  console << "(four warnings are expected below)" << endl;
+  bool ok = true;
+  for (int32_t dim : {-1, 0, 1 << 30}) {
+    string corrupted = bytes;
+    memcpy(&corrupted[dims_offset], &dim, sizeof(dim));
+    stringstream in(corrupted);
+    SignedDistanceField loaded;
+    ok &= !loaded.read(in);
+  }
+  // Truncated payload
+  stringstream truncated(bytes.substr(0, bytes.size() / 2));
+  SignedDistanceField loaded;
+  ok &= !loaded.read(truncated);
+  return ok;
+}
+
+static bool bench(
+  const wstring& name, const Mesh& mesh, int resolution, const Analytic& analytic = nullptr) {
+  console << "--- " << name << " (" << mesh.get_triangles().size() << " triangles, res "
+          << resolution << ") ---" << endl;
+
+  SignedDistanceField::BakeOptions options;
+  options.resolution = resolution;
+
+  auto start = Clock::now();
+  SignedDistanceField sdf = SignedDistanceField::bake(mesh, options);
+  double bake_ms = ms_since(start);
+  console << "bake: " << bake_ms << " ms, bricks " << sdf.dense_brick_num() << "/"
+          << sdf.brick_num() << ", " << sdf.memory_bytes() / 1024 << " KiB" << endl;
+
+  // Serialization round trip
+  stringstream buffer;
+  sdf.write(buffer);
+  size_t file_bytes = buffer.str().size();
+  SignedDistanceField loaded;
+  bool ok = loaded.read(buffer);
+  console << "serialized: " << file_bytes / 1024 << " KiB, reload " << (ok ? "ok" : "FAILED")
+          << endl;
+  if (analytic) {
+    ok &= check_distances(sdf, analytic);
+    ok &= check_distances(loaded, analytic);
+    // A ray from outside toward the center hits the surface at distance 2 (both shapes reach
+    // 1 along the axis)
+    double t_hit = 0;
+    ok &= sdf.trace(Vec3(3, 0, 0), Vec3(-1, 0, 0), 10, t_hit) && abs(t_hit - 2) < sdf.voxel_size();
+    ok &= check_corrupted_header(sdf);
+  }
+
+  // Random shadow and AO queries around the mesh
+  const size_t query_num = 1 << 20;
+  Aabb box = sdf.bounds();
+  vector<Vec3> origins(query_num), dirs(query_num);
+  mt19937 rng(42);
+  uniform_real_distribution<double> unit(0.0, 1.0);
+  for (size_t i = 0; i < query_num; i++) {
+    Vec3 e = box.extent();
+    origins[i] = box.min + Vec3(unit(rng) * e.x, unit(rng) * e.y, unit(rng) * e.z);
+    dirs[i] = Vec3(unit(rng) - 0.5, unit(rng) - 0.5, unit(rng) - 0.5).normalized();
+  }
+  vector<double> results(query_num);
+  const double t_max = box.extent().norm();
+
+  start = Clock::now();
+  parallel_for(0, query_num, 256, [&](size_t i) {
+    results[i] = sdf.soft_shadow(origins[i], dirs[i], sdf.voxel_size(), t_max);
+  });
+  double shadow_ms = ms_since(start);
+  console << "soft shadow: " << query_num / (shadow_ms * 1e3) << " Mrays/s" << endl;
+
+  start = Clock::now();
+  parallel_for(0, query_num, 256, [&](size_t i) {
+    results[i] = sdf.occlusion(origins[i], dirs[i]);
+  });
+  double ao_ms = ms_since(start);
+  console << "occlusion: " << query_num / (ao_ms * 1e3) << " Mqueries/s" << endl;
+  return ok;
+}
+
+int main(int argc, char** argv) {
+  console << "threads: " << global_thread_pool().concurrency() << endl;
+
+  bool ok = true;
+  ok &= bench(L"cube", Mesh::procudure_cube(), 64, box_distance);
+  ok &= bench(L"sphere (subdiv 4)", Mesh::procudure_sphere_icosahedron(4), 64, sphere_distance);
+  ok &= bench(L"sphere (subdiv 4)", Mesh::procudure_sphere_icosahedron(4), 128, sphere_distance);
+
+  // Optionally, meshes from a model file
+  if (argc > 1) {
+    AssetLoader loader;
+    for (MeshPtr& mesh : loader.load_meshes(argv[1])) {
+      ok &= bench(make_wstring(argv[1]), *mesh, 128);
+    }
+  }
+
+  console << "SDF check: " << (ok ? "passed" : "FAILED") << endl;
+  return ok ? 0 : 1;
+}
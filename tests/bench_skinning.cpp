@@ -0,0 +1,284 @@
+// Benchmark CPU skinning of many instances, and check the kernels against a double-precision
+// reference, the palette from the scene graph and the BVH refit
+
+#include <chrono>
+#include <cmath>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include <console.h>
+#include <parallel.h>
+#include <rmath.h>
+#include <scene_graph.h>
+#include <skinning.h>
+
+using namespace std;
+using namespace rei;
+
+using Clock = chrono::high_resolution_clock;
+
+static double ms_since(Clock::time_point start) {
+  return chrono::duration<double, milli>(Clock::now() - start).count();
+}
+
+static Vec3 position_of(const PackedMesh::Vertex& v) {
+  return {v.position[0], v.position[1], v.position[2]};
+}
+static Vec3 normal_of(const PackedMesh::Vertex& v) {
+  return {v.normal[0], v.normal[1], v.normal[2]};
+}
+
+// A tube along +x, `length` long, with `bone_num` bones evenly along it; each vertex is weighted
+// between the two closest bones
+static shared_ptr<Mesh> make_tube(size_t rings, size_t segments, size_t bone_num, double length) {
+  vector<Mesh::Vertex> vertices;
+  vector<Mesh::BoneWeights> weights;
+  const double spacing = length / bone_num;
+  for (size_t r = 0; r < rings; r++) {
+    const double x = length * r / (rings - 1);
+    // Position in bone units, measured from the middle of the first bone
+    const double s = (std::max)(0.0, (std::min)(x / spacing - 0.5, double(bone_num - 1)));
+    const size_t b0 = (std::min)(size_t(s), bone_num - 1), b1 = (std::min)(b0 + 1, bone_num - 1);
+    const float w1 = b1 == b0 ? 0.f : float(s - b0);
+    for (size_t k = 0; k < segments; k++) {
+      const double a = 2 * pi * k / segments;
+      const Vec3 normal {0, std::cos(a), std::sin(a)};
+      vertices.emplace_back(Vec3(x, 0, 0) + normal * 0.5, normal);
+      Mesh::BoneWeights bw {};
+      bw.bones[0] = uint16_t(b0);
+      bw.bones[1] = uint16_t(b1);
+      bw.weights[0] = 1.f - w1;
+      bw.weights[1] = w1;
+      weights.push_back(bw);
+    }
+  }
+  vector<Mesh::Triangle> triangles;
+  for (size_t r = 0; r + 1 < rings; r++) {
+    for (size_t k = 0; k < segments; k++) {
+      const size_t a = r * segments + k, b = r * segments + (k + 1) % segments;
+      triangles.emplace_back(a, b, a + segments);
+      triangles.emplace_back(b, b + segments, a + segments);
+    }
+  }
+  vector<Mesh::Bone> bones;
+  for (size_t b = 0; b < bone_num; b++)
+    bones.push_back({L"bone" + to_wstring(b), Mat4::translate({-spacing * b, 0, 0})});
+  auto mesh = make_shared<Mesh>(L"tube", move(vertices), move(triangles));
+  mesh->set_skin(move(bones), move(weights));
+  return mesh;
+}
+
+// A bent pose: bone b sits at its bind position along x, rotated about z by b * `bend` radians
+static vector<Mat4> bent_pose(size_t bone_num, double length, double bend) {
+  vector<Mat4> pose;
+  const double spacing = length / bone_num;
+  for (size_t b = 0; b < bone_num; b++)
+    pose.push_back(Mat4::translate({spacing * b, 0.1 * b, 0}) * Mat4::rotate({0, 0, 1}, bend * b));
+  return pose;
+}
+
+// Double-precision references for vertex i of `mesh` posed by `pose` (bone space to mesh space)
+static Vec3 reference_linear(const Mesh& mesh, const vector<Mat4>& pose, size_t i, Vec3& normal) {
+  const Mesh::BoneWeights& bw = mesh.get_bone_weights()[i];
+  Mat4 m = Mat4::from_diag({0, 0, 0, 0});
+  for (int k = 0; k < 4; k++) {
+    const Mat4 skin = pose[bw.bones[k]] * mesh.get_bones()[bw.bones[k]].offset;
+    for (int r = 0; r < 4; r++)
+      for (int c = 0; c < 4; c++)
+        m(r, c) += skin(r, c) * bw.weights[k];
+  }
+  const Mesh::Vertex& v = mesh.get_vertices()[i];
+  normal = (m * Vec4(v.normal, 0)).truncated().normalized();
+  return (m * v.coord).truncated();
+}
+
+static Vec3 reference_dual_quat(
+  const Mesh& mesh, const vector<Mat4>& pose, size_t i, Vec3& normal) {
+  const Mesh::BoneWeights& bw = mesh.get_bone_weights()[i];
+  Quat real(0, 0, 0, 0), dual(0, 0, 0, 0);
+  Quat first;
+  for (int k = 0; k < 4; k++) {
+    const Trs trs = Trs::decompose(pose[bw.bones[k]] * mesh.get_bones()[bw.bones[k]].offset);
+    const Quat r = trs.rotation;
+    const Quat d = Quat(trs.translation.x, trs.translation.y, trs.translation.z, 0) * r * 0.5;
+    if (k == 0) first = r;
+    const double w = dot(first, r) < 0 ? -bw.weights[k] : bw.weights[k];
+    real = real + r * w;
+    dual = dual + d * w;
+  }
+  const double n = real.norm();
+  real = real * (1 / n);
+  dual = dual * (1 / n);
+  const Quat t = dual * real.conjugate() * 2.0;
+  const Mesh::Vertex& v = mesh.get_vertices()[i];
+  normal = real.rotate_vector(v.normal).normalized();
+  return real.rotate_vector(v.coord.truncated()) + Vec3(t.x, t.y, t.z);
+}
+
+// Largest position and normal error of a skinned instance against a reference
+template <typename Reference>
+static double max_error(const SkinInstance& inst, const vector<Mat4>& pose, Reference ref) {
+  double error = 0;
+  const Mesh& mesh = inst.mesh().mesh();
+  for (size_t i = 0; i < inst.vertices().size(); i++) {
+    Vec3 normal;
+    const Vec3 p = ref(mesh, pose, i, normal);
+    error = (std::max)(error, (position_of(inst.vertices()[i]) - p).norm());
+    error = (std::max)(error, (normal_of(inst.vertices()[i]) - normal).norm());
+  }
+  return error;
+}
+
+int main() {
+  bool ok = true;
+  const size_t bone_num = 3;
+  const double length = 3.0;
+  auto tube = make_shared<SkinnedMesh>(make_tube(48, 16, bone_num, length));
+
+  // Both kernels against the references, in a bent pose
+  {
+    const vector<Mat4> pose = bent_pose(bone_num, length, 0.6);
+    SkinInstance linear(tube, SkinningMethod::Linear), dq(tube, SkinningMethod::DualQuaternion);
+    linear.set_pose(pose.data());
+    dq.set_pose(pose.data());
+    SkinInstance* instances[] = {&linear, &dq};
+    skin(instances, 2);
+    const double linear_error = max_error(linear, pose, reference_linear);
+    const double dq_error = max_error(dq, pose, reference_dual_quat);
+    if (linear_error > 1e-4 || dq_error > 1e-4)
+      console << "Mismatch: kernels (linear " << linear_error << ", dual quaternion " << dq_error
+              << ")" << endl;
+    ok &= linear_error <= 1e-4 && dq_error <= 1e-4;
+
+    // Rigid: with every bone moved alike, both methods are that one transform
+    const Mat4 rigid = Mat4::translate({1, 2, 3}) * Mat4::rotate(Vec3(1, 1, 0).normalized(), 1.2);
+    vector<Mat4> same(bone_num);
+    for (size_t b = 0; b < bone_num; b++)
+      same[b] = rigid * Mat4::translate({length / bone_num * b, 0, 0});
+    linear.set_pose(same.data());
+    dq.set_pose(same.data());
+    skin(instances, 2);
+    double rigid_error = 0;
+    for (size_t i = 0; i < tube->vertex_num(); i++) {
+      const Vec3 p = (rigid * tube->mesh().get_vertices()[i].coord).truncated();
+      rigid_error = (std::max)(rigid_error, (position_of(linear.vertices()[i]) - p).norm());
+      rigid_error = (std::max)(rigid_error, (position_of(dq.vertices()[i]) - p).norm());
+    }
+    if (rigid_error > 1e-4) console << "Mismatch: rigid pose (" << rigid_error << ")" << endl;
+    ok &= rigid_error <= 1e-4;
+  }
+
+  // Palette from a bone chain in the scene graph, under a moved mesh node
+  {
+    SceneGraph graph;
+    const SceneGraph::NodeId root
+      = graph.add_node(SceneGraph::k_invalid_node, Mat4::translate({5, 0, 0}), L"character");
+    const SceneGraph::NodeId mesh_node = graph.add_node(root, Mat4::I(), L"tube");
+    SceneGraph::NodeId parent = root;
+    for (size_t b = 0; b < bone_num; b++) {
+      const Mat4 local = Mat4::translate({b == 0 ? 0.0 : length / bone_num, 0, 0})
+                         * Mat4::rotate({0, 0, 1}, 0.3);
+      parent = graph.add_node(parent, local, L"bone" + to_wstring(b));
+    }
+    graph.update(nullptr);
+
+    SkinInstance from_graph(tube), from_pose(tube);
+    bool same = from_graph.bind(graph, mesh_node) == bone_num;
+    vector<Mat4> pose;
+    for (size_t b = 0; b < bone_num; b++)
+      pose.push_back(graph.world(mesh_node).inv() * graph.world(mesh_node + 1 + b));
+    from_pose.set_pose(pose.data());
+    SkinInstance* instances[] = {&from_graph, &from_pose};
+    skin(instances, 1, &graph);
+    skin(instances + 1, 1);
+    for (size_t i = 0; i < tube->vertex_num(); i++)
+      same &= (position_of(from_graph.vertices()[i]) - position_of(from_pose.vertices()[i])).norm()
+              < 1e-5;
+    if (!same) console << "Mismatch: scene graph palette" << endl;
+    ok &= same;
+  }
+
+  // The refit BVH bounds the skinned vertices like a fresh build, and rays hit the same point
+  {
+    SkinInstance inst(tube);
+    inst.enable_bvh();
+    const vector<Mat4> pose = bent_pose(bone_num, length, 0.8);
+    inst.set_pose(pose.data());
+    SkinInstance* instances[] = {&inst};
+    skin(instances, 1);
+    vector<Vec3> positions;
+    for (const PackedMesh::Vertex& v : inst.vertices())
+      positions.push_back(position_of(v));
+    vector<uint32_t> indices;
+    for (const Mesh::Triangle& t : tube->mesh().get_triangles())
+      indices.insert(indices.end(), {uint32_t(t.a), uint32_t(t.b), uint32_t(t.c)});
+    TriangleBVH rebuilt;
+    rebuilt.build(move(positions), move(indices));
+
+    const Aabb refit = inst.bvh()->bounds(), fresh = rebuilt.bounds();
+    bool same = (refit.min - fresh.min).norm() < 1e-9 && (refit.max - fresh.max).norm() < 1e-9;
+    mt19937 rng(5);
+    uniform_real_distribution<double> u(-1.0, 1.0);
+    size_t hits = 0;
+    for (int i = 0; i < 1000; i++) {
+      // Rays from outside toward a point near the middle of the bent tube
+      const Vec3 target = (fresh.min + fresh.max) * 0.5 + Vec3(u(rng), u(rng), u(rng)) * 0.5;
+      const Vec3 origin = target + Vec3(u(rng), u(rng), u(rng)).normalized() * 10.0;
+      const Vec3 dir = (target - origin).normalized();
+      TriangleBVH::RayHit a, b;
+      const bool hit_a = inst.bvh()->intersect(origin, dir, 100, a);
+      const bool hit_b = rebuilt.intersect(origin, dir, 100, b);
+      same &= hit_a == hit_b && (!hit_a || fabs(a.t - b.t) < 1e-9);
+      hits += hit_a;
+    }
+    same &= hits > 0;
+    if (!same) console << "Mismatch: BVH refit" << endl;
+    ok &= same;
+  }
+
+  // Throughput: a crowd of characters, each a 2k-vertex skin with 32 bones in its own pose
+  {
+    const size_t crowd = 2000, bones = 32, frames = 20;
+    auto body = make_shared<SkinnedMesh>(make_tube(128, 16, bones, 2.0));
+    vector<unique_ptr<SkinInstance>> linear, dq;
+    vector<SkinInstance*> linear_ptrs, dq_ptrs;
+    for (size_t i = 0; i < crowd; i++) {
+      linear.push_back(make_unique<SkinInstance>(body, SkinningMethod::Linear));
+      dq.push_back(make_unique<SkinInstance>(body, SkinningMethod::DualQuaternion));
+      linear_ptrs.push_back(linear.back().get());
+      dq_ptrs.push_back(dq.back().get());
+    }
+    console << "Characters: " << crowd << ", vertices each: " << body->vertex_num()
+            << ", bones: " << bones << ", " << global_thread_pool().concurrency() << " threads"
+            << endl;
+
+    // Palettes are set per frame as an animation system would, then the crowd is skinned
+    auto run = [&](vector<SkinInstance*>& instances, double& pose_ms) {
+      pose_ms = 0;
+      auto start = Clock::now();
+      for (size_t f = 0; f < frames; f++) {
+        auto pose_start = Clock::now();
+        parallel_for(0, crowd, 16, [&](size_t i) {
+          const vector<Mat4> pose = bent_pose(bones, 2.0, 0.05 * std::sin(0.1 * (f + i)));
+          instances[i]->set_pose(pose.data());
+        });
+        pose_ms += ms_since(pose_start);
+        skin(instances.data(), instances.size());
+      }
+      pose_ms /= frames;
+      return ms_since(start) / frames - pose_ms;
+    };
+    double linear_pose, dq_pose;
+    const double linear_ms = run(linear_ptrs, linear_pose);
+    const double dq_ms = run(dq_ptrs, dq_pose);
+    const double vertices = double(crowd * body->vertex_num());
+    console << "Linear blend: " << linear_ms << " ms/frame (" << linear_ms * 1e6 / vertices
+            << " ns/vertex), palettes " << linear_pose << " ms" << endl;
+    console << "Dual quaternion: " << dq_ms << " ms/frame (" << dq_ms * 1e6 / vertices
+            << " ns/vertex), palettes " << dq_pose << " ms" << endl;
+  }
+
+  console << "Skinning check: " << (ok ? "passed" : "FAILED") << endl;
+  return ok ? 0 : 1;
+}
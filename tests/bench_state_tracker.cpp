@@ -0,0 +1,224 @@
+// Check the resource state tracker against a recording backend, and count the barriers the
+// pipelines issue per frame on the null renderer
+
+#include <memory>
+#include <vector>
+
+#include <console.h>
+#include <null/null_renderer.h>
+#include <render_pipeline.h>
+#include <resource_state_tracker.h>
+#include <scene.h>
+
+using namespace std;
+using namespace rei;
+
+namespace {
+
+struct FakeResource {
+  int state = 0;
+  StateTracking<int> tracking;
+};
+
+using Tracker = ResourceStateTracker<FakeResource, int>;
+using Kind = Tracker::BarrierKind;
+
+// Keeps the batches flushed, as a device backend would issue them
+struct Recorder {
+  vector<vector<Tracker::Barrier>> batches;
+
+  void flush(Tracker& tracker) {
+    tracker.flush([&](const Tracker::Barrier* barriers, size_t count) {
+      batches.emplace_back(barriers, barriers + count);
+    });
+  }
+};
+
+bool same(const Tracker::Barrier& b, const FakeResource& res, int before, int after, Kind kind) {
+  return b.record == &res && b.before == before && b.after == after && b.kind == kind;
+}
+
+bool check_tracker() {
+  bool ok = true;
+  Tracker tracker;
+  Recorder rec;
+  FakeResource a, b;
+
+  // No-op transitions issue nothing, not even an empty batch
+  tracker.transition(a, 0);
+  rec.flush(tracker);
+  ok &= rec.batches.empty() && tracker.stats().elided == 1;
+
+  // Transitions of several resources go out together; two of one resource merge
+  tracker.transition(a, 1);
+  tracker.transition(b, 1);
+  tracker.transition(a, 2);
+  rec.flush(tracker);
+  ok &= rec.batches.size() == 1 && rec.batches[0].size() == 2;
+  ok &= same(rec.batches[0][0], a, 0, 2, Kind::Transition);
+  ok &= same(rec.batches[0][1], b, 0, 1, Kind::Transition);
+  ok &= a.state == 2 && b.state == 1;
+
+  // A transition and its reverse cancel out
+  tracker.transition(a, 3);
+  tracker.transition(a, 2);
+  rec.flush(tracker);
+  ok &= rec.batches.size() == 1 && a.state == 2;
+
+  // UAV barriers: one per resource in a batch, none with a transition
+  tracker.uav_barrier(a);
+  tracker.uav_barrier(a);
+  tracker.transition(b, 4);
+  tracker.uav_barrier(b);
+  rec.flush(tracker);
+  ok &= rec.batches.size() == 2 && rec.batches[1].size() == 2;
+  ok &= same(rec.batches[1][0], a, 2, 2, Kind::UAV);
+  ok &= same(rec.batches[1][1], b, 1, 4, Kind::Transition);
+
+  // A split begins in one batch and ends in a later one
+  tracker.begin_split(a, 5);
+  rec.flush(tracker);
+  tracker.begin_split(a, 5); // already begun
+  rec.flush(tracker);
+  tracker.transition(a, 5);
+  rec.flush(tracker);
+  ok &= rec.batches.size() == 4;
+  ok &= rec.batches[2].size() == 1 && same(rec.batches[2][0], a, 2, 5, Kind::BeginOnly);
+  ok &= rec.batches[3].size() == 1 && same(rec.batches[3][0], a, 2, 5, Kind::EndOnly);
+  ok &= !a.tracking.splitting && a.state == 5;
+
+  // Ended toward another state, the split is followed by a plain transition
+  tracker.begin_split(b, 6);
+  rec.flush(tracker);
+  tracker.transition(b, 7);
+  rec.flush(tracker);
+  ok &= rec.batches.size() == 6 && rec.batches[5].size() == 2;
+  ok &= same(rec.batches[5][0], b, 4, 6, Kind::EndOnly);
+  ok &= same(rec.batches[5][1], b, 6, 7, Kind::Transition);
+
+  // Begun and ended with nothing between, it is a plain transition
+  tracker.begin_split(a, 8);
+  tracker.transition(a, 8);
+  rec.flush(tracker);
+  ok &= rec.batches.size() == 7 && rec.batches[6].size() == 1;
+  ok &= same(rec.batches[6][0], a, 5, 8, Kind::Transition);
+
+  // A UAV barrier folded into a transition which then cancels out is still issued
+  tracker.transition(a, 9);
+  tracker.transition(a, 8);
+  tracker.uav_barrier(a);
+  rec.flush(tracker);
+  ok &= rec.batches.size() == 8 && rec.batches[7].size() == 1;
+  ok &= same(rec.batches[7][0], a, 8, 8, Kind::UAV) && a.state == 8;
+
+  // A UAV barrier during a split is dropped, whether the split began in an earlier batch ...
+  tracker.begin_split(b, 10);
+  rec.flush(tracker);
+  tracker.uav_barrier(b);
+  rec.flush(tracker);
+  tracker.transition(b, 10);
+  rec.flush(tracker);
+  ok &= rec.batches.size() == 10;
+  ok &= rec.batches[8].size() == 1 && same(rec.batches[8][0], b, 7, 10, Kind::BeginOnly);
+  ok &= rec.batches[9].size() == 1 && same(rec.batches[9][0], b, 7, 10, Kind::EndOnly);
+
+  // ... or in the same one, where it becomes a plain transition ...
+  tracker.begin_split(b, 11);
+  tracker.uav_barrier(b);
+  tracker.transition(b, 11);
+  rec.flush(tracker);
+  ok &= rec.batches.size() == 11 && rec.batches[10].size() == 1;
+  ok &= same(rec.batches[10][0], b, 10, 11, Kind::Transition);
+
+  // ... unless that transition cancels out, leaving the UAV barrier
+  tracker.begin_split(a, 12);
+  tracker.uav_barrier(a);
+  tracker.transition(a, 8);
+  rec.flush(tracker);
+  ok &= rec.batches.size() == 12 && rec.batches[11].size() == 1;
+  ok &= same(rec.batches[11][0], a, 8, 8, Kind::UAV) && !a.tracking.splitting;
+
+  const Tracker::Stats& stats = tracker.stats();
+  ok &= stats.transitions == 15 && stats.uav_barriers == 7 && stats.elided == 12;
+  ok &= stats.batches == rec.batches.size() && stats.split_transitions == 3;
+  size_t issued = 0;
+  for (const auto& batch : rec.batches)
+    issued += batch.size();
+  ok &= stats.barriers == issued && issued == 15;
+  console << "Tracker: " << stats.transitions << " transitions and " << stats.uav_barriers
+          << " UAV barriers requested, " << issued << " barriers issued in " << stats.batches
+          << " batches, " << stats.elided << " elided" << endl;
+  return ok;
+}
+
+template <typename Pipeline>
+bool measure(const char* name, Scene& scene, int frame_num) {
+  using Call = null::Renderer::Call;
+  auto renderer = make_shared<null::Renderer>();
+  Pipeline pipeline(renderer);
+
+  ViewportConfig view_conf = {};
+  view_conf.width = 1280;
+  view_conf.height = 720;
+  view_conf.window_id.platform = SystemWindowID::Offscreen;
+  const auto viewport = pipeline.register_viewport(view_conf);
+  pipeline.transform_viewport(viewport, Camera({0, 5, 30}));
+  SceneConfig scene_conf = {};
+  scene_conf.scene = &scene;
+  const auto scene_h = pipeline.register_scene(scene_conf);
+
+  // Warm up: the first frame creates per-viewport arguments
+  pipeline.sync_scene(scene_h, scene);
+  pipeline.render(viewport, scene_h);
+
+  const size_t failed_before = renderer->stats().failed_checks;
+  renderer->reset_stats();
+  for (int frame = 0; frame < frame_num; frame++) {
+    pipeline.sync_scene(scene_h, scene);
+    pipeline.render(viewport, scene_h);
+  }
+
+  const null::Renderer::Stats& stats = renderer->stats();
+  const null::Renderer::BarrierStats& barriers = renderer->barrier_stats();
+  const size_t commands = stats[Call::Draw] + stats[Call::Dispatch] + stats[Call::Raytrace]
+                          + stats[Call::ClearTexture] + stats[Call::CopyTexture]
+                          + stats[Call::BeginRenderPass] + stats[Call::Present];
+  const size_t requests = barriers.transitions + barriers.uav_barriers;
+  const size_t failed_checks = failed_before + stats.failed_checks;
+  bool ok = failed_checks == 0;
+  ok &= requests == stats[Call::Transition] + stats[Call::Barrier];
+  ok &= barriers.batches <= commands;
+  ok &= barriers.barriers <= requests - barriers.elided + barriers.split_transitions;
+
+  console << name << " per frame: " << requests / frame_num << " barriers requested, "
+          << barriers.barriers / frame_num << " issued in " << barriers.batches / frame_num
+          << " batches, " << barriers.elided / frame_num << " elided, "
+          << barriers.split_transitions / frame_num << " split; " << failed_checks
+          << " failed checks" << endl;
+  pipeline.remove_scene(scene_h);
+  return ok;
+}
+
+} // namespace
+
+int main() {
+  bool ok = check_tracker();
+
+  Scene scene(L"State Tracker Bench");
+  auto cube = make_shared<Mesh>(Mesh::procudure_cube());
+  auto mat = make_shared<Material>(L"material");
+  for (int i = 0; i < 100; i++)
+    scene.add_model(Mat4::translate({i * 2.0, 0, 0}), cube, mat, L"cube");
+  Light area = Light::point({0, 10, 0}, Colors::white, 100);
+  area.type = LightType::Sphere;
+  area.radius = 1;
+  scene.add_light(area);
+  scene.add_light(Light::point({5, 10, 0}, Colors::white, 100));
+
+  const int frame_num = 20;
+  ok &= measure<DeferredPipeline>("Deferred", scene, frame_num);
+  ok &= measure<HybridPipeline>("Hybrid", scene, frame_num);
+
+  console << "State tracker check: " << (ok ? "passed" : "FAILED") << endl;
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,433 @@
+// Benchmark the texture pipeline (mip generation, BC encoding, import through the asset cache)
+// on generated images, and check the decoders and encoders along the way
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <console.h>
+#include <parallel.h>
+#include <texture_import.h>
+
+using namespace std;
+using namespace rei;
+namespace fs = std::filesystem;
+
+using Clock = chrono::high_resolution_clock;
+
+static double ms_since(Clock::time_point start) {
+  return chrono::duration<double, milli>(Clock::now() - start).count();
+}
+
+// zlib.compress(b"rei texture pipeline " * 40 + bytes(range(256)), 9): fixed Huffman codes
+static const uint8_t k_zlib_fixed[] = {
+  0x78, 0xDA, 0x2B, 0x4A, 0xCD, 0x54, 0x28, 0x49, 0xAD, 0x28, 0x29, 0x2D, 0x4A, 0x55, 0x28, 0xC8,
+  0x2C, 0x48, 0xCD, 0xC9, 0xCC, 0x4B, 0x55, 0x28, 0x1A, 0x15, 0x1C, 0x15, 0x1C, 0x15, 0x24, 0x45,
+  0x90, 0x81, 0x91, 0x89, 0x99, 0x85, 0x95, 0x8D, 0x9D, 0x83, 0x93, 0x8B, 0x9B, 0x87, 0x97, 0x8F,
+  0x5F, 0x40, 0x50, 0x48, 0x58, 0x44, 0x54, 0x4C, 0x5C, 0x42, 0x52, 0x4A, 0x5A, 0x46, 0x56, 0x4E,
+  0x5E, 0x41, 0x51, 0x49, 0x59, 0x45, 0x55, 0x4D, 0x5D, 0x43, 0x53, 0x4B, 0x5B, 0x47, 0x57, 0x4F,
+  0xDF, 0xC0, 0xD0, 0xC8, 0xD8, 0xC4, 0xD4, 0xCC, 0xDC, 0xC2, 0xD2, 0xCA, 0xDA, 0xC6, 0xD6, 0xCE,
+  0xDE, 0xC1, 0xD1, 0xC9, 0xD9, 0xC5, 0xD5, 0xCD, 0xDD, 0xC3, 0xD3, 0xCB, 0xDB, 0xC7, 0xD7, 0xCF,
+  0x3F, 0x20, 0x30, 0x28, 0x38, 0x24, 0x34, 0x2C, 0x3C, 0x22, 0x32, 0x2A, 0x3A, 0x26, 0x36, 0x2E,
+  0x3E, 0x21, 0x31, 0x29, 0x39, 0x25, 0x35, 0x2D, 0x3D, 0x23, 0x33, 0x2B, 0x3B, 0x27, 0x37, 0x2F,
+  0xBF, 0xA0, 0xB0, 0xA8, 0xB8, 0xA4, 0xB4, 0xAC, 0xBC, 0xA2, 0xB2, 0xAA, 0xBA, 0xA6, 0xB6, 0xAE,
+  0xBE, 0xA1, 0xB1, 0xA9, 0xB9, 0xA5, 0xB5, 0xAD, 0xBD, 0xA3, 0xB3, 0xAB, 0xBB, 0xA7, 0xB7, 0xAF,
+  0x7F, 0xC2, 0xC4, 0x49, 0x93, 0xA7, 0x4C, 0x9D, 0x36, 0x7D, 0xC6, 0xCC, 0x59, 0xB3, 0xE7, 0xCC,
+  0x9D, 0x37, 0x7F, 0xC1, 0xC2, 0x45, 0x8B, 0x97, 0x2C, 0x5D, 0xB6, 0x7C, 0xC5, 0xCA, 0x55, 0xAB,
+  0xD7, 0xAC, 0x5D, 0xB7, 0x7E, 0xC3, 0xC6, 0x4D, 0x9B, 0xB7, 0x6C, 0xDD, 0xB6, 0x7D, 0xC7, 0xCE,
+  0x5D, 0xBB, 0xF7, 0xEC, 0xDD, 0xB7, 0xFF, 0xC0, 0xC1, 0x43, 0x87, 0x8F, 0x1C, 0x3D, 0x76, 0xFC,
+  0xC4, 0xC9, 0x53, 0xA7, 0xCF, 0x9C, 0x3D, 0x77, 0xFE, 0xC2, 0xC5, 0x4B, 0x97, 0xAF, 0x5C, 0xBD,
+  0x76, 0xFD, 0xC6, 0xCD, 0x5B, 0xB7, 0xEF, 0xDC, 0xBD, 0x77, 0xFF, 0xC1, 0xC3, 0x47, 0x8F, 0x9F,
+  0x3C, 0x7D, 0xF6, 0xFC, 0xC5, 0xCB, 0x57, 0xAF, 0xDF, 0xBC, 0x7D, 0xF7, 0xFE, 0xC3, 0xC7, 0x4F,
+  0x9F, 0xBF, 0x7C, 0xFD, 0xF6, 0xFD, 0xC7, 0xCF, 0x5F, 0xBF, 0xFF, 0xFC, 0xFD, 0xF7, 0x1F, 0x00,
+  0xB0, 0xF9, 0xC0, 0xA8
+};
+
+// 8x8 RGBA, Adam7-interlaced, compressed with dynamic Huffman codes; see png_pixel
+static const uint8_t k_png_interlaced[] = {
+  0x89, 0x50, 0x4E, 0x47, 0x0D, 0x0A, 0x1A, 0x0A, 0x00, 0x00, 0x00, 0x0D, 0x49, 0x48, 0x44, 0x52,
+  0x00, 0x00, 0x00, 0x08, 0x00, 0x00, 0x00, 0x08, 0x08, 0x06, 0x00, 0x00, 0x01, 0xB3, 0x08, 0x8E,
+  0x1D, 0x00, 0x00, 0x00, 0x7D, 0x49, 0x44, 0x41, 0x54, 0x78, 0xDA, 0x6D, 0x8C, 0x51, 0x11, 0xC4,
+  0x20, 0x10, 0x43, 0x13, 0x07, 0x95, 0xB0, 0x12, 0x90, 0xB0, 0x12, 0x2A, 0x01, 0x09, 0x48, 0x58,
+  0x29, 0x95, 0x70, 0x12, 0x70, 0x72, 0x38, 0x28, 0x7F, 0xF0, 0xC7, 0x71, 0x2D, 0x9D, 0x39, 0x98,
+  0xFB, 0xC8, 0x64, 0x37, 0x93, 0x3C, 0x02, 0x68, 0x34, 0xE8, 0x9B, 0x30, 0x6D, 0x86, 0x98, 0xA8,
+  0x90, 0xB3, 0x27, 0xFD, 0x30, 0x7F, 0x5E, 0x09, 0x54, 0x9A, 0x22, 0x65, 0x85, 0xCF, 0x5F, 0x27,
+  0xA2, 0x1F, 0xC1, 0x2D, 0x0A, 0xB6, 0xD2, 0x77, 0xF9, 0x11, 0x45, 0x5D, 0x99, 0x26, 0x62, 0xFB,
+  0x68, 0x1C, 0xA3, 0x11, 0x43, 0x99, 0x18, 0x90, 0xAD, 0x09, 0x72, 0x15, 0xB8, 0xFA, 0xCF, 0x09,
+  0xEF, 0x46, 0xE1, 0x51, 0xA8, 0xBF, 0x3F, 0x71, 0xEC, 0x0B, 0xE1, 0xB5, 0x10, 0x52, 0x58, 0x08,
+  0xB3, 0x3E, 0xF3, 0x42, 0x73, 0x81, 0xAD, 0x24, 0xA8, 0x56, 0x00, 0x00, 0x00, 0x00, 0x49, 0x45,
+  0x4E, 0x44, 0xAE, 0x42, 0x60, 0x82
+};
+
+static void png_pixel(int x, int y, uint8_t* rgba) {
+  rgba[0] = uint8_t(x * 32), rgba[1] = uint8_t(y * 32);
+  rgba[2] = uint8_t((x ^ y) * 16), rgba[3] = uint8_t(255 - x * 8);
+}
+
+static uint32_t crc32(const uint8_t* data, size_t size, uint32_t crc = 0) {
+  crc = ~crc;
+  for (size_t i = 0; i < size; i++) {
+    crc ^= data[i];
+    for (int k = 0; k < 8; k++)
+      crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1)));
+  }
+  return ~crc;
+}
+
+static void put_be32(vector<uint8_t>& out, uint32_t v) {
+  for (int s = 24; s >= 0; s -= 8)
+    out.push_back(uint8_t(v >> s));
+}
+
+// RGB PNG with every row filter, in stored (uncompressed) deflate blocks
+static vector<uint8_t> write_png(const vector<uint8_t>& rgba, uint32_t w, uint32_t h) {
+  vector<uint8_t> raw;
+  vector<uint8_t> prev(w * 3, 0), row(w * 3);
+  for (uint32_t y = 0; y < h; y++) {
+    for (uint32_t x = 0; x < w * 3; x++)
+      row[x] = rgba[(y * w + x / 3) * 4 + x % 3];
+    const int filter = int(y % 5);
+    raw.push_back(uint8_t(filter));
+    for (uint32_t i = 0; i < w * 3; i++) {
+      const int a = i >= 3 ? row[i - 3] : 0, b = prev[i], c = i >= 3 ? prev[i - 3] : 0;
+      const int p = a + b - c, pa = abs(p - a), pb = abs(p - b), pc = abs(p - c);
+      const int paeth = pa <= pb && pa <= pc ? a : pb <= pc ? b : c;
+      const int pred[5] = {0, a, b, (a + b) / 2, paeth};
+      raw.push_back(uint8_t(row[i] - pred[filter]));
+    }
+    prev = row;
+  }
+  vector<uint8_t> z = {0x78, 0x01};
+  for (size_t at = 0; at < raw.size(); at += 65535) {
+    const size_t len = min(raw.size() - at, size_t(65535));
+    z.push_back(at + len == raw.size() ? 1 : 0);
+    z.insert(z.end(), {uint8_t(len), uint8_t(len >> 8), uint8_t(~len), uint8_t(~len >> 8)});
+    z.insert(z.end(), raw.begin() + at, raw.begin() + at + len);
+  }
+  uint32_t a = 1, b = 0;
+  for (uint8_t v : raw)
+    a = (a + v) % 65521, b = (b + a) % 65521;
+  put_be32(z, b << 16 | a);
+
+  vector<uint8_t> png = {137, 80, 78, 71, 13, 10, 26, 10};
+  auto chunk = [&](const char* type, const vector<uint8_t>& body) {
+    put_be32(png, uint32_t(body.size()));
+    const size_t start = png.size();
+    png.insert(png.end(), type, type + 4);
+    png.insert(png.end(), body.begin(), body.end());
+    put_be32(png, crc32(&png[start], png.size() - start));
+  };
+  vector<uint8_t> header;
+  put_be32(header, w);
+  put_be32(header, h);
+  header.insert(header.end(), {8, 2, 0, 0, 0});
+  chunk("IHDR", header);
+  chunk("IDAT", z);
+  chunk("IEND", {});
+  return png;
+}
+
+// 32-bit TGA: run-length encoded bottom-up, or raw top-down
+static vector<uint8_t> write_tga(const vector<uint8_t>& rgba, uint32_t w, uint32_t h, bool rle) {
+  vector<uint8_t> tga(18, 0);
+  tga[2] = rle ? 10 : 2;
+  tga[12] = uint8_t(w), tga[13] = uint8_t(w >> 8), tga[14] = uint8_t(h), tga[15] = uint8_t(h >> 8);
+  tga[16] = 32;
+  tga[17] = uint8_t(8 | (rle ? 0 : 0x20));
+  vector<uint32_t> pixels; // bgra, in file order
+  for (uint32_t j = 0; j < h; j++) {
+    const uint32_t y = rle ? h - 1 - j : j;
+    for (uint32_t x = 0; x < w; x++) {
+      const uint8_t* p = &rgba[(y * w + x) * 4];
+      pixels.push_back(uint32_t(p[2]) | uint32_t(p[1]) << 8 | uint32_t(p[0]) << 16
+                       | uint32_t(p[3]) << 24);
+    }
+  }
+  auto put = [&](uint32_t v) {
+    for (int k = 0; k < 4; k++)
+      tga.push_back(uint8_t(v >> (k * 8)));
+  };
+  for (size_t i = 0; i < pixels.size();) {
+    size_t run = 1;
+    while (rle && i + run < pixels.size() && run < 128 && pixels[i + run] == pixels[i])
+      run++;
+    if (rle && run > 1) {
+      tga.push_back(uint8_t(0x80 | (run - 1)));
+      put(pixels[i]);
+      i += run;
+    } else {
+      const size_t n = rle ? 1 : pixels.size();
+      if (rle) tga.push_back(0);
+      for (size_t k = 0; k < n; k++)
+        put(pixels[i + k]);
+      i += n;
+    }
+  }
+  return tga;
+}
+
+// Radiance HDR from RGBE pixels; per-channel run-length scanlines, or flat ones
+static vector<uint8_t> write_hdr(const vector<uint8_t>& rgbe, uint32_t w, uint32_t h, bool rle) {
+  const string header
+    = "#?RADIANCE\nFORMAT=32-bit_rle_rgbe\n\n-Y " + to_string(h) + " +X " + to_string(w) + "\n";
+  vector<uint8_t> hdr(header.begin(), header.end());
+  for (uint32_t y = 0; y < h; y++) {
+    const uint8_t* row = &rgbe[y * w * 4];
+    if (!rle) {
+      hdr.insert(hdr.end(), row, row + w * 4);
+      continue;
+    }
+    hdr.insert(hdr.end(), {2, 2, uint8_t(w >> 8), uint8_t(w)});
+    for (int c = 0; c < 4; c++)
+      for (uint32_t x = 0; x < w;) {
+        uint32_t run = 1;
+        while (x + run < w && run < 127 && row[(x + run) * 4 + c] == row[x * 4 + c])
+          run++;
+        if (run > 2) {
+          hdr.insert(hdr.end(), {uint8_t(128 + run), row[x * 4 + c]});
+        } else {
+          run = min(w - x, 2u);
+          hdr.push_back(uint8_t(run));
+          for (uint32_t k = 0; k < run; k++)
+            hdr.push_back(row[(x + k) * 4 + c]);
+        }
+        x += run;
+      }
+  }
+  return hdr;
+}
+
+static bool write_file(const string& path, const vector<uint8_t>& bytes) {
+  FILE* f = fopen(path.c_str(), "wb");
+  if (!f) return false;
+  const bool ok = fwrite(bytes.data(), 1, bytes.size(), f) == bytes.size();
+  return fclose(f) == 0 && ok;
+}
+
+// Smooth gradients with some noise and sharp edges, like a photo-sourced albedo map
+static vector<uint8_t> test_image(uint32_t w, uint32_t h, mt19937& rng, bool alpha) {
+  vector<uint8_t> rgba(size_t(w) * h * 4);
+  uniform_int_distribution<int> noise(-6, 6);
+  for (uint32_t y = 0; y < h; y++)
+    for (uint32_t x = 0; x < w; x++) {
+      uint8_t* p = &rgba[(size_t(y) * w + x) * 4];
+      const double u = double(x) / w, v = double(y) / h;
+      const bool stripe = (x / 37 + y / 53) % 7 == 0;
+      const double base[3] = {0.5 + 0.4 * sin(u * 9.0), 0.4 + 0.3 * cos(v * 7.0 + u * 3.0),
+        stripe ? 0.9 : 0.2 + 0.2 * u};
+      for (int c = 0; c < 3; c++)
+        p[c] = uint8_t(max(0, min(255, int(base[c] * 255.0) + noise(rng))));
+      p[3] = alpha ? uint8_t(x * 255 / max(w - 1, 1u)) : 255;
+    }
+  return rgba;
+}
+
+// Peak signal-to-noise ratio over the first `channels` channels
+static double psnr(const vector<uint8_t>& a, const vector<uint8_t>& b, int channels) {
+  double sum = 0.0;
+  for (size_t i = 0; i < a.size(); i++)
+    if (int(i % 4) < channels) sum += double(a[i] - b[i]) * double(a[i] - b[i]);
+  const double mse = sum / (a.size() / 4 * channels);
+  return mse == 0.0 ? 99.0 : 10.0 * log10(255.0 * 255.0 / mse);
+}
+
+int main() {
+  mt19937 rng(11);
+  bool ok = true;
+  auto check = [&](bool cond, const char* what) {
+    if (!cond) console << "Check failed: " << what << endl;
+    ok &= cond;
+  };
+
+  // Decoders
+  {
+    const string text = [] {
+      string s;
+      for (int i = 0; i < 40; i++)
+        s += "rei texture pipeline ";
+      for (int i = 0; i < 256; i++)
+        s.push_back(char(i));
+      return s;
+    }();
+    vector<uint8_t> out;
+    const bool inflated = inflate_zlib(k_zlib_fixed, sizeof(k_zlib_fixed), text.size(), out);
+    check(inflated && memcmp(out.data(), text.data(), text.size()) == 0, "inflate");
+    check(!inflate_zlib(k_zlib_fixed, sizeof(k_zlib_fixed) - 4, text.size(), out),
+      "inflate rejects a truncated stream");
+
+    Image image;
+    bool same = decode_png(k_png_interlaced, sizeof(k_png_interlaced), image) && image.width == 8;
+    for (int i = 0; same && i < 64; i++) {
+      uint8_t expected[4];
+      png_pixel(i % 8, i / 8, expected);
+      same &= memcmp(&image.rgba8[i * 4], expected, 4) == 0;
+    }
+    check(same, "interlaced PNG");
+
+    const uint32_t w = 61, h = 37;
+    vector<uint8_t> rgba = test_image(w, h, rng, true);
+    const vector<uint8_t> png = write_png(rgba, w, h);
+    same = decode_png(png.data(), png.size(), image);
+    for (size_t i = 0; same && i < rgba.size(); i++)
+      same &= image.rgba8[i] == (i % 4 == 3 ? 255 : rgba[i]);
+    check(same, "filtered PNG");
+    check(!decode_png(png.data(), png.size() / 2, image), "PNG rejects truncated data");
+
+    for (bool rle : {false, true}) {
+      const vector<uint8_t> tga = write_tga(rgba, w, h, rle);
+      check(decode_tga(tga.data(), tga.size(), image) && image.rgba8 == rgba, "TGA");
+    }
+
+    vector<uint8_t> rgbe(w * h * 4);
+    for (size_t i = 0; i < rgbe.size(); i++)
+      rgbe[i] = i % 4 == 3 ? uint8_t(120 + (i / 4) % 16) : uint8_t(i / 4 / 9 * 9 + i % 4);
+    for (bool rle : {false, true}) {
+      const vector<uint8_t> hdr = write_hdr(rgbe, w, h, rle);
+      same = decode_hdr(hdr.data(), hdr.size(), image) && image.hdr;
+      for (size_t i = 0; same && i < rgbe.size(); i++) {
+        const size_t px = i / 4 * 4;
+        const float expected
+          = i % 4 == 3 ? 1.f : (rgbe[i] + 0.5f) * ldexp(1.f, int(rgbe[px + 3]) - 136);
+        same &= image.rgba32f[i] == expected;
+      }
+      check(same, "HDR");
+    }
+  }
+
+  // Mip filtering is gamma-correct: a black and white checkerboard averages to sRGB 188, not 128
+  {
+    Image checker;
+    checker.width = checker.height = 64;
+    checker.rgba8.resize(64 * 64 * 4);
+    for (size_t i = 0; i < checker.pixel_num(); i++) {
+      const uint8_t v = ((i % 64) + (i / 64)) % 2 ? 255 : 0;
+      memset(&checker.rgba8[i * 4], v, 3);
+      checker.rgba8[i * 4 + 3] = 255;
+    }
+    TextureImportOptions options;
+    options.compression = TextureImportOptions::Compression::None;
+    options.filter = MipFilter::Box;
+    TexturePtr t = build_texture(checker, options, L"checker");
+    check(t->level_count() == 7 && t->level(6).width == 1, "full mip chain");
+    const uint8_t* level1 = t->level_data(1);
+    check(abs(int(level1[0]) - 188) <= 1 && level1[3] == 255, "gamma-correct box filter");
+    options.usage = TextureImportOptions::Usage::Linear;
+    t = build_texture(checker, options, L"checker");
+    check(abs(int(t->level_data(1)[0]) - 128) <= 1, "linear box filter");
+  }
+
+  // Block encoders
+  {
+    const uint32_t w = 256, h = 256;
+    const vector<uint8_t> rgba = test_image(w, h, rng, true);
+    const struct {
+      TextureFormat format;
+      int channels;
+      double min_psnr;
+    } cases[] = {{TextureFormat::BC1, 3, 30.0}, {TextureFormat::BC3, 4, 30.0},
+      {TextureFormat::BC5, 2, 38.0}, {TextureFormat::BC7, 4, 34.0}};
+    vector<uint8_t> opaque = rgba;
+    for (size_t i = 3; i < opaque.size(); i += 4)
+      opaque[i] = 255;
+    for (const auto& c : cases) {
+      // BC1 colors are only meaningful where the pixel is opaque
+      const vector<uint8_t>& src = c.format == TextureFormat::BC1 ? opaque : rgba;
+      double last = 0.0;
+      for (CompressionQuality q :
+        {CompressionQuality::Fast, CompressionQuality::Normal, CompressionQuality::High}) {
+        const vector<uint8_t> blocks = compress_image(src.data(), w, h, c.format, q);
+        const vector<uint8_t> back = decompress_image(blocks.data(), w, h, c.format);
+        const double db = psnr(src, back, c.channels);
+        check(db >= c.min_psnr && db >= last - 0.05, format_name(c.format));
+        last = db;
+      }
+    }
+    // BC1 keeps a 1-bit alpha
+    const vector<uint8_t> bc1 = compress_image(rgba.data(), w, h, TextureFormat::BC1,
+      CompressionQuality::Normal);
+    const vector<uint8_t> back = decompress_image(bc1.data(), w, h, TextureFormat::BC1);
+    bool cutout = true;
+    for (size_t i = 3; i < rgba.size(); i += 4)
+      cutout &= back[i] == (rgba[i] < 128 ? 0 : 255);
+    check(cutout, "BC1 transparency");
+  }
+
+  // Conversion throughput, size and quality of level 0, on a material-sized texture
+  const uint32_t size = 2048;
+  Image source;
+  source.width = source.height = size;
+  source.rgba8 = test_image(size, size, rng, false);
+  const double rgba8_bytes = double(level_bytes(TextureFormat::RGBA8, size, size)) * 4.0 / 3.0;
+  console << "Texture " << size << "x" << size << " with mips, "
+          << global_thread_pool().concurrency() << " threads" << endl;
+  using Compression = TextureImportOptions::Compression;
+  const struct {
+    Compression compression;
+    TextureImportOptions::Usage usage;
+  } formats[] = {{Compression::BC1, TextureImportOptions::Usage::Color},
+    {Compression::BC7, TextureImportOptions::Usage::Color},
+    {Compression::BC5, TextureImportOptions::Usage::NormalMap}};
+  const char* quality_names[] = {"fast", "normal", "high"};
+  for (const auto& f : formats)
+    for (int q = 0; q < 3; q++) {
+      TextureImportOptions options;
+      options.compression = f.compression;
+      options.usage = f.usage;
+      options.quality = CompressionQuality(q);
+      auto start = Clock::now();
+      TexturePtr t = build_texture(source, options, L"bench");
+      const double ms = ms_since(start);
+      const vector<uint8_t> back = decompress_image(t->level_data(0), size, size, t->format());
+      const int channels = f.usage == TextureImportOptions::Usage::NormalMap ? 2 : 3;
+      console << format_name(t->format()) << " " << quality_names[q] << ": " << ms << " ms, "
+              << psnr(source.rgba8, back, channels) << " dB, " << rgba8_bytes / t->total_bytes()
+              << "x smaller than RGBA8" << endl;
+    }
+  {
+    TextureImportOptions options;
+    options.compression = Compression::None;
+    auto start = Clock::now();
+    TexturePtr t = build_texture(source, options, L"bench");
+    console << "Mip chain only (Kaiser, RGBA8): " << ms_since(start) << " ms" << endl;
+  }
+
+  // Import through a scratch cache: a miss converts and stores, a hit maps the stored file
+  const fs::path dir = fs::temp_directory_path() / "rei_bench_texture";
+  fs::remove_all(dir);
+  fs::create_directories(dir);
+  {
+    const string png_path = (dir / "albedo.png").string();
+    check(write_file(png_path, write_png(source.rgba8, size, size)), "write PNG");
+    AssetCache::Options cache_options;
+    cache_options.directory = (dir / "cache").string();
+    TextureImporter importer(make_shared<AssetCache>(cache_options));
+
+    auto start = Clock::now();
+    TexturePtr converted = importer.load(png_path);
+    const double miss_ms = ms_since(start);
+    start = Clock::now();
+    TexturePtr cached = importer.load(png_path);
+    const double hit_ms = ms_since(start);
+    bool same = converted && cached && cached->format() == converted->format()
+                && cached->level_count() == converted->level_count();
+    for (uint32_t i = 0; same && i < cached->level_count(); i++)
+      same &= memcmp(cached->level_data(i), converted->level_data(i), cached->level(i).bytes) == 0;
+    check(same, "cached texture matches the conversion");
+    check(converted && converted->format() == TextureFormat::BC1_SRGB, "auto format");
+    console << "Import: " << miss_ms << " ms converting, " << hit_ms << " ms from the cache"
+            << endl;
+
+    const string garbage = (dir / "garbage.rtex").string();
+    check(write_file(garbage, vector<uint8_t>(4096, 7)), "write garbage");
+    check(!Texture::open(garbage, L"garbage"), "reject a malformed container");
+  }
+  fs::remove_all(dir);
+
+  console << "Texture check: " << (ok ? "passed" : "FAILED") << endl;
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,83 @@
+// Benchmark scene voxelization and octree ray marching
+
+#include <chrono>
+#include <random>
+#include <string>
+
+#include <console.h>
+#include <geometry.h>
+#include <material.h>
+#include <parallel.h>
+#include <scene.h>
+#include <voxelizer.h>
+
+using namespace std;
+using namespace rei;
+
+using Clock = chrono::high_resolution_clock;
+
+static double ms_since(Clock::time_point start) {
+  return chrono::duration<double, milli>(Clock::now() - start).count();
+}
+
+// A floor and a grid of balls, similar to the ray tracing demo but larger
+static Scene make_scene(int balls_per_axis) {
+  Scene scene;
+  MaterialPtr stone = make_shared<Material>(L"stone");
+  stone->set(L"albedo", Colors::white * 0.5);
+  MaterialPtr light = make_shared<Material>(L"light");
+  light->set(L"albedo", Colors::yellow);
+  light->set(L"emissive", 4.0);
+
+  MeshPtr plane = make_shared<Mesh>(Mesh::procudure_cube({16, 0.125, 16}));
+  MeshPtr ball = make_shared<Mesh>(Mesh::procudure_sphere_icosahedron(3, 0.4));
+  scene.add_model(Mat4::translate({0, -0.125, 0}), plane, stone, L"floor");
+  for (int i = 0; i < balls_per_axis; i++)
+    for (int j = 0; j < balls_per_axis; j++) {
+      double x = -15 + 30.0 * (i + 0.5) / balls_per_axis;
+      double z = -15 + 30.0 * (j + 0.5) / balls_per_axis;
+      scene.add_model(Mat4::translate({x, 0.5, z}), ball, (i + j) % 7 ? stone : light, L"ball");
+    }
+  return scene;
+}
+
+int main() {
+  console << "threads: " << global_thread_pool().concurrency() << endl;
+  Scene scene = make_scene(32);
+
+  for (int resolution : {128, 256, 512}) {
+    VoxelizeOptions options;
+    options.resolution = resolution;
+
+    auto start = Clock::now();
+    SparseVoxelOctree svo = SparseVoxelOctree::voxelize(scene, options);
+    double voxelize_ms = ms_since(start);
+    console << "--- " << resolution << "^3 ---" << endl;
+    console << "voxelize: " << voxelize_ms << " ms, " << svo.leaf_num() << " leaves, "
+            << svo.node_num() << " nodes, " << svo.memory_bytes() / 1024 << " KiB" << endl;
+
+    // Random rays from above the floor
+    const size_t ray_num = 1 << 20;
+    mt19937 rng(7);
+    uniform_real_distribution<double> unit(0.0, 1.0);
+    vector<Vec3> origins(ray_num), dirs(ray_num);
+    for (size_t i = 0; i < ray_num; i++) {
+      origins[i] = Vec3(unit(rng) * 30 - 15, 0.2 + unit(rng) * 2, unit(rng) * 30 - 15);
+      dirs[i] = Vec3(unit(rng) - 0.5, unit(rng) - 0.5, unit(rng) - 0.5).normalized();
+    }
+    vector<char> hits(ray_num);
+    start = Clock::now();
+    parallel_for(0, ray_num, 256, [&](size_t i) {
+      SparseVoxelOctree::RayHit hit;
+      hits[i] = svo.ray_march(origins[i], dirs[i], 64.0, hit);
+    });
+    double march_ms = ms_since(start);
+    size_t hit_num = 0;
+    for (char h : hits)
+      hit_num += h;
+    console << "ray march: " << ray_num / (march_ms * 1e3) << " Mrays/s, hit rate "
+            << double(hit_num) / ray_num << endl;
+  }
+
+  return 0;
+}